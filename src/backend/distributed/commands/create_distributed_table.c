@@ -80,6 +80,8 @@
 #include "distributed/multi_executor.h"
 #include "distributed/multi_logical_planner.h"
 #include "distributed/multi_partitioning_utils.h"
+#include "distributed/multi_progress.h"
+#include "distributed/parallel_copy.h"
 #include "distributed/pg_dist_colocation.h"
 #include "distributed/pg_dist_partition.h"
 #include "distributed/reference_table_utils.h"
@@ -183,7 +185,8 @@ static bool CanUseExclusiveConnections(Oid relationId, bool localTableEmpty);
 static uint64 DoCopyFromLocalTableIntoShards(Relation distributedRelation,
 											 DestReceiver *copyDest,
 											 TupleTableSlot *slot,
-											 EState *estate);
+											 EState *estate,
+											 DistributeDataProgress *progress);
 static void ErrorIfTemporaryTable(Oid relationId);
 static void ErrorIfForeignTable(Oid relationOid);
 static void SendAddLocalTableToMetadataCommandOutsideTransaction(Oid relationId);
@@ -2741,8 +2744,48 @@ CopyFromLocalTableIntoDistTable(Oid localTableId, Oid distributedTableId)
 	/* initialise state for writing to shards, we'll open connections on demand */
 	copyDest->rStartup(copyDest, 0, sourceTupleDescriptor);
 
-	uint64 rowsCopied = DoCopyFromLocalTableIntoShards(localRelation, copyDest, slot,
-													   estate);
+	/* report progress, unless we are already part of a monitored operation */
+	DistributeDataProgress *progress = NULL;
+	BlockNumber totalBlocks = RelationGetNumberOfBlocks(localRelation);
+	if (totalBlocks > 0 && !HasProgressMonitor())
+	{
+		progress = CreateDistributeDataProgressMonitor(distributedTableId,
+													   totalBlocks);
+	}
+
+	uint64 rowsCopied = 0;
+
+	PG_TRY();
+	{
+		if (CanCopyLocalDataInParallel(localRelation,
+									   (CitusCopyDestReceiver *) copyDest))
+		{
+			rowsCopied =
+				ParallelCopyLocalDataIntoShards(localRelation,
+												(CitusCopyDestReceiver *) copyDest,
+												progress);
+		}
+		else
+		{
+			rowsCopied = DoCopyFromLocalTableIntoShards(localRelation, copyDest, slot,
+														estate, progress);
+		}
+	}
+	PG_CATCH();
+	{
+		if (progress != NULL)
+		{
+			FinalizeCurrentProgressMonitor();
+		}
+
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	if (progress != NULL)
+	{
+		FinalizeCurrentProgressMonitor();
+	}
 
 	/* finish writing into the shards */
 	copyDest->rShutdown(copyDest);
@@ -2769,7 +2812,8 @@ static uint64
 DoCopyFromLocalTableIntoShards(Relation localRelation,
 							   DestReceiver *copyDest,
 							   TupleTableSlot *slot,
-							   EState *estate)
+							   EState *estate,
+							   DistributeDataProgress *progress)
 {
 	/* begin reading from local table */
 	TableScanDesc scan = table_beginscan(localRelation, GetActiveSnapshot(), 0,
@@ -2796,6 +2840,10 @@ DoCopyFromLocalTableIntoShards(Relation localRelation,
 
 		rowsCopied++;
 
+		UpdateDistributeDataProgress(progress,
+									 ItemPointerGetBlockNumber(&slot->tts_tid) + 1,
+									 rowsCopied);
+
 		if (rowsCopied % LOG_PER_TUPLE_AMOUNT == 0)
 		{
 			ereport(DEBUG1, (errmsg("Copied " UINT64_FORMAT " rows", rowsCopied)));
@@ -62,6 +62,7 @@
 #include "catalog/pg_attribute.h"
 #include "catalog/pg_type.h"
 #include "commands/copy.h"
+#include "commands/copyfrom_internal.h"
 #include "commands/defrem.h"
 #include "commands/progress.h"
 #include "executor/executor.h"
@@ -72,9 +73,12 @@
 #include "nodes/nodeFuncs.h"
 #include "parser/parse_func.h"
 #include "parser/parse_type.h"
+#include "storage/latch.h"
 #include "tcop/cmdtag.h"
+#include "tcop/tcopprot.h"
 #include "tsearch/ts_locale.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
@@ -82,10 +86,13 @@
 
 #include "pg_version_constants.h"
 
+#include "distributed/citus_custom_scan.h"
 #include "distributed/citus_safe_lib.h"
 #include "distributed/commands/multi_copy.h"
 #include "distributed/commands/utility_hook.h"
 #include "distributed/coordinator_protocol.h"
+#include "distributed/deparse_shard_query.h"
+#include "distributed/distributed_planner.h"
 #include "distributed/hash_helpers.h"
 #include "distributed/intermediate_results.h"
 #include "distributed/listutils.h"
@@ -98,6 +105,8 @@
 #include "distributed/multi_partitioning_utils.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_router_planner.h"
+#include "distributed/parallel_copy.h"
+#include "distributed/placement_access.h"
 #include "distributed/placement_connection.h"
 #include "distributed/relation_access_tracking.h"
 #include "distributed/remote_commands.h"
@@ -109,6 +118,7 @@
 #include "distributed/transmit.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_protocol.h"
+#include "distributed/worker_shard_copy.h"
 
 #if PG_VERSION_NUM >= PG_VERSION_16
 #include "distributed/relation_utils.h"
@@ -118,9 +128,30 @@
 /* constant used in binary protocol */
 static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
 
+/* maximum amount of data buffered per shard during COPY .. TO STDOUT */
+#define COPY_TO_FETCH_BUFFER_SIZE (1024 * 1024)
+
+/* settings of the coordinator that COPY .. TO STDOUT uses to format values */
+static const char *CopyToOutputSettings[] = {
+	"TimeZone",
+	"DateStyle",
+	"IntervalStyle",
+	"extra_float_digits",
+	"bytea_output"
+};
+
 /* if true, skip validation of JSONB columns during COPY */
 bool SkipJsonbValidationInCopy = true;
 
+/* maximum number of connections used concurrently by COPY .. TO STDOUT */
+int MaxCopyToConnections = 1;
+
+/* if true, COPY .. TO STDOUT sends the rows of the shards in shard order */
+bool CopyToPreserveShardOrder = true;
+
+/* if true, forward text and CSV input lines to shards without parsing them */
+bool SkipRowValidationInCopy = false;
+
 /* custom Citus option for appending to a shard */
 #define APPEND_TO_SHARD_OPTION "append_to_shard"
 
@@ -222,6 +253,46 @@ struct CopyShardState
 };
 
 
+/*
+ * CopyToFetch represents a COPY .. TO STDOUT command on a shard placement of
+ * which the output is forwarded to the client.
+ */
+typedef struct CopyToFetch
+{
+	char *copyCommand;
+	List *placementAccessList;
+
+	/* connection that accessed the placements earlier in the transaction */
+	MultiConnection *requiredConnection;
+
+	/* connection over which the command runs, NULL once it is done */
+	MultiConnection *connection;
+
+	bool copyStarted;
+	bool done;
+
+	/* rows received while the rows of earlier fetches are still being sent */
+	StringInfo bufferedData;
+	int64 bufferedRowCount;
+} CopyToFetch;
+
+
+/*
+ * CopyToFetchState keeps track of the fetches of a COPY .. TO STDOUT of which
+ * the output is sent to the client.
+ */
+typedef struct CopyToFetchState
+{
+	CopyToFetch **fetchArray;
+
+	/* first fetch of which not all data was sent yet */
+	int headFetchIndex;
+
+	/* whether the header line of the first fetch still needs to be sent */
+	bool headerPending;
+} CopyToFetchState;
+
+
 /*
  * Represents the state for allowing copy via local
  * execution.
@@ -238,6 +309,14 @@ typedef enum LocalCopyStatus
 static void CopyToExistingShards(CopyStmt *copyStatement,
 								 QueryCompletion *completionTag);
 static bool IsCopyInBinaryFormat(CopyStmt *copyStatement);
+static bool CanForwardCopyInputLines(CopyStmt *copyStatement,
+									 CitusCopyDestReceiver *copyDest,
+									 Relation distributedRelation,
+									 bool isInputFormatBinary);
+static bool IsForwardableCopyOption(char *optionName);
+static uint64 ForwardCopyInputLines(CopyFromState copyState, CopyStmt *copyStatement,
+									CitusCopyDestReceiver *copyDest,
+									Relation distributedRelation);
 static List * FindJsonbInputColumns(TupleDesc tupleDescriptor,
 									List *inputColumnNameList);
 static List * RemoveOptionFromList(List *optionList, char *optionName);
@@ -248,6 +327,7 @@ static void SendCopyBinaryHeaders(CopyOutState copyOutState, int64 shardId,
 static void SendCopyBinaryFooters(CopyOutState copyOutState, int64 shardId,
 								  List *connectionList);
 static StringInfo ConstructCopyStatement(CopyStmt *copyStatement, int64 shardId);
+static void AppendCopyOptions(StringInfo command, List *optionList);
 static void SendCopyDataToAll(StringInfo dataBuffer, int64 shardId, List *connectionList);
 static void SendCopyDataToPlacement(StringInfo dataBuffer, int64 shardId,
 									MultiConnection *connection);
@@ -299,8 +379,19 @@ static void ShutdownCopyConnectionState(CopyConnectionState *connectionState,
 										CitusCopyDestReceiver *copyDest);
 static SelectStmt * CitusCopySelect(CopyStmt *copyStatement);
 static void CitusCopyTo(CopyStmt *copyStatement, QueryCompletion *completionTag);
-static int64 ForwardCopyDataFromConnection(CopyOutState copyOutState,
-										   MultiConnection *connection);
+static bool CitusCopyQueryTo(CopyStmt *copyStatement, const char *queryString,
+							 QueryCompletion *completionTag);
+static List * CopyQueryToTaskList(PlannedStmt *plannedStmt);
+static bool CopyStatementHasHeader(CopyStmt *copyStatement);
+static char * CopyToOutputSettingsCommand(void);
+static int64 ForwardCopyDataFromShards(CopyOutState copyOutState, List *fetchList,
+									   bool headerRequested);
+static bool StartCopyToFetch(CopyToFetch *fetch, bool optionalConnection);
+static bool CanForwardCopyToFetch(CopyToFetchState *fetchState, int fetchIndex);
+static bool ReceiveCopyToFetchData(CopyToFetchState *fetchState, int fetchIndex,
+								   CopyOutState copyOutState, int64 *tuplesSent);
+static void FinishCopyToFetch(CopyToFetch *fetch);
+static void WaitForCopyToFetches(CopyToFetchState *fetchState, int startedFetchCount);
 
 /* Private functions copied and adapted from copy.c in PostgreSQL */
 static void SendCopyBegin(CopyOutState cstate);
@@ -315,6 +406,14 @@ static void CopyAttributeOutText(CopyOutState outputState, char *string);
 static inline void CopyFlushOutput(CopyOutState outputState, char *start, char *pointer);
 static bool CitusSendTupleToPlacements(TupleTableSlot *slot,
 									   CitusCopyDestReceiver *copyDest);
+static void CitusSendRawRowToPlacements(CitusCopyDestReceiver *copyDest, int64 shardId,
+										StringInfo rowData);
+static CopyShardState * GetShardStateForRow(CitusCopyDestReceiver *copyDest,
+											int64 shardId, bool *firstTupleInShard);
+static void SendCopyRowToPlacements(CitusCopyDestReceiver *copyDest,
+									CopyShardState *shardState,
+									Datum *columnValues, bool *columnNulls,
+									StringInfo rawRowData);
 static void AddPlacementStateToCopyConnectionStateBuffer(CopyConnectionState *
 														 connectionState,
 														 CopyPlacementState *
@@ -343,7 +442,6 @@ static void CreateLocalColocatedIntermediateFile(CitusCopyDestReceiver *copyDest
 static void FinishLocalColocatedIntermediateFiles(CitusCopyDestReceiver *copyDest);
 static void CloneCopyOutStateForLocalCopy(CopyOutState from, CopyOutState to);
 static LocalCopyStatus GetLocalCopyStatus(void);
-static bool ShardIntervalListHasLocalPlacements(List *shardIntervalList);
 static void LogLocalCopyToRelationExecution(uint64 shardId);
 static void LogLocalCopyToFileExecution(uint64 shardId);
 
@@ -512,6 +610,114 @@ CopyToExistingShards(CopyStmt *copyStatement, QueryCompletion *completionTag)
 	DestReceiver *dest = (DestReceiver *) copyDest;
 	dest->rStartup(dest, 0, tupleDescriptor);
 
+	bool forwardInputLines = CanForwardCopyInputLines(copyStatement, copyDest,
+													  distributedRelation,
+													  isInputFormatBinary);
+	bool copyInParallel = !forwardInputLines &&
+						  CanCopyFromInParallel(copyStatement, copyDest,
+												distributedRelation,
+												isInputFormatBinary);
+
+	/* initialize copy state to read from COPY data source */
+	bool skipJsonbValidation = SkipJsonbValidationInCopy && !isInputFormatBinary &&
+							   !forwardInputLines;
+	bool binaryOutput = copyDest->copyOutState->binary;
+	FmgrInfo *columnOutputFunctions = copyDest->columnOutputFunctions;
+	CopyFromState copyState = BeginCopyFromDistributedTable(distributedRelation,
+															copyStatement, NULL,
+															partitionColumnIndex,
+															skipJsonbValidation,
+															binaryOutput,
+															columnOutputFunctions);
+
+	/* set up callback to identify error line number */
+	errorCallback.callback = CopyFromErrorCallback;
+	errorCallback.arg = (void *) copyState;
+	errorCallback.previous = error_context_stack;
+	error_context_stack = &errorCallback;
+
+	if (forwardInputLines)
+	{
+		processedRowCount = ForwardCopyInputLines(copyState, copyStatement, copyDest,
+												  distributedRelation);
+	}
+	else if (copyInParallel &&
+			 ParallelCopyFromIntoShards(copyState, copyStatement, copyDest,
+										&processedRowCount))
+	{
+		/* the input lines were parsed by parallel workers */
+	}
+	else
+	{
+		while (true)
+		{
+			ResetPerTupleExprContext(executorState);
+
+			MemoryContext oldContext = MemoryContextSwitchTo(executorTupleContext);
+
+			/* parse a row from the input */
+			bool nextRowFound = NextCopyFrom(copyState, executorExpressionContext,
+											 columnValues, columnNulls);
+
+			if (!nextRowFound)
+			{
+				MemoryContextSwitchTo(oldContext);
+				break;
+			}
+
+			CHECK_FOR_INTERRUPTS();
+
+			MemoryContextSwitchTo(oldContext);
+
+			dest->receiveSlot(tupleTableSlot, dest);
+
+			++processedRowCount;
+
+			pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED,
+										 processedRowCount);
+		}
+	}
+
+	EndCopyFrom(copyState);
+
+	/* all lines have been copied, stop showing line number in errors */
+	error_context_stack = errorCallback.previous;
+
+	/* finish the COPY commands */
+	dest->rShutdown(dest);
+	dest->rDestroy(dest);
+
+	ExecDropSingleTupleTableSlot(tupleTableSlot);
+	FreeExecutorState(executorState);
+	table_close(distributedRelation, NoLock);
+
+	CHECK_FOR_INTERRUPTS();
+
+	if (completionTag != NULL)
+	{
+		CompleteCopyQueryTagCompat(completionTag, processedRowCount);
+	}
+}
+
+
+/*
+ * BeginCopyFromDistributedTable starts reading the input of a COPY .. FROM
+ * into the given distributed table, either from the source of the COPY
+ * statement or from the given data source callback.
+ *
+ * If skipJsonbValidation is set, JSONB columns other than the distribution
+ * column are parsed as text and the given output functions are changed to
+ * send them as JSONB in the given format.
+ */
+CopyFromState
+BeginCopyFromDistributedTable(Relation distributedRelation, CopyStmt *copyStatement,
+							  copy_data_source_cb dataSourceCallback,
+							  int partitionColumnIndex, bool skipJsonbValidation,
+							  bool binaryOutput, FmgrInfo *columnOutputFunctions)
+{
+	Oid tableId = RelationGetRelid(distributedRelation);
+	TupleDesc tupleDescriptor = RelationGetDescr(distributedRelation);
+
 	/*
 	 * Below, we change a few fields in the Relation to control the behaviour
 	 * of BeginCopyFrom. However, we obviously should not do this in relcache
@@ -554,9 +760,8 @@ CopyToExistingShards(CopyStmt *copyStatement, QueryCompletion *completionTag)
 	 * until the object is parsed by the worker, which is unable to give an accurate
 	 * line number.
 	 */
-	if (SkipJsonbValidationInCopy && !isInputFormatBinary)
+	if (skipJsonbValidation)
 	{
-		CopyOutState copyOutState = copyDest->copyOutState;
 		ListCell *jsonbColumnIndexCell = NULL;
 
 		/* get the column indices for all JSONB columns that appear in the input */
@@ -586,7 +791,7 @@ CopyToExistingShards(CopyStmt *copyStatement, QueryCompletion *completionTag)
 			/* parse the column as text instead of JSONB */
 			currentColumn->atttypid = TEXTOID;
 
-			if (copyOutState->binary)
+			if (binaryOutput)
 			{
 				Oid textSendAsJsonbFunctionId = CitusTextSendAsJsonbFunctionId();
 
@@ -598,13 +803,13 @@ CopyToExistingShards(CopyStmt *copyStatement, QueryCompletion *completionTag)
 				 * prepending a version number.
 				 */
 				fmgr_info(textSendAsJsonbFunctionId,
-						  &copyDest->columnOutputFunctions[jsonbColumnIndex]);
+						  &columnOutputFunctions[jsonbColumnIndex]);
 			}
 			else
 			{
 				Oid textoutFunctionId = TextOutFunctionId();
 				fmgr_info(textoutFunctionId,
-						  &copyDest->columnOutputFunctions[jsonbColumnIndex]);
+						  &columnOutputFunctions[jsonbColumnIndex]);
 			}
 		}
 	}
@@ -615,27 +820,183 @@ CopyToExistingShards(CopyStmt *copyStatement, QueryCompletion *completionTag)
 											NULL,
 											copyStatement->filename,
 											copyStatement->is_program,
-											NULL,
+											dataSourceCallback,
 											copyStatement->attlist,
 											copyStatement->options);
 
-	/* set up callback to identify error line number */
-	errorCallback.callback = CopyFromErrorCallback;
-	errorCallback.arg = (void *) copyState;
-	errorCallback.previous = error_context_stack;
-	error_context_stack = &errorCallback;
+	return copyState;
+}
+
+
+/*
+ * CanForwardCopyInputLines returns whether the lines of a COPY .. FROM in text
+ * or CSV format can be forwarded to the shards as they are, in which case
+ * only the distribution column is parsed on the coordinator to find the shard
+ * and the remaining columns are validated by the workers.
+ *
+ * This requires all columns to be in the input, since defaults of missing
+ * columns are evaluated on the coordinator, and the input lines cannot be
+ * written to local shards.
+ */
+static bool
+CanForwardCopyInputLines(CopyStmt *copyStatement, CitusCopyDestReceiver *copyDest,
+						 Relation distributedRelation, bool isInputFormatBinary)
+{
+	if (!SkipRowValidationInCopy || isInputFormatBinary)
+	{
+		return false;
+	}
+
+	DefElem *option = NULL;
+	foreach_ptr(option, copyStatement->options)
+	{
+		if (!IsForwardableCopyOption(option->defname))
+		{
+			return false;
+		}
+	}
+
+	if (!CopyInputIncludesAllColumns(distributedRelation, copyStatement->attlist))
+	{
+		return false;
+	}
+
+	if (copyDest->shouldUseLocalCopy)
+	{
+		List *shardIntervalList = LoadShardIntervalList(copyDest->distributedRelationId);
+		if (ShardIntervalListHasLocalPlacements(shardIntervalList))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * CopyInputIncludesAllColumns returns whether the input of a COPY .. FROM with
+ * the given column list includes all columns of the relation that can be
+ * copied into, such that no defaults need to be evaluated.
+ */
+bool
+CopyInputIncludesAllColumns(Relation relation, List *attnameList)
+{
+	TupleDesc tupleDescriptor = RelationGetDescr(relation);
+	List *attnumList = CopyGetAttnums(tupleDescriptor, relation, attnameList);
+
+	return list_length(attnumList) == AvailableColumnCount(tupleDescriptor);
+}
+
+
+/*
+ * IsForwardableCopyOption returns whether input lines of a COPY with the given
+ * option can be forwarded to the shards as they are. The header, encoding and
+ * freeze options are handled on the coordinator, the rest only determine how
+ * the workers parse the lines.
+ */
+static bool
+IsForwardableCopyOption(char *optionName)
+{
+	return strcmp(optionName, "format") == 0 ||
+		   strcmp(optionName, "delimiter") == 0 ||
+		   strcmp(optionName, "null") == 0 ||
+		   strcmp(optionName, "quote") == 0 ||
+		   strcmp(optionName, "escape") == 0 ||
+		   strcmp(optionName, "header") == 0 ||
+		   strcmp(optionName, "encoding") == 0 ||
+		   strcmp(optionName, "freeze") == 0;
+}
+
+
+/*
+ * ForwardCopyInputLines reads the lines of the COPY input, parses only the
+ * distribution column of each line to find its shard, and sends the lines
+ * to the shards as they are. It returns the number of lines copied.
+ */
+static uint64
+ForwardCopyInputLines(CopyFromState copyState, CopyStmt *copyStatement,
+					  CitusCopyDestReceiver *copyDest, Relation distributedRelation)
+{
+	TupleDesc tupleDescriptor = RelationGetDescr(distributedRelation);
+	int partitionColumnIndex = copyDest->partitionColumnIndex;
+	EState *executorState = copyDest->executorState;
+	MemoryContext executorTupleContext = GetPerTupleMemoryContext(executorState);
+	Datum *columnValues = palloc0(tupleDescriptor->natts * sizeof(Datum));
+	bool *columnNulls = palloc0(tupleDescriptor->natts * sizeof(bool));
+	StringInfo lineData = makeStringInfo();
+	uint64 processedRowCount = 0;
+
+	List *attnumList = CopyGetAttnums(tupleDescriptor, distributedRelation,
+									  copyStatement->attlist);
+	int fieldCount = list_length(attnumList);
+
+	/* find the position of the distribution column in the input */
+	int partitionFieldIndex = -1;
+	int fieldIndex = 0;
+	int attnum = 0;
+	foreach_int(attnum, attnumList)
+	{
+		if (attnum - 1 == partitionColumnIndex)
+		{
+			partitionFieldIndex = fieldIndex;
+		}
+
+		fieldIndex++;
+	}
+
+	FmgrInfo partitionColumnInputFunction;
+	Oid partitionColumnTypeIOParam = InvalidOid;
+	int32 partitionColumnTypeMod = -1;
+
+	if (partitionColumnIndex != INVALID_PARTITION_COLUMN_INDEX)
+	{
+		Form_pg_attribute partitionColumn =
+			TupleDescAttr(tupleDescriptor, partitionColumnIndex);
+		Oid inputFunctionId = InvalidOid;
+
+		getTypeInputInfo(partitionColumn->atttypid, &inputFunctionId,
+						 &partitionColumnTypeIOParam);
+		fmgr_info(inputFunctionId, &partitionColumnInputFunction);
+		partitionColumnTypeMod = partitionColumn->atttypmod;
+	}
+
+	/* send the lines to the shards in the format of the input */
+	CopyStmt *shardCopyStatement = copyDest->copyStatement;
+	DefElem *option = NULL;
+
+	copyDest->copyOutState->binary = false;
+	shardCopyStatement->options = NIL;
+
+	foreach_ptr(option, copyStatement->options)
+	{
+		if (strcmp(option->defname, "header") != 0 &&
+			strcmp(option->defname, "encoding") != 0 &&
+			strcmp(option->defname, "freeze") != 0)
+		{
+			shardCopyStatement->options = lappend(shardCopyStatement->options, option);
+		}
+	}
+
+	if (copyStatement->attlist != NIL)
+	{
+		shardCopyStatement->attlist = copyStatement->attlist;
+	}
 
 	while (true)
 	{
+		char **fieldArray = NULL;
+		int fieldArrayLength = 0;
+
 		ResetPerTupleExprContext(executorState);
 
 		MemoryContext oldContext = MemoryContextSwitchTo(executorTupleContext);
 
-		/* parse a row from the input */
-		bool nextRowFound = NextCopyFrom(copyState, executorExpressionContext,
-										 columnValues, columnNulls);
+		/* split the line into fields, without calling their input functions */
+		bool nextLineFound = NextCopyFromRawFields(copyState, &fieldArray,
+												   &fieldArrayLength);
 
-		if (!nextRowFound)
+		if (!nextLineFound)
 		{
 			MemoryContextSwitchTo(oldContext);
 			break;
@@ -643,34 +1004,54 @@ CopyToExistingShards(CopyStmt *copyStatement, QueryCompletion *completionTag)
 
 		CHECK_FOR_INTERRUPTS();
 
-		MemoryContextSwitchTo(oldContext);
+		if (fieldArrayLength > fieldCount)
+		{
+			ereport(ERROR, (errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+							errmsg("extra data after last expected column")));
+		}
+		else if (fieldArrayLength < fieldCount)
+		{
+			int missingAttnum = list_nth_int(attnumList, fieldArrayLength);
+			Form_pg_attribute missingColumn =
+				TupleDescAttr(tupleDescriptor, missingAttnum - 1);
 
-		dest->receiveSlot(tupleTableSlot, dest);
+			ereport(ERROR, (errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+							errmsg("missing data for column \"%s\"",
+								   NameStr(missingColumn->attname))));
+		}
 
-		++processedRowCount;
+		if (partitionFieldIndex >= 0)
+		{
+			char *partitionField = fieldArray[partitionFieldIndex];
 
-		pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED, processedRowCount);
-	}
+			columnNulls[partitionColumnIndex] = (partitionField == NULL);
+			if (partitionField != NULL)
+			{
+				columnValues[partitionColumnIndex] =
+					InputFunctionCall(&partitionColumnInputFunction, partitionField,
+									  partitionColumnTypeIOParam,
+									  partitionColumnTypeMod);
+			}
+		}
 
-	EndCopyFrom(copyState);
+		int64 shardId = ShardIdForTuple(copyDest, columnValues, columnNulls);
 
-	/* all lines have been copied, stop showing line number in errors */
-	error_context_stack = errorCallback.previous;
+		MemoryContextSwitchTo(oldContext);
 
-	/* finish the COPY commands */
-	dest->rShutdown(dest);
-	dest->rDestroy(dest);
+		/* the line buffer holds the line in the server encoding, without newline */
+		resetStringInfo(lineData);
+		appendBinaryStringInfo(lineData, copyState->line_buf.data,
+							   copyState->line_buf.len);
+		appendStringInfoCharMacro(lineData, '\n');
 
-	ExecDropSingleTupleTableSlot(tupleTableSlot);
-	FreeExecutorState(executorState);
-	table_close(distributedRelation, NoLock);
+		CitusCopyDestReceiverSendRawRow(copyDest, shardId, lineData);
 
-	CHECK_FOR_INTERRUPTS();
+		++processedRowCount;
 
-	if (completionTag != NULL)
-	{
-		CompleteCopyQueryTagCompat(completionTag, processedRowCount);
+		pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED, processedRowCount);
 	}
+
+	return processedRowCount;
 }
 
 
@@ -1035,53 +1416,66 @@ ConstructCopyStatement(CopyStmt *copyStatement, int64 shardId)
 		appendStringInfoString(command, "TO STDOUT");
 	}
 
-	if (copyStatement->options != NIL)
+	AppendCopyOptions(command, copyStatement->options);
+
+	return command;
+}
+
+
+/*
+ * AppendCopyOptions appends the given COPY options as a WITH clause to the
+ * given command.
+ */
+static void
+AppendCopyOptions(StringInfo command, List *optionList)
+{
+	if (optionList == NIL)
 	{
-		ListCell *optionCell = NULL;
+		return;
+	}
 
-		appendStringInfoString(command, " WITH (");
+	ListCell *optionCell = NULL;
 
-		foreach(optionCell, copyStatement->options)
-		{
-			DefElem *defel = (DefElem *) lfirst(optionCell);
+	appendStringInfoString(command, " WITH (");
 
-			if (optionCell != list_head(copyStatement->options))
-			{
-				appendStringInfoString(command, ", ");
-			}
+	foreach(optionCell, optionList)
+	{
+		DefElem *defel = (DefElem *) lfirst(optionCell);
 
-			appendStringInfo(command, "%s", defel->defname);
+		if (optionCell != list_head(optionList))
+		{
+			appendStringInfoString(command, ", ");
+		}
 
-			if (defel->arg == NULL)
-			{
-				/* option without value */
-			}
-			else if (IsA(defel->arg, String))
-			{
-				char *value = defGetString(defel);
+		appendStringInfo(command, "%s", defel->defname);
 
-				/* make sure strings are quoted (may contain reserved characters) */
-				appendStringInfo(command, " %s", quote_literal_cstr(value));
-			}
-			else if (IsA(defel->arg, List))
-			{
-				List *nameList = defGetStringList(defel);
+		if (defel->arg == NULL)
+		{
+			/* option without value */
+		}
+		else if (IsA(defel->arg, String))
+		{
+			char *value = defGetString(defel);
 
-				appendStringInfo(command, " (%s)", NameListToQuotedString(nameList));
-			}
-			else
-			{
-				char *value = defGetString(defel);
+			/* make sure strings are quoted (may contain reserved characters) */
+			appendStringInfo(command, " %s", quote_literal_cstr(value));
+		}
+		else if (IsA(defel->arg, List))
+		{
+			List *nameList = defGetStringList(defel);
 
-				/* numeric options or * should not have quotes */
-				appendStringInfo(command, " %s", value);
-			}
+			appendStringInfo(command, " (%s)", NameListToQuotedString(nameList));
 		}
+		else
+		{
+			char *value = defGetString(defel);
 
-		appendStringInfoString(command, ")");
+			/* numeric options or * should not have quotes */
+			appendStringInfo(command, " %s", value);
+		}
 	}
 
-	return command;
+	appendStringInfoString(command, ")");
 }
 
 
@@ -1952,7 +2346,7 @@ GetLocalCopyStatus(void)
  * ShardIntervalListHasLocalPlacements returns true if any of the input
  * shard placement has a local placement;
  */
-static bool
+bool
 ShardIntervalListHasLocalPlacements(List *shardIntervalList)
 {
 	int32 localGroupId = GetLocalGroupId();
@@ -2257,17 +2651,6 @@ CitusCopyDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 static bool
 CitusSendTupleToPlacements(TupleTableSlot *slot, CitusCopyDestReceiver *copyDest)
 {
-	TupleDesc tupleDescriptor = copyDest->tupleDescriptor;
-	CopyStmt *copyStatement = copyDest->copyStatement;
-
-	CopyOutState copyOutState = copyDest->copyOutState;
-	FmgrInfo *columnOutputFunctions = copyDest->columnOutputFunctions;
-	CopyCoercionData *columnCoercionPaths = copyDest->columnCoercionPaths;
-	ListCell *placementStateCell = NULL;
-	bool cachedShardStateFound = false;
-	bool firstTupleInShard = false;
-
-
 	EState *executorState = copyDest->executorState;
 	MemoryContext executorTupleContext = GetPerTupleMemoryContext(executorState);
 	MemoryContext oldContext = MemoryContextSwitchTo(executorTupleContext);
@@ -2284,20 +2667,132 @@ CitusSendTupleToPlacements(TupleTableSlot *slot, CitusCopyDestReceiver *copyDest
 	bool isColocatedIntermediateResult =
 		copyDest->colocatedIntermediateResultIdPrefix != NULL;
 
-	CopyShardState *shardState = GetShardState(shardId, copyDest->shardStateHash,
-											   copyDest->connectionStateHash,
-											   &cachedShardStateFound,
-											   copyDest->shouldUseLocalCopy,
-											   copyDest->copyOutState,
-											   isColocatedIntermediateResult,
-											   copyDest->isPublishable);
+	bool firstTupleInShard = false;
+	CopyShardState *shardState = GetShardStateForRow(copyDest, shardId,
+													 &firstTupleInShard);
+
+	if (isColocatedIntermediateResult && copyDest->shouldUseLocalCopy &&
+		shardState->containsLocalPlacement)
+	{
+		if (firstTupleInShard)
+		{
+			CreateLocalColocatedIntermediateFile(copyDest, shardState);
+		}
+
+		WriteTupleToLocalFile(slot, copyDest, shardId,
+							  shardState->copyOutState, &shardState->fileDest);
+	}
+	else if (copyDest->shouldUseLocalCopy && shardState->containsLocalPlacement)
+	{
+		WriteTupleToLocalShard(slot, copyDest, shardId, shardState->copyOutState);
+	}
+
+	SendCopyRowToPlacements(copyDest, shardState, columnValues, columnNulls, NULL);
+
+	MemoryContextSwitchTo(oldContext);
+
+	copyDest->tuplesSent++;
+
+	/*
+	 * Release per tuple memory allocated in this function. If we're writing
+	 * the results of an INSERT ... SELECT then the SELECT execution will use
+	 * its own executor state and reset the per tuple expression context
+	 * separately.
+	 */
+	ResetPerTupleExprContext(executorState);
+
+	return true;
+}
+
+
+/*
+ * CitusCopyDestReceiverSendRawRow sends a row that is already serialized in
+ * the COPY format of the destination receiver to the placements of the given
+ * shard. This allows the rows to be serialized and routed by other processes,
+ * such as the parallel workers that copy local data into shards.
+ *
+ * Rows cannot be written to local placements in this way, so callers should
+ * only use it when none of the placements are local.
+ */
+void
+CitusCopyDestReceiverSendRawRow(CitusCopyDestReceiver *copyDest, int64 shardId,
+								StringInfo rowData)
+{
+	PG_TRY();
+	{
+		CitusSendRawRowToPlacements(copyDest, shardId, rowData);
+	}
+	PG_CATCH();
+	{
+		/*
+		 * We might be able to recover from errors with ROLLBACK TO SAVEPOINT,
+		 * so unclaim the connections before throwing errors.
+		 */
+		List *connectionStateList = ConnectionStateList(copyDest->connectionStateHash);
+		UnclaimCopyConnections(connectionStateList);
+
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+
+/*
+ * CitusSendRawRowToPlacements sends the given serialized row to the shard
+ * placement(s) of the given shard.
+ */
+static void
+CitusSendRawRowToPlacements(CitusCopyDestReceiver *copyDest, int64 shardId,
+							StringInfo rowData)
+{
+	/* connections hash is kept in memory context */
+	MemoryContext oldContext = MemoryContextSwitchTo(copyDest->memoryContext);
+
+	bool firstTupleInShard = false;
+	CopyShardState *shardState = GetShardStateForRow(copyDest, shardId,
+													 &firstTupleInShard);
 
-	if (!cachedShardStateFound)
+	if ((copyDest->shouldUseLocalCopy && shardState->containsLocalPlacement) ||
+		copyDest->colocatedIntermediateResultIdPrefix != NULL)
 	{
-		firstTupleInShard = true;
+		ereport(ERROR, (errmsg("cannot send serialized rows to shard " INT64_FORMAT,
+							   shardId),
+						errdetail("Serialized rows can only be sent to remote "
+								  "shard placements.")));
 	}
 
-	if (firstTupleInShard && !copyDest->multiShardCopy &&
+	SendCopyRowToPlacements(copyDest, shardState, NULL, NULL, rowData);
+
+	MemoryContextSwitchTo(oldContext);
+
+	copyDest->tuplesSent++;
+}
+
+
+/*
+ * GetShardStateForRow returns the copy state of the given shard, initializing
+ * it if this is the first row that is sent to the shard. It also marks the
+ * COPY as a parallel modification once rows are sent to multiple shards.
+ */
+static CopyShardState *
+GetShardStateForRow(CitusCopyDestReceiver *copyDest, int64 shardId,
+					bool *firstTupleInShard)
+{
+	bool cachedShardStateFound = false;
+	bool isColocatedIntermediateResult =
+		copyDest->colocatedIntermediateResultIdPrefix != NULL;
+
+	CopyShardState *shardState = GetShardState(shardId, copyDest->shardStateHash,
+											   copyDest->connectionStateHash,
+											   &cachedShardStateFound,
+											   copyDest->shouldUseLocalCopy,
+											   copyDest->copyOutState,
+											   isColocatedIntermediateResult,
+											   copyDest->isPublishable);
+
+	*firstTupleInShard = !cachedShardStateFound;
+
+	if (*firstTupleInShard && !copyDest->multiShardCopy &&
 		hash_get_num_entries(copyDest->shardStateHash) == 2)
 	{
 		Oid relationId = copyDest->distributedRelationId;
@@ -2312,21 +2807,26 @@ CitusSendTupleToPlacements(TupleTableSlot *slot, CitusCopyDestReceiver *copyDest
 		}
 	}
 
-	if (isColocatedIntermediateResult && copyDest->shouldUseLocalCopy &&
-		shardState->containsLocalPlacement)
-	{
-		if (firstTupleInShard)
-		{
-			CreateLocalColocatedIntermediateFile(copyDest, shardState);
-		}
+	return shardState;
+}
 
-		WriteTupleToLocalFile(slot, copyDest, shardId,
-							  shardState->copyOutState, &shardState->fileDest);
-	}
-	else if (copyDest->shouldUseLocalCopy && shardState->containsLocalPlacement)
-	{
-		WriteTupleToLocalShard(slot, copyDest, shardId, shardState->copyOutState);
-	}
+
+/*
+ * SendCopyRowToPlacements sends a row to the remote placements of the given
+ * shard. The row is either given as column values, which are serialized for
+ * each placement, or as rawRowData that is already serialized.
+ */
+static void
+SendCopyRowToPlacements(CitusCopyDestReceiver *copyDest, CopyShardState *shardState,
+						Datum *columnValues, bool *columnNulls, StringInfo rawRowData)
+{
+	TupleDesc tupleDescriptor = copyDest->tupleDescriptor;
+	CopyStmt *copyStatement = copyDest->copyStatement;
+	CopyOutState copyOutState = copyDest->copyOutState;
+	FmgrInfo *columnOutputFunctions = copyDest->columnOutputFunctions;
+	CopyCoercionData *columnCoercionPaths = copyDest->columnCoercionPaths;
+	uint64 shardId = shardState->shardId;
+	ListCell *placementStateCell = NULL;
 
 	foreach(placementStateCell, shardState->placementStateList)
 	{
@@ -2372,13 +2872,21 @@ CitusSendTupleToPlacements(TupleTableSlot *slot, CitusCopyDestReceiver *copyDest
 		else if (currentPlacementState != activePlacementState)
 		{
 			/* buffer data */
-			StringInfo copyBuffer = copyOutState->fe_msgbuf;
-			resetStringInfo(copyBuffer);
-			AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
-							  copyOutState, columnOutputFunctions,
-							  columnCoercionPaths);
-			appendBinaryStringInfo(currentPlacementState->data, copyBuffer->data,
-								   copyBuffer->len);
+			if (rawRowData != NULL)
+			{
+				appendBinaryStringInfo(currentPlacementState->data, rawRowData->data,
+									   rawRowData->len);
+			}
+			else
+			{
+				StringInfo copyBuffer = copyOutState->fe_msgbuf;
+				resetStringInfo(copyBuffer);
+				AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
+								  copyOutState, columnOutputFunctions,
+								  columnCoercionPaths);
+				appendBinaryStringInfo(currentPlacementState->data, copyBuffer->data,
+									   copyBuffer->len);
+			}
 		}
 		else
 		{
@@ -2388,27 +2896,22 @@ CitusSendTupleToPlacements(TupleTableSlot *slot, CitusCopyDestReceiver *copyDest
 
 		if (sendTupleOverConnection)
 		{
-			resetStringInfo(copyOutState->fe_msgbuf);
-			AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
-							  copyOutState, columnOutputFunctions, columnCoercionPaths);
-			SendCopyDataToPlacement(copyOutState->fe_msgbuf, shardId,
-									connectionState->connection);
+			if (rawRowData != NULL)
+			{
+				SendCopyDataToPlacement(rawRowData, shardId,
+										connectionState->connection);
+			}
+			else
+			{
+				resetStringInfo(copyOutState->fe_msgbuf);
+				AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
+								  copyOutState, columnOutputFunctions,
+								  columnCoercionPaths);
+				SendCopyDataToPlacement(copyOutState->fe_msgbuf, shardId,
+										connectionState->connection);
+			}
 		}
 	}
-
-	MemoryContextSwitchTo(oldContext);
-
-	copyDest->tuplesSent++;
-
-	/*
-	 * Release per tuple memory allocated in this function. If we're writing
-	 * the results of an INSERT ... SELECT then the SELECT execution will use
-	 * its own executor state and reset the per tuple expression context
-	 * separately.
-	 */
-	ResetPerTupleExprContext(executorState);
-
-	return true;
 }
 
 
@@ -2823,6 +3326,26 @@ CopyStatementHasFormat(CopyStmt *copyStatement, char *formatName)
 }
 
 
+/*
+ * CopyStatementHasHeader returns whether the COPY statement asks for a header
+ * line.
+ */
+static bool
+CopyStatementHasHeader(CopyStmt *copyStatement)
+{
+	DefElem *option = NULL;
+	foreach_ptr(option, copyStatement->options)
+	{
+		if (strcmp(option->defname, "header") == 0)
+		{
+			return defGetBoolean(option);
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * ProcessCopyStmt handles Citus specific concerns for COPY like supporting
  * COPYing from distributed tables and preventing unsupported actions. The
@@ -2853,6 +3376,16 @@ ProcessCopyStmt(CopyStmt *copyStatement, QueryCompletion *completionTag, const
 		return NULL;
 	}
 
+	/*
+	 * Handle COPY shard FROM STDIN WITH (compression '<method>') commands,
+	 * which are sent by other nodes to copy shards in a compressed stream.
+	 */
+	if (IsCompressedShardCopyStmt(copyStatement))
+	{
+		ReceiveCompressedShardCopy(copyStatement, completionTag);
+		return NULL;
+	}
+
 	/*
 	 * We check whether a distributed relation is affected. For that, we need to open the
 	 * relation. To prevent race conditions with later lookups, lock the table, and modify
@@ -2928,6 +3461,21 @@ ProcessCopyStmt(CopyStmt *copyStatement, QueryCompletion *completionTag, const
 			}
 		}
 	}
+	else if (copyStatement->query != NULL && !copyStatement->is_from &&
+			 copyStatement->filename == NULL && !copyStatement->is_program &&
+			 !CopyStatementHasFormat(copyStatement, "binary") &&
+			 MaxCopyToConnections > 1)
+	{
+		/*
+		 * COPY (query) TO STDOUT on a distributed query of which the results
+		 * do not need to be combined on the coordinator is streamed from the
+		 * shards like COPY table TO STDOUT.
+		 */
+		if (CitusCopyQueryTo(copyStatement, queryString, completionTag))
+		{
+			return NULL;
+		}
+	}
 	return (Node *) copyStatement;
 }
 
@@ -2979,13 +3527,13 @@ CitusCopySelect(CopyStmt *copyStatement)
 
 /*
  * CitusCopyTo runs a COPY .. TO STDOUT command on each shard to do a full
- * table dump.
+ * table dump. The commands run concurrently over up to
+ * citus.max_copy_to_connections connections.
  */
 static void
 CitusCopyTo(CopyStmt *copyStatement, QueryCompletion *completionTag)
 {
-	ListCell *shardIntervalCell = NULL;
-	int64 tuplesSent = 0;
+	List *fetchList = NIL;
 
 	Relation distributedRelation = table_openrv(copyStatement->relation, AccessShareLock);
 	Oid relationId = RelationGetRelid(distributedRelation);
@@ -2997,121 +3545,578 @@ CitusCopyTo(CopyStmt *copyStatement, QueryCompletion *completionTag)
 	copyOutState->attnumlist = CopyGetAttnums(tupleDescriptor, distributedRelation,
 											  copyStatement->attlist);
 
+	bool headerRequested = CopyStatementHasHeader(copyStatement);
+
 	SendCopyBegin(copyOutState);
 
 	List *shardIntervalList = LoadShardIntervalList(relationId);
 
-	foreach(shardIntervalCell, shardIntervalList)
+	ShardInterval *shardInterval = NULL;
+	foreach_ptr(shardInterval, shardIntervalList)
 	{
-		ShardInterval *shardInterval = lfirst(shardIntervalCell);
 		List *shardPlacementList = ActiveShardPlacementList(shardInterval->shardId);
-		ListCell *shardPlacementCell = NULL;
-		int placementIndex = 0;
 
-		StringInfo copyCommand = ConstructCopyStatement(copyStatement,
-														shardInterval->shardId);
+		if (shardPlacementList != NIL)
+		{
+			ShardPlacement *shardPlacement = linitial(shardPlacementList);
+			ShardPlacementAccess *placementAccess =
+				CreatePlacementAccess(shardPlacement, PLACEMENT_ACCESS_SELECT);
+
+			CopyToFetch *fetch = palloc0(sizeof(CopyToFetch));
+			fetch->copyCommand = ConstructCopyStatement(copyStatement,
+														shardInterval->shardId)->data;
+			fetch->placementAccessList = list_make1(placementAccess);
+			fetch->bufferedData = makeStringInfo();
+
+			fetchList = lappend(fetchList, fetch);
+		}
 
-		foreach(shardPlacementCell, shardPlacementList)
+		if (shardInterval == linitial(shardIntervalList))
 		{
-			ShardPlacement *shardPlacement = lfirst(shardPlacementCell);
-			int connectionFlags = 0;
-			char *userName = NULL;
-			const bool raiseErrors = true;
+			/* remove header after the first shard */
+			copyStatement->options =
+				RemoveOptionFromList(copyStatement->options, "header");
+		}
+	}
 
-			MultiConnection *connection = GetPlacementConnection(connectionFlags,
-																 shardPlacement,
-																 userName);
+	int64 tuplesSent = ForwardCopyDataFromShards(copyOutState, fetchList,
+												 headerRequested);
 
-			/*
-			 * This code-path doesn't support optional connections, so we don't expect
-			 * NULL connections.
-			 */
-			Assert(connection != NULL);
+	SendCopyEnd(copyOutState);
+
+	table_close(distributedRelation, AccessShareLock);
+
+	if (completionTag != NULL)
+	{
+		CompleteCopyQueryTagCompat(completionTag, tuplesSent);
+	}
+}
+
+
+/*
+ * CitusCopyQueryTo runs a COPY (query) TO STDOUT by running a COPY of the
+ * query of each task of its distributed plan on the workers and forwarding
+ * the output to the client as it arrives, instead of collecting the result
+ * of the query on the coordinator. This is only possible when the results of
+ * the tasks do not need to be combined in any way.
+ *
+ * Returns false without sending anything if the query cannot be copied this
+ * way, in which case it should be run as a regular COPY.
+ */
+static bool
+CitusCopyQueryTo(CopyStmt *copyStatement, const char *queryString,
+				 QueryCompletion *completionTag)
+{
+	/* the worker queries do not have the column names of the query */
+	if (CopyStatementHasHeader(copyStatement))
+	{
+		return false;
+	}
+
+	RawStmt *rawStmt = makeNode(RawStmt);
+	rawStmt->stmt = copyObject(copyStatement->query);
+	rawStmt->stmt_location = -1;
+	rawStmt->stmt_len = 0;
+
+	Query *query = RewriteRawQueryStmt(rawStmt, queryString, NULL, 0);
+	if (query->commandType != CMD_SELECT || query->utilityStmt != NULL ||
+		query->hasModifyingCTE || query->rowMarks != NIL || query->hasRowSecurity ||
+		!NeedsDistributedPlanning(query))
+	{
+		return false;
+	}
+
+	PlannedStmt *plannedStmt = pg_plan_query(query, queryString,
+											 CURSOR_OPT_PARALLEL_OK, NULL);
+
+	List *taskList = CopyQueryToTaskList(plannedStmt);
+	if (taskList == NIL)
+	{
+		/* the regular COPY plans the query again */
+		return false;
+	}
+
+	/* the executor would check permissions on the range table of the plan */
+#if PG_VERSION_NUM >= PG_VERSION_16
+	ExecCheckPermissions(plannedStmt->rtable, plannedStmt->permInfos, true);
+#else
+	ExecCheckRTPerms(plannedStmt->rtable, true);
+#endif
+
+	RecordParallelRelationAccessForTaskList(taskList);
+
+	StringInfo copyOptions = makeStringInfo();
+	AppendCopyOptions(copyOptions, copyStatement->options);
+
+	List *fetchList = NIL;
+	Task *task = NULL;
+	foreach_ptr(task, taskList)
+	{
+		ShardPlacement *taskPlacement = linitial(task->taskPlacementList);
+
+		CopyToFetch *fetch = palloc0(sizeof(CopyToFetch));
+		fetch->copyCommand = psprintf("COPY (%s) TO STDOUT%s", TaskQueryString(task),
+									  copyOptions->data);
+		fetch->placementAccessList = PlacementAccessListForTask(task, taskPlacement);
+		fetch->bufferedData = makeStringInfo();
+
+		fetchList = lappend(fetchList, fetch);
+	}
+
+	CustomScan *customScan = (CustomScan *) plannedStmt->planTree;
+
+	CopyOutState copyOutState = (CopyOutState) palloc0(sizeof(CopyOutStateData));
+	copyOutState->fe_msgbuf = makeStringInfo();
+	copyOutState->binary = false;
+
+	int columnCount = list_length(customScan->scan.plan.targetlist);
+	for (int columnNumber = 1; columnNumber <= columnCount; columnNumber++)
+	{
+		copyOutState->attnumlist = lappend_int(copyOutState->attnumlist, columnNumber);
+	}
+
+	SendCopyBegin(copyOutState);
+
+	bool headerRequested = false;
+	int64 tuplesSent = ForwardCopyDataFromShards(copyOutState, fetchList,
+												 headerRequested);
 
-			if (placementIndex == list_length(shardPlacementList) - 1)
+	SendCopyEnd(copyOutState);
+
+	if (completionTag != NULL)
+	{
+		CompleteCopyQueryTagCompat(completionTag, tuplesSent);
+	}
+
+	return true;
+}
+
+
+/*
+ * CopyQueryToTaskList returns the tasks of the given plan if the plan only
+ * consists of a distributed query of which the results of the tasks can be
+ * sent to the client as is, or NIL otherwise.
+ */
+static List *
+CopyQueryToTaskList(PlannedStmt *plannedStmt)
+{
+	Plan *planTree = plannedStmt->planTree;
+
+	/* anything on top of the scan, like a sort or a limit, needs the coordinator */
+	if (!IsCitusCustomScan(planTree) || planTree->qual != NIL ||
+		planTree->initPlan != NIL || plannedStmt->subplans != NIL)
+	{
+		return NIL;
+	}
+
+	DistributedPlan *distributedPlan = GetDistributedPlan((CustomScan *) planTree);
+	Job *workerJob = distributedPlan->workerJob;
+
+	if (distributedPlan->planningError != NULL ||
+		distributedPlan->modLevel != ROW_MODIFY_READONLY ||
+		distributedPlan->subPlanList != NIL ||
+		distributedPlan->repartitionedAggregateQuery != NULL ||
+		workerJob == NULL || workerJob->dependentJobList != NIL ||
+		workerJob->deferredPruning || workerJob->taskList == NIL)
+	{
+		return NIL;
+	}
+
+	/* the scan should output the columns of the worker query in order */
+	List *scanTargetList = planTree->targetlist;
+	List *jobTargetList = workerJob->jobQuery->targetList;
+	if (list_length(scanTargetList) != list_length(jobTargetList))
+	{
+		return NIL;
+	}
+
+	TargetEntry *targetEntry = NULL;
+	foreach_ptr(targetEntry, scanTargetList)
+	{
+		if (targetEntry->resjunk || !IsA(targetEntry->expr, Var) ||
+			((Var *) targetEntry->expr)->varattno != targetEntry->resno)
+		{
+			return NIL;
+		}
+	}
+
+	foreach_ptr(targetEntry, jobTargetList)
+	{
+		if (targetEntry->resjunk)
+		{
+			return NIL;
+		}
+	}
+
+	/* tasks on the local node would not see writes done by local execution */
+	if (GetCurrentLocalExecutionStatus() == LOCAL_EXECUTION_REQUIRED ||
+		AnyTaskAccessesLocalNode(workerJob->taskList))
+	{
+		return NIL;
+	}
+
+	Task *task = NULL;
+	foreach_ptr(task, workerJob->taskList)
+	{
+		if (task->taskType != READ_TASK || task->queryCount != 1 ||
+			task->taskPlacementList == NIL)
+		{
+			return NIL;
+		}
+	}
+
+	return workerJob->taskList;
+}
+
+
+/*
+ * CopyToOutputSettingsCommand returns SET LOCAL commands that give the
+ * settings which affect the output of COPY .. TO STDOUT the values they have
+ * on this node. The commands are sent in the same query string as the COPY,
+ * such that they also apply outside of a transaction block.
+ */
+static char *
+CopyToOutputSettingsCommand(void)
+{
+	StringInfo command = makeStringInfo();
+
+	for (int settingIndex = 0; settingIndex < lengthof(CopyToOutputSettings);
+		 settingIndex++)
+	{
+		const char *settingName = CopyToOutputSettings[settingIndex];
+		bool missingOk = false;
+		bool restrictPrivileged = false;
+		const char *settingValue = GetConfigOption(settingName, missingOk,
+												   restrictPrivileged);
+
+		appendStringInfo(command, "SET LOCAL %s TO %s;", settingName,
+						 quote_literal_cstr(settingValue));
+	}
+
+	return command->data;
+}
+
+
+/*
+ * ForwardCopyDataFromShards runs the COPY .. TO STDOUT commands of the given
+ * fetches concurrently over up to citus.max_copy_to_connections connections
+ * and forwards the copy data to the client as it arrives. Returns the number
+ * of rows sent.
+ *
+ * If citus.copy_to_preserve_shard_order is enabled, the output of each fetch
+ * is sent after the output of the fetches before it, and the fetches that run
+ * ahead buffer a limited amount of data. Otherwise, only the header of the
+ * first fetch, if requested, is sent before anything else.
+ */
+static int64
+ForwardCopyDataFromShards(CopyOutState copyOutState, List *fetchList,
+						  bool headerRequested)
+{
+	int fetchCount = list_length(fetchList);
+	int maxConnectionCount = MaxCopyToConnections;
+	int nextFetchIndex = 0;
+	int activeFetchCount = 0;
+	int64 tuplesSent = 0;
+
+	CopyToFetchState fetchState;
+	fetchState.fetchArray = palloc0(Max(fetchCount, 1) * sizeof(CopyToFetch *));
+	fetchState.headFetchIndex = 0;
+	fetchState.headerPending = headerRequested;
+
+	if (MultiShardConnectionType == SEQUENTIAL_CONNECTION)
+	{
+		/* the user asked to access shards one at a time */
+		maxConnectionCount = 1;
+	}
+
+	/*
+	 * The workers format the values, so they need to use the settings of the
+	 * coordinator to give the same output as a COPY on the coordinator.
+	 */
+	char *outputSettingsCommand = CopyToOutputSettingsCommand();
+
+	int fetchIndex = 0;
+	CopyToFetch *fetch = NULL;
+	foreach_ptr(fetch, fetchList)
+	{
+		fetch->copyCommand = psprintf("%s%s", outputSettingsCommand,
+									  fetch->copyCommand);
+		fetchState.fetchArray[fetchIndex++] = fetch;
+	}
+
+	/*
+	 * Find the connections that need to be used for placements that were
+	 * already accessed in this transaction before we claim any connections,
+	 * since claimed connections that modified placements cannot be found.
+	 */
+	foreach_ptr(fetch, fetchList)
+	{
+		fetch->requiredConnection =
+			GetConnectionIfPlacementAccessedInXact(0, fetch->placementAccessList, NULL);
+	}
+
+	while (fetchState.headFetchIndex < fetchCount)
+	{
+		/* start the commands of the next shards while there are connections to spare */
+		while (nextFetchIndex < fetchCount)
+		{
+			int fetchesInProgress = CopyToPreserveShardOrder ?
+									nextFetchIndex - fetchState.headFetchIndex :
+									activeFetchCount;
+			if (fetchesInProgress >= maxConnectionCount)
 			{
-				/* last chance for this shard */
-				MarkRemoteTransactionCritical(connection);
+				break;
 			}
 
-			if (PQstatus(connection->pgConn) != CONNECTION_OK)
+			bool optionalConnection = activeFetchCount > 0;
+			if (!StartCopyToFetch(fetchState.fetchArray[nextFetchIndex],
+								  optionalConnection))
 			{
-				ReportConnectionError(connection, ERROR);
-				continue;
+				break;
 			}
 
-			RemoteTransactionBeginIfNecessary(connection);
+			nextFetchIndex++;
+			activeFetchCount++;
+		}
+
+		bool madeProgress = false;
+
+		for (fetchIndex = fetchState.headFetchIndex; fetchIndex < nextFetchIndex;
+			 fetchIndex++)
+		{
+			fetch = fetchState.fetchArray[fetchIndex];
+			bool forwardData = CanForwardCopyToFetch(&fetchState, fetchIndex);
+
+			if (forwardData && fetch->bufferedData->len > 0)
+			{
+				CopySendData(copyOutState, fetch->bufferedData->data,
+							 fetch->bufferedData->len);
+				CopySendEndOfRow(copyOutState, false);
+
+				tuplesSent += fetch->bufferedRowCount;
+				resetStringInfo(fetch->bufferedData);
+				fetch->bufferedRowCount = 0;
+				madeProgress = true;
+			}
 
-			if (!SendRemoteCommand(connection, copyCommand->data))
+			if (fetch->done)
 			{
-				ReportConnectionError(connection, ERROR);
 				continue;
 			}
 
-			PGresult *result = GetRemoteCommandResult(connection, raiseErrors);
-			if (PQresultStatus(result) != PGRES_COPY_OUT)
+			if (ReceiveCopyToFetchData(&fetchState, fetchIndex, copyOutState,
+									   &tuplesSent))
 			{
-				ReportResultError(connection, result, ERROR);
+				madeProgress = true;
 			}
 
-			PQclear(result);
+			if (fetch->done)
+			{
+				activeFetchCount--;
+				madeProgress = true;
+			}
+		}
 
-			tuplesSent += ForwardCopyDataFromConnection(copyOutState, connection);
+		/* skip over the fetches of which all data was sent */
+		while (fetchState.headFetchIndex < nextFetchIndex)
+		{
+			fetch = fetchState.fetchArray[fetchState.headFetchIndex];
+			if (!fetch->done || fetch->bufferedData->len > 0)
+			{
+				break;
+			}
 
-			break;
+			fetchState.headFetchIndex++;
+			fetchState.headerPending = false;
 		}
 
-		if (shardIntervalCell == list_head(shardIntervalList))
+		if (!madeProgress && fetchState.headFetchIndex < fetchCount)
 		{
-			/* remove header after the first shard */
-			copyStatement->options =
-				RemoveOptionFromList(copyStatement->options, "header");
+			WaitForCopyToFetches(&fetchState, nextFetchIndex);
 		}
+
+		CHECK_FOR_INTERRUPTS();
 	}
 
-	SendCopyEnd(copyOutState);
+	return tuplesSent;
+}
 
-	table_close(distributedRelation, AccessShareLock);
 
-	if (completionTag != NULL)
+/*
+ * StartCopyToFetch sends the COPY command of the given fetch over a connection
+ * to its placement. If optionalConnection is set and no connection is
+ * available right now, the function returns false.
+ */
+static bool
+StartCopyToFetch(CopyToFetch *fetch, bool optionalConnection)
+{
+	int connectionFlags = optionalConnection ? OPTIONAL_CONNECTION : 0;
+	char *userName = NULL;
+
+	/* wait for the connection that accessed the placement to become available */
+	if (optionalConnection && fetch->requiredConnection != NULL &&
+		fetch->requiredConnection->claimedExclusively)
 	{
-		CompleteCopyQueryTagCompat(completionTag, tuplesSent);
+		return false;
 	}
+
+	MultiConnection *connection =
+		StartPlacementListConnection(connectionFlags, fetch->placementAccessList,
+									 userName);
+	if (connection == NULL)
+	{
+		/* an optional connection could not be opened */
+		return false;
+	}
+
+	FinishConnectionEstablishment(connection);
+
+	if (PQstatus(connection->pgConn) != CONNECTION_OK)
+	{
+		ReportConnectionError(connection, ERROR);
+	}
+
+	ClaimConnectionExclusively(connection);
+	MarkRemoteTransactionCritical(connection);
+	RemoteTransactionBeginIfNecessary(connection);
+
+	if (!SendRemoteCommand(connection, fetch->copyCommand))
+	{
+		ReportConnectionError(connection, ERROR);
+	}
+
+	fetch->connection = connection;
+
+	return true;
 }
 
 
 /*
- * ForwardCopyDataFromConnection forwards copy data received over the given connection
- * to the client or file descriptor.
+ * CanForwardCopyToFetch returns whether the data of the fetch at the given
+ * index can be sent to the client right away.
  */
-static int64
-ForwardCopyDataFromConnection(CopyOutState copyOutState, MultiConnection *connection)
+static bool
+CanForwardCopyToFetch(CopyToFetchState *fetchState, int fetchIndex)
+{
+	if (CopyToPreserveShardOrder)
+	{
+		return fetchIndex == fetchState->headFetchIndex;
+	}
+
+	/* the header comes from the first fetch */
+	return !fetchState->headerPending || fetchIndex == 0;
+}
+
+
+/*
+ * ReceiveCopyToFetchData receives the copy data that is available on the
+ * connection of the fetch at the given index without blocking. The data is
+ * sent to the client if possible, or buffered otherwise until the buffer is
+ * full. Returns whether any data was received.
+ */
+static bool
+ReceiveCopyToFetchData(CopyToFetchState *fetchState, int fetchIndex,
+					   CopyOutState copyOutState, int64 *tuplesSent)
 {
-	char *receiveBuffer = NULL;
-	const int useAsync = 0;
+	CopyToFetch *fetch = fetchState->fetchArray[fetchIndex];
+	MultiConnection *connection = fetch->connection;
+	PGconn *pgConn = connection->pgConn;
 	bool raiseErrors = true;
-	int64 tuplesSent = 0;
+	bool receivedData = false;
 
-	/* receive copy data message in a synchronous manner */
-	int receiveLength = PQgetCopyData(connection->pgConn, &receiveBuffer, useAsync);
-	while (receiveLength > 0)
+	if (PQflush(pgConn) == -1 || PQconsumeInput(pgConn) == 0)
 	{
-		bool includeEndOfLine = false;
+		ReportConnectionError(connection, ERROR);
+	}
 
-		CopySendData(copyOutState, receiveBuffer, receiveLength);
-		CopySendEndOfRow(copyOutState, includeEndOfLine);
-		tuplesSent++;
+	/* skip over the results of the SET commands that precede the COPY */
+	while (!fetch->copyStarted)
+	{
+		if (PQisBusy(pgConn))
+		{
+			return false;
+		}
 
-		PQfreemem(receiveBuffer);
+		PGresult *result = GetRemoteCommandResult(connection, raiseErrors);
+		ExecStatusType resultStatus = PQresultStatus(result);
+		if (resultStatus == PGRES_COPY_OUT)
+		{
+			fetch->copyStarted = true;
+		}
+		else if (resultStatus != PGRES_COMMAND_OK)
+		{
+			ReportResultError(connection, result, ERROR);
+		}
 
-		receiveLength = PQgetCopyData(connection->pgConn, &receiveBuffer, useAsync);
+		PQclear(result);
 	}
 
-	if (receiveLength != -1)
+	while (true)
 	{
-		ReportConnectionError(connection, ERROR);
+		bool forwardData = CanForwardCopyToFetch(fetchState, fetchIndex);
+		if (!forwardData && fetch->bufferedData->len >= COPY_TO_FETCH_BUFFER_SIZE)
+		{
+			/* stop reading until the buffer can be sent */
+			break;
+		}
+
+		char *receiveBuffer = NULL;
+		const int useAsync = 1;
+
+		int receiveLength = PQgetCopyData(pgConn, &receiveBuffer, useAsync);
+		if (receiveLength == 0)
+		{
+			/* no complete row is available yet */
+			break;
+		}
+		else if (receiveLength == -1)
+		{
+			FinishCopyToFetch(fetch);
+			break;
+		}
+		else if (receiveLength < 0)
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+
+		if (forwardData)
+		{
+			bool includeEndOfLine = false;
+
+			CopySendData(copyOutState, receiveBuffer, receiveLength);
+			CopySendEndOfRow(copyOutState, includeEndOfLine);
+			(*tuplesSent)++;
+
+			if (fetchIndex == 0)
+			{
+				/* the header, if any, is the first row of the first fetch */
+				fetchState->headerPending = false;
+			}
+		}
+		else
+		{
+			appendBinaryStringInfo(fetch->bufferedData, receiveBuffer, receiveLength);
+			fetch->bufferedRowCount++;
+		}
+
+		PQfreemem(receiveBuffer);
+		receivedData = true;
 	}
 
+	return receivedData;
+}
+
+
+/*
+ * FinishCopyToFetch reads the result of the COPY command of the given fetch
+ * after all copy data was received and releases its connection.
+ */
+static void
+FinishCopyToFetch(CopyToFetch *fetch)
+{
+	MultiConnection *connection = fetch->connection;
+	bool raiseErrors = true;
+
 	PGresult *result = GetRemoteCommandResult(connection, raiseErrors);
 	if (!IsResponseOK(result))
 	{
@@ -3121,7 +4126,76 @@ ForwardCopyDataFromConnection(CopyOutState copyOutState, MultiConnection *connec
 	PQclear(result);
 	ClearResults(connection, raiseErrors);
 
-	return tuplesSent;
+	UnclaimConnection(connection);
+
+	fetch->connection = NULL;
+	fetch->done = true;
+}
+
+
+/*
+ * WaitForCopyToFetches waits until data arrives on any of the connections of
+ * the started fetches from which we are reading.
+ */
+static void
+WaitForCopyToFetches(CopyToFetchState *fetchState, int startedFetchCount)
+{
+	int eventSetSize = startedFetchCount - fetchState->headFetchIndex + 2;
+	WaitEventSet *waitEventSet = CreateWaitEventSet(CurrentMemoryContext, eventSetSize);
+	WaitEvent *events = palloc0(eventSetSize * sizeof(WaitEvent));
+
+	for (int fetchIndex = fetchState->headFetchIndex; fetchIndex < startedFetchCount;
+		 fetchIndex++)
+	{
+		CopyToFetch *fetch = fetchState->fetchArray[fetchIndex];
+		if (fetch->done ||
+			(!CanForwardCopyToFetch(fetchState, fetchIndex) &&
+			 fetch->bufferedData->len >= COPY_TO_FETCH_BUFFER_SIZE))
+		{
+			continue;
+		}
+
+		PGconn *pgConn = fetch->connection->pgConn;
+		int eventMask = WL_SOCKET_READABLE;
+
+		if (PQflush(pgConn) == 1)
+		{
+			/* the command was not fully sent yet */
+			eventMask |= WL_SOCKET_WRITEABLE;
+		}
+
+		int waitEventSetIndex =
+			CitusAddWaitEventSetToSet(waitEventSet, eventMask, PQsocket(pgConn),
+									  NULL, (void *) fetch);
+		if (waitEventSetIndex == WAIT_EVENT_SET_INDEX_FAILED)
+		{
+			ReportConnectionError(fetch->connection, ERROR);
+		}
+	}
+
+	AddWaitEventToSet(waitEventSet, WL_POSTMASTER_DEATH, PGINVALID_SOCKET, NULL, NULL);
+	AddWaitEventToSet(waitEventSet, WL_LATCH_SET, PGINVALID_SOCKET, MyLatch, NULL);
+
+	int eventCount = WaitEventSetWait(waitEventSet, -1, events, eventSetSize,
+									  WAIT_EVENT_CLIENT_READ);
+
+	for (int eventIndex = 0; eventIndex < eventCount; eventIndex++)
+	{
+		WaitEvent *event = &events[eventIndex];
+
+		if (event->events & WL_POSTMASTER_DEATH)
+		{
+			ereport(ERROR, (errmsg("postmaster was shut down, exiting")));
+		}
+
+		if (event->events & WL_LATCH_SET)
+		{
+			ResetLatch(MyLatch);
+		}
+	}
+
+	FreeWaitEventSet(waitEventSet);
+	pfree(events);
 }
 
 
@@ -0,0 +1,1718 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallel_copy.c
+ *
+ * Copying data into the shards of a distributed table using parallel
+ * workers, both when distributing a local table and for COPY .. FROM.
+ *
+ * When a table with a lot of data is distributed, a single backend used to
+ * scan the table, compute the shard of every tuple and serialize it for the
+ * COPY into the shard, which made distributing the table CPU-bound. In
+ * parallel mode, parallel workers share a parallel scan of the local table.
+ * Each worker serializes the tuples of the blocks that it scans in the COPY
+ * format, hashes their distribution column values and sends batches of rows
+ * to the backend that distributes the table through a shared memory queue.
+ * The backend only finds the shard of every row and forwards it to the COPY
+ * into that shard.
+ *
+ * Similarly, a COPY .. FROM into a distributed table used to parse every
+ * row of the input in a single backend. In parallel mode, the backend only
+ * splits the input into lines and sends chunks of lines to the parallel
+ * workers, which parse the lines using the regular COPY machinery and send
+ * the serialized rows back in the same way.
+ *
+ * The COPY connections remain owned by the backend that runs the command,
+ * since the shards may have been created in its transaction and the data is
+ * committed by the same 2PC.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+
+#include "access/heapam.h"
+#include "access/parallel.h"
+#include "access/relscan.h"
+#include "access/tableam.h"
+#include "access/xact.h"
+#include "catalog/pg_proc.h"
+#include "commands/copyfrom_internal.h"
+#include "commands/progress.h"
+#include "executor/executor.h"
+#include "executor/tuptable.h"
+#include "libpq/pqformat.h"
+#include "mb/pg_wchar.h"
+#include "nodes/makefuncs.h"
+#include "optimizer/paths.h"
+#include "storage/bufmgr.h"
+#include "storage/latch.h"
+#include "storage/shm_mq.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+
+#include "pg_version_compat.h"
+
+#include "distributed/citus_ruleutils.h"
+#include "distributed/commands/multi_copy.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/metadata_utility.h"
+#include "distributed/multi_progress.h"
+#include "distributed/parallel_copy.h"
+#include "distributed/shardinterval_utils.h"
+#include "distributed/transmit.h"
+#include "distributed/tuplestore.h"
+
+
+/* keys of the parallel copy state in the dynamic shared memory segment */
+#define PARALLEL_COPY_KEY_SHARED UINT64CONST(0xC175C0F700000001)
+#define PARALLEL_COPY_KEY_SCAN UINT64CONST(0xC175C0F700000002)
+#define PARALLEL_COPY_KEY_QUEUES UINT64CONST(0xC175C0F700000003)
+#define PARALLEL_COPY_KEY_INPUT_QUEUES UINT64CONST(0xC175C0F700000004)
+#define PARALLEL_COPY_KEY_COPY_STATEMENT UINT64CONST(0xC175C0F700000005)
+
+/* size of the queues between each parallel worker and the leader */
+#define PARALLEL_COPY_QUEUE_SIZE (256 * 1024)
+
+/* rows and input lines are sent in batches of about this size */
+#define PARALLEL_COPY_BATCH_SIZE (64 * 1024)
+
+/* amount of COPY input that the leader reads at a time */
+#define PARALLEL_COPY_READ_SIZE (64 * 1024)
+
+
+/*
+ * ParallelCopyShared is the information that parallel workers need to
+ * serialize and hash rows of a distributed table.
+ */
+typedef struct ParallelCopyShared
+{
+	Oid relationId;
+	int partitionColumnIndex;
+	Oid hashFunctionId;
+	Oid partitionColumnCollation;
+	bool binaryCopyFormat;
+	bool skipJsonbValidation;
+} ParallelCopyShared;
+
+
+/*
+ * SerializedRowHeader precedes every row in a batch that a parallel worker
+ * sends to the leader.
+ */
+typedef struct SerializedRowHeader
+{
+	int32 hashValue;
+	int32 rowLength;
+} SerializedRowHeader;
+
+
+/*
+ * InputChunkHeader precedes every chunk of input lines that the leader sends
+ * to a parallel worker.
+ */
+typedef struct InputChunkHeader
+{
+	/* line number of the first line in the chunk, counted like COPY does */
+	uint64 firstLineNumber;
+} InputChunkHeader;
+
+
+/*
+ * ParallelCopyInputReader is used by the leader to read the input of a COPY
+ * .. FROM and split it into lines without parsing the fields of the lines,
+ * in the same way as CopyReadLineText.
+ */
+typedef struct ParallelCopyInputReader
+{
+	CopyFromState copyState;
+
+	/* input that was read from the source, of which readOffset was split */
+	char *readBuffer;
+	int readLength;
+	int readOffset;
+	bool receivedCopyDone;
+	bool reachedEndOfInput;
+	bool reachedEndOfData;
+
+	/* number of lines read, including lines within quoted CSV fields */
+	uint64 lineNumber;
+
+	bool csvMode;
+	char quoteChar;
+	char escapeChar;
+} ParallelCopyInputReader;
+
+
+/*
+ * SerializedRowWriter is used by parallel workers to serialize rows and send
+ * them to the leader in batches.
+ */
+typedef struct SerializedRowWriter
+{
+	ParallelCopyShared *shared;
+	TupleDesc tupleDescriptor;
+	CopyOutState copyOutState;
+	FmgrInfo *columnOutputFunctions;
+	FmgrInfo hashFunction;
+	shm_mq_handle *queueHandle;
+} SerializedRowWriter;
+
+
+/*
+ * SerializedRowReceiver keeps track of the queues from which the leader
+ * receives serialized rows and forwards them to the shards.
+ */
+typedef struct SerializedRowReceiver
+{
+	int workerCount;
+	shm_mq_handle **queueHandles;
+	bool *workerDone;
+	int activeWorkerCount;
+	CitusCopyDestReceiver *copyDest;
+	uint64 rowsCopied;
+} SerializedRowReceiver;
+
+
+/* GUC that determines the number of parallel workers used to copy local data */
+int MaxDistributeDataWorkers = 0;
+
+/* GUC that determines the number of parallel workers used to parse COPY input */
+int MaxParallelCopyWorkers = 0;
+
+/* input queue and current chunk of COPY input of a parallel worker */
+static shm_mq_handle *ParallelCopyInputQueue = NULL;
+static CopyFromState ParallelCopyInputState = NULL;
+static char *ParallelCopyInputChunk = NULL;
+static Size ParallelCopyInputChunkSize = 0;
+static Size ParallelCopyInputChunkOffset = 0;
+
+
+static void InitializeParallelCopyShared(ParallelCopyShared *shared, Oid relationId,
+										 CitusCopyDestReceiver *copyDest);
+static shm_mq_handle ** AttachLeaderQueues(ParallelContext *parallelContext,
+										   char *queueSpace, bool leaderIsReceiver);
+static shm_mq_handle * AttachWorkerQueue(dsm_segment *segment, char *queueSpace,
+										 bool workerIsReceiver);
+static void SetWorkerQueueHandles(ParallelContext *parallelContext,
+								  shm_mq_handle **queueHandles);
+static SerializedRowReceiver * CreateSerializedRowReceiver(ParallelContext *
+														   parallelContext,
+														   shm_mq_handle **queueHandles,
+														   CitusCopyDestReceiver *
+														   copyDest);
+static bool ReceiveSerializedRowBatches(SerializedRowReceiver *receiver);
+static void WaitForSerializedRows(void);
+static uint64 ReceiveSerializedRows(SerializedRowReceiver *receiver,
+									ParallelTableScanDesc parallelScan,
+									DistributeDataProgress *progress);
+static uint64 SendSerializedRowBatch(CitusCopyDestReceiver *copyDest,
+									 char *batchData, Size batchSize);
+static uint64 CopyLocalDataFromParallelScan(Relation localRelation,
+											ParallelTableScanDesc parallelScan,
+											CitusCopyDestReceiver *copyDest,
+											DistributeDataProgress *progress);
+static BlockNumber ParallelScanBlocksAllocated(ParallelTableScanDesc parallelScan);
+static bool InputFunctionsAreParallelSafe(TupleDesc tupleDescriptor);
+static CopyStmt * WorkerCopyStatement(CopyStmt *copyStatement);
+static bool CanSplitCopyInputIntoLines(CopyFromState copyState);
+static ParallelCopyInputReader * CreateParallelCopyInputReader(CopyFromState copyState);
+static bool ReadParallelCopyInputLine(ParallelCopyInputReader *reader, StringInfo line);
+static bool ReadEndOfDataMarker(ParallelCopyInputReader *reader);
+static int PeekParallelCopyInputByte(ParallelCopyInputReader *reader);
+static bool LoadParallelCopyInput(ParallelCopyInputReader *reader);
+static int ReadRawCopyInput(ParallelCopyInputReader *reader);
+static void SendInputChunkToWorker(shm_mq_handle *inputQueueHandle,
+								   StringInfo inputChunk,
+								   SerializedRowReceiver *receiver);
+static int ReadParallelCopyInput(void *outbuf, int minread, int maxread);
+static SerializedRowWriter * CreateSerializedRowWriter(ParallelCopyShared *shared,
+													   TupleDesc tupleDescriptor,
+													   shm_mq_handle *queueHandle);
+static void AppendSerializedRow(SerializedRowWriter *writer, Datum *columnValues,
+								bool *columnNulls);
+static void SendRowBatchToLeader(SerializedRowWriter *writer);
+
+
+PG_FUNCTION_INFO_V1(citus_create_distributed_table_progress);
+
+
+/*
+ * citus_create_distributed_table_progress returns the progress of copying the
+ * local data of tables that are being distributed by any backend.
+ */
+Datum
+citus_create_distributed_table_progress(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+
+	List *segmentList = NIL;
+	TupleDesc tupleDescriptor = NULL;
+	Tuplestorestate *tupleStore = SetupTuplestore(fcinfo, &tupleDescriptor);
+
+	List *monitorList = ProgressMonitorList(DISTRIBUTE_DATA_ACTIVITY_MAGIC_NUMBER,
+											&segmentList);
+
+	ProgressMonitorData *monitor = NULL;
+	foreach_ptr(monitor, monitorList)
+	{
+		DistributeDataProgress *progress = ProgressMonitorSteps(monitor);
+		Datum values[6];
+		bool isNulls[6];
+
+		memset(isNulls, false, sizeof(isNulls));
+
+		values[0] = Int32GetDatum(monitor->processId);
+		values[1] = ObjectIdGetDatum(progress->relationId);
+		values[2] = Int32GetDatum(progress->parallelWorkerCount);
+		values[3] = Int64GetDatum(progress->totalBlocks);
+		values[4] = Int64GetDatum(pg_atomic_read_u64(&progress->blocksScanned));
+		values[5] = Int64GetDatum(pg_atomic_read_u64(&progress->rowsCopied));
+
+		tuplestore_putvalues(tupleStore, tupleDescriptor, values, isNulls);
+	}
+
+	DetachFromDSMSegments(segmentList);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * CreateDistributeDataProgressMonitor creates and registers a progress monitor
+ * for copying the local data of the given relation into its shards. It returns
+ * NULL if the monitor could not be created.
+ */
+DistributeDataProgress *
+CreateDistributeDataProgressMonitor(Oid relationId, BlockNumber totalBlocks)
+{
+	dsm_handle dsmHandle = DSM_HANDLE_INVALID;
+	ProgressMonitorData *monitor = CreateProgressMonitor(1,
+														 sizeof(DistributeDataProgress),
+														 &dsmHandle);
+	if (monitor == NULL)
+	{
+		return NULL;
+	}
+
+	DistributeDataProgress *progress = ProgressMonitorSteps(monitor);
+	progress->relationId = relationId;
+	progress->parallelWorkerCount = 0;
+	progress->totalBlocks = totalBlocks;
+	pg_atomic_init_u64(&progress->blocksScanned, 0);
+	pg_atomic_init_u64(&progress->rowsCopied, 0);
+
+	RegisterProgressMonitor(DISTRIBUTE_DATA_ACTIVITY_MAGIC_NUMBER, relationId,
+							dsmHandle);
+
+	return progress;
+}
+
+
+/*
+ * UpdateDistributeDataProgress records the number of blocks scanned and rows
+ * copied so far, if there is a progress monitor.
+ */
+void
+UpdateDistributeDataProgress(DistributeDataProgress *progress,
+							 BlockNumber blocksScanned, uint64 rowsCopied)
+{
+	if (progress == NULL)
+	{
+		return;
+	}
+
+	pg_atomic_write_u64(&progress->blocksScanned,
+						Min((uint64) blocksScanned, progress->totalBlocks));
+	pg_atomic_write_u64(&progress->rowsCopied, rowsCopied);
+}
+
+
+/*
+ * CanCopyLocalDataInParallel returns whether the data of the given local
+ * relation can be copied into the shards of the distributed table of the
+ * given destination receiver using parallel workers.
+ *
+ * Parallel workers only serialize the tuples, so rows can only go to remote
+ * placements, and the local table needs to have the same tuple descriptor
+ * as the distributed table to avoid coercions. We only bother for heap tables
+ * that are large enough to be scanned in parallel by PostgreSQL itself.
+ */
+bool
+CanCopyLocalDataInParallel(Relation localRelation, CitusCopyDestReceiver *copyDest)
+{
+	Oid relationId = RelationGetRelid(localRelation);
+
+	if (MaxDistributeDataWorkers <= 0 || IsInParallelMode())
+	{
+		return false;
+	}
+
+	if (relationId != copyDest->distributedRelationId ||
+		!IsCitusTableType(relationId, HASH_DISTRIBUTED) ||
+		copyDest->partitionColumnIndex == INVALID_PARTITION_COLUMN_INDEX)
+	{
+		return false;
+	}
+
+	if (localRelation->rd_tableam != GetHeapamTableAmRoutine() ||
+		RelationUsesLocalBuffers(localRelation))
+	{
+		return false;
+	}
+
+	if (RelationGetNumberOfBlocks(localRelation) <
+		(BlockNumber) min_parallel_table_scan_size)
+	{
+		return false;
+	}
+
+	List *shardIntervalList = LoadShardIntervalList(relationId);
+	if (copyDest->shouldUseLocalCopy &&
+		ShardIntervalListHasLocalPlacements(shardIntervalList))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * ParallelCopyLocalDataIntoShards copies the data of the local relation into
+ * the shards of the distributed table using up to citus.max_distribute_data_workers
+ * parallel workers, which scan the relation using the active snapshot. The
+ * destination receiver should already be started. Returns the number of rows
+ * copied.
+ */
+uint64
+ParallelCopyLocalDataIntoShards(Relation localRelation, CitusCopyDestReceiver *copyDest,
+								DistributeDataProgress *progress)
+{
+	Snapshot snapshot = GetActiveSnapshot();
+	int workerCount = MaxDistributeDataWorkers;
+	uint64 rowsCopied = 0;
+
+	EnterParallelMode();
+
+	ParallelContext *parallelContext =
+		CreateParallelContext("citus", "ParallelCopyLocalDataWorkerMain", workerCount);
+
+	Size parallelScanSize = table_parallelscan_estimate(localRelation, snapshot);
+	Size queueSpaceSize = mul_size(PARALLEL_COPY_QUEUE_SIZE, workerCount);
+
+	shm_toc_estimate_chunk(&parallelContext->estimator, sizeof(ParallelCopyShared));
+	shm_toc_estimate_chunk(&parallelContext->estimator, parallelScanSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, queueSpaceSize);
+	shm_toc_estimate_keys(&parallelContext->estimator, 3);
+
+	InitializeParallelDSM(parallelContext);
+
+	ParallelCopyShared *shared = shm_toc_allocate(parallelContext->toc,
+												  sizeof(ParallelCopyShared));
+	InitializeParallelCopyShared(shared, RelationGetRelid(localRelation), copyDest);
+	shm_toc_insert(parallelContext->toc, PARALLEL_COPY_KEY_SHARED, shared);
+
+	ParallelTableScanDesc parallelScan = shm_toc_allocate(parallelContext->toc,
+														  parallelScanSize);
+	table_parallelscan_initialize(localRelation, parallelScan, snapshot);
+	shm_toc_insert(parallelContext->toc, PARALLEL_COPY_KEY_SCAN, parallelScan);
+
+	char *queueSpace = shm_toc_allocate(parallelContext->toc, queueSpaceSize);
+	shm_toc_insert(parallelContext->toc, PARALLEL_COPY_KEY_QUEUES, queueSpace);
+
+	shm_mq_handle **queueHandles = AttachLeaderQueues(parallelContext, queueSpace, true);
+
+	LaunchParallelWorkers(parallelContext);
+
+	ereport(DEBUG1, (errmsg("copying data from local table using %d parallel "
+							"workers", parallelContext->nworkers_launched)));
+
+	if (progress != NULL)
+	{
+		progress->parallelWorkerCount = parallelContext->nworkers_launched;
+	}
+
+	if (parallelContext->nworkers_launched == 0)
+	{
+		/* no workers could be started, so scan the table ourselves */
+		rowsCopied = CopyLocalDataFromParallelScan(localRelation, parallelScan,
+												   copyDest, progress);
+	}
+	else
+	{
+		SetWorkerQueueHandles(parallelContext, queueHandles);
+
+		SerializedRowReceiver *receiver =
+			CreateSerializedRowReceiver(parallelContext, queueHandles, copyDest);
+
+		rowsCopied = ReceiveSerializedRows(receiver, parallelScan, progress);
+	}
+
+	/* rethrows any error that occurred in the workers */
+	WaitForParallelWorkersToFinish(parallelContext);
+
+	DestroyParallelContext(parallelContext);
+	ExitParallelMode();
+
+	ereport(DEBUG1, (errmsg("Copied " UINT64_FORMAT " rows", rowsCopied)));
+
+	return rowsCopied;
+}
+
+
+/*
+ * CanCopyFromInParallel returns whether the input of the given COPY .. FROM
+ * can be parsed by parallel workers.
+ *
+ * The workers parse the rows with the regular COPY machinery, but cannot
+ * evaluate defaults that use sequences or write to local shards, so all
+ * columns need to be in the input and all shards need to be remote. Only
+ * text and CSV input can be split into lines by the leader.
+ */
+bool
+CanCopyFromInParallel(CopyStmt *copyStatement, CitusCopyDestReceiver *copyDest,
+					  Relation distributedRelation, bool isInputFormatBinary)
+{
+	Oid relationId = copyDest->distributedRelationId;
+
+	if (MaxParallelCopyWorkers <= 0 || IsInParallelMode() || isInputFormatBinary)
+	{
+		return false;
+	}
+
+	if (!IsCitusTableType(relationId, HASH_DISTRIBUTED) ||
+		copyDest->partitionColumnIndex == INVALID_PARTITION_COLUMN_INDEX ||
+		copyDest->colocatedIntermediateResultIdPrefix != NULL)
+	{
+		return false;
+	}
+
+	/* the DEFAULT option can make workers evaluate defaults */
+	DefElem *option = NULL;
+	foreach_ptr(option, copyStatement->options)
+	{
+		if (strcmp(option->defname, "default") == 0)
+		{
+			return false;
+		}
+	}
+
+	if (!CopyInputIncludesAllColumns(distributedRelation, copyStatement->attlist))
+	{
+		return false;
+	}
+
+	if (!InputFunctionsAreParallelSafe(RelationGetDescr(distributedRelation)))
+	{
+		return false;
+	}
+
+	List *shardIntervalList = LoadShardIntervalList(relationId);
+	if (copyDest->shouldUseLocalCopy &&
+		ShardIntervalListHasLocalPlacements(shardIntervalList))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * ParallelCopyFromIntoShards reads the input of a COPY .. FROM, splits it into
+ * chunks of lines and lets up to citus.max_parallel_copy_workers parallel
+ * workers parse the lines, while forwarding the rows that they serialize to
+ * the shards. The destination receiver should already be started.
+ *
+ * The leader only looks for the ends of the lines in the raw input. It does
+ * not split the lines into fields, which is left to the workers.
+ *
+ * Returns false without reading any input if the input cannot be split into
+ * lines by the leader or no parallel workers could be started, in which case
+ * the caller should parse the input itself.
+ */
+bool
+ParallelCopyFromIntoShards(CopyFromState copyState, CopyStmt *copyStatement,
+						   CitusCopyDestReceiver *copyDest, uint64 *processedRowCount)
+{
+	int workerCount = MaxParallelCopyWorkers;
+
+	if (!CanSplitCopyInputIntoLines(copyState))
+	{
+		return false;
+	}
+
+	char *copyStatementString = nodeToString(WorkerCopyStatement(copyStatement));
+	Size copyStatementSize = strlen(copyStatementString) + 1;
+
+	EnterParallelMode();
+
+	ParallelContext *parallelContext =
+		CreateParallelContext("citus", "ParallelCopyFromWorkerMain", workerCount);
+
+	Size queueSpaceSize = mul_size(PARALLEL_COPY_QUEUE_SIZE, workerCount);
+
+	shm_toc_estimate_chunk(&parallelContext->estimator, sizeof(ParallelCopyShared));
+	shm_toc_estimate_chunk(&parallelContext->estimator, copyStatementSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, queueSpaceSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, queueSpaceSize);
+	shm_toc_estimate_keys(&parallelContext->estimator, 4);
+
+	InitializeParallelDSM(parallelContext);
+
+	ParallelCopyShared *shared = shm_toc_allocate(parallelContext->toc,
+												  sizeof(ParallelCopyShared));
+	InitializeParallelCopyShared(shared, copyDest->distributedRelationId, copyDest);
+	shm_toc_insert(parallelContext->toc, PARALLEL_COPY_KEY_SHARED, shared);
+
+	char *sharedCopyStatement = shm_toc_allocate(parallelContext->toc,
+												 copyStatementSize);
+	memcpy_s(sharedCopyStatement, copyStatementSize, copyStatementString,
+			 copyStatementSize);
+	shm_toc_insert(parallelContext->toc, PARALLEL_COPY_KEY_COPY_STATEMENT,
+				   sharedCopyStatement);
+
+	char *inputQueueSpace = shm_toc_allocate(parallelContext->toc, queueSpaceSize);
+	shm_toc_insert(parallelContext->toc, PARALLEL_COPY_KEY_INPUT_QUEUES,
+				   inputQueueSpace);
+
+	char *queueSpace = shm_toc_allocate(parallelContext->toc, queueSpaceSize);
+	shm_toc_insert(parallelContext->toc, PARALLEL_COPY_KEY_QUEUES, queueSpace);
+
+	shm_mq_handle **inputQueueHandles = AttachLeaderQueues(parallelContext,
+														   inputQueueSpace, false);
+	shm_mq_handle **queueHandles = AttachLeaderQueues(parallelContext, queueSpace, true);
+
+	LaunchParallelWorkers(parallelContext);
+
+	int launchedWorkerCount = parallelContext->nworkers_launched;
+	if (launchedWorkerCount == 0)
+	{
+		DestroyParallelContext(parallelContext);
+		ExitParallelMode();
+
+		return false;
+	}
+
+	ereport(DEBUG1, (errmsg("parsing COPY input using %d parallel workers",
+							launchedWorkerCount)));
+
+	SetWorkerQueueHandles(parallelContext, inputQueueHandles);
+	SetWorkerQueueHandles(parallelContext, queueHandles);
+
+	SerializedRowReceiver *receiver =
+		CreateSerializedRowReceiver(parallelContext, queueHandles, copyDest);
+
+	/* the workers report the lines on which errors occur */
+	copyState->relname_only = true;
+
+	ParallelCopyInputReader *reader = CreateParallelCopyInputReader(copyState);
+
+	if (copyState->opts.header_line)
+	{
+		StringInfo headerLine = makeStringInfo();
+		ReadParallelCopyInputLine(reader, headerLine);
+	}
+
+	/* send chunks of complete lines to the workers in turn */
+	StringInfo inputChunk = makeStringInfo();
+	int workerIndex = 0;
+	bool nextLineFound = true;
+
+	while (nextLineFound)
+	{
+		if (inputChunk->len == 0)
+		{
+			InputChunkHeader chunkHeader;
+			chunkHeader.firstLineNumber = reader->lineNumber + 1;
+
+			appendBinaryStringInfo(inputChunk, (char *) &chunkHeader,
+								   sizeof(InputChunkHeader));
+		}
+
+		nextLineFound = ReadParallelCopyInputLine(reader, inputChunk);
+
+		if (inputChunk->len >= PARALLEL_COPY_BATCH_SIZE ||
+			(!nextLineFound && inputChunk->len > sizeof(InputChunkHeader)))
+		{
+			SendInputChunkToWorker(inputQueueHandles[workerIndex], inputChunk, receiver);
+			resetStringInfo(inputChunk);
+
+			workerIndex = (workerIndex + 1) % launchedWorkerCount;
+
+			pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED,
+										 receiver->rowsCopied);
+		}
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	/* workers see the end of the input once we detach from their queues */
+	for (workerIndex = 0; workerIndex < launchedWorkerCount; workerIndex++)
+	{
+		shm_mq_detach(inputQueueHandles[workerIndex]);
+	}
+
+	while (receiver->activeWorkerCount > 0)
+	{
+		if (!ReceiveSerializedRowBatches(receiver))
+		{
+			WaitForSerializedRows();
+		}
+
+		pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED,
+									 receiver->rowsCopied);
+
+		/* also processes messages from workers, including their errors */
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	/* rethrows any error that occurred in the workers */
+	WaitForParallelWorkersToFinish(parallelContext);
+
+	DestroyParallelContext(parallelContext);
+	ExitParallelMode();
+
+	*processedRowCount = receiver->rowsCopied;
+
+	return true;
+}
+
+
+/*
+ * InitializeParallelCopyShared fills in the information that parallel workers
+ * need to serialize the rows of the given relation for the given destination
+ * receiver.
+ */
+static void
+InitializeParallelCopyShared(ParallelCopyShared *shared, Oid relationId,
+							 CitusCopyDestReceiver *copyDest)
+{
+	CitusTableCacheEntry *cacheEntry =
+		GetCitusTableCacheEntry(copyDest->distributedRelationId);
+
+	shared->relationId = relationId;
+	shared->partitionColumnIndex = copyDest->partitionColumnIndex;
+	shared->hashFunctionId = cacheEntry->hashFunction->fn_oid;
+	shared->partitionColumnCollation = cacheEntry->partitionColumn->varcollid;
+	shared->binaryCopyFormat = copyDest->copyOutState->binary;
+	shared->skipJsonbValidation = SkipJsonbValidationInCopy;
+}
+
+
+/*
+ * AttachLeaderQueues creates a queue for each parallel worker in the given
+ * space and attaches the leader to them, either as the receiver or as the
+ * sender.
+ */
+static shm_mq_handle **
+AttachLeaderQueues(ParallelContext *parallelContext, char *queueSpace,
+				   bool leaderIsReceiver)
+{
+	int workerCount = parallelContext->nworkers;
+	shm_mq_handle **queueHandles = palloc0(workerCount * sizeof(shm_mq_handle *));
+
+	for (int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+	{
+		shm_mq *queue = shm_mq_create(queueSpace +
+									  workerIndex * PARALLEL_COPY_QUEUE_SIZE,
+									  PARALLEL_COPY_QUEUE_SIZE);
+
+		if (leaderIsReceiver)
+		{
+			shm_mq_set_receiver(queue, MyProc);
+		}
+		else
+		{
+			shm_mq_set_sender(queue, MyProc);
+		}
+
+		queueHandles[workerIndex] = shm_mq_attach(queue, parallelContext->seg, NULL);
+	}
+
+	return queueHandles;
+}
+
+
+/*
+ * AttachWorkerQueue attaches the current parallel worker to its queue in the
+ * given space, either as the receiver or as the sender.
+ */
+static shm_mq_handle *
+AttachWorkerQueue(dsm_segment *segment, char *queueSpace, bool workerIsReceiver)
+{
+	shm_mq *queue = (shm_mq *) (queueSpace +
+								ParallelWorkerNumber * PARALLEL_COPY_QUEUE_SIZE);
+
+	if (workerIsReceiver)
+	{
+		shm_mq_set_receiver(queue, MyProc);
+	}
+	else
+	{
+		shm_mq_set_sender(queue, MyProc);
+	}
+
+	return shm_mq_attach(queue, segment, NULL);
+}
+
+
+/*
+ * SetWorkerQueueHandles associates the queues of the launched parallel workers
+ * with their background worker handles, such that the leader notices workers
+ * that exit before attaching to their queue.
+ */
+static void
+SetWorkerQueueHandles(ParallelContext *parallelContext, shm_mq_handle **queueHandles)
+{
+	for (int workerIndex = 0; workerIndex < parallelContext->nworkers_launched;
+		 workerIndex++)
+	{
+		shm_mq_set_handle(queueHandles[workerIndex],
+						  parallelContext->worker[workerIndex].bgwhandle);
+	}
+}
+
+
+/*
+ * CreateSerializedRowReceiver creates the state for receiving serialized rows
+ * from the launched parallel workers over the given queues.
+ */
+static SerializedRowReceiver *
+CreateSerializedRowReceiver(ParallelContext *parallelContext,
+							shm_mq_handle **queueHandles,
+							CitusCopyDestReceiver *copyDest)
+{
+	SerializedRowReceiver *receiver = palloc0(sizeof(SerializedRowReceiver));
+	receiver->workerCount = parallelContext->nworkers_launched;
+	receiver->queueHandles = queueHandles;
+	receiver->workerDone = palloc0(receiver->workerCount * sizeof(bool));
+	receiver->activeWorkerCount = receiver->workerCount;
+	receiver->copyDest = copyDest;
+	receiver->rowsCopied = 0;
+
+	return receiver;
+}
+
+
+/*
+ * ReceiveSerializedRowBatches reads the batches of serialized rows that are
+ * available in the queues of the parallel workers without waiting, and sends
+ * them to the shards. Returns whether any rows were received.
+ */
+static bool
+ReceiveSerializedRowBatches(SerializedRowReceiver *receiver)
+{
+	bool receivedRows = false;
+
+	for (int workerIndex = 0; workerIndex < receiver->workerCount; workerIndex++)
+	{
+		Size batchSize = 0;
+		void *batchData = NULL;
+
+		if (receiver->workerDone[workerIndex])
+		{
+			continue;
+		}
+
+		shm_mq_result result = shm_mq_receive(receiver->queueHandles[workerIndex],
+											  &batchSize, &batchData, true);
+		if (result == SHM_MQ_WOULD_BLOCK)
+		{
+			continue;
+		}
+		else if (result == SHM_MQ_DETACHED)
+		{
+			/* the worker is done, or failed and its error is rethrown later */
+			receiver->workerDone[workerIndex] = true;
+			receiver->activeWorkerCount--;
+			continue;
+		}
+
+		receiver->rowsCopied += SendSerializedRowBatch(receiver->copyDest, batchData,
+													   batchSize);
+		receivedRows = true;
+	}
+
+	return receivedRows;
+}
+
+
+/*
+ * WaitForSerializedRows waits until a parallel worker sends rows, reads input
+ * or exits.
+ */
+static void
+WaitForSerializedRows(void)
+{
+	(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L,
+					 PG_WAIT_EXTENSION);
+	ResetLatch(MyLatch);
+}
+
+
+/*
+ * ReceiveSerializedRows reads batches of serialized rows from the queues of
+ * the parallel workers that scan the local table and sends them to the shards
+ * until all workers are done. Returns the number of rows copied.
+ */
+static uint64
+ReceiveSerializedRows(SerializedRowReceiver *receiver,
+					  ParallelTableScanDesc parallelScan,
+					  DistributeDataProgress *progress)
+{
+	while (receiver->activeWorkerCount > 0)
+	{
+		uint64 previousRowsCopied = receiver->rowsCopied;
+
+		bool receivedRows = ReceiveSerializedRowBatches(receiver);
+
+		if (previousRowsCopied == 0 && receiver->rowsCopied > 0)
+		{
+			ereport(NOTICE, (errmsg("Copying data from local table...")));
+		}
+
+		UpdateDistributeDataProgress(progress, ParallelScanBlocksAllocated(parallelScan),
+									 receiver->rowsCopied);
+
+		if (!receivedRows && receiver->activeWorkerCount > 0)
+		{
+			WaitForSerializedRows();
+		}
+
+		/* also processes messages from workers, including their errors */
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	return receiver->rowsCopied;
+}
+
+
+/*
+ * SendSerializedRowBatch sends the rows in a batch from a parallel worker to
+ * the shards that cover the hash values of their distribution columns.
+ * Returns the number of rows in the batch.
+ */
+static uint64
+SendSerializedRowBatch(CitusCopyDestReceiver *copyDest, char *batchData,
+					   Size batchSize)
+{
+	CitusTableCacheEntry *cacheEntry =
+		GetCitusTableCacheEntry(copyDest->distributedRelationId);
+	Size batchOffset = 0;
+	uint64 rowCount = 0;
+
+	while (batchOffset < batchSize)
+	{
+		SerializedRowHeader rowHeader;
+		memcpy_s(&rowHeader, sizeof(SerializedRowHeader), batchData + batchOffset,
+				 sizeof(SerializedRowHeader));
+		batchOffset += sizeof(SerializedRowHeader);
+
+		int shardIndex = FindShardIntervalIndex(Int32GetDatum(rowHeader.hashValue),
+												cacheEntry);
+		ShardInterval *shardInterval = cacheEntry->sortedShardIntervalArray[shardIndex];
+
+		StringInfoData rowData;
+		rowData.data = batchData + batchOffset;
+		rowData.len = rowHeader.rowLength;
+		rowData.maxlen = rowHeader.rowLength;
+		rowData.cursor = 0;
+
+		CitusCopyDestReceiverSendRawRow(copyDest, shardInterval->shardId, &rowData);
+
+		batchOffset += rowHeader.rowLength;
+		rowCount++;
+	}
+
+	return rowCount;
+}
+
+
+/*
+ * CopyLocalDataFromParallelScan copies the local data in the current backend
+ * using the parallel scan, for when no parallel workers could be started.
+ */
+static uint64
+CopyLocalDataFromParallelScan(Relation localRelation,
+							  ParallelTableScanDesc parallelScan,
+							  CitusCopyDestReceiver *copyDest,
+							  DistributeDataProgress *progress)
+{
+	DestReceiver *dest = (DestReceiver *) copyDest;
+	TupleTableSlot *slot = table_slot_create(localRelation, NULL);
+	TableScanDesc scan = table_beginscan_parallel(localRelation, parallelScan);
+	uint64 rowsCopied = 0;
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+	{
+		if (rowsCopied == 0)
+		{
+			ereport(NOTICE, (errmsg("Copying data from local table...")));
+		}
+
+		dest->receiveSlot(slot, dest);
+		rowsCopied++;
+
+		ResetPerTupleExprContext(copyDest->executorState);
+
+		UpdateDistributeDataProgress(progress,
+									 ItemPointerGetBlockNumber(&slot->tts_tid) + 1,
+									 rowsCopied);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	table_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+
+	return rowsCopied;
+}
+
+
+/*
+ * ParallelScanBlocksAllocated returns the number of blocks that the parallel
+ * scan handed out to the workers so far.
+ */
+static BlockNumber
+ParallelScanBlocksAllocated(ParallelTableScanDesc parallelScan)
+{
+	ParallelBlockTableScanDesc blockScan = (ParallelBlockTableScanDesc) parallelScan;
+	uint64 blocksAllocated = pg_atomic_read_u64(&blockScan->phs_nallocated);
+
+	return (BlockNumber) Min(blocksAllocated, (uint64) blockScan->phs_nblocks);
+}
+
+
+/*
+ * InputFunctionsAreParallelSafe returns whether the input functions of all
+ * columns of the given tuple descriptor can be called in parallel workers.
+ */
+static bool
+InputFunctionsAreParallelSafe(TupleDesc tupleDescriptor)
+{
+	for (int columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+	{
+		Form_pg_attribute column = TupleDescAttr(tupleDescriptor, columnIndex);
+		Oid inputFunctionId = InvalidOid;
+		Oid typeIOParam = InvalidOid;
+
+		if (column->attisdropped)
+		{
+			continue;
+		}
+
+		getTypeInputInfo(column->atttypid, &inputFunctionId, &typeIOParam);
+		if (func_parallel(inputFunctionId) != PROPARALLEL_SAFE)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * WorkerCopyStatement returns the COPY statement that parallel workers use to
+ * parse chunks of input lines. The header is skipped by the leader, and the
+ * input is already in the server encoding.
+ */
+static CopyStmt *
+WorkerCopyStatement(CopyStmt *copyStatement)
+{
+	CopyStmt *workerCopyStatement = makeNode(CopyStmt);
+	workerCopyStatement->relation = copyObject(copyStatement->relation);
+	workerCopyStatement->attlist = copyObject(copyStatement->attlist);
+	workerCopyStatement->is_from = true;
+	workerCopyStatement->is_program = false;
+	workerCopyStatement->filename = NULL;
+
+	DefElem *option = NULL;
+	foreach_ptr(option, copyStatement->options)
+	{
+		if (strcmp(option->defname, "header") == 0 ||
+			strcmp(option->defname, "encoding") == 0 ||
+			strcmp(option->defname, "freeze") == 0)
+		{
+			continue;
+		}
+
+		workerCopyStatement->options = lappend(workerCopyStatement->options,
+											   copyObject(option));
+	}
+
+	char *serverEncoding = pstrdup(GetDatabaseEncodingName());
+	DefElem *encodingOption = makeDefElem("encoding",
+										  (Node *) makeString(serverEncoding), -1);
+	workerCopyStatement->options = lappend(workerCopyStatement->options,
+										   encodingOption);
+
+	return workerCopyStatement;
+}
+
+
+/*
+ * CanSplitCopyInputIntoLines returns whether the leader can find the ends of
+ * the lines in the raw input of the COPY. That requires the input to be in the
+ * server encoding, in which the bytes of multi-byte characters cannot be
+ * mistaken for newlines, quotes or backslashes. A header that needs to match
+ * the column names needs to be parsed.
+ */
+static bool
+CanSplitCopyInputIntoLines(CopyFromState copyState)
+{
+	if (copyState->need_transcoding || copyState->encoding_embeds_ascii)
+	{
+		return false;
+	}
+
+#if PG_VERSION_NUM >= PG_VERSION_15
+	if (copyState->opts.header_line == COPY_HEADER_MATCH)
+	{
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+
+/*
+ * CreateParallelCopyInputReader creates the state for reading the input of the
+ * given COPY .. FROM as lines.
+ */
+static ParallelCopyInputReader *
+CreateParallelCopyInputReader(CopyFromState copyState)
+{
+	ParallelCopyInputReader *reader = palloc0(sizeof(ParallelCopyInputReader));
+	reader->copyState = copyState;
+	reader->readBuffer = palloc(PARALLEL_COPY_READ_SIZE);
+	reader->csvMode = copyState->opts.csv_mode;
+
+	if (reader->csvMode)
+	{
+		reader->quoteChar = copyState->opts.quote[0];
+		reader->escapeChar = copyState->opts.escape[0];
+
+		/* like in CopyReadLineText, an escape that equals the quote is a toggle */
+		if (reader->quoteChar == reader->escapeChar)
+		{
+			reader->escapeChar = '\0';
+		}
+	}
+
+	return reader;
+}
+
+
+/*
+ * ReadParallelCopyInputLine appends the next line of the COPY input to the
+ * given string, including its newline, and returns whether there was one.
+ * It follows the rules of CopyReadLineText for newlines within quoted CSV
+ * fields, backslash escapes in text format and the \. end-of-data marker,
+ * but leaves any other validation to the workers that parse the line.
+ */
+static bool
+ReadParallelCopyInputLine(ParallelCopyInputReader *reader, StringInfo line)
+{
+	int lineStart = line->len;
+	bool inQuote = false;
+	bool lastWasEscape = false;
+
+	if (reader->reachedEndOfData)
+	{
+		return false;
+	}
+
+	while (true)
+	{
+		int character = PeekParallelCopyInputByte(reader);
+		if (character == EOF)
+		{
+			break;
+		}
+
+		reader->readOffset++;
+
+		if (reader->csvMode)
+		{
+			if (inQuote && character == reader->escapeChar)
+			{
+				lastWasEscape = !lastWasEscape;
+			}
+			if (character == reader->quoteChar && !lastWasEscape)
+			{
+				inQuote = !inQuote;
+			}
+			if (character != reader->escapeChar)
+			{
+				lastWasEscape = false;
+			}
+
+			/* COPY also counts the lines within quoted fields */
+			if (inQuote)
+			{
+				if (character == '\n')
+				{
+					reader->lineNumber++;
+				}
+
+				appendStringInfoCharMacro(line, character);
+				continue;
+			}
+		}
+
+		if (character == '\\' &&
+			(!reader->csvMode || line->len == lineStart) &&
+			PeekParallelCopyInputByte(reader) == '.')
+		{
+			if (ReadEndOfDataMarker(reader))
+			{
+				break;
+			}
+
+			/* in CSV, \. followed by other data is regular data */
+			appendStringInfoCharMacro(line, character);
+			appendStringInfoCharMacro(line, '.');
+			continue;
+		}
+
+		appendStringInfoCharMacro(line, character);
+
+		if (character == '\\' && !reader->csvMode)
+		{
+			/* the character after a backslash is never a newline */
+			int escapedCharacter = PeekParallelCopyInputByte(reader);
+			if (escapedCharacter != EOF)
+			{
+				reader->readOffset++;
+				appendStringInfoCharMacro(line, escapedCharacter);
+			}
+		}
+		else if (character == '\r')
+		{
+			if (PeekParallelCopyInputByte(reader) == '\n')
+			{
+				reader->readOffset++;
+				appendStringInfoCharMacro(line, '\n');
+			}
+
+			reader->lineNumber++;
+			return true;
+		}
+		else if (character == '\n')
+		{
+			reader->lineNumber++;
+			return true;
+		}
+	}
+
+	if (line->len == lineStart)
+	{
+		return false;
+	}
+
+	/* the last line of the input does not need to end with a newline */
+	appendStringInfoCharMacro(line, '\n');
+	reader->lineNumber++;
+
+	return true;
+}
+
+
+/*
+ * ReadEndOfDataMarker is called when the next characters of the input are \.
+ * and reads them if they are the end-of-data marker, which needs to be
+ * followed by a newline. In text format, the marker ends the data anywhere
+ * in a line, and anything else after \. is an error. In CSV, it only ends the
+ * data on a line of its own. Returns whether the marker was read, after which
+ * any remaining input is discarded. Otherwise, only \. was read.
+ */
+static bool
+ReadEndOfDataMarker(ParallelCopyInputReader *reader)
+{
+	/* the backslash was already read, so skip the period */
+	reader->readOffset++;
+
+	int character = PeekParallelCopyInputByte(reader);
+	if (character == '\r')
+	{
+		reader->readOffset++;
+		character = PeekParallelCopyInputByte(reader);
+		if (character == '\n')
+		{
+			reader->readOffset++;
+		}
+	}
+	else if (character == '\n')
+	{
+		reader->readOffset++;
+	}
+	else if (character != EOF)
+	{
+		if (!reader->csvMode)
+		{
+			ereport(ERROR, (errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+							errmsg("end-of-copy marker corrupt")));
+		}
+
+		return false;
+	}
+
+	reader->reachedEndOfData = true;
+
+	/* like COPY, read the rest of the data that the client sends */
+	if (reader->copyState->copy_src == COPY_FRONTEND)
+	{
+		while (LoadParallelCopyInput(reader))
+		{
+			reader->readOffset = reader->readLength;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * PeekParallelCopyInputByte returns the next byte of the COPY input without
+ * consuming it, or EOF at the end of the input.
+ */
+static int
+PeekParallelCopyInputByte(ParallelCopyInputReader *reader)
+{
+	if (reader->readOffset >= reader->readLength && !LoadParallelCopyInput(reader))
+	{
+		return EOF;
+	}
+
+	return (unsigned char) reader->readBuffer[reader->readOffset];
+}
+
+
+/*
+ * LoadParallelCopyInput reads the next part of the COPY input into the read
+ * buffer of the reader, and returns false at the end of the input.
+ */
+static bool
+LoadParallelCopyInput(ParallelCopyInputReader *reader)
+{
+	CopyFromState copyState = reader->copyState;
+
+	if (reader->reachedEndOfInput)
+	{
+		return false;
+	}
+
+	int bytesRead = ReadRawCopyInput(reader);
+	if (bytesRead == 0)
+	{
+		reader->reachedEndOfInput = true;
+		return false;
+	}
+
+	reader->readLength = bytesRead;
+	reader->readOffset = 0;
+
+	copyState->bytes_processed += bytesRead;
+	pgstat_progress_update_param(PROGRESS_COPY_BYTES_PROCESSED,
+								 copyState->bytes_processed);
+
+	return true;
+}
+
+
+/*
+ * ReadRawCopyInput reads the next part of the input of the COPY .. FROM into
+ * the read buffer of the reader, in the same way as CopyGetData, and returns
+ * the number of bytes read. Returns 0 at the end of the input.
+ */
+static int
+ReadRawCopyInput(ParallelCopyInputReader *reader)
+{
+	CopyFromState copyState = reader->copyState;
+	char *buffer = reader->readBuffer;
+	int maxread = PARALLEL_COPY_READ_SIZE;
+
+	switch (copyState->copy_src)
+	{
+		case COPY_FILE:
+		{
+			size_t bytesRead = fread(buffer, 1, maxread, copyState->copy_file);
+			if (ferror(copyState->copy_file))
+			{
+				ereport(ERROR, (errcode_for_file_access(),
+								errmsg("could not read from COPY file: %m")));
+			}
+
+			return (int) bytesRead;
+		}
+
+		case COPY_FRONTEND:
+		{
+			StringInfo message = copyState->fe_msgbuf;
+
+			while (message->cursor >= message->len)
+			{
+				if (reader->receivedCopyDone)
+				{
+					return 0;
+				}
+
+				/* resets the message buffer and its cursor */
+				reader->receivedCopyDone = ReceiveCopyData(message);
+			}
+
+			int bytesRead = Min(message->len - message->cursor, maxread);
+			pq_copymsgbytes(message, buffer, bytesRead);
+
+			return bytesRead;
+		}
+
+		case COPY_CALLBACK:
+		{
+			return copyState->data_source_cb(buffer, 1, maxread);
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * SendInputChunkToWorker sends a chunk of input lines to a parallel worker. If
+ * the queue of the worker is full, rows from all workers are forwarded to the
+ * shards until the worker has read enough of its input.
+ */
+static void
+SendInputChunkToWorker(shm_mq_handle *inputQueueHandle, StringInfo inputChunk,
+					   SerializedRowReceiver *receiver)
+{
+	while (true)
+	{
+		shm_mq_result result = shm_mq_send_compat(inputQueueHandle, inputChunk->len,
+												  inputChunk->data, true, true);
+		if (result == SHM_MQ_SUCCESS)
+		{
+			break;
+		}
+		else if (result == SHM_MQ_DETACHED)
+		{
+			/* rethrow the error of the worker, if any */
+			CHECK_FOR_INTERRUPTS();
+
+			ereport(ERROR, (errmsg("parallel worker stopped reading COPY input")));
+		}
+
+		/* the queue is full, forward rows while the worker catches up */
+		if (!ReceiveSerializedRowBatches(receiver))
+		{
+			WaitForSerializedRows();
+		}
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+
+/*
+ * ParallelCopyLocalDataWorkerMain is the entry point of the parallel workers
+ * that copy local data. It scans its part of the local table and sends the
+ * tuples to the leader serialized in the COPY format, preceded by the hash
+ * value of their distribution column.
+ */
+void
+ParallelCopyLocalDataWorkerMain(dsm_segment *segment, shm_toc *toc)
+{
+	ParallelCopyShared *shared = shm_toc_lookup(toc, PARALLEL_COPY_KEY_SHARED, false);
+	ParallelTableScanDesc parallelScan = shm_toc_lookup(toc, PARALLEL_COPY_KEY_SCAN,
+														false);
+	char *queueSpace = shm_toc_lookup(toc, PARALLEL_COPY_KEY_QUEUES, false);
+	shm_mq_handle *queueHandle = AttachWorkerQueue(segment, queueSpace, false);
+
+	Relation relation = table_open(shared->relationId, AccessShareLock);
+	TupleTableSlot *slot = table_slot_create(relation, NULL);
+	TableScanDesc scan = table_beginscan_parallel(relation, parallelScan);
+
+	SerializedRowWriter *writer = CreateSerializedRowWriter(shared,
+															RelationGetDescr(relation),
+															queueHandle);
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+	{
+		slot_getallattrs(slot);
+
+		AppendSerializedRow(writer, slot->tts_values, slot->tts_isnull);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	SendRowBatchToLeader(writer);
+
+	table_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+	table_close(relation, AccessShareLock);
+
+	shm_mq_detach(queueHandle);
+}
+
+
+/*
+ * ParallelCopyFromWorkerMain is the entry point of the parallel workers that
+ * parse the input of a COPY .. FROM. It parses the chunks of lines that the
+ * leader sends and sends the rows back to the leader serialized in the COPY
+ * format, preceded by the hash value of their distribution column.
+ */
+void
+ParallelCopyFromWorkerMain(dsm_segment *segment, shm_toc *toc)
+{
+	ParallelCopyShared *shared = shm_toc_lookup(toc, PARALLEL_COPY_KEY_SHARED, false);
+	char *copyStatementString = shm_toc_lookup(toc, PARALLEL_COPY_KEY_COPY_STATEMENT,
+											   false);
+	char *inputQueueSpace = shm_toc_lookup(toc, PARALLEL_COPY_KEY_INPUT_QUEUES, false);
+	char *queueSpace = shm_toc_lookup(toc, PARALLEL_COPY_KEY_QUEUES, false);
+
+	ParallelCopyInputQueue = AttachWorkerQueue(segment, inputQueueSpace, true);
+	shm_mq_handle *queueHandle = AttachWorkerQueue(segment, queueSpace, false);
+
+	CopyStmt *copyStatement = (CopyStmt *) stringToNode(copyStatementString);
+
+	Relation relation = table_open(shared->relationId, AccessShareLock);
+	TupleDesc tupleDescriptor = RelationGetDescr(relation);
+	Datum *columnValues = palloc0(tupleDescriptor->natts * sizeof(Datum));
+	bool *columnNulls = palloc0(tupleDescriptor->natts * sizeof(bool));
+
+	SerializedRowWriter *writer = CreateSerializedRowWriter(shared, tupleDescriptor,
+															queueHandle);
+
+	CopyFromState copyState =
+		BeginCopyFromDistributedTable(relation, copyStatement, ReadParallelCopyInput,
+									  shared->partitionColumnIndex,
+									  shared->skipJsonbValidation,
+									  shared->binaryCopyFormat,
+									  writer->columnOutputFunctions);
+	ParallelCopyInputState = copyState;
+
+	/* errors report the line of the input that the worker was parsing */
+	ErrorContextCallback errorCallback;
+	errorCallback.callback = CopyFromErrorCallback;
+	errorCallback.arg = (void *) copyState;
+	errorCallback.previous = error_context_stack;
+	error_context_stack = &errorCallback;
+
+	EState *executorState = CreateExecutorState();
+	MemoryContext executorTupleContext = GetPerTupleMemoryContext(executorState);
+	ExprContext *executorExpressionContext = GetPerTupleExprContext(executorState);
+
+	while (true)
+	{
+		ResetPerTupleExprContext(executorState);
+
+		MemoryContext oldContext = MemoryContextSwitchTo(executorTupleContext);
+
+		bool nextRowFound = NextCopyFrom(copyState, executorExpressionContext,
+										 columnValues, columnNulls);
+
+		MemoryContextSwitchTo(oldContext);
+
+		if (!nextRowFound)
+		{
+			break;
+		}
+
+		AppendSerializedRow(writer, columnValues, columnNulls);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	SendRowBatchToLeader(writer);
+
+	error_context_stack = errorCallback.previous;
+
+	EndCopyFrom(copyState);
+	FreeExecutorState(executorState);
+	table_close(relation, AccessShareLock);
+
+	shm_mq_detach(queueHandle);
+	shm_mq_detach(ParallelCopyInputQueue);
+	ParallelCopyInputQueue = NULL;
+	ParallelCopyInputState = NULL;
+}
+
+
+/*
+ * ReadParallelCopyInput is the data source of the COPY in a parallel worker,
+ * which reads the chunks of lines that the leader sends. The input ends when
+ * the leader detaches from the queue.
+ *
+ * Each chunk starts with the number of its first line in the input, to which
+ * the line number of the COPY is set. COPY only asks for more data after it
+ * reached the end of the last line of a chunk, except to look past a \r at
+ * the end of a chunk, in which case the line numbers in errors are one off.
+ */
+static int
+ReadParallelCopyInput(void *outbuf, int minread, int maxread)
+{
+	int bytesRead = 0;
+
+	while (bytesRead < minread)
+	{
+		if (ParallelCopyInputChunkOffset >= ParallelCopyInputChunkSize)
+		{
+			Size chunkSize = 0;
+			void *chunkData = NULL;
+
+			shm_mq_result result = shm_mq_receive(ParallelCopyInputQueue, &chunkSize,
+												  &chunkData, false);
+			if (result == SHM_MQ_DETACHED)
+			{
+				break;
+			}
+
+			InputChunkHeader chunkHeader;
+			memcpy_s(&chunkHeader, sizeof(InputChunkHeader), chunkData,
+					 sizeof(InputChunkHeader));
+
+			ParallelCopyInputChunk = (char *) chunkData + sizeof(InputChunkHeader);
+			ParallelCopyInputChunkSize = chunkSize - sizeof(InputChunkHeader);
+			ParallelCopyInputChunkOffset = 0;
+
+			/* NextCopyFrom already counted the line that it is about to read */
+			ParallelCopyInputState->cur_lineno = chunkHeader.firstLineNumber;
+		}
+
+		Size bytesAvailable = ParallelCopyInputChunkSize - ParallelCopyInputChunkOffset;
+		Size bytesToCopy = Min(bytesAvailable, (Size) (maxread - bytesRead));
+
+		memcpy_s((char *) outbuf + bytesRead, maxread - bytesRead,
+				 ParallelCopyInputChunk + ParallelCopyInputChunkOffset, bytesToCopy);
+
+		ParallelCopyInputChunkOffset += bytesToCopy;
+		bytesRead += bytesToCopy;
+	}
+
+	return bytesRead;
+}
+
+
+/*
+ * CreateSerializedRowWriter creates the state for serializing rows of the
+ * given tuple descriptor in the same way as CitusCopyDestReceiverStartup and
+ * sending them to the leader over the given queue.
+ */
+static SerializedRowWriter *
+CreateSerializedRowWriter(ParallelCopyShared *shared, TupleDesc tupleDescriptor,
+						  shm_mq_handle *queueHandle)
+{
+	SerializedRowWriter *writer = palloc0(sizeof(SerializedRowWriter));
+
+	CopyOutState copyOutState = (CopyOutState) palloc0(sizeof(CopyOutStateData));
+	copyOutState->delim = "\t";
+	copyOutState->null_print = "\\N";
+	copyOutState->null_print_client = "\\N";
+	copyOutState->binary = shared->binaryCopyFormat;
+	copyOutState->fe_msgbuf = makeStringInfo();
+	copyOutState->rowcontext = AllocSetContextCreate(CurrentMemoryContext,
+													 "ParallelCopyRowContext",
+													 ALLOCSET_DEFAULT_SIZES);
+
+	writer->shared = shared;
+	writer->tupleDescriptor = tupleDescriptor;
+	writer->copyOutState = copyOutState;
+	writer->columnOutputFunctions = ColumnOutputFunctions(tupleDescriptor,
+														  copyOutState->binary);
+	writer->queueHandle = queueHandle;
+
+	fmgr_info(shared->hashFunctionId, &writer->hashFunction);
+
+	return writer;
+}
+
+
+/*
+ * AppendSerializedRow adds a row to the current batch of serialized rows,
+ * preceded by the hash value of its distribution column, and sends the batch
+ * to the leader once it is large enough.
+ */
+static void
+AppendSerializedRow(SerializedRowWriter *writer, Datum *columnValues,
+					bool *columnNulls)
+{
+	ParallelCopyShared *shared = writer->shared;
+	CopyOutState copyOutState = writer->copyOutState;
+	StringInfo batch = copyOutState->fe_msgbuf;
+	int partitionColumnIndex = shared->partitionColumnIndex;
+
+	if (columnNulls[partitionColumnIndex])
+	{
+		ereport(ERROR, (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+						errmsg("the partition column of table %s cannot be NULL",
+							   generate_qualified_relation_name(shared->relationId))));
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(copyOutState->rowcontext);
+
+	SerializedRowHeader rowHeader;
+	rowHeader.hashValue =
+		DatumGetInt32(FunctionCall1Coll(&writer->hashFunction,
+										shared->partitionColumnCollation,
+										columnValues[partitionColumnIndex]));
+
+	MemoryContextSwitchTo(oldContext);
+
+	/* reserve space for the header, and fill in the length afterwards */
+	int headerOffset = batch->len;
+	appendBinaryStringInfo(batch, (char *) &rowHeader, sizeof(SerializedRowHeader));
+
+	AppendCopyRowData(columnValues, columnNulls, writer->tupleDescriptor,
+					  copyOutState, writer->columnOutputFunctions, NULL);
+
+	rowHeader.rowLength = batch->len - headerOffset - sizeof(SerializedRowHeader);
+	memcpy_s(batch->data + headerOffset, sizeof(SerializedRowHeader),
+			 &rowHeader, sizeof(SerializedRowHeader));
+
+	MemoryContextReset(copyOutState->rowcontext);
+
+	if (batch->len >= PARALLEL_COPY_BATCH_SIZE)
+	{
+		SendRowBatchToLeader(writer);
+	}
+}
+
+
+/*
+ * SendRowBatchToLeader sends the current batch of serialized rows to the
+ * leader, if any, and empties the batch.
+ */
+static void
+SendRowBatchToLeader(SerializedRowWriter *writer)
+{
+	StringInfo batch = writer->copyOutState->fe_msgbuf;
+
+	if (batch->len == 0)
+	{
+		return;
+	}
+
+	shm_mq_result result = shm_mq_send_compat(writer->queueHandle, batch->len,
+											  batch->data, false, true);
+	if (result != SHM_MQ_SUCCESS)
+	{
+		ereport(ERROR, (errcode(ERRCODE_ADMIN_SHUTDOWN),
+						errmsg("could not send rows to the leader of the "
+							   "parallel copy")));
+	}
+
+	resetStringInfo(batch);
+}
@@ -5,6 +5,10 @@
  *   backends. The primary goal is to prevent excessive number of
  *   connections (typically > max_connections) to any worker node.
  *
+ *   It also keeps track of the number of tasks that are running on each
+ *   node and a moving average of their execution times, which is used by
+ *   the adaptive task assignment policy.
+ *
  * Copyright (c) Citus Data, Inc.
  *
  *-------------------------------------------------------------------------
@@ -23,6 +27,7 @@
 #include "common/hashfn.h"
 #include "storage/ipc.h"
 #include "utils/builtins.h"
+#include "utils/timestamp.h"
 
 #include "pg_version_constants.h"
 
@@ -42,6 +47,12 @@
 
 #define REMOTE_CONNECTION_STATS_COLUMNS 4
 
+/* weight of the most recent task in the moving average of task execution times */
+#define NODE_TASK_TIME_SMOOTHING_FACTOR 0.25
+
+/* task execution times that are older than this are not considered recent */
+#define NODE_TASK_TIME_EXPIRY_MS (10 * MS_PER_SECOND)
+
 
 /*
  * The data structure used to store data in shared memory. This data structure is only
@@ -56,6 +67,9 @@ typedef struct ConnectionStatsSharedData
 
 	LWLock sharedConnectionHashLock;
 	ConditionVariable waitersConditionVariable;
+
+	/* protects SharedNodeTaskStatsHash, which is updated far more often */
+	LWLock sharedNodeTaskStatsHashLock;
 } ConnectionStatsSharedData;
 
 
@@ -85,6 +99,38 @@ typedef struct SharedConnStatsHashEntry
 } SharedConnStatsHashEntry;
 
 
+/*
+ * Hash entry for per worker task execution stats. The stats are kept per node,
+ * so the databaseOid of the key is always InvalidOid.
+ */
+typedef struct SharedNodeTaskStatsHashEntry
+{
+	SharedConnStatsHashKey key;
+
+	/* number of tasks that are currently running on the node */
+	int inFlightTaskCount;
+
+	/* exponential moving average of the execution times of tasks on the node */
+	double averageTaskTimeMicrosecs;
+
+	/* time at which the last task on the node finished, 0 if none did */
+	TimestampTz lastTaskFinishTime;
+} SharedNodeTaskStatsHashEntry;
+
+
+/*
+ * LocalNodeTaskCount keeps track of the number of tasks this backend counts
+ * as in-flight on a node, such that they can be released if the executions
+ * are abandoned due to an error.
+ */
+typedef struct LocalNodeTaskCount
+{
+	char hostname[MAX_NODE_LENGTH];
+	int32 port;
+	int inFlightTaskCount;
+} LocalNodeTaskCount;
+
+
 /*
  * Controlled via a GUC, never access directly, use GetMaxSharedPoolSize().
  *  "0" means adjust MaxSharedPoolSize automatically by using MaxConnections.
@@ -107,8 +153,12 @@ int MaxClientConnections = ALLOW_ALL_EXTERNAL_CONNECTIONS;
 
 /* the following two structs are used for accessing shared memory */
 static HTAB *SharedConnStatsHash = NULL;
+static HTAB *SharedNodeTaskStatsHash = NULL;
 static ConnectionStatsSharedData *ConnectionStatsSharedState = NULL;
 
+/* in-flight tasks of this backend, allocated in TopMemoryContext */
+static List *LocalNodeTaskCountList = NIL;
+
 
 static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 
@@ -119,6 +169,11 @@ static void StoreAllRemoteConnectionStats(Tuplestorestate *tupleStore, TupleDesc
 static void LockConnectionSharedMemory(LWLockMode lockMode);
 static void UnLockConnectionSharedMemory(void);
 static bool ShouldWaitForConnection(int currentConnectionCount);
+static void InitNodeTaskStatsHashKey(SharedConnStatsHashKey *key, const char *hostname,
+									 int port);
+static LocalNodeTaskCount * FindLocalNodeTaskCount(const char *hostname, int port,
+												   bool createIfMissing);
+static void AdjustInFlightTaskCount(const char *hostname, int port, int delta);
 static uint32 SharedConnectionHashHash(const void *key, Size keysize);
 static int SharedConnectionHashCompare(const void *a, const void *b, Size keysize);
 
@@ -645,6 +700,11 @@ SharedConnectionStatsShmemSize(void)
 
 	size = add_size(size, hashSize);
 
+	Size taskStatsHashSize = hash_estimate_size(MaxWorkerNodesTracked,
+												sizeof(SharedNodeTaskStatsHashEntry));
+
+	size = add_size(size, taskStatsHashSize);
+
 	return size;
 }
 
@@ -690,6 +750,8 @@ SharedConnectionStatsShmemInit(void)
 
 		LWLockInitialize(&ConnectionStatsSharedState->sharedConnectionHashLock,
 						 ConnectionStatsSharedState->sharedConnectionHashTrancheId);
+		LWLockInitialize(&ConnectionStatsSharedState->sharedNodeTaskStatsHashLock,
+						 ConnectionStatsSharedState->sharedConnectionHashTrancheId);
 
 		ConditionVariableInit(&ConnectionStatsSharedState->waitersConditionVariable);
 	}
@@ -699,9 +761,16 @@ SharedConnectionStatsShmemInit(void)
 		ShmemInitHash("Shared Conn. Stats Hash", MaxWorkerNodesTracked,
 					  MaxWorkerNodesTracked, &info, hashFlags);
 
+	/* create (hostname, port) -> [task stats], using the same key */
+	info.entrysize = sizeof(SharedNodeTaskStatsHashEntry);
+	SharedNodeTaskStatsHash =
+		ShmemInitHash("Shared Node Task Stats Hash", MaxWorkerNodesTracked,
+					  MaxWorkerNodesTracked, &info, hashFlags);
+
 	LWLockRelease(AddinShmemInitLock);
 
 	Assert(SharedConnStatsHash != NULL);
+	Assert(SharedNodeTaskStatsHash != NULL);
 	Assert(ConnectionStatsSharedState->sharedConnectionHashTrancheId != 0);
 
 	if (prev_shmem_startup_hook != NULL)
@@ -711,6 +780,234 @@ SharedConnectionStatsShmemInit(void)
 }
 
 
+/*
+ * IncrementNodeInFlightTaskCount records that this backend started running a
+ * task on the given node.
+ */
+void
+IncrementNodeInFlightTaskCount(const char *hostname, int port)
+{
+	AdjustInFlightTaskCount(hostname, port, 1);
+}
+
+
+/*
+ * RecordNodeTaskCompletion records that a task which was counted via
+ * IncrementNodeInFlightTaskCount finished on the given node. The execution
+ * time of successful tasks is added to the moving average of the node.
+ */
+void
+RecordNodeTaskCompletion(const char *hostname, int port, uint64 durationMicrosecs,
+						 bool succeeded)
+{
+	AdjustInFlightTaskCount(hostname, port, -1);
+
+	if (!succeeded)
+	{
+		return;
+	}
+
+	SharedConnStatsHashKey nodeKey;
+	InitNodeTaskStatsHashKey(&nodeKey, hostname, port);
+
+	LWLockAcquire(&ConnectionStatsSharedState->sharedNodeTaskStatsHashLock,
+				  LW_EXCLUSIVE);
+
+	bool entryFound = false;
+	SharedNodeTaskStatsHashEntry *taskStatsEntry =
+		hash_search(SharedNodeTaskStatsHash, &nodeKey, HASH_FIND, &entryFound);
+
+	if (entryFound)
+	{
+		TimestampTz now = GetCurrentTimestamp();
+
+		if (taskStatsEntry->lastTaskFinishTime == 0 ||
+			TimestampDifferenceExceeds(taskStatsEntry->lastTaskFinishTime, now,
+									   NODE_TASK_TIME_EXPIRY_MS))
+		{
+			/* the previous average is too old to be relevant */
+			taskStatsEntry->averageTaskTimeMicrosecs = durationMicrosecs;
+		}
+		else
+		{
+			taskStatsEntry->averageTaskTimeMicrosecs +=
+				NODE_TASK_TIME_SMOOTHING_FACTOR *
+				(durationMicrosecs - taskStatsEntry->averageTaskTimeMicrosecs);
+		}
+
+		taskStatsEntry->lastTaskFinishTime = now;
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->sharedNodeTaskStatsHashLock);
+}
+
+
+/*
+ * GetNodeTaskStats fills the task execution stats of the given node and
+ * returns whether any are known. The average task time is only reported if
+ * a task finished on the node recently.
+ */
+bool
+GetNodeTaskStats(const char *hostname, int port, NodeTaskStats *taskStats)
+{
+	SharedConnStatsHashKey nodeKey;
+	InitNodeTaskStatsHashKey(&nodeKey, hostname, port);
+
+	memset(taskStats, 0, sizeof(NodeTaskStats));
+
+	LWLockAcquire(&ConnectionStatsSharedState->sharedNodeTaskStatsHashLock, LW_SHARED);
+
+	bool entryFound = false;
+	SharedNodeTaskStatsHashEntry *taskStatsEntry =
+		hash_search(SharedNodeTaskStatsHash, &nodeKey, HASH_FIND, &entryFound);
+
+	if (entryFound)
+	{
+		taskStats->inFlightTaskCount = taskStatsEntry->inFlightTaskCount;
+
+		if (taskStatsEntry->lastTaskFinishTime != 0 &&
+			!TimestampDifferenceExceeds(taskStatsEntry->lastTaskFinishTime,
+										GetCurrentTimestamp(),
+										NODE_TASK_TIME_EXPIRY_MS))
+		{
+			taskStats->hasRecentTaskTime = true;
+			taskStats->averageTaskTimeMicrosecs =
+				taskStatsEntry->averageTaskTimeMicrosecs;
+		}
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->sharedNodeTaskStatsHashLock);
+
+	return entryFound;
+}
+
+
+/*
+ * ReleaseNodeInFlightTaskCounts gives back the in-flight task counts of this
+ * backend for tasks whose completion was never recorded, which happens when
+ * an execution is abandoned due to an error. It is called at the end of the
+ * transaction and does not allocate memory.
+ */
+void
+ReleaseNodeInFlightTaskCounts(void)
+{
+	LocalNodeTaskCount *localTaskCount = NULL;
+	foreach_ptr(localTaskCount, LocalNodeTaskCountList)
+	{
+		if (localTaskCount->inFlightTaskCount > 0)
+		{
+			AdjustInFlightTaskCount(localTaskCount->hostname, localTaskCount->port,
+									-localTaskCount->inFlightTaskCount);
+		}
+	}
+}
+
+
+/*
+ * AdjustInFlightTaskCount adds delta to the number of in-flight tasks on the
+ * given node, both in shared memory and in the backend-local bookkeeping.
+ */
+static void
+AdjustInFlightTaskCount(const char *hostname, int port, int delta)
+{
+	bool createIfMissing = delta > 0;
+	LocalNodeTaskCount *localTaskCount =
+		FindLocalNodeTaskCount(hostname, port, createIfMissing);
+
+	if (localTaskCount == NULL)
+	{
+		/* we never counted a task on this node */
+		return;
+	}
+
+	/* never release more tasks than this backend counted */
+	delta = Max(delta, -localTaskCount->inFlightTaskCount);
+	if (delta == 0)
+	{
+		return;
+	}
+
+	localTaskCount->inFlightTaskCount += delta;
+
+	SharedConnStatsHashKey nodeKey;
+	InitNodeTaskStatsHashKey(&nodeKey, hostname, port);
+
+	LWLockAcquire(&ConnectionStatsSharedState->sharedNodeTaskStatsHashLock,
+				  LW_EXCLUSIVE);
+
+	/* like for connection counters, we continue without stats if the hash is full */
+	bool entryFound = false;
+	SharedNodeTaskStatsHashEntry *taskStatsEntry =
+		hash_search(SharedNodeTaskStatsHash, &nodeKey,
+					delta > 0 ? HASH_ENTER_NULL : HASH_FIND, &entryFound);
+
+	if (taskStatsEntry != NULL)
+	{
+		if (!entryFound)
+		{
+			taskStatsEntry->inFlightTaskCount = 0;
+			taskStatsEntry->averageTaskTimeMicrosecs = 0;
+			taskStatsEntry->lastTaskFinishTime = 0;
+		}
+
+		taskStatsEntry->inFlightTaskCount =
+			Max(taskStatsEntry->inFlightTaskCount + delta, 0);
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->sharedNodeTaskStatsHashLock);
+}
+
+
+/*
+ * FindLocalNodeTaskCount returns the backend-local in-flight task count of
+ * the given node, or NULL if there is none and createIfMissing is false.
+ */
+static LocalNodeTaskCount *
+FindLocalNodeTaskCount(const char *hostname, int port, bool createIfMissing)
+{
+	LocalNodeTaskCount *localTaskCount = NULL;
+	foreach_ptr(localTaskCount, LocalNodeTaskCountList)
+	{
+		if (localTaskCount->port == port &&
+			strncmp(localTaskCount->hostname, hostname, MAX_NODE_LENGTH) == 0)
+		{
+			return localTaskCount;
+		}
+	}
+
+	if (!createIfMissing)
+	{
+		return NULL;
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(TopMemoryContext);
+
+	localTaskCount = palloc0(sizeof(LocalNodeTaskCount));
+	strlcpy(localTaskCount->hostname, hostname, MAX_NODE_LENGTH);
+	localTaskCount->port = port;
+
+	LocalNodeTaskCountList = lappend(LocalNodeTaskCountList, localTaskCount);
+
+	MemoryContextSwitchTo(oldContext);
+
+	return localTaskCount;
+}
+
+
+/*
+ * InitNodeTaskStatsHashKey fills the key of the task stats hash for the given
+ * node.
+ */
+static void
+InitNodeTaskStatsHashKey(SharedConnStatsHashKey *key, const char *hostname, int port)
+{
+	memset(key, 0, sizeof(SharedConnStatsHashKey));
+	strlcpy(key->hostname, hostname, MAX_NODE_LENGTH);
+	key->port = port;
+	key->databaseOid = InvalidOid;
+}
+
+
 /*
  * AdaptiveConnectionManagementFlag returns the appropriate connection flag,
  * regarding the adaptive connection management, based on the given
@@ -169,6 +169,7 @@
 #include "distributed/relation_access_tracking.h"
 #include "distributed/remote_commands.h"
 #include "distributed/repartition_join_execution.h"
+#include "distributed/repartitioned_aggregate.h"
 #include "distributed/resource_lock.h"
 #include "distributed/shared_connection_stats.h"
 #include "distributed/subplan_execution.h"
@@ -314,6 +315,18 @@ typedef struct DistributedExecution
 	 * fail, such as CREATE INDEX CONCURRENTLY.
 	 */
 	bool localExecutionSupported;
+
+	/*
+	 * When interleaveLocalExecution is set, the tasks in localTaskList are
+	 * executed one by one while waiting for the results of the remote tasks,
+	 * instead of after the remote execution finished. executedLocalTaskCount
+	 * is the number of tasks at the start of localTaskList that were already
+	 * executed, and scanState is the scan state that the tasks are executed
+	 * for.
+	 */
+	bool interleaveLocalExecution;
+	int executedLocalTaskCount;
+	CitusScanState *scanState;
 } DistributedExecution;
 
 
@@ -502,6 +515,9 @@ int ExecutorSlowStartInterval = 10;
 bool EnableCostBasedConnectionEstablishment = true;
 bool PreventIncompleteConnectionEstablishment = true;
 
+/* GUC, determining whether local tasks run while waiting for remote results */
+bool EnableInterleavedLocalExecution = false;
+
 
 /*
  * TaskExecutionState indicates whether or not a command on a shard
@@ -627,6 +643,9 @@ typedef struct TaskPlacementExecution
 	/* execution time statistics for this placement execution */
 	instr_time startTime;
 	instr_time endTime;
+
+	/* whether the execution is counted in the shared task stats of the node */
+	bool countedInNodeTaskStats;
 } TaskPlacementExecution;
 
 
@@ -648,6 +667,10 @@ static TransactionProperties DecideTransactionPropertiesForTaskList(RowModifyLev
 																	exludeFromTransaction);
 static void StartDistributedExecution(DistributedExecution *execution);
 static void RunLocalExecution(CitusScanState *scanState, DistributedExecution *execution);
+static void RunLocalTaskList(CitusScanState *scanState, DistributedExecution *execution,
+							 List *localTaskList);
+static bool ShouldRunLocalTaskWhileWaiting(DistributedExecution *execution);
+static bool HasConnectionEstablishmentInProgress(DistributedExecution *execution);
 static void RunDistributedExecution(DistributedExecution *execution);
 static void SequentialRunDistributedExecution(DistributedExecution *execution);
 static void FinishDistributedExecution(DistributedExecution *execution);
@@ -809,6 +832,15 @@ AdaptiveExecutor(CitusScanState *scanState)
 
 	bool localExecutionSupported = true;
 
+	if (distributedPlan->repartitionedAggregateQuery != NULL)
+	{
+		/* partial aggregates are repartitioned via intermediate results */
+		UseCoordinatedTransaction();
+
+		/* finalize the groups of each partition on the workers */
+		taskList = RepartitionedAggregateTaskList(distributedPlan, taskList);
+	}
+
 	if (RequestedForExplainAnalyze(scanState))
 	{
 		/*
@@ -880,13 +912,31 @@ AdaptiveExecutor(CitusScanState *scanState)
 	}
 	else
 	{
+		/*
+		 * Read-only local tasks do not depend on the remote tasks, so we can
+		 * execute them while the remote tasks are in flight, such that the
+		 * query does not take the remote time plus the local time.
+		 */
+		execution->scanState = scanState;
+		execution->interleaveLocalExecution =
+			EnableInterleavedLocalExecution &&
+			!DistributedExecutionModifiesDatabase(execution);
+
 		RunDistributedExecution(execution);
+
+		if (execution->executedLocalTaskCount > 0)
+		{
+			ereport(DEBUG1, (errmsg("executed local tasks while waiting for remote "
+									"tasks")));
+		}
+
+		execution->interleaveLocalExecution = false;
 	}
 
 	/* execute tasks local to the node (if any) */
-	if (list_length(execution->localTaskList) > 0)
+	if (list_length(execution->localTaskList) > execution->executedLocalTaskCount)
 	{
-		/* now execute the local tasks */
+		/* now execute the remaining local tasks */
 		RunLocalExecution(scanState, execution);
 	}
 
@@ -910,23 +960,39 @@ AdaptiveExecutor(CitusScanState *scanState)
 
 
 /*
- * RunLocalExecution runs the localTaskList in the execution, fills the tuplestore
+ * RunLocalExecution runs the tasks in the localTaskList of the execution that
+ * were not yet executed while waiting for remote results, fills the tuplestore
  * and sets the es_processed if necessary.
- *
- * It also sorts the tuplestore if there are no remote tasks remaining.
  */
 static void
 RunLocalExecution(CitusScanState *scanState, DistributedExecution *execution)
+{
+	List *remainingLocalTaskList = list_copy_tail(execution->localTaskList,
+												  execution->executedLocalTaskCount);
+
+	RunLocalTaskList(scanState, execution, remainingLocalTaskList);
+}
+
+
+/*
+ * RunLocalTaskList executes the given tasks from the localTaskList of the
+ * execution, which should directly follow the tasks that were already
+ * executed.
+ */
+static void
+RunLocalTaskList(CitusScanState *scanState, DistributedExecution *execution,
+				 List *localTaskList)
 {
 	EState *estate = ScanStateGetExecutorState(scanState);
 	bool isUtilityCommand = false;
-	uint64 rowsProcessed = ExecuteLocalTaskListExtended(execution->localTaskList,
+	uint64 rowsProcessed = ExecuteLocalTaskListExtended(localTaskList,
 														estate->es_param_list_info,
 														scanState->distributedPlan,
 														execution->defaultTupleDest,
 														isUtilityCommand);
 
 	execution->rowsProcessed += rowsProcessed;
+	execution->executedLocalTaskCount += list_length(localTaskList);
 }
 
 
@@ -1984,14 +2050,29 @@ RunDistributedExecution(DistributedExecution *execution)
 				continue;
 			}
 
+			/*
+			 * If there are local tasks to execute, we only check for I/O events
+			 * that are ready and execute a local task when there are none.
+			 */
+			bool runLocalTask = ShouldRunLocalTaskWhileWaiting(execution);
+
 			/* wait for I/O events */
-			long timeout = NextEventTimeout(execution);
+			long timeout = runLocalTask ? 0 : NextEventTimeout(execution);
 			int eventCount =
 				WaitEventSetWait(execution->waitEventSet, timeout, execution->events,
 								 execution->eventSetSize, WAIT_EVENT_CLIENT_READ);
 
 			ProcessWaitEvents(execution, execution->events, eventCount,
 							  &cancellationReceived);
+
+			if (runLocalTask && eventCount == 0 && !cancellationReceived)
+			{
+				Task *localTask = list_nth(execution->localTaskList,
+										   execution->executedLocalTaskCount);
+
+				RunLocalTaskList(execution->scanState, execution,
+								 list_make1(localTask));
+			}
 		}
 
 		FreeExecutionWaitEvents(execution);
@@ -2059,6 +2140,53 @@ ProcessSessionsWithFailedWaitEventSetOperations(DistributedExecution *execution)
 }
 
 
+/*
+ * ShouldRunLocalTaskWhileWaiting returns whether the distributed execution
+ * should execute one of its local tasks while the remote tasks are in flight.
+ *
+ * We wait until the connections are established, such that the remote tasks
+ * are sent before we get busy with a local task.
+ */
+static bool
+ShouldRunLocalTaskWhileWaiting(DistributedExecution *execution)
+{
+	if (!execution->interleaveLocalExecution)
+	{
+		return false;
+	}
+
+	if (list_length(execution->localTaskList) <= execution->executedLocalTaskCount)
+	{
+		return false;
+	}
+
+	return !HasConnectionEstablishmentInProgress(execution);
+}
+
+
+/*
+ * HasConnectionEstablishmentInProgress returns true if any of the connections
+ * of the execution is still being established, irrespective of
+ * citus.prevent_incomplete_connection_establishment.
+ */
+static bool
+HasConnectionEstablishmentInProgress(DistributedExecution *execution)
+{
+	WorkerSession *session = NULL;
+	foreach_ptr(session, execution->sessionList)
+	{
+		MultiConnection *connection = session->connection;
+		if (connection->connectionState == MULTI_CONNECTION_INITIAL ||
+			connection->connectionState == MULTI_CONNECTION_CONNECTING)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * HasIncompleteConnectionEstablishment returns true if any of the connections
  * that has been initiated by the executor is in initialization stage.
@@ -3889,6 +4017,13 @@ StartPlacementExecutionOnSession(TaskPlacementExecution *placementExecution,
 	{
 		session->commandsSent++;
 
+		if (TaskAssignmentPolicy == TASK_ASSIGNMENT_ADAPTIVE)
+		{
+			/* let the adaptive task assignment policy know about the load */
+			IncrementNodeInFlightTaskCount(workerPool->nodeName, workerPool->nodePort);
+			placementExecution->countedInNodeTaskStats = true;
+		}
+
 		if (workerPool->poolToLocalNode)
 		{
 			/*
@@ -4360,6 +4495,19 @@ PlacementExecutionDone(TaskPlacementExecution *placementExecution, bool succeede
 		return;
 	}
 
+	if (placementExecution->countedInNodeTaskStats)
+	{
+		/* report the load to the adaptive task assignment policy */
+		instr_time now;
+		INSTR_TIME_SET_CURRENT(now);
+
+		uint64 durationMicrosecs =
+			MicrosecondsBetweenTimestamps(placementExecution->startTime, now);
+		RecordNodeTaskCompletion(workerPool->nodeName, workerPool->nodePort,
+								 durationMicrosecs, succeeded);
+		placementExecution->countedInNodeTaskStats = false;
+	}
+
 	if (succeeded)
 	{
 		/* mark the placement execution as finished */
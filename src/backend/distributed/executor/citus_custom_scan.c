@@ -33,6 +33,7 @@
 #include "distributed/deparse_shard_query.h"
 #include "distributed/distributed_execution_locks.h"
 #include "distributed/function_call_delegation.h"
+#include "distributed/hash_helpers.h"
 #include "distributed/insert_select_executor.h"
 #include "distributed/insert_select_planner.h"
 #include "distributed/listutils.h"
@@ -44,6 +45,7 @@
 #include "distributed/multi_router_planner.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/query_stats.h"
+#include "distributed/shard_pruning.h"
 #include "distributed/shard_utils.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/worker_log_messages.h"
@@ -65,6 +67,8 @@ static void CitusBeginModifyScan(CustomScanState *node, EState *estate, int efla
 static void CitusPreExecScan(CitusScanState *scanState);
 static bool ModifyJobNeedsEvaluation(Job *workerJob);
 static void RegenerateTaskForFasthPathQuery(Job *workerJob);
+static void PruneTaskListUsingParameters(Job *workerJob, ParamListInfo paramListInfo);
+static bool TaskAccessesAnyShard(Task *task, HTAB *shardIdSet);
 static void RegenerateTaskListForInsert(Job *workerJob);
 static DistributedPlan * CopyDistributedPlanWithoutCache(
 	DistributedPlan *originalDistributedPlan);
@@ -262,7 +266,17 @@ CitusExecScan(CustomScanState *node)
 
 	if (!scanState->finishedRemoteScan)
 	{
-		AdaptiveExecutor(scanState);
+		/*
+		 * The remote tasks of subplans may have been executed together with
+		 * other independent subplans, in which case the results are ready.
+		 */
+		scanState->tuplestorestate =
+			ClaimPrefetchedSubPlanResult(scanState->distributedPlan);
+
+		if (scanState->tuplestorestate == NULL)
+		{
+			AdaptiveExecutor(scanState);
+		}
 
 		scanState->finishedRemoteScan = true;
 	}
@@ -282,6 +296,21 @@ CitusBeginReadOnlyScan(CustomScanState *node, EState *estate, int eflags)
 
 	Assert(originalDistributedPlan->workerJob->jobQuery->commandType == CMD_SELECT);
 
+	if (originalDistributedPlan->workerJob->shardPruningRelationIdList != NIL)
+	{
+		/*
+		 * Multi-shard plans that were created without parameter values are
+		 * pruned for the current execution on a copy of the generic plan.
+		 */
+		DistributedPlan *currentPlan =
+			CopyDistributedPlanWithoutCache(originalDistributedPlan);
+		scanState->distributedPlan = currentPlan;
+
+		PruneTaskListUsingParameters(currentPlan->workerJob,
+									 estate->es_param_list_info);
+		return;
+	}
+
 	if (!originalDistributedPlan->workerJob->deferredPruning)
 	{
 		/*
@@ -623,6 +652,91 @@ RegenerateTaskListForInsert(Job *workerJob)
 }
 
 
+/*
+ * PruneTaskListUsingParameters removes the tasks of a multi-shard job that was
+ * planned without parameter values, for which none of the shards remain after
+ * pruning with the parameter values of the current execution. The parameters
+ * are still sent along with the queries of the remaining tasks.
+ */
+static void
+PruneTaskListUsingParameters(Job *workerJob, ParamListInfo paramListInfo)
+{
+	HTAB *requiredShardIdSet = CreateSimpleHashSetWithName(uint64,
+														   "required shard id set");
+	ListCell *relationIdCell = NULL;
+	ListCell *rangeTableIdCell = NULL;
+	ListCell *restrictionCell = NULL;
+
+	/* force evaluation of bound params */
+	ParamListInfo boundParams = copyParamList(paramListInfo);
+
+	forthree(relationIdCell, workerJob->shardPruningRelationIdList,
+			 rangeTableIdCell, workerJob->shardPruningRangeTableIdList,
+			 restrictionCell, workerJob->shardPruningRestrictionList)
+	{
+		Oid relationId = lfirst_oid(relationIdCell);
+		Index rangeTableId = lfirst_int(rangeTableIdCell);
+		Node *restrictionList = (Node *) lfirst(restrictionCell);
+
+		/*
+		 * Replace the parameters with their values and fold the constants
+		 * such that, for instance, IN lists become constant arrays. Parameters
+		 * without a value are ignored by PruneShards.
+		 */
+		Node *resolvedRestrictions = ResolveExternalParams(restrictionList,
+														   boundParams);
+		List *restrictClauseList =
+			(List *) eval_const_expressions(NULL, resolvedRestrictions);
+
+		List *prunedShardList = PruneShards(relationId, rangeTableId,
+											restrictClauseList, NULL);
+
+		ShardInterval *shardInterval = NULL;
+		foreach_ptr(shardInterval, prunedShardList)
+		{
+			hash_search(requiredShardIdSet, &shardInterval->shardId, HASH_ENTER, NULL);
+		}
+	}
+
+	List *prunedTaskList = NIL;
+	Task *task = NULL;
+	foreach_ptr(task, workerJob->taskList)
+	{
+		if (TaskAccessesAnyShard(task, requiredShardIdSet))
+		{
+			prunedTaskList = lappend(prunedTaskList, task);
+		}
+	}
+
+	workerJob->taskList = prunedTaskList;
+
+	hash_destroy(requiredShardIdSet);
+}
+
+
+/*
+ * TaskAccessesAnyShard returns whether the task accesses any of the shards
+ * in the given set.
+ */
+static bool
+TaskAccessesAnyShard(Task *task, HTAB *shardIdSet)
+{
+	RelationShard *relationShard = NULL;
+	foreach_ptr(relationShard, task->relationShardList)
+	{
+		bool found = false;
+		hash_search(shardIdSet, &relationShard->shardId, HASH_FIND, &found);
+
+		if (found)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * RegenerateTaskForFasthPathQuery does the shard pruning for
  * UPDATE/DELETE/SELECT fast path router queries and rebuilds the query strings.
@@ -66,7 +66,8 @@ static List * WrapTasksForPartitioning(const char *resultIdPrefix,
 									   List *selectTaskList,
 									   int partitionColumnIndex,
 									   CitusTableCacheEntry *targetRelation,
-									   bool binaryFormat);
+									   bool binaryFormat,
+									   bool allowNullPartitionColumnValues);
 static List * ExecutePartitionTaskList(List *partitionTaskList,
 									   CitusTableCacheEntry *targetRelation);
 static PartitioningTupleDest * CreatePartitioningTupleDest(
@@ -105,13 +106,14 @@ static void ExecuteFetchTaskList(List *fetchTaskList);
  * correspond to targetRelation->sortedShardIntervalArray[shardIndex].
  *
  * partitionColumnIndex determines the column in the selectTaskList to use for
- * partitioning.
+ * partitioning. If allowNullPartitionColumnValues is true, rows with a NULL
+ * partition column value go to the first shard rather than raising an error.
  */
 List **
 RedistributeTaskListResults(const char *resultIdPrefix, List *selectTaskList,
 							int partitionColumnIndex,
 							CitusTableCacheEntry *targetRelation,
-							bool binaryFormat)
+							bool binaryFormat, bool allowNullPartitionColumnValues)
 {
 	/*
 	 * Make sure that this transaction has a distributed transaction ID.
@@ -123,7 +125,8 @@ RedistributeTaskListResults(const char *resultIdPrefix, List *selectTaskList,
 
 	List *fragmentList = PartitionTasklistResults(resultIdPrefix, selectTaskList,
 												  partitionColumnIndex,
-												  targetRelation, binaryFormat);
+												  targetRelation, binaryFormat,
+												  allowNullPartitionColumnValues);
 	return ColocateFragmentsWithRelation(fragmentList, targetRelation);
 }
 
@@ -146,7 +149,7 @@ List *
 PartitionTasklistResults(const char *resultIdPrefix, List *selectTaskList,
 						 int partitionColumnIndex,
 						 CitusTableCacheEntry *targetRelation,
-						 bool binaryFormat)
+						 bool binaryFormat, bool allowNullPartitionColumnValues)
 {
 	if (!IsCitusTableTypeCacheEntry(targetRelation, HASH_DISTRIBUTED) &&
 		!IsCitusTableTypeCacheEntry(targetRelation, RANGE_DISTRIBUTED))
@@ -166,7 +169,8 @@ PartitionTasklistResults(const char *resultIdPrefix, List *selectTaskList,
 
 	selectTaskList = WrapTasksForPartitioning(resultIdPrefix, selectTaskList,
 											  partitionColumnIndex, targetRelation,
-											  binaryFormat);
+											  binaryFormat,
+											  allowNullPartitionColumnValues);
 	return ExecutePartitionTaskList(selectTaskList, targetRelation);
 }
 
@@ -180,7 +184,7 @@ static List *
 WrapTasksForPartitioning(const char *resultIdPrefix, List *selectTaskList,
 						 int partitionColumnIndex,
 						 CitusTableCacheEntry *targetRelation,
-						 bool binaryFormat)
+						 bool binaryFormat, bool allowNullPartitionColumnValues)
 {
 	List *wrappedTaskList = NIL;
 	ShardInterval **shardIntervalArray = targetRelation->sortedShardIntervalArray;
@@ -213,6 +217,9 @@ WrapTasksForPartitioning(const char *resultIdPrefix, List *selectTaskList,
 									  "hash" : "range";
 		const char *binaryFormatString = binaryFormat ? "true" : "false";
 
+		/* only pass allow_null_partition_column when it differs from the default */
+		const char *allowNullString = allowNullPartitionColumnValues ? ",true" : "";
+
 		Task *wrappedSelectTask = copyObject(selectTask);
 
 		StringInfo wrappedQuery = makeStringInfo();
@@ -221,14 +228,14 @@ WrapTasksForPartitioning(const char *resultIdPrefix, List *selectTaskList,
 						 ", %s || '_' || partition_index::text "
 						 ", rows_written "
 						 "FROM worker_partition_query_result"
-						 "(%s,%s,%d,%s,%s,%s,%s) WHERE rows_written > 0",
+						 "(%s,%s,%d,%s,%s,%s,%s%s) WHERE rows_written > 0",
 						 quote_literal_cstr(taskPrefix),
 						 quote_literal_cstr(taskPrefix),
 						 quote_literal_cstr(TaskQueryString(selectTask)),
 						 partitionColumnIndex,
 						 quote_literal_cstr(partitionMethodString),
 						 minValuesString->data, maxValuesString->data,
-						 binaryFormatString);
+						 binaryFormatString, allowNullString);
 
 		SetTaskQueryString(wrappedSelectTask, wrappedQuery->data);
 		wrappedTaskList = lappend(wrappedTaskList, wrappedSelectTask);
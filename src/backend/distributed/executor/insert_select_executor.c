@@ -172,11 +172,13 @@ NonPushableInsertSelectExecScan(CustomScanState *node)
 				WrapTaskListForProjection(distSelectTaskList, projectedTargetEntries);
 			}
 
+			bool allowNullPartitionColumnValues = false;
 			List **redistributedResults = RedistributeTaskListResults(distResultPrefix,
 																	  distSelectTaskList,
 																	  distributionColumnIndex,
 																	  targetRelation,
-																	  binaryFormat);
+																	  binaryFormat,
+																	  allowNullPartitionColumnValues);
 
 			/*
 			 * At this point select query has been executed on workers and results
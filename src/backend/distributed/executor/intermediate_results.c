@@ -44,10 +44,15 @@
 #include "distributed/tuplestore.h"
 #include "distributed/utils/array_type.h"
 #include "distributed/utils/directory.h"
+#include "distributed/utils/stream_compression.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_protocol.h"
 
 
+/* compression settings for intermediate results, set via GUCs */
+int IntermediateResultCompression = STREAM_COMPRESSION_NONE;
+int IntermediateResultCompressionThreshold = 64;
+
 static List *CreatedResultsDirectories = NIL;
 
 
@@ -80,6 +85,10 @@ typedef struct RemoteFileDestReceiver
 	CopyOutState copyOutState;
 	FmgrInfo *columnOutputFunctions;
 
+	/* compression state, NULL if the result is not compressed */
+	CompressionStream *compressionStream;
+	StringInfo compressedData;
+
 	/* statistics */
 	uint64 tuplesSent;
 	uint64 bytesSent;
@@ -100,6 +109,8 @@ static void RemoteFileDestReceiverStartup(DestReceiver *dest, int operation,
 static void PrepareIntermediateResultBroadcast(RemoteFileDestReceiver *resultDest);
 static StringInfo ConstructCopyResultStatement(const char *resultId);
 static bool RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
+static int WriteIntermediateResultData(RemoteFileDestReceiver *resultDest,
+									   StringInfo dataBuffer);
 static void BroadcastCopyData(StringInfo dataBuffer, List *connectionList);
 static void SendCopyDataOverConnection(StringInfo dataBuffer,
 									   MultiConnection *connection);
@@ -112,6 +123,8 @@ static void ReadIntermediateResultsIntoFuncOutput(FunctionCallInfo fcinfo,
 												  Datum *resultIdArray,
 												  int resultCount);
 static uint64 FetchRemoteIntermediateResult(MultiConnection *connection, char *resultId);
+static bool LocalIntermediateResultsExist(Datum *resultIdArray, int resultCount,
+										  int64 *totalBytes);
 static CopyStatus CopyDataFromConnection(MultiConnection *connection,
 										 FileCompat *fileCompat,
 										 uint64 *bytesReceived);
@@ -237,6 +250,25 @@ CreateRemoteFileDestReceiver(const char *resultId, EState *executorState,
 }
 
 
+/*
+ * CreateIntermediateResultCompressionStream returns a compression stream for
+ * writing an intermediate result according to citus.intermediate_result_compression,
+ * or NULL if intermediate results should not be compressed.
+ */
+CompressionStream *
+CreateIntermediateResultCompressionStream(void)
+{
+	if (IntermediateResultCompression == STREAM_COMPRESSION_NONE)
+	{
+		return NULL;
+	}
+
+	uint64 thresholdBytes = (uint64) IntermediateResultCompressionThreshold * 1024;
+
+	return CreateCompressionStream(IntermediateResultCompression, thresholdBytes);
+}
+
+
 /*
  * RemoteFileDestReceiverBytesSent returns number of bytes sent per remote worker.
  */
@@ -276,6 +308,9 @@ RemoteFileDestReceiverStartup(DestReceiver *dest, int operation,
 
 	resultDest->columnOutputFunctions = ColumnOutputFunctions(inputTupleDescriptor,
 															  copyOutState->binary);
+
+	resultDest->compressionStream = CreateIntermediateResultCompressionStream();
+	resultDest->compressedData = makeStringInfo();
 }
 
 
@@ -350,20 +385,15 @@ PrepareIntermediateResultBroadcast(RemoteFileDestReceiver *resultDest)
 		PQclear(result);
 	}
 
+	resultDest->connectionList = connectionList;
+
 	if (copyOutState->binary)
 	{
 		/* send headers when using binary encoding */
 		resetStringInfo(copyOutState->fe_msgbuf);
 		AppendCopyBinaryHeaders(copyOutState);
-		BroadcastCopyData(copyOutState->fe_msgbuf, connectionList);
-
-		if (resultDest->writeLocalFile)
-		{
-			WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
-		}
+		WriteIntermediateResultData(resultDest, copyOutState->fe_msgbuf);
 	}
-
-	resultDest->connectionList = connectionList;
 }
 
 
@@ -404,7 +434,6 @@ RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 
 	TupleDesc tupleDescriptor = resultDest->tupleDescriptor;
 
-	List *connectionList = resultDest->connectionList;
 	CopyOutState copyOutState = resultDest->copyOutState;
 	FmgrInfo *columnOutputFunctions = resultDest->columnOutputFunctions;
 
@@ -425,19 +454,13 @@ RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 	AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
 					  copyOutState, columnOutputFunctions, NULL);
 
-	/* send row to nodes */
-	BroadcastCopyData(copyData, connectionList);
-
-	/* write to local file (if applicable) */
-	if (resultDest->writeLocalFile)
-	{
-		WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
-	}
+	/* send row to nodes and write to local file (if applicable) */
+	int bytesWritten = WriteIntermediateResultData(resultDest, copyData);
 
 	MemoryContextSwitchTo(oldContext);
 
 	resultDest->tuplesSent++;
-	resultDest->bytesSent += copyData->len;
+	resultDest->bytesSent += bytesWritten;
 
 	ResetPerTupleExprContext(executorState);
 
@@ -445,6 +468,42 @@ RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 }
 
 
+/*
+ * WriteIntermediateResultData sends the given bytes to all nodes and writes them
+ * to the local file (if applicable). If the result is compressed, the bytes go
+ * through the compression stream first and only the compressed bytes that are
+ * ready are sent. Returns the number of bytes that were sent.
+ */
+static int
+WriteIntermediateResultData(RemoteFileDestReceiver *resultDest, StringInfo dataBuffer)
+{
+	if (resultDest->compressionStream != NULL)
+	{
+		StringInfo compressedData = resultDest->compressedData;
+
+		resetStringInfo(compressedData);
+		CompressionStreamWrite(resultDest->compressionStream, dataBuffer->data,
+							   dataBuffer->len, compressedData);
+
+		dataBuffer = compressedData;
+	}
+
+	if (dataBuffer->len == 0)
+	{
+		return 0;
+	}
+
+	BroadcastCopyData(dataBuffer, resultDest->connectionList);
+
+	if (resultDest->writeLocalFile)
+	{
+		WriteToLocalFile(dataBuffer, &resultDest->fileCompat);
+	}
+
+	return dataBuffer->len;
+}
+
+
 /*
  * WriteToLocalResultsFile writes the bytes in a StringInfo to a local file.
  */
@@ -491,11 +550,27 @@ RemoteFileDestReceiverShutdown(DestReceiver *destReceiver)
 		/* send footers when using binary encoding */
 		resetStringInfo(copyOutState->fe_msgbuf);
 		AppendCopyBinaryFooters(copyOutState);
-		BroadcastCopyData(copyOutState->fe_msgbuf, connectionList);
+		WriteIntermediateResultData(resultDest, copyOutState->fe_msgbuf);
+	}
+
+	if (resultDest->compressionStream != NULL)
+	{
+		/* flush the remaining (possibly uncompressed) bytes */
+		StringInfo compressedData = resultDest->compressedData;
+
+		resetStringInfo(compressedData);
+		CompressionStreamFinish(resultDest->compressionStream, compressedData);
 
-		if (resultDest->writeLocalFile)
+		if (compressedData->len > 0)
 		{
-			WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
+			BroadcastCopyData(compressedData, connectionList);
+
+			if (resultDest->writeLocalFile)
+			{
+				WriteToLocalFile(compressedData, &resultDest->fileCompat);
+			}
+
+			resultDest->bytesSent += compressedData->len;
 		}
 	}
 
@@ -921,6 +996,15 @@ fetch_intermediate_results(PG_FUNCTION_ARGS)
 	 */
 	EnsureDistributedTransactionId();
 
+	/*
+	 * The results may already have been pushed to this node, for instance by
+	 * a streaming repartition join, in which case there is nothing to fetch.
+	 */
+	if (LocalIntermediateResultsExist(resultIdArray, resultCount, &totalBytesWritten))
+	{
+		PG_RETURN_INT64(totalBytesWritten);
+	}
+
 	MultiConnection *connection = GetNodeConnection(connectionFlags, remoteHost,
 													remotePort);
 
@@ -950,6 +1034,35 @@ fetch_intermediate_results(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * LocalIntermediateResultsExist returns whether all of the given intermediate
+ * results exist on this node and if so, sets totalBytes to their total size.
+ */
+static bool
+LocalIntermediateResultsExist(Datum *resultIdArray, int resultCount, int64 *totalBytes)
+{
+	int64 localBytes = 0;
+
+	for (int resultIndex = 0; resultIndex < resultCount; resultIndex++)
+	{
+		char *resultId = TextDatumGetCString(resultIdArray[resultIndex]);
+		char *localPath = QueryResultFileName(resultId);
+
+		struct stat fileStat;
+		if (stat(localPath, &fileStat) != 0)
+		{
+			return false;
+		}
+
+		localBytes += fileStat.st_size;
+	}
+
+	*totalBytes = localBytes;
+
+	return true;
+}
+
+
 /*
  * FetchRemoteIntermediateResult fetches a remote intermediate result over
  * the given connection.
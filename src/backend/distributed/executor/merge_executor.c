@@ -161,10 +161,12 @@ ExecuteSourceAtWorkerAndRepartition(CitusScanState *scanState)
 	 * targetRelation, and then colocates the result files with shards. These
 	 * transfers are done by calls to fetch_intermediate_results() between nodes.
 	 */
+	bool allowNullPartitionColumnValues = false;
 	List **redistributedResults =
 		RedistributeTaskListResults(distResultPrefix,
 									distSourceTaskList, partitionColumnIndex,
-									targetRelation, binaryFormat);
+									targetRelation, binaryFormat,
+									allowNullPartitionColumnValues);
 
 	ereport(DEBUG1, (errmsg("Executing final MERGE on workers using "
 							"intermediate results")));
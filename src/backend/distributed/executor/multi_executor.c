@@ -10,6 +10,8 @@
 
 #include "postgres.h"
 
+#include "safe_lib.h"
+
 #include "miscadmin.h"
 
 #include "access/xact.h"
@@ -23,6 +25,7 @@
 #include "nodes/nodeFuncs.h"
 #include "parser/parse_oper.h"
 #include "parser/parsetree.h"
+#include "storage/fd.h"
 #include "storage/lmgr.h"
 #include "tcop/dest.h"
 #include "tcop/pquery.h"
@@ -51,6 +54,8 @@
 #include "distributed/relation_access_tracking.h"
 #include "distributed/resource_lock.h"
 #include "distributed/transaction_management.h"
+#include "distributed/utils/shard_load_stats.h"
+#include "distributed/utils/stream_compression.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_protocol.h"
 #include "distributed/worker_shard_visibility.h"
@@ -92,9 +97,21 @@ bool SortReturning = false;
  */
 int ExecutorLevel = 0;
 
+/*
+ * State of the compressed file that is currently being read by
+ * ReadFileIntoTupleStore, used in ReadCompressedFileCallback.
+ */
+static FILE *CompressedFile = NULL;
+static DecompressionStream *CompressedFileStream = NULL;
+static StringInfo DecompressedFileData = NULL;
+static char *CompressedFileReadBuffer = NULL;
+static bool CompressedFileAtEnd = false;
+
 
 /* local function forward declarations */
 static Relation StubRelation(TupleDesc tupleDescriptor);
+static bool IsCompressedFile(char *fileName);
+static int ReadCompressedFileCallback(void *outBuf, int minRead, int maxRead);
 static char * GetObjectTypeString(ObjectType objType);
 static bool AlterTableConstraintCheck(QueryDesc *queryDesc);
 static List * FindCitusCustomScanStates(PlanState *planState);
@@ -177,6 +194,9 @@ CitusExecutorRun(QueryDesc *queryDesc,
 	Instrumentation *volatile totalTime = queryDesc->totaltime;
 	queryDesc->totaltime = NULL;
 
+	/* whether we measure the load of this query on the shards it accesses */
+	volatile bool measureShardLoad = false;
+
 	PG_TRY();
 	{
 		ExecutorLevel++;
@@ -235,7 +255,15 @@ CitusExecutorRun(QueryDesc *queryDesc,
 			/* postgres will switch here again and will restore back on its own */
 			MemoryContextSwitchTo(oldcontext);
 
+			measureShardLoad = StartShardLoadMeasurement(queryDesc);
+
 			standard_ExecutorRun(queryDesc, direction, count, execute_once);
+
+			if (measureShardLoad)
+			{
+				EndShardLoadMeasurement();
+				measureShardLoad = false;
+			}
 		}
 
 		if (totalTime)
@@ -274,6 +302,11 @@ CitusExecutorRun(QueryDesc *queryDesc,
 			queryDesc->totaltime = totalTime;
 		}
 
+		if (measureShardLoad)
+		{
+			CancelShardLoadMeasurement();
+		}
+
 		executorBoundParams = savedBoundParams;
 		ExecutorLevel--;
 
@@ -455,9 +488,35 @@ ReadFileIntoTupleStore(char *fileName, char *copyFormat, TupleDesc tupleDescript
 									  location);
 	copyOptions = lappend(copyOptions, copyOption);
 
-	CopyFromState copyState = BeginCopyFrom(NULL, stubRelation, NULL,
-											fileName, false, NULL,
-											NULL, copyOptions);
+	CopyFromState copyState = NULL;
+	bool compressedFile = IsCompressedFile(fileName);
+
+	if (compressedFile)
+	{
+		/*
+		 * Set the decompression state as global variables since the data
+		 * source callback of COPY does not take any arguments.
+		 */
+		CompressedFile = AllocateFile(fileName, PG_BINARY_R);
+		if (CompressedFile == NULL)
+		{
+			ereport(ERROR, (errcode_for_file_access(),
+							errmsg("could not open file \"%s\": %m", fileName)));
+		}
+
+		CompressedFileStream = CreateDecompressionStream();
+		DecompressedFileData = makeStringInfo();
+		CompressedFileReadBuffer = palloc(STREAM_COMPRESSION_FRAME_SIZE);
+		CompressedFileAtEnd = false;
+
+		copyState = BeginCopyFrom(NULL, stubRelation, NULL, NULL, false,
+								  ReadCompressedFileCallback, NULL, copyOptions);
+	}
+	else
+	{
+		copyState = BeginCopyFrom(NULL, stubRelation, NULL, fileName, false, NULL,
+								  NULL, copyOptions);
+	}
 
 	while (true)
 	{
@@ -479,6 +538,93 @@ ReadFileIntoTupleStore(char *fileName, char *copyFormat, TupleDesc tupleDescript
 	EndCopyFrom(copyState);
 	pfree(columnValues);
 	pfree(columnNulls);
+
+	if (compressedFile)
+	{
+		FreeFile(CompressedFile);
+		CompressedFile = NULL;
+	}
+}
+
+
+/*
+ * IsCompressedFile returns whether the given file starts with the header of
+ * a compressed stream, as written when citus.intermediate_result_compression
+ * is enabled.
+ */
+static bool
+IsCompressedFile(char *fileName)
+{
+	char header[STREAM_COMPRESSION_MAGIC_LENGTH];
+
+	FILE *file = AllocateFile(fileName, PG_BINARY_R);
+	if (file == NULL)
+	{
+		ereport(ERROR, (errcode_for_file_access(),
+						errmsg("could not open file \"%s\": %m", fileName)));
+	}
+
+	size_t bytesRead = fread(header, 1, STREAM_COMPRESSION_MAGIC_LENGTH, file);
+
+	FreeFile(file);
+
+	return bytesRead == STREAM_COMPRESSION_MAGIC_LENGTH &&
+		   memcmp(header, STREAM_COMPRESSION_MAGIC,
+				  STREAM_COMPRESSION_MAGIC_LENGTH) == 0;
+}
+
+
+/*
+ * ReadCompressedFileCallback is the data source callback of COPY when reading
+ * a compressed file. It reads and decompresses the file until at least minRead
+ * bytes are available (or the end of the file is reached) and copies up to
+ * maxRead bytes into outBuf.
+ */
+static int
+ReadCompressedFileCallback(void *outBuf, int minRead, int maxRead)
+{
+	StringInfo decompressedData = DecompressedFileData;
+
+	if (decompressedData->cursor == decompressedData->len)
+	{
+		resetStringInfo(decompressedData);
+	}
+
+	while (decompressedData->len - decompressedData->cursor < minRead &&
+		   !CompressedFileAtEnd)
+	{
+		size_t bytesRead = fread(CompressedFileReadBuffer, 1,
+								 STREAM_COMPRESSION_FRAME_SIZE, CompressedFile);
+		if (bytesRead == 0)
+		{
+			if (ferror(CompressedFile))
+			{
+				ereport(ERROR, (errcode_for_file_access(),
+								errmsg("could not read compressed file: %m")));
+			}
+
+			DecompressionStreamFinish(CompressedFileStream, decompressedData);
+			CompressedFileAtEnd = true;
+		}
+		else
+		{
+			DecompressionStreamWrite(CompressedFileStream, CompressedFileReadBuffer,
+									 bytesRead, decompressedData);
+		}
+	}
+
+	int availableBytes = decompressedData->len - decompressedData->cursor;
+	int bytesToRead = Min(availableBytes, maxRead);
+
+	if (bytesToRead > 0)
+	{
+		memcpy_s(outBuf, bytesToRead,
+				 &decompressedData->data[decompressedData->cursor], bytesToRead);
+	}
+
+	decompressedData->cursor += bytesToRead;
+
+	return bytesToRead;
 }
 
 
@@ -25,16 +25,24 @@
 #include "nodes/primnodes.h"
 #include "tcop/pquery.h"
 #include "tcop/tcopprot.h"
+#include "utils/guc.h"
 #include "utils/typcache.h"
 
+#include "distributed/commands/multi_copy.h"
+#include "distributed/connection_management.h"
 #include "distributed/intermediate_results.h"
+#include "distributed/listutils.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/metadata_utility.h"
 #include "distributed/multi_executor.h"
 #include "distributed/pg_dist_shard.h"
 #include "distributed/remote_commands.h"
+#include "distributed/remote_transaction.h"
+#include "distributed/string_utils.h"
+#include "distributed/transaction_management.h"
 #include "distributed/tuplestore.h"
 #include "distributed/utils/array_type.h"
+#include "distributed/utils/bloom_filter.h"
 #include "distributed/utils/function.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_protocol.h"
@@ -94,9 +102,51 @@ typedef struct PartitionedResultDestReceiver
 
 	/* whether NULL partition column values are allowed */
 	bool allowNullPartitionColumnValues;
+
+	/*
+	 * Optional bloom filter of the join keys on the other side of an inner
+	 * join. Rows whose partition column value is not in the filter are
+	 * skipped.
+	 */
+	BloomFilter *bloomFilter;
+	FmgrInfo *bloomFilterHashFunction;
+	Oid bloomFilterCollation;
 } PartitionedResultDestReceiver;
 
+
+/*
+ * BloomFilterDestReceiver is used for adding the values of a column of the
+ * streamed tuples to a bloom filter.
+ */
+typedef struct BloomFilterDestReceiver
+{
+	/* public DestReceiver interface */
+	DestReceiver pub;
+
+	int columnIndex;
+	FmgrInfo *hashFunction;
+	Oid collation;
+	BloomFilter *bloomFilter;
+
+	/* stop once the filter would contain more than maxRows rows */
+	int64 maxRows;
+	int64 rowCount;
+	bool maxRowsExceeded;
+} BloomFilterDestReceiver;
+
 static Portal StartPortalForQueryExecution(const char *queryString);
+static FmgrInfo * ColumnHashFunction(Oid columnType);
+static void SetPartitionedResultBloomFilter(DestReceiver *dest, BloomFilter *bloomFilter,
+											Var *partitionColumn);
+static bool PartitionColumnValueInBloomFilter(PartitionedResultDestReceiver *self,
+											  Datum partitionColumnValue);
+static void BloomFilterDestReceiverStartup(DestReceiver *dest, int operation,
+										   TupleDesc inputTupleDescriptor);
+static bool BloomFilterDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
+static void BloomFilterDestReceiverShutdown(DestReceiver *dest);
+static void BloomFilterDestReceiverDestroy(DestReceiver *dest);
+static void PushPartitionsToTargetNodes(const char *resultIdPrefix, DestReceiver **dests,
+										int partitionCount, List *targetNodeIdList);
 static void PartitionedResultDestReceiverStartup(DestReceiver *dest, int operation,
 												 TupleDesc inputTupleDescriptor);
 static bool PartitionedResultDestReceiverReceive(TupleTableSlot *slot,
@@ -106,11 +156,28 @@ static void PartitionedResultDestReceiverDestroy(DestReceiver *copyDest);
 
 /* exports for SQL callable functions */
 PG_FUNCTION_INFO_V1(worker_partition_query_result);
+PG_FUNCTION_INFO_V1(worker_build_bloom_filter);
 
 
 /*
  * worker_partition_query_result executes a query and writes the results into a
  * set of local files according to the partition scheme and the partition column.
+ *
+ * Optionally, the IDs of the nodes that consume each partition can be passed
+ * in target_node_ids. Partitions that are consumed by another node are then
+ * kept in memory and pushed to that node once the query finishes, rather than
+ * being written to a local file that the target node needs to fetch. Partitions
+ * that do not fit in memory are still written to a local file.
+ *
+ * Optionally, a bloom filter of the join keys on the other side of an inner
+ * join can be passed in bloom_filter, in which case rows whose partition column
+ * value cannot have a join partner are skipped.
+ *
+ * Optionally, the compression method and threshold for the result files can be
+ * passed in compression and compression_threshold, which otherwise follow the
+ * citus.intermediate_result_compression settings of this session. The node
+ * that plans a repartition join passes its own settings, since the results are
+ * written here.
  */
 Datum
 worker_partition_query_result(PG_FUNCTION_ARGS)
@@ -148,6 +215,31 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 	bool allowNullPartitionColumnValues = PG_GETARG_BOOL(7);
 	bool generateEmptyResults = PG_GETARG_BOOL(8);
 
+	/* older versions of the UDF do not have the target_node_ids argument */
+	List *targetNodeIdList = NIL;
+	if (PG_NARGS() > 9)
+	{
+		targetNodeIdList = IntegerArrayTypeToList(PG_GETARG_ARRAYTYPE_P(9));
+	}
+
+	BloomFilter *bloomFilter = NULL;
+	if (PG_NARGS() > 10)
+	{
+		bytea *bloomFilterBytea = PG_GETARG_BYTEA_PP(10);
+		if (VARSIZE_ANY_EXHDR(bloomFilterBytea) > 0)
+		{
+			bloomFilter = BloomFilterFromBytea(bloomFilterBytea);
+		}
+	}
+
+	char *compressionMethod = "";
+	int compressionThreshold = 0;
+	if (PG_NARGS() > 12)
+	{
+		compressionMethod = text_to_cstring(PG_GETARG_TEXT_P(11));
+		compressionThreshold = PG_GETARG_INT32(12);
+	}
+
 	if (!IsMultiStatementTransaction())
 	{
 		ereport(ERROR, (errmsg("worker_partition_query_result can only be used in a "
@@ -179,6 +271,25 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 						errmsg("number of partitions cannot be 0")));
 	}
 
+	if (list_length(targetNodeIdList) > partitionCount)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("target node ids cannot have more elements than "
+							   "the min and max values")));
+	}
+
+	/* the file dest receivers read the compression settings when they start */
+	int saveNestLevel = NewGUCNestLevel();
+
+	if (compressionMethod[0] != '\0')
+	{
+		set_config_option("citus.intermediate_result_compression", compressionMethod,
+						  PGC_USERSET, PGC_S_SESSION, GUC_ACTION_LOCAL, true, 0, false);
+		set_config_option("citus.intermediate_result_compression_threshold",
+						  ConvertIntToString(compressionThreshold),
+						  PGC_USERSET, PGC_S_SESSION, GUC_ACTION_LOCAL, true, 0, false);
+	}
+
 	/* start execution early in order to extract the tuple descriptor */
 	Portal portal = StartPortalForQueryExecution(queryString);
 
@@ -214,14 +325,25 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 	MemoryContext tupleContext = GetPerTupleMemoryContext(estate);
 
 	/* create all dest receivers */
+	int32 localNodeId = targetNodeIdList != NIL ? GetLocalNodeId() : 0;
 	DestReceiver **dests = palloc0(partitionCount * sizeof(DestReceiver *));
 	for (int partitionIndex = 0; partitionIndex < partitionCount; partitionIndex++)
 	{
 		StringInfo resultId = makeStringInfo();
 		appendStringInfo(resultId, "%s_%d", resultIdPrefixString, partitionIndex);
 		char *filePath = QueryResultFileName(resultId->data);
+
+		/* keep partitions in memory if they are pushed to another node */
+		bool bufferInMemory = false;
+		if (partitionIndex < list_length(targetNodeIdList))
+		{
+			int targetNodeId = list_nth_int(targetNodeIdList, partitionIndex);
+			bufferInMemory = targetNodeId != 0 && targetNodeId != localNodeId;
+		}
+
 		DestReceiver *partitionDest = CreateFileDestReceiver(filePath, tupleContext,
-															 binaryCopy);
+															 binaryCopy,
+															 bufferInMemory);
 		dests[partitionIndex] = partitionDest;
 	}
 
@@ -241,9 +363,22 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 		lazyStartup,
 		allowNullPartitionColumnValues);
 
+	if (bloomFilter != NULL)
+	{
+		SetPartitionedResultBloomFilter(dest, bloomFilter, partitionColumn);
+	}
+
 	/* execute the query */
 	PortalRun(portal, FETCH_ALL, false, true, dest, dest, NULL);
 
+	if (targetNodeIdList != NIL)
+	{
+		PushPartitionsToTargetNodes(resultIdPrefixString, dests, partitionCount,
+									targetNodeIdList);
+	}
+
+	AtEOXact_GUC(true, saveNestLevel);
+
 	/* construct the output result */
 	TupleDesc returnTupleDesc = NULL;
 	Tuplestorestate *tupleStore = SetupTuplestore(fcinfo, &returnTupleDesc);
@@ -260,6 +395,13 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 
 		FileDestReceiverStats(dests[partitionIndex], &recordsWritten, &bytesWritten);
 
+		/* partitions kept in memory were written on their target node instead */
+		StringInfo memoryBuffer = FileDestReceiverMemoryBuffer(dests[partitionIndex]);
+		if (memoryBuffer != NULL)
+		{
+			bytesWritten += memoryBuffer->len;
+		}
+
 		memset(values, 0, sizeof(values));
 		memset(nulls, 0, sizeof(nulls));
 
@@ -278,6 +420,165 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * worker_build_bloom_filter executes a query and returns a bloom filter of
+ * the values in the given column, or NULL if the query returns more than
+ * max_rows rows.
+ */
+Datum
+worker_build_bloom_filter(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+
+	text *queryText = PG_GETARG_TEXT_P(0);
+	char *queryString = text_to_cstring(queryText);
+	int columnIndex = PG_GETARG_INT32(1);
+	int64 bitCount = PG_GETARG_INT64(2);
+	int32 hashCount = PG_GETARG_INT32(3);
+	int64 maxRows = PG_GETARG_INT64(4);
+
+	if (bitCount <= 0 || hashCount <= 0 || maxRows < 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("bit count and hash count must be positive and "
+							   "max rows cannot be negative")));
+	}
+
+	Portal portal = StartPortalForQueryExecution(queryString);
+
+	TupleDesc tupleDescriptor = portal->tupDesc;
+	if (tupleDescriptor == NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("query must generate a set of rows")));
+	}
+
+	if (columnIndex < 0 || columnIndex >= tupleDescriptor->natts)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("column index must be between 0 and %d",
+							   tupleDescriptor->natts - 1)));
+	}
+
+	FormData_pg_attribute *columnAttr = TupleDescAttr(tupleDescriptor, columnIndex);
+
+	BloomFilterDestReceiver *dest = palloc0(sizeof(BloomFilterDestReceiver));
+	dest->pub.receiveSlot = BloomFilterDestReceiverReceive;
+	dest->pub.rStartup = BloomFilterDestReceiverStartup;
+	dest->pub.rShutdown = BloomFilterDestReceiverShutdown;
+	dest->pub.rDestroy = BloomFilterDestReceiverDestroy;
+	dest->pub.mydest = DestNone;
+	dest->columnIndex = columnIndex;
+	dest->hashFunction = ColumnHashFunction(columnAttr->atttypid);
+	dest->collation = columnAttr->attcollation;
+	dest->bloomFilter = CreateBloomFilter(bitCount, hashCount);
+	dest->maxRows = maxRows;
+
+	PortalRun(portal, FETCH_ALL, false, true, (DestReceiver *) dest,
+			  (DestReceiver *) dest, NULL);
+	PortalDrop(portal, false);
+
+	if (dest->maxRowsExceeded)
+	{
+		PG_RETURN_NULL();
+	}
+
+	PG_RETURN_BYTEA_P(BloomFilterToBytea(dest->bloomFilter));
+}
+
+
+/*
+ * ColumnHashFunction returns the hash function of the given type, which is
+ * the same function that is used for hash partitioning.
+ */
+static FmgrInfo *
+ColumnHashFunction(Oid columnType)
+{
+	TypeCacheEntry *typeEntry = lookup_type_cache(columnType,
+												  TYPECACHE_HASH_PROC_FINFO);
+
+	if (!OidIsValid(typeEntry->hash_proc_finfo.fn_oid))
+	{
+		ereport(ERROR, (errmsg("no hash function defined for type %s",
+							   format_type_be(columnType))));
+	}
+
+	FmgrInfo *hashFunction = palloc0(sizeof(FmgrInfo));
+	fmgr_info_copy(hashFunction, &(typeEntry->hash_proc_finfo), CurrentMemoryContext);
+
+	return hashFunction;
+}
+
+
+/*
+ * BloomFilterDestReceiverStartup implements the rStartup interface of
+ * BloomFilterDestReceiver.
+ */
+static void
+BloomFilterDestReceiverStartup(DestReceiver *dest, int operation,
+							   TupleDesc inputTupleDescriptor)
+{
+	/* nothing to do */
+}
+
+
+/*
+ * BloomFilterDestReceiverReceive implements the receiveSlot interface of
+ * BloomFilterDestReceiver. It adds the column value to the bloom filter and
+ * stops the execution once more than maxRows rows have been received.
+ */
+static bool
+BloomFilterDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
+{
+	BloomFilterDestReceiver *self = (BloomFilterDestReceiver *) dest;
+
+	self->rowCount++;
+	if (self->rowCount > self->maxRows)
+	{
+		self->maxRowsExceeded = true;
+
+		/* returning false stops the execution */
+		return false;
+	}
+
+	bool isNull = false;
+	Datum columnValue = slot_getattr(slot, self->columnIndex + 1, &isNull);
+
+	/* NULL values never have a join partner */
+	if (!isNull)
+	{
+		Datum hashDatum = FunctionCall1Coll(self->hashFunction, self->collation,
+											columnValue);
+
+		BloomFilterAdd(self->bloomFilter, DatumGetUInt32(hashDatum));
+	}
+
+	return true;
+}
+
+
+/*
+ * BloomFilterDestReceiverShutdown implements the rShutdown interface of
+ * BloomFilterDestReceiver.
+ */
+static void
+BloomFilterDestReceiverShutdown(DestReceiver *dest)
+{
+	/* nothing to do */
+}
+
+
+/*
+ * BloomFilterDestReceiverDestroy implements the rDestroy interface of
+ * BloomFilterDestReceiver.
+ */
+static void
+BloomFilterDestReceiverDestroy(DestReceiver *dest)
+{
+	/* nothing to do */
+}
+
+
 /*
  * StartPortalForQueryExecution creates and starts a portal which can be
  * used for running the given query.
@@ -304,6 +605,165 @@ StartPortalForQueryExecution(const char *queryString)
 }
 
 
+/*
+ * PushPartitionsToTargetNodes sends the partitions that were kept in memory to
+ * their target nodes as intermediate results. At most one connection is used
+ * per target node and the partitions are sent to different nodes in parallel.
+ *
+ * The remote transactions remain open until the current transaction ends, such
+ * that the intermediate results are available for the rest of the distributed
+ * transaction.
+ */
+static void
+PushPartitionsToTargetNodes(const char *resultIdPrefix, DestReceiver **dests,
+							int partitionCount, List *targetNodeIdList)
+{
+	List *nodeIdList = NIL;
+	List *connectionList = NIL;
+	List **partitionIndexLists = palloc0(partitionCount * sizeof(List *));
+
+	for (int partitionIndex = 0; partitionIndex < partitionCount; partitionIndex++)
+	{
+		if (FileDestReceiverMemoryBuffer(dests[partitionIndex]) == NULL)
+		{
+			/* partition was written to a local file, or not at all */
+			continue;
+		}
+
+		int targetNodeId = list_nth_int(targetNodeIdList, partitionIndex);
+		int nodeIndex = 0;
+		int nodeId = 0;
+
+		foreach_int(nodeId, nodeIdList)
+		{
+			if (nodeId == targetNodeId)
+			{
+				break;
+			}
+
+			nodeIndex++;
+		}
+
+		if (nodeIndex == list_length(nodeIdList))
+		{
+			/* results need to be visible to the rest of the distributed transaction */
+			if (connectionList == NIL)
+			{
+				UseCoordinatedTransaction();
+			}
+
+			WorkerNode *workerNode = LookupNodeByNodeIdOrError(targetNodeId);
+			int connectionFlags = 0;
+
+			MultiConnection *connection = StartNodeConnection(connectionFlags,
+															  workerNode->workerName,
+															  workerNode->workerPort);
+			ClaimConnectionExclusively(connection);
+			MarkRemoteTransactionCritical(connection);
+
+			nodeIdList = lappend_int(nodeIdList, targetNodeId);
+			connectionList = lappend(connectionList, connection);
+		}
+
+		partitionIndexLists[nodeIndex] = lappend_int(partitionIndexLists[nodeIndex],
+													 partitionIndex);
+	}
+
+	if (connectionList == NIL)
+	{
+		return;
+	}
+
+	FinishConnectionListEstablishment(connectionList);
+
+	/* must open transaction blocks to use intermediate results */
+	RemoteTransactionsBeginIfNecessary(connectionList);
+
+	/* in each round, send the next partition for each of the nodes */
+	bool partitionsRemaining = true;
+	for (int roundIndex = 0; partitionsRemaining; roundIndex++)
+	{
+		List *roundConnectionList = NIL;
+		List *roundPartitionIndexList = NIL;
+		int nodeIndex = 0;
+
+		MultiConnection *connection = NULL;
+		foreach_ptr(connection, connectionList)
+		{
+			List *partitionIndexList = partitionIndexLists[nodeIndex++];
+			if (roundIndex >= list_length(partitionIndexList))
+			{
+				continue;
+			}
+
+			int partitionIndex = list_nth_int(partitionIndexList, roundIndex);
+			StringInfo copyCommand = makeStringInfo();
+			appendStringInfo(copyCommand,
+							 "COPY \"%s_%d\" FROM STDIN WITH (format result)",
+							 resultIdPrefix, partitionIndex);
+
+			if (!SendRemoteCommand(connection, copyCommand->data))
+			{
+				ReportConnectionError(connection, ERROR);
+			}
+
+			roundConnectionList = lappend(roundConnectionList, connection);
+			roundPartitionIndexList = lappend_int(roundPartitionIndexList,
+												  partitionIndex);
+		}
+
+		partitionsRemaining = roundConnectionList != NIL;
+
+		ListCell *connectionCell = NULL;
+		ListCell *partitionIndexCell = NULL;
+		forboth(connectionCell, roundConnectionList,
+				partitionIndexCell, roundPartitionIndexList)
+		{
+			connection = (MultiConnection *) lfirst(connectionCell);
+			int partitionIndex = lfirst_int(partitionIndexCell);
+			bool raiseInterrupts = true;
+
+			PGresult *result = GetRemoteCommandResult(connection, raiseInterrupts);
+			if (PQresultStatus(result) != PGRES_COPY_IN)
+			{
+				ReportResultError(connection, result, ERROR);
+			}
+
+			PQclear(result);
+
+			StringInfo partitionData =
+				FileDestReceiverMemoryBuffer(dests[partitionIndex]);
+			if (!PutRemoteCopyData(connection, partitionData->data,
+								   partitionData->len) ||
+				!PutRemoteCopyEnd(connection, NULL))
+			{
+				ReportConnectionError(connection, ERROR);
+			}
+		}
+
+		foreach_ptr(connection, roundConnectionList)
+		{
+			bool raiseInterrupts = true;
+
+			PGresult *result = GetRemoteCommandResult(connection, raiseInterrupts);
+			if (PQresultStatus(result) != PGRES_COMMAND_OK)
+			{
+				ReportCopyError(connection, result);
+			}
+
+			PQclear(result);
+			ForgetResults(connection);
+		}
+	}
+
+	MultiConnection *connection = NULL;
+	foreach_ptr(connection, connectionList)
+	{
+		UnclaimConnection(connection);
+	}
+}
+
+
 /*
  * QueryTupleShardSearchInfo returns a CitusTableCacheEntry which has enough
  * information so that FindShardInterval() can find the shard corresponding
@@ -429,6 +889,38 @@ CreatePartitionedResultDestReceiver(int partitionColumnIndex,
 }
 
 
+/*
+ * SetPartitionedResultBloomFilter makes the given partitioned dest receiver
+ * skip rows whose partition column value is not in the bloom filter.
+ */
+static void
+SetPartitionedResultBloomFilter(DestReceiver *dest, BloomFilter *bloomFilter,
+								Var *partitionColumn)
+{
+	PartitionedResultDestReceiver *self = (PartitionedResultDestReceiver *) dest;
+
+	self->bloomFilter = bloomFilter;
+	self->bloomFilterHashFunction = ColumnHashFunction(partitionColumn->vartype);
+	self->bloomFilterCollation = partitionColumn->varcollid;
+}
+
+
+/*
+ * PartitionColumnValueInBloomFilter returns whether the given partition column
+ * value may be in the bloom filter of the dest receiver.
+ */
+static bool
+PartitionColumnValueInBloomFilter(PartitionedResultDestReceiver *self,
+								  Datum partitionColumnValue)
+{
+	Datum hashDatum = FunctionCall1Coll(self->bloomFilterHashFunction,
+										self->bloomFilterCollation,
+										partitionColumnValue);
+
+	return BloomFilterContains(self->bloomFilter, DatumGetUInt32(hashDatum));
+}
+
+
 /*
  * PartitionedResultDestReceiverStartup implements the rStartup interface of
  * PartitionedResultDestReceiver.
@@ -475,6 +967,17 @@ PartitionedResultDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 
 	int partitionIndex;
 
+	if (self->bloomFilter != NULL)
+	{
+		/* the bloom filter is only used for inner joins, NULLs never match */
+		if (columnNulls[self->partitionColumnIndex] ||
+			!PartitionColumnValueInBloomFilter(self,
+											   columnValues[self->partitionColumnIndex]))
+		{
+			return true;
+		}
+	}
+
 	if (columnNulls[self->partitionColumnIndex])
 	{
 		if (self->allowNullPartitionColumnValues)
@@ -13,6 +13,14 @@
  * - It creates schemas in each worker in a single transaction to store intermediate results.
  * - It iterates all tasks and finds the ones whose dependencies are already executed, and executes them with
  *  adaptive executor logic.
+ * - When citus.enable_streaming_repartition_joins is enabled, map tasks are told on which
+ *  nodes their partitions are consumed, such that they can push the partitions to those nodes
+ *  instead of having the fetch tasks pull them afterwards.
+ * - When the plan contains bloom filter tasks for an inner dual partition join, it builds a
+ *  bloom filter of the join keys on the smaller side and passes it to the map tasks of the
+ *  other side, which then skip rows that have no join partner.
+ * - When citus.intermediate_result_compression is enabled, it passes the compression settings
+ *  to the map tasks, which write the partitions on the workers.
  *
  *
  * Repartition queries do not begin a transaction even if we are in
@@ -28,26 +36,65 @@
 #include "miscadmin.h"
 
 #include "access/hash.h"
+#include "catalog/pg_type.h"
+#include "executor/tuptable.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/tuplestore.h"
 
 #include "distributed/adaptive_executor.h"
+#include "distributed/deparse_shard_query.h"
 #include "distributed/directed_acyclic_graph_execution.h"
 #include "distributed/hash_helpers.h"
+#include "distributed/intermediate_results.h"
 #include "distributed/listutils.h"
 #include "distributed/local_executor.h"
 #include "distributed/metadata_cache.h"
+#include "distributed/multi_executor.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/repartition_join_execution.h"
 #include "distributed/task_execution_utils.h"
 #include "distributed/transaction_management.h"
 #include "distributed/transmit.h"
+#include "distributed/tuple_destination.h"
+#include "distributed/utils/bloom_filter.h"
 #include "distributed/worker_manager.h"
 #include "distributed/worker_transaction.h"
 
 
+/*
+ * MapTaskTargetNodes keeps track of the nodes on which the partitions of a map
+ * task are consumed.
+ */
+typedef struct MapTaskTargetNodes
+{
+	Task *mapTask;
+
+	/* node IDs indexed by partition ID, 0 for partitions that are not fetched */
+	int partitionCount;
+	int *targetNodeIds;
+} MapTaskTargetNodes;
+
+
+/* config variable managed via guc.c */
+bool EnableStreamingRepartitionJoins = false;
+
+
 static List * ExtractJobsInJobTree(Job *job);
 static void TraverseJobTree(Job *curJob, List **jobs);
+static bool ShouldStreamMapTaskOutputs(void);
+static List * StreamMapTaskOutputsToMergeNodes(List *allTasks);
+static MapTaskTargetNodes * FindMapTaskTargetNodes(List *targetNodesList, Task *mapTask);
+static char * TargetNodeIdsArgument(MapTaskTargetNodes *targetNodes);
+static List * FilterMapTasksByBloomFilters(Job *topLevelJob, List *allTasks);
+static void ExtractJobPointersInJobTree(Job *job, List **jobList);
+static void BuildJoinBloomFilters(MapMergeJob *leftJob, MapMergeJob *rightJob,
+								  BloomFilter **leftFilter, BloomFilter **rightFilter);
+static List * AddBloomFilterToMapTasks(List *allTasks, uint64 jobId,
+									   BloomFilter *bloomFilter);
+static List * AddCompressionToMapTasks(List *allTasks);
+static char * MapQueryStringWithArgument(Task *mapTask, char *argumentString);
 
 
 /*
@@ -61,6 +108,19 @@ ExecuteDependentTasks(List *topLevelTasks, Job *topLevelJob)
 	List *allTasks = CreateTaskListForJobTree(topLevelTasks);
 	List *jobIds = ExtractJobsInJobTree(topLevelJob);
 
+	if (ShouldStreamMapTaskOutputs())
+	{
+		allTasks = StreamMapTaskOutputsToMergeNodes(allTasks);
+	}
+
+	/* bloom filters and compression are passed as named arguments, so add them last */
+	allTasks = FilterMapTasksByBloomFilters(topLevelJob, allTasks);
+
+	if (IntermediateResultCompression != STREAM_COMPRESSION_NONE)
+	{
+		allTasks = AddCompressionToMapTasks(allTasks);
+	}
+
 	ExecuteTasksInDependencyOrder(allTasks, topLevelTasks, jobIds);
 
 	return jobIds;
@@ -98,3 +158,471 @@ TraverseJobTree(Job *curJob, List **jobIds)
 		TraverseJobTree(childJob, jobIds);
 	}
 }
+
+
+/*
+ * ShouldStreamMapTaskOutputs returns whether map tasks should push their
+ * partitions to the nodes that consume them.
+ *
+ * Pushing partitions opens transactions from the map task nodes to the merge
+ * nodes, which cannot be part of a prepared transaction. We therefore only
+ * stream map outputs for top-level statements that are not part of a bigger
+ * transaction, in which case the repartition join does not share the worker
+ * transactions with modifications.
+ */
+static bool
+ShouldStreamMapTaskOutputs(void)
+{
+	if (!EnableStreamingRepartitionJoins)
+	{
+		return false;
+	}
+
+	if (IsMultiStatementTransaction() || ExecutorLevel > 1)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * StreamMapTaskOutputsToMergeNodes returns a copy of the given task list in which
+ * the map tasks pass the nodes on which each partition is consumed to
+ * worker_partition_query_result. The map tasks then push the partitions to those
+ * nodes right after partitioning, after which the map output fetch tasks find
+ * the results locally and skip copying them over.
+ *
+ * The tasks may belong to a cached plan, hence we replace the map tasks by
+ * modified copies rather than changing them in place. The other tasks refer to
+ * the map tasks by job and task ID, so they do not need to be changed.
+ */
+static List *
+StreamMapTaskOutputsToMergeNodes(List *allTasks)
+{
+	List *targetNodesList = NIL;
+
+	Task *task = NULL;
+	foreach_ptr(task, allTasks)
+	{
+		if (task->taskType != MAP_OUTPUT_FETCH_TASK ||
+			list_length(task->dependentTaskList) != 1 ||
+			list_length(task->taskPlacementList) != 1)
+		{
+			continue;
+		}
+
+		Task *mapTask = (Task *) linitial(task->dependentTaskList);
+		ShardPlacement *mergePlacement = linitial(task->taskPlacementList);
+
+		MapTaskTargetNodes *targetNodes = FindMapTaskTargetNodes(targetNodesList,
+																 mapTask);
+		if (targetNodes == NULL)
+		{
+			targetNodes = palloc0(sizeof(MapTaskTargetNodes));
+			targetNodes->mapTask = mapTask;
+
+			targetNodesList = lappend(targetNodesList, targetNodes);
+		}
+
+		if (task->partitionId >= targetNodes->partitionCount)
+		{
+			int newPartitionCount = task->partitionId + 1;
+			int *newTargetNodeIds = palloc0(newPartitionCount * sizeof(int));
+
+			for (int partitionId = 0; partitionId < targetNodes->partitionCount;
+				 partitionId++)
+			{
+				newTargetNodeIds[partitionId] = targetNodes->targetNodeIds[partitionId];
+			}
+
+			targetNodes->partitionCount = newPartitionCount;
+			targetNodes->targetNodeIds = newTargetNodeIds;
+		}
+
+		targetNodes->targetNodeIds[task->partitionId] = mergePlacement->nodeId;
+	}
+
+	List *streamingTaskList = NIL;
+	int streamingMapTaskCount = 0;
+
+	foreach_ptr(task, allTasks)
+	{
+		MapTaskTargetNodes *targetNodes = NULL;
+
+		if (task->taskType == MAP_TASK)
+		{
+			targetNodes = FindMapTaskTargetNodes(targetNodesList, task);
+		}
+
+		char *streamingQueryString = NULL;
+		if (targetNodes != NULL)
+		{
+			streamingQueryString =
+				MapQueryStringWithArgument(task, TargetNodeIdsArgument(targetNodes));
+		}
+
+		if (streamingQueryString == NULL)
+		{
+			streamingTaskList = lappend(streamingTaskList, task);
+			continue;
+		}
+
+		Task *streamingMapTask = palloc(sizeof(Task));
+		*streamingMapTask = *task;
+		SetTaskQueryString(streamingMapTask, streamingQueryString);
+
+		streamingTaskList = lappend(streamingTaskList, streamingMapTask);
+		streamingMapTaskCount++;
+	}
+
+	ereport(DEBUG1, (errmsg("pushing the partitions of %d map tasks to the nodes "
+							"that consume them", streamingMapTaskCount)));
+
+	return streamingTaskList;
+}
+
+
+/*
+ * FindMapTaskTargetNodes returns the MapTaskTargetNodes for the given map task,
+ * or NULL if there is none.
+ */
+static MapTaskTargetNodes *
+FindMapTaskTargetNodes(List *targetNodesList, Task *mapTask)
+{
+	MapTaskTargetNodes *targetNodes = NULL;
+	foreach_ptr(targetNodes, targetNodesList)
+	{
+		if (targetNodes->mapTask->jobId == mapTask->jobId &&
+			targetNodes->mapTask->taskId == mapTask->taskId)
+		{
+			return targetNodes;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * TargetNodeIdsArgument returns the target_node_ids argument of
+ * worker_partition_query_result for the given target nodes.
+ */
+static char *
+TargetNodeIdsArgument(MapTaskTargetNodes *targetNodes)
+{
+	StringInfo argumentString = makeStringInfo();
+	appendStringInfoString(argumentString, "'{");
+
+	for (int partitionId = 0; partitionId < targetNodes->partitionCount; partitionId++)
+	{
+		appendStringInfo(argumentString, "%s%d", partitionId > 0 ? "," : "",
+						 targetNodes->targetNodeIds[partitionId]);
+	}
+
+	appendStringInfoString(argumentString, "}'::int[]");
+
+	return argumentString->data;
+}
+
+
+/*
+ * FilterMapTasksByBloomFilters returns a copy of the given task list in which
+ * the map tasks of one side of each inner dual partition join that has bloom
+ * filter tasks are given a bloom filter of the join keys on the other side.
+ *
+ * The bloom filters of both sides are built, such that we can filter the
+ * larger side by the keys of the smaller side. A side only gets a filter if it
+ * has at most citus.repartition_join_bloom_filter_max_rows rows, in which case
+ * building the filter stops early.
+ */
+static List *
+FilterMapTasksByBloomFilters(Job *topLevelJob, List *allTasks)
+{
+	List *jobList = NIL;
+	ExtractJobPointersInJobTree(topLevelJob, &jobList);
+
+	Job *job = NULL;
+	foreach_ptr(job, jobList)
+	{
+		if (list_length(job->dependentJobList) != 2)
+		{
+			continue;
+		}
+
+		MapMergeJob *leftJob = (MapMergeJob *) linitial(job->dependentJobList);
+		MapMergeJob *rightJob = (MapMergeJob *) lsecond(job->dependentJobList);
+
+		if (!CitusIsA(leftJob, MapMergeJob) || !CitusIsA(rightJob, MapMergeJob) ||
+			leftJob->bloomFilterTaskList == NIL ||
+			rightJob->bloomFilterTaskList == NIL)
+		{
+			continue;
+		}
+
+		/* both sides need to hash the join keys the same way */
+		if (leftJob->partitionColumn->vartype != rightJob->partitionColumn->vartype ||
+			leftJob->partitionColumn->varcollid != rightJob->partitionColumn->varcollid)
+		{
+			continue;
+		}
+
+		BloomFilter *leftFilter = NULL;
+		BloomFilter *rightFilter = NULL;
+		BuildJoinBloomFilters(leftJob, rightJob, &leftFilter, &rightFilter);
+
+		if (leftFilter != NULL &&
+			(rightFilter == NULL || leftFilter->elementCount <= rightFilter->elementCount))
+		{
+			allTasks = AddBloomFilterToMapTasks(allTasks, rightJob->job.jobId,
+												leftFilter);
+		}
+		else if (rightFilter != NULL)
+		{
+			allTasks = AddBloomFilterToMapTasks(allTasks, leftJob->job.jobId,
+												rightFilter);
+		}
+	}
+
+	return allTasks;
+}
+
+
+/*
+ * ExtractJobPointersInJobTree adds all jobs in the job tree where the given
+ * job is root to the job list.
+ */
+static void
+ExtractJobPointersInJobTree(Job *job, List **jobList)
+{
+	*jobList = lappend(*jobList, job);
+
+	Job *childJob = NULL;
+	foreach_ptr(childJob, job->dependentJobList)
+	{
+		ExtractJobPointersInJobTree(childJob, jobList);
+	}
+}
+
+
+/*
+ * BuildJoinBloomFilters executes the bloom filter tasks of both sides of a
+ * join and combines the filters that are returned for each side. A filter is
+ * set to NULL if the side has too many rows.
+ */
+static void
+BuildJoinBloomFilters(MapMergeJob *leftJob, MapMergeJob *rightJob,
+					  BloomFilter **leftFilter, BloomFilter **rightFilter)
+{
+	List *taskList = list_concat(list_copy(leftJob->bloomFilterTaskList),
+								 rightJob->bloomFilterTaskList);
+
+	int resultColumnCount = 2;
+	TupleDesc tupleDescriptor = CreateTemplateTupleDesc(resultColumnCount);
+	TupleDescInitEntry(tupleDescriptor, (AttrNumber) 1, "job_id", INT8OID, -1, 0);
+	TupleDescInitEntry(tupleDescriptor, (AttrNumber) 2, "bloom_filter", BYTEAOID, -1,
+					   0);
+
+	Tuplestorestate *tupleStore = tuplestore_begin_heap(false, false, work_mem);
+	TupleDestination *tupleDest = CreateTupleStoreTupleDest(tupleStore, tupleDescriptor);
+
+	bool expectResults = true;
+	ExecuteTaskListIntoTupleDest(ROW_MODIFY_READONLY, taskList, tupleDest,
+								 expectResults);
+
+	bool leftTooLarge = false;
+	bool rightTooLarge = false;
+	BloomFilter *combinedLeftFilter = NULL;
+	BloomFilter *combinedRightFilter = NULL;
+
+	TupleTableSlot *slot = MakeSingleTupleTableSlot(tupleDescriptor,
+													&TTSOpsMinimalTuple);
+	bool goForward = true;
+	bool doCopy = false;
+
+	while (tuplestore_gettupleslot(tupleStore, goForward, doCopy, slot))
+	{
+		bool isNull = false;
+		uint64 jobId = DatumGetInt64(slot_getattr(slot, 1, &isNull));
+		Datum filterDatum = slot_getattr(slot, 2, &isNull);
+
+		bool isLeftJob = jobId == leftJob->job.jobId;
+		BloomFilter **combinedFilter = isLeftJob ? &combinedLeftFilter :
+									   &combinedRightFilter;
+		bool *tooLarge = isLeftJob ? &leftTooLarge : &rightTooLarge;
+
+		if (isNull)
+		{
+			*tooLarge = true;
+		}
+		else
+		{
+			BloomFilter *filter = BloomFilterFromBytea(DatumGetByteaPP(filterDatum));
+
+			if (*combinedFilter == NULL)
+			{
+				*combinedFilter = filter;
+			}
+			else
+			{
+				BloomFilterUnion(*combinedFilter, filter);
+			}
+		}
+
+		ExecClearTuple(slot);
+	}
+
+	ExecDropSingleTupleTableSlot(slot);
+	tuplestore_end(tupleStore);
+
+	if (!leftTooLarge && combinedLeftFilter != NULL &&
+		combinedLeftFilter->elementCount <= RepartitionJoinBloomFilterMaxRows)
+	{
+		*leftFilter = combinedLeftFilter;
+	}
+
+	if (!rightTooLarge && combinedRightFilter != NULL &&
+		combinedRightFilter->elementCount <= RepartitionJoinBloomFilterMaxRows)
+	{
+		*rightFilter = combinedRightFilter;
+	}
+}
+
+
+/*
+ * AddBloomFilterToMapTasks returns a copy of the given task list in which the
+ * map tasks of the given job pass the bloom filter to
+ * worker_partition_query_result. The filter is folded to the smallest size
+ * that still has a low false positive rate before it is sent to the workers.
+ */
+static List *
+AddBloomFilterToMapTasks(List *allTasks, uint64 jobId, BloomFilter *bloomFilter)
+{
+	BloomFilterFold(bloomFilter, BLOOM_FILTER_MIN_BIT_COUNT);
+
+	bytea *serializedFilter = BloomFilterToBytea(bloomFilter);
+	char *filterData = VARDATA_ANY(serializedFilter);
+	int filterLength = VARSIZE_ANY_EXHDR(serializedFilter);
+	const char *hexDigits = "0123456789abcdef";
+
+	StringInfo hexFilter = makeStringInfo();
+	appendStringInfoString(hexFilter, "\\x");
+
+	for (int byteIndex = 0; byteIndex < filterLength; byteIndex++)
+	{
+		unsigned char filterByte = (unsigned char) filterData[byteIndex];
+
+		appendStringInfoChar(hexFilter, hexDigits[filterByte >> 4]);
+		appendStringInfoChar(hexFilter, hexDigits[filterByte & 0xF]);
+	}
+
+	StringInfo argumentString = makeStringInfo();
+	appendStringInfo(argumentString, "bloom_filter => %s::bytea",
+					 quote_literal_cstr(hexFilter->data));
+
+	List *filteredTaskList = NIL;
+
+	Task *task = NULL;
+	foreach_ptr(task, allTasks)
+	{
+		char *filteredQueryString = NULL;
+
+		if (task->taskType == MAP_TASK && task->jobId == jobId)
+		{
+			filteredQueryString = MapQueryStringWithArgument(task,
+															 argumentString->data);
+		}
+
+		if (filteredQueryString == NULL)
+		{
+			filteredTaskList = lappend(filteredTaskList, task);
+			continue;
+		}
+
+		Task *filteredMapTask = palloc(sizeof(Task));
+		*filteredMapTask = *task;
+		SetTaskQueryString(filteredMapTask, filteredQueryString);
+
+		filteredTaskList = lappend(filteredTaskList, filteredMapTask);
+	}
+
+	return filteredTaskList;
+}
+
+
+/*
+ * AddCompressionToMapTasks returns a copy of the given task list in which the
+ * map tasks pass the citus.intermediate_result_compression settings of this
+ * session to worker_partition_query_result, which writes the partitions on
+ * the workers.
+ */
+static List *
+AddCompressionToMapTasks(List *allTasks)
+{
+	const char *compressionMethod =
+		GetConfigOption("citus.intermediate_result_compression", false, false);
+
+	StringInfo argumentString = makeStringInfo();
+	appendStringInfo(argumentString,
+					 "compression => %s, compression_threshold => %d",
+					 quote_literal_cstr(compressionMethod),
+					 IntermediateResultCompressionThreshold);
+
+	List *compressedTaskList = NIL;
+
+	Task *task = NULL;
+	foreach_ptr(task, allTasks)
+	{
+		char *compressedQueryString = NULL;
+
+		if (task->taskType == MAP_TASK)
+		{
+			compressedQueryString = MapQueryStringWithArgument(task,
+															   argumentString->data);
+		}
+
+		if (compressedQueryString == NULL)
+		{
+			compressedTaskList = lappend(compressedTaskList, task);
+			continue;
+		}
+
+		Task *compressedMapTask = palloc(sizeof(Task));
+		*compressedMapTask = *task;
+		SetTaskQueryString(compressedMapTask, compressedQueryString);
+
+		compressedTaskList = lappend(compressedTaskList, compressedMapTask);
+	}
+
+	return compressedTaskList;
+}
+
+
+/*
+ * MapQueryStringWithArgument returns the query string of the given map task
+ * with the given argument added as the last argument of
+ * worker_partition_query_result, or NULL if the query string does not have
+ * the expected shape.
+ */
+static char *
+MapQueryStringWithArgument(Task *mapTask, char *argumentString)
+{
+	char *mapQueryString = TaskQueryString(mapTask);
+	int mapQueryLength = strlen(mapQueryString);
+	int suffixLength = strlen(MAP_TASK_QUERY_SUFFIX);
+
+	if (mapQueryLength < suffixLength ||
+		strcmp(mapQueryString + mapQueryLength - suffixLength,
+			   MAP_TASK_QUERY_SUFFIX) != 0)
+	{
+		return NULL;
+	}
+
+	StringInfo newQueryString = makeStringInfo();
+	appendBinaryStringInfo(newQueryString, mapQueryString,
+						   mapQueryLength - suffixLength);
+	appendStringInfo(newQueryString, ",%s" MAP_TASK_QUERY_SUFFIX, argumentString);
+
+	return newQueryString->data;
+}
@@ -0,0 +1,106 @@
+/*-------------------------------------------------------------------------
+ *
+ * repartitioned_aggregate_execution.c
+ *
+ * Execution logic for aggregations of which the groups are finalized on the
+ * workers. The partial aggregates of the worker tasks are repartitioned by a
+ * group column using worker_partition_query_result() and colocated with the
+ * shards of a relation, after which a task per shard finalizes the groups of
+ * its partition from the intermediate results.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "nodes/parsenodes.h"
+
+#include "distributed/citus_ruleutils.h"
+#include "distributed/commands/multi_copy.h"
+#include "distributed/intermediate_results.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/multi_physical_planner.h"
+#include "distributed/recursive_planning.h"
+#include "distributed/repartitioned_aggregate.h"
+#include "distributed/resource_lock.h"
+
+
+/*
+ * RepartitionedAggregateTaskList repartitions the partial aggregates returned
+ * by the given worker tasks and returns the tasks that finalize the groups of
+ * each partition on the workers.
+ */
+List *
+RepartitionedAggregateTaskList(DistributedPlan *distributedPlan, List *taskList)
+{
+	Job *workerJob = distributedPlan->workerJob;
+	CitusTableCacheEntry *targetRelation =
+		GetCitusTableCacheEntry(distributedPlan->repartitionedAggregateRelationId);
+	int partitionColumnIndex = distributedPlan->repartitionedAggregateColumnIndex;
+	List *finalTaskList = NIL;
+	uint32 taskIdIndex = 1;
+
+	/*
+	 * Make a copy of the finalize query. We'll repeatedly replace the
+	 * subquery that reads the partial aggregates for different partitions
+	 * and then deparse it.
+	 */
+	Query *finalizeQuery = copyObject(distributedPlan->repartitionedAggregateQuery);
+	RangeTblEntry *partialAggregatesRTE = linitial(finalizeQuery->rtable);
+	List *partialAggregateTargetList = partialAggregatesRTE->subquery->targetList;
+	bool binaryFormat = CanUseBinaryCopyFormatForTargetList(partialAggregateTargetList);
+
+	/* include the job id in case the aggregation runs in a nested execution */
+	StringInfo resultPrefix = makeStringInfo();
+	appendStringInfo(resultPrefix, "repartitioned_aggregate_" UINT64_FORMAT,
+					 workerJob->jobId);
+
+	/* groups with a NULL partition column go into the first partition */
+	bool allowNullPartitionColumnValues = true;
+	List **partitionResultIds = RedistributeTaskListResults(resultPrefix->data,
+															taskList,
+															partitionColumnIndex,
+															targetRelation,
+															binaryFormat,
+															allowNullPartitionColumnValues);
+
+	int shardCount = targetRelation->shardIntervalArrayLength;
+	for (int shardIndex = 0; shardIndex < shardCount; shardIndex++)
+	{
+		ShardInterval *shardInterval = targetRelation->sortedShardIntervalArray[shardIndex];
+		List *resultIdList = partitionResultIds[shardIndex];
+		uint64 shardId = shardInterval->shardId;
+
+		/* skip partitions without groups */
+		if (resultIdList == NIL)
+		{
+			continue;
+		}
+
+		/* sort result ids for consistent test output */
+		List *sortedResultIds = SortList(resultIdList, pg_qsort_strcmp);
+
+		partialAggregatesRTE->subquery =
+			BuildReadIntermediateResultsArrayQuery(partialAggregateTargetList, NIL,
+												   sortedResultIds, binaryFormat);
+
+		StringInfo queryString = makeStringInfo();
+		pg_get_query_def(finalizeQuery, queryString);
+		ereport(DEBUG4, (errmsg("finalize query: %s", queryString->data)));
+
+		LockShardDistributionMetadata(shardId, ShareLock);
+
+		Task *finalTask = CreateBasicTask(workerJob->jobId, taskIdIndex, READ_TASK,
+										  queryString->data);
+		finalTask->anchorShardId = shardId;
+		finalTask->taskPlacementList = ActiveShardPlacementList(shardId);
+
+		finalTaskList = lappend(finalTaskList, finalTask);
+		taskIdIndex++;
+	}
+
+	return finalTaskList;
+}
@@ -10,9 +10,13 @@
 
 #include "postgres.h"
 
+#include "miscadmin.h"
+
 #include "executor/executor.h"
 #include "utils/datetime.h"
 
+#include "distributed/citus_custom_scan.h"
+#include "distributed/distributed_execution_locks.h"
 #include "distributed/intermediate_result_pruning.h"
 #include "distributed/intermediate_results.h"
 #include "distributed/listutils.h"
@@ -21,6 +25,7 @@
 #include "distributed/recursive_planning.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/transaction_management.h"
+#include "distributed/tuple_destination.h"
 #include "distributed/worker_manager.h"
 
 #define SECOND_TO_MILLI_SECOND 1000
@@ -30,10 +35,43 @@ int MaxIntermediateResult = 1048576; /* maximum size in KB the intermediate resu
 /* when this is true, we enforce intermediate result size limit in all executors */
 int SubPlanLevel = 0;
 
+/* when this is true, independent subplans run their remote tasks concurrently */
+bool EnableConcurrentSubPlanExecution = false;
+
+
+/*
+ * PrefetchedSubPlanResult holds the worker results of a subplan whose tasks
+ * were executed ahead of time, together with the tasks of other subplans that
+ * do not depend on each other.
+ */
+typedef struct PrefetchedSubPlanResult
+{
+	DistributedPlan *distributedPlan;
+	Tuplestorestate *tupleStore;
+} PrefetchedSubPlanResult;
+
+
+/* results of prefetched subplans that are not yet claimed by their custom scan */
+static List *PrefetchedSubPlanResultList = NIL;
+
+
+static void ExecuteSubPlanList(uint64 planId, List *subPlanList,
+							   HTAB *intermediateResultsHash);
+static void PrefetchIndependentSubPlans(uint64 planId, List *subPlanList,
+										int startIndex);
+static CustomScan * ConcurrentlyExecutableSubPlanScan(DistributedSubPlan *subPlan);
+static bool SubPlanIsReadOnly(DistributedSubPlan *subPlan);
+static bool SubPlanResultPrefetched(DistributedPlan *distributedPlan);
+static bool UsesAnyIntermediateResult(DistributedPlan *distributedPlan,
+									  List *resultIdList);
+static void ExecuteSubPlanTasksConcurrently(List *customScanList);
+
 
 /*
  * ExecuteSubPlans executes a list of subplans from a distributed plan
- * by sequentially executing each plan from the top.
+ * by sequentially executing each plan from the top. Independent subplans
+ * may have their remote tasks executed concurrently ahead of time, see
+ * PrefetchIndependentSubPlans.
  */
 void
 ExecuteSubPlans(DistributedPlan *distributedPlan)
@@ -58,9 +96,45 @@ ExecuteSubPlans(DistributedPlan *distributedPlan)
 	 */
 	UseCoordinatedTransaction();
 
+	/*
+	 * Prefetched results are only meaningful for the current execution, make
+	 * sure we do not leave dangling pointers behind in case of an error.
+	 */
+	List *savedPrefetchedSubPlanResultList = PrefetchedSubPlanResultList;
+
+	PG_TRY();
+	{
+		ExecuteSubPlanList(planId, subPlanList, intermediateResultsHash);
+	}
+	PG_FINALLY();
+	{
+		PrefetchedSubPlanResultList = savedPrefetchedSubPlanResultList;
+	}
+	PG_END_TRY();
+}
+
+
+/*
+ * ExecuteSubPlanList executes the given subplans in order and writes their
+ * results to the nodes that need them. When citus.enable_concurrent_subplan_execution
+ * is enabled, the remote tasks of subplans that do not depend on each other are
+ * executed together before the first of them is reached.
+ */
+static void
+ExecuteSubPlanList(uint64 planId, List *subPlanList, HTAB *intermediateResultsHash)
+{
+	int subPlanIndex = 0;
+
 	DistributedSubPlan *subPlan = NULL;
 	foreach_ptr(subPlan, subPlanList)
 	{
+		if (EnableConcurrentSubPlanExecution)
+		{
+			PrefetchIndependentSubPlans(planId, subPlanList, subPlanIndex);
+		}
+
+		subPlanIndex++;
+
 		PlannedStmt *plannedStmt = subPlan->plan;
 		uint32 subPlanId = subPlan->subPlanId;
 		ParamListInfo params = NULL;
@@ -101,3 +175,247 @@ ExecuteSubPlans(DistributedPlan *distributedPlan)
 		FreeExecutorState(estate);
 	}
 }
+
+
+/*
+ * PrefetchIndependentSubPlans builds the set of subplans starting at startIndex
+ * that can be executed right away, because they only read intermediate results
+ * of subplans that already finished, and executes their remote tasks in a single
+ * distributed execution. Each subplan gets its own tuple store, which is later
+ * claimed by the custom scan of the subplan via ClaimPrefetchedSubPlanResult
+ * such that the remainder of the subplan (e.g. the combine query and the
+ * broadcast of the result) runs as usual.
+ *
+ * We never reorder subplans across a subplan that may modify data, since that
+ * would change which version of the data the later subplans observe.
+ */
+static void
+PrefetchIndependentSubPlans(uint64 planId, List *subPlanList, int startIndex)
+{
+	List *pendingResultIdList = NIL;
+	List *customScanList = NIL;
+
+	for (int subPlanIndex = startIndex; subPlanIndex < list_length(subPlanList);
+		 subPlanIndex++)
+	{
+		DistributedSubPlan *subPlan = list_nth(subPlanList, subPlanIndex);
+		CustomScan *customScan = ConcurrentlyExecutableSubPlanScan(subPlan);
+
+		if (customScan == NULL)
+		{
+			if (!SubPlanIsReadOnly(subPlan))
+			{
+				break;
+			}
+		}
+		else
+		{
+			DistributedPlan *distributedPlan = GetDistributedPlan(customScan);
+
+			if (!SubPlanResultPrefetched(distributedPlan) &&
+				!UsesAnyIntermediateResult(distributedPlan, pendingResultIdList))
+			{
+				customScanList = lappend(customScanList, customScan);
+			}
+		}
+
+		/* later subplans cannot read the result of this subplan yet */
+		pendingResultIdList = lappend(pendingResultIdList,
+									  GenerateResultId(planId, subPlan->subPlanId));
+	}
+
+	/* there is nothing to gain from running a single subplan ahead of time */
+	if (list_length(customScanList) < 2)
+	{
+		return;
+	}
+
+	ereport(DEBUG1, (errmsg("executing the tasks of %d subplans concurrently",
+							list_length(customScanList))));
+
+	ExecuteSubPlanTasksConcurrently(customScanList);
+}
+
+
+/*
+ * ConcurrentlyExecutableSubPlanScan returns the Citus custom scan of the given
+ * subplan if its remote tasks can be executed ahead of time, and NULL otherwise.
+ *
+ * That is only the case for read-only adaptive executor plans whose tasks are
+ * known at this point, i.e. plans without deferred pruning, repartitioning,
+ * repartitioned aggregates or subplans of their own.
+ */
+static CustomScan *
+ConcurrentlyExecutableSubPlanScan(DistributedSubPlan *subPlan)
+{
+	PlannedStmt *plannedStmt = subPlan->plan;
+
+	if (!SubPlanIsReadOnly(subPlan) || plannedStmt->subplans != NIL)
+	{
+		return NULL;
+	}
+
+	CustomScan *customScan = FetchCitusCustomScanIfExists(plannedStmt->planTree);
+	if (customScan == NULL || customScan->methods != &AdaptiveExecutorCustomScanMethods)
+	{
+		return NULL;
+	}
+
+	DistributedPlan *distributedPlan = GetDistributedPlan(customScan);
+	Job *workerJob = distributedPlan->workerJob;
+
+	if (distributedPlan->modLevel != ROW_MODIFY_READONLY ||
+		distributedPlan->modifyQueryViaCoordinatorOrRepartition != NULL ||
+		distributedPlan->repartitionedAggregateQuery != NULL ||
+		distributedPlan->subPlanList != NIL ||
+		distributedPlan->planningError != NULL ||
+		workerJob == NULL ||
+		workerJob->deferredPruning ||
+		workerJob->dependentJobList != NIL ||
+		workerJob->taskList == NIL)
+	{
+		return NULL;
+	}
+
+	return customScan;
+}
+
+
+/*
+ * SubPlanIsReadOnly returns whether the given subplan is a plain SELECT.
+ */
+static bool
+SubPlanIsReadOnly(DistributedSubPlan *subPlan)
+{
+	PlannedStmt *plannedStmt = subPlan->plan;
+
+	return plannedStmt->commandType == CMD_SELECT && !plannedStmt->hasModifyingCTE;
+}
+
+
+/*
+ * SubPlanResultPrefetched returns whether the remote tasks of the given
+ * distributed plan were already executed and wait to be claimed.
+ */
+static bool
+SubPlanResultPrefetched(DistributedPlan *distributedPlan)
+{
+	PrefetchedSubPlanResult *prefetchedResult = NULL;
+	foreach_ptr(prefetchedResult, PrefetchedSubPlanResultList)
+	{
+		if (prefetchedResult->distributedPlan == distributedPlan)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * UsesAnyIntermediateResult returns whether the given distributed plan reads
+ * any of the intermediate results in resultIdList.
+ */
+static bool
+UsesAnyIntermediateResult(DistributedPlan *distributedPlan, List *resultIdList)
+{
+	UsedDistributedSubPlan *usedSubPlan = NULL;
+	foreach_ptr(usedSubPlan, distributedPlan->usedSubPlanNodeList)
+	{
+		char *resultId = NULL;
+		foreach_ptr(resultId, resultIdList)
+		{
+			if (strcmp(resultId, usedSubPlan->subPlanId) == 0)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * ExecuteSubPlanTasksConcurrently executes the tasks of the given custom scans
+ * in a single distributed execution, such that the subplans share the worker
+ * sessions and their tasks run in parallel. The results of each subplan are
+ * written into a separate tuple store that is registered as a prefetched result.
+ */
+static void
+ExecuteSubPlanTasksConcurrently(List *customScanList)
+{
+	List *combinedTaskList = NIL;
+	bool randomAccess = true;
+	bool interTransactions = false;
+
+	CustomScan *customScan = NULL;
+	foreach_ptr(customScan, customScanList)
+	{
+		DistributedPlan *distributedPlan = GetDistributedPlan(customScan);
+
+		/* the custom scan would otherwise take these locks before execution */
+		LockPartitionsForDistributedPlan(distributedPlan);
+
+		Tuplestorestate *tupleStore =
+			tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
+
+		/* the scan tuple descriptor of a Citus custom scan is its scan target list */
+		TupleDesc tupleDescriptor = ExecTypeFromTL(customScan->custom_scan_tlist);
+		TupleDestination *tupleDest =
+			CreateTupleStoreTupleDest(tupleStore, tupleDescriptor);
+
+		Task *task = NULL;
+		foreach_ptr(task, distributedPlan->workerJob->taskList)
+		{
+			/* tasks may belong to a cached plan, do not modify them */
+			Task *prefetchTask = copyObject(task);
+			prefetchTask->tupleDest = tupleDest;
+
+			combinedTaskList = lappend(combinedTaskList, prefetchTask);
+		}
+
+		PrefetchedSubPlanResult *prefetchedResult =
+			palloc0(sizeof(PrefetchedSubPlanResult));
+		prefetchedResult->distributedPlan = distributedPlan;
+		prefetchedResult->tupleStore = tupleStore;
+
+		PrefetchedSubPlanResultList = lappend(PrefetchedSubPlanResultList,
+											  prefetchedResult);
+	}
+
+	/* enforce citus.max_intermediate_result_size on the prefetched results */
+	SubPlanLevel++;
+
+	bool expectResults = true;
+	ExecuteTaskListIntoTupleDest(ROW_MODIFY_READONLY, combinedTaskList,
+								 CreateTupleDestNone(), expectResults);
+
+	SubPlanLevel--;
+}
+
+
+/*
+ * ClaimPrefetchedSubPlanResult returns the tuple store holding the results of
+ * the remote tasks of the given distributed plan if they were already executed
+ * by ExecuteSubPlanTasksConcurrently, and NULL otherwise. The caller becomes
+ * the owner of the tuple store.
+ */
+Tuplestorestate *
+ClaimPrefetchedSubPlanResult(DistributedPlan *distributedPlan)
+{
+	PrefetchedSubPlanResult *prefetchedResult = NULL;
+	foreach_ptr(prefetchedResult, PrefetchedSubPlanResultList)
+	{
+		if (prefetchedResult->distributedPlan == distributedPlan)
+		{
+			PrefetchedSubPlanResultList = list_delete_ptr(PrefetchedSubPlanResultList,
+														  prefetchedResult);
+
+			return prefetchedResult->tupleStore;
+		}
+	}
+
+	return NULL;
+}
@@ -31,11 +31,9 @@
 
 
 /* Local functions forward declarations */
-static void SendCopyInStart(void);
 static void SendCopyOutStart(void);
 static void SendCopyDone(void);
 static void SendCopyData(StringInfo fileBuffer);
-static bool ReceiveCopyData(StringInfo copyData);
 static void FreeStringInfo(StringInfo stringInfo);
 
 
@@ -52,7 +50,7 @@ RedirectCopyDataToRegularFile(const char *filename)
 	File fileDesc = FileOpenForTransmit(filename, fileFlags);
 	FileCompat fileCompat = FileCompatFromFileStart(fileDesc);
 
-	SendCopyInStart();
+	SendCopyInStart(true);
 
 	bool copyDone = ReceiveCopyData(copyData);
 	while (!copyDone)
@@ -179,13 +177,14 @@ FileOpenForTransmitPerm(const char *filename, int fileFlags, int fileMode)
 
 /*
  * SendCopyInStart sends the start copy in message to initiate receiving data
- * from stdin. The frontend should now send copy data.
+ * from stdin, announcing either the binary or the text copy format. The
+ * frontend should now send copy data.
  */
-static void
-SendCopyInStart(void)
+void
+SendCopyInStart(bool binaryFormat)
 {
 	StringInfoData copyInStart = { NULL, 0, 0, 0 };
-	const char copyFormat = 1; /* binary copy format */
+	const char copyFormat = binaryFormat ? 1 : 0;
 
 	pq_beginmessage(&copyInStart, 'G');
 	pq_sendbyte(&copyInStart, copyFormat);
@@ -256,7 +255,7 @@ SendCopyData(StringInfo fileBuffer)
  * If the received message does not conform to the copy protocol, the function
  * mirrors copy.c's error behavior.
  */
-static bool
+bool
 ReceiveCopyData(StringInfo copyData)
 {
 	bool copyDone = true;
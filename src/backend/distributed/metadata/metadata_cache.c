@@ -191,6 +191,8 @@ typedef struct MetadataCacheData
 	Oid distObjectPrimaryKeyIndexId;
 	Oid distCleanupRelationId;
 	Oid distCleanupPrimaryKeyIndexId;
+	Oid distShardTransferProgressRelationId;
+	Oid distShardTransferProgressPrimaryKeyIndexId;
 	Oid distColocationRelationId;
 	Oid distColocationConfigurationIndexId;
 	Oid distPartitionRelationId;
@@ -2882,6 +2884,28 @@ DistCleanupPrimaryKeyIndexId(void)
 }
 
 
+/* return oid of pg_dist_shard_transfer_progress relation */
+Oid
+DistShardTransferProgressRelationId(void)
+{
+	CachedRelationLookup("pg_dist_shard_transfer_progress",
+						 &MetadataCache.distShardTransferProgressRelationId);
+
+	return MetadataCache.distShardTransferProgressRelationId;
+}
+
+
+/* return oid of pg_dist_shard_transfer_progress primary key index */
+Oid
+DistShardTransferProgressPrimaryKeyIndexId(void)
+{
+	CachedRelationLookup("pg_dist_shard_transfer_progress_pkey",
+						 &MetadataCache.distShardTransferProgressPrimaryKeyIndexId);
+
+	return MetadataCache.distShardTransferProgressPrimaryKeyIndexId;
+}
+
+
 /* return oid of pg_dist_colocation relation */
 Oid
 DistColocationRelationId(void)
@@ -92,8 +92,6 @@ static uint64 * AllocateUint64(uint64 value);
 static void RecordDistributedRelationDependencies(Oid distributedRelationId);
 static GroupShardPlacement * TupleToGroupShardPlacement(TupleDesc tupleDesc,
 														HeapTuple heapTuple);
-static bool DistributedRelationSize(Oid relationId, SizeQueryType sizeQueryType,
-									bool failOnError, uint64 *relationSize);
 static bool DistributedRelationSizeOnWorker(WorkerNode *workerNode, Oid relationId,
 											SizeQueryType sizeQueryType, bool failOnError,
 											uint64 *relationSize);
@@ -520,7 +518,7 @@ ReceiveShardIdAndSizeResults(List *connectionList, Tuplestorestate *tupleStore,
  * relation.
  * Input relation is allowed to be an index on a distributed table too.
  */
-static bool
+bool
 DistributedRelationSize(Oid relationId, SizeQueryType sizeQueryType,
 						bool failOnError, uint64 *relationSize)
 {
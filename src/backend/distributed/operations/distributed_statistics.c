@@ -0,0 +1,1383 @@
+/*-------------------------------------------------------------------------
+ *
+ * distributed_statistics.c
+ *
+ * Functions for gathering the statistics of the shards of distributed tables
+ * into the coordinator.
+ *
+ * The shell tables on the coordinator do not contain any rows, so PostgreSQL
+ * has no statistics for them. citus_analyze and the maintenance daemon fetch
+ * the row counts and the pg_stats entries of the shards from the workers,
+ * merge them, and store the result in pg_class and pg_statistic of the shell
+ * table, where they are used when planning on the coordinator.
+ *
+ * Row counts, null fractions and widths are combined exactly. The most common
+ * values of the shards are combined by their estimated number of rows, and
+ * the histograms are combined by picking equally weighted bounds from the
+ * bounds of all shards, which approximates the histogram of the whole table.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <math.h>
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "libpq-fe.h"
+#include "miscadmin.h"
+
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "access/xact.h"
+#include "catalog/indexing.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_statistic.h"
+#include "catalog/pg_type.h"
+#include "storage/lmgr.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
+
+#include "distributed/citus_safe_lib.h"
+#include "distributed/connection_management.h"
+#include "distributed/coordinator_protocol.h"
+#include "distributed/distributed_statistics.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/metadata_utility.h"
+#include "distributed/multi_join_order.h"
+#include "distributed/relay_utility.h"
+#include "distributed/remote_commands.h"
+#include "distributed/version_compat.h"
+#include "distributed/worker_manager.h"
+
+
+/* columns of the result of ShardStatisticsQuery */
+#define SHARD_STATISTICS_SHARD_ID 0
+#define SHARD_STATISTICS_ROW_COUNT 1
+#define SHARD_STATISTICS_PAGE_COUNT 2
+#define SHARD_STATISTICS_COLUMN_NAME 3
+#define SHARD_STATISTICS_NULL_FRACTION 4
+#define SHARD_STATISTICS_AVERAGE_WIDTH 5
+#define SHARD_STATISTICS_DISTINCT_COUNT 6
+#define SHARD_STATISTICS_MOST_COMMON_VALUES 7
+#define SHARD_STATISTICS_MOST_COMMON_FREQUENCIES 8
+#define SHARD_STATISTICS_HISTOGRAM_BOUNDS 9
+#define SHARD_STATISTICS_CORRELATION 10
+
+/* PostgreSQL stores the number of distinct values as a fraction above this */
+#define DISTINCT_FRACTION_THRESHOLD 0.1
+
+
+/*
+ * ShardPlacementGroup contains the shards whose statistics are fetched from
+ * a single node.
+ */
+typedef struct ShardPlacementGroup
+{
+	uint32 nodeId;
+	char *nodeName;
+	int nodePort;
+	List *shardIntervalList;
+} ShardPlacementGroup;
+
+/*
+ * ShardColumnStatistics is a pg_stats entry of a column of a single shard.
+ */
+typedef struct ShardColumnStatistics
+{
+	double rowCount;
+	float4 nullFraction;
+	int32 averageWidth;
+	float4 distinctCount;
+	char *mostCommonValues;
+	char *mostCommonFrequencies;
+	char *histogramBounds;
+	bool hasCorrelation;
+	float4 correlation;
+} ShardColumnStatistics;
+
+/*
+ * TableStatistics contains the statistics of all shards of a table, with
+ * the column statistics indexed by attribute number - 1.
+ */
+typedef struct TableStatistics
+{
+	Oid relationId;
+	bool hasRowCount;
+	double rowCount;
+	double pageCount;
+	int columnCount;
+	List **columnStatisticsLists;
+} TableStatistics;
+
+/*
+ * ColumnTypeInfo contains what we need to know about the type of a column to
+ * parse and merge the values in its statistics.
+ */
+typedef struct ColumnTypeInfo
+{
+	Oid typeId;
+	int32 typeMod;
+	Oid collationId;
+	int16 typeLength;
+	bool typeByValue;
+	char typeAlign;
+	Oid arrayInputFunction;
+	Oid arrayIoParam;
+	Oid equalityOperator;
+	Oid lessThanOperator;
+	FmgrInfo *equalityFunction;
+	FmgrInfo *compareFunction;
+} ColumnTypeInfo;
+
+/*
+ * MergedColumnStatistics is the statistics of a column of the whole table,
+ * in the form in which it is stored in pg_statistic.
+ */
+typedef struct MergedColumnStatistics
+{
+	float4 nullFraction;
+	int32 averageWidth;
+	float4 distinctCount;
+	int mostCommonValueCount;
+	Datum *mostCommonValues;
+	Datum *mostCommonFrequencies;
+	int histogramBoundCount;
+	Datum *histogramBounds;
+	bool hasCorrelation;
+	float4 correlation;
+} MergedColumnStatistics;
+
+/*
+ * ValueCount is a (most common) value with the estimated number of rows in
+ * which it occurs, and the position at which it was first seen.
+ */
+typedef struct ValueCount
+{
+	Datum value;
+	double rowCount;
+	int firstPosition;
+} ValueCount;
+
+/*
+ * WeightedBound is a histogram bound of a shard, weighted by the number of
+ * rows of the shard that it represents.
+ */
+typedef struct WeightedBound
+{
+	Datum value;
+	double weight;
+} WeightedBound;
+
+
+static List * AnalyzableCitusTableIdList(void);
+static List * GroupShardsByPlacementNode(List *shardIntervalList);
+static char * ShardStatisticsQuery(List *shardIntervalList);
+static void FetchShardStatistics(ShardPlacementGroup *placementGroup,
+								 TableStatistics *tableStatistics);
+static double StringToDouble(char *valueString);
+static void ColumnTypeInfoForAttribute(Form_pg_attribute attribute,
+									   ColumnTypeInfo *typeInfo);
+static bool MergeColumnStatistics(List *shardStatisticsList, ColumnTypeInfo *typeInfo,
+								  bool isDistributionColumn,
+								  MergedColumnStatistics *mergedStatistics);
+static void MergeMostCommonValues(List *shardStatisticsList, double totalRowCount,
+								  ColumnTypeInfo *typeInfo,
+								  MergedColumnStatistics *mergedStatistics);
+static void MergeHistograms(List *shardStatisticsList, ColumnTypeInfo *typeInfo,
+							MergedColumnStatistics *mergedStatistics);
+static Datum * ParseStatisticsArray(char *arrayText, Oid inputFunction, Oid ioParam,
+									int32 typeMod, Oid elementType, int16 typeLength,
+									bool typeByValue, char typeAlign, int *valueCount);
+static float4 * ParseFrequencyArray(char *arrayText, int *frequencyCount);
+static bool ValuesAreEqual(Datum left, Datum right, ColumnTypeInfo *typeInfo);
+static int CompareValueCounts(const void *left, const void *right, void *arg);
+static int CompareValueCountsByRowCount(const void *left, const void *right);
+static int CompareWeightedBounds(const void *left, const void *right, void *arg);
+static void StoreColumnStatistics(Relation statisticRelation, Oid relationId,
+								  AttrNumber attributeNumber, bool inherited,
+								  ColumnTypeInfo *typeInfo,
+								  MergedColumnStatistics *mergedStatistics);
+static void StoreRelationStatistics(Oid relationId, double rowCount, double pageCount);
+
+
+/* exports for SQL callable functions */
+PG_FUNCTION_INFO_V1(citus_analyze);
+
+
+/* GUC, interval in milliseconds between gathering statistics, -1 to disable */
+int DistributedAnalyzeInterval = -1;
+
+
+/*
+ * citus_analyze gathers the statistics of the shards of the given distributed
+ * or reference table into the coordinator, or of all such tables owned by the
+ * current user when no table is given.
+ */
+Datum
+citus_analyze(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+	EnsureCoordinator();
+
+	if (!PG_ARGISNULL(0))
+	{
+		Oid relationId = PG_GETARG_OID(0);
+
+		EnsureTableOwner(relationId);
+
+		if (!IsCitusTableType(relationId, DISTRIBUTED_TABLE) &&
+			!IsCitusTableType(relationId, REFERENCE_TABLE))
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							errmsg("relation \"%s\" is not a distributed or "
+								   "reference table", get_rel_name(relationId))));
+		}
+
+		AnalyzeDistributedTable(relationId);
+
+		PG_RETURN_VOID();
+	}
+
+	List *relationIdList = AnalyzableCitusTableIdList();
+
+	Oid relationId = InvalidOid;
+	foreach_oid(relationId, relationIdList)
+	{
+		if (!object_ownercheck(RelationRelationId, relationId, GetUserId()))
+		{
+			continue;
+		}
+
+		AnalyzeDistributedTable(relationId);
+	}
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * TryAnalyzeDistributedTables gathers the statistics of all distributed and
+ * reference tables into the coordinator for the maintenance daemon. Errors
+ * are turned into warnings, such that a table whose statistics cannot be
+ * gathered does not prevent the other tables from being analyzed.
+ *
+ * The function returns the number of tables that were analyzed.
+ */
+int
+TryAnalyzeDistributedTables(void)
+{
+	volatile int analyzedTableCount = 0;
+	MemoryContext savedContext = CurrentMemoryContext;
+
+	List *relationIdList = AnalyzableCitusTableIdList();
+
+	Oid relationId = InvalidOid;
+	foreach_oid(relationId, relationIdList)
+	{
+		/*
+		 * Start a subtransaction so we can rollback database's state to it in case
+		 * of error.
+		 */
+		BeginInternalSubTransaction(NULL);
+
+		PG_TRY();
+		{
+			AnalyzeDistributedTable(relationId);
+
+			ReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(savedContext);
+
+			analyzedTableCount++;
+		}
+		PG_CATCH();
+		{
+			MemoryContextSwitchTo(savedContext);
+			ErrorData *edata = CopyErrorData();
+			FlushErrorState();
+
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(savedContext);
+
+			/* rethrow as WARNING */
+			edata->elevel = WARNING;
+			ThrowErrorData(edata);
+		}
+		PG_END_TRY();
+	}
+
+	return analyzedTableCount;
+}
+
+
+/*
+ * AnalyzableCitusTableIdList returns the distributed and reference tables,
+ * whose shards are on other nodes than the shell table.
+ */
+static List *
+AnalyzableCitusTableIdList(void)
+{
+	List *distributedTableIdList = CitusTableTypeIdList(DISTRIBUTED_TABLE);
+	List *referenceTableIdList = CitusTableTypeIdList(REFERENCE_TABLE);
+
+	return list_concat(distributedTableIdList, referenceTableIdList);
+}
+
+
+/*
+ * AnalyzeDistributedTable fetches the row counts and column statistics of the
+ * shards of the given table, merges them and stores them as the statistics of
+ * the shell table on this node.
+ */
+void
+AnalyzeDistributedTable(Oid relationId)
+{
+	/* same lock as ANALYZE, which prevents concurrent updates of the statistics */
+	LockRelationOid(relationId, ShareUpdateExclusiveLock);
+
+	/* the table might have been dropped or undistributed while we were waiting */
+	if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(relationId)) ||
+		!IsCitusTable(relationId))
+	{
+		UnlockRelationOid(relationId, ShareUpdateExclusiveLock);
+		return;
+	}
+
+	MemoryContext analyzeContext = AllocSetContextCreate(CurrentMemoryContext,
+														 "Distributed Analyze",
+														 ALLOCSET_DEFAULT_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(analyzeContext);
+
+	Relation relation = table_open(relationId, AccessShareLock);
+	TupleDesc tupleDescriptor = RelationGetDescr(relation);
+	bool inherited = relation->rd_rel->relkind == RELKIND_PARTITIONED_TABLE;
+
+	TableStatistics *tableStatistics = palloc0(sizeof(TableStatistics));
+	tableStatistics->relationId = relationId;
+	tableStatistics->columnCount = tupleDescriptor->natts;
+	tableStatistics->columnStatisticsLists =
+		palloc0(tupleDescriptor->natts * sizeof(List *));
+
+	List *shardIntervalList = LoadShardIntervalList(relationId);
+	List *placementGroupList = GroupShardsByPlacementNode(shardIntervalList);
+
+	ShardPlacementGroup *placementGroup = NULL;
+	foreach_ptr(placementGroup, placementGroupList)
+	{
+		FetchShardStatistics(placementGroup, tableStatistics);
+	}
+
+	/* no shard has been analyzed yet */
+	if (!tableStatistics->hasRowCount)
+	{
+		table_close(relation, AccessShareLock);
+		MemoryContextSwitchTo(oldContext);
+		MemoryContextDelete(analyzeContext);
+		return;
+	}
+
+	AttrNumber distributionColumnNumber = InvalidAttrNumber;
+	if (HasDistributionKey(relationId))
+	{
+		Var *distributionColumn = DistPartitionKey(relationId);
+		distributionColumnNumber = distributionColumn->varattno;
+	}
+
+	Relation statisticRelation = table_open(StatisticRelationId, RowExclusiveLock);
+
+	for (int columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+	{
+		Form_pg_attribute attribute = TupleDescAttr(tupleDescriptor, columnIndex);
+		List *shardStatisticsList = tableStatistics->columnStatisticsLists[columnIndex];
+		ColumnTypeInfo typeInfo;
+		MergedColumnStatistics mergedStatistics;
+
+		if (attribute->attisdropped || shardStatisticsList == NIL)
+		{
+			continue;
+		}
+
+		ColumnTypeInfoForAttribute(attribute, &typeInfo);
+
+		bool isDistributionColumn = attribute->attnum == distributionColumnNumber;
+		if (!MergeColumnStatistics(shardStatisticsList, &typeInfo, isDistributionColumn,
+								   &mergedStatistics))
+		{
+			continue;
+		}
+
+		StoreColumnStatistics(statisticRelation, relationId, attribute->attnum,
+							  inherited, &typeInfo, &mergedStatistics);
+	}
+
+	table_close(statisticRelation, RowExclusiveLock);
+	table_close(relation, AccessShareLock);
+
+	StoreRelationStatistics(relationId, tableStatistics->rowCount,
+							tableStatistics->pageCount);
+
+	MemoryContextSwitchTo(oldContext);
+	MemoryContextDelete(analyzeContext);
+}
+
+
+/*
+ * GroupShardsByPlacementNode picks an active placement for each of the given
+ * shards and groups the shards by the node of that placement, such that we
+ * need a single query per node. For replicated shards, we only use the first
+ * placement to avoid counting the same rows twice.
+ */
+static List *
+GroupShardsByPlacementNode(List *shardIntervalList)
+{
+	List *placementGroupList = NIL;
+
+	ShardInterval *shardInterval = NULL;
+	foreach_ptr(shardInterval, shardIntervalList)
+	{
+		bool missingOk = false;
+		ShardPlacement *placement = ActiveShardPlacement(shardInterval->shardId,
+														 missingOk);
+		ShardPlacementGroup *shardPlacementGroup = NULL;
+
+		ShardPlacementGroup *placementGroup = NULL;
+		foreach_ptr(placementGroup, placementGroupList)
+		{
+			if (placementGroup->nodeId == placement->nodeId)
+			{
+				shardPlacementGroup = placementGroup;
+				break;
+			}
+		}
+
+		if (shardPlacementGroup == NULL)
+		{
+			shardPlacementGroup = palloc0(sizeof(ShardPlacementGroup));
+			shardPlacementGroup->nodeId = placement->nodeId;
+			shardPlacementGroup->nodeName = placement->nodeName;
+			shardPlacementGroup->nodePort = placement->nodePort;
+
+			placementGroupList = lappend(placementGroupList, shardPlacementGroup);
+		}
+
+		shardPlacementGroup->shardIntervalList =
+			lappend(shardPlacementGroup->shardIntervalList, shardInterval);
+	}
+
+	return placementGroupList;
+}
+
+
+/*
+ * ShardStatisticsQuery returns a query that returns the row and page counts of
+ * the given shards together with their pg_stats entries, one row per column,
+ * ordered by shard ID. Shards that were moved or dropped in the meantime are
+ * skipped. For partitioned shards, we use the statistics that include the
+ * partitions, like ANALYZE does for the partitioned table itself.
+ */
+static char *
+ShardStatisticsQuery(List *shardIntervalList)
+{
+	StringInfo query = makeStringInfo();
+
+	appendStringInfoString(query,
+						   "SELECT shards.shard_id, c.reltuples, c.relpages, "
+						   "s.attname, s.null_frac, s.avg_width, s.n_distinct, "
+						   "s.most_common_vals::text, s.most_common_freqs::text, "
+						   "s.histogram_bounds::text, s.correlation "
+						   "FROM (VALUES ");
+
+	bool firstShard = true;
+	ShardInterval *shardInterval = NULL;
+	foreach_ptr(shardInterval, shardIntervalList)
+	{
+		Oid relationId = shardInterval->relationId;
+		char *schemaName = get_namespace_name(get_rel_namespace(relationId));
+		char *shardName = get_rel_name(relationId);
+		AppendShardIdToName(&shardName, shardInterval->shardId);
+
+		appendStringInfo(query, "%s(" UINT64_FORMAT "::bigint, %s, %s)",
+						 firstShard ? "" : ", ",
+						 shardInterval->shardId,
+						 quote_literal_cstr(schemaName),
+						 quote_literal_cstr(shardName));
+
+		firstShard = false;
+	}
+
+	appendStringInfoString(query,
+						   ") AS shards (shard_id, schema_name, table_name) "
+						   "JOIN pg_class c ON c.oid = to_regclass("
+						   "format('%I.%I', shards.schema_name, shards.table_name)) "
+						   "LEFT JOIN pg_stats s ON s.schemaname = shards.schema_name "
+						   "AND s.tablename = shards.table_name "
+						   "AND s.inherited = (c.relkind = 'p') "
+						   "ORDER BY shards.shard_id");
+
+	return query->data;
+}
+
+
+/*
+ * FetchShardStatistics fetches the statistics of the shards in the given
+ * placement group and adds them to the table statistics.
+ */
+static void
+FetchShardStatistics(ShardPlacementGroup *placementGroup,
+					 TableStatistics *tableStatistics)
+{
+	uint32 connectionFlags = 0;
+	PGresult *result = NULL;
+	bool raiseErrors = true;
+
+	char *query = ShardStatisticsQuery(placementGroup->shardIntervalList);
+	MultiConnection *connection = GetNodeConnection(connectionFlags,
+													placementGroup->nodeName,
+													placementGroup->nodePort);
+
+	int queryResult = ExecuteOptionalRemoteCommand(connection, query, &result);
+	if (queryResult != 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_CONNECTION_FAILURE),
+						errmsg("could not fetch the statistics of the shards of "
+							   "relation \"%s\" from %s:%d",
+							   get_rel_name(tableStatistics->relationId),
+							   placementGroup->nodeName, placementGroup->nodePort)));
+	}
+
+	uint64 previousShardId = INVALID_SHARD_ID;
+	double shardRowCount = -1;
+	int rowCount = PQntuples(result);
+
+	for (int rowIndex = 0; rowIndex < rowCount; rowIndex++)
+	{
+		uint64 shardId = SafeStringToUint64(PQgetvalue(result, rowIndex,
+													   SHARD_STATISTICS_SHARD_ID));
+
+		if (shardId != previousShardId)
+		{
+			previousShardId = shardId;
+			shardRowCount = StringToDouble(PQgetvalue(result, rowIndex,
+													  SHARD_STATISTICS_ROW_COUNT));
+
+			/* reltuples is -1 for shards that were never vacuumed or analyzed */
+			if (shardRowCount >= 0)
+			{
+				tableStatistics->hasRowCount = true;
+				tableStatistics->rowCount += shardRowCount;
+				tableStatistics->pageCount +=
+					StringToDouble(PQgetvalue(result, rowIndex,
+											  SHARD_STATISTICS_PAGE_COUNT));
+			}
+		}
+
+		if (shardRowCount <= 0 ||
+			PQgetisnull(result, rowIndex, SHARD_STATISTICS_COLUMN_NAME))
+		{
+			continue;
+		}
+
+		char *columnName = PQgetvalue(result, rowIndex, SHARD_STATISTICS_COLUMN_NAME);
+		AttrNumber attributeNumber = get_attnum(tableStatistics->relationId,
+												columnName);
+		if (attributeNumber <= 0 || attributeNumber > tableStatistics->columnCount)
+		{
+			continue;
+		}
+
+		ShardColumnStatistics *columnStatistics =
+			palloc0(sizeof(ShardColumnStatistics));
+		columnStatistics->rowCount = shardRowCount;
+		columnStatistics->nullFraction =
+			StringToDouble(PQgetvalue(result, rowIndex, SHARD_STATISTICS_NULL_FRACTION));
+		columnStatistics->averageWidth =
+			pg_strtoint32(PQgetvalue(result, rowIndex, SHARD_STATISTICS_AVERAGE_WIDTH));
+		columnStatistics->distinctCount =
+			StringToDouble(PQgetvalue(result, rowIndex,
+									  SHARD_STATISTICS_DISTINCT_COUNT));
+
+		if (!PQgetisnull(result, rowIndex, SHARD_STATISTICS_MOST_COMMON_VALUES) &&
+			!PQgetisnull(result, rowIndex, SHARD_STATISTICS_MOST_COMMON_FREQUENCIES))
+		{
+			columnStatistics->mostCommonValues =
+				pstrdup(PQgetvalue(result, rowIndex,
+								   SHARD_STATISTICS_MOST_COMMON_VALUES));
+			columnStatistics->mostCommonFrequencies =
+				pstrdup(PQgetvalue(result, rowIndex,
+								   SHARD_STATISTICS_MOST_COMMON_FREQUENCIES));
+		}
+
+		if (!PQgetisnull(result, rowIndex, SHARD_STATISTICS_HISTOGRAM_BOUNDS))
+		{
+			columnStatistics->histogramBounds =
+				pstrdup(PQgetvalue(result, rowIndex, SHARD_STATISTICS_HISTOGRAM_BOUNDS));
+		}
+
+		if (!PQgetisnull(result, rowIndex, SHARD_STATISTICS_CORRELATION))
+		{
+			columnStatistics->hasCorrelation = true;
+			columnStatistics->correlation =
+				StringToDouble(PQgetvalue(result, rowIndex,
+										  SHARD_STATISTICS_CORRELATION));
+		}
+
+		int columnIndex = attributeNumber - 1;
+		tableStatistics->columnStatisticsLists[columnIndex] =
+			lappend(tableStatistics->columnStatisticsLists[columnIndex],
+					columnStatistics);
+	}
+
+	PQclear(result);
+	ClearResults(connection, raiseErrors);
+}
+
+
+/*
+ * StringToDouble parses a floating point number in the text format of
+ * PostgreSQL.
+ */
+static double
+StringToDouble(char *valueString)
+{
+	return DatumGetFloat8(DirectFunctionCall1(float8in, CStringGetDatum(valueString)));
+}
+
+
+/*
+ * ColumnTypeInfoForAttribute fills in the type information for the given
+ * column. Statistics are stored in terms of the base type of domains.
+ */
+static void
+ColumnTypeInfoForAttribute(Form_pg_attribute attribute, ColumnTypeInfo *typeInfo)
+{
+	memset(typeInfo, 0, sizeof(ColumnTypeInfo));
+
+	typeInfo->typeMod = attribute->atttypmod;
+	typeInfo->typeId = getBaseTypeAndTypmod(attribute->atttypid, &typeInfo->typeMod);
+	typeInfo->collationId = attribute->attcollation;
+
+	get_typlenbyvalalign(typeInfo->typeId, &typeInfo->typeLength,
+						 &typeInfo->typeByValue, &typeInfo->typeAlign);
+
+	/* without an array type, we cannot parse most common values or histograms */
+	Oid arrayTypeId = get_array_type(typeInfo->typeId);
+	if (!OidIsValid(arrayTypeId))
+	{
+		return;
+	}
+
+	getTypeInputInfo(arrayTypeId, &typeInfo->arrayInputFunction,
+					 &typeInfo->arrayIoParam);
+
+	TypeCacheEntry *typeEntry = lookup_type_cache(typeInfo->typeId,
+												  TYPECACHE_EQ_OPR_FINFO |
+												  TYPECACHE_LT_OPR |
+												  TYPECACHE_CMP_PROC_FINFO);
+
+	if (OidIsValid(typeEntry->eq_opr) && OidIsValid(typeEntry->eq_opr_finfo.fn_oid))
+	{
+		typeInfo->equalityOperator = typeEntry->eq_opr;
+		typeInfo->equalityFunction = &typeEntry->eq_opr_finfo;
+	}
+
+	if (OidIsValid(typeEntry->lt_opr) && OidIsValid(typeEntry->cmp_proc))
+	{
+		typeInfo->lessThanOperator = typeEntry->lt_opr;
+		typeInfo->compareFunction = &typeEntry->cmp_proc_finfo;
+	}
+}
+
+
+/*
+ * MergeColumnStatistics merges the statistics of a column of all shards into
+ * the statistics of the column for the whole table. Returns false if none of
+ * the shards has rows.
+ */
+static bool
+MergeColumnStatistics(List *shardStatisticsList, ColumnTypeInfo *typeInfo,
+					  bool isDistributionColumn,
+					  MergedColumnStatistics *mergedStatistics)
+{
+	double totalRowCount = 0.0;
+	double nullRowCount = 0.0;
+	double nonNullRowCount = 0.0;
+	double totalWidth = 0.0;
+	double totalDistinctCount = 0.0;
+	double maxDistinctCount = 0.0;
+	bool allDistinctCountsScale = true;
+	double correlationSum = 0.0;
+	double correlationRowCount = 0.0;
+
+	memset(mergedStatistics, 0, sizeof(MergedColumnStatistics));
+
+	ShardColumnStatistics *shardStatistics = NULL;
+	foreach_ptr(shardStatistics, shardStatisticsList)
+	{
+		double shardRowCount = shardStatistics->rowCount;
+		double shardNonNullRowCount =
+			shardRowCount * (1.0 - shardStatistics->nullFraction);
+		double shardDistinctCount = shardStatistics->distinctCount;
+
+		totalRowCount += shardRowCount;
+		nullRowCount += shardRowCount * shardStatistics->nullFraction;
+		nonNullRowCount += shardNonNullRowCount;
+		totalWidth += shardNonNullRowCount * shardStatistics->averageWidth;
+
+		/* negative values are the number of distinct values per row */
+		if (shardDistinctCount < 0)
+		{
+			shardDistinctCount = -shardDistinctCount * shardRowCount;
+		}
+		else
+		{
+			allDistinctCountsScale = false;
+		}
+
+		totalDistinctCount += shardDistinctCount;
+		maxDistinctCount = Max(maxDistinctCount, shardDistinctCount);
+
+		if (shardStatistics->hasCorrelation)
+		{
+			correlationSum += shardRowCount * shardStatistics->correlation;
+			correlationRowCount += shardRowCount;
+		}
+	}
+
+	if (totalRowCount <= 0)
+	{
+		return false;
+	}
+
+	mergedStatistics->nullFraction = nullRowCount / totalRowCount;
+
+	if (nonNullRowCount > 0)
+	{
+		mergedStatistics->averageWidth = (int32) rint(totalWidth / nonNullRowCount);
+	}
+
+	/*
+	 * Values of the distribution column do not overlap between shards, so
+	 * their distinct counts add up, whereas for other columns we only know
+	 * that there are at least as many as in the shard with the most. When
+	 * the number of distinct values grows with the table on all shards, that
+	 * is also likely the case for the table as a whole.
+	 */
+	double distinctCount = isDistributionColumn || allDistinctCountsScale ?
+						   totalDistinctCount : maxDistinctCount;
+	distinctCount = Min(distinctCount, nonNullRowCount);
+
+	if (allDistinctCountsScale ||
+		distinctCount > DISTINCT_FRACTION_THRESHOLD * totalRowCount)
+	{
+		mergedStatistics->distinctCount = Max(-distinctCount / totalRowCount, -1.0);
+	}
+	else
+	{
+		mergedStatistics->distinctCount = distinctCount;
+	}
+
+	if (OidIsValid(typeInfo->arrayInputFunction) &&
+		OidIsValid(typeInfo->equalityOperator))
+	{
+		MergeMostCommonValues(shardStatisticsList, totalRowCount, typeInfo,
+							  mergedStatistics);
+	}
+
+	if (OidIsValid(typeInfo->arrayInputFunction) &&
+		OidIsValid(typeInfo->lessThanOperator))
+	{
+		MergeHistograms(shardStatisticsList, typeInfo, mergedStatistics);
+
+		if (correlationRowCount > 0)
+		{
+			mergedStatistics->hasCorrelation = true;
+			mergedStatistics->correlation = correlationSum / correlationRowCount;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * MergeMostCommonValues estimates the number of rows of each of the most
+ * common values of the shards, and keeps the values that occur in the most
+ * rows overall. We keep as many values as the shard with the longest list.
+ */
+static void
+MergeMostCommonValues(List *shardStatisticsList, double totalRowCount,
+					  ColumnTypeInfo *typeInfo,
+					  MergedColumnStatistics *mergedStatistics)
+{
+	int maxValueCount = 0;
+	int valueCountCapacity = 16;
+	int valueCountCount = 0;
+	ValueCount *valueCounts = palloc0(valueCountCapacity * sizeof(ValueCount));
+
+	ShardColumnStatistics *shardStatistics = NULL;
+	foreach_ptr(shardStatistics, shardStatisticsList)
+	{
+		int valueCount = 0;
+		int frequencyCount = 0;
+
+		if (shardStatistics->mostCommonValues == NULL)
+		{
+			continue;
+		}
+
+		Datum *values = ParseStatisticsArray(shardStatistics->mostCommonValues,
+											 typeInfo->arrayInputFunction,
+											 typeInfo->arrayIoParam,
+											 typeInfo->typeMod, typeInfo->typeId,
+											 typeInfo->typeLength,
+											 typeInfo->typeByValue,
+											 typeInfo->typeAlign, &valueCount);
+		float4 *frequencies = ParseFrequencyArray(shardStatistics->mostCommonFrequencies,
+												  &frequencyCount);
+		if (valueCount != frequencyCount)
+		{
+			continue;
+		}
+
+		maxValueCount = Max(maxValueCount, valueCount);
+
+		for (int valueIndex = 0; valueIndex < valueCount; valueIndex++)
+		{
+			if (valueCountCount == valueCountCapacity)
+			{
+				valueCountCapacity *= 2;
+				valueCounts = repalloc(valueCounts,
+									   valueCountCapacity * sizeof(ValueCount));
+			}
+
+			ValueCount *valueCountEntry = &valueCounts[valueCountCount];
+			valueCountEntry->value = values[valueIndex];
+			valueCountEntry->rowCount = frequencies[valueIndex] *
+										shardStatistics->rowCount;
+			valueCountEntry->firstPosition = valueCountCount;
+			valueCountCount++;
+		}
+	}
+
+	if (valueCountCount == 0)
+	{
+		return;
+	}
+
+	/*
+	 * Add up the row counts of values that are equal according to the equality
+	 * operator of the type. When the type can be sorted, equal values are
+	 * adjacent after sorting, otherwise we compare with all distinct values.
+	 */
+	bool valuesAreSorted = typeInfo->compareFunction != NULL;
+	if (valuesAreSorted)
+	{
+		qsort_arg(valueCounts, valueCountCount, sizeof(ValueCount), CompareValueCounts,
+				  typeInfo);
+	}
+
+	int distinctValueCount = 0;
+	for (int valueIndex = 0; valueIndex < valueCountCount; valueIndex++)
+	{
+		ValueCount *valueCount = &valueCounts[valueIndex];
+		ValueCount *equalValueCount = NULL;
+
+		int distinctIndex = valuesAreSorted ? Max(distinctValueCount - 1, 0) : 0;
+		for (; distinctIndex < distinctValueCount; distinctIndex++)
+		{
+			if (ValuesAreEqual(valueCounts[distinctIndex].value, valueCount->value,
+							   typeInfo))
+			{
+				equalValueCount = &valueCounts[distinctIndex];
+				break;
+			}
+		}
+
+		if (equalValueCount != NULL)
+		{
+			equalValueCount->rowCount += valueCount->rowCount;
+			equalValueCount->firstPosition = Min(equalValueCount->firstPosition,
+												 valueCount->firstPosition);
+		}
+		else
+		{
+			valueCounts[distinctValueCount++] = *valueCount;
+		}
+	}
+
+	qsort(valueCounts, distinctValueCount, sizeof(ValueCount),
+		  CompareValueCountsByRowCount);
+
+	int mostCommonValueCount = Min(maxValueCount, distinctValueCount);
+
+	mergedStatistics->mostCommonValueCount = mostCommonValueCount;
+	mergedStatistics->mostCommonValues = palloc0(mostCommonValueCount * sizeof(Datum));
+	mergedStatistics->mostCommonFrequencies =
+		palloc0(mostCommonValueCount * sizeof(Datum));
+
+	for (int valueIndex = 0; valueIndex < mostCommonValueCount; valueIndex++)
+	{
+		double frequency = valueCounts[valueIndex].rowCount / totalRowCount;
+
+		mergedStatistics->mostCommonValues[valueIndex] = valueCounts[valueIndex].value;
+		mergedStatistics->mostCommonFrequencies[valueIndex] =
+			Float4GetDatum((float4) Min(frequency, 1.0));
+	}
+}
+
+
+/*
+ * MergeHistograms builds a histogram of the whole table from the histograms
+ * of the shards. Each bound of a shard histogram stands for an equal share of
+ * the rows of that shard that are not null and not among its most common
+ * values. We sort the bounds of all shards and pick the bounds at equal
+ * distances in the cumulative number of rows, keeping the minimum and maximum
+ * bounds. The histogram has as many bounds as the largest shard histogram.
+ */
+static void
+MergeHistograms(List *shardStatisticsList, ColumnTypeInfo *typeInfo,
+				MergedColumnStatistics *mergedStatistics)
+{
+	int maxBoundCount = 0;
+	int boundCapacity = 16;
+	int boundCount = 0;
+	WeightedBound *bounds = palloc0(boundCapacity * sizeof(WeightedBound));
+
+	ShardColumnStatistics *shardStatistics = NULL;
+	foreach_ptr(shardStatistics, shardStatisticsList)
+	{
+		int shardBoundCount = 0;
+		double mostCommonFraction = 0.0;
+
+		if (shardStatistics->histogramBounds == NULL)
+		{
+			continue;
+		}
+
+		Datum *shardBounds = ParseStatisticsArray(shardStatistics->histogramBounds,
+												  typeInfo->arrayInputFunction,
+												  typeInfo->arrayIoParam,
+												  typeInfo->typeMod, typeInfo->typeId,
+												  typeInfo->typeLength,
+												  typeInfo->typeByValue,
+												  typeInfo->typeAlign,
+												  &shardBoundCount);
+		if (shardBoundCount < 2)
+		{
+			continue;
+		}
+
+		if (shardStatistics->mostCommonFrequencies != NULL)
+		{
+			int frequencyCount = 0;
+			float4 *frequencies =
+				ParseFrequencyArray(shardStatistics->mostCommonFrequencies,
+									&frequencyCount);
+
+			for (int frequencyIndex = 0; frequencyIndex < frequencyCount;
+				 frequencyIndex++)
+			{
+				mostCommonFraction += frequencies[frequencyIndex];
+			}
+		}
+
+		double histogramFraction = 1.0 - shardStatistics->nullFraction -
+								   mostCommonFraction;
+		double histogramRowCount = Max(shardStatistics->rowCount * histogramFraction,
+									   1.0);
+		double boundWeight = histogramRowCount / shardBoundCount;
+
+		maxBoundCount = Max(maxBoundCount, shardBoundCount);
+
+		for (int boundIndex = 0; boundIndex < shardBoundCount; boundIndex++)
+		{
+			if (boundCount == boundCapacity)
+			{
+				boundCapacity *= 2;
+				bounds = repalloc(bounds, boundCapacity * sizeof(WeightedBound));
+			}
+
+			bounds[boundCount].value = shardBounds[boundIndex];
+			bounds[boundCount].weight = boundWeight;
+			boundCount++;
+		}
+	}
+
+	if (boundCount < 2)
+	{
+		return;
+	}
+
+	qsort_arg(bounds, boundCount, sizeof(WeightedBound), CompareWeightedBounds,
+			  typeInfo);
+
+	double totalWeight = 0.0;
+	for (int boundIndex = 0; boundIndex < boundCount; boundIndex++)
+	{
+		totalWeight += bounds[boundIndex].weight;
+	}
+
+	int histogramBoundCount = Min(maxBoundCount, boundCount);
+	int lastHistogramIndex = histogramBoundCount - 1;
+	double cumulativeWeight = 0.0;
+	int boundIndex = 0;
+
+	mergedStatistics->histogramBoundCount = histogramBoundCount;
+	mergedStatistics->histogramBounds = palloc0(histogramBoundCount * sizeof(Datum));
+
+	for (int histogramIndex = 0; histogramIndex < histogramBoundCount;
+		 histogramIndex++)
+	{
+		if (histogramIndex == lastHistogramIndex)
+		{
+			boundIndex = boundCount - 1;
+		}
+		else if (histogramIndex > 0)
+		{
+			double targetWeight = totalWeight * histogramIndex / lastHistogramIndex;
+
+			while (boundIndex < boundCount - 1 &&
+				   cumulativeWeight + bounds[boundIndex].weight < targetWeight)
+			{
+				cumulativeWeight += bounds[boundIndex].weight;
+				boundIndex++;
+			}
+		}
+
+		mergedStatistics->histogramBounds[histogramIndex] = bounds[boundIndex].value;
+	}
+}
+
+
+/*
+ * ParseStatisticsArray parses an array in text format using the given array
+ * input function and returns its (non-null) elements.
+ */
+static Datum *
+ParseStatisticsArray(char *arrayText, Oid inputFunction, Oid ioParam, int32 typeMod,
+					 Oid elementType, int16 typeLength, bool typeByValue,
+					 char typeAlign, int *valueCount)
+{
+	Datum *values = NULL;
+	bool *nulls = NULL;
+	int elementCount = 0;
+
+	Datum arrayDatum = OidInputFunctionCall(inputFunction, arrayText, ioParam, typeMod);
+	ArrayType *array = DatumGetArrayTypeP(arrayDatum);
+
+	deconstruct_array(array, elementType, typeLength, typeByValue, typeAlign,
+					  &values, &nulls, &elementCount);
+
+	int nonNullCount = 0;
+	for (int elementIndex = 0; elementIndex < elementCount; elementIndex++)
+	{
+		if (!nulls[elementIndex])
+		{
+			values[nonNullCount++] = values[elementIndex];
+		}
+	}
+
+	*valueCount = nonNullCount;
+
+	return values;
+}
+
+
+/*
+ * ParseFrequencyArray parses a real[] in text format, as found in the
+ * most_common_freqs column of pg_stats.
+ */
+static float4 *
+ParseFrequencyArray(char *arrayText, int *frequencyCount)
+{
+	int valueCount = 0;
+	int32 typeMod = -1;
+
+	Datum *values = ParseStatisticsArray(arrayText, F_ARRAY_IN, FLOAT4OID, typeMod,
+										 FLOAT4OID, sizeof(float4), true,
+										 TYPALIGN_INT, &valueCount);
+
+	float4 *frequencies = palloc0(Max(valueCount, 1) * sizeof(float4));
+	for (int valueIndex = 0; valueIndex < valueCount; valueIndex++)
+	{
+		frequencies[valueIndex] = DatumGetFloat4(values[valueIndex]);
+	}
+
+	*frequencyCount = valueCount;
+
+	return frequencies;
+}
+
+
+/*
+ * ValuesAreEqual compares two values using the equality operator and collation
+ * of the column type in the ColumnTypeInfo.
+ */
+static bool
+ValuesAreEqual(Datum left, Datum right, ColumnTypeInfo *typeInfo)
+{
+	Datum isEqual = FunctionCall2Coll(typeInfo->equalityFunction,
+									  typeInfo->collationId, left, right);
+
+	return DatumGetBool(isEqual);
+}
+
+
+/*
+ * CompareValueCounts orders value counts by their value, using the comparison
+ * function and collation of the column type in the ColumnTypeInfo argument.
+ */
+static int
+CompareValueCounts(const void *left, const void *right, void *arg)
+{
+	const ValueCount *leftValueCount = (const ValueCount *) left;
+	const ValueCount *rightValueCount = (const ValueCount *) right;
+	ColumnTypeInfo *typeInfo = (ColumnTypeInfo *) arg;
+
+	Datum comparison = FunctionCall2Coll(typeInfo->compareFunction,
+										 typeInfo->collationId,
+										 leftValueCount->value, rightValueCount->value);
+
+	return DatumGetInt32(comparison);
+}
+
+
+/*
+ * CompareValueCountsByRowCount orders value counts by descending row count,
+ * and by the position at which they were first seen to make the order
+ * deterministic.
+ */
+static int
+CompareValueCountsByRowCount(const void *left, const void *right)
+{
+	const ValueCount *leftValueCount = (const ValueCount *) left;
+	const ValueCount *rightValueCount = (const ValueCount *) right;
+
+	if (leftValueCount->rowCount > rightValueCount->rowCount)
+	{
+		return -1;
+	}
+	else if (leftValueCount->rowCount < rightValueCount->rowCount)
+	{
+		return 1;
+	}
+
+	return leftValueCount->firstPosition - rightValueCount->firstPosition;
+}
+
+
+/*
+ * CompareWeightedBounds orders histogram bounds using the comparison function
+ * and collation of the column type in the ColumnTypeInfo argument.
+ */
+static int
+CompareWeightedBounds(const void *left, const void *right, void *arg)
+{
+	const WeightedBound *leftBound = (const WeightedBound *) left;
+	const WeightedBound *rightBound = (const WeightedBound *) right;
+	ColumnTypeInfo *typeInfo = (ColumnTypeInfo *) arg;
+
+	Datum comparison = FunctionCall2Coll(typeInfo->compareFunction,
+										 typeInfo->collationId,
+										 leftBound->value, rightBound->value);
+
+	return DatumGetInt32(comparison);
+}
+
+
+/*
+ * StoreColumnStatistics inserts or updates the pg_statistic entry of the given
+ * column, with the most common values, histogram and correlation in the same
+ * slots that ANALYZE uses.
+ */
+static void
+StoreColumnStatistics(Relation statisticRelation, Oid relationId,
+					  AttrNumber attributeNumber, bool inherited,
+					  ColumnTypeInfo *typeInfo,
+					  MergedColumnStatistics *mergedStatistics)
+{
+	Datum values[Natts_pg_statistic];
+	bool isNulls[Natts_pg_statistic];
+	bool replaces[Natts_pg_statistic];
+
+	memset(values, 0, sizeof(values));
+	memset(isNulls, false, sizeof(isNulls));
+	memset(replaces, true, sizeof(replaces));
+
+	values[Anum_pg_statistic_starelid - 1] = ObjectIdGetDatum(relationId);
+	values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(attributeNumber);
+	values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(inherited);
+	values[Anum_pg_statistic_stanullfrac - 1] =
+		Float4GetDatum(mergedStatistics->nullFraction);
+	values[Anum_pg_statistic_stawidth - 1] =
+		Int32GetDatum(mergedStatistics->averageWidth);
+	values[Anum_pg_statistic_stadistinct - 1] =
+		Float4GetDatum(mergedStatistics->distinctCount);
+
+	for (int slotIndex = 0; slotIndex < STATISTIC_NUM_SLOTS; slotIndex++)
+	{
+		values[Anum_pg_statistic_stakind1 - 1 + slotIndex] = Int16GetDatum(0);
+		values[Anum_pg_statistic_staop1 - 1 + slotIndex] = ObjectIdGetDatum(InvalidOid);
+		values[Anum_pg_statistic_stacoll1 - 1 + slotIndex] =
+			ObjectIdGetDatum(InvalidOid);
+		isNulls[Anum_pg_statistic_stanumbers1 - 1 + slotIndex] = true;
+		isNulls[Anum_pg_statistic_stavalues1 - 1 + slotIndex] = true;
+	}
+
+	int slotIndex = 0;
+
+	if (mergedStatistics->mostCommonValueCount > 0)
+	{
+		ArrayType *frequencyArray =
+			construct_array(mergedStatistics->mostCommonFrequencies,
+							mergedStatistics->mostCommonValueCount,
+							FLOAT4OID, sizeof(float4), true, TYPALIGN_INT);
+		ArrayType *valueArray =
+			construct_array(mergedStatistics->mostCommonValues,
+							mergedStatistics->mostCommonValueCount,
+							typeInfo->typeId, typeInfo->typeLength,
+							typeInfo->typeByValue, typeInfo->typeAlign);
+
+		values[Anum_pg_statistic_stakind1 - 1 + slotIndex] =
+			Int16GetDatum(STATISTIC_KIND_MCV);
+		values[Anum_pg_statistic_staop1 - 1 + slotIndex] =
+			ObjectIdGetDatum(typeInfo->equalityOperator);
+		values[Anum_pg_statistic_stacoll1 - 1 + slotIndex] =
+			ObjectIdGetDatum(typeInfo->collationId);
+		values[Anum_pg_statistic_stanumbers1 - 1 + slotIndex] =
+			PointerGetDatum(frequencyArray);
+		isNulls[Anum_pg_statistic_stanumbers1 - 1 + slotIndex] = false;
+		values[Anum_pg_statistic_stavalues1 - 1 + slotIndex] =
+			PointerGetDatum(valueArray);
+		isNulls[Anum_pg_statistic_stavalues1 - 1 + slotIndex] = false;
+		slotIndex++;
+	}
+
+	if (mergedStatistics->histogramBoundCount >= 2)
+	{
+		ArrayType *boundArray =
+			construct_array(mergedStatistics->histogramBounds,
+							mergedStatistics->histogramBoundCount,
+							typeInfo->typeId, typeInfo->typeLength,
+							typeInfo->typeByValue, typeInfo->typeAlign);
+
+		values[Anum_pg_statistic_stakind1 - 1 + slotIndex] =
+			Int16GetDatum(STATISTIC_KIND_HISTOGRAM);
+		values[Anum_pg_statistic_staop1 - 1 + slotIndex] =
+			ObjectIdGetDatum(typeInfo->lessThanOperator);
+		values[Anum_pg_statistic_stacoll1 - 1 + slotIndex] =
+			ObjectIdGetDatum(typeInfo->collationId);
+		values[Anum_pg_statistic_stavalues1 - 1 + slotIndex] =
+			PointerGetDatum(boundArray);
+		isNulls[Anum_pg_statistic_stavalues1 - 1 + slotIndex] = false;
+		slotIndex++;
+	}
+
+	if (mergedStatistics->hasCorrelation)
+	{
+		Datum correlationDatum = Float4GetDatum(mergedStatistics->correlation);
+		ArrayType *correlationArray = construct_array(&correlationDatum, 1, FLOAT4OID,
+													  sizeof(float4), true,
+													  TYPALIGN_INT);
+
+		values[Anum_pg_statistic_stakind1 - 1 + slotIndex] =
+			Int16GetDatum(STATISTIC_KIND_CORRELATION);
+		values[Anum_pg_statistic_staop1 - 1 + slotIndex] =
+			ObjectIdGetDatum(typeInfo->lessThanOperator);
+		values[Anum_pg_statistic_stacoll1 - 1 + slotIndex] =
+			ObjectIdGetDatum(typeInfo->collationId);
+		values[Anum_pg_statistic_stanumbers1 - 1 + slotIndex] =
+			PointerGetDatum(correlationArray);
+		isNulls[Anum_pg_statistic_stanumbers1 - 1 + slotIndex] = false;
+		slotIndex++;
+	}
+
+	TupleDesc tupleDescriptor = RelationGetDescr(statisticRelation);
+	HeapTuple oldTuple = SearchSysCache3(STATRELATTINH,
+										 ObjectIdGetDatum(relationId),
+										 Int16GetDatum(attributeNumber),
+										 BoolGetDatum(inherited));
+	if (HeapTupleIsValid(oldTuple))
+	{
+		HeapTuple newTuple = heap_modify_tuple(oldTuple, tupleDescriptor, values,
+											   isNulls, replaces);
+		ReleaseSysCache(oldTuple);
+
+		CatalogTupleUpdate(statisticRelation, &newTuple->t_self, newTuple);
+	}
+	else
+	{
+		HeapTuple newTuple = heap_form_tuple(tupleDescriptor, values, isNulls);
+
+		CatalogTupleInsert(statisticRelation, newTuple);
+	}
+}
+
+
+/*
+ * StoreRelationStatistics sets reltuples and relpages of the given relation
+ * to the totals of its shards. Unlike ANALYZE, we update pg_class
+ * transactionally, which also invalidates cached plans that use the table.
+ */
+static void
+StoreRelationStatistics(Oid relationId, double rowCount, double pageCount)
+{
+	Relation pgClass = table_open(RelationRelationId, RowExclusiveLock);
+
+	HeapTuple classTuple = SearchSysCacheCopy1(RELOID, ObjectIdGetDatum(relationId));
+	if (!HeapTupleIsValid(classTuple))
+	{
+		ereport(ERROR, (errmsg("cache lookup failed for relation %u", relationId)));
+	}
+
+	Form_pg_class classForm = (Form_pg_class) GETSTRUCT(classTuple);
+	classForm->reltuples = (float4) rowCount;
+	classForm->relpages = (int32) Min(pageCount, (double) PG_INT32_MAX);
+
+	CatalogTupleUpdate(pgClass, &classTuple->t_self, classTuple);
+
+	heap_freetuple(classTuple);
+	table_close(pgClass, RowExclusiveLock);
+
+	CommandCounterIncrement();
+}
+
+
+/*
+ * SetDistributedTableSizeEstimate is called from the get_relation_info hook to
+ * make the planner use the row and page counts that citus_analyze stored for
+ * a distributed or reference table. The shell table itself is empty, so
+ * PostgreSQL would otherwise estimate its size from its (lack of) blocks.
+ */
+void
+SetDistributedTableSizeEstimate(Oid relationId, RelOptInfo *rel)
+{
+	if (rel->tuples > 0 || !IsCitusTable(relationId))
+	{
+		return;
+	}
+
+	HeapTuple classTuple = SearchSysCache1(RELOID, ObjectIdGetDatum(relationId));
+	if (!HeapTupleIsValid(classTuple))
+	{
+		return;
+	}
+
+	Form_pg_class classForm = (Form_pg_class) GETSTRUCT(classTuple);
+	if (classForm->reltuples > 0 && classForm->relpages > 0)
+	{
+		rel->pages = (BlockNumber) classForm->relpages;
+		rel->tuples = classForm->reltuples;
+	}
+
+	ReleaseSysCache(classTuple);
+}
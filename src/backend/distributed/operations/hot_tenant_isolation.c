@@ -0,0 +1,596 @@
+/*-------------------------------------------------------------------------
+ *
+ * hot_tenant_isolation.c
+ *
+ * Functions for isolating busy tenants to their own shard in the background.
+ *
+ * citus_stat_tenants keeps track of the query count and CPU usage of tenants.
+ * When citus.hot_tenant_isolation_interval is set, the maintenance daemon on
+ * the coordinator checks the statistics of the last period of all tenants.
+ * Once a tenant stays above citus.hot_tenant_query_threshold or
+ * citus.hot_tenant_cpu_threshold for citus.hot_tenant_sustain_time, it
+ * schedules a background job that isolates the tenant to a new shard and
+ * moves that shard to the least loaded node, such that the tenant no longer
+ * competes for resources with the other tenants in its shard.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "miscadmin.h"
+
+#include "access/xact.h"
+#include "executor/spi.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "distributed/citus_ruleutils.h"
+#include "distributed/colocation_utils.h"
+#include "distributed/coordinator_protocol.h"
+#include "distributed/hot_tenant_isolation.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/metadata_utility.h"
+#include "distributed/multi_join_order.h"
+#include "distributed/multi_partitioning_utils.h"
+#include "distributed/shard_transfer.h"
+#include "distributed/utils/citus_stat_tenants.h"
+
+/* job type of the background jobs that isolate a tenant */
+#define TENANT_ISOLATION_JOB_TYPE "isolate_tenant"
+
+
+/*
+ * HotTenantEntry keeps track of a tenant that was above the thresholds at
+ * the last checks of the maintenance daemon.
+ */
+typedef struct HotTenantEntry
+{
+	TenantStatsHashKey key;   /* hash key of entry - MUST BE FIRST */
+
+	/* time of the first check at which the tenant was above the thresholds */
+	TimestampTz hotSince;
+
+	/* number of the last check at which the tenant was above the thresholds */
+	uint64 lastHotCheck;
+} HotTenantEntry;
+
+
+static List * HotTenantList(void);
+static void UpdateHotTenants(List *hotTenantList, TimestampTz checkTime);
+static bool ScheduleHotTenantIsolation(TenantStatsHashKey *tenantKey);
+static Oid TenantRelationId(int colocationId);
+static ShardInterval * TenantShardInterval(Oid relationId, char *tenantValue);
+static bool TenantIsIsolated(Oid relationId, char *tenantValue);
+static int32 LeastLoadedNodeId(int32 excludedNodeId);
+
+PG_FUNCTION_INFO_V1(citus_schedule_tenant_isolation);
+
+/* GUCs that determine when the maintenance daemon isolates a tenant */
+int HotTenantIsolationInterval = -1;
+int HotTenantQueryThreshold = 10000;
+double HotTenantCpuThreshold = 0.0;
+int HotTenantSustainTime = 600;
+
+/* tenants that were above the thresholds at the last check of this process */
+static HTAB *HotTenantHash = NULL;
+static uint64 HotTenantCheckCount = 0;
+
+
+/*
+ * citus_schedule_tenant_isolation schedules a background job that isolates
+ * the given tenant of a table to its own shard and then moves that shard to
+ * the least loaded node. It returns the id of the job.
+ */
+Datum
+citus_schedule_tenant_isolation(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+	EnsureCoordinator();
+
+	Oid relationId = PG_GETARG_OID(0);
+	char *tenantValue = text_to_cstring(PG_GETARG_TEXT_P(1));
+	Oid shardTransferModeOid = PG_GETARG_OID(2);
+
+	EnsureTableOwner(relationId);
+
+	if (TenantIsIsolated(relationId, tenantValue))
+	{
+		char *tableName = get_rel_name(relationId);
+		ereport(ERROR, (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+						(errmsg("table %s has already been isolated for the given value",
+								quote_identifier(tableName)))));
+	}
+
+	char shardTransferMode = LookupShardTransferMode(shardTransferModeOid);
+	int64 jobId = ScheduleTenantIsolation(relationId, tenantValue, shardTransferMode);
+
+	ereport(NOTICE, (errmsg("Scheduled isolation of tenant %s of %s as job %ld",
+							tenantValue, get_rel_name(relationId), jobId),
+					 errhint("To monitor progress, run: SELECT * FROM "
+							 "pg_dist_background_task WHERE job_id = %ld ORDER BY "
+							 "task_id ASC;", jobId)));
+
+	PG_RETURN_INT64(jobId);
+}
+
+
+/*
+ * ScheduleTenantIsolation creates a background job with a task that isolates
+ * the given tenant of a hash distributed table, and of the tables colocated
+ * with it, to a new shard. If there is another node that can hold shards, a
+ * second task moves the new shard to the least loaded one of them.
+ */
+int64
+ScheduleTenantIsolation(Oid relationId, char *tenantValue, char shardTransferMode)
+{
+	ShardInterval *shardInterval = TenantShardInterval(relationId, tenantValue);
+
+	List *placementList = ActiveShardPlacementList(shardInterval->shardId);
+	if (list_length(placementList) > 1)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot isolate tenants when using shard replication")));
+	}
+
+	ShardPlacement *sourcePlacement = linitial(placementList);
+
+	if (shardTransferMode == TRANSFER_MODE_AUTOMATIC)
+	{
+		VerifyTablesHaveReplicaIdentity(ColocatedTableList(relationId));
+	}
+
+	const char *shardTransferModeString =
+		shardTransferMode == TRANSFER_MODE_BLOCK_WRITES ? "block_writes" :
+		shardTransferMode == TRANSFER_MODE_FORCE_LOGICAL ? "force_logical" :
+		"auto";
+
+	char *qualifiedRelationName = generate_qualified_relation_name(relationId);
+	char *quotedRelationName = quote_literal_cstr(qualifiedRelationName);
+	char *quotedTenantValue = quote_literal_cstr(tenantValue);
+	char *quotedTransferMode = quote_literal_cstr(shardTransferModeString);
+
+	StringInfoData buf = { 0 };
+	initStringInfo(&buf);
+
+	appendStringInfo(&buf, "Isolate tenant %s of %s", tenantValue,
+					 qualifiedRelationName);
+	int64 jobId = CreateBackgroundJob(TENANT_ISOLATION_JOB_TYPE, buf.data);
+
+	/* the new shard is created on the node of the current shard */
+	resetStringInfo(&buf);
+	appendStringInfo(&buf,
+					 "SELECT pg_catalog.isolate_tenant_to_new_shard(%s, %s::text, "
+					 "'CASCADE', %s)",
+					 quotedRelationName, quotedTenantValue, quotedTransferMode);
+
+	int32 isolateNodesInvolved[] = { sourcePlacement->nodeId };
+	BackgroundTask *isolateTask = ScheduleBackgroundTask(jobId, GetUserId(), buf.data,
+														 0, NULL, 1,
+														 isolateNodesInvolved);
+
+	int32 targetNodeId = LeastLoadedNodeId(sourcePlacement->nodeId);
+	if (targetNodeId == 0)
+	{
+		/* there is no other node to move the tenant to */
+		return jobId;
+	}
+
+	/*
+	 * The id of the new shard is only known after the isolation, and its
+	 * placement may have moved by then, so both are looked up by the task.
+	 */
+	resetStringInfo(&buf);
+	appendStringInfo(&buf,
+					 "SELECT pg_catalog.citus_move_shard_placement("
+					 "placement.shardid, node.nodeid, %d, %s) "
+					 "FROM pg_catalog.pg_dist_placement placement "
+					 "JOIN pg_catalog.pg_dist_node node USING (groupid) "
+					 "WHERE placement.shardid = "
+					 "pg_catalog.get_shard_id_for_distribution_column(%s, %s::text) "
+					 "AND node.noderole = 'primary'",
+					 targetNodeId, quotedTransferMode,
+					 quotedRelationName, quotedTenantValue);
+
+	int64 dependsArray[] = { isolateTask->taskid };
+	int32 moveNodesInvolved[] = { sourcePlacement->nodeId, targetNodeId };
+	ScheduleBackgroundTask(jobId, GetUserId(), buf.data, 1, dependsArray, 2,
+						   moveNodesInvolved);
+
+	return jobId;
+}
+
+
+/*
+ * TryScheduleHotTenantIsolation checks the tenant statistics for the
+ * maintenance daemon and schedules the isolation of the busiest tenant that
+ * has been above the thresholds for citus.hot_tenant_sustain_time. Only one
+ * tenant is isolated at a time, and none while a rebalance is running.
+ * Errors are turned into warnings.
+ *
+ * The function returns the number of scheduled jobs.
+ */
+int
+TryScheduleHotTenantIsolation(void)
+{
+	MemoryContext savedContext = CurrentMemoryContext;
+	TimestampTz checkTime = GetCurrentTimestamp();
+	List *volatile hotTenantList = NIL;
+
+	if (HotTenantQueryThreshold <= 0 && HotTenantCpuThreshold <= 0)
+	{
+		return 0;
+	}
+
+	BeginInternalSubTransaction(NULL);
+
+	PG_TRY();
+	{
+		List *tenantList = HotTenantList();
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(savedContext);
+
+		UpdateHotTenants(tenantList, checkTime);
+		hotTenantList = tenantList;
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(savedContext);
+		ErrorData *edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(savedContext);
+
+		/* rethrow as WARNING */
+		edata->elevel = WARNING;
+		ThrowErrorData(edata);
+	}
+	PG_END_TRY();
+
+	if (hotTenantList == NIL)
+	{
+		return 0;
+	}
+
+	int64 jobId = 0;
+	if (HasNonTerminalJobOfType(TENANT_ISOLATION_JOB_TYPE, &jobId) ||
+		HasNonTerminalJobOfType("rebalance", &jobId))
+	{
+		return 0;
+	}
+
+	/* the list is ordered by load, so we isolate the busiest tenant first */
+	TenantStatsHashKey *tenantKey = NULL;
+	foreach_ptr(tenantKey, hotTenantList)
+	{
+		HotTenantEntry *hotTenant = hash_search(HotTenantHash, tenantKey, HASH_FIND,
+												NULL);
+		if (hotTenant == NULL ||
+			!TimestampDifferenceExceeds(hotTenant->hotSince, checkTime,
+										HotTenantSustainTime * 1000))
+		{
+			continue;
+		}
+
+		/*
+		 * Once we tried to isolate a tenant, it has to be above the thresholds
+		 * for citus.hot_tenant_sustain_time again before we retry.
+		 */
+		hash_search(HotTenantHash, tenantKey, HASH_REMOVE, NULL);
+
+		volatile bool scheduled = false;
+
+		BeginInternalSubTransaction(NULL);
+
+		PG_TRY();
+		{
+			scheduled = ScheduleHotTenantIsolation(tenantKey);
+
+			ReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(savedContext);
+		}
+		PG_CATCH();
+		{
+			MemoryContextSwitchTo(savedContext);
+			ErrorData *edata = CopyErrorData();
+			FlushErrorState();
+
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(savedContext);
+
+			/* rethrow as WARNING */
+			edata->elevel = WARNING;
+			ThrowErrorData(edata);
+		}
+		PG_END_TRY();
+
+		if (scheduled)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * HotTenantList returns the keys of the tenants whose query count or CPU
+ * usage in the last period, summed over all nodes, is above the thresholds.
+ * The busiest tenants come first.
+ */
+static List *
+HotTenantList(void)
+{
+	MemoryContext callerContext = CurrentMemoryContext;
+	List *hotTenantList = NIL;
+
+	StringInfo hotTenantQuery = makeStringInfo();
+	appendStringInfo(hotTenantQuery,
+					 "SELECT colocation_id, tenant_attribute "
+					 "FROM pg_catalog.citus_stat_tenants(true) "
+					 "WHERE tenant_attribute IS NOT NULL "
+					 "GROUP BY colocation_id, tenant_attribute "
+					 "HAVING (%d > 0 AND sum(query_count_in_last_period) >= %d) "
+					 "OR (%f > 0 AND sum(cpu_usage_in_last_period) >= %f) "
+					 "ORDER BY sum(query_count_in_last_period) DESC, "
+					 "sum(cpu_usage_in_last_period) DESC",
+					 HotTenantQueryThreshold, HotTenantQueryThreshold,
+					 HotTenantCpuThreshold, HotTenantCpuThreshold);
+
+	int spiConnectionResult = SPI_connect();
+	if (spiConnectionResult != SPI_OK_CONNECT)
+	{
+		ereport(ERROR, (errmsg("could not connect to SPI manager")));
+	}
+
+	bool readOnly = false;
+	int spiQueryResult = SPI_execute(hotTenantQuery->data, readOnly, 0);
+	if (spiQueryResult != SPI_OK_SELECT)
+	{
+		ereport(ERROR, (errmsg("execution was not successful \"%s\"",
+							   hotTenantQuery->data)));
+	}
+
+	for (uint64 rowIndex = 0; rowIndex < SPI_processed; rowIndex++)
+	{
+		HeapTuple tuple = SPI_tuptable->vals[rowIndex];
+		TupleDesc tupleDescriptor = SPI_tuptable->tupdesc;
+		bool isNull = false;
+
+		int colocationId = DatumGetInt32(SPI_getbinval(tuple, tupleDescriptor, 1,
+													   &isNull));
+		char *tenantAttribute = SPI_getvalue(tuple, tupleDescriptor, 2);
+
+		MemoryContext spiContext = MemoryContextSwitchTo(callerContext);
+
+		TenantStatsHashKey *tenantKey = palloc0(sizeof(TenantStatsHashKey));
+		strlcpy(tenantKey->tenantAttribute, tenantAttribute,
+				MAX_TENANT_ATTRIBUTE_LENGTH);
+		tenantKey->colocationGroupId = colocationId;
+
+		hotTenantList = lappend(hotTenantList, tenantKey);
+
+		MemoryContextSwitchTo(spiContext);
+	}
+
+	SPI_finish();
+
+	return hotTenantList;
+}
+
+
+/*
+ * UpdateHotTenants records since when the given tenants are above the
+ * thresholds, and forgets the tenants that are no longer above them.
+ */
+static void
+UpdateHotTenants(List *hotTenantList, TimestampTz checkTime)
+{
+	if (HotTenantHash == NULL)
+	{
+		HASHCTL info = {
+			.keysize = sizeof(TenantStatsHashKey),
+			.entrysize = sizeof(HotTenantEntry),
+			.hcxt = TopMemoryContext
+		};
+
+		HotTenantHash = hash_create("Hot Tenant Hash", 32, &info,
+									HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+	}
+
+	HotTenantCheckCount++;
+
+	TenantStatsHashKey *tenantKey = NULL;
+	foreach_ptr(tenantKey, hotTenantList)
+	{
+		bool found = false;
+		HotTenantEntry *hotTenant = hash_search(HotTenantHash, tenantKey, HASH_ENTER,
+												&found);
+		if (!found)
+		{
+			hotTenant->hotSince = checkTime;
+		}
+
+		hotTenant->lastHotCheck = HotTenantCheckCount;
+	}
+
+	HASH_SEQ_STATUS status;
+	HotTenantEntry *hotTenant = NULL;
+
+	hash_seq_init(&status, HotTenantHash);
+	while ((hotTenant = hash_seq_search(&status)) != NULL)
+	{
+		if (hotTenant->lastHotCheck != HotTenantCheckCount)
+		{
+			hash_search(HotTenantHash, &hotTenant->key, HASH_REMOVE, NULL);
+		}
+	}
+}
+
+
+/*
+ * ScheduleHotTenantIsolation schedules the isolation of the given tenant
+ * from the tenant statistics, unless it is already isolated. It returns
+ * whether a job was scheduled.
+ */
+static bool
+ScheduleHotTenantIsolation(TenantStatsHashKey *tenantKey)
+{
+	Oid relationId = TenantRelationId(tenantKey->colocationGroupId);
+	if (!OidIsValid(relationId))
+	{
+		return false;
+	}
+
+	if (TenantIsIsolated(relationId, tenantKey->tenantAttribute))
+	{
+		return false;
+	}
+
+	int64 jobId = ScheduleTenantIsolation(relationId, tenantKey->tenantAttribute,
+										  TRANSFER_MODE_AUTOMATIC);
+
+	ereport(LOG, (errmsg("scheduled isolation of hot tenant %s of %s as job %ld",
+						 tenantKey->tenantAttribute, get_rel_name(relationId),
+						 jobId)));
+
+	return true;
+}
+
+
+/*
+ * TenantRelationId returns a hash distributed table of the given colocation
+ * group, through which the tenants of the group can be isolated, or
+ * InvalidOid if there is none.
+ */
+static Oid
+TenantRelationId(int colocationId)
+{
+	List *colocatedTableList = ColocationGroupTableList(colocationId, 0);
+
+	Oid relationId = InvalidOid;
+	foreach_oid(relationId, colocatedTableList)
+	{
+		if (IsCitusTableType(relationId, HASH_DISTRIBUTED) &&
+			!PartitionTable(relationId))
+		{
+			return relationId;
+		}
+	}
+
+	return InvalidOid;
+}
+
+
+/*
+ * TenantShardInterval returns the shard of a hash distributed table that
+ * contains the given distribution column value.
+ */
+static ShardInterval *
+TenantShardInterval(Oid relationId, char *tenantValue)
+{
+	CitusTableCacheEntry *cacheEntry = GetCitusTableCacheEntry(relationId);
+	if (cacheEntry->partitionMethod != DISTRIBUTE_BY_HASH)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot isolate tenant because tenant isolation "
+							   "is only support for hash distributed tables")));
+	}
+
+	Var *distributionColumn = DistPartitionKey(relationId);
+	Datum tenantDatum = StringToDatum(tenantValue, distributionColumn->vartype);
+
+	ShardInterval *shardInterval = FindShardInterval(tenantDatum, cacheEntry);
+	if (shardInterval == NULL)
+	{
+		ereport(ERROR, (errmsg("tenant does not have a shard")));
+	}
+
+	return shardInterval;
+}
+
+
+/*
+ * TenantIsIsolated returns whether the shard that contains the given tenant
+ * only contains that tenant.
+ */
+static bool
+TenantIsIsolated(Oid relationId, char *tenantValue)
+{
+	ShardInterval *shardInterval = TenantShardInterval(relationId, tenantValue);
+
+	return DatumGetInt32(shardInterval->minValue) ==
+		   DatumGetInt32(shardInterval->maxValue);
+}
+
+
+/*
+ * LeastLoadedNodeId returns the id of the active primary node that can hold
+ * shards with the lowest query load, other than the given node. The load is
+ * the shard load tracked by citus.stat_shard_load_track, and nodes with the
+ * same load are ordered by their number of placements. If there is no such
+ * node, 0 is returned.
+ */
+static int32
+LeastLoadedNodeId(int32 excludedNodeId)
+{
+	int32 nodeId = 0;
+
+	StringInfo nodeQuery = makeStringInfo();
+	appendStringInfo(nodeQuery,
+					 "SELECT node.nodeid "
+					 "FROM pg_catalog.pg_dist_node node "
+					 "LEFT JOIN ("
+					 "SELECT nodeid, result::float8 AS load "
+					 "FROM pg_catalog.run_command_on_all_nodes("
+					 "'SELECT coalesce(sum(load), 0) "
+					 "FROM pg_catalog.citus_shard_load_local()', "
+					 "give_warning_for_connection_errors := true) "
+					 "WHERE success) node_load USING (nodeid) "
+					 "LEFT JOIN ("
+					 "SELECT groupid, count(*) AS placement_count "
+					 "FROM pg_catalog.pg_dist_placement GROUP BY groupid"
+					 ") node_placements USING (groupid) "
+					 "WHERE node.isactive AND node.shouldhaveshards "
+					 "AND node.noderole = 'primary' AND node.nodeid <> %d "
+					 "ORDER BY coalesce(node_load.load, 0), "
+					 "coalesce(node_placements.placement_count, 0), node.nodeid "
+					 "LIMIT 1",
+					 excludedNodeId);
+
+	int spiConnectionResult = SPI_connect();
+	if (spiConnectionResult != SPI_OK_CONNECT)
+	{
+		ereport(ERROR, (errmsg("could not connect to SPI manager")));
+	}
+
+	bool readOnly = false;
+	int spiQueryResult = SPI_execute(nodeQuery->data, readOnly, 0);
+	if (spiQueryResult != SPI_OK_SELECT)
+	{
+		ereport(ERROR, (errmsg("execution was not successful \"%s\"",
+							   nodeQuery->data)));
+	}
+
+	if (SPI_processed > 0)
+	{
+		bool isNull = false;
+		Datum nodeIdDatum = SPI_getbinval(SPI_tuptable->vals[0],
+										  SPI_tuptable->tupdesc, 1, &isNull);
+		nodeId = DatumGetInt32(nodeIdDatum);
+	}
+
+	SPI_finish();
+
+	return nodeId;
+}
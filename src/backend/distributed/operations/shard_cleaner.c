@@ -22,12 +22,15 @@
 #include "postmaster/postmaster.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
+#include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 
 #include "distributed/citus_safe_lib.h"
 #include "distributed/coordinator_protocol.h"
 #include "distributed/listutils.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/pg_dist_cleanup.h"
+#include "distributed/pg_dist_shard_transfer_progress.h"
 #include "distributed/remote_commands.h"
 #include "distributed/resource_lock.h"
 #include "distributed/shard_cleaner.h"
@@ -41,6 +44,7 @@
 /* GUC configuration for shard cleaner */
 int NextOperationId = 0;
 int NextCleanupRecordId = 0;
+int ShardTransferResumeTimeout = 0;
 
 /* Data structure for cleanup operation */
 
@@ -96,7 +100,9 @@ static bool TryDropDatabaseOutsideTransaction(char *databaseName, char *nodeName
 											  int nodePort);
 
 static CleanupRecord * GetCleanupRecordByNameAndType(char *objectName,
-													 CleanupObject type);
+													 CleanupObject type,
+													 OperationId
+													 excludedOperationId);
 
 /* Functions for cleanup infrastructure */
 static CleanupRecord * TupleToCleanupRecord(HeapTuple heapTuple,
@@ -106,11 +112,21 @@ static OperationId GetNextOperationId(void);
 static uint64 GetNextCleanupRecordId(void);
 static void LockOperationId(OperationId operationId);
 static bool TryLockOperationId(OperationId operationId);
+static void UnlockOperationId(OperationId operationId);
 static void DeleteCleanupRecordByRecordId(uint64 recordId);
 static void DeleteCleanupRecordByRecordIdOutsideTransaction(uint64 recordId);
 static bool CleanupRecordExists(uint64 recordId);
 static List * ListCleanupRecords(void);
 static List * ListCleanupRecordsForCurrentOperation(void);
+static List * ListCleanupRecordsForOperation(OperationId operationId);
+static List * ListShardTransferProgress(void);
+static bool ShardTransferIsResumable(List *progressList, OperationId operationId);
+static bool ShardTransferProgressMatches(List *progressList,
+										 OperationId operationId,
+										 List *expectedProgressList);
+static bool ShardTransferResourcesExist(OperationId operationId, int targetShardCount);
+static bool ShardIntervalListContainsShard(List *shardIntervalList, uint64 shardId);
+static char * ShardIdArrayLiteral(List *shardIntervalList);
 static int DropOrphanedResourcesForCleanup(void);
 static int CompareCleanupRecordsByObjectType(const void *leftElement,
 											 const void *rightElement);
@@ -255,6 +271,8 @@ DropOrphanedResourcesForCleanup()
 	cleanupRecordList = SortList(cleanupRecordList,
 								 CompareCleanupRecordsByObjectType);
 
+	List *shardTransferProgressList = ListShardTransferProgress();
+
 	int removedResourceCountForCleanup = 0;
 	int failedResourceCountForCleanup = 0;
 	CleanupRecord *record = NULL;
@@ -266,6 +284,12 @@ DropOrphanedResourcesForCleanup()
 			continue;
 		}
 
+		if (ShardTransferIsResumable(shardTransferProgressList, record->operationId))
+		{
+			/* failed shard transfer keeps its resources until it is resumed */
+			continue;
+		}
+
 		/* Advisory locks are reentrant */
 		if (!TryLockOperationId(record->operationId))
 		{
@@ -345,6 +369,22 @@ RegisterOperationNeedingCleanup(void)
 }
 
 
+/*
+ * ResumeOperationNeedingCleanup is called instead of RegisterOperationNeedingCleanup
+ * by an operation that continues where a failed operation left off, such that the
+ * resources and cleanup records of the failed operation become its own.
+ */
+void
+ResumeOperationNeedingCleanup(OperationId operationId)
+{
+	Assert(operationId != INVALID_OPERATION_ID);
+
+	CurrentOperationId = operationId;
+
+	LockOperationId(CurrentOperationId);
+}
+
+
 /*
  * FinalizeOperationNeedingCleanupOnSuccess is be called by an operation to signal
  * completion with success. This will trigger cleanup of appropriate resources.
@@ -954,13 +994,15 @@ TryDropDatabaseOutsideTransaction(char *databaseName, char *nodeName, int nodePo
 
 /*
  * ErrorIfCleanupRecordForShardExists errors out if a cleanup record for the given
- * shard name exists.
+ * shard name exists, other than the records of resumedOperationId, which is the
+ * failed shard transfer that the caller resumes (if any).
  */
 void
-ErrorIfCleanupRecordForShardExists(char *shardName)
+ErrorIfCleanupRecordForShardExists(char *shardName, OperationId resumedOperationId)
 {
 	CleanupRecord *record =
-		GetCleanupRecordByNameAndType(shardName, CLEANUP_OBJECT_SHARD_PLACEMENT);
+		GetCleanupRecordByNameAndType(shardName, CLEANUP_OBJECT_SHARD_PLACEMENT,
+									  resumedOperationId);
 
 	if (record == NULL)
 	{
@@ -973,6 +1015,548 @@ ErrorIfCleanupRecordForShardExists(char *shardName)
 }
 
 
+/*
+ * ShardTransferProgressForShardList returns the progress records that a move
+ * or copy of the given shards from the source node to the target node writes
+ * once it copied them, which have no operation ID or expiry time yet.
+ */
+List *
+ShardTransferProgressForShardList(List *shardIntervalList, uint32 sourceNodeId,
+								  uint32 targetNodeId)
+{
+	List *progressList = NIL;
+
+	ShardInterval *shardInterval = NULL;
+	foreach_ptr(shardInterval, shardIntervalList)
+	{
+		ShardTransferProgress *progress = palloc0(sizeof(ShardTransferProgress));
+		progress->shardId = shardInterval->shardId;
+		progress->sourceShardId = shardInterval->shardId;
+		progress->sourceNodeId = sourceNodeId;
+		progress->targetNodeId = targetNodeId;
+
+		progressList = lappend(progressList, progress);
+	}
+
+	return progressList;
+}
+
+
+/*
+ * InsertShardTransferProgressOutsideTransaction records that the current
+ * operation copied the shards in the given progress records to their target
+ * nodes, such that a retry can resume the transfer from the copied shards if it
+ * fails afterwards. The records are inserted in a separate transaction to ensure
+ * they persist after rollback. It does nothing when resuming shard transfers is
+ * disabled.
+ */
+void
+InsertShardTransferProgressOutsideTransaction(List *progressList)
+{
+	/* We must have a valid OperationId. Any operation requring cleanup
+	 * will call RegisterOperationNeedingCleanup.
+	 */
+	Assert(CurrentOperationId != INVALID_OPERATION_ID);
+
+	if (ShardTransferResumeTimeout <= 0 || list_length(progressList) == 0)
+	{
+		return;
+	}
+
+	StringInfo command = makeStringInfo();
+	appendStringInfo(command,
+					 "INSERT INTO %s.%s "
+					 " (operation_id, shardid, source_shardid, source_node_id, "
+					 " target_node_id, shard_min_value, shard_max_value, "
+					 " copied_at, resumable_until) VALUES ",
+					 PG_CATALOG,
+					 PG_DIST_SHARD_TRANSFER_PROGRESS);
+
+	const char *separator = "";
+	ShardTransferProgress *progress = NULL;
+	foreach_ptr(progress, progressList)
+	{
+		appendStringInfo(command,
+						 "%s(" UINT64_FORMAT ", " UINT64_FORMAT ", " UINT64_FORMAT
+						 ", %u, %u, %s, %s, now(), "
+						 "now() + %d * interval '1 millisecond')",
+						 separator,
+						 CurrentOperationId,
+						 progress->shardId,
+						 progress->sourceShardId,
+						 progress->sourceNodeId,
+						 progress->targetNodeId,
+						 progress->minValue != NULL ?
+						 quote_literal_cstr(progress->minValue) : "NULL",
+						 progress->maxValue != NULL ?
+						 quote_literal_cstr(progress->maxValue) : "NULL",
+						 ShardTransferResumeTimeout);
+		separator = ", ";
+	}
+
+	MultiConnection *connection =
+		GetConnectionForLocalQueriesOutsideTransaction(CitusExtensionOwnerName());
+	SendCommandListToWorkerOutsideTransactionWithConnection(connection,
+															list_make1(command->data));
+}
+
+
+/*
+ * DeleteShardTransferProgressOutsideTransaction deletes the progress records of
+ * the current operation in a separate transaction. Shard transfers call it
+ * before they make changes to the copied shards that a retry could not redo,
+ * after which a failure cleans up the copied shards as usual.
+ */
+void
+DeleteShardTransferProgressOutsideTransaction(void)
+{
+	Assert(CurrentOperationId != INVALID_OPERATION_ID);
+
+	List *progressList = ListShardTransferProgress();
+	bool progressExists = false;
+
+	ShardTransferProgress *progress = NULL;
+	foreach_ptr(progress, progressList)
+	{
+		if (progress->operationId == CurrentOperationId)
+		{
+			progressExists = true;
+			break;
+		}
+	}
+
+	if (!progressExists)
+	{
+		return;
+	}
+
+	StringInfo command = makeStringInfo();
+	appendStringInfo(command,
+					 "DELETE FROM %s.%s WHERE operation_id = " UINT64_FORMAT,
+					 PG_CATALOG,
+					 PG_DIST_SHARD_TRANSFER_PROGRESS,
+					 CurrentOperationId);
+
+	MultiConnection *connection =
+		GetConnectionForLocalQueriesOutsideTransaction(CitusExtensionOwnerName());
+	SendCommandListToWorkerOutsideTransactionWithConnection(connection,
+															list_make1(command->data));
+}
+
+
+/*
+ * LockResumableShardTransfer looks for a failed transfer that copied exactly
+ * the shards described by expectedProgressList, and that can still be resumed.
+ * The expected records only need to have the source shard, the nodes and the
+ * hash range set, since a split allocates new IDs for the shards it creates.
+ *
+ * If there is such a transfer, it takes the lock of its operation, such that
+ * its resources are not cleaned up concurrently, and returns the operation ID.
+ * When resumedProgressList is not NULL, it is set to the progress records of
+ * the operation. Otherwise, it returns INVALID_OPERATION_ID.
+ */
+OperationId
+LockResumableShardTransfer(List *expectedProgressList, List **resumedProgressList)
+{
+	if (ShardTransferResumeTimeout <= 0 || list_length(expectedProgressList) == 0)
+	{
+		return INVALID_OPERATION_ID;
+	}
+
+	ShardTransferProgress *firstExpectedProgress =
+		(ShardTransferProgress *) linitial(expectedProgressList);
+	List *progressList = ListShardTransferProgress();
+	OperationId operationId = INVALID_OPERATION_ID;
+
+	/* prefer the most recent attempt, in case there are several */
+	ShardTransferProgress *progress = NULL;
+	foreach_ptr(progress, progressList)
+	{
+		if (progress->sourceShardId == firstExpectedProgress->sourceShardId &&
+			progress->operationId > operationId &&
+			ShardTransferProgressMatches(progressList, progress->operationId,
+										 expectedProgressList))
+		{
+			operationId = progress->operationId;
+		}
+	}
+
+	if (operationId == INVALID_OPERATION_ID)
+	{
+		return INVALID_OPERATION_ID;
+	}
+
+	if (!TryLockOperationId(operationId))
+	{
+		/* resources of the operation are being cleaned up */
+		return INVALID_OPERATION_ID;
+	}
+
+	/*
+	 * The resources might have been cleaned up after the progress records
+	 * expired and before we got the lock, in which case the cleanup records
+	 * are gone as well. Now that we hold the lock, they cannot be removed
+	 * anymore, so we check again using a fresh snapshot.
+	 */
+	InvalidateCatalogSnapshot();
+
+	progressList = ListShardTransferProgress();
+	if (!ShardTransferProgressMatches(progressList, operationId,
+									  expectedProgressList) ||
+		!ShardTransferResourcesExist(operationId, list_length(expectedProgressList)))
+	{
+		UnlockOperationId(operationId);
+		return INVALID_OPERATION_ID;
+	}
+
+	if (resumedProgressList != NULL)
+	{
+		*resumedProgressList = NIL;
+
+		foreach_ptr(progress, progressList)
+		{
+			if (progress->operationId == operationId)
+			{
+				*resumedProgressList = lappend(*resumedProgressList, progress);
+			}
+		}
+	}
+
+	return operationId;
+}
+
+
+/*
+ * AbandonShardTransferProgress deletes the progress records of failed transfers
+ * from any of the given shards other than resumedOperationId, as well as all
+ * expired progress records, in a separate transaction. That lets the orphaned
+ * resources of the abandoned transfers be cleaned up right away, which needs to
+ * happen before the shards can be transferred again.
+ */
+void
+AbandonShardTransferProgress(List *shardIntervalList, OperationId resumedOperationId)
+{
+	List *progressList = ListShardTransferProgress();
+	TimestampTz currentTime = GetCurrentTimestamp();
+	bool abandonedProgressExists = false;
+
+	ShardTransferProgress *progress = NULL;
+	foreach_ptr(progress, progressList)
+	{
+		if (progress->resumableUntil <= currentTime ||
+			(progress->operationId != resumedOperationId &&
+			 ShardIntervalListContainsShard(shardIntervalList,
+											progress->sourceShardId)))
+		{
+			abandonedProgressExists = true;
+			break;
+		}
+	}
+
+	if (!abandonedProgressExists)
+	{
+		return;
+	}
+
+	StringInfo command = makeStringInfo();
+	appendStringInfo(command,
+					 "DELETE FROM %s.%s "
+					 "WHERE resumable_until <= now() "
+					 "OR (operation_id <> " UINT64_FORMAT " AND operation_id IN "
+					 "(SELECT operation_id FROM %s.%s WHERE source_shardid = ANY(%s)))",
+					 PG_CATALOG,
+					 PG_DIST_SHARD_TRANSFER_PROGRESS,
+					 resumedOperationId,
+					 PG_CATALOG,
+					 PG_DIST_SHARD_TRANSFER_PROGRESS,
+					 ShardIdArrayLiteral(shardIntervalList));
+
+	MultiConnection *connection =
+		GetConnectionForLocalQueriesOutsideTransaction(CitusExtensionOwnerName());
+	SendCommandListToWorkerOutsideTransactionWithConnection(connection,
+															list_make1(command->data));
+}
+
+
+/*
+ * ListShardTransferProgress lists all the records in pg_dist_shard_transfer_progress.
+ */
+static List *
+ListShardTransferProgress(void)
+{
+	Relation pgDistShardTransferProgress =
+		table_open(DistShardTransferProgressRelationId(), AccessShareLock);
+	TupleDesc tupleDescriptor = RelationGetDescr(pgDistShardTransferProgress);
+
+	List *progressList = NIL;
+	int scanKeyCount = 0;
+	bool indexOK = false;
+
+	SysScanDesc scanDescriptor = systable_beginscan(pgDistShardTransferProgress,
+													InvalidOid, indexOK, NULL,
+													scanKeyCount, NULL);
+
+	HeapTuple heapTuple = NULL;
+	while (HeapTupleIsValid(heapTuple = systable_getnext(scanDescriptor)))
+	{
+		Datum datumArray[Natts_pg_dist_shard_transfer_progress];
+		bool isNullArray[Natts_pg_dist_shard_transfer_progress];
+		heap_deform_tuple(heapTuple, tupleDescriptor, datumArray, isNullArray);
+
+		ShardTransferProgress *progress = palloc0(sizeof(ShardTransferProgress));
+
+		progress->operationId = DatumGetUInt64(
+			datumArray[Anum_pg_dist_shard_transfer_progress_operation_id - 1]);
+		progress->shardId = DatumGetUInt64(
+			datumArray[Anum_pg_dist_shard_transfer_progress_shardid - 1]);
+		progress->sourceShardId = DatumGetUInt64(
+			datumArray[Anum_pg_dist_shard_transfer_progress_source_shardid - 1]);
+		progress->sourceNodeId = DatumGetUInt32(
+			datumArray[Anum_pg_dist_shard_transfer_progress_source_node_id - 1]);
+		progress->targetNodeId = DatumGetUInt32(
+			datumArray[Anum_pg_dist_shard_transfer_progress_target_node_id - 1]);
+		progress->resumableUntil = DatumGetTimestampTz(
+			datumArray[Anum_pg_dist_shard_transfer_progress_resumable_until - 1]);
+
+		if (!isNullArray[Anum_pg_dist_shard_transfer_progress_shard_min_value - 1])
+		{
+			progress->minValue = TextDatumGetCString(
+				datumArray[Anum_pg_dist_shard_transfer_progress_shard_min_value - 1]);
+		}
+
+		if (!isNullArray[Anum_pg_dist_shard_transfer_progress_shard_max_value - 1])
+		{
+			progress->maxValue = TextDatumGetCString(
+				datumArray[Anum_pg_dist_shard_transfer_progress_shard_max_value - 1]);
+		}
+
+		progressList = lappend(progressList, progress);
+	}
+
+	systable_endscan(scanDescriptor);
+	table_close(pgDistShardTransferProgress, NoLock);
+
+	return progressList;
+}
+
+
+/*
+ * ShardTransferIsResumable returns whether the given operation has progress
+ * records that did not expire yet.
+ */
+static bool
+ShardTransferIsResumable(List *progressList, OperationId operationId)
+{
+	TimestampTz currentTime = GetCurrentTimestamp();
+
+	ShardTransferProgress *progress = NULL;
+	foreach_ptr(progress, progressList)
+	{
+		if (progress->operationId == operationId &&
+			progress->resumableUntil > currentTime)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * ShardTransferProgressMatches returns whether the progress records of the
+ * given operation correspond one-to-one to the expected progress records, and
+ * did not expire yet.
+ */
+static bool
+ShardTransferProgressMatches(List *progressList, OperationId operationId,
+							 List *expectedProgressList)
+{
+	TimestampTz currentTime = GetCurrentTimestamp();
+	int matchingRecordCount = 0;
+
+	ShardTransferProgress *progress = NULL;
+	foreach_ptr(progress, progressList)
+	{
+		if (progress->operationId != operationId)
+		{
+			continue;
+		}
+
+		if (progress->resumableUntil <= currentTime)
+		{
+			return false;
+		}
+
+		bool expected = false;
+		ShardTransferProgress *expectedProgress = NULL;
+		foreach_ptr(expectedProgress, expectedProgressList)
+		{
+			if (ShardTransferProgressEquals(progress, expectedProgress))
+			{
+				expected = true;
+				break;
+			}
+		}
+
+		if (!expected)
+		{
+			return false;
+		}
+
+		/*
+		 * The expected records of a transfer differ from each other in the
+		 * source shard or the hash range, so each can only match one record.
+		 */
+		matchingRecordCount++;
+	}
+
+	return matchingRecordCount == list_length(expectedProgressList);
+}
+
+
+/*
+ * ShardTransferProgressEquals returns whether the given progress records
+ * describe the same copy of a shard, regardless of the operation and the ID of
+ * the copied shard.
+ */
+bool
+ShardTransferProgressEquals(ShardTransferProgress *leftProgress,
+							ShardTransferProgress *rightProgress)
+{
+	if (leftProgress->sourceShardId != rightProgress->sourceShardId ||
+		leftProgress->sourceNodeId != rightProgress->sourceNodeId ||
+		leftProgress->targetNodeId != rightProgress->targetNodeId)
+	{
+		return false;
+	}
+
+	if ((leftProgress->minValue == NULL) != (rightProgress->minValue == NULL) ||
+		(leftProgress->maxValue == NULL) != (rightProgress->maxValue == NULL))
+	{
+		return false;
+	}
+
+	if (leftProgress->minValue != NULL &&
+		strcmp(leftProgress->minValue, rightProgress->minValue) != 0)
+	{
+		return false;
+	}
+
+	if (leftProgress->maxValue != NULL &&
+		strcmp(leftProgress->maxValue, rightProgress->maxValue) != 0)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * ShardTransferResourcesExist returns whether the cleanup records of the given
+ * operation still contain the shards it created on the target nodes and the
+ * replication objects that a resumed shard transfer continues to use.
+ */
+static bool
+ShardTransferResourcesExist(OperationId operationId, int targetShardCount)
+{
+	int failureShardCount = 0;
+	bool publicationExists = false;
+	bool replicationSlotExists = false;
+	bool subscriptionExists = false;
+	List *recordList = ListCleanupRecordsForOperation(operationId);
+
+	CleanupRecord *record = NULL;
+	foreach_ptr(record, recordList)
+	{
+		switch (record->objectType)
+		{
+			case CLEANUP_OBJECT_SHARD_PLACEMENT:
+			{
+				/* other shards, like the dummy shards of a split, are always dropped */
+				if (record->policy == CLEANUP_ON_FAILURE)
+				{
+					failureShardCount++;
+				}
+				break;
+			}
+
+			case CLEANUP_OBJECT_PUBLICATION:
+			{
+				publicationExists = true;
+				break;
+			}
+
+			case CLEANUP_OBJECT_REPLICATION_SLOT:
+			{
+				replicationSlotExists = true;
+				break;
+			}
+
+			case CLEANUP_OBJECT_SUBSCRIPTION:
+			{
+				subscriptionExists = true;
+				break;
+			}
+
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	return failureShardCount == targetShardCount && publicationExists &&
+		   replicationSlotExists && subscriptionExists;
+}
+
+
+/*
+ * ShardIntervalListContainsShard returns whether the given list contains the
+ * shard with the given ID.
+ */
+static bool
+ShardIntervalListContainsShard(List *shardIntervalList, uint64 shardId)
+{
+	ShardInterval *shardInterval = NULL;
+	foreach_ptr(shardInterval, shardIntervalList)
+	{
+		if (shardInterval->shardId == shardId)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * ShardIdArrayLiteral returns a bigint array literal that contains the IDs of
+ * the given shards.
+ */
+static char *
+ShardIdArrayLiteral(List *shardIntervalList)
+{
+	StringInfo arrayLiteral = makeStringInfo();
+	appendStringInfoString(arrayLiteral, "ARRAY[");
+
+	const char *separator = "";
+	ShardInterval *shardInterval = NULL;
+	foreach_ptr(shardInterval, shardIntervalList)
+	{
+		appendStringInfo(arrayLiteral, "%s" UINT64_FORMAT, separator,
+						 shardInterval->shardId);
+		separator = ",";
+	}
+
+	appendStringInfoString(arrayLiteral, "]::bigint[]");
+
+	return arrayLiteral->data;
+}
+
+
 /*
  * GetNextOperationId allocates and returns a unique operationId for an operation
  * requiring potential cleanup. This allocation occurs both in shared memory and
@@ -1071,12 +1655,23 @@ ListCleanupRecordsForCurrentOperation(void)
 	 */
 	Assert(CurrentOperationId != INVALID_OPERATION_ID);
 
+	return ListCleanupRecordsForOperation(CurrentOperationId);
+}
+
+
+/*
+ * ListCleanupRecordsForOperation lists all the cleanup records for the given
+ * operation.
+ */
+static List *
+ListCleanupRecordsForOperation(OperationId operationId)
+{
 	Relation pgDistCleanup = table_open(DistCleanupRelationId(), AccessShareLock);
 	TupleDesc tupleDescriptor = RelationGetDescr(pgDistCleanup);
 
 	ScanKeyData scanKey[1];
 	ScanKeyInit(&scanKey[0], Anum_pg_dist_cleanup_operation_id, BTEqualStrategyNumber,
-				F_INT8EQ, Int64GetDatum(CurrentOperationId));
+				F_INT8EQ, Int64GetDatum(operationId));
 
 	int scanKeyCount = 1;
 	Oid scanIndexId = InvalidOid;
@@ -1101,11 +1696,12 @@ ListCleanupRecordsForCurrentOperation(void)
 
 
 /*
- * GetCleanupRecordByNameAndType returns the cleanup record with given name and type,
- * if any, returns NULL otherwise.
+ * GetCleanupRecordByNameAndType returns the cleanup record with given name and type
+ * that does not belong to excludedOperationId, if any, returns NULL otherwise.
  */
 static CleanupRecord *
-GetCleanupRecordByNameAndType(char *objectName, CleanupObject type)
+GetCleanupRecordByNameAndType(char *objectName, CleanupObject type,
+							  OperationId excludedOperationId)
 {
 	CleanupRecord *objectFound = NULL;
 
@@ -1127,7 +1723,8 @@ GetCleanupRecordByNameAndType(char *objectName, CleanupObject type)
 	while (HeapTupleIsValid(heapTuple = systable_getnext(scanDescriptor)))
 	{
 		CleanupRecord *record = TupleToCleanupRecord(heapTuple, tupleDescriptor);
-		if (strcmp(record->objectName, objectName) == 0)
+		if (strcmp(record->objectName, objectName) == 0 &&
+			record->operationId != excludedOperationId)
 		{
 			objectFound = record;
 			break;
@@ -1312,3 +1909,18 @@ TryLockOperationId(OperationId operationId)
 											   dontWait);
 	return (lockResult != LOCKACQUIRE_NOT_AVAIL);
 }
+
+
+/*
+ * UnlockOperationId releases a lock taken by TryLockOperationId, for operations
+ * that another process should be able to clean up before the current
+ * transaction ends.
+ */
+static void
+UnlockOperationId(OperationId operationId)
+{
+	LOCKTAG tag;
+	const bool sessionLock = false;
+	SET_LOCKTAG_CLEANUP_OPERATION_ID(tag, operationId);
+	LockRelease(&tag, ExclusiveLock, sessionLock);
+}
@@ -156,6 +156,13 @@ typedef struct WorkerHashKey
 	int port;
 } WorkerHashKey;
 
+/* NodeFillStateHashEntry maps a worker to its fill state in a RebalanceState */
+typedef struct NodeFillStateHashEntry
+{
+	WorkerHashKey worker;
+	NodeFillState *fillState;
+} NodeFillStateHashEntry;
+
 /* WorkerShardIds represents a set of shardIds grouped by worker */
 typedef struct WorkerShardIds
 {
@@ -246,8 +253,11 @@ static bool WorkerNodeListContains(List *workerNodeList, const char *workerName,
 								   uint32 workerPort);
 static void UpdateColocatedShardPlacementProgress(uint64 shardId, char *sourceName,
 												  int sourcePort, uint64 progress);
-static NodeFillState * FindFillStateForPlacement(RebalanceState *state,
+static NodeFillState * FindFillStateForPlacement(HTAB *fillStateHash,
 												 ShardPlacement *placement);
+static void RepositionFillStates(RebalanceState *state,
+								 NodeFillState *sourceFillState,
+								 NodeFillState *targetFillState);
 static RebalanceState * InitRebalanceState(List *workerNodeList, List *shardPlacementList,
 										   RebalancePlanFunctions *functions);
 static void MoveShardsAwayFromDisallowedNodes(RebalanceState *state);
@@ -267,6 +277,8 @@ static int CompareDisallowedPlacementDesc(const void *void1, const void *void2);
 static bool ShardAllowedOnNode(uint64 shardId, WorkerNode *workerNode, void *context);
 static float4 NodeCapacity(WorkerNode *workerNode, void *context);
 static ShardCost GetShardCost(uint64 shardId, void *context);
+static double ShardListQueryLoad(List *shardIntervalList, char *workerNodeName,
+								 uint32 workerNodePort);
 static List * NonColocatedDistRelationIdList(void);
 static void RebalanceTableShards(RebalanceOptions *options, Oid shardReplicationModeOid);
 static int64 RebalanceTableShardsBackground(RebalanceOptions *options, Oid
@@ -313,6 +325,7 @@ PG_FUNCTION_INFO_V1(get_rebalance_progress);
 PG_FUNCTION_INFO_V1(citus_drain_node);
 PG_FUNCTION_INFO_V1(master_drain_node);
 PG_FUNCTION_INFO_V1(citus_shard_cost_by_disk_size);
+PG_FUNCTION_INFO_V1(citus_shard_cost_by_query_load);
 PG_FUNCTION_INFO_V1(citus_validate_rebalance_strategy_functions);
 PG_FUNCTION_INFO_V1(pg_dist_rebalance_strategy_enterprise_check);
 PG_FUNCTION_INFO_V1(citus_rebalance_start);
@@ -699,6 +712,102 @@ citus_shard_cost_by_disk_size(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * citus_shard_cost_by_query_load gets the cost for a shard based on the recent
+ * query load on the shard and its colocated shards, as tracked on the worker
+ * of the first active placement of the shard when citus.stat_shard_load_track
+ * is enabled there. Every shard has a cost of at least 1, such that shards
+ * without any load are spread evenly.
+ *
+ * SQL signature:
+ * citus_shard_cost_by_query_load(shardid bigint) returns float4
+ */
+Datum
+citus_shard_cost_by_query_load(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+	uint64 shardId = PG_GETARG_INT64(0);
+	bool missingOk = false;
+	ShardPlacement *shardPlacement = ActiveShardPlacement(shardId, missingOk);
+
+	MemoryContext localContext = AllocSetContextCreate(CurrentMemoryContext,
+													   "CostByQueryLoadContext",
+													   ALLOCSET_DEFAULT_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(localContext);
+	ShardInterval *shardInterval = LoadShardInterval(shardId);
+	List *colocatedShardList = ColocatedShardIntervalList(shardInterval);
+
+	double colocationLoad = ShardListQueryLoad(colocatedShardList,
+											   shardPlacement->nodeName,
+											   shardPlacement->nodePort);
+
+	MemoryContextSwitchTo(oldContext);
+	MemoryContextReset(localContext);
+
+	PG_RETURN_FLOAT4(colocationLoad + 1);
+}
+
+
+/*
+ * ShardListQueryLoad returns the total load of the given shards, as tracked
+ * by citus_shard_load_local() on the given worker.
+ */
+static double
+ShardListQueryLoad(List *shardIntervalList, char *workerNodeName,
+				   uint32 workerNodePort)
+{
+	uint32 connectionFlag = 0;
+	StringInfo loadQuery = makeStringInfo();
+
+	appendStringInfoString(loadQuery,
+						   "SELECT coalesce(sum(load), 0) "
+						   "FROM pg_catalog.citus_shard_load_local() "
+						   "WHERE shardid IN (");
+
+	ShardInterval *shardInterval = NULL;
+	bool addComma = false;
+	foreach_ptr(shardInterval, shardIntervalList)
+	{
+		appendStringInfo(loadQuery, "%s" UINT64_FORMAT, addComma ? ", " : "",
+						 shardInterval->shardId);
+		addComma = true;
+	}
+
+	appendStringInfoString(loadQuery, ")");
+
+	MultiConnection *connection = GetNodeConnection(connectionFlag, workerNodeName,
+													workerNodePort);
+	PGresult *result = NULL;
+	int queryResult = ExecuteOptionalRemoteCommand(connection, loadQuery->data,
+												   &result);
+
+	if (queryResult != RESPONSE_OKAY)
+	{
+		ereport(ERROR, (errcode(ERRCODE_CONNECTION_FAILURE),
+						errmsg("cannot get the shard load because of a connection "
+							   "error")));
+	}
+
+	List *loadList = ReadFirstColumnAsText(result);
+	if (list_length(loadList) != 1)
+	{
+		ereport(ERROR, (errmsg(
+							"received wrong number of rows from worker, expected 1 received %d",
+							list_length(loadList))));
+	}
+
+	StringInfo loadStringInfo = (StringInfo) linitial(loadList);
+	double load = DatumGetFloat8(DirectFunctionCall1(float8in,
+													 CStringGetDatum(
+														 loadStringInfo->data)));
+
+	PQclear(result);
+	ForgetResults(connection);
+
+	return load;
+}
+
+
 /*
  * GetColocatedRebalanceSteps takes a List of PlacementUpdateEvents and creates
  * a new List of containing those and all the updates for colocated shards.
@@ -2537,6 +2646,14 @@ InitRebalanceState(List *workerNodeList, List *shardPlacementList,
 	state->functions = functions;
 	state->placementsHash = ShardPlacementsListToHash(shardPlacementList);
 
+	HASHCTL info = {
+		.keysize = sizeof(WorkerHashKey),
+		.entrysize = sizeof(NodeFillStateHashEntry),
+		.hcxt = CurrentMemoryContext
+	};
+	HTAB *fillStateHash = hash_create("NodeFillState Hash", 32, &info,
+									  HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+
 	/* create empty fill state for all of the worker nodes */
 	foreach_ptr(workerNode, workerNodeList)
 	{
@@ -2553,13 +2670,21 @@ InitRebalanceState(List *workerNodeList, List *shardPlacementList,
 		state->fillStateListAsc = lappend(state->fillStateListAsc, fillState);
 		state->fillStateListDesc = lappend(state->fillStateListDesc, fillState);
 		state->totalCapacity += fillState->capacity;
+
+		WorkerHashKey workerKey = { 0 };
+		strlcpy(workerKey.hostname, workerNode->workerName, MAX_NODE_LENGTH);
+		workerKey.port = workerNode->workerPort;
+
+		NodeFillStateHashEntry *fillStateEntry =
+			hash_search(fillStateHash, &workerKey, HASH_ENTER, NULL);
+		fillStateEntry->fillState = fillState;
 	}
 
 	/* Fill the fill states for all of the worker nodes based on the placements */
 	foreach_htab(placement, &status, state->placementsHash)
 	{
 		ShardCost *shardCost = palloc0(sizeof(ShardCost));
-		NodeFillState *fillState = FindFillStateForPlacement(state, placement);
+		NodeFillState *fillState = FindFillStateForPlacement(fillStateHash, placement);
 
 		Assert(fillState != NULL);
 
@@ -2570,8 +2695,6 @@ InitRebalanceState(List *workerNodeList, List *shardPlacementList,
 													  fillState->capacity);
 		fillState->shardCostListDesc = lappend(fillState->shardCostListDesc,
 											   shardCost);
-		fillState->shardCostListDesc = SortList(fillState->shardCostListDesc,
-												CompareShardCostDesc);
 
 		state->totalCost += shardCost->cost;
 
@@ -2587,6 +2710,16 @@ InitRebalanceState(List *workerNodeList, List *shardPlacementList,
 	}
 	foreach_htab_cleanup(placement, &status);
 
+	/* sort the shards of each node once all of them are added */
+	NodeFillState *nodeFillState = NULL;
+	foreach_ptr(nodeFillState, state->fillStateListAsc)
+	{
+		nodeFillState->shardCostListDesc = SortList(nodeFillState->shardCostListDesc,
+													CompareShardCostDesc);
+	}
+
+	hash_destroy(fillStateHash);
+
 	state->fillStateListAsc = SortList(state->fillStateListAsc, CompareNodeFillStateAsc);
 	state->fillStateListDesc = SortList(state->fillStateListDesc,
 										CompareNodeFillStateDesc);
@@ -2613,22 +2746,23 @@ CalculateUtilization(float4 totalCost, float4 capacity)
 
 /*
  * FindFillStateForPlacement finds the fillState for the workernode that
- * matches the placement.
+ * matches the placement in the given hash of fill states by worker.
  */
 static NodeFillState *
-FindFillStateForPlacement(RebalanceState *state, ShardPlacement *placement)
+FindFillStateForPlacement(HTAB *fillStateHash, ShardPlacement *placement)
 {
-	NodeFillState *fillState = NULL;
+	WorkerHashKey workerKey = { 0 };
+	strlcpy(workerKey.hostname, placement->nodeName, MAX_NODE_LENGTH);
+	workerKey.port = placement->nodePort;
 
-	/* Find the correct fill state to add the placement to and do that */
-	foreach_ptr(fillState, state->fillStateListAsc)
+	NodeFillStateHashEntry *fillStateEntry =
+		hash_search(fillStateHash, &workerKey, HASH_FIND, NULL);
+	if (fillStateEntry == NULL)
 	{
-		if (IsPlacementOnWorkerNode(placement, fillState->node))
-		{
-			return fillState;
-		}
+		return NULL;
 	}
-	return NULL;
+
+	return fillStateEntry->fillState;
 }
 
 
@@ -2820,7 +2954,11 @@ FindAllowedTargetFillState(RebalanceState *state, uint64 shardId)
  * 1. add a placement update to state->placementUpdateList
  * 2. update state->placementsHash
  * 3. update totalcost, utilization and shardCostListDesc in source and target
- * 4. resort state->fillStateListAsc/Desc
+ * 4. reposition source and target in state->fillStateListAsc/Desc
+ *
+ * All lists are kept sorted by inserting at a position that is found using
+ * binary search, instead of sorting them again, because the shard lists can
+ * be very long on large clusters.
  */
 static void
 MoveShardCost(NodeFillState *sourceFillState,
@@ -2848,25 +2986,57 @@ MoveShardCost(NodeFillState *sourceFillState,
 	sourceFillState->totalCost -= shardCost->cost;
 	sourceFillState->utilization = CalculateUtilization(sourceFillState->totalCost,
 														sourceFillState->capacity);
-	sourceFillState->shardCostListDesc = list_delete_ptr(
+	sourceFillState->shardCostListDesc = SortedListDelete(
 		sourceFillState->shardCostListDesc,
-		shardCost);
+		shardCost, CompareShardCostDesc);
 
 	targetFillState->totalCost += shardCost->cost;
 	targetFillState->utilization = CalculateUtilization(targetFillState->totalCost,
 														targetFillState->capacity);
-	targetFillState->shardCostListDesc = lappend(targetFillState->shardCostListDesc,
-												 shardCost);
-	targetFillState->shardCostListDesc = SortList(targetFillState->shardCostListDesc,
-												  CompareShardCostDesc);
+	targetFillState->shardCostListDesc = SortedListInsert(
+		targetFillState->shardCostListDesc,
+		shardCost, CompareShardCostDesc);
 
-	state->fillStateListAsc = SortList(state->fillStateListAsc, CompareNodeFillStateAsc);
-	state->fillStateListDesc = SortList(state->fillStateListDesc,
-										CompareNodeFillStateDesc);
+	RepositionFillStates(state, sourceFillState, targetFillState);
 	CheckRebalanceStateInvariants(state);
 }
 
 
+/*
+ * RepositionFillStates moves the source and target fill states of a move,
+ * whose utilization changed, to their new positions in
+ * state->fillStateListAsc and state->fillStateListDesc. Both fill states are
+ * removed before either is inserted again, since the binary search in
+ * SortedListInsert relies on the rest of the list still being sorted.
+ */
+static void
+RepositionFillStates(RebalanceState *state, NodeFillState *sourceFillState,
+					 NodeFillState *targetFillState)
+{
+	state->fillStateListAsc = list_delete_ptr(state->fillStateListAsc,
+											  sourceFillState);
+	state->fillStateListAsc = list_delete_ptr(state->fillStateListAsc,
+											  targetFillState);
+	state->fillStateListDesc = list_delete_ptr(state->fillStateListDesc,
+											   sourceFillState);
+	state->fillStateListDesc = list_delete_ptr(state->fillStateListDesc,
+											   targetFillState);
+
+	state->fillStateListAsc = SortedListInsert(state->fillStateListAsc,
+											   sourceFillState,
+											   CompareNodeFillStateAsc);
+	state->fillStateListAsc = SortedListInsert(state->fillStateListAsc,
+											   targetFillState,
+											   CompareNodeFillStateAsc);
+	state->fillStateListDesc = SortedListInsert(state->fillStateListDesc,
+												sourceFillState,
+												CompareNodeFillStateDesc);
+	state->fillStateListDesc = SortedListInsert(state->fillStateListDesc,
+												targetFillState,
+												CompareNodeFillStateDesc);
+}
+
+
 /*
  * FindAndMoveShardCost is the main rebalancing algorithm. This takes the
  * current state and returns a list with a new move appended that improves the
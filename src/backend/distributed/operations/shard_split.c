@@ -95,10 +95,21 @@ static void CreateReplicaIdentitiesForDummyShards(HTAB *mapOfPlacementToDummySha
 static void CreateObjectOnPlacement(List *objectCreationCommandList,
 									WorkerNode *workerNode);
 static List *    CreateSplitIntervalsForShardGroup(List *sourceColocatedShardList,
-												   List *splitPointsForShard);
+												   List *splitPointsForShard,
+												   bool assignShardIds);
 static void CreateSplitIntervalsForShard(ShardInterval *sourceShard,
 										 List *splitPointsForShard,
+										 bool assignShardIds,
 										 List **shardSplitChildrenIntervalList);
+static List * ShardSplitProgressList(List *sourceColocatedShardIntervalList,
+									 List *shardGroupSplitIntervalListList,
+									 WorkerNode *sourceWorkerNode,
+									 List *workersForPlacementList);
+static void AssignResumedSplitChildShardIds(List *sourceColocatedShardIntervalList,
+											List *shardGroupSplitIntervalListList,
+											WorkerNode *sourceWorkerNode,
+											List *workersForPlacementList,
+											List *resumedProgressList);
 static void BlockingShardSplit(SplitOperation splitOperation,
 							   uint64 splitWorkflowId,
 							   List *sourceColocatedShardIntervalList,
@@ -111,7 +122,8 @@ static void NonBlockingShardSplit(SplitOperation splitOperation,
 								  List *shardSplitPointsList,
 								  List *workersForPlacementList,
 								  DistributionColumnMap *distributionColumnOverrides,
-								  uint32 targetColocationId);
+								  uint32 targetColocationId,
+								  List *resumedProgressList);
 static void DoSplitCopy(WorkerNode *sourceShardNode,
 						List *sourceColocatedShardIntervalList,
 						List *shardGroupSplitIntervalListList,
@@ -121,7 +133,8 @@ static void DoSplitCopy(WorkerNode *sourceShardNode,
 static StringInfo CreateSplitCopyCommand(ShardInterval *sourceShardSplitInterval,
 										 char *distributionColumnName,
 										 List *splitChildrenShardIntervalList,
-										 List *workersForPlacementList);
+										 List *workersForPlacementList,
+										 ShardCopyBlockRange *blockRange);
 static Task * CreateSplitCopyTask(StringInfo splitCopyUdfCommand, char *snapshotName, int
 								  taskId, uint64 jobId);
 static void UpdateDistributionColumnsForShardGroup(List *colocatedShardList,
@@ -496,13 +509,56 @@ SplitShard(SplitMode splitMode,
 		sourceColocatedShardIntervalList = colocatedShardIntervalList;
 	}
 
+	/*
+	 * If a previous attempt of the same non-blocking split failed after
+	 * copying all the split children, we continue from there rather than
+	 * copying them again.
+	 */
+	OperationId resumedOperationId = INVALID_OPERATION_ID;
+	List *resumedProgressList = NIL;
+	if (splitMode != BLOCKING_SPLIT && splitOperation != CREATE_DISTRIBUTED_TABLE)
+	{
+		bool assignShardIds = false;
+		List *shardGroupSplitIntervalListList = CreateSplitIntervalsForShardGroup(
+			sourceColocatedShardIntervalList,
+			shardSplitPointsList,
+			assignShardIds);
+		WorkerNode *sourceWorkerNode =
+			ActiveShardPlacementWorkerNode(shardIntervalToSplit->shardId);
+		List *expectedProgressList = ShardSplitProgressList(
+			sourceColocatedShardIntervalList,
+			shardGroupSplitIntervalListList,
+			sourceWorkerNode,
+			workersForPlacementList);
+
+		resumedOperationId = LockResumableShardTransfer(expectedProgressList,
+														&resumedProgressList);
+		if (resumedOperationId != INVALID_OPERATION_ID)
+		{
+			ereport(NOTICE, (errmsg("resuming the split of shard " UINT64_FORMAT
+									" using the data that a previous attempt of "
+									"%s copied", shardIdToSplit, operationName)));
+		}
+	}
+
+	/* other failed transfers of these shards can be cleaned up now */
+	AbandonShardTransferProgress(sourceColocatedShardIntervalList, resumedOperationId);
+
 	DropOrphanedResourcesInSeparateTransaction();
 
 	/* use the user-specified shard ID as the split workflow ID */
 	uint64 splitWorkflowId = shardIntervalToSplit->shardId;
 
-	/* Start operation to prepare for generating cleanup records */
-	RegisterOperationNeedingCleanup();
+	if (resumedOperationId != INVALID_OPERATION_ID)
+	{
+		/* take over the resources of the failed split */
+		ResumeOperationNeedingCleanup(resumedOperationId);
+	}
+	else
+	{
+		/* Start operation to prepare for generating cleanup records */
+		RegisterOperationNeedingCleanup();
+	}
 
 	if (splitMode == BLOCKING_SPLIT)
 	{
@@ -527,7 +583,8 @@ SplitShard(SplitMode splitMode,
 			shardSplitPointsList,
 			workersForPlacementList,
 			distributionColumnOverrides,
-			targetColocationId);
+			targetColocationId,
+			resumedProgressList);
 
 		PlacementMovedUsingLogicalReplicationInTX = true;
 	}
@@ -561,9 +618,11 @@ BlockingShardSplit(SplitOperation splitOperation,
 	BlockWritesToShardList(sourceColocatedShardIntervalList);
 
 	/* First create shard interval metadata for split children */
+	bool assignShardIds = true;
 	List *shardGroupSplitIntervalListList = CreateSplitIntervalsForShardGroup(
 		sourceColocatedShardIntervalList,
-		shardSplitPointsList);
+		shardSplitPointsList,
+		assignShardIds);
 
 	/* Only single placement allowed (already validated RelationReplicationFactor = 1) */
 	ShardInterval *firstShard = linitial(sourceColocatedShardIntervalList);
@@ -862,23 +921,40 @@ DoSplitCopy(WorkerNode *sourceShardNode, List *sourceColocatedShardIntervalList,
 												   distributionColumn->varattno,
 												   missingOK);
 
-		StringInfo splitCopyUdfCommand = CreateSplitCopyCommand(
-			sourceShardIntervalToCopy,
-			distributionColumnName,
-			splitShardIntervalList,
-			destinationWorkerNodesList);
-
-		/* Create copy task. Snapshot name is required for nonblocking splits */
-		Task *splitCopyTask = CreateSplitCopyTask(splitCopyUdfCommand, snapShotName,
-												  taskId,
-												  sourceShardIntervalToCopy->shardId);
-
-		ShardPlacement *taskPlacement = CitusMakeNode(ShardPlacement);
-		SetPlacementNodeMetadata(taskPlacement, sourceShardNode);
-		splitCopyTask->taskPlacementList = list_make1(taskPlacement);
+		/*
+		 * Large shards are copied in several block ranges in parallel, all
+		 * using the same snapshot. A NIL list means that the whole shard is
+		 * copied by a single task.
+		 */
+		List *blockRangeList = ShardCopyBlockRangeList(sourceShardIntervalToCopy,
+													   sourceShardNode);
+		if (blockRangeList == NIL)
+		{
+			blockRangeList = list_make1(NULL);
+		}
 
-		splitCopyTaskList = lappend(splitCopyTaskList, splitCopyTask);
-		taskId++;
+		ShardCopyBlockRange *blockRange = NULL;
+		foreach_ptr(blockRange, blockRangeList)
+		{
+			StringInfo splitCopyUdfCommand = CreateSplitCopyCommand(
+				sourceShardIntervalToCopy,
+				distributionColumnName,
+				splitShardIntervalList,
+				destinationWorkerNodesList,
+				blockRange);
+
+			/* Create copy task. Snapshot name is required for nonblocking splits */
+			Task *splitCopyTask = CreateSplitCopyTask(splitCopyUdfCommand, snapShotName,
+													  taskId,
+													  sourceShardIntervalToCopy->shardId);
+
+			ShardPlacement *taskPlacement = CitusMakeNode(ShardPlacement);
+			SetPlacementNodeMetadata(taskPlacement, sourceShardNode);
+			splitCopyTask->taskPlacementList = list_make1(taskPlacement);
+
+			splitCopyTaskList = lappend(splitCopyTaskList, splitCopyTask);
+			taskId++;
+		}
 	}
 
 	ExecuteTaskListOutsideTransaction(ROW_MODIFY_NONE, splitCopyTaskList,
@@ -908,12 +984,15 @@ DoSplitCopy(WorkerNode *sourceShardNode, List *sourceColocatedShardIntervalList,
  *          11 -- workef node id)::pg_catalog.split_copy_info
  *      ]
  *  );
+ * If 'blockRange' is not NULL, the start and end block of the range are passed
+ * as additional arguments, such that only part of the source shard is copied.
  */
 static StringInfo
 CreateSplitCopyCommand(ShardInterval *sourceShardSplitInterval,
 					   char *distributionColumnName,
 					   List *splitChildrenShardIntervalList,
-					   List *destinationWorkerNodesList)
+					   List *destinationWorkerNodesList,
+					   ShardCopyBlockRange *blockRange)
 {
 	StringInfo splitCopyInfoArray = makeStringInfo();
 	appendStringInfo(splitCopyInfoArray, "ARRAY[");
@@ -943,11 +1022,19 @@ CreateSplitCopyCommand(ShardInterval *sourceShardSplitInterval,
 	appendStringInfo(splitCopyInfoArray, "]");
 
 	StringInfo splitCopyUdf = makeStringInfo();
-	appendStringInfo(splitCopyUdf, "SELECT pg_catalog.worker_split_copy(%lu, %s, %s);",
+	appendStringInfo(splitCopyUdf, "SELECT pg_catalog.worker_split_copy(%lu, %s, %s",
 					 sourceShardSplitInterval->shardId,
 					 quote_literal_cstr(distributionColumnName),
 					 splitCopyInfoArray->data);
 
+	if (blockRange != NULL)
+	{
+		appendStringInfo(splitCopyUdf, ", %u, %s", blockRange->startBlock,
+						 ShardCopyEndBlockString(blockRange));
+	}
+
+	appendStringInfo(splitCopyUdf, ");");
+
 	return splitCopyUdf;
 }
 
@@ -1021,10 +1108,13 @@ CreateObjectOnPlacement(List *objectCreationCommandList,
  *      [ S1_1(-2147483648, 0), S1_2(1, 2147483647) ], // Split Interval List for S1.
  *      [ S2_1(-2147483648, 0), S2_2(1, 2147483647) ]  // Split Interval List for S2.
  *  ]
+ *
+ * When assignShardIds is false, the children do not get a shard ID yet.
  */
 static List *
 CreateSplitIntervalsForShardGroup(List *sourceColocatedShardIntervalList,
-								  List *splitPointsForShard)
+								  List *splitPointsForShard,
+								  bool assignShardIds)
 {
 	List *shardGroupSplitIntervalListList = NIL;
 
@@ -1033,7 +1123,7 @@ CreateSplitIntervalsForShardGroup(List *sourceColocatedShardIntervalList,
 	{
 		List *shardSplitIntervalList = NIL;
 		CreateSplitIntervalsForShard(shardToSplitInterval, splitPointsForShard,
-									 &shardSplitIntervalList);
+									 assignShardIds, &shardSplitIntervalList);
 
 		shardGroupSplitIntervalListList = lappend(shardGroupSplitIntervalListList,
 												  shardSplitIntervalList);
@@ -1051,6 +1141,7 @@ CreateSplitIntervalsForShardGroup(List *sourceColocatedShardIntervalList,
 static void
 CreateSplitIntervalsForShard(ShardInterval *sourceShard,
 							 List *splitPointsForShard,
+							 bool assignShardIds,
 							 List **shardSplitChildrenIntervalList)
 {
 	/* For 'N' split points, we will have N+1 shard intervals created. */
@@ -1074,7 +1165,9 @@ CreateSplitIntervalsForShard(ShardInterval *sourceShard,
 	{
 		ShardInterval *splitChildShardInterval = CopyShardInterval(sourceShard);
 		splitChildShardInterval->shardIndex = -1;
-		splitChildShardInterval->shardId = GetNextShardIdForSplitChild();
+		splitChildShardInterval->shardId = assignShardIds ?
+										   GetNextShardIdForSplitChild() :
+										   INVALID_SHARD_ID;
 
 		splitChildShardInterval->minValueExists = true;
 		splitChildShardInterval->minValue = currentSplitChildMinValue;
@@ -1100,6 +1193,98 @@ CreateSplitIntervalsForShard(ShardInterval *sourceShard,
 }
 
 
+/*
+ * ShardSplitProgressList returns the progress records that a non-blocking split
+ * writes once it copied the given split children, one for each child.
+ */
+static List *
+ShardSplitProgressList(List *sourceColocatedShardIntervalList,
+					   List *shardGroupSplitIntervalListList,
+					   WorkerNode *sourceWorkerNode,
+					   List *workersForPlacementList)
+{
+	List *progressList = NIL;
+
+	ShardInterval *sourceShardInterval = NULL;
+	List *splitChildrenShardIntervalList = NIL;
+	forboth_ptr(sourceShardInterval, sourceColocatedShardIntervalList,
+				splitChildrenShardIntervalList, shardGroupSplitIntervalListList)
+	{
+		ShardInterval *splitChildShardInterval = NULL;
+		WorkerNode *workerPlacementNode = NULL;
+		forboth_ptr(splitChildShardInterval, splitChildrenShardIntervalList,
+					workerPlacementNode, workersForPlacementList)
+		{
+			ShardTransferProgress *progress = palloc0(sizeof(ShardTransferProgress));
+			progress->shardId = splitChildShardInterval->shardId;
+			progress->sourceShardId = sourceShardInterval->shardId;
+			progress->sourceNodeId = sourceWorkerNode->nodeId;
+			progress->targetNodeId = workerPlacementNode->nodeId;
+			progress->minValue =
+				psprintf("%d", DatumGetInt32(splitChildShardInterval->minValue));
+			progress->maxValue =
+				psprintf("%d", DatumGetInt32(splitChildShardInterval->maxValue));
+
+			progressList = lappend(progressList, progress);
+		}
+	}
+
+	return progressList;
+}
+
+
+/*
+ * AssignResumedSplitChildShardIds gives the split children the shard IDs that
+ * the failed split, which the current operation resumes, used for them. The
+ * caller made sure that there is a progress record for every child.
+ */
+static void
+AssignResumedSplitChildShardIds(List *sourceColocatedShardIntervalList,
+								List *shardGroupSplitIntervalListList,
+								WorkerNode *sourceWorkerNode,
+								List *workersForPlacementList,
+								List *resumedProgressList)
+{
+	List *expectedProgressList = ShardSplitProgressList(
+		sourceColocatedShardIntervalList,
+		shardGroupSplitIntervalListList,
+		sourceWorkerNode,
+		workersForPlacementList);
+
+	/* the children are in the same order as their expected progress records */
+	ListCell *expectedProgressCell = list_head(expectedProgressList);
+
+	List *splitChildrenShardIntervalList = NIL;
+	foreach_ptr(splitChildrenShardIntervalList, shardGroupSplitIntervalListList)
+	{
+		ShardInterval *splitChildShardInterval = NULL;
+		foreach_ptr(splitChildShardInterval, splitChildrenShardIntervalList)
+		{
+			ShardTransferProgress *expectedProgress = lfirst(expectedProgressCell);
+			expectedProgressCell = lnext(expectedProgressList, expectedProgressCell);
+
+			ShardTransferProgress *resumedProgress = NULL;
+			foreach_ptr(resumedProgress, resumedProgressList)
+			{
+				if (ShardTransferProgressEquals(resumedProgress, expectedProgress))
+				{
+					splitChildShardInterval->shardId = resumedProgress->shardId;
+					break;
+				}
+			}
+
+			if (splitChildShardInterval->shardId == INVALID_SHARD_ID)
+			{
+				ereport(ERROR, (errmsg("could not find the shard that the split "
+									   "being resumed copied for the range "
+									   "[%s, %s]", expectedProgress->minValue,
+									   expectedProgress->maxValue)));
+			}
+		}
+	}
+}
+
+
 /*
  * UpdateDistributionColumnsForShardGroup globally updates the pg_dist_partition metadata
  * for each relation that has a shard in colocatedShardList.
@@ -1378,6 +1563,8 @@ AcquireNonblockingSplitLock(Oid relationId)
  *                                    from the metadata.
  * targetColocationId               : Specifies the colocation ID (only used for
  *                                    create_distributed_table_concurrently).
+ * resumedProgressList              : Progress records of a failed split that the
+ *                                    current operation resumes, NIL otherwise.
  */
 void
 NonBlockingShardSplit(SplitOperation splitOperation,
@@ -1386,28 +1573,43 @@ NonBlockingShardSplit(SplitOperation splitOperation,
 					  List *shardSplitPointsList,
 					  List *workersForPlacementList,
 					  DistributionColumnMap *distributionColumnOverrides,
-					  uint32 targetColocationId)
+					  uint32 targetColocationId,
+					  List *resumedProgressList)
 {
 	const char *operationName = SplitOperationAPIName[splitOperation];
+	bool resumeSplit = resumedProgressList != NIL;
 
 	ErrorIfMultipleNonblockingMoveSplitInTheSameTransaction();
 
 	char *superUser = CitusExtensionOwnerName();
 	char *databaseName = get_database_name(MyDatabaseId);
 
-	/* First create shard interval metadata for split children */
+	ShardInterval *firstShard = linitial(sourceColocatedShardIntervalList);
+	WorkerNode *sourceShardToCopyNode =
+		ActiveShardPlacementWorkerNode(firstShard->shardId);
+
+	/*
+	 * First create shard interval metadata for split children. When resuming,
+	 * the children keep the shard IDs of the shards that were already copied.
+	 */
+	bool assignShardIds = !resumeSplit;
 	List *shardGroupSplitIntervalListList = CreateSplitIntervalsForShardGroup(
 		sourceColocatedShardIntervalList,
-		shardSplitPointsList);
+		shardSplitPointsList,
+		assignShardIds);
 
-	ShardInterval *firstShard = linitial(sourceColocatedShardIntervalList);
+	if (resumeSplit)
+	{
+		AssignResumedSplitChildShardIds(sourceColocatedShardIntervalList,
+										shardGroupSplitIntervalListList,
+										sourceShardToCopyNode,
+										workersForPlacementList,
+										resumedProgressList);
+	}
 
 	/* Acquire global lock to prevent concurrent nonblocking splits */
 	AcquireNonblockingSplitLock(firstShard->relationId);
 
-	WorkerNode *sourceShardToCopyNode =
-		ActiveShardPlacementWorkerNode(firstShard->shardId);
-
 	/* Create hashmap to group shards for publication-subscription management */
 	HTAB *publicationInfoHash = CreateShardSplitInfoMapForPublication(
 		sourceColocatedShardIntervalList,
@@ -1423,50 +1625,67 @@ NonBlockingShardSplit(SplitOperation splitOperation,
 		databaseName);
 	ClaimConnectionExclusively(sourceConnection);
 
-	MultiConnection *sourceReplicationConnection =
-		GetReplicationConnection(sourceShardToCopyNode->workerName,
-								 sourceShardToCopyNode->workerPort);
-
 	/* Non-Blocking shard split workflow starts here */
 
-	ereport(LOG, (errmsg("creating child shards for %s",
-						 operationName)));
-
-	/* 1) Physically create split children. */
-	CreateSplitShardsForShardGroup(shardGroupSplitIntervalListList,
-								   workersForPlacementList);
-
 	/*
-	 * 2) Create dummy shards due to PG logical replication constraints.
-	 *    Refer to the comment section of 'CreateDummyShardsForShardGroup' for indepth
-	 *    information.
+	 * When resuming a failed split, the split children, the dummy shards, the
+	 * publications, the replication slots and the subscriptions of the failed
+	 * split already exist, and the children contain the initial copy.
 	 */
-	HTAB *mapOfPlacementToDummyShardList = CreateSimpleHash(NodeAndOwner,
-															GroupedShardSplitInfos);
-	CreateDummyShardsForShardGroup(
-		mapOfPlacementToDummyShardList,
-		sourceColocatedShardIntervalList,
-		shardGroupSplitIntervalListList,
-		sourceShardToCopyNode,
-		workersForPlacementList);
+	MultiConnection *sourceReplicationConnection = NULL;
+	if (!resumeSplit)
+	{
+		sourceReplicationConnection =
+			GetReplicationConnection(sourceShardToCopyNode->workerName,
+									 sourceShardToCopyNode->workerPort);
 
-	/*
-	 * 3) Create replica identities on dummy shards. This needs to be done
-	 * before the subscriptions are created. Otherwise the subscription
-	 * creation will get stuck waiting for the publication to send a
-	 * replica identity. Since we never actually write data into these
-	 * dummy shards there's no point in creating these indexes after the
-	 * initial COPY phase, like we do for the replica identities on the
-	 * target shards.
-	 */
-	CreateReplicaIdentitiesForDummyShards(mapOfPlacementToDummyShardList);
+		ereport(LOG, (errmsg("creating child shards for %s",
+							 operationName)));
 
-	ereport(LOG, (errmsg(
-					  "creating replication artifacts (publications, replication slots, subscriptions for %s",
-					  operationName)));
+		/* 1) Physically create split children. */
+		CreateSplitShardsForShardGroup(shardGroupSplitIntervalListList,
+									   workersForPlacementList);
+
+		/*
+		 * 2) Create dummy shards due to PG logical replication constraints.
+		 *    Refer to the comment section of 'CreateDummyShardsForShardGroup' for
+		 *    indepth information.
+		 */
+		HTAB *mapOfPlacementToDummyShardList = CreateSimpleHash(NodeAndOwner,
+																GroupedShardSplitInfos);
+		CreateDummyShardsForShardGroup(
+			mapOfPlacementToDummyShardList,
+			sourceColocatedShardIntervalList,
+			shardGroupSplitIntervalListList,
+			sourceShardToCopyNode,
+			workersForPlacementList);
+
+		/*
+		 * 3) Create replica identities on dummy shards. This needs to be done
+		 * before the subscriptions are created. Otherwise the subscription
+		 * creation will get stuck waiting for the publication to send a
+		 * replica identity. Since we never actually write data into these
+		 * dummy shards there's no point in creating these indexes after the
+		 * initial COPY phase, like we do for the replica identities on the
+		 * target shards.
+		 */
+		CreateReplicaIdentitiesForDummyShards(mapOfPlacementToDummyShardList);
+
+		ereport(LOG, (errmsg(
+						  "creating replication artifacts (publications, replication slots, subscriptions for %s",
+						  operationName)));
 
-	/* 4) Create Publications. */
-	CreatePublications(sourceConnection, publicationInfoHash);
+		/* 4) Create Publications. */
+		CreatePublications(sourceConnection, publicationInfoHash);
+	}
+	else
+	{
+		/*
+		 * The failed split did not release the split information in the shared
+		 * memory of the source node, which we set up again below.
+		 */
+		ExecuteSplitShardReleaseSharedMemory(sourceConnection);
+	}
 
 	/* 5) Execute 'worker_split_shard_replication_setup UDF */
 	List *replicationSlotInfoList = ExecuteSplitShardReplicationSetupUDF(
@@ -1493,52 +1712,70 @@ NonBlockingShardSplit(SplitOperation splitOperation,
 		groupedLogicalRepTargetsHash,
 		superUser, databaseName);
 
-	char *logicalRepDecoderPlugin = "citus";
+	if (!resumeSplit)
+	{
+		char *logicalRepDecoderPlugin = "citus";
 
-	/*
-	 * 6) Create replication slots and keep track of their snapshot.
-	 */
-	char *snapshot = CreateReplicationSlots(
-		sourceConnection,
-		sourceReplicationConnection,
-		logicalRepTargetList,
-		logicalRepDecoderPlugin);
+		/*
+		 * 6) Create replication slots and keep track of their snapshot.
+		 */
+		char *snapshot = CreateReplicationSlots(
+			sourceConnection,
+			sourceReplicationConnection,
+			logicalRepTargetList,
+			logicalRepDecoderPlugin);
 
-	/*
-	 * 7) Create subscriptions. This isn't strictly needed yet at this
-	 * stage, but this way we error out quickly if it fails.
-	 */
-	CreateSubscriptions(
-		sourceConnection,
-		databaseName,
-		logicalRepTargetList);
+		/*
+		 * 7) Create subscriptions. This isn't strictly needed yet at this
+		 * stage, but this way we error out quickly if it fails.
+		 */
+		CreateSubscriptions(
+			sourceConnection,
+			databaseName,
+			logicalRepTargetList);
 
-	/*
-	 * We have to create the primary key (or any other replica identity)
-	 * before the update/delete operations that are queued will be
-	 * replicated. Because if the replica identity does not exist on the
-	 * target, the replication would fail.
-	 *
-	 * So the latest possible moment we could do this is right after the
-	 * initial data COPY, but before enabling the susbcriptions. It might
-	 * seem like a good idea to it after the initial data COPY, since
-	 * it's generally the rule that it's cheaper to build an index at once
-	 * than to create it incrementally. This general rule, is why we create
-	 * all the regular indexes as late during the move as possible.
-	 *
-	 * But as it turns out in practice it's not as clear cut, and we saw a
-	 * speed degradation in the time it takes to move shards when doing the
-	 * replica identity creation after the initial COPY. So, instead we
-	 * keep it before the COPY.
-	 */
-	CreateReplicaIdentities(logicalRepTargetList);
+		/*
+		 * We have to create the primary key (or any other replica identity)
+		 * before the update/delete operations that are queued will be
+		 * replicated. Because if the replica identity does not exist on the
+		 * target, the replication would fail.
+		 *
+		 * So the latest possible moment we could do this is right after the
+		 * initial data COPY, but before enabling the susbcriptions. It might
+		 * seem like a good idea to it after the initial data COPY, since
+		 * it's generally the rule that it's cheaper to build an index at once
+		 * than to create it incrementally. This general rule, is why we create
+		 * all the regular indexes as late during the move as possible.
+		 *
+		 * But as it turns out in practice it's not as clear cut, and we saw a
+		 * speed degradation in the time it takes to move shards when doing the
+		 * replica identity creation after the initial COPY. So, instead we
+		 * keep it before the COPY.
+		 */
+		CreateReplicaIdentities(logicalRepTargetList);
 
-	ereport(LOG, (errmsg("performing copy for %s", operationName)));
+		ereport(LOG, (errmsg("performing copy for %s", operationName)));
 
-	/* 8) Do snapshotted Copy */
-	DoSplitCopy(sourceShardToCopyNode, sourceColocatedShardIntervalList,
-				shardGroupSplitIntervalListList, workersForPlacementList,
-				snapshot, distributionColumnOverrides);
+		/* 8) Do snapshotted Copy */
+		DoSplitCopy(sourceShardToCopyNode, sourceColocatedShardIntervalList,
+					shardGroupSplitIntervalListList, workersForPlacementList,
+					snapshot, distributionColumnOverrides);
+
+		/*
+		 * Once all split children are copied, a retry of a failed split can
+		 * reuse them, since the replication slots hold on to the changes that
+		 * happened after the copy. A failed create_distributed_table_concurrently
+		 * is not resumed, since its retry starts from a different table.
+		 */
+		if (splitOperation != CREATE_DISTRIBUTED_TABLE)
+		{
+			InsertShardTransferProgressOutsideTransaction(
+				ShardSplitProgressList(sourceColocatedShardIntervalList,
+									   shardGroupSplitIntervalListList,
+									   sourceShardToCopyNode,
+									   workersForPlacementList));
+		}
+	}
 
 	ereport(LOG, (errmsg("replicating changes for %s", operationName)));
 
@@ -1632,7 +1869,10 @@ NonBlockingShardSplit(SplitOperation splitOperation,
 	CloseGroupedLogicalRepTargetsConnections(groupedLogicalRepTargetsHash);
 
 	/* 18) Close connection of template replication slot */
-	CloseConnection(sourceReplicationConnection);
+	if (sourceReplicationConnection != NULL)
+	{
+		CloseConnection(sourceReplicationConnection);
+	}
 }
 
 
@@ -57,6 +57,7 @@
 #include "distributed/shard_transfer.h"
 #include "distributed/worker_manager.h"
 #include "distributed/worker_protocol.h"
+#include "distributed/worker_shard_copy.h"
 #include "distributed/worker_transaction.h"
 
 /* local type declarations */
@@ -107,12 +108,14 @@ static void ErrorIfSameNode(char *sourceNodeName, int sourceNodePort,
 static void CopyShardTables(List *shardIntervalList, char *sourceNodeName,
 							int32 sourceNodePort, char *targetNodeName,
 							int32 targetNodePort, bool useLogicalReplication,
-							const char *operationName);
+							const char *operationName,
+							OperationId resumedOperationId);
 static void CopyShardTablesViaLogicalReplication(List *shardIntervalList,
 												 char *sourceNodeName,
 												 int32 sourceNodePort,
 												 char *targetNodeName,
-												 int32 targetNodePort);
+												 int32 targetNodePort,
+												 bool resumeTransfer);
 
 static void CopyShardTablesViaBlockWrites(List *shardIntervalList, char *sourceNodeName,
 										  int32 sourceNodePort,
@@ -164,7 +167,9 @@ static List * PostLoadShardCreationCommandList(ShardInterval *shardInterval,
 											   int32 sourceNodePort);
 static ShardCommandList * CreateShardCommandList(ShardInterval *shardInterval,
 												 List *ddlCommandList);
-static char * CreateShardCopyCommand(ShardInterval *shard, WorkerNode *targetNode);
+static char * CreateShardCopyCommand(ShardInterval *shard, WorkerNode *targetNode,
+									 ShardCopyBlockRange *blockRange);
+static uint64 HeapShardSizeInBytes(ShardInterval *shardInterval, WorkerNode *sourceNode);
 
 
 /* declarations for dynamic loading */
@@ -177,6 +182,8 @@ PG_FUNCTION_INFO_V1(master_move_shard_placement);
 
 double DesiredPercentFreeAfterMove = 10;
 bool CheckAvailableSpaceBeforeMove = true;
+int MaxShardCopyStreams = 1;
+int ShardCopyChunkSize = 1024 * 1024; /* in KB */
 
 
 /*
@@ -500,6 +507,34 @@ TransferShards(int64 shardId, char *sourceNodeName,
 		EnsureReferenceTablesExistOnAllNodesExtended(shardReplicationMode);
 	}
 
+	/*
+	 * If a previous attempt of the same transfer failed after copying all the
+	 * shards, we continue from there rather than copying them again.
+	 */
+	OperationId resumedOperationId = INVALID_OPERATION_ID;
+	if (useLogicalReplication)
+	{
+		WorkerNode *sourceNode = FindWorkerNode(sourceNodeName, sourceNodePort);
+		WorkerNode *targetNode = FindWorkerNode(targetNodeName, targetNodePort);
+
+		List *expectedProgressList =
+			ShardTransferProgressForShardList(colocatedShardList, sourceNode->nodeId,
+											  targetNode->nodeId);
+
+		resumedOperationId = LockResumableShardTransfer(expectedProgressList, NULL);
+		if (resumedOperationId != INVALID_OPERATION_ID)
+		{
+			ereport(NOTICE, (errmsg("resuming the %s of shard " UINT64_FORMAT
+									" using the data that a previous attempt "
+									"copied to %s:%d",
+									operationName, shardId,
+									targetNodeName, targetNodePort)));
+		}
+	}
+
+	/* other failed transfers of these shards can be cleaned up now */
+	AbandonShardTransferProgress(colocatedShardList, resumedOperationId);
+
 	DropOrphanedResourcesInSeparateTransaction();
 
 	ShardInterval *colocatedShard = NULL;
@@ -511,11 +546,12 @@ TransferShards(int64 shardId, char *sourceNodeName,
 		 * orphaned placement somewhere that is not cleanup up yet.
 		 */
 		char *qualifiedShardName = ConstructQualifiedShardName(colocatedShard);
-		ErrorIfCleanupRecordForShardExists(qualifiedShardName);
+		ErrorIfCleanupRecordForShardExists(qualifiedShardName, resumedOperationId);
 	}
 
 	CopyShardTables(colocatedShardList, sourceNodeName, sourceNodePort, targetNodeName,
-					targetNodePort, useLogicalReplication, operationFunctionName);
+					targetNodePort, useLogicalReplication, operationFunctionName,
+					resumedOperationId);
 
 	if (transferType == SHARD_TRANSFER_MOVE)
 	{
@@ -1329,25 +1365,37 @@ ErrorIfReplicatingDistributedTableWithFKeys(List *tableIdList)
  * CopyShardTables copies a shard along with its co-located shards from a source
  * node to target node. It does not make any checks about state of the shards.
  * It is caller's responsibility to make those checks if they are necessary.
+ *
+ * When resumedOperationId is valid, the copy continues the failed logical
+ * replication transfer with that operation ID, whose lock the caller holds.
  */
 static void
 CopyShardTables(List *shardIntervalList, char *sourceNodeName, int32 sourceNodePort,
 				char *targetNodeName, int32 targetNodePort, bool useLogicalReplication,
-				const char *operationName)
+				const char *operationName, OperationId resumedOperationId)
 {
 	if (list_length(shardIntervalList) < 1)
 	{
 		return;
 	}
 
-	/* Start operation to prepare for generating cleanup records */
-	RegisterOperationNeedingCleanup();
+	bool resumeTransfer = resumedOperationId != INVALID_OPERATION_ID;
+	if (resumeTransfer)
+	{
+		/* take over the resources of the failed transfer */
+		ResumeOperationNeedingCleanup(resumedOperationId);
+	}
+	else
+	{
+		/* Start operation to prepare for generating cleanup records */
+		RegisterOperationNeedingCleanup();
+	}
 
 	if (useLogicalReplication)
 	{
 		CopyShardTablesViaLogicalReplication(shardIntervalList, sourceNodeName,
 											 sourceNodePort, targetNodeName,
-											 targetNodePort);
+											 targetNodePort, resumeTransfer);
 	}
 	else
 	{
@@ -1364,13 +1412,21 @@ CopyShardTables(List *shardIntervalList, char *sourceNodeName, int32 sourceNodeP
 
 /*
  * CopyShardTablesViaLogicalReplication copies a shard along with its co-located shards
- * from a source node to target node via logical replication.
+ * from a source node to target node via logical replication. When resuming a failed
+ * transfer, the shards already exist on the target node.
  */
 static void
 CopyShardTablesViaLogicalReplication(List *shardIntervalList, char *sourceNodeName,
 									 int32 sourceNodePort, char *targetNodeName,
-									 int32 targetNodePort)
+									 int32 targetNodePort, bool resumeTransfer)
 {
+	if (resumeTransfer)
+	{
+		LogicallyReplicateShards(shardIntervalList, sourceNodeName, sourceNodePort,
+								 targetNodeName, targetNodePort, resumeTransfer);
+		return;
+	}
+
 	MemoryContext localContext = AllocSetContextCreate(CurrentMemoryContext,
 													   "CopyShardTablesViaLogicalReplication",
 													   ALLOCSET_DEFAULT_SIZES);
@@ -1409,7 +1465,8 @@ CopyShardTablesViaLogicalReplication(List *shardIntervalList, char *sourceNodeNa
 
 	/* data copy is done seperately when logical replication is used */
 	LogicallyReplicateShards(shardIntervalList, sourceNodeName,
-							 sourceNodePort, targetNodeName, targetNodePort);
+							 sourceNodePort, targetNodeName, targetNodePort,
+							 resumeTransfer);
 }
 
 
@@ -1595,54 +1652,79 @@ CopyShardsToNode(WorkerNode *sourceNode, WorkerNode *targetNode, List *shardInte
 			continue;
 		}
 
-		List *ddlCommandList = NIL;
-
 		/*
-		 * This uses repeatable read because we want to read the table in
-		 * the state exactly as it was when the snapshot was created. This
-		 * is needed when using this code for the initial data copy when
-		 * using logical replication. The logical replication catchup might
-		 * fail otherwise, because some of the updates that it needs to do
-		 * have already been applied on the target.
+		 * Large shards are copied in several block ranges in parallel. A NIL
+		 * list means that the whole shard is copied by a single task.
 		 */
-		StringInfo beginTransaction = makeStringInfo();
-		appendStringInfo(beginTransaction,
-						 "BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;");
-		ddlCommandList = lappend(ddlCommandList, beginTransaction->data);
-
-		/* Set snapshot for non-blocking shard split. */
-		if (snapshotName != NULL)
+		List *blockRangeList = ShardCopyBlockRangeList(shardInterval, sourceNode);
+		if (blockRangeList == NIL)
 		{
-			StringInfo snapShotString = makeStringInfo();
-			appendStringInfo(snapShotString, "SET TRANSACTION SNAPSHOT %s;",
-							 quote_literal_cstr(
-								 snapshotName));
-			ddlCommandList = lappend(ddlCommandList, snapShotString->data);
+			blockRangeList = list_make1(NULL);
 		}
 
-		char *copyCommand = CreateShardCopyCommand(
-			shardInterval, targetNode);
+		ShardCopyBlockRange *blockRange = NULL;
+		foreach_ptr(blockRange, blockRangeList)
+		{
+			List *ddlCommandList = NIL;
+
+			/*
+			 * This uses repeatable read because we want to read the table in
+			 * the state exactly as it was when the snapshot was created. This
+			 * is needed when using this code for the initial data copy when
+			 * using logical replication. The logical replication catchup might
+			 * fail otherwise, because some of the updates that it needs to do
+			 * have already been applied on the target.
+			 *
+			 * All block ranges of a shard are read using the same snapshot,
+			 * such that together they copy exactly the same rows as a single
+			 * task would.
+			 */
+			StringInfo beginTransaction = makeStringInfo();
+			appendStringInfo(beginTransaction,
+							 "BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;");
+			ddlCommandList = lappend(ddlCommandList, beginTransaction->data);
 
-		ddlCommandList = lappend(ddlCommandList, copyCommand);
+			/* Set snapshot for non-blocking shard split. */
+			if (snapshotName != NULL)
+			{
+				StringInfo snapShotString = makeStringInfo();
+				appendStringInfo(snapShotString, "SET TRANSACTION SNAPSHOT %s;",
+								 quote_literal_cstr(
+									 snapshotName));
+				ddlCommandList = lappend(ddlCommandList, snapShotString->data);
+			}
 
-		StringInfo commitCommand = makeStringInfo();
-		appendStringInfo(commitCommand, "COMMIT;");
-		ddlCommandList = lappend(ddlCommandList, commitCommand->data);
+			/* compress the data that the source node sends, if enabled */
+			char *compressionCommand = SetShardTransferCompressionCommand();
+			if (compressionCommand != NULL)
+			{
+				ddlCommandList = lappend(ddlCommandList, compressionCommand);
+			}
 
-		Task *task = CitusMakeNode(Task);
-		task->jobId = shardInterval->shardId;
-		task->taskId = taskId;
-		task->taskType = READ_TASK;
-		task->replicationModel = REPLICATION_MODEL_INVALID;
-		SetTaskQueryStringList(task, ddlCommandList);
+			char *copyCommand = CreateShardCopyCommand(
+				shardInterval, targetNode, blockRange);
 
-		ShardPlacement *taskPlacement = CitusMakeNode(ShardPlacement);
-		SetPlacementNodeMetadata(taskPlacement, sourceNode);
+			ddlCommandList = lappend(ddlCommandList, copyCommand);
 
-		task->taskPlacementList = list_make1(taskPlacement);
+			StringInfo commitCommand = makeStringInfo();
+			appendStringInfo(commitCommand, "COMMIT;");
+			ddlCommandList = lappend(ddlCommandList, commitCommand->data);
 
-		copyTaskList = lappend(copyTaskList, task);
-		taskId++;
+			Task *task = CitusMakeNode(Task);
+			task->jobId = shardInterval->shardId;
+			task->taskId = taskId;
+			task->taskType = READ_TASK;
+			task->replicationModel = REPLICATION_MODEL_INVALID;
+			SetTaskQueryStringList(task, ddlCommandList);
+
+			ShardPlacement *taskPlacement = CitusMakeNode(ShardPlacement);
+			SetPlacementNodeMetadata(taskPlacement, sourceNode);
+
+			task->taskPlacementList = list_make1(taskPlacement);
+
+			copyTaskList = lappend(copyTaskList, task);
+			taskId++;
+		}
 	}
 
 	ExecuteTaskListOutsideTransaction(ROW_MODIFY_NONE, copyTaskList,
@@ -1654,22 +1736,159 @@ CopyShardsToNode(WorkerNode *sourceNode, WorkerNode *targetNode, List *shardInte
 /*
  * CreateShardCopyCommand constructs the command to copy a shard to another
  * worker node. This command needs to be run on the node wher you want to copy
- * the shard from.
+ * the shard from. If blockRange is not NULL, only the given range of heap
+ * blocks of the shard is copied.
  */
 static char *
 CreateShardCopyCommand(ShardInterval *shard,
-					   WorkerNode *targetNode)
+					   WorkerNode *targetNode,
+					   ShardCopyBlockRange *blockRange)
 {
 	char *shardName = ConstructQualifiedShardName(shard);
 	StringInfo query = makeStringInfo();
-	appendStringInfo(query,
-					 "SELECT pg_catalog.worker_copy_table_to_node(%s::regclass, %u);",
-					 quote_literal_cstr(shardName),
-					 targetNode->nodeId);
+
+	if (blockRange == NULL)
+	{
+		appendStringInfo(query,
+						 "SELECT pg_catalog.worker_copy_table_to_node(%s::regclass, %u);",
+						 quote_literal_cstr(shardName),
+						 targetNode->nodeId);
+	}
+	else
+	{
+		appendStringInfo(query,
+						 "SELECT pg_catalog.worker_copy_table_to_node(%s::regclass, %u, "
+						 "%u, %s);",
+						 quote_literal_cstr(shardName),
+						 targetNode->nodeId,
+						 blockRange->startBlock,
+						 ShardCopyEndBlockString(blockRange));
+	}
+
 	return query->data;
 }
 
 
+/*
+ * ShardCopyEndBlockString returns the end_block argument of the shard copy
+ * UDFs for the given block range, which is NULL for an open-ended range.
+ */
+char *
+ShardCopyEndBlockString(ShardCopyBlockRange *blockRange)
+{
+	if (blockRange->endBlock == InvalidBlockNumber)
+	{
+		return "NULL";
+	}
+
+	return psprintf("%u", blockRange->endBlock);
+}
+
+
+/*
+ * ShardCopyBlockRangeList returns the list of block ranges in which the given
+ * shard is copied from the source node in parallel, or NIL when the shard
+ * should be copied by a single task.
+ *
+ * Only heap tables are split, since the block ranges are applied as filters
+ * on the ctid, which only correspond to physical blocks for heap tables. The
+ * number of ranges is determined by the size of the shard relative to
+ * citus.shard_copy_chunk_size, up to citus.max_shard_copy_streams. The last
+ * range is left open-ended, such that rows in blocks that did not exist yet
+ * when we looked at the size are still copied.
+ */
+List *
+ShardCopyBlockRangeList(ShardInterval *shardInterval, WorkerNode *sourceNode)
+{
+	if (MaxShardCopyStreams <= 1)
+	{
+		return NIL;
+	}
+
+	uint64 shardSizeInBytes = HeapShardSizeInBytes(shardInterval, sourceNode);
+	uint64 blockCount = shardSizeInBytes / BLCKSZ;
+	uint64 chunkBlockCount = Max(((uint64) ShardCopyChunkSize * 1024) / BLCKSZ, 1);
+	uint64 rangeCount = Min((blockCount + chunkBlockCount - 1) / chunkBlockCount,
+							(uint64) MaxShardCopyStreams);
+
+	if (rangeCount <= 1)
+	{
+		return NIL;
+	}
+
+	uint64 blocksPerRange = (blockCount + rangeCount - 1) / rangeCount;
+	List *blockRangeList = NIL;
+
+	for (uint64 rangeIndex = 0; rangeIndex < rangeCount; rangeIndex++)
+	{
+		ShardCopyBlockRange *blockRange = palloc0(sizeof(ShardCopyBlockRange));
+		blockRange->startBlock = (BlockNumber) (rangeIndex * blocksPerRange);
+
+		if (rangeIndex == rangeCount - 1)
+		{
+			blockRange->endBlock = InvalidBlockNumber;
+		}
+		else
+		{
+			blockRange->endBlock = (BlockNumber) ((rangeIndex + 1) * blocksPerRange);
+		}
+
+		blockRangeList = lappend(blockRangeList, blockRange);
+	}
+
+	ereport(DEBUG1, (errmsg("copying shard " UINT64_FORMAT " using %d streams",
+							shardInterval->shardId, list_length(blockRangeList))));
+
+	return blockRangeList;
+}
+
+
+/*
+ * HeapShardSizeInBytes returns the size of the main fork of the given shard
+ * on the source node, or 0 if the shard does not use the heap access method.
+ */
+static uint64
+HeapShardSizeInBytes(ShardInterval *shardInterval, WorkerNode *sourceNode)
+{
+	uint32 connectionFlag = 0;
+	char *shardName = ConstructQualifiedShardName(shardInterval);
+
+	StringInfo sizeQuery = makeStringInfo();
+	appendStringInfo(sizeQuery,
+					 "SELECT pg_catalog.pg_relation_size(c.oid) "
+					 "FROM pg_catalog.pg_class c "
+					 "JOIN pg_catalog.pg_am a ON (a.oid = c.relam) "
+					 "WHERE c.oid = %s::regclass AND a.amname = 'heap'",
+					 quote_literal_cstr(shardName));
+
+	MultiConnection *connection = GetNodeConnection(connectionFlag,
+													sourceNode->workerName,
+													sourceNode->workerPort);
+	PGresult *result = NULL;
+	int queryResult = ExecuteOptionalRemoteCommand(connection, sizeQuery->data,
+												   &result);
+
+	if (queryResult != RESPONSE_OKAY)
+	{
+		ereport(ERROR, (errcode(ERRCODE_CONNECTION_FAILURE),
+						errmsg("cannot get the size because of a connection error")));
+	}
+
+	uint64 shardSize = 0;
+	List *sizeList = ReadFirstColumnAsText(result);
+	if (list_length(sizeList) == 1)
+	{
+		StringInfo shardSizeString = (StringInfo) linitial(sizeList);
+		shardSize = SafeStringToUint64(shardSizeString->data);
+	}
+
+	PQclear(result);
+	ForgetResults(connection);
+
+	return shardSize;
+}
+
+
 /*
  * EnsureShardCanBeCopied checks if the given shard has a healthy placement in the source
  * node and no placements in the target node.
@@ -16,6 +16,7 @@
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
 
+#include "distributed/argutils.h"
 #include "distributed/citus_ruleutils.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_executor.h"
@@ -33,13 +34,31 @@ PG_FUNCTION_INFO_V1(worker_copy_table_to_node);
  *     source_table regclass,
  *     target_node_id integer
  *  ) RETURNS VOID
+ *
+ * worker_copy_table_to_node(
+ *     source_table regclass,
+ *     target_node_id integer,
+ *     start_block bigint,
+ *     end_block bigint
+ *  ) RETURNS VOID
+ *
+ * The second form only copies the tuples in the given range of heap blocks,
+ * such that a large shard can be copied by several concurrent calls that use
+ * the same snapshot.
  */
 Datum
 worker_copy_table_to_node(PG_FUNCTION_ARGS)
 {
+	PG_ENSURE_ARGNOTNULL(0, "source_table");
+	PG_ENSURE_ARGNOTNULL(1, "target_node_id");
+
 	Oid relationId = PG_GETARG_OID(0);
 	uint32_t targetNodeId = PG_GETARG_INT32(1);
 
+	BlockNumber startBlock = 0;
+	BlockNumber endBlock = InvalidBlockNumber;
+	ShardCopyBlockRangeFromArgs(fcinfo, 2, &startBlock, &endBlock);
+
 	Oid schemaOid = get_rel_namespace(relationId);
 	char *relationSchemaName = get_namespace_name(schemaOid);
 	char *relationName = get_rel_name(relationId);
@@ -61,7 +80,8 @@ worker_copy_table_to_node(PG_FUNCTION_ARGS)
 	const char *columnList = CopyableColumnNamesFromRelationName(relationSchemaName,
 																 relationName);
 	appendStringInfo(selectShardQueryForCopy,
-					 "SELECT %s FROM %s;", columnList, relationQualifiedName);
+					 "SELECT %s FROM %s%s;", columnList, relationQualifiedName,
+					 ShardCopyBlockRangeFilter(startBlock, endBlock));
 
 	ParamListInfo params = NULL;
 	ExecuteQueryStringIntoDestReceiver(selectShardQueryForCopy->data, params,
@@ -11,23 +11,43 @@
 #include "postgres.h"
 
 #include "libpq-fe.h"
+#include "miscadmin.h"
 
+#include "access/table.h"
 #include "commands/copy.h"
+#include "commands/defrem.h"
 #include "nodes/makefuncs.h"
 #include "parser/parse_relation.h"
+#include "tcop/cmdtag.h"
+#include "tcop/utility.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
+#include "utils/rls.h"
 
+#include "distributed/argutils.h"
+#include "distributed/backend_data.h"
 #include "distributed/commands/multi_copy.h"
 #include "distributed/connection_management.h"
+#include "distributed/listutils.h"
 #include "distributed/local_executor.h"
 #include "distributed/local_multi_copy.h"
+#include "distributed/metadata_cache.h"
 #include "distributed/relation_utils.h"
 #include "distributed/remote_commands.h"
 #include "distributed/replication_origin_session_utils.h"
+#include "distributed/transmit.h"
+#include "distributed/utils/stream_compression.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_manager.h"
+#include "distributed/worker_protocol.h"
 #include "distributed/worker_shard_copy.h"
+#include "distributed/worker_shard_visibility.h"
+
+/* name of the COPY option that announces a compressed shard copy stream */
+#define SHARD_COPY_COMPRESSION_OPTION "compression"
+
+/* GUC, determining the compression method of shard copy streams */
+int ShardTransferCompression = STREAM_COMPRESSION_NONE;
 
 /*
  * LocalCopyBuffer is used in copy callback to return the copied rows.
@@ -36,6 +56,16 @@
  */
 static StringInfo LocalCopyBuffer;
 
+/*
+ * State of receiving a compressed shard copy stream. Like LocalCopyBuffer,
+ * these are global variables since the copy callback takes no arguments.
+ */
+static StreamCompressionMethod ShardCopyCompressionMethod = STREAM_COMPRESSION_NONE;
+static DecompressionStream *ShardCopyDecompressionStream = NULL;
+static StringInfo ShardCopyDecompressedData = NULL;
+static StringInfo ShardCopyMessage = NULL;
+static bool ShardCopyInputDone = false;
+
 typedef struct ShardCopyDestReceiver
 {
 	/* public DestReceiver interface */
@@ -67,6 +97,14 @@ typedef struct ShardCopyDestReceiver
 	 * Connection for destination shard (NULL if useLocalCopy is true)
 	 */
 	MultiConnection *connection;
+
+	/*
+	 * Compression stream that the COPY data to the destination node passes
+	 * through (NULL if the data is sent uncompressed), and the buffer that
+	 * holds its output.
+	 */
+	CompressionStream *compressionStream;
+	StringInfo compressedData;
 } ShardCopyDestReceiver;
 
 static bool ShardCopyDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
@@ -75,9 +113,16 @@ static void ShardCopyDestReceiverStartup(DestReceiver *dest, int operation,
 static void ShardCopyDestReceiverShutdown(DestReceiver *destReceiver);
 static void ShardCopyDestReceiverDestroy(DestReceiver *destReceiver);
 static bool CanUseLocalCopy(uint32_t destinationNodeId);
+static bool IsKnownDestinationShard(List *destinationShardFullyQualifiedName);
 static StringInfo ConstructShardCopyStatement(List *destinationShardFullyQualifiedName,
 											  bool
-											  useBinaryFormat, TupleDesc tupleDesc);
+											  useBinaryFormat, TupleDesc tupleDesc,
+											  CompressionStream *compressionStream);
+static bool PutShardCopyData(ShardCopyDestReceiver *copyDest, StringInfo copyData,
+							 bool finish);
+static DefElem * ShardCopyCompressionOption(CopyStmt *copyStatement);
+static int ReadCompressedShardCopyCallback(void *outBuf, int minRead, int maxRead);
+static void ReceiveCompressedShardCopyMessage(void);
 static void WriteLocalTuple(TupleTableSlot *slot, ShardCopyDestReceiver *copyDest);
 static int ReadFromLocalBufferCallback(void *outBuf, int minRead, int maxRead);
 static void LocalCopyToShard(ShardCopyDestReceiver *copyDest, CopyOutState
@@ -93,6 +138,25 @@ CanUseLocalCopy(uint32_t destinationNodeId)
 }
 
 
+/*
+ * IsKnownDestinationShard returns whether the destination of the copy is a
+ * shard in the metadata. The receiving node only accepts compressed streams
+ * for such shards, which excludes the split children that are added to the
+ * metadata after their data is copied.
+ */
+static bool
+IsKnownDestinationShard(List *destinationShardFullyQualifiedName)
+{
+	char *destinationShardRelationName = lsecond(destinationShardFullyQualifiedName);
+	bool missingOk = true;
+
+	uint64 shardId = ExtractShardIdFromTableName(destinationShardRelationName,
+												 missingOk);
+
+	return shardId != INVALID_SHARD_ID && ShardExists(shardId);
+}
+
+
 /* Connect to node with source shard and trigger copy start.  */
 static void
 ConnectToRemoteAndStartCopy(ShardCopyDestReceiver *copyDest)
@@ -117,7 +181,8 @@ ConnectToRemoteAndStartCopy(ShardCopyDestReceiver *copyDest)
 	StringInfo copyStatement = ConstructShardCopyStatement(
 		copyDest->destinationShardFullyQualifiedName,
 		copyDest->copyOutState->binary,
-		copyDest->tupleDescriptor);
+		copyDest->tupleDescriptor,
+		copyDest->compressionStream);
 
 	if (!SendRemoteCommand(copyDest->connection, copyStatement->data))
 	{
@@ -218,8 +283,7 @@ ShardCopyDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 						  copyOutState,
 						  copyDest->columnOutputFunctions,
 						  NULL /* columnCoercionPaths */);
-		if (!PutRemoteCopyData(copyDest->connection, copyOutState->fe_msgbuf->data,
-							   copyOutState->fe_msgbuf->len))
+		if (!PutShardCopyData(copyDest, copyOutState->fe_msgbuf, false))
 		{
 			char *destinationShardSchemaName = linitial(
 				copyDest->destinationShardFullyQualifiedName);
@@ -278,6 +342,18 @@ ShardCopyDestReceiverStartup(DestReceiver *dest, int operation, TupleDesc
 		/* Setup replication origin session for local copy*/
 		SetupReplicationOriginLocalSession();
 	}
+	else if (ShardTransferCompression != STREAM_COMPRESSION_NONE &&
+			 IsKnownDestinationShard(copyDest->destinationShardFullyQualifiedName))
+	{
+		/*
+		 * The receiving side only accepts compressed input once the COPY
+		 * announces compression, so small shards are compressed as well.
+		 */
+		uint64 compressionThresholdBytes = 0;
+		copyDest->compressionStream = CreateCompressionStream(
+			ShardTransferCompression, compressionThresholdBytes);
+		copyDest->compressedData = makeStringInfo();
+	}
 }
 
 
@@ -308,8 +384,14 @@ ShardCopyDestReceiverShutdown(DestReceiver *dest)
 			AppendCopyBinaryFooters(copyDest->copyOutState);
 		}
 
+		/* send the remainder of a compressed stream before ending it */
+		bool copyDataSent = copyDest->compressionStream == NULL ||
+							PutShardCopyData(copyDest, copyDest->copyOutState->fe_msgbuf,
+											 true);
+
 		/* end the COPY input */
-		if (!PutRemoteCopyEnd(copyDest->connection, NULL /* errormsg */))
+		if (!copyDataSent ||
+			!PutRemoteCopyEnd(copyDest->connection, NULL /* errormsg */))
 		{
 			char *destinationShardSchemaName = linitial(
 				copyDest->destinationShardFullyQualifiedName);
@@ -424,6 +506,79 @@ CopyableColumnNamesFromRelationName(const char *schemaName, const char *relation
 }
 
 
+/*
+ * ShardCopyBlockRangeFromArgs reads the optional (start_block, end_block)
+ * arguments of the shard copy UDFs, which start at the given argument index.
+ * When the UDF is called without them, the range covers the whole table. A
+ * NULL end_block means that the range extends to the end of the table.
+ */
+void
+ShardCopyBlockRangeFromArgs(FunctionCallInfo fcinfo, int startBlockArgIndex,
+							BlockNumber *startBlock, BlockNumber *endBlock)
+{
+	*startBlock = 0;
+	*endBlock = InvalidBlockNumber;
+
+	if (PG_NARGS() <= startBlockArgIndex)
+	{
+		return;
+	}
+
+	PG_ENSURE_ARGNOTNULL(startBlockArgIndex, "start_block");
+
+	int64 startBlockArg = PG_GETARG_INT64(startBlockArgIndex);
+	if (startBlockArg < 0 || startBlockArg > MaxBlockNumber)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("start_block must be between 0 and %u",
+							   MaxBlockNumber)));
+	}
+
+	*startBlock = (BlockNumber) startBlockArg;
+
+	if (!PG_ARGISNULL(startBlockArgIndex + 1))
+	{
+		int64 endBlockArg = PG_GETARG_INT64(startBlockArgIndex + 1);
+		if (endBlockArg < startBlockArg || endBlockArg > MaxBlockNumber)
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							errmsg("end_block must be between start_block and %u",
+								   MaxBlockNumber)));
+		}
+
+		*endBlock = (BlockNumber) endBlockArg;
+	}
+}
+
+
+/*
+ * ShardCopyBlockRangeFilter returns a WHERE clause that limits a scan of a
+ * heap table to the tuples in blocks [startBlock, endBlock), which the planner
+ * turns into a TID range scan. An endBlock of InvalidBlockNumber leaves the
+ * range open-ended, such that tuples beyond the last block that the
+ * coordinator saw are still copied.
+ */
+char *
+ShardCopyBlockRangeFilter(BlockNumber startBlock, BlockNumber endBlock)
+{
+	StringInfo filter = makeStringInfo();
+
+	if (startBlock == 0 && endBlock == InvalidBlockNumber)
+	{
+		return filter->data;
+	}
+
+	appendStringInfo(filter, " WHERE ctid >= '(%u,0)'::tid", startBlock);
+
+	if (endBlock != InvalidBlockNumber)
+	{
+		appendStringInfo(filter, " AND ctid < '(%u,0)'::tid", endBlock);
+	}
+
+	return filter->data;
+}
+
+
 /*
  * ConstructShardCopyStatement constructs the text of a COPY statement
  * for copying into a result table
@@ -431,7 +586,8 @@ CopyableColumnNamesFromRelationName(const char *schemaName, const char *relation
 static StringInfo
 ConstructShardCopyStatement(List *destinationShardFullyQualifiedName, bool
 							useBinaryFormat,
-							TupleDesc tupleDesc)
+							TupleDesc tupleDesc,
+							CompressionStream *compressionStream)
 {
 	char *destinationShardSchemaName = linitial(destinationShardFullyQualifiedName);
 	char *destinationShardRelationName = lsecond(destinationShardFullyQualifiedName);
@@ -445,10 +601,23 @@ ConstructShardCopyStatement(List *destinationShardFullyQualifiedName, bool
 					 quote_identifier(destinationShardSchemaName), quote_identifier(
 						 destinationShardRelationName), columnList);
 
-	if (useBinaryFormat)
+	if (useBinaryFormat && compressionStream != NULL)
+	{
+		appendStringInfo(command, " WITH (format binary, %s %s);",
+						 SHARD_COPY_COMPRESSION_OPTION,
+						 quote_literal_cstr(StreamCompressionMethodName(
+												compressionStream->method)));
+	}
+	else if (useBinaryFormat)
 	{
 		appendStringInfo(command, " WITH (format binary);");
 	}
+	else if (compressionStream != NULL)
+	{
+		appendStringInfo(command, " WITH (%s %s);", SHARD_COPY_COMPRESSION_OPTION,
+						 quote_literal_cstr(StreamCompressionMethodName(
+												compressionStream->method)));
+	}
 	else
 	{
 		appendStringInfo(command, ";");
@@ -458,6 +627,42 @@ ConstructShardCopyStatement(List *destinationShardFullyQualifiedName, bool
 }
 
 
+/*
+ * PutShardCopyData sends the given COPY data to the destination node, passing
+ * it through the compression stream when the shard copy is compressed. When
+ * finish is true, the remainder of the compression stream is sent as well.
+ * Returns false if the data could not be sent.
+ */
+static bool
+PutShardCopyData(ShardCopyDestReceiver *copyDest, StringInfo copyData, bool finish)
+{
+	if (copyDest->compressionStream == NULL)
+	{
+		return PutRemoteCopyData(copyDest->connection, copyData->data, copyData->len);
+	}
+
+	StringInfo compressedData = copyDest->compressedData;
+	resetStringInfo(compressedData);
+
+	CompressionStreamWrite(copyDest->compressionStream, copyData->data, copyData->len,
+						   compressedData);
+
+	if (finish)
+	{
+		CompressionStreamFinish(copyDest->compressionStream, compressedData);
+	}
+
+	/* the compression stream buffers its input until it has a full frame */
+	if (compressedData->len == 0)
+	{
+		return true;
+	}
+
+	return PutRemoteCopyData(copyDest->connection, compressedData->data,
+							 compressedData->len);
+}
+
+
 /* Write Tuple to Local Shard. */
 static void
 WriteLocalTuple(TupleTableSlot *slot, ShardCopyDestReceiver *copyDest)
@@ -566,3 +771,253 @@ ReadFromLocalBufferCallback(void *outBuf, int minRead, int maxRead)
 
 	return bytesRead;
 }
+
+
+/*
+ * SetShardTransferCompressionCommand returns a command that enables the
+ * current citus.shard_transfer_compression setting in the transaction of a
+ * shard copy task, such that the source node compresses the data it sends to
+ * the target node. Returns NULL if shard transfers are not compressed.
+ */
+char *
+SetShardTransferCompressionCommand(void)
+{
+	if (ShardTransferCompression == STREAM_COMPRESSION_NONE)
+	{
+		return NULL;
+	}
+
+	StringInfo command = makeStringInfo();
+	appendStringInfo(command, "SET LOCAL citus.shard_transfer_compression TO %s;",
+					 quote_literal_cstr(StreamCompressionMethodName(
+											ShardTransferCompression)));
+
+	return command->data;
+}
+
+
+/*
+ * IsCompressedShardCopyStmt returns whether the given COPY statement is a
+ * COPY .. FROM STDIN WITH (compression '<method>') statement, which is sent by
+ * ShardCopyDestReceiver when shard transfers are compressed.
+ */
+bool
+IsCompressedShardCopyStmt(CopyStmt *copyStatement)
+{
+	return ShardCopyCompressionOption(copyStatement) != NULL;
+}
+
+
+/*
+ * ShardCopyCompressionOption returns the compression option of the given COPY
+ * statement, or NULL if it does not have one.
+ */
+static DefElem *
+ShardCopyCompressionOption(CopyStmt *copyStatement)
+{
+	DefElem *option = NULL;
+	foreach_ptr(option, copyStatement->options)
+	{
+		if (strcmp(option->defname, SHARD_COPY_COMPRESSION_OPTION) == 0)
+		{
+			return option;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * ReceiveCompressedShardCopy executes a COPY .. FROM STDIN statement of which
+ * the input is a compressed stream. Only shards accept such streams, and only
+ * from other nodes or superusers, since the statement bypasses the COPY
+ * processing of Citus and Postgres. The compression method is checked before
+ * the client is asked for data, such that a sender on a node that supports a
+ * method this node lacks gets an error before it sends any data. The COPY
+ * data messages are decompressed and passed to COPY through a data source
+ * callback.
+ */
+void
+ReceiveCompressedShardCopy(CopyStmt *copyStatement, QueryCompletion *completionTag)
+{
+	DefElem *compressionOption = ShardCopyCompressionOption(copyStatement);
+
+	if (!copyStatement->is_from || copyStatement->relation == NULL ||
+		copyStatement->filename != NULL || copyStatement->is_program)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("the %s option is only supported for COPY .. FROM "
+							   "STDIN", SHARD_COPY_COMPRESSION_OPTION)));
+	}
+
+	if (copyStatement->whereClause != NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("the %s option is not supported for COPY FROM "
+							   "with WHERE", SHARD_COPY_COMPRESSION_OPTION)));
+	}
+
+	Relation relation = table_openrv(copyStatement->relation, RowExclusiveLock);
+	if (!RelationIsAKnownShard(RelationGetRelid(relation)) ||
+		!(IsCitusInternalBackend() || superuser()))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("the %s option is only supported when copying "
+							   "shards between nodes", SHARD_COPY_COMPRESSION_OPTION)));
+	}
+
+	char *methodName = defGetString(compressionOption);
+	StreamCompressionMethod method = STREAM_COMPRESSION_NONE;
+	if (!StreamCompressionMethodFromName(methodName, &method) ||
+		!StreamCompressionMethodSupported(method))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("compression method \"%s\" is not supported on "
+							   "this node", methodName)));
+	}
+
+	/* same checks as DoCopy() for COPY FROM */
+	PreventCommandIfReadOnly("COPY FROM");
+	PreventCommandIfParallelMode("COPY FROM");
+
+	CheckCopyPermissions(copyStatement);
+
+	if (check_enable_rls(RelationGetRelid(relation), InvalidOid, false) == RLS_ENABLED)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("COPY FROM not supported with row-level security"),
+						errhint("Use INSERT statements instead.")));
+	}
+
+	List *copyOptions = list_copy(copyStatement->options);
+	copyOptions = list_delete_ptr(copyOptions, compressionOption);
+
+	ParseState *pState = make_parsestate(NULL /* parentParseState */);
+	(void) addRangeTableEntryForRelation(pState, relation, RowExclusiveLock,
+										 NULL /* alias */, false /* inh */,
+										 false /* inFromCl */);
+
+	ShardCopyCompressionMethod = method;
+	ShardCopyDecompressionStream = CreateDecompressionStream();
+	ShardCopyDecompressedData = makeStringInfo();
+	ShardCopyMessage = makeStringInfo();
+	ShardCopyInputDone = false;
+
+	CopyFromState copyState = BeginCopyFrom(pState, relation,
+											NULL /* whereClause */,
+											NULL /* fileName */,
+											false /* is_program */,
+											ReadCompressedShardCopyCallback,
+											copyStatement->attlist,
+											copyOptions);
+
+	/* the data arrives compressed, but we announce the format of the COPY */
+	bool binaryFormat = false;
+	DefElem *option = NULL;
+	foreach_ptr(option, copyOptions)
+	{
+		if (strcmp(option->defname, "format") == 0)
+		{
+			binaryFormat = strcmp(defGetString(option), "binary") == 0;
+		}
+	}
+
+	SendCopyInStart(binaryFormat);
+
+	uint64 processedRowCount = CopyFrom(copyState);
+
+	/* consume the protocol-level end of the input if COPY did not read it */
+	while (!ShardCopyInputDone)
+	{
+		ReceiveCompressedShardCopyMessage();
+	}
+
+	EndCopyFrom(copyState);
+
+	table_close(relation, NoLock);
+	free_parsestate(pState);
+
+	SetQueryCompletion(completionTag, CMDTAG_COPY, processedRowCount);
+}
+
+
+/*
+ * ReadCompressedShardCopyCallback is the data source callback of COPY when
+ * receiving a compressed shard copy stream. It receives and decompresses COPY
+ * data messages until at least minRead bytes are available (or the input
+ * ends) and copies up to maxRead bytes into outBuf.
+ */
+static int
+ReadCompressedShardCopyCallback(void *outBuf, int minRead, int maxRead)
+{
+	StringInfo decompressedData = ShardCopyDecompressedData;
+
+	if (decompressedData->cursor == decompressedData->len)
+	{
+		resetStringInfo(decompressedData);
+	}
+
+	while (decompressedData->len - decompressedData->cursor < minRead &&
+		   !ShardCopyInputDone)
+	{
+		ReceiveCompressedShardCopyMessage();
+	}
+
+	int availableBytes = decompressedData->len - decompressedData->cursor;
+	int bytesToRead = Min(availableBytes, maxRead);
+
+	if (bytesToRead > 0)
+	{
+		memcpy_s(outBuf, bytesToRead,
+				 &decompressedData->data[decompressedData->cursor], bytesToRead);
+	}
+
+	decompressedData->cursor += bytesToRead;
+
+	return bytesToRead;
+}
+
+
+/*
+ * ReceiveCompressedShardCopyMessage receives a single message of a compressed
+ * shard copy stream from the client and appends its decompressed contents to
+ * ShardCopyDecompressedData. At the end of the input, the remainder of the
+ * stream is decompressed and ShardCopyInputDone is set. Input that is not
+ * compressed with the announced method is rejected, except for an empty
+ * stream.
+ */
+static void
+ReceiveCompressedShardCopyMessage(void)
+{
+	DecompressionStream *stream = ShardCopyDecompressionStream;
+
+	resetStringInfo(ShardCopyMessage);
+
+	bool copyDone = ReceiveCopyData(ShardCopyMessage);
+	if (copyDone)
+	{
+		bool receivedData = stream->headerProcessed || stream->pendingData->len > 0;
+
+		DecompressionStreamFinish(stream, ShardCopyDecompressedData);
+		ShardCopyInputDone = true;
+
+		if (!receivedData)
+		{
+			return;
+		}
+	}
+	else if (ShardCopyMessage->len > 0)
+	{
+		DecompressionStreamWrite(stream, ShardCopyMessage->data,
+								 ShardCopyMessage->len, ShardCopyDecompressedData);
+	}
+
+	if (stream->headerProcessed &&
+		(!stream->compressed || stream->method != ShardCopyCompressionMethod))
+	{
+		ereport(ERROR, (errcode(ERRCODE_PROTOCOL_VIOLATION),
+						errmsg("COPY data is not compressed with the announced "
+							   "compression method")));
+	}
+}
@@ -15,6 +15,7 @@
 
 #include "pg_version_compat.h"
 
+#include "distributed/argutils.h"
 #include "distributed/citus_ruleutils.h"
 #include "distributed/distribution_column.h"
 #include "distributed/intermediate_results.h"
@@ -56,10 +57,16 @@ static char * TraceWorkerSplitCopyUdf(char *sourceShardToCopySchemaName,
  * UDF to split copy shard to list of destination shards.
  * 'source_shard_id' : Source ShardId to split copy.
  * 'splitCopyInfos'  : Array of Split Copy Info (destination_shard's id, min/max ranges and node_id)
+ * 'start_block', 'end_block' : Optional range of heap blocks of the source shard
+ *                              to copy, NULL end_block meaning the end of the shard.
  */
 Datum
 worker_split_copy(PG_FUNCTION_ARGS)
 {
+	PG_ENSURE_ARGNOTNULL(0, "source_shard_id");
+	PG_ENSURE_ARGNOTNULL(1, "distribution_column");
+	PG_ENSURE_ARGNOTNULL(2, "splitCopyInfos");
+
 	uint64 shardIdToSplitCopy = DatumGetUInt64(PG_GETARG_DATUM(0));
 	ShardInterval *shardIntervalToSplitCopy = LoadShardInterval(shardIdToSplitCopy);
 
@@ -91,6 +98,10 @@ worker_split_copy(PG_FUNCTION_ARGS)
 		splitCopyInfoList = lappend(splitCopyInfoList, splitCopyInfo);
 	}
 
+	BlockNumber startBlock = 0;
+	BlockNumber endBlock = InvalidBlockNumber;
+	ShardCopyBlockRangeFromArgs(fcinfo, 3, &startBlock, &endBlock);
+
 	EState *executor = CreateExecutorState();
 	DestReceiver *splitCopyDestReceiver = CreatePartitionedSplitCopyDestReceiver(executor,
 																				 shardIntervalToSplitCopy,
@@ -118,8 +129,9 @@ worker_split_copy(PG_FUNCTION_ARGS)
 		sourceShardToCopyName);
 
 	appendStringInfo(selectShardQueryForCopy,
-					 "SELECT %s FROM %s;", columnList,
-					 sourceShardToCopyQualifiedName);
+					 "SELECT %s FROM %s%s;", columnList,
+					 sourceShardToCopyQualifiedName,
+					 ShardCopyBlockRangeFilter(startBlock, endBlock));
 
 	ParamListInfo params = NULL;
 	ExecuteQueryStringIntoDestReceiver(selectShardQueryForCopy->data, params,
@@ -64,6 +64,13 @@ PlanCombineQuery(DistributedPlan *distributedPlan, CustomScan *remoteScan)
 
 	Job *workerJob = distributedPlan->workerJob;
 	List *workerTargetList = workerJob->jobQuery->targetList;
+
+	/* when groups are finalized on the workers, the remote scan returns final rows */
+	if (distributedPlan->repartitionedAggregateQuery != NULL)
+	{
+		workerTargetList = distributedPlan->repartitionedAggregateQuery->targetList;
+	}
+
 	List *remoteScanTargetList = RemoteScanTargetList(workerTargetList);
 	return BuildSelectStatementViaStdPlanner(combineQuery, remoteScanTargetList,
 											 remoteScan);
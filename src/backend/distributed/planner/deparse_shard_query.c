@@ -13,6 +13,8 @@
 
 #include "c.h"
 
+#include "miscadmin.h"
+
 #include "access/heapam.h"
 #include "access/htup_details.h"
 #include "catalog/pg_constraint.h"
@@ -24,9 +26,11 @@
 #include "nodes/pg_list.h"
 #include "parser/parsetree.h"
 #include "storage/lock.h"
+#include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 
 #include "distributed/citus_nodefuncs.h"
 #include "distributed/citus_ruleutils.h"
@@ -38,11 +42,27 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_router_planner.h"
+#include "distributed/shard_pruning.h"
 #include "distributed/shard_utils.h"
 #include "distributed/utils/citus_stat_tenants.h"
 #include "distributed/version_compat.h"
 
 
+/* prefix of the placeholders for shard names in shard query templates */
+#define SHARD_PLACEHOLDER_PREFIX_FORMAT "citus_shard_%08x%08x_"
+#define SHARD_PLACEHOLDER_PREFIX_LENGTH 29
+
+
+/* whether to deparse queries for multiple shards only once */
+bool EnableShardQueryTemplates = true;
+
+static char ShardPlaceholderPrefix[SHARD_PLACEHOLDER_PREFIX_LENGTH + 1] = "";
+
+
+static bool RebuildQueryStringFromTemplate(Job *workerJob, Task *task,
+										   ShardQueryTemplate *queryTemplate);
+static bool SetShardPlaceholderNames(Node *node, List **relationIdList);
+static char * GetShardPlaceholderPrefix(void);
 static void UpdateTaskQueryString(Query *query, Task *task);
 static RelationShard * FindRelationShard(Oid inputRelationId, List *relationShardList);
 static void ConvertRteToSubqueryWithEmptyResult(RangeTblEntry *rte);
@@ -61,104 +81,384 @@ RebuildQueryStrings(Job *workerJob)
 	List *taskList = workerJob->taskList;
 	Task *task = NULL;
 	bool isSingleTask = list_length(taskList) == 1;
+	ShardQueryTemplate *queryTemplate = NULL;
+	List *arraySplitList = NIL;
 
 	if (originalQuery->commandType == CMD_INSERT)
 	{
 		AddInsertAliasIfNeeded(originalQuery);
 	}
 
-	foreach_ptr(task, taskList)
+	/*
+	 * Multi-shard UPDATE and DELETE queries only need the values of partition
+	 * column IN lists that hash into the shard of the task.
+	 */
+	if (!isSingleTask && (originalQuery->commandType == CMD_UPDATE ||
+						  originalQuery->commandType == CMD_DELETE))
 	{
-		Query *query = originalQuery;
+		arraySplitList = SplitPartitionKeyArraysByShard(originalQuery);
+	}
 
-		/*
-		 * Copy the query if there are multiple tasks. If there is a single
-		 * task, we scribble on the original query to avoid the copying
-		 * overhead.
-		 */
-		if (!isSingleTask)
-		{
-			query = copyObject(originalQuery);
-		}
+	/*
+	 * Otherwise, multi-shard UPDATE and DELETE queries only differ in the
+	 * shard names across tasks, so we deparse the query once.
+	 */
+	if (!isSingleTask && arraySplitList == NIL &&
+		UpdateOrDeleteOrMergeQuery(originalQuery))
+	{
+		queryTemplate = DeparseShardQueryTemplate(copyObject(originalQuery));
+	}
 
-		if (UpdateOrDeleteOrMergeQuery(query))
+	/*
+	 * The arrays are restricted in the job query itself, which may be cached
+	 * in a prepared plan, so always put them back.
+	 */
+	PG_TRY();
+	{
+		foreach_ptr(task, taskList)
 		{
-			List *relationShardList = task->relationShardList;
+			Query *query = originalQuery;
+
+			if (queryTemplate != NULL &&
+				RebuildQueryStringFromTemplate(workerJob, task, queryTemplate))
+			{
+				continue;
+			}
 
 			/*
-			 * For UPDATE and DELETE queries, we may have subqueries and joins, so
-			 * we use relation shard list to update shard names and call
-			 * pg_get_query_def() directly.
+			 * Copy the query if there are multiple tasks. If there is a single
+			 * task, we scribble on the original query to avoid the copying
+			 * overhead.
 			 */
-			UpdateRelationToShardNames((Node *) query, relationShardList);
-		}
-		else if (query->commandType == CMD_INSERT && task->modifyWithSubquery)
-		{
-			/* for INSERT..SELECT, adjust shard names in SELECT part */
-			List *relationShardList = task->relationShardList;
-			ShardInterval *shardInterval = LoadShardInterval(task->anchorShardId);
+			if (!isSingleTask)
+			{
+				RestrictPartitionKeyArraysToShards(arraySplitList,
+												   task->relationShardList);
 
-			RangeTblEntry *copiedInsertRte = ExtractResultRelationRTEOrError(query);
-			RangeTblEntry *copiedSubqueryRte = ExtractSelectRangeTableEntry(query);
-			Query *copiedSubquery = copiedSubqueryRte->subquery;
+				query = copyObject(originalQuery);
+			}
 
-			/* there are no restrictions to add for reference and citus local tables */
-			if (IsCitusTableType(shardInterval->relationId, DISTRIBUTED_TABLE))
+			if (UpdateOrDeleteOrMergeQuery(query))
 			{
-				AddPartitionKeyNotNullFilterToSelect(copiedSubquery);
+				List *relationShardList = task->relationShardList;
+
+				/*
+				 * For UPDATE and DELETE queries, we may have subqueries and joins, so
+				 * we use relation shard list to update shard names and call
+				 * pg_get_query_def() directly.
+				 */
+				UpdateRelationToShardNames((Node *) query, relationShardList);
 			}
+			else if (query->commandType == CMD_INSERT && task->modifyWithSubquery)
+			{
+				/* for INSERT..SELECT, adjust shard names in SELECT part */
+				List *relationShardList = task->relationShardList;
+				ShardInterval *shardInterval = LoadShardInterval(task->anchorShardId);
 
-			ReorderInsertSelectTargetLists(query, copiedInsertRte, copiedSubqueryRte);
+				RangeTblEntry *copiedInsertRte = ExtractResultRelationRTEOrError(query);
+				RangeTblEntry *copiedSubqueryRte = ExtractSelectRangeTableEntry(query);
+				Query *copiedSubquery = copiedSubqueryRte->subquery;
 
-			UpdateRelationToShardNames((Node *) copiedSubquery, relationShardList);
-		}
+				/* there are no restrictions to add for reference and citus local tables */
+				if (IsCitusTableType(shardInterval->relationId, DISTRIBUTED_TABLE))
+				{
+					AddPartitionKeyNotNullFilterToSelect(copiedSubquery);
+				}
 
-		if (query->commandType == CMD_INSERT)
-		{
-			RangeTblEntry *modifiedRelationRTE = linitial(originalQuery->rtable);
+				ReorderInsertSelectTargetLists(query, copiedInsertRte, copiedSubqueryRte);
 
-			/*
-			 * We store the modified relaiton ID in the task so we can lazily call
-			 * deparse_shard_query when the string is needed
-			 */
-			task->anchorDistributedTableId = modifiedRelationRTE->relid;
+				UpdateRelationToShardNames((Node *) copiedSubquery, relationShardList);
+			}
+
+			if (query->commandType == CMD_INSERT)
+			{
+				RangeTblEntry *modifiedRelationRTE = linitial(originalQuery->rtable);
+
+				/*
+				 * We store the modified relaiton ID in the task so we can lazily call
+				 * deparse_shard_query when the string is needed
+				 */
+				task->anchorDistributedTableId = modifiedRelationRTE->relid;
+
+				/*
+				 * For multi-row inserts, we modify the VALUES before storing the
+				 * query in the task.
+				 */
+				RangeTblEntry *valuesRTE = ExtractDistributedInsertValuesRTE(query);
+				if (valuesRTE != NULL)
+				{
+					Assert(valuesRTE->rtekind == RTE_VALUES);
+					Assert(task->rowValuesLists != NULL);
+
+					valuesRTE->values_lists = task->rowValuesLists;
+				}
+			}
+
+			bool isQueryObjectOrText = GetTaskQueryType(task) == TASK_QUERY_TEXT ||
+									   GetTaskQueryType(task) == TASK_QUERY_OBJECT;
+			ereport(DEBUG4, (errmsg("query before rebuilding: %s",
+									!isQueryObjectOrText
+									? "(null)"
+									: TaskQueryString(task))));
+
+			task->partitionKeyValue = workerJob->partitionKeyValue;
+			SetJobColocationId(workerJob);
+			task->colocationId = workerJob->colocationId;
+
+			UpdateTaskQueryString(query, task);
 
 			/*
-			 * For multi-row inserts, we modify the VALUES before storing the
-			 * query in the task.
+			 * If parameters were resolved in the job query, then they are now also
+			 * resolved in the query string.
 			 */
-			RangeTblEntry *valuesRTE = ExtractDistributedInsertValuesRTE(query);
-			if (valuesRTE != NULL)
-			{
-				Assert(valuesRTE->rtekind == RTE_VALUES);
-				Assert(task->rowValuesLists != NULL);
+			task->parametersInQueryStringResolved =
+				workerJob->parametersInJobQueryResolved;
 
-				valuesRTE->values_lists = task->rowValuesLists;
-			}
+			ereport(DEBUG4, (errmsg("query after rebuilding:  %s",
+									TaskQueryString(task))));
 		}
 
-		bool isQueryObjectOrText = GetTaskQueryType(task) == TASK_QUERY_TEXT ||
-								   GetTaskQueryType(task) == TASK_QUERY_OBJECT;
-		ereport(DEBUG4, (errmsg("query before rebuilding: %s",
-								!isQueryObjectOrText
-								? "(null)"
-								: TaskQueryString(task))));
+	}
+	PG_FINALLY();
+	{
+		ResetPartitionKeyArrays(arraySplitList);
+	}
+	PG_END_TRY();
+}
 
-		task->partitionKeyValue = workerJob->partitionKeyValue;
-		SetJobColocationId(workerJob);
-		task->colocationId = workerJob->colocationId;
 
-		UpdateTaskQueryString(query, task);
+/*
+ * RebuildQueryStringFromTemplate sets the query string of the given task by
+ * instantiating the query template, and returns whether it succeeded. It does
+ * not set the query string if the task might be executed locally, because
+ * local execution can skip deparsing altogether.
+ */
+static bool
+RebuildQueryStringFromTemplate(Job *workerJob, Task *task,
+							   ShardQueryTemplate *queryTemplate)
+{
+	if (ShouldLazyDeparseQuery(task))
+	{
+		return false;
+	}
+
+	char *queryString = InstantiateShardQueryTemplate(queryTemplate,
+													  task->relationShardList);
+	if (queryString == NULL)
+	{
+		return false;
+	}
+
+	task->partitionKeyValue = workerJob->partitionKeyValue;
+	SetJobColocationId(workerJob);
+	task->colocationId = workerJob->colocationId;
+
+	SetTaskQueryString(task, AnnotateQuery(queryString, task->partitionKeyValue,
+										   task->colocationId));
+
+	/* parameters resolved in the job query are also resolved in the template */
+	task->parametersInQueryStringResolved = workerJob->parametersInJobQueryResolved;
+
+	ereport(DEBUG4, (errmsg("query after rebuilding:  %s",
+							TaskQueryString(task))));
+
+	return true;
+}
 
-		/*
-		 * If parameters were resolved in the job query, then they are now also
-		 * resolved in the query string.
-		 */
-		task->parametersInQueryStringResolved = workerJob->parametersInJobQueryResolved;
 
-		ereport(DEBUG4, (errmsg("query after rebuilding:  %s",
-								TaskQueryString(task))));
+/*
+ * DeparseShardQueryTemplate deparses the given query, in which the Citus
+ * tables are not yet replaced by shards, into a template in which the shard
+ * names can be substituted for each task. The query is modified in the
+ * process. Returns NULL if templates are disabled.
+ *
+ * The placeholders for the shard names are identifiers that start with a
+ * prefix that contains a random number, such that they cannot be confused
+ * with any other part of the query.
+ */
+ShardQueryTemplate *
+DeparseShardQueryTemplate(Query *query)
+{
+	if (!EnableShardQueryTemplates)
+	{
+		return NULL;
 	}
+
+	List *placeholderRelationIdList = NIL;
+	SetShardPlaceholderNames((Node *) query, &placeholderRelationIdList);
+
+	StringInfo templateString = makeStringInfo();
+	pg_get_query_def(query, templateString);
+
+	ShardQueryTemplate *queryTemplate = palloc0(sizeof(ShardQueryTemplate));
+	char *placeholderPrefix = GetShardPlaceholderPrefix();
+	char *fragmentStart = templateString->data;
+	char *placeholder = NULL;
+
+	while ((placeholder = strstr(fragmentStart, placeholderPrefix)) != NULL)
+	{
+		char *placeholderIndexString = placeholder + SHARD_PLACEHOLDER_PREFIX_LENGTH;
+		char *placeholderEnd = NULL;
+		int placeholderIndex = (int) strtol(placeholderIndexString, &placeholderEnd, 10);
+		Oid relationId = list_nth_oid(placeholderRelationIdList, placeholderIndex);
+
+		queryTemplate->queryFragmentList =
+			lappend(queryTemplate->queryFragmentList,
+					pnstrdup(fragmentStart, placeholder - fragmentStart));
+		queryTemplate->relationIdList =
+			lappend_oid(queryTemplate->relationIdList, relationId);
+
+		fragmentStart = placeholderEnd;
+	}
+
+	queryTemplate->queryFragmentList =
+		lappend(queryTemplate->queryFragmentList, pstrdup(fragmentStart));
+
+	return queryTemplate;
+}
+
+
+/*
+ * InstantiateShardQueryTemplate returns the query string of the template in
+ * which the placeholders are replaced by the names of the shards in the
+ * relation shard list. Returns NULL if a relation in the template does not
+ * have a shard in the list, in which case the query needs to be deparsed for
+ * the task since UpdateRelationToShardNames changes the query structure.
+ */
+char *
+InstantiateShardQueryTemplate(ShardQueryTemplate *queryTemplate,
+							  List *relationShardList)
+{
+	StringInfo queryString = makeStringInfo();
+	ListCell *fragmentCell = list_head(queryTemplate->queryFragmentList);
+
+	Oid relationId = InvalidOid;
+	foreach_oid(relationId, queryTemplate->relationIdList)
+	{
+		RelationShard *relationShard = FindRelationShard(relationId,
+														 relationShardList);
+		if (relationShard == NULL || relationShard->shardId == INVALID_SHARD_ID)
+		{
+			return NULL;
+		}
+
+		char *shardName = get_rel_name(relationId);
+		AppendShardIdToName(&shardName, relationShard->shardId);
+
+		appendStringInfoString(queryString, (char *) lfirst(fragmentCell));
+		appendStringInfoString(queryString, quote_identifier(shardName));
+
+		fragmentCell = lnext(queryTemplate->queryFragmentList, fragmentCell);
+	}
+
+	appendStringInfoString(queryString, (char *) lfirst(fragmentCell));
+
+	return queryString->data;
+}
+
+
+/*
+ * SetShardPlaceholderNames walks over the query tree and replaces the names of
+ * Citus tables by placeholders, which contain the index of the relation in
+ * relationIdList. It mirrors UpdateRelationToShardNames.
+ */
+static bool
+SetShardPlaceholderNames(Node *node, List **relationIdList)
+{
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	/* want to look at all RTEs, even in subqueries, CTEs and such */
+	if (IsA(node, Query))
+	{
+		return query_tree_walker((Query *) node, SetShardPlaceholderNames,
+								 relationIdList, QTW_EXAMINE_RTES_BEFORE);
+	}
+
+	if (!IsA(node, RangeTblEntry))
+	{
+		return expression_tree_walker(node, SetShardPlaceholderNames,
+									  relationIdList);
+	}
+
+	RangeTblEntry *newRte = (RangeTblEntry *) node;
+
+	if (newRte->rtekind == RTE_FUNCTION)
+	{
+		newRte = NULL;
+		if (!FindCitusExtradataContainerRTE(node, &newRte))
+		{
+			/* only update function rtes containing citus_extradata_container */
+			return false;
+		}
+	}
+	else if (newRte->rtekind != RTE_RELATION)
+	{
+		return false;
+	}
+
+	Oid relationId = newRte->relid;
+	if (!IsCitusTable(relationId))
+	{
+		/* leave local tables as is */
+		return false;
+	}
+
+	int placeholderIndex = 0;
+	Oid placeholderRelationId = InvalidOid;
+	foreach_oid(placeholderRelationId, *relationIdList)
+	{
+		if (placeholderRelationId == relationId)
+		{
+			break;
+		}
+
+		placeholderIndex++;
+	}
+
+	if (placeholderIndex == list_length(*relationIdList))
+	{
+		*relationIdList = lappend_oid(*relationIdList, relationId);
+	}
+
+	StringInfo placeholderName = makeStringInfo();
+	appendStringInfo(placeholderName, "%s%d", GetShardPlaceholderPrefix(),
+					 placeholderIndex);
+
+	Oid schemaId = get_rel_namespace(relationId);
+	char *schemaName = get_namespace_name(schemaId);
+
+	ModifyRangeTblExtraData(newRte, CITUS_RTE_SHARD, schemaName, placeholderName->data,
+							NIL);
+
+	return false;
+}
+
+
+/*
+ * GetShardPlaceholderPrefix returns the prefix of the shard name placeholders
+ * of this backend, which is generated on first use.
+ */
+static char *
+GetShardPlaceholderPrefix(void)
+{
+	if (ShardPlaceholderPrefix[0] == '\0')
+	{
+		uint32 randomNumbers[2];
+
+		if (!pg_strong_random(randomNumbers, sizeof(randomNumbers)))
+		{
+			randomNumbers[0] = (uint32) random() ^ (uint32) MyProcPid;
+			randomNumbers[1] = (uint32) random() ^ (uint32) GetCurrentTimestamp();
+		}
+
+		snprintf(ShardPlaceholderPrefix, sizeof(ShardPlaceholderPrefix),
+				 SHARD_PLACEHOLDER_PREFIX_FORMAT, randomNumbers[0], randomNumbers[1]);
+	}
+
+	return ShardPlaceholderPrefix;
 }
 
 
@@ -48,6 +48,7 @@
 #include "distributed/coordinator_protocol.h"
 #include "distributed/cte_inline.h"
 #include "distributed/distributed_planner.h"
+#include "distributed/distributed_statistics.h"
 #include "distributed/function_call_delegation.h"
 #include "distributed/insert_select_planner.h"
 #include "distributed/intermediate_result_pruning.h"
@@ -93,6 +94,9 @@ static uint64 NextPlanId = 1;
 /* keep track of planner call stack levels */
 int PlannerLevel = 0;
 
+/* whether to plan multi-shard SELECTs without bound parameter values */
+bool EnableGenericMultiShardPlans = false;
+
 static bool ListContainsDistributedTableRTE(List *rangeTableList,
 											bool *maybeHasForeignDistributedTable);
 static PlannedStmt * CreateDistributedPlannedStmt(
@@ -152,6 +156,14 @@ static RouterPlanType GetRouterPlanType(Query *query,
 										bool hasUnresolvedParams);
 static void ConcatenateRTablesAndPerminfos(PlannedStmt *mainPlan,
 										   PlannedStmt *concatPlan);
+static DistributedPlan * TryCreateGenericMultiShardPlan(Query *originalQuery,
+														Query *query,
+														PlannerRestrictionContext *
+														plannerRestrictionContext);
+static DistributedPlan * CreateLogicalAndPhysicalPlan(Query *originalQuery,
+													  Query *query,
+													  PlannerRestrictionContext *
+													  plannerRestrictionContext);
 
 
 /* Distributed planner hook */
@@ -1067,7 +1079,18 @@ CreateDistributedPlan(uint64 planId, bool allowRecursivePlanning, Query *origina
 		 * parameters. We return a NULL plan, which will have an
 		 * extremely high cost, such that postgres will replan with
 		 * bound parameters.
+		 *
+		 * SELECT queries that can be planned without recursive planning
+		 * may optionally be planned with the parameters left in place,
+		 * such that postgres can cache the plan and we only prune the
+		 * shards for each execution.
 		 */
+		if (EnableGenericMultiShardPlans && !hasCtes && !IsModifyCommand(originalQuery))
+		{
+			return TryCreateGenericMultiShardPlan(originalQuery, query,
+												  plannerRestrictionContext);
+		}
+
 		return NULL;
 	}
 
@@ -1193,6 +1216,19 @@ CreateDistributedPlan(uint64 planId, bool allowRecursivePlanning, Query *origina
 
 	/* Step 3: Try Logical planner */
 
+	return CreateLogicalAndPhysicalPlan(originalQuery, query, plannerRestrictionContext);
+}
+
+
+/*
+ * CreateLogicalAndPhysicalPlan creates a distributed plan for a query that
+ * cannot be router planned by going through the logical planner, the logical
+ * optimizer and the physical planner.
+ */
+static DistributedPlan *
+CreateLogicalAndPhysicalPlan(Query *originalQuery, Query *query,
+							 PlannerRestrictionContext *plannerRestrictionContext)
+{
 	MultiTreeRoot *logicalPlan = MultiLogicalPlanCreate(originalQuery, query,
 														plannerRestrictionContext);
 	MultiLogicalPlanOptimize(logicalPlan);
@@ -1207,8 +1243,8 @@ CreateDistributedPlan(uint64 planId, bool allowRecursivePlanning, Query *origina
 	CheckNodeIsDumpable((Node *) logicalPlan);
 
 	/* Create the physical plan */
-	distributedPlan = CreatePhysicalDistributedPlan(logicalPlan,
-													plannerRestrictionContext);
+	DistributedPlan *distributedPlan =
+		CreatePhysicalDistributedPlan(logicalPlan, plannerRestrictionContext);
 
 	/* distributed plan currently should always succeed or error out */
 	Assert(distributedPlan && distributedPlan->planningError == NULL);
@@ -1217,6 +1253,70 @@ CreateDistributedPlan(uint64 planId, bool allowRecursivePlanning, Query *origina
 }
 
 
+/*
+ * TryCreateGenericMultiShardPlan tries to create a multi-shard plan for a
+ * SELECT query that has parameters without a value, such that the plan can be
+ * reused across executions of a prepared statement. The parameters are sent
+ * to the workers along with the task queries, and the executor prunes the
+ * task list once the parameter values are known.
+ *
+ * The function returns NULL if the query cannot be planned this way, in which
+ * case postgres falls back to planning the query with bound parameters.
+ */
+static DistributedPlan *
+TryCreateGenericMultiShardPlan(Query *originalQuery, Query *query,
+							   PlannerRestrictionContext *plannerRestrictionContext)
+{
+	MemoryContext savedContext = CurrentMemoryContext;
+	DistributedPlan *distributedPlan = NULL;
+
+	/* preserve the original query in case planning fails */
+	Query *copyOfOriginalQuery = copyObject(originalQuery);
+
+	PG_TRY();
+	{
+		distributedPlan = CreateLogicalAndPhysicalPlan(copyOfOriginalQuery, query,
+													   plannerRestrictionContext);
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(savedContext);
+		ErrorData *edata = CopyErrorData();
+		FlushErrorState();
+
+		/* don't try to intercept PANIC or FATAL, let those breeze past us */
+		if (edata->elevel != ERROR)
+		{
+			PG_RE_THROW();
+		}
+
+		ereport(DEBUG4, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("Planning with unbound parameters failed with "
+								"\nmessage: %s\ndetail: %s\nhint: %s",
+								edata->message ? edata->message : "",
+								edata->detail ? edata->detail : "",
+								edata->hint ? edata->hint : "")));
+
+		/* leave the error handling system */
+		FreeErrorData(edata);
+
+		distributedPlan = NULL;
+	}
+	PG_END_TRY();
+
+	/*
+	 * Repartition jobs embed their queries in function calls on the workers,
+	 * which cannot receive the parameters.
+	 */
+	if (distributedPlan != NULL && distributedPlan->workerJob->dependentJobList != NIL)
+	{
+		return NULL;
+	}
+
+	return distributedPlan;
+}
+
+
 /*
  * EnsurePartitionTableNotReplicated errors out if the input relation is
  * a partition table and the table has a replication factor greater than
@@ -2038,6 +2138,8 @@ multi_relation_restriction_hook(PlannerInfo *root, RelOptInfo *relOptInfo,
  * multi_get_relation_info_hook modifies the relation's indexlist
  * if necessary, to avoid a crash in PG16 caused by our
  * Citus function AdjustPartitioningForDistributedPlanning().
+ * It also sets the size estimates of distributed tables, see
+ * SetDistributedTableSizeEstimate().
  *
  * AdjustPartitioningForDistributedPlanning() is a hack that we use
  * to prevent Postgres' standard_planner() to expand all the partitions
@@ -2087,6 +2189,9 @@ multi_get_relation_info_hook(PlannerInfo *root, Oid relationObjectId, bool inhpa
 			}
 		}
 	}
+
+	/* use the statistics that citus_analyze gathered from the shards, if any */
+	SetDistributedTableSizeEstimate(relationObjectId, rel);
 }
 
 
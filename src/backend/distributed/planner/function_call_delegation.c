@@ -635,6 +635,10 @@ ShardPlacementForFunctionColocatedWithReferenceTable(CitusTableCacheEntry *cache
 		/* reorder the placement list */
 		placementList = RoundRobinReorder(placementList);
 	}
+	else if (TaskAssignmentPolicy == TASK_ASSIGNMENT_ADAPTIVE)
+	{
+		placementList = AdaptiveReorder(placementList);
+	}
 
 	return (ShardPlacement *) linitial(placementList);
 }
@@ -30,6 +30,7 @@ bool LogIntermediateResults = false;
 
 
 static List * FindSubPlansUsedInNode(Node *node, SubPlanAccessType accessType);
+static bool SubPlanUsageListContains(List *usedSubPlanList, char *resultId);
 static void AppendAllAccessedWorkerNodes(IntermediateResultsHashEntry *entry,
 										 DistributedPlan *distributedPlan,
 										 int nodeCount);
@@ -45,8 +46,9 @@ static void LogIntermediateResultMulticastSummary(IntermediateResultsHashEntry *
  * job query and returns them as a combined list of UsedDistributedSubPlan
  * structs.
  *
- * The list may contain duplicates if the subplan is referenced multiple
- * times.
+ * The list contains a single entry per subplan and access type, even if the
+ * subplan is referenced multiple times, such as when identical subqueries
+ * share a subplan.
  */
 List *
 FindSubPlanUsages(DistributedPlan *plan)
@@ -113,7 +115,7 @@ FindSubPlansUsedInNode(Node *node, SubPlanAccessType accessType)
 			char *resultId =
 				FindIntermediateResultIdIfExists(rangeTableEntry);
 
-			if (resultId == NULL)
+			if (resultId == NULL || SubPlanUsageListContains(usedSubPlanList, resultId))
 			{
 				continue;
 			}
@@ -135,6 +137,28 @@ FindSubPlansUsedInNode(Node *node, SubPlanAccessType accessType)
 }
 
 
+/*
+ * SubPlanUsageListContains returns whether the given list of
+ * UsedDistributedSubPlans already contains the given intermediate result.
+ * Adding the same result again would only make us revisit the tasks of the
+ * plan when deciding where to send the result.
+ */
+static bool
+SubPlanUsageListContains(List *usedSubPlanList, char *resultId)
+{
+	UsedDistributedSubPlan *usedPlan = NULL;
+	foreach_ptr(usedPlan, usedSubPlanList)
+	{
+		if (strcmp(usedPlan->subPlanId, resultId) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * RecordSubplanExecutionsOnNodes iterates over the usedSubPlanNodeList,
  * and for each entry, record the workerNodes that are accessed by
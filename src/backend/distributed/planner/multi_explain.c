@@ -596,6 +596,12 @@ ExplainMapMergeJob(MapMergeJob *mapMergeJob, ExplainState *es)
 	ExplainPropertyInteger("Map Task Count", NULL, mapTaskCount, es);
 	ExplainPropertyInteger("Merge Task Count", NULL, mergeTaskCount, es);
 
+	if (mapMergeJob->estimatedDataSize > 0)
+	{
+		ExplainPropertyBytes("Estimated Data Transfer",
+							 (int64) mapMergeJob->estimatedDataSize, es);
+	}
+
 	if (dependentJobCount > 0)
 	{
 		ExplainOpenGroup("Dependent Jobs", "Dependent Jobs", false, es);
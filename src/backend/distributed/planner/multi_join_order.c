@@ -2,7 +2,8 @@
  *
  * multi_join_order.c
  *
- * Routines for constructing the join order list using a rule-based approach.
+ * Routines for constructing the join order list using a rule-based approach,
+ * optionally refined by estimates of the data that each join transfers.
  *
  * Copyright (c) Citus Data, Inc.
  *
@@ -22,25 +23,41 @@
 #include "lib/stringinfo.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/optimizer.h"
+#include "optimizer/plancat.h"
+#include "storage/itemid.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
+#include "utils/hsearch.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/selfuncs.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 
 #include "pg_version_constants.h"
 
 #include "distributed/listutils.h"
 #include "distributed/metadata_cache.h"
+#include "distributed/metadata_utility.h"
 #include "distributed/multi_join_order.h"
+#include "distributed/multi_logical_planner.h"
+#include "distributed/multi_partitioning_utils.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/pg_dist_partition.h"
+#include "distributed/transaction_management.h"
 #include "distributed/worker_protocol.h"
 
 
+/* how long we use table sizes that we fetched from the workers */
+#define TABLE_SIZE_CACHE_TIMEOUT_MS 60000
+
+
 /* Config variables managed via guc.c */
 bool LogMultiJoinOrder = false; /* print join order as a debugging aid */
 bool EnableSingleHashRepartitioning = false;
+bool EnableCostBasedJoinOrder = false;
 
 /* Function pointer type definition for join rule evaluation functions */
 typedef JoinOrderNode *(*RuleEvalFunction) (JoinOrderNode *currentJoinNode,
@@ -52,12 +69,38 @@ static char *RuleNameArray[JOIN_RULE_LAST] = { 0 }; /* ordered join rule names *
 static RuleEvalFunction RuleEvalFunctionArray[JOIN_RULE_LAST] = { 0 }; /* join rules */
 
 
+/*
+ * TableSizeCacheEntry keeps the size of a distributed table, which we fetch
+ * from the workers at most once per TABLE_SIZE_CACHE_TIMEOUT_MS.
+ */
+typedef struct TableSizeCacheEntry
+{
+	Oid relationId;
+	uint64 tableSize;
+	TimestampTz fetchTime;
+} TableSizeCacheEntry;
+
+static HTAB *TableSizeCache = NULL;
+
+
 /* Local functions forward declarations */
 static bool JoinExprListWalker(Node *node, List **joinList);
 static bool ExtractLeftMostRangeTableIndex(Node *node, int *rangeTableIndex);
 static List * JoinOrderForTable(TableEntry *firstTable, List *tableEntryList,
 								List *joinClauseList);
 static List * BestJoinOrder(List *candidateJoinOrders);
+static bool BetterJoinOrderNode(JoinOrderNode *joinNode, JoinOrderNode *otherJoinNode);
+static bool IsCartesianJoinRule(JoinRuleType ruleType);
+static List * LowestTransferCost(List *candidateJoinOrders);
+static double JoinOrderTransferCost(List *joinOrder);
+static void EstimateTableEntrySizes(List *tableEntryList, List *whereClauseList);
+static bool IsRestrictionClauseOfTable(Node *clause, uint32 rangeTableId);
+static Selectivity RestrictionClauseSelectivity(Node *clause);
+static uint64 CachedTableSize(Oid relationId);
+static bool FetchTableSize(Oid relationId, uint64 *tableSize);
+static double AveragePlacementCount(Oid relationId);
+static void EstimateJoinOrderNodeCost(JoinOrderNode *currentJoinNode,
+									  JoinOrderNode *nextJoinNode);
 static List * FewestOfJoinRuleType(List *candidateJoinOrders, JoinRuleType ruleType);
 static uint32 JoinRuleTypeCount(List *joinOrder, JoinRuleType ruleTypeToCount);
 static List * LatestLargeDataTransfer(List *candidateJoinOrders);
@@ -281,13 +324,22 @@ NodeIsEqualsOpExpr(Node *node)
  * candidate join orders, each with a different table as its first table. Then,
  * the function chooses among these candidates the join order that transfers the
  * least amount of data across the network, and returns this join order.
+ *
+ * When citus.enable_cost_based_join_order is on, the amount of data is estimated
+ * from the table sizes and the filters in the given where clause list, rather
+ * than from the join rules alone.
  */
 List *
-JoinOrderList(List *tableEntryList, List *joinClauseList)
+JoinOrderList(List *tableEntryList, List *joinClauseList, List *whereClauseList)
 {
 	List *candidateJoinOrderList = NIL;
 	ListCell *tableEntryCell = NULL;
 
+	if (EnableCostBasedJoinOrder)
+	{
+		EstimateTableEntrySizes(tableEntryList, whereClauseList);
+	}
+
 	foreach(tableEntryCell, tableEntryList)
 	{
 		TableEntry *startingTable = (TableEntry *) lfirst(tableEntryCell);
@@ -329,7 +381,8 @@ JoinOrderList(List *tableEntryList, List *joinClauseList)
  * then chooses the table that has the lowest ranking join rule, and with which
  * it can join the table to the previous table in the join order. The function
  * repeats this until it determines all elements in the join order list, and
- * returns this list.
+ * returns this list. With cost-based join ordering, the function instead
+ * chooses the table whose join transfers the least amount of data.
  */
 static List *
 JoinOrderForTable(TableEntry *firstTable, List *tableEntryList, List *joinClauseList)
@@ -348,6 +401,8 @@ JoinOrderForTable(TableEntry *firstTable, List *tableEntryList, List *joinClause
 													 list_make1(firstPartitionColumn),
 													 firstPartitionMethod,
 													 firstTable);
+	firstJoinNode->rowCount = firstTable->rowCount;
+	firstJoinNode->rowWidth = firstTable->rowWidth;
 
 	/* add first node to the join order */
 	List *joinOrderList = list_make1(firstJoinNode);
@@ -359,7 +414,6 @@ JoinOrderForTable(TableEntry *firstTable, List *tableEntryList, List *joinClause
 	{
 		ListCell *pendingTableCell = NULL;
 		JoinOrderNode *nextJoinNode = NULL;
-		JoinRuleType nextJoinRuleType = JOIN_RULE_LAST;
 
 		List *pendingTableList = TableEntryListDifference(tableEntryList,
 														  joinedTableList);
@@ -386,12 +440,15 @@ JoinOrderForTable(TableEntry *firstTable, List *tableEntryList, List *joinClause
 				continue;
 			}
 
+			if (EnableCostBasedJoinOrder)
+			{
+				EstimateJoinOrderNodeCost(currentJoinNode, pendingJoinNode);
+			}
+
 			/* if this rule is better than previous ones, keep it */
-			JoinRuleType pendingJoinRuleType = pendingJoinNode->joinRuleType;
-			if (pendingJoinRuleType < nextJoinRuleType)
+			if (BetterJoinOrderNode(pendingJoinNode, nextJoinNode))
 			{
 				nextJoinNode = pendingJoinNode;
-				nextJoinRuleType = pendingJoinRuleType;
 			}
 		}
 
@@ -425,6 +482,10 @@ JoinOrderForTable(TableEntry *firstTable, List *tableEntryList, List *joinClause
  * this. First, the function chooses join orders that have the fewest number of
  * join operators that cause large data transfers. Second, the function chooses
  * join orders where large data transfers occur later in the execution.
+ *
+ * With cost-based join ordering, the function first chooses the join orders
+ * with the fewest cartesian products, and among those the ones with the lowest
+ * estimated data transfer. The heuristics above then only break ties.
  */
 static List *
 BestJoinOrder(List *candidateJoinOrders)
@@ -432,6 +493,13 @@ BestJoinOrder(List *candidateJoinOrders)
 	uint32 highestValidIndex = JOIN_RULE_LAST - 1;
 	uint32 candidateCount PG_USED_FOR_ASSERTS_ONLY = 0;
 
+	if (EnableCostBasedJoinOrder)
+	{
+		candidateJoinOrders = FewestOfJoinRuleType(candidateJoinOrders,
+												   CARTESIAN_PRODUCT);
+		candidateJoinOrders = LowestTransferCost(candidateJoinOrders);
+	}
+
 	/*
 	 * We start with the highest ranking rule type (cartesian product), and walk
 	 * over these rules in reverse order. For each rule type, we then keep join
@@ -473,6 +541,419 @@ BestJoinOrder(List *candidateJoinOrders)
 }
 
 
+/*
+ * BetterJoinOrderNode returns whether the given join order node is a better next
+ * step in a join order than the other node, which may be NULL. By default, the
+ * node with the lowest ranking join rule is better. With cost-based join
+ * ordering, we avoid cartesian products and then prefer the node that transfers
+ * the least amount of data, using the join rule and the join output size to
+ * break ties.
+ */
+static bool
+BetterJoinOrderNode(JoinOrderNode *joinNode, JoinOrderNode *otherJoinNode)
+{
+	if (otherJoinNode == NULL)
+	{
+		return true;
+	}
+
+	if (EnableCostBasedJoinOrder)
+	{
+		bool isCartesian = IsCartesianJoinRule(joinNode->joinRuleType);
+		bool otherIsCartesian = IsCartesianJoinRule(otherJoinNode->joinRuleType);
+
+		if (isCartesian != otherIsCartesian)
+		{
+			return !isCartesian;
+		}
+
+		if (joinNode->transferCost != otherJoinNode->transferCost)
+		{
+			return joinNode->transferCost < otherJoinNode->transferCost;
+		}
+
+		if (joinNode->joinRuleType == otherJoinNode->joinRuleType)
+		{
+			double outputSize = joinNode->rowCount * joinNode->rowWidth;
+			double otherOutputSize = otherJoinNode->rowCount * otherJoinNode->rowWidth;
+
+			return outputSize < otherOutputSize;
+		}
+	}
+
+	return joinNode->joinRuleType < otherJoinNode->joinRuleType;
+}
+
+
+/* IsCartesianJoinRule returns whether the join rule combines all rows of both sides. */
+static bool
+IsCartesianJoinRule(JoinRuleType ruleType)
+{
+	return ruleType == CARTESIAN_PRODUCT_REFERENCE_JOIN ||
+		   ruleType == CARTESIAN_PRODUCT;
+}
+
+
+/*
+ * LowestTransferCost finds the join orders with the lowest estimated number of
+ * bytes sent over the network, and filters all other join orders.
+ */
+static List *
+LowestTransferCost(List *candidateJoinOrders)
+{
+	List *cheapestJoinOrders = NIL;
+	double lowestTransferCost = 0.0;
+
+	List *joinOrder = NIL;
+	foreach_ptr(joinOrder, candidateJoinOrders)
+	{
+		double transferCost = JoinOrderTransferCost(joinOrder);
+
+		if (cheapestJoinOrders == NIL || transferCost < lowestTransferCost)
+		{
+			cheapestJoinOrders = list_make1(joinOrder);
+			lowestTransferCost = transferCost;
+		}
+		else if (transferCost == lowestTransferCost)
+		{
+			cheapestJoinOrders = lappend(cheapestJoinOrders, joinOrder);
+		}
+	}
+
+	return cheapestJoinOrders;
+}
+
+
+/* JoinOrderTransferCost returns the estimated bytes transferred by a join order. */
+static double
+JoinOrderTransferCost(List *joinOrder)
+{
+	double transferCost = 0.0;
+
+	JoinOrderNode *joinOrderNode = NULL;
+	foreach_ptr(joinOrderNode, joinOrder)
+	{
+		transferCost += joinOrderNode->transferCost;
+	}
+
+	return transferCost;
+}
+
+
+/*
+ * EstimateTableEntrySizes estimates the number of rows that each table in the
+ * given list contributes to the joins, and their width. The number of rows is
+ * derived from the size of the table's shards and the average row width, and
+ * reduced by the selectivity of the filters on the table.
+ *
+ * Since the shell tables on the coordinator have no statistics, selectivities
+ * are PostgreSQL's defaults for the type of clause.
+ */
+static void
+EstimateTableEntrySizes(List *tableEntryList, List *whereClauseList)
+{
+	TableEntry *tableEntry = NULL;
+	foreach_ptr(tableEntry, tableEntryList)
+	{
+		Oid relationId = tableEntry->relationId;
+		double rowWidth = get_relation_data_width(relationId, NULL);
+		double tupleSize = rowWidth + MAXALIGN(SizeofHeapTupleHeader) +
+						   sizeof(ItemIdData);
+		double rowCount = CachedTableSize(relationId) / tupleSize;
+
+		Node *whereClause = NULL;
+		foreach_ptr(whereClause, whereClauseList)
+		{
+			if (IsRestrictionClauseOfTable(whereClause, tableEntry->rangeTableId))
+			{
+				rowCount *= RestrictionClauseSelectivity(whereClause);
+			}
+		}
+
+		tableEntry->rowCount = clamp_row_est(rowCount);
+		tableEntry->rowWidth = rowWidth;
+	}
+}
+
+
+/*
+ * IsRestrictionClauseOfTable returns whether the clause only refers to columns
+ * of the table with the given range table id.
+ */
+static bool
+IsRestrictionClauseOfTable(Node *clause, uint32 rangeTableId)
+{
+	List *columnList = pull_var_clause_default(clause);
+	if (columnList == NIL)
+	{
+		return false;
+	}
+
+	Var *column = NULL;
+	foreach_ptr(column, columnList)
+	{
+		if (column->varno != rangeTableId)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * RestrictionClauseSelectivity returns the fraction of rows that we expect to
+ * pass the given filter, based on the kind of clause.
+ */
+static Selectivity
+RestrictionClauseSelectivity(Node *clause)
+{
+	if (IsA(clause, OpExpr))
+	{
+		OpExpr *operatorExpression = (OpExpr *) clause;
+
+		if (OperatorImplementsEquality(operatorExpression->opno))
+		{
+			return DEFAULT_EQ_SEL;
+		}
+
+		return DEFAULT_INEQ_SEL;
+	}
+	else if (IsA(clause, ScalarArrayOpExpr))
+	{
+		ScalarArrayOpExpr *arrayOperatorExpression = (ScalarArrayOpExpr *) clause;
+		Node *arrayArgument = (Node *) lsecond(arrayOperatorExpression->args);
+
+		if (arrayOperatorExpression->useOr &&
+			OperatorImplementsEquality(arrayOperatorExpression->opno) &&
+			IsA(arrayArgument, Const) && !((Const *) arrayArgument)->constisnull)
+		{
+			ArrayType *array = DatumGetArrayTypeP(((Const *) arrayArgument)->constvalue);
+			int elementCount = ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+
+			return Min(1.0, elementCount * DEFAULT_EQ_SEL);
+		}
+
+		return DEFAULT_INEQ_SEL;
+	}
+	else if (IsA(clause, NullTest))
+	{
+		NullTest *nullTest = (NullTest *) clause;
+
+		if (nullTest->nulltesttype == IS_NULL)
+		{
+			return DEFAULT_UNK_SEL;
+		}
+
+		return 1.0 - DEFAULT_UNK_SEL;
+	}
+	else if (is_andclause(clause))
+	{
+		Selectivity selectivity = 1.0;
+
+		Node *argument = NULL;
+		foreach_ptr(argument, ((BoolExpr *) clause)->args)
+		{
+			selectivity *= RestrictionClauseSelectivity(argument);
+		}
+
+		return selectivity;
+	}
+	else if (is_orclause(clause))
+	{
+		Selectivity selectivity = 0.0;
+
+		Node *argument = NULL;
+		foreach_ptr(argument, ((BoolExpr *) clause)->args)
+		{
+			Selectivity argumentSelectivity = RestrictionClauseSelectivity(argument);
+
+			selectivity = selectivity + argumentSelectivity -
+						  selectivity * argumentSelectivity;
+		}
+
+		return selectivity;
+	}
+	else if (is_notclause(clause))
+	{
+		return 1.0 - RestrictionClauseSelectivity((Node *) get_notclausearg(clause));
+	}
+
+	return DEFAULT_INEQ_SEL;
+}
+
+
+/*
+ * CachedTableSize returns the size of a single copy of the given table's
+ * shards, which we fetch from the workers and keep for a while. If we cannot
+ * get the size, the function returns 0 and we treat the table as empty.
+ */
+static uint64
+CachedTableSize(Oid relationId)
+{
+	if (TableSizeCache == NULL)
+	{
+		HASHCTL info = {
+			.keysize = sizeof(Oid),
+			.entrysize = sizeof(TableSizeCacheEntry),
+			.hcxt = CacheMemoryContext
+		};
+
+		TableSizeCache = hash_create("Table Size Cache", 32, &info,
+									 HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+	}
+
+	TimestampTz currentTime = GetCurrentTimestamp();
+	bool found = false;
+
+	TableSizeCacheEntry *cacheEntry = hash_search(TableSizeCache, &relationId,
+												  HASH_FIND, &found);
+	if (found && !TimestampDifferenceExceeds(cacheEntry->fetchTime, currentTime,
+											 TABLE_SIZE_CACHE_TIMEOUT_MS))
+	{
+		return cacheEntry->tableSize;
+	}
+
+	/* the size functions cannot see the data modified by this transaction */
+	if (XactModificationLevel == XACT_MODIFICATION_DATA)
+	{
+		return 0;
+	}
+
+	uint64 placementsSize = 0;
+	if (!FetchTableSize(relationId, &placementsSize))
+	{
+		return 0;
+	}
+
+	cacheEntry = hash_search(TableSizeCache, &relationId, HASH_ENTER, &found);
+	cacheEntry->tableSize = (uint64) (placementsSize /
+									  AveragePlacementCount(relationId));
+	cacheEntry->fetchTime = currentTime;
+
+	return cacheEntry->tableSize;
+}
+
+
+/*
+ * FetchTableSize fetches the total size of the main forks of the placements of
+ * the given table from the workers, including the sizes of its partitions.
+ */
+static bool
+FetchTableSize(Oid relationId, uint64 *tableSize)
+{
+	bool failOnError = false;
+	if (!DistributedRelationSize(relationId, RELATION_SIZE, failOnError, tableSize))
+	{
+		return false;
+	}
+
+	if (PartitionedTable(relationId))
+	{
+		Oid partitionId = InvalidOid;
+		foreach_oid(partitionId, PartitionList(relationId))
+		{
+			uint64 partitionSize = 0;
+			if (!FetchTableSize(partitionId, &partitionSize))
+			{
+				return false;
+			}
+
+			*tableSize += partitionSize;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * AveragePlacementCount returns the average number of active placements of the
+ * shards of the given table, which is the number of nodes for reference tables.
+ */
+static double
+AveragePlacementCount(Oid relationId)
+{
+	List *shardIntervalList = LoadShardIntervalList(relationId);
+	int placementCount = 0;
+
+	ShardInterval *shardInterval = NULL;
+	foreach_ptr(shardInterval, shardIntervalList)
+	{
+		placementCount += list_length(ActiveShardPlacementList(shardInterval->shardId));
+	}
+
+	if (placementCount == 0)
+	{
+		return 1.0;
+	}
+
+	return (double) placementCount / list_length(shardIntervalList);
+}
+
+
+/*
+ * EstimateJoinOrderNodeCost estimates the output size of joining the next join
+ * order node to the current one, and the number of bytes that this join sends
+ * over the network.
+ *
+ * Without distinct counts, we assume that equi-joins are between keys and
+ * foreign keys, and thus produce as many rows as the larger side.
+ */
+static void
+EstimateJoinOrderNodeCost(JoinOrderNode *currentJoinNode, JoinOrderNode *nextJoinNode)
+{
+	TableEntry *candidateTable = nextJoinNode->tableEntry;
+	double currentSize = currentJoinNode->rowCount * currentJoinNode->rowWidth;
+	double candidateSize = candidateTable->rowCount * candidateTable->rowWidth;
+	JoinRuleType joinRuleType = nextJoinNode->joinRuleType;
+
+	if (IsCartesianJoinRule(joinRuleType))
+	{
+		nextJoinNode->rowCount = currentJoinNode->rowCount * candidateTable->rowCount;
+	}
+	else
+	{
+		nextJoinNode->rowCount = Max(currentJoinNode->rowCount, candidateTable->rowCount);
+	}
+
+	nextJoinNode->rowWidth = currentJoinNode->rowWidth + candidateTable->rowWidth;
+
+	switch (joinRuleType)
+	{
+		case SINGLE_HASH_PARTITION_JOIN:
+		case SINGLE_RANGE_PARTITION_JOIN:
+		{
+			/* the side that is not anchored on its partition column moves */
+			if (nextJoinNode->anchorTable == candidateTable)
+			{
+				nextJoinNode->transferCost = currentSize;
+			}
+			else
+			{
+				nextJoinNode->transferCost = candidateSize;
+			}
+
+			break;
+		}
+
+		case DUAL_PARTITION_JOIN:
+		case CARTESIAN_PRODUCT:
+		{
+			nextJoinNode->transferCost = currentSize + candidateSize;
+			break;
+		}
+
+		default:
+		{
+			nextJoinNode->transferCost = 0.0;
+			break;
+		}
+	}
+}
+
+
 /*
  * FewestOfJoinRuleType finds join orders that have the fewest number of times
  * the given join rule occurs in the candidate join orders, and filters all
@@ -624,8 +1105,17 @@ PrintJoinOrderList(List *joinOrder)
 		}
 	}
 
-	ereport(LOG, (errmsg("join order: %s",
-						 printBuffer->data)));
+	if (EnableCostBasedJoinOrder)
+	{
+		ereport(LOG, (errmsg("join order: %s", printBuffer->data),
+					  errdetail("Estimated data transfer: %.0f bytes",
+								JoinOrderTransferCost(joinOrder))));
+	}
+	else
+	{
+		ereport(LOG, (errmsg("join order: %s",
+							 printBuffer->data)));
+	}
 }
 
 
@@ -966,6 +1456,10 @@ LocalJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
  * or the candidate table is already partitioned on a join column. If they are,
  * the function returns a join order node with the already partitioned column as
  * the next partition key. Otherwise, the function returns null.
+ *
+ * If both sides are partitioned on a join column, we repartition the candidate
+ * table, unless cost-based join ordering estimates the other side to be
+ * smaller.
  */
 static JoinOrderNode *
 SinglePartitionJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
@@ -975,6 +1469,8 @@ SinglePartitionJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
 	char currentPartitionMethod = currentJoinNode->partitionMethod;
 	TableEntry *currentAnchorTable = currentJoinNode->anchorTable;
 	JoinRuleType currentJoinRuleType = currentJoinNode->joinRuleType;
+	JoinOrderNode *candidateMovesJoinNode = NULL;
+	JoinOrderNode *currentMovesJoinNode = NULL;
 
 
 	Oid relationId = candidateTable->relationId;
@@ -1014,20 +1510,27 @@ SinglePartitionJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
 				return NULL;
 			}
 
-			return MakeJoinOrderNode(candidateTable, SINGLE_HASH_PARTITION_JOIN,
-									 currentPartitionColumnList,
-									 currentPartitionMethod,
-									 currentAnchorTable);
+			candidateMovesJoinNode = MakeJoinOrderNode(candidateTable,
+													   SINGLE_HASH_PARTITION_JOIN,
+													   currentPartitionColumnList,
+													   currentPartitionMethod,
+													   currentAnchorTable);
 		}
 		else if (candidatePartitionMethod == DISTRIBUTE_BY_RANGE)
 		{
-			return MakeJoinOrderNode(candidateTable, SINGLE_RANGE_PARTITION_JOIN,
-									 currentPartitionColumnList,
-									 currentPartitionMethod,
-									 currentAnchorTable);
+			candidateMovesJoinNode = MakeJoinOrderNode(candidateTable,
+													   SINGLE_RANGE_PARTITION_JOIN,
+													   currentPartitionColumnList,
+													   currentPartitionMethod,
+													   currentAnchorTable);
 		}
 	}
 
+	if (candidateMovesJoinNode != NULL && !EnableCostBasedJoinOrder)
+	{
+		return candidateMovesJoinNode;
+	}
+
 	/* evaluate re-partitioning the current table only if the rule didn't apply above */
 	if (candidatePartitionMethod != DISTRIBUTE_BY_NONE)
 	{
@@ -1050,27 +1553,45 @@ SinglePartitionJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
 				 */
 				if (!EnableSingleHashRepartitioning)
 				{
-					return NULL;
+					return candidateMovesJoinNode;
 				}
 
-				return MakeJoinOrderNode(candidateTable,
-										 SINGLE_HASH_PARTITION_JOIN,
-										 candidatePartitionColumnList,
-										 candidatePartitionMethod,
-										 candidateTable);
+				currentMovesJoinNode = MakeJoinOrderNode(candidateTable,
+														 SINGLE_HASH_PARTITION_JOIN,
+														 candidatePartitionColumnList,
+														 candidatePartitionMethod,
+														 candidateTable);
 			}
 			else if (currentPartitionMethod == DISTRIBUTE_BY_RANGE)
 			{
-				return MakeJoinOrderNode(candidateTable,
-										 SINGLE_RANGE_PARTITION_JOIN,
-										 candidatePartitionColumnList,
-										 candidatePartitionMethod,
-										 candidateTable);
+				currentMovesJoinNode = MakeJoinOrderNode(candidateTable,
+														 SINGLE_RANGE_PARTITION_JOIN,
+														 candidatePartitionColumnList,
+														 candidatePartitionMethod,
+														 candidateTable);
 			}
 		}
 	}
 
-	return NULL;
+	if (candidateMovesJoinNode == NULL)
+	{
+		return currentMovesJoinNode;
+	}
+	else if (currentMovesJoinNode == NULL)
+	{
+		return candidateMovesJoinNode;
+	}
+
+	/* both sides can be repartitioned, pick the one with less data to move */
+	double currentSize = currentJoinNode->rowCount * currentJoinNode->rowWidth;
+	double candidateSize = candidateTable->rowCount * candidateTable->rowWidth;
+
+	if (currentSize < candidateSize)
+	{
+		return currentMovesJoinNode;
+	}
+
+	return candidateMovesJoinNode;
 }
 
 
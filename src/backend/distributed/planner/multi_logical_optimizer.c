@@ -35,16 +35,19 @@
 #include "parser/parse_oper.h"
 #include "parser/parsetree.h"
 #include "rewrite/rewriteManip.h"
+#include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/syscache.h"
+#include "utils/typcache.h"
 
 #include "pg_version_constants.h"
 
 #include "distributed/citus_nodes.h"
 #include "distributed/citus_ruleutils.h"
 #include "distributed/colocation_utils.h"
+#include "distributed/commands/multi_copy.h"
 #include "distributed/errormessage.h"
 #include "distributed/extended_op_node_utils.h"
 #include "distributed/function_utils.h"
@@ -63,6 +66,8 @@
 /* Config variable managed via guc.c */
 int LimitClauseRowFetchCount = -1; /* number of rows to fetch from each task */
 double CountDistinctErrorRate = 0.0; /* precision of count(distinct) approximate */
+int CountDistinctApproximationMethod = COUNT_DISTINCT_APPROXIMATION_AUTO;
+int PercentileApproximationCompression = DISABLE_PERCENTILE_APPROXIMATION;
 int CoordinatorAggregationStrategy = COORDINATOR_AGGREGATION_ROW_GATHER;
 
 /* Constant used throughout file */
@@ -276,9 +281,13 @@ static AggregateType GetAggregateType(Aggref *aggregatExpression);
 static Oid AggregateArgumentType(Aggref *aggregate);
 static Expr * FirstAggregateArgument(Aggref *aggregate);
 static bool AggregateEnabledCustom(Aggref *aggregateExpression);
+static bool IsApproximablePercentileCont(Aggref *aggregateExpression,
+										 const char *aggregateProcName);
+static bool AggregateHasPolymorphicArguments(Oid aggregateOid);
 static Oid CitusFunctionOidWithSignature(char *functionName, int numargs, Oid *argtypes);
 static Oid WorkerPartialAggOid(void);
-static Oid CoordCombineAggOid(void);
+static Oid WorkerPartialAggBinaryOid(void);
+static bool PartialAggregateStateIsBinary(Form_pg_aggregate aggform);
 static Oid AggregateFunctionOid(const char *functionName, Oid inputType);
 static Oid TypeOid(Oid schemaId, const char *typeName);
 static SortGroupClause * CreateSortGroupClause(Var *column);
@@ -286,6 +295,7 @@ static SortGroupClause * CreateSortGroupClause(Var *column);
 /* Local functions forward declarations for count(distinct) approximations */
 static const char * CountDistinctHashFunctionName(Oid argumentType);
 static int CountDistinctStorageSize(double approximationErrorRate);
+static bool UseNativeCountDistinctApproximation(void);
 static Const * MakeIntegerConstInt64(int64 integerValue);
 static Const * MakeIntegerConst(int32 integerValue);
 
@@ -1704,24 +1714,41 @@ MasterAggregateExpression(Aggref *originalAggregate,
 		 * If enabled, we check for count(distinct) approximations before count
 		 * distincts. For this, we first compute hll_add_agg(hll_hash(column)) on
 		 * worker nodes, and get hll values. We then gather hlls on the master
-		 * node, and compute hll_cardinality(hll_union_agg(hll)).
+		 * node, and compute hll_cardinality(hll_union_agg(hll)). Without the hll
+		 * extension, the built-in citus_hll_union_agg & citus_hll_cardinality
+		 * are used on the sketches that citus_hll_add_agg built on the workers.
 		 */
 		const int argCount = 1;
 		const int defaultTypeMod = -1;
+		Oid unionFunctionId = InvalidOid;
+		Oid cardinalityFunctionId = InvalidOid;
+		Oid hllType = InvalidOid;
 
+		if (UseNativeCountDistinctApproximation())
+		{
+			Oid sketchArgTypes[] = { BYTEAOID };
 
-		/* extract schema name of hll */
-		Oid hllId = get_extension_oid(HLL_EXTENSION_NAME, false);
-		Oid hllSchemaOid = get_extension_schema(hllId);
-		const char *hllSchemaName = get_namespace_name(hllSchemaOid);
+			unionFunctionId = CitusFunctionOidWithSignature(
+				CITUS_HLL_UNION_AGGREGATE_NAME, argCount, sketchArgTypes);
+			cardinalityFunctionId = CitusFunctionOidWithSignature(
+				CITUS_HLL_CARDINALITY_FUNC_NAME, argCount, sketchArgTypes);
+			hllType = BYTEAOID;
+		}
+		else
+		{
+			/* extract schema name of hll */
+			Oid hllId = get_extension_oid(HLL_EXTENSION_NAME, false);
+			Oid hllSchemaOid = get_extension_schema(hllId);
+			const char *hllSchemaName = get_namespace_name(hllSchemaOid);
 
-		Oid unionFunctionId = FunctionOid(hllSchemaName, HLL_UNION_AGGREGATE_NAME,
+			unionFunctionId = FunctionOid(hllSchemaName, HLL_UNION_AGGREGATE_NAME,
 										  argCount);
-		Oid cardinalityFunctionId = FunctionOid(hllSchemaName, HLL_CARDINALITY_FUNC_NAME,
-												argCount);
-		Oid cardinalityReturnType = get_func_rettype(cardinalityFunctionId);
+			cardinalityFunctionId = FunctionOid(hllSchemaName,
+												HLL_CARDINALITY_FUNC_NAME, argCount);
+			hllType = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
+		}
 
-		Oid hllType = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
+		Oid cardinalityReturnType = get_func_rettype(cardinalityFunctionId);
 		Oid hllTypeCollationId = get_typcollation(hllType);
 		Var *hllColumn = makeVar(masterTableId, walkerContext->columnId, hllType,
 								 defaultTypeMod,
@@ -2106,12 +2133,59 @@ MasterAggregateExpression(Aggref *originalAggregate,
 
 		newMasterExpression = (Expr *) unionAggregate;
 	}
+	else if (aggregateType == AGGREGATE_PERCENTILE_CONT_APPROXIMATE)
+	{
+		/*
+		 * If the original aggregate is an approximated percentile_cont(), we
+		 * gather the t-digest sketches that the workers built on the master
+		 * node, and compute citus_tdigest_percentile(citus_tdigest_union_agg(
+		 * sketch), fraction) with the fraction of the original aggregate.
+		 */
+		const int unionArgumentCount = 1;
+		const int percentileArgumentCount = 2;
+		const int defaultTypeMod = -1;
+		Expr *fractionExpression =
+			(Expr *) copyObject(linitial(originalAggregate->aggdirectargs));
+		Oid unionArgTypes[] = { BYTEAOID };
+		Oid percentileArgTypes[] = { BYTEAOID, exprType((Node *) fractionExpression) };
+
+		Oid unionFunctionId = CitusFunctionOidWithSignature(
+			CITUS_TDIGEST_UNION_AGGREGATE_NAME, unionArgumentCount, unionArgTypes);
+		Oid percentileFunctionId = CitusFunctionOidWithSignature(
+			CITUS_TDIGEST_PERCENTILE_FUNC_NAME, percentileArgumentCount,
+			percentileArgTypes);
+
+		Var *sketchColumn = makeVar(masterTableId, walkerContext->columnId, BYTEAOID,
+									defaultTypeMod, InvalidOid, columnLevelsUp);
+		walkerContext->columnId++;
+
+		TargetEntry *sketchTargetEntry = makeTargetEntry((Expr *) sketchColumn,
+														 argumentId, NULL, false);
+
+		Aggref *unionAggregate = makeNode(Aggref);
+		unionAggregate->aggfnoid = unionFunctionId;
+		unionAggregate->aggtype = BYTEAOID;
+		unionAggregate->args = list_make1(sketchTargetEntry);
+		unionAggregate->aggkind = AGGKIND_NORMAL;
+		unionAggregate->aggfilter = NULL;
+		unionAggregate->aggtranstype = InvalidOid;
+		unionAggregate->aggargtypes = list_make1_oid(BYTEAOID);
+		unionAggregate->aggsplit = AGGSPLIT_SIMPLE;
+
+		FuncExpr *percentileExpression = makeNode(FuncExpr);
+		percentileExpression->funcid = percentileFunctionId;
+		percentileExpression->funcresulttype = get_func_rettype(percentileFunctionId);
+		percentileExpression->args = list_make2(unionAggregate, fractionExpression);
+
+		newMasterExpression = (Expr *) percentileExpression;
+	}
 	else if (aggregateType == AGGREGATE_CUSTOM_COMBINE)
 	{
 		HeapTuple aggTuple =
 			SearchSysCache1(AGGFNOID, ObjectIdGetDatum(originalAggregate->aggfnoid));
 		Form_pg_aggregate aggform;
 		Oid combine;
+		bool binaryState = false;
 
 		if (!HeapTupleIsValid(aggTuple))
 		{
@@ -2123,13 +2197,15 @@ MasterAggregateExpression(Aggref *originalAggregate,
 		{
 			aggform = (Form_pg_aggregate) GETSTRUCT(aggTuple);
 			combine = aggform->aggcombinefn;
+			binaryState = PartialAggregateStateIsBinary(aggform);
 			ReleaseSysCache(aggTuple);
 		}
 
 		if (combine != InvalidOid)
 		{
-			Oid coordCombineId = CoordCombineAggOid();
-			Oid workerReturnType = CSTRINGOID;
+			Oid coordCombineId = binaryState ? CoordCombineAggBinaryOid() :
+								 CoordCombineAggOid();
+			Oid workerReturnType = binaryState ? BYTEAOID : CSTRINGOID;
 			int32 workerReturnTypeMod = -1;
 			Oid workerCollationId = InvalidOid;
 			Oid resultType = exprType((Node *) originalAggregate);
@@ -2148,7 +2224,7 @@ MasterAggregateExpression(Aggref *originalAggregate,
 						   makeTargetEntry((Expr *) column, 2, NULL, false),
 						   makeTargetEntry((Expr *) nullTag, 3, NULL, false));
 
-			/* coord_combine_agg(agg, workercol) */
+			/* coord_combine_agg(agg, workercol) or its binary equivalent */
 			Aggref *newMasterAggregate = makeNode(Aggref);
 			newMasterAggregate->aggfnoid = coordCombineId;
 			newMasterAggregate->aggtype = originalAggregate->aggtype;
@@ -2156,7 +2232,7 @@ MasterAggregateExpression(Aggref *originalAggregate,
 			newMasterAggregate->aggkind = AGGKIND_NORMAL;
 			newMasterAggregate->aggfilter = NULL;
 			newMasterAggregate->aggtranstype = INTERNALOID;
-			newMasterAggregate->aggargtypes = list_make3_oid(OIDOID, CSTRINGOID,
+			newMasterAggregate->aggargtypes = list_make3_oid(OIDOID, workerReturnType,
 															 resultType);
 			newMasterAggregate->aggsplit = AGGSPLIT_SIMPLE;
 
@@ -3111,44 +3187,63 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 	{
 		/*
 		 * If the original aggregate is a count(distinct) approximation, we want
-		 * to compute hll_add_agg(hll_hash(var), storageSize) on worker nodes.
+		 * to compute hll_add_agg(hll_hash(var), storageSize) on worker nodes, or
+		 * citus_hll_add_agg(var, storageSize) without the hll extension.
 		 */
 		const AttrNumber firstArgumentId = 1;
 		const AttrNumber secondArgumentId = 2;
 		const int hashArgumentCount = 2;
 		const int addArgumentCount = 2;
+		Expr *addArgumentExpression = NULL;
+		Oid addFunctionId = InvalidOid;
+		Oid hllType = InvalidOid;
 
 
 		/* init hll_hash() related variables */
 		Oid argumentType = AggregateArgumentType(originalAggregate);
 		TargetEntry *argument = (TargetEntry *) linitial(originalAggregate->args);
 		Expr *argumentExpression = copyObject(argument->expr);
+		int logOfStorageSize = CountDistinctStorageSize(CountDistinctErrorRate);
+		Const *logOfStorageSizeConst = MakeIntegerConst(logOfStorageSize);
 
-		/* extract schema name of hll */
-		Oid hllId = get_extension_oid(HLL_EXTENSION_NAME, false);
-		Oid hllSchemaOid = get_extension_schema(hllId);
-		const char *hllSchemaName = get_namespace_name(hllSchemaOid);
+		if (UseNativeCountDistinctApproximation())
+		{
+			Oid addArgTypes[] = { ANYELEMENTOID, INT4OID };
 
-		const char *hashFunctionName = CountDistinctHashFunctionName(argumentType);
-		Oid hashFunctionId = FunctionOid(hllSchemaName, hashFunctionName,
-										 hashArgumentCount);
-		Oid hashFunctionReturnType = get_func_rettype(hashFunctionId);
+			/* citus_hll_add_agg() hashes the values itself */
+			addFunctionId = CitusFunctionOidWithSignature(CITUS_HLL_ADD_AGGREGATE_NAME,
+														  addArgumentCount, addArgTypes);
+			addArgumentExpression = argumentExpression;
+			hllType = BYTEAOID;
+		}
+		else
+		{
+			/* extract schema name of hll */
+			Oid hllId = get_extension_oid(HLL_EXTENSION_NAME, false);
+			Oid hllSchemaOid = get_extension_schema(hllId);
+			const char *hllSchemaName = get_namespace_name(hllSchemaOid);
 
-		/* init hll_add_agg() related variables */
-		Oid addFunctionId = FunctionOid(hllSchemaName, HLL_ADD_AGGREGATE_NAME,
+			const char *hashFunctionName = CountDistinctHashFunctionName(argumentType);
+			Oid hashFunctionId = FunctionOid(hllSchemaName, hashFunctionName,
+											 hashArgumentCount);
+			Oid hashFunctionReturnType = get_func_rettype(hashFunctionId);
+
+			/* init hll_add_agg() related variables */
+			addFunctionId = FunctionOid(hllSchemaName, HLL_ADD_AGGREGATE_NAME,
 										addArgumentCount);
-		Oid hllType = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
-		int logOfStorageSize = CountDistinctStorageSize(CountDistinctErrorRate);
-		Const *logOfStorageSizeConst = MakeIntegerConst(logOfStorageSize);
+			hllType = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
+
+			/* construct hll_hash() expression */
+			FuncExpr *hashFunction = makeNode(FuncExpr);
+			hashFunction->funcid = hashFunctionId;
+			hashFunction->funcresulttype = hashFunctionReturnType;
+			hashFunction->args = list_make1(argumentExpression);
 
-		/* construct hll_hash() expression */
-		FuncExpr *hashFunction = makeNode(FuncExpr);
-		hashFunction->funcid = hashFunctionId;
-		hashFunction->funcresulttype = hashFunctionReturnType;
-		hashFunction->args = list_make1(argumentExpression);
+			addArgumentExpression = (Expr *) hashFunction;
+		}
 
 		/* construct hll_add_agg() expression */
-		TargetEntry *hashedColumnArgument = makeTargetEntry((Expr *) hashFunction,
+		TargetEntry *hashedColumnArgument = makeTargetEntry(addArgumentExpression,
 															firstArgumentId, NULL, false);
 		TargetEntry *storageSizeArgument = makeTargetEntry((Expr *) logOfStorageSizeConst,
 														   secondArgumentId, NULL, false);
@@ -3163,6 +3258,13 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 		addAggregateFunction->aggfilter = (Expr *) copyObject(
 			originalAggregate->aggfilter);
 
+		if (hllType == BYTEAOID)
+		{
+			/* the values are hashed using the collation of the argument */
+			addAggregateFunction->inputcollid = exprCollation((Node *) argumentExpression);
+			addAggregateFunction->aggargtypes = list_make2_oid(argumentType, INT4OID);
+		}
+
 		workerAggregateList = lappend(workerAggregateList, addAggregateFunction);
 	}
 	else if (aggregateType == AGGREGATE_AVERAGE)
@@ -3267,12 +3369,49 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 
 		workerAggregateList = lappend(workerAggregateList, newWorkerAggregate);
 	}
+	else if (aggregateType == AGGREGATE_PERCENTILE_CONT_APPROXIMATE)
+	{
+		/*
+		 * If the original aggregate is percentile_cont(fraction) WITHIN GROUP
+		 * (ORDER BY column), we want to compute citus_tdigest_add_agg(column,
+		 * compression) on worker nodes. The fraction is only needed on the
+		 * coordinator.
+		 */
+		const AttrNumber firstArgumentId = 1;
+		const AttrNumber secondArgumentId = 2;
+		const int addArgumentCount = 2;
+		Oid addArgTypes[] = { FLOAT8OID, INT4OID };
+
+		Expr *argumentExpression = copyObject(FirstAggregateArgument(originalAggregate));
+		Const *compressionConst = MakeIntegerConst(PercentileApproximationCompression);
+
+		TargetEntry *valueArgument = makeTargetEntry(argumentExpression, firstArgumentId,
+													 NULL, false);
+		TargetEntry *compressionArgument = makeTargetEntry((Expr *) compressionConst,
+														   secondArgumentId, NULL,
+														   false);
+
+		Aggref *addAggregateFunction = makeNode(Aggref);
+		addAggregateFunction->aggfnoid = CitusFunctionOidWithSignature(
+			CITUS_TDIGEST_ADD_AGGREGATE_NAME, addArgumentCount, addArgTypes);
+		addAggregateFunction->aggtype = BYTEAOID;
+		addAggregateFunction->args = list_make2(valueArgument, compressionArgument);
+		addAggregateFunction->aggkind = AGGKIND_NORMAL;
+		addAggregateFunction->aggfilter = (Expr *) copyObject(
+			originalAggregate->aggfilter);
+		addAggregateFunction->aggtranstype = InvalidOid;
+		addAggregateFunction->aggargtypes = list_make2_oid(FLOAT8OID, INT4OID);
+		addAggregateFunction->aggsplit = AGGSPLIT_SIMPLE;
+
+		workerAggregateList = lappend(workerAggregateList, addAggregateFunction);
+	}
 	else if (aggregateType == AGGREGATE_CUSTOM_COMBINE)
 	{
 		HeapTuple aggTuple =
 			SearchSysCache1(AGGFNOID, ObjectIdGetDatum(originalAggregate->aggfnoid));
 		Form_pg_aggregate aggform;
 		Oid combine;
+		bool binaryState = false;
 
 		if (!HeapTupleIsValid(aggTuple))
 		{
@@ -3284,12 +3423,14 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 		{
 			aggform = (Form_pg_aggregate) GETSTRUCT(aggTuple);
 			combine = aggform->aggcombinefn;
+			binaryState = PartialAggregateStateIsBinary(aggform);
 			ReleaseSysCache(aggTuple);
 		}
 
 		if (combine != InvalidOid)
 		{
-			Oid workerPartialId = WorkerPartialAggOid();
+			Oid workerPartialId = binaryState ? WorkerPartialAggBinaryOid() :
+								  WorkerPartialAggOid();
 
 			Const *aggOidParam = makeConst(REGPROCEDUREOID, -1, InvalidOid, sizeof(Oid),
 										   ObjectIdGetDatum(originalAggregate->aggfnoid),
@@ -3339,7 +3480,7 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 			/* worker_partial_agg(agg, arg) or worker_partial_agg(agg, ROW(...args)) */
 			Aggref *newWorkerAggregate = copyObject(originalAggregate);
 			newWorkerAggregate->aggfnoid = workerPartialId;
-			newWorkerAggregate->aggtype = CSTRINGOID;
+			newWorkerAggregate->aggtype = binaryState ? BYTEAOID : CSTRINGOID;
 			newWorkerAggregate->args = newWorkerAggregateArgs;
 			newWorkerAggregate->aggkind = AGGKIND_NORMAL;
 			newWorkerAggregate->aggtranstype = INTERNALOID;
@@ -3462,6 +3603,12 @@ GetAggregateType(Aggref *aggregateExpression)
 		}
 	}
 
+	if (PercentileApproximationCompression != DISABLE_PERCENTILE_APPROXIMATION &&
+		IsApproximablePercentileCont(aggregateExpression, aggregateProcName))
+	{
+		return AGGREGATE_PERCENTILE_CONT_APPROXIMATE;
+	}
+
 	/* handle any remaining built-in aggregates with a suitable combinefn */
 	if (AggregateEnabledCustom(aggregateExpression))
 	{
@@ -3546,6 +3693,20 @@ AggregateEnabledCustom(Aggref *aggregateExpression)
 
 	bool supportsSafeCombine = typeform->typtype != TYPTYPE_PSEUDO;
 
+	/*
+	 * Internal transition states of user-defined aggregates can be passed in
+	 * binary form using their serialfunc & deserialfunc. Their transition
+	 * functions are not called with the aggregate's expression, so we cannot
+	 * support polymorphic arguments.
+	 */
+	if (aggform->aggtranstype == INTERNALOID &&
+		aggform->aggserialfn != InvalidOid &&
+		aggform->aggdeserialfn != InvalidOid &&
+		aggregateOid >= FirstNormalObjectId)
+	{
+		supportsSafeCombine = !AggregateHasPolymorphicArguments(aggregateOid);
+	}
+
 	ReleaseSysCache(aggTuple);
 	ReleaseSysCache(typeTuple);
 
@@ -3553,6 +3714,103 @@ AggregateEnabledCustom(Aggref *aggregateExpression)
 }
 
 
+/*
+ * IsApproximablePercentileCont returns whether the given aggregate is the
+ * built-in percentile_cont(fraction) WITHIN GROUP (ORDER BY column) over double
+ * precision values, with one or an array of fractions, which we can compute
+ * using the built-in t-digest sketches. The fraction has to be computable on
+ * the coordinator, and the values have to be sorted in ascending order for the
+ * fraction to mean the same thing as in the sketch.
+ */
+static bool
+IsApproximablePercentileCont(Aggref *aggregateExpression, const char *aggregateProcName)
+{
+	if (aggregateExpression->aggfnoid >= FirstNormalObjectId ||
+		aggregateExpression->aggkind != AGGKIND_ORDERED_SET ||
+		strncmp(aggregateProcName, PERCENTILE_CONT_AGGREGATE_NAME, NAMEDATALEN) != 0)
+	{
+		return false;
+	}
+
+	if (list_length(aggregateExpression->args) != 1 ||
+		list_length(aggregateExpression->aggorder) != 1 ||
+		list_length(aggregateExpression->aggdirectargs) != 1)
+	{
+		return false;
+	}
+
+	Oid argumentType = exprType((Node *) FirstAggregateArgument(aggregateExpression));
+	if (argumentType != FLOAT8OID)
+	{
+		return false;
+	}
+
+	Node *fractionExpression = linitial(aggregateExpression->aggdirectargs);
+	Oid fractionType = exprType(fractionExpression);
+	if ((fractionType != FLOAT8OID && fractionType != FLOAT8ARRAYOID) ||
+		pull_var_clause_default(fractionExpression) != NIL)
+	{
+		return false;
+	}
+
+	SortGroupClause *sortClause = linitial(aggregateExpression->aggorder);
+	TypeCacheEntry *typeEntry = lookup_type_cache(FLOAT8OID, TYPECACHE_LT_OPR);
+
+	return sortClause->sortop == typeEntry->lt_opr;
+}
+
+
+/*
+ * AggregateHasPolymorphicArguments returns whether any of the declared
+ * arguments of the given aggregate has a polymorphic type.
+ */
+static bool
+AggregateHasPolymorphicArguments(Oid aggregateOid)
+{
+	Oid *argumentTypes = NULL;
+	int argumentCount = 0;
+
+	get_func_signature(aggregateOid, &argumentTypes, &argumentCount);
+
+	for (int argumentIndex = 0; argumentIndex < argumentCount; argumentIndex++)
+	{
+		if (IsPolymorphicType(argumentTypes[argumentIndex]))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * PartialAggregateStateIsBinary returns whether the transition state of the
+ * given aggregate can be passed from the workers to the coordinator in binary
+ * form, using worker_partial_agg_binary & coord_combine_agg_binary. That is
+ * the case for internal states, which AggregateEnabledCustom only allows with
+ * a serialfunc & deserialfunc, and for state types that are safe to send in
+ * binary form between nodes. Other states are passed in text form.
+ */
+static bool
+PartialAggregateStateIsBinary(Form_pg_aggregate aggform)
+{
+	if (aggform->aggtranstype == INTERNALOID)
+	{
+		return true;
+	}
+
+	/* array_recv checks the element type oid, which differs between nodes */
+	Oid elementType = get_element_type(aggform->aggtranstype);
+	if (elementType >= FirstNormalObjectId)
+	{
+		return false;
+	}
+
+	return CanUseBinaryCopyFormatForType(aggform->aggtranstype);
+}
+
+
 /*
  * AggregateFunctionOid performs a reverse lookup on aggregate function name,
  * and returns the corresponding aggregate function oid for the given function
@@ -3651,7 +3909,7 @@ WorkerPartialAggOid()
 /*
  * CoordCombineAggOid looks up oid of pg_catalog.coord_combine_agg
  */
-static Oid
+Oid
 CoordCombineAggOid()
 {
 	Oid argtypes[] = {
@@ -3664,6 +3922,39 @@ CoordCombineAggOid()
 }
 
 
+/*
+ * WorkerPartialAggBinaryOid looks up oid of pg_catalog.worker_partial_agg_binary
+ */
+static Oid
+WorkerPartialAggBinaryOid()
+{
+	Oid argtypes[] = {
+		OIDOID,
+		ANYELEMENTOID,
+	};
+
+	return CitusFunctionOidWithSignature(WORKER_PARTIAL_AGGREGATE_BINARY_NAME, 2,
+										 argtypes);
+}
+
+
+/*
+ * CoordCombineAggBinaryOid looks up oid of pg_catalog.coord_combine_agg_binary
+ */
+Oid
+CoordCombineAggBinaryOid()
+{
+	Oid argtypes[] = {
+		OIDOID,
+		BYTEAOID,
+		ANYELEMENTOID,
+	};
+
+	return CitusFunctionOidWithSignature(COORD_COMBINE_AGGREGATE_BINARY_NAME, 3,
+										 argtypes);
+}
+
+
 /*
  * TypeOid looks for a type that has the given name and schema, and returns the
  * corresponding type's oid.
@@ -4115,6 +4406,25 @@ DeferErrorIfUnsupportedAggregateDistinct(Aggref *aggregateExpression,
 		bool missingOK = true;
 		Oid distinctExtensionId = get_extension_oid(HLL_EXTENSION_NAME, missingOK);
 
+		/* the built-in sketches hash the values using extended hash functions */
+		if (UseNativeCountDistinctApproximation())
+		{
+			Oid argumentType = AggregateArgumentType(aggregateExpression);
+			TypeCacheEntry *typeEntry =
+				lookup_type_cache(argumentType, TYPECACHE_HASH_EXTENDED_PROC);
+
+			if (OidIsValid(typeEntry->hash_extended_proc))
+			{
+				return NULL;
+			}
+
+			return DeferredError(ERRCODE_FEATURE_NOT_SUPPORTED,
+								 "cannot compute count (distinct) approximation",
+								 psprintf("type %s cannot be hashed",
+										  format_type_be(argumentType)),
+								 NULL);
+		}
+
 		/* if extension for distinct approximation is loaded, we are good */
 		if (distinctExtensionId != InvalidOid)
 		{
@@ -4981,30 +5291,43 @@ HasOrderByComplexExpression(List *sortClauseList, List *targetList)
 
 /*
  * HasOrderByHllType walks over the given order by clauses, and checks if any of
- * those clauses operate on hll data type. If they do, the function returns true.
+ * those clauses operate on hll data type or on the built-in sketches. If they
+ * do, the function returns true.
  */
 static bool
 HasOrderByHllType(List *sortClauseList, List *targetList)
 {
 	bool hasOrderByHllType = false;
+	Oid hllTypeId = InvalidOid;
+	const int addArgumentCount = 2;
+	Oid addArgTypes[] = { ANYELEMENTOID, INT4OID };
+	Oid citusHllAddFunctionId =
+		CitusFunctionOidWithSignature(CITUS_HLL_ADD_AGGREGATE_NAME, addArgumentCount,
+									  addArgTypes);
 
 	/* check whether HLL is loaded */
 	Oid hllId = get_extension_oid(HLL_EXTENSION_NAME, true);
-	if (!OidIsValid(hllId))
+	if (OidIsValid(hllId))
 	{
-		return hasOrderByHllType;
+		Oid hllSchemaOid = get_extension_schema(hllId);
+		hllTypeId = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
 	}
 
-	Oid hllSchemaOid = get_extension_schema(hllId);
-	Oid hllTypeId = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
-
 	SortGroupClause *sortClause = NULL;
 	foreach_ptr(sortClause, sortClauseList)
 	{
 		Node *sortExpression = get_sortgroupclause_expr(sortClause, targetList);
 
 		Oid sortColumnTypeId = exprType(sortExpression);
-		if (sortColumnTypeId == hllTypeId)
+		if (OidIsValid(hllTypeId) && sortColumnTypeId == hllTypeId)
+		{
+			hasOrderByHllType = true;
+			break;
+		}
+
+		/* the built-in sketches are bytea, so match the aggregate itself */
+		if (IsA(sortExpression, Aggref) &&
+			((Aggref *) sortExpression)->aggfnoid == citusHllAddFunctionId)
 		{
 			hasOrderByHllType = true;
 			break;
@@ -5015,6 +5338,35 @@ HasOrderByHllType(List *sortClauseList, List *targetList)
 }
 
 
+/*
+ * UseNativeCountDistinctApproximation returns whether count(distinct)
+ * approximations use the built-in HyperLogLog sketches rather than the hll
+ * extension, based on citus.count_distinct_approximation_method.
+ */
+static bool
+UseNativeCountDistinctApproximation(void)
+{
+	switch (CountDistinctApproximationMethod)
+	{
+		case COUNT_DISTINCT_APPROXIMATION_HLL:
+		{
+			return false;
+		}
+
+		case COUNT_DISTINCT_APPROXIMATION_NATIVE:
+		{
+			return true;
+		}
+
+		default:
+		{
+			bool missingOK = true;
+			return !OidIsValid(get_extension_oid(HLL_EXTENSION_NAME, missingOK));
+		}
+	}
+}
+
+
 /*
  * ShouldProcessDistinctOrderAndLimitForWorker returns whether
  * ProcessDistinctClauseForWorkerQuery should be called. If not,
@@ -88,6 +88,8 @@ static List * MultiTableNodeList(List *tableEntryList, List *rangeTableList);
 static List * AddMultiCollectNodes(List *tableNodeList);
 static MultiNode * MultiJoinTree(List *joinOrderList, List *collectTableList,
 								 List *joinClauseList);
+static void SetPartitionDataSizes(MultiNode *joinNode, JoinOrderNode *leftJoinOrderNode,
+								  JoinOrderNode *rightJoinOrderNode);
 static MultiCollect * CollectNodeForTable(List *collectTableList, uint32 rangeTableId);
 static MultiSelect * MultiSelectNode(List *whereClauseList);
 static bool IsSelectClause(Node *clause);
@@ -677,7 +679,7 @@ MultiNodeTree(Query *queryTree)
 		collectTableList = AddMultiCollectNodes(tableNodeList);
 
 		/* find best join order for commutative inner joins */
-		joinOrderList = JoinOrderList(tableEntryList, joinClauseList);
+		joinOrderList = JoinOrderList(tableEntryList, joinClauseList, whereClauseList);
 
 		/* build join tree using the join order and collected tables */
 		joinTreeNode = MultiJoinTree(joinOrderList, collectTableList, joinClauseList);
@@ -1572,6 +1574,7 @@ static MultiNode *
 MultiJoinTree(List *joinOrderList, List *collectTableList, List *joinWhereClauseList)
 {
 	MultiNode *currentTopNode = NULL;
+	JoinOrderNode *previousJoinOrderNode = NULL;
 	ListCell *joinOrderCell = NULL;
 	bool firstJoinNode = true;
 
@@ -1603,9 +1606,17 @@ MultiJoinTree(List *joinOrderList, List *collectTableList, List *joinWhereClause
 												   joinType,
 												   joinClauseList);
 
+			if (EnableCostBasedJoinOrder)
+			{
+				SetPartitionDataSizes(newJoinNode, previousJoinOrderNode,
+									  joinOrderNode);
+			}
+
 			/* the new join node becomes the top of our join tree */
 			currentTopNode = newJoinNode;
 		}
+
+		previousJoinOrderNode = joinOrderNode;
 	}
 
 	/* current top node points to the entire left deep join tree */
@@ -1613,6 +1624,45 @@ MultiJoinTree(List *joinOrderList, List *collectTableList, List *joinWhereClause
 }
 
 
+/*
+ * SetPartitionDataSizes copies the estimated sizes of the two sides of a join
+ * from the join order into the partition nodes that repartition them, such that
+ * EXPLAIN can show how much data each repartitioning moves.
+ */
+static void
+SetPartitionDataSizes(MultiNode *joinNode, JoinOrderNode *leftJoinOrderNode,
+					  JoinOrderNode *rightJoinOrderNode)
+{
+	if (!CitusIsA(joinNode, MultiJoin))
+	{
+		return;
+	}
+
+	MultiBinaryNode *binaryNode = (MultiBinaryNode *) joinNode;
+	TableEntry *rightTable = rightJoinOrderNode->tableEntry;
+	double leftSize = leftJoinOrderNode->rowCount * leftJoinOrderNode->rowWidth;
+	double rightSize = rightTable->rowCount * rightTable->rowWidth;
+
+	if (CitusIsA(binaryNode->leftChildNode, MultiCollect))
+	{
+		MultiNode *childNode = ChildNode((MultiUnaryNode *) binaryNode->leftChildNode);
+		if (CitusIsA(childNode, MultiPartition))
+		{
+			((MultiPartition *) childNode)->estimatedDataSize = leftSize;
+		}
+	}
+
+	if (CitusIsA(binaryNode->rightChildNode, MultiCollect))
+	{
+		MultiNode *childNode = ChildNode((MultiUnaryNode *) binaryNode->rightChildNode);
+		if (CitusIsA(childNode, MultiPartition))
+		{
+			((MultiPartition *) childNode)->estimatedDataSize = rightSize;
+		}
+	}
+}
+
+
 /*
  * CollectNodeForTable finds the MultiCollect node whose MultiTable node has the
  * given range table identifier. Note that this function expects each collect
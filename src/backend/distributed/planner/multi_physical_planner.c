@@ -78,9 +78,12 @@
 #include "distributed/query_pushdown_planning.h"
 #include "distributed/query_utils.h"
 #include "distributed/recursive_planning.h"
+#include "distributed/repartitioned_aggregate.h"
 #include "distributed/shard_pruning.h"
 #include "distributed/shardinterval_utils.h"
+#include "distributed/shared_connection_stats.h"
 #include "distributed/string_utils.h"
+#include "distributed/utils/bloom_filter.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_manager.h"
 #include "distributed/worker_protocol.h"
@@ -88,11 +91,39 @@
 /* RepartitionJoinBucketCountPerNode determines bucket amount during repartitions */
 int RepartitionJoinBucketCountPerNode = 4;
 
+/*
+ * EnableRepartitionJoinBloomFilters determines whether inner dual partition
+ * joins filter one side by a bloom filter of the join keys of the other side,
+ * which is only built if that side has at most RepartitionJoinBloomFilterMaxRows
+ * rows.
+ */
+bool EnableRepartitionJoinBloomFilters = false;
+int RepartitionJoinBloomFilterMaxRows = 100000;
+
 /* Policy to use when assigning tasks to worker nodes */
 int TaskAssignmentPolicy = TASK_ASSIGNMENT_GREEDY;
 bool EnableUniqueJobIds = true;
 
 
+/*
+ * AdaptiveNodeLoad is the load of a node as seen by the adaptive task
+ * assignment policy while it assigns a list of tasks.
+ */
+typedef struct AdaptiveNodeLoad
+{
+	int32 nodeId;
+
+	/* load observed by all backends when the assignment started */
+	NodeTaskStats taskStats;
+
+	/* number of tasks of the current task list assigned to the node */
+	int assignedTaskCount;
+} AdaptiveNodeLoad;
+
+/* node loads used by AdaptiveAssignTaskList */
+static List *AdaptiveAssignmentNodeLoadList = NIL;
+
+
 /*
  * OperatorCache is used for caching operator identifiers for given typeId,
  * accessMethodId and strategyNumber. It is initialized to empty list as
@@ -168,13 +199,20 @@ static uint32 HashPartitionCount(void);
 static Job * BuildJobTreeTaskList(Job *jobTree,
 								  PlannerRestrictionContext *plannerRestrictionContext);
 static bool IsInnerTableOfOuterJoin(RelationRestriction *relationRestriction);
+static void SetJobShardPruningRestrictions(Job *job,
+										   RelationRestrictionContext *restrictionContext);
 static void ErrorIfUnsupportedShardDistribution(Query *query);
 static Task * QueryPushdownTaskCreate(Query *originalQuery, int shardIndex,
 									  RelationRestrictionContext *restrictionContext,
 									  uint32 taskId,
 									  TaskType taskType,
 									  bool modifyRequiresCoordinatorEvaluation,
+									  ShardQueryTemplate *queryTemplate,
+									  List *arraySplitList,
 									  DeferredErrorMessage **planningError);
+static bool TaskQueryStringRequired(TaskType taskType,
+									bool modifyRequiresCoordinatorEvaluation);
+static void MakeQueryQualsExplicit(Query *query);
 static List * SqlTaskList(Job *job);
 static bool DependsOnHashPartitionJob(Job *job);
 static uint32 AnchorRangeTableId(List *rangeTableList);
@@ -213,6 +251,10 @@ static Task * GreedyAssignTask(WorkerNode *workerNode, List *taskList,
 							   List *activeShardPlacementLists);
 static List * ReorderAndAssignTaskList(List *taskList,
 									   ReorderFunction reorderFunction);
+static List * AdaptiveReorderInTaskList(List *placementList);
+static List * AdaptiveReorderPlacements(List *placementList, List **nodeLoadList);
+static AdaptiveNodeLoad * FindOrLoadAdaptiveNodeLoad(List **nodeLoadList,
+													 ShardPlacement *placement);
 static int CompareTasksByShardId(const void *leftElement, const void *rightElement);
 static List * ActiveShardPlacementLists(List *taskList);
 static List * LeftRotateList(List *list, uint32 rotateCount);
@@ -223,6 +265,8 @@ static uint32 TaskListHighestTaskId(List *taskList);
 static List * MapTaskList(MapMergeJob *mapMergeJob, List *filterTaskList);
 static StringInfo CreateMapQueryString(MapMergeJob *mapMergeJob, Task *filterTask,
 									   uint32 partitionColumnIndex, bool useBinaryFormat);
+static Task * CreateBloomFilterTask(MapMergeJob *mapMergeJob, Task *filterTask,
+									uint32 partitionColumnIndex);
 static char * PartitionResultNamePrefix(uint64 jobId, int32 taskId);
 static char * PartitionResultName(uint64 jobId, uint32 taskId, uint32 partitionId);
 static ShardInterval ** RangeIntervalArrayWithNullBucket(ShardInterval **intervalArray,
@@ -267,6 +311,9 @@ CreatePhysicalDistributedPlan(MultiTreeRoot *multiTree,
 	distributedPlan->modLevel = ROW_MODIFY_READONLY;
 	distributedPlan->expectResults = true;
 
+	/* finalize groups on the workers if the coordinator would combine many groups */
+	PlanRepartitionedAggregate(distributedPlan);
+
 	return distributedPlan;
 }
 
@@ -359,6 +406,19 @@ BuildJobTree(MultiTreeRoot *multiTree)
 				partitionType = DUAL_HASH_PARTITION_TYPE;
 			}
 
+			/*
+			 * For inner joins between two repartitioned tables, rows without a
+			 * join partner on the other side can be filtered out before
+			 * repartitioning. We only do this for the first join, whose sides
+			 * do not depend on other jobs.
+			 */
+			bool buildBloomFilters = EnableRepartitionJoinBloomFilters &&
+									 partitionType == DUAL_HASH_PARTITION_TYPE &&
+									 joinNode->joinType == JOIN_INNER &&
+									 loopDependentJobList == NIL &&
+									 CitusIsA(leftChildNode, MultiPartition) &&
+									 CitusIsA(rightChildNode, MultiPartition);
+
 			if (CitusIsA(leftChildNode, MultiPartition))
 			{
 				MultiPartition *partitionNode = (MultiPartition *) leftChildNode;
@@ -373,6 +433,8 @@ BuildJobTree(MultiTreeRoot *multiTree)
 															partitionKey, partitionType,
 															baseRelationId,
 															JOIN_MAP_MERGE_JOB);
+				mapMergeJob->buildBloomFilter = buildBloomFilters;
+				mapMergeJob->estimatedDataSize = partitionNode->estimatedDataSize;
 
 				/* reset dependent job list */
 				loopDependentJobList = NIL;
@@ -394,6 +456,8 @@ BuildJobTree(MultiTreeRoot *multiTree)
 															partitionKey, partitionType,
 															baseRelationId,
 															JOIN_MAP_MERGE_JOB);
+				mapMergeJob->buildBloomFilter = buildBloomFilters;
+				mapMergeJob->estimatedDataSize = partitionNode->estimatedDataSize;
 
 				/* append to the dependent job list for on-going dependencies */
 				loopDependentJobList = lappend(loopDependentJobList, mapMergeJob);
@@ -2158,6 +2222,17 @@ BuildJobTreeTaskList(Job *jobTree, PlannerRestrictionContext *plannerRestriction
 		{
 			job->taskList = assignedSqlTaskList;
 		}
+
+		/*
+		 * When the job query still has parameters, remember how to prune the
+		 * task list once the parameter values are known.
+		 */
+		if (!job->parametersInJobQueryResolved && job->dependentJobList == NIL &&
+			!CitusIsA(job, MapMergeJob))
+		{
+			SetJobShardPruningRestrictions(job, plannerRestrictionContext->
+										   relationRestrictionContext);
+		}
 	}
 
 	return jobTree;
@@ -2259,22 +2334,62 @@ QueryPushdownSqlTaskList(Query *query, uint64 jobId,
 	 * identify the end of the bitmapset.
 	 */
 	int shardOffset = minShardOffset - 1;
-	while ((shardOffset = bms_next_member(taskRequiredForShardIndex, shardOffset)) >= 0)
-	{
-		Task *subqueryTask = QueryPushdownTaskCreate(query, shardOffset,
-													 relationRestrictionContext,
-													 taskIdIndex,
-													 taskType,
-													 modifyRequiresCoordinatorEvaluation,
-													 planningError);
-		if (*planningError != NULL)
+
+	/*
+	 * When there are multiple tasks, each task only needs the values of
+	 * partition column IN lists that hash into its shards.
+	 */
+	List *arraySplitList = NIL;
+	if (bms_num_members(taskRequiredForShardIndex) > 1 &&
+		TaskQueryStringRequired(taskType, modifyRequiresCoordinatorEvaluation))
+	{
+		arraySplitList = SplitPartitionKeyArraysByShard(query);
+	}
+
+	/*
+	 * Otherwise, the query strings only differ in the shard names, so we
+	 * deparse the query once and fill in the shard names for each task.
+	 */
+	ShardQueryTemplate *queryTemplate = NULL;
+	if (bms_num_members(taskRequiredForShardIndex) > 1 && arraySplitList == NIL &&
+		TaskQueryStringRequired(taskType, modifyRequiresCoordinatorEvaluation))
+	{
+		Query *templateQuery = copyObject(query);
+		MakeQueryQualsExplicit(templateQuery);
+
+		queryTemplate = DeparseShardQueryTemplate(templateQuery);
+	}
+
+	/* the arrays are restricted in the query itself, so always put them back */
+	PG_TRY();
+	{
+		while ((shardOffset = bms_next_member(taskRequiredForShardIndex,
+											  shardOffset)) >= 0)
 		{
-			return NIL;
+			Task *subqueryTask =
+				QueryPushdownTaskCreate(query, shardOffset, relationRestrictionContext,
+										taskIdIndex, taskType,
+										modifyRequiresCoordinatorEvaluation,
+										queryTemplate, arraySplitList, planningError);
+			if (*planningError != NULL)
+			{
+				break;
+			}
+			subqueryTask->jobId = jobId;
+			sqlTaskList = lappend(sqlTaskList, subqueryTask);
+
+			++taskIdIndex;
 		}
-		subqueryTask->jobId = jobId;
-		sqlTaskList = lappend(sqlTaskList, subqueryTask);
+	}
+	PG_FINALLY();
+	{
+		ResetPartitionKeyArrays(arraySplitList);
+	}
+	PG_END_TRY();
 
-		++taskIdIndex;
+	if (*planningError != NULL)
+	{
+		return NIL;
 	}
 
 	/* If it is a modify task with multiple tables */
@@ -2293,6 +2408,68 @@ QueryPushdownSqlTaskList(Query *query, uint64 jobId,
 }
 
 
+/*
+ * SetJobShardPruningRestrictions records the restrictions of the distributed
+ * tables in the given job, such that the task list can be pruned at execution
+ * time using the parameter values. It mirrors QueryPushdownSqlTaskList: a task
+ * is needed if the shard of any distributed table that is not on the inner
+ * side of an outer join remains after pruning. For jobs created through
+ * SqlTaskList this may keep more tasks than necessary, but never fewer, since
+ * the task queries contain all restrictions.
+ *
+ * Nothing is recorded if none of the restrictions contain parameters, because
+ * pruning would then give the same result as during planning.
+ */
+static void
+SetJobShardPruningRestrictions(Job *job, RelationRestrictionContext *restrictionContext)
+{
+	List *relationIdList = NIL;
+	List *rangeTableIdList = NIL;
+	List *restrictionList = NIL;
+	bool restrictionsHaveParams = false;
+
+	RelationRestriction *relationRestriction = NULL;
+	foreach_ptr(relationRestriction, restrictionContext->relationRestrictionList)
+	{
+		Oid relationId = relationRestriction->relationId;
+
+		if (!IsCitusTable(relationId) ||
+			!HasDistributionKey(relationId) ||
+			IsInnerTableOfOuterJoin(relationRestriction))
+		{
+			continue;
+		}
+
+		/* all shards are pruned regardless of the parameters */
+		if (JoinConditionIsOnFalse(relationRestriction->relOptInfo->joininfo))
+		{
+			continue;
+		}
+
+		List *baseRestrictionList = relationRestriction->relOptInfo->baserestrictinfo;
+		List *restrictClauseList = get_all_actual_clauses(baseRestrictionList);
+
+		if (HasUnresolvedExternParamsWalker((Node *) restrictClauseList, NULL))
+		{
+			restrictionsHaveParams = true;
+		}
+
+		relationIdList = lappend_oid(relationIdList, relationId);
+		rangeTableIdList = lappend_int(rangeTableIdList, relationRestriction->index);
+		restrictionList = lappend(restrictionList, copyObject(restrictClauseList));
+	}
+
+	if (!restrictionsHaveParams)
+	{
+		return;
+	}
+
+	job->shardPruningRelationIdList = relationIdList;
+	job->shardPruningRangeTableIdList = rangeTableIdList;
+	job->shardPruningRestrictionList = restrictionList;
+}
+
+
 /*
  * IsInnerTableOfOuterJoin tests based on the join information envoded in a
  * RelationRestriction if the table accessed for this relation is
@@ -2431,19 +2608,52 @@ ErrorIfUnsupportedShardDistribution(Query *query)
 }
 
 
+/*
+ * TaskQueryStringRequired returns whether the query string of a query pushdown
+ * task is generated during planning.
+ */
+static bool
+TaskQueryStringRequired(TaskType taskType, bool modifyRequiresCoordinatorEvaluation)
+{
+	return (taskType == MODIFY_TASK && !modifyRequiresCoordinatorEvaluation) ||
+		   taskType == READ_TASK;
+}
+
+
+/*
+ * MakeQueryQualsExplicit makes the top-level ands in the WHERE clause of the
+ * query explicit again.
+ *
+ * Ands are made implicit during shard pruning, as predicate comparison and
+ * refutation depend on it being so. We need to make them explicit again so
+ * that the query string is generated as (...) AND (...) as opposed to
+ * (...), (...).
+ */
+static void
+MakeQueryQualsExplicit(Query *query)
+{
+	if (query->jointree->quals != NULL && IsA(query->jointree->quals, List))
+	{
+		query->jointree->quals = (Node *) make_ands_explicit(
+			(List *) query->jointree->quals);
+	}
+}
+
+
 /*
  * SubqueryTaskCreate creates a sql task by replacing the target
- * shardInterval's boundary value.
+ * shardInterval's boundary value. If a query template is given, the query
+ * string is generated from the template rather than deparsed. Partition
+ * column arrays in the given split list are restricted to the values of the
+ * task's shards.
  */
 static Task *
 QueryPushdownTaskCreate(Query *originalQuery, int shardIndex,
 						RelationRestrictionContext *restrictionContext, uint32 taskId,
 						TaskType taskType, bool modifyRequiresCoordinatorEvaluation,
+						ShardQueryTemplate *queryTemplate, List *arraySplitList,
 						DeferredErrorMessage **planningError)
 {
-	Query *taskQuery = copyObject(originalQuery);
-
-	StringInfo queryString = makeStringInfo();
 	ListCell *restrictionCell = NULL;
 	List *taskShardList = NIL;
 	List *relationShardList = NIL;
@@ -2526,32 +2736,37 @@ QueryPushdownTaskCreate(Query *originalQuery, int shardIndex,
 		return NULL;
 	}
 
-	/*
-	 * Augment the relations in the query with the shard IDs.
-	 */
-	UpdateRelationToShardNames((Node *) taskQuery, relationShardList);
+	Task *subqueryTask = CreateBasicTask(jobId, taskId, taskType, NULL);
 
-	/*
-	 * Ands are made implicit during shard pruning, as predicate comparison and
-	 * refutation depend on it being so. We need to make them explicit again so
-	 * that the query string is generated as (...) AND (...) as opposed to
-	 * (...), (...).
-	 */
-	if (taskQuery->jointree->quals != NULL && IsA(taskQuery->jointree->quals, List))
+	if (TaskQueryStringRequired(taskType, modifyRequiresCoordinatorEvaluation))
 	{
-		taskQuery->jointree->quals = (Node *) make_ands_explicit(
-			(List *) taskQuery->jointree->quals);
-	}
+		char *queryString = NULL;
 
-	Task *subqueryTask = CreateBasicTask(jobId, taskId, taskType, NULL);
+		if (queryTemplate != NULL)
+		{
+			queryString = InstantiateShardQueryTemplate(queryTemplate,
+														relationShardList);
+		}
 
-	if ((taskType == MODIFY_TASK && !modifyRequiresCoordinatorEvaluation) ||
-		taskType == READ_TASK)
-	{
-		pg_get_query_def(taskQuery, queryString);
-		ereport(DEBUG4, (errmsg("distributed statement: %s",
-								queryString->data)));
-		SetTaskQueryString(subqueryTask, queryString->data);
+		if (queryString == NULL)
+		{
+			RestrictPartitionKeyArraysToShards(arraySplitList, relationShardList);
+
+			Query *taskQuery = copyObject(originalQuery);
+
+			/*
+			 * Augment the relations in the query with the shard IDs.
+			 */
+			UpdateRelationToShardNames((Node *) taskQuery, relationShardList);
+			MakeQueryQualsExplicit(taskQuery);
+
+			StringInfo queryStringInfo = makeStringInfo();
+			pg_get_query_def(taskQuery, queryStringInfo);
+			queryString = queryStringInfo->data;
+		}
+
+		ereport(DEBUG4, (errmsg("distributed statement: %s", queryString)));
+		SetTaskQueryString(subqueryTask, queryString);
 	}
 
 	subqueryTask->dependentTaskList = NULL;
@@ -4313,6 +4528,16 @@ MapTaskList(MapMergeJob *mapMergeJob, List *filterTaskList)
 	foreach(filterTaskCell, filterTaskList)
 	{
 		Task *filterTask = (Task *) lfirst(filterTaskCell);
+
+		if (mapMergeJob->buildBloomFilter)
+		{
+			Task *bloomFilterTask = CreateBloomFilterTask(mapMergeJob, filterTask,
+														  partitionColumnResNo);
+
+			mapMergeJob->bloomFilterTaskList =
+				lappend(mapMergeJob->bloomFilterTaskList, bloomFilterTask);
+		}
+
 		StringInfo mapQueryString = CreateMapQueryString(mapMergeJob, filterTask,
 														 partitionColumnResNo,
 														 useBinaryFormat);
@@ -4437,7 +4662,7 @@ CreateMapQueryString(MapMergeJob *mapMergeJob, Task *filterTask,
 					 ", %s || '_' || partition_index::text "
 					 ", rows_written "
 					 "FROM pg_catalog.worker_partition_query_result"
-					 "(%s,%s,%d,%s,%s,%s,%s,%s,%s) WHERE rows_written > 0",
+					 "(%s,%s,%d,%s,%s,%s,%s,%s,%s" MAP_TASK_QUERY_SUFFIX,
 					 quote_literal_cstr(resultNamePrefix),
 					 quote_literal_cstr(resultNamePrefix),
 					 quote_literal_cstr(filterQueryString),
@@ -4453,6 +4678,38 @@ CreateMapQueryString(MapMergeJob *mapMergeJob, Task *filterTask,
 }
 
 
+/*
+ * CreateBloomFilterTask returns a task that builds a bloom filter of the
+ * partition column values of the given filter task on the worker. The task
+ * returns the job ID along with the filter, or NULL if the filter task
+ * returns more than citus.repartition_join_bloom_filter_max_rows rows.
+ */
+static Task *
+CreateBloomFilterTask(MapMergeJob *mapMergeJob, Task *filterTask,
+					  uint32 partitionColumnIndex)
+{
+	Task *bloomFilterTask = copyObject(filterTask);
+	StringInfo bloomFilterQueryString = makeStringInfo();
+	char *filterQueryString = TaskQueryString(filterTask);
+	int64 bitCount = (int64) RepartitionJoinBloomFilterMaxRows *
+					 BLOOM_FILTER_BITS_PER_ELEMENT;
+
+	appendStringInfo(bloomFilterQueryString,
+					 "SELECT " UINT64_FORMAT "::bigint, "
+					 "pg_catalog.worker_build_bloom_filter(%s,%d," INT64_FORMAT ",%d,%d)",
+					 mapMergeJob->job.jobId,
+					 quote_literal_cstr(filterQueryString),
+					 partitionColumnIndex - 1,
+					 bitCount,
+					 BLOOM_FILTER_HASH_COUNT,
+					 RepartitionJoinBloomFilterMaxRows);
+
+	SetTaskQueryString(bloomFilterTask, bloomFilterQueryString->data);
+
+	return bloomFilterTask;
+}
+
+
 /*
  * PartitionResultNamePrefix returns the prefix we use for worker_partition_query_result
  * results. Each result will have a _<partition index> suffix.
@@ -5025,6 +5282,10 @@ AssignAnchorShardTaskList(List *taskList)
 	{
 		assignedTaskList = RoundRobinAssignTaskList(taskList);
 	}
+	else if (TaskAssignmentPolicy == TASK_ASSIGNMENT_ADAPTIVE)
+	{
+		assignedTaskList = AdaptiveAssignTaskList(taskList);
+	}
 
 	Assert(assignedTaskList != NIL);
 	return assignedTaskList;
@@ -5239,6 +5500,161 @@ RoundRobinReorder(List *placementList)
 }
 
 
+/*
+ * AdaptiveAssignTaskList assigns each task to the placement on the node with
+ * the lowest expected task latency, based on the moving averages of task
+ * execution times and the number of running tasks that backends keep in
+ * shared memory. Tasks that are assigned to a node earlier in the same task
+ * list count towards its load, such that the tasks of a single query are
+ * spread over the replicas rather than all sent to the fastest node.
+ */
+List *
+AdaptiveAssignTaskList(List *taskList)
+{
+	AdaptiveAssignmentNodeLoadList = NIL;
+
+	taskList = ReorderAndAssignTaskList(taskList, AdaptiveReorderInTaskList);
+
+	AdaptiveAssignmentNodeLoadList = NIL;
+
+	return taskList;
+}
+
+
+/*
+ * AdaptiveReorder returns a copy of the placement list in which the placement
+ * on the node with the lowest expected task latency comes first.
+ */
+List *
+AdaptiveReorder(List *placementList)
+{
+	List *nodeLoadList = NIL;
+
+	return AdaptiveReorderPlacements(placementList, &nodeLoadList);
+}
+
+
+/*
+ * AdaptiveReorderInTaskList is the ReorderFunction of AdaptiveAssignTaskList,
+ * which keeps the node loads across the tasks of the task list.
+ */
+static List *
+AdaptiveReorderInTaskList(List *placementList)
+{
+	return AdaptiveReorderPlacements(placementList, &AdaptiveAssignmentNodeLoadList);
+}
+
+
+/*
+ * AdaptiveReorderPlacements moves the placement on the node with the lowest
+ * expected task latency to the front of a copy of the placement list, and
+ * counts the task towards the load of that node in nodeLoadList.
+ *
+ * The expected latency of a node is its average task execution time times the
+ * number of tasks that would be running on it. Nodes without recent task
+ * executions are assumed to be as fast as the average of the other nodes,
+ * such that they are tried again after a slow period. Ties keep the original
+ * placement order.
+ */
+static List *
+AdaptiveReorderPlacements(List *placementList, List **nodeLoadList)
+{
+	int placementCount = list_length(placementList);
+	if (placementCount < 2)
+	{
+		return placementList;
+	}
+
+	AdaptiveNodeLoad **placementLoads = palloc0(placementCount *
+												sizeof(AdaptiveNodeLoad *));
+	double totalTaskTime = 0.0;
+	int timedNodeCount = 0;
+
+	int placementIndex = 0;
+	ShardPlacement *placement = NULL;
+	foreach_ptr(placement, placementList)
+	{
+		AdaptiveNodeLoad *nodeLoad = FindOrLoadAdaptiveNodeLoad(nodeLoadList,
+																placement);
+		if (nodeLoad->taskStats.hasRecentTaskTime)
+		{
+			totalTaskTime += nodeLoad->taskStats.averageTaskTimeMicrosecs;
+			timedNodeCount++;
+		}
+
+		placementLoads[placementIndex++] = nodeLoad;
+	}
+
+	double defaultTaskTime = 1.0;
+	if (timedNodeCount > 0)
+	{
+		defaultTaskTime = Max(totalTaskTime / timedNodeCount, defaultTaskTime);
+	}
+
+	int bestPlacementIndex = 0;
+	double bestExpectedLatency = 0.0;
+
+	for (placementIndex = 0; placementIndex < placementCount; placementIndex++)
+	{
+		AdaptiveNodeLoad *nodeLoad = placementLoads[placementIndex];
+		double taskTime = defaultTaskTime;
+
+		if (nodeLoad->taskStats.hasRecentTaskTime)
+		{
+			taskTime = Max(nodeLoad->taskStats.averageTaskTimeMicrosecs, 1.0);
+		}
+
+		double expectedLatency = taskTime * (1 + nodeLoad->taskStats.inFlightTaskCount +
+											 nodeLoad->assignedTaskCount);
+
+		if (placementIndex == 0 || expectedLatency < bestExpectedLatency)
+		{
+			bestPlacementIndex = placementIndex;
+			bestExpectedLatency = expectedLatency;
+		}
+	}
+
+	placementLoads[bestPlacementIndex]->assignedTaskCount++;
+
+	List *reorderedPlacementList = list_copy(placementList);
+	ShardPlacement *bestPlacement = list_nth(reorderedPlacementList,
+											 bestPlacementIndex);
+
+	reorderedPlacementList = list_delete_nth_cell(reorderedPlacementList,
+												  bestPlacementIndex);
+	reorderedPlacementList = lcons(bestPlacement, reorderedPlacementList);
+
+	return reorderedPlacementList;
+}
+
+
+/*
+ * FindOrLoadAdaptiveNodeLoad returns the load of the node of the given
+ * placement from nodeLoadList, and reads it from shared memory if it is not
+ * in the list yet.
+ */
+static AdaptiveNodeLoad *
+FindOrLoadAdaptiveNodeLoad(List **nodeLoadList, ShardPlacement *placement)
+{
+	AdaptiveNodeLoad *nodeLoad = NULL;
+	foreach_ptr(nodeLoad, *nodeLoadList)
+	{
+		if (nodeLoad->nodeId == placement->nodeId)
+		{
+			return nodeLoad;
+		}
+	}
+
+	nodeLoad = palloc0(sizeof(AdaptiveNodeLoad));
+	nodeLoad->nodeId = placement->nodeId;
+	GetNodeTaskStats(placement->nodeName, placement->nodePort, &nodeLoad->taskStats);
+
+	*nodeLoadList = lappend(*nodeLoadList, nodeLoad);
+
+	return nodeLoad;
+}
+
+
 /*
  * ReorderAndAssignTaskList finds the placements for a task based on its anchor
  * shard id and then sorts them by insertion time. If reorderFunction is given,
@@ -2013,6 +2013,8 @@ GenerateSingleShardRouterTaskList(Job *job, List *relationShardList,
  *
  * Supported Types
  * - TASK_ASSIGNMENT_ROUND_ROBIN round robin schedule queries among placements
+ * - TASK_ASSIGNMENT_ADAPTIVE schedule queries on the placement with the lowest
+ *   expected latency
  *
  * By default it does not reorder the task list, implying a first-replica strategy.
  */
@@ -2048,6 +2050,24 @@ ReorderTaskPlacementsByTaskAssignmentPolicy(Job *job,
 		List *reorderedPlacementList = RoundRobinReorder(placementList);
 		task->taskPlacementList = reorderedPlacementList;
 
+		ShardPlacement *primaryPlacement = (ShardPlacement *) linitial(
+			reorderedPlacementList);
+		ereport(DEBUG3, (errmsg("assigned task %u to node %s:%u", task->taskId,
+								primaryPlacement->nodeName,
+								primaryPlacement->nodePort)));
+	}
+	else if (taskAssignmentPolicy == TASK_ASSIGNMENT_ADAPTIVE)
+	{
+		Assert(list_length(job->taskList) == 1);
+		Task *task = (Task *) linitial(job->taskList);
+
+		/* same as for round-robin, we want to spread the load over the workers */
+		Assert(ReadOnlyTask(task->taskType));
+		placementList = RemoveCoordinatorPlacementIfNotSingleNode(placementList);
+
+		List *reorderedPlacementList = AdaptiveReorder(placementList);
+		task->taskPlacementList = reorderedPlacementList;
+
 		ShardPlacement *primaryPlacement = (ShardPlacement *) linitial(
 			reorderedPlacementList);
 		ereport(DEBUG3, (errmsg("assigned task %u to node %s:%u", task->taskId,
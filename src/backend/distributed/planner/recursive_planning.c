@@ -103,9 +103,23 @@ struct RecursivePlanningContextInternal
 	uint64 planId;
 	bool allDistributionKeysInQueryAreEqual; /* used for some optimizations */
 	List *subPlanList;
+	List *plannedSubqueryList;
 	PlannerRestrictionContext *plannerRestrictionContext;
 };
 
+/*
+ * PlannedSubquery is a subquery or CTE for which a subplan was generated,
+ * kept such that structurally identical subqueries can read its result.
+ */
+typedef struct PlannedSubquery
+{
+	Query *query;
+	uint32 subPlanId;
+} PlannedSubquery;
+
+/* controlled via GUC, share subplans among identical subqueries and CTEs */
+bool EnableCommonSubplanElimination = false;
+
 /* track depth of current recursive planner query */
 static int recursivePlanningDepth = 0;
 
@@ -175,6 +189,11 @@ static bool RecursivelyPlanSubquery(Query *subquery,
 static void RecursivelyPlanSetOperations(Query *query, Node *node,
 										 RecursivePlanningContext *context);
 static bool IsLocalTableRteOrMatView(Node *node);
+static uint32 FindEquivalentSubPlanId(Query *subquery,
+									  RecursivePlanningContext *planningContext);
+static void RememberPlannedSubquery(Query *subquery, uint32 subPlanId,
+									RecursivePlanningContext *planningContext);
+static bool CanShareSubPlan(Query *subquery);
 static DistributedSubPlan * CreateDistributedSubPlan(uint32 subPlanId,
 													 Query *subPlanQuery);
 static bool CteReferenceListWalker(Node *node, CteReferenceWalkerContext *context);
@@ -215,6 +234,7 @@ GenerateSubplansForSubqueriesAndCTEs(uint64 planId, Query *originalQuery,
 	context.level = 0;
 	context.planId = planId;
 	context.subPlanList = NIL;
+	context.plannedSubqueryList = NIL;
 	context.plannerRestrictionContext = plannerRestrictionContext;
 
 	/*
@@ -1133,21 +1153,34 @@ RecursivelyPlanCTEs(Query *query, RecursivePlanningContext *planningContext)
 			continue;
 		}
 
-		uint32 subPlanId = list_length(planningContext->subPlanList) + 1;
-
-		if (IsLoggableLevel(DEBUG1))
+		uint32 subPlanId = FindEquivalentSubPlanId(subquery, planningContext);
+		if (subPlanId != 0)
 		{
-			StringInfo subPlanString = makeStringInfo();
-			pg_get_query_def(subquery, subPlanString);
-			ereport(DEBUG1, (errmsg("generating subplan " UINT64_FORMAT
-									"_%u for CTE %s: %s", planId, subPlanId,
-									cteName,
-									subPlanString->data)));
+			ereport(DEBUG1, (errmsg("reusing subplan " UINT64_FORMAT "_%u for CTE %s",
+									planId, subPlanId, cteName)));
 		}
+		else
+		{
+			subPlanId = list_length(planningContext->subPlanList) + 1;
 
-		/* build a sub plan for the CTE */
-		DistributedSubPlan *subPlan = CreateDistributedSubPlan(subPlanId, subquery);
-		planningContext->subPlanList = lappend(planningContext->subPlanList, subPlan);
+			if (IsLoggableLevel(DEBUG1))
+			{
+				StringInfo subPlanString = makeStringInfo();
+				pg_get_query_def(subquery, subPlanString);
+				ereport(DEBUG1, (errmsg("generating subplan " UINT64_FORMAT
+										"_%u for CTE %s: %s", planId, subPlanId,
+										cteName,
+										subPlanString->data)));
+			}
+
+			/* remember the CTE before the planner scribbles on it */
+			RememberPlannedSubquery(subquery, subPlanId, planningContext);
+
+			/* build a sub plan for the CTE */
+			DistributedSubPlan *subPlan = CreateDistributedSubPlan(subPlanId, subquery);
+			planningContext->subPlanList = lappend(planningContext->subPlanList,
+												   subPlan);
+		}
 
 		/* build the result_id parameter for the call to read_intermediate_result */
 		char *resultId = GenerateResultId(planId, subPlanId);
@@ -1534,14 +1567,25 @@ RecursivelyPlanSubquery(Query *subquery, RecursivePlanningContext *planningConte
 		debugQuery = copyObject(subquery);
 	}
 
-
 	/*
-	 * Create the subplan and append it to the list in the planning context.
+	 * If an identical subquery was already planned, read its result instead of
+	 * executing and broadcasting the same subquery again.
 	 */
-	int subPlanId = list_length(planningContext->subPlanList) + 1;
+	uint32 subPlanId = FindEquivalentSubPlanId(subquery, planningContext);
+	bool reusedSubPlan = subPlanId != 0;
+
+	if (!reusedSubPlan)
+	{
+		/*
+		 * Create the subplan and append it to the list in the planning context.
+		 */
+		subPlanId = list_length(planningContext->subPlanList) + 1;
+
+		RememberPlannedSubquery(subquery, subPlanId, planningContext);
 
-	DistributedSubPlan *subPlan = CreateDistributedSubPlan(subPlanId, subquery);
-	planningContext->subPlanList = lappend(planningContext->subPlanList, subPlan);
+		DistributedSubPlan *subPlan = CreateDistributedSubPlan(subPlanId, subquery);
+		planningContext->subPlanList = lappend(planningContext->subPlanList, subPlan);
+	}
 
 	/* build the result_id parameter for the call to read_intermediate_result */
 	char *resultId = GenerateResultId(planId, subPlanId);
@@ -1558,9 +1602,18 @@ RecursivelyPlanSubquery(Query *subquery, RecursivePlanningContext *planningConte
 
 		pg_get_query_def(debugQuery, subqueryString);
 
-		ereport(DEBUG1, (errmsg("generating subplan " UINT64_FORMAT
-								"_%u for subquery %s", planId, subPlanId,
-								subqueryString->data)));
+		if (reusedSubPlan)
+		{
+			ereport(DEBUG1, (errmsg("reusing subplan " UINT64_FORMAT
+									"_%u for subquery %s", planId, subPlanId,
+									subqueryString->data)));
+		}
+		else
+		{
+			ereport(DEBUG1, (errmsg("generating subplan " UINT64_FORMAT
+									"_%u for subquery %s", planId, subPlanId,
+									subqueryString->data)));
+		}
 	}
 
 	/* finally update the input subquery to point the result query */
@@ -1569,6 +1622,75 @@ RecursivelyPlanSubquery(Query *subquery, RecursivePlanningContext *planningConte
 }
 
 
+/*
+ * FindEquivalentSubPlanId returns the ID of a subplan that was generated in
+ * the current planning context for a subquery or CTE that is structurally
+ * identical to the given subquery, or 0 if there is none.
+ *
+ * Identical subqueries are common in generated SQL, and sharing the subplan
+ * means that the subquery is only executed and broadcast once. Subqueries
+ * that use different aliases for the same tables are not considered
+ * identical.
+ */
+static uint32
+FindEquivalentSubPlanId(Query *subquery, RecursivePlanningContext *planningContext)
+{
+	if (!EnableCommonSubplanElimination || !CanShareSubPlan(subquery))
+	{
+		return 0;
+	}
+
+	PlannedSubquery *plannedSubquery = NULL;
+	foreach_ptr(plannedSubquery, planningContext->plannedSubqueryList)
+	{
+		if (equal(plannedSubquery->query, subquery))
+		{
+			return plannedSubquery->subPlanId;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * RememberPlannedSubquery keeps a copy of a subquery for which we are about to
+ * generate a subplan, such that FindEquivalentSubPlanId can find it. We need a
+ * copy since the planner modifies the query.
+ */
+static void
+RememberPlannedSubquery(Query *subquery, uint32 subPlanId,
+						RecursivePlanningContext *planningContext)
+{
+	if (!EnableCommonSubplanElimination || !CanShareSubPlan(subquery))
+	{
+		return;
+	}
+
+	PlannedSubquery *plannedSubquery = palloc0(sizeof(PlannedSubquery));
+	plannedSubquery->query = copyObject(subquery);
+	plannedSubquery->subPlanId = subPlanId;
+
+	planningContext->plannedSubqueryList =
+		lappend(planningContext->plannedSubqueryList, plannedSubquery);
+}
+
+
+/*
+ * CanShareSubPlan returns whether the result of the given subquery can be
+ * used in place of another execution of the same subquery. Modifications and
+ * row locks have side effects, and volatile functions may give different
+ * results on every execution.
+ */
+static bool
+CanShareSubPlan(Query *subquery)
+{
+	return subquery->commandType == CMD_SELECT &&
+		   subquery->rowMarks == NIL &&
+		   !contain_volatile_functions((Node *) subquery);
+}
+
+
 /*
  * CreateDistributedSubPlan creates a distributed subplan by recursively calling
  * the planner from the top, which may either generate a local plan or another
@@ -0,0 +1,383 @@
+/*-------------------------------------------------------------------------
+ *
+ * repartitioned_aggregate_planner.c
+ *   Planning of aggregations of which the groups are finalized on the
+ *   workers.
+ *
+ * When a query groups by a column other than the distribution column, the
+ * workers compute partial aggregates and the coordinator combines the
+ * partial aggregates of all groups. With many groups, that makes the
+ * coordinator the bottleneck. Instead, the partial aggregates can be
+ * repartitioned by a group column across the workers, such that each worker
+ * finalizes the groups of one or more partitions in parallel and only the
+ * final rows are sent to the coordinator.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
+#include "utils/lsyscache.h"
+#include "utils/typcache.h"
+
+#include "distributed/citus_nodefuncs.h"
+#include "distributed/commands/multi_copy.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/multi_logical_optimizer.h"
+#include "distributed/multi_physical_planner.h"
+#include "distributed/recursive_planning.h"
+#include "distributed/repartitioned_aggregate.h"
+
+
+/* controlled via GUC */
+bool EnableRepartitionedAggregation = false;
+
+
+static bool CanRepartitionAggregate(DistributedPlan *distributedPlan,
+									int *partitionColumnIndex, Oid *relationId);
+static bool HasOnlyTransferableColumns(List *targetList);
+static List * WorkerOutputTargetList(List *workerTargetList);
+static Query * FinalizeQuery(Query *combineQuery, List *workerOutputTargetList);
+static Query * FinalRowsCombineQuery(Query *combineQuery, List *finalizeTargetList);
+static bool ShipCombinedAggregatesByNameWalker(Node *node, Oid *coordCombineAggIds);
+
+
+/*
+ * PlanRepartitionedAggregate changes the given distributed plan such that the
+ * groups of the aggregation are finalized on the workers, if
+ * citus.enable_repartitioned_aggregation is on and the plan allows it.
+ *
+ * The worker job is left untouched. During execution, its results are
+ * repartitioned by a group column and the repartitionedAggregateQuery of the
+ * plan runs on each partition. The combine query only applies the ORDER BY,
+ * DISTINCT and LIMIT clauses to the final rows.
+ */
+void
+PlanRepartitionedAggregate(DistributedPlan *distributedPlan)
+{
+	int partitionColumnIndex = 0;
+	Oid relationId = InvalidOid;
+
+	if (!EnableRepartitionedAggregation)
+	{
+		return;
+	}
+
+	if (!CanRepartitionAggregate(distributedPlan, &partitionColumnIndex, &relationId))
+	{
+		return;
+	}
+
+	Query *combineQuery = distributedPlan->combineQuery;
+	List *workerTargetList = distributedPlan->workerJob->jobQuery->targetList;
+	List *workerOutputTargetList = WorkerOutputTargetList(workerTargetList);
+	Query *finalizeQuery = FinalizeQuery(combineQuery, workerOutputTargetList);
+
+	distributedPlan->combineQuery = FinalRowsCombineQuery(combineQuery,
+														  finalizeQuery->targetList);
+	distributedPlan->repartitionedAggregateQuery = finalizeQuery;
+	distributedPlan->repartitionedAggregateColumnIndex = partitionColumnIndex;
+	distributedPlan->repartitionedAggregateRelationId = relationId;
+
+	ereport(DEBUG1, (errmsg("finalizing aggregates on the workers after "
+							"repartitioning by column %d", partitionColumnIndex + 1)));
+}
+
+
+/*
+ * CanRepartitionAggregate returns whether the groups of the aggregation in the
+ * given plan can be finalized on the workers. If so, it sets the index of the
+ * worker output column to repartition by, which is the first group column,
+ * and the relation whose shards define the partitions.
+ */
+static bool
+CanRepartitionAggregate(DistributedPlan *distributedPlan, int *partitionColumnIndex,
+						Oid *relationId)
+{
+	Job *workerJob = distributedPlan->workerJob;
+	Query *combineQuery = distributedPlan->combineQuery;
+
+	if (workerJob == NULL || combineQuery == NULL ||
+		workerJob->dependentJobList != NIL ||
+		list_length(workerJob->taskList) < 2)
+	{
+		return false;
+	}
+
+	/* the combine query reads from the worker job only */
+	if (combineQuery->groupClause == NIL || combineQuery->groupingSets != NIL ||
+		combineQuery->hasWindowFuncs || combineQuery->hasTargetSRFs ||
+		combineQuery->hasSubLinks || list_length(combineQuery->rtable) != 1)
+	{
+		return false;
+	}
+
+	/* the worker queries are wrapped in worker_partition_query_result() */
+	if (HasUnresolvedExternParamsWalker((Node *) workerJob->jobQuery, NULL) ||
+		HasUnresolvedExternParamsWalker((Node *) combineQuery, NULL))
+	{
+		return false;
+	}
+
+	/* worker output and final rows are sent as intermediate results and tuples */
+	if (!HasOnlyTransferableColumns(workerJob->jobQuery->targetList) ||
+		!HasOnlyTransferableColumns(combineQuery->targetList))
+	{
+		return false;
+	}
+
+	SortGroupClause *groupClause = linitial(combineQuery->groupClause);
+	TargetEntry *groupTargetEntry = get_sortgroupclause_tle(groupClause,
+															combineQuery->targetList);
+	if (!IsA(groupTargetEntry->expr, Var))
+	{
+		return false;
+	}
+
+	Var *groupColumn = (Var *) groupTargetEntry->expr;
+	if (groupColumn->varno != 1 || groupColumn->varlevelsup != 0)
+	{
+		return false;
+	}
+
+	/* equal group values need to hash into the same partition */
+	TypeCacheEntry *typeEntry = lookup_type_cache(groupColumn->vartype,
+												  TYPECACHE_HASH_PROC);
+	if (!OidIsValid(typeEntry->hash_proc) ||
+		(OidIsValid(groupColumn->varcollid) &&
+		 !get_collation_isdeterministic(groupColumn->varcollid)))
+	{
+		return false;
+	}
+
+	/* the partitions are colocated with the shards of a relation in the query */
+	Task *firstTask = linitial(workerJob->taskList);
+	if (firstTask->anchorShardId == INVALID_SHARD_ID)
+	{
+		return false;
+	}
+
+	ShardInterval *anchorShardInterval = LoadShardInterval(firstTask->anchorShardId);
+	if (!IsCitusTableType(anchorShardInterval->relationId, HASH_DISTRIBUTED))
+	{
+		return false;
+	}
+
+	*partitionColumnIndex = groupColumn->varattno - 1;
+	*relationId = anchorShardInterval->relationId;
+
+	return true;
+}
+
+
+/*
+ * HasOnlyTransferableColumns returns whether none of the columns in the given
+ * target list have a pseudo-type or an anonymous record type, which cannot be
+ * read back from an intermediate result.
+ */
+static bool
+HasOnlyTransferableColumns(List *targetList)
+{
+	TargetEntry *targetEntry = NULL;
+	foreach_ptr(targetEntry, targetList)
+	{
+		Oid columnType = exprType((Node *) targetEntry->expr);
+
+		if (columnType == RECORDOID || columnType == RECORDARRAYOID ||
+			get_typtype(columnType) == TYPTYPE_PSEUDO)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * WorkerOutputTargetList returns the columns that the worker queries return,
+ * with unique names such that they can be used in a column definition list.
+ */
+static List *
+WorkerOutputTargetList(List *workerTargetList)
+{
+	List *outputTargetList = NIL;
+	AttrNumber columnNumber = 1;
+
+	TargetEntry *workerTargetEntry = NULL;
+	foreach_ptr(workerTargetEntry, workerTargetList)
+	{
+		if (workerTargetEntry->resjunk)
+		{
+			continue;
+		}
+
+		TargetEntry *outputTargetEntry = flatCopyTargetEntry(workerTargetEntry);
+		outputTargetEntry->resno = columnNumber;
+		outputTargetEntry->resname = WorkerColumnName(columnNumber);
+		outputTargetEntry->ressortgroupref = 0;
+
+		outputTargetList = lappend(outputTargetList, outputTargetEntry);
+		columnNumber++;
+	}
+
+	return outputTargetList;
+}
+
+
+/*
+ * FinalizeQuery returns the query that finalizes the groups of a partition of
+ * the partial aggregates. It is the combine query without ORDER BY, DISTINCT
+ * and LIMIT, which only apply to the final rows of all partitions, reading
+ * from a subquery on the intermediate results of the partition. The subquery
+ * does not read any results yet; it is replaced during execution.
+ */
+static Query *
+FinalizeQuery(Query *combineQuery, List *workerOutputTargetList)
+{
+	Query *finalizeQuery = copyObject(combineQuery);
+	finalizeQuery->sortClause = NIL;
+	finalizeQuery->distinctClause = NIL;
+	finalizeQuery->hasDistinctOn = false;
+	finalizeQuery->limitCount = NULL;
+	finalizeQuery->limitOffset = NULL;
+	finalizeQuery->limitOption = LIMIT_OPTION_DEFAULT;
+
+	/* the aggregate OIDs of the coordinator do not exist on the workers */
+	Oid coordCombineAggIds[] = { CoordCombineAggOid(), CoordCombineAggBinaryOid() };
+	ShipCombinedAggregatesByNameWalker((Node *) finalizeQuery->targetList,
+									   coordCombineAggIds);
+	ShipCombinedAggregatesByNameWalker(finalizeQuery->havingQual, coordCombineAggIds);
+
+	/* all columns are returned, since the combine query may sort by them */
+	TargetEntry *targetEntry = NULL;
+	foreach_ptr(targetEntry, finalizeQuery->targetList)
+	{
+		targetEntry->resjunk = false;
+
+		if (targetEntry->resname == NULL)
+		{
+			targetEntry->resname = WorkerColumnName(targetEntry->resno);
+		}
+	}
+
+	List *columnNameList = NIL;
+	foreach_ptr(targetEntry, workerOutputTargetList)
+	{
+		columnNameList = lappend(columnNameList, makeString(targetEntry->resname));
+	}
+
+	bool useBinaryCopyFormat = CanUseBinaryCopyFormatForTargetList(
+		workerOutputTargetList);
+
+	RangeTblEntry *workerResultRTE = linitial(finalizeQuery->rtable);
+	workerResultRTE->rtekind = RTE_SUBQUERY;
+	workerResultRTE->functions = NIL;
+	workerResultRTE->subquery =
+		BuildReadIntermediateResultsArrayQuery(workerOutputTargetList, NIL, NIL,
+											   useBinaryCopyFormat);
+	workerResultRTE->alias = makeAlias("remote_scan", NIL);
+	workerResultRTE->eref = makeAlias("remote_scan", columnNameList);
+
+	return finalizeQuery;
+}
+
+
+/*
+ * ShipCombinedAggregatesByNameWalker changes the aggregate OID arguments of
+ * the coord_combine_agg calls in the given expression to regprocedure, such
+ * that the finalize query refers to the aggregates by name when deparsed, like
+ * the worker_partial_agg calls of the worker queries do.
+ */
+static bool
+ShipCombinedAggregatesByNameWalker(Node *node, Oid *coordCombineAggIds)
+{
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	if (IsA(node, Aggref))
+	{
+		Aggref *aggregate = (Aggref *) node;
+
+		if (aggregate->aggfnoid == coordCombineAggIds[0] ||
+			aggregate->aggfnoid == coordCombineAggIds[1])
+		{
+			TargetEntry *aggOidArgument = linitial(aggregate->args);
+			Const *aggOidParam = (Const *) aggOidArgument->expr;
+
+			Assert(IsA(aggOidParam, Const));
+			aggOidParam->consttype = REGPROCEDUREOID;
+		}
+	}
+
+	return expression_tree_walker(node, ShipCombinedAggregatesByNameWalker,
+								  coordCombineAggIds);
+}
+
+
+/*
+ * FinalRowsCombineQuery returns the combine query that applies the ORDER BY,
+ * DISTINCT and LIMIT clauses of the given combine query to the final rows,
+ * which have the given target list.
+ */
+static Query *
+FinalRowsCombineQuery(Query *combineQuery, List *finalizeTargetList)
+{
+	Query *finalRowsQuery = copyObject(combineQuery);
+	finalRowsQuery->groupClause = NIL;
+	finalRowsQuery->havingQual = NULL;
+	finalRowsQuery->hasAggs = false;
+	finalRowsQuery->jointree->quals = NULL;
+
+	List *columnNameList = NIL;
+	List *funcColumnNames = NIL;
+	List *funcColumnTypes = NIL;
+	List *funcColumnTypeMods = NIL;
+	List *funcCollations = NIL;
+	List *targetList = NIL;
+
+	TargetEntry *combineTargetEntry = NULL;
+	TargetEntry *finalizeTargetEntry = NULL;
+	forboth_ptr(combineTargetEntry, finalRowsQuery->targetList,
+				finalizeTargetEntry, finalizeTargetList)
+	{
+		Node *finalizeExpr = (Node *) finalizeTargetEntry->expr;
+		char *columnName = finalizeTargetEntry->resname;
+
+		columnNameList = lappend(columnNameList, makeString(columnName));
+		funcColumnNames = lappend(funcColumnNames, makeString(columnName));
+		funcColumnTypes = lappend_oid(funcColumnTypes, exprType(finalizeExpr));
+		funcColumnTypeMods = lappend_int(funcColumnTypeMods, exprTypmod(finalizeExpr));
+		funcCollations = lappend_oid(funcCollations, exprCollation(finalizeExpr));
+
+		/* each column of the final rows is returned as-is */
+		TargetEntry *targetEntry = flatCopyTargetEntry(combineTargetEntry);
+		targetEntry->expr = (Expr *) makeVar(1, finalizeTargetEntry->resno,
+											 exprType(finalizeExpr),
+											 exprTypmod(finalizeExpr),
+											 exprCollation(finalizeExpr), 0);
+
+		targetList = lappend(targetList, targetEntry);
+	}
+
+	finalRowsQuery->targetList = targetList;
+
+	/* the derived table now represents the final rows */
+	List *tableIdList = NIL;
+	RangeTblEntry *workerResultRTE = linitial(finalRowsQuery->rtable);
+	ExtractRangeTblExtraData(workerResultRTE, NULL, NULL, NULL, &tableIdList);
+
+	linitial(finalRowsQuery->rtable) =
+		DerivedRangeTableEntry(NULL, columnNameList, tableIdList, funcColumnNames,
+							   funcColumnTypes, funcColumnTypeMods, funcCollations);
+
+	return finalRowsQuery;
+}
@@ -77,6 +77,7 @@
 #include "optimizer/clauses.h"
 #include "optimizer/planner.h"
 #include "parser/parse_coerce.h"
+#include "utils/array.h"
 #include "utils/arrayaccess.h"
 #include "utils/catcache.h"
 #include "utils/fmgrprotos.h"
@@ -86,6 +87,7 @@
 
 #include "pg_version_constants.h"
 
+#include "distributed/citus_nodefuncs.h"
 #include "distributed/distributed_planner.h"
 #include "distributed/listutils.h"
 #include "distributed/log_utils.h"
@@ -241,6 +243,10 @@ typedef struct ClauseWalkerContext
 	FunctionCall2InfoData compareIntervalFunctionCall;
 } ClauseWalkerContext;
 
+
+/* minimum number of values in a partition column array to split it by shard */
+int ShardArraySplitThreshold = 32;
+
 static bool BuildPruningTree(Node *node, PruningTreeBuildContext *context);
 static void SimplifyPruningTree(PruningTreeNode *node, PruningTreeNode *parent);
 static void PrunableExpressions(PruningTreeNode *node, ClauseWalkerContext *context);
@@ -294,6 +300,13 @@ static OpExpr * SAORestrictionArrayEqualityOp(ScalarArrayOpExpr *arrayOperatorEx
 static void DebugLogNode(char *fmt, Node *node, List *deparseCtx);
 static void DebugLogPruningInstance(PruningInstance *pruning, List *deparseCtx);
 static int ConstraintCount(PruningTreeNode *node);
+static bool SplitPartitionKeyArraysWalker(Node *node, List **arraySplitList);
+static void SplitPartitionKeyArraysInQuals(Query *query, Node *quals,
+										   List **arraySplitList);
+static PartitionKeyArraySplit * SplitPartitionKeyArray(Query *query,
+													   ScalarArrayOpExpr *arrayOpExpr);
+static List ** PartitionKeyArrayElementsByShard(Node *arrayNode,
+												CitusTableCacheEntry *cacheEntry);
 
 
 /*
@@ -2065,3 +2078,381 @@ ConstraintCount(PruningTreeNode *node)
 		   list_length(node->validConstraints) +
 		   (node->hasInvalidConstraints ? 1 : 0);
 }
+
+
+/*
+ * SplitPartitionKeyArraysByShard finds the partition column = ANY (array)
+ * filters in the given query on hash-distributed tables, and groups the array
+ * values of each filter by the shard they hash into in a single pass over the
+ * array. The returned list can be used to restrict the arrays in the query to
+ * the values of the shards of a task before the query is deparsed. Arrays with
+ * fewer than citus.shard_array_split_threshold values are not split.
+ *
+ * Only filters that are top-level conjuncts of a WHERE clause are considered,
+ * such that removing values that cannot match any row in the shard does not
+ * change the outcome of the query. NULL array elements are kept for all shards.
+ */
+List *
+SplitPartitionKeyArraysByShard(Query *query)
+{
+	List *arraySplitList = NIL;
+
+	SplitPartitionKeyArraysWalker((Node *) query, &arraySplitList);
+
+	return arraySplitList;
+}
+
+
+/*
+ * RestrictPartitionKeyArraysToShards replaces the arrays of the given filters
+ * in the query with the values that hash into the shards in the relation shard
+ * list of a task. Filters on relations without a shard in the list keep their
+ * original array.
+ */
+void
+RestrictPartitionKeyArraysToShards(List *arraySplitList, List *relationShardList)
+{
+	PartitionKeyArraySplit *arraySplit = NULL;
+	foreach_ptr(arraySplit, arraySplitList)
+	{
+		Node *arrayNode = arraySplit->originalArray;
+
+		RelationShard *relationShard = NULL;
+		foreach_ptr(relationShard, relationShardList)
+		{
+			if (relationShard->relationId != arraySplit->relationId)
+			{
+				continue;
+			}
+
+			for (int shardIndex = 0; shardIndex < arraySplit->shardCount; shardIndex++)
+			{
+				if (arraySplit->shardIdArray[shardIndex] == relationShard->shardId)
+				{
+					arrayNode = arraySplit->shardArrayArray[shardIndex];
+					break;
+				}
+			}
+
+			break;
+		}
+
+		lsecond(arraySplit->arrayOpExpr->args) = arrayNode;
+	}
+}
+
+
+/*
+ * ResetPartitionKeyArrays puts the original arrays back into the filters.
+ */
+void
+ResetPartitionKeyArrays(List *arraySplitList)
+{
+	PartitionKeyArraySplit *arraySplit = NULL;
+	foreach_ptr(arraySplit, arraySplitList)
+	{
+		lsecond(arraySplit->arrayOpExpr->args) = arraySplit->originalArray;
+	}
+}
+
+
+/*
+ * SplitPartitionKeyArraysWalker walks over all queries in the query tree and
+ * splits the partition column arrays in their WHERE clauses.
+ */
+static bool
+SplitPartitionKeyArraysWalker(Node *node, List **arraySplitList)
+{
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	if (IsA(node, Query))
+	{
+		Query *query = (Query *) node;
+
+		if (query->jointree != NULL)
+		{
+			SplitPartitionKeyArraysInQuals(query, query->jointree->quals,
+										   arraySplitList);
+		}
+
+		return query_tree_walker(query, SplitPartitionKeyArraysWalker,
+								 arraySplitList, 0);
+	}
+
+	return expression_tree_walker(node, SplitPartitionKeyArraysWalker,
+								  arraySplitList);
+}
+
+
+/*
+ * SplitPartitionKeyArraysInQuals splits the partition column arrays in the
+ * top-level conjuncts of the given WHERE clause, which may be in implicit
+ * or explicit AND form.
+ */
+static void
+SplitPartitionKeyArraysInQuals(Query *query, Node *quals, List **arraySplitList)
+{
+	if (quals == NULL)
+	{
+		return;
+	}
+
+	if (IsA(quals, List))
+	{
+		Node *qual = NULL;
+		foreach_ptr(qual, (List *) quals)
+		{
+			SplitPartitionKeyArraysInQuals(query, qual, arraySplitList);
+		}
+	}
+	else if (is_andclause(quals))
+	{
+		SplitPartitionKeyArraysInQuals(query, (Node *) ((BoolExpr *) quals)->args,
+									   arraySplitList);
+	}
+	else if (IsA(quals, ScalarArrayOpExpr))
+	{
+		PartitionKeyArraySplit *arraySplit =
+			SplitPartitionKeyArray(query, (ScalarArrayOpExpr *) quals);
+		if (arraySplit != NULL)
+		{
+			*arraySplitList = lappend(*arraySplitList, arraySplit);
+		}
+	}
+}
+
+
+/*
+ * SplitPartitionKeyArray returns the split of the given filter if it is of the
+ * form partition column = ANY (array of constants) on a hash-distributed table
+ * in the range table of the given query, and NULL otherwise.
+ */
+static PartitionKeyArraySplit *
+SplitPartitionKeyArray(Query *query, ScalarArrayOpExpr *arrayOpExpr)
+{
+	if (!arrayOpExpr->useOr || !OperatorImplementsEquality(arrayOpExpr->opno))
+	{
+		return NULL;
+	}
+
+	Node *leftOperand = linitial(arrayOpExpr->args);
+	Node *arrayNode = lsecond(arrayOpExpr->args);
+
+	if (!IsA(leftOperand, Var) || ((Var *) leftOperand)->varlevelsup != 0)
+	{
+		return NULL;
+	}
+
+	Var *column = (Var *) leftOperand;
+	RangeTblEntry *rangeTableEntry = rt_fetch(column->varno, query->rtable);
+
+	if (GetRangeTblKind(rangeTableEntry) != CITUS_RTE_RELATION ||
+		!IsCitusTableType(rangeTableEntry->relid, HASH_DISTRIBUTED))
+	{
+		return NULL;
+	}
+
+	CitusTableCacheEntry *cacheEntry = GetCitusTableCacheEntry(rangeTableEntry->relid);
+	Var *partitionColumn = cacheEntry->partitionColumn;
+	int shardCount = cacheEntry->shardIntervalArrayLength;
+
+	if (column->varattno != partitionColumn->varattno ||
+		column->vartype != partitionColumn->vartype ||
+		arrayOpExpr->inputcollid != partitionColumn->varcollid ||
+		shardCount < 2)
+	{
+		return NULL;
+	}
+
+	List **shardElementLists = PartitionKeyArrayElementsByShard(arrayNode, cacheEntry);
+	if (shardElementLists == NULL)
+	{
+		return NULL;
+	}
+
+	PartitionKeyArraySplit *arraySplit = palloc0(sizeof(PartitionKeyArraySplit));
+	arraySplit->arrayOpExpr = arrayOpExpr;
+	arraySplit->originalArray = arrayNode;
+	arraySplit->relationId = rangeTableEntry->relid;
+	arraySplit->shardCount = shardCount;
+	arraySplit->shardIdArray = palloc0(shardCount * sizeof(uint64));
+	arraySplit->shardArrayArray = palloc0(shardCount * sizeof(Node *));
+
+	int16 typeLength = 0;
+	bool typeByValue = false;
+	char typeAlign = 0;
+	get_typlenbyvalalign(partitionColumn->vartype, &typeLength, &typeByValue,
+						 &typeAlign);
+
+	for (int shardIndex = 0; shardIndex < shardCount; shardIndex++)
+	{
+		List *elementList = shardElementLists[shardIndex];
+
+		arraySplit->shardIdArray[shardIndex] =
+			cacheEntry->sortedShardIntervalArray[shardIndex]->shardId;
+
+		if (IsA(arrayNode, ArrayExpr))
+		{
+			ArrayExpr *shardArrayExpr = copyObject((ArrayExpr *) arrayNode);
+			shardArrayExpr->elements = elementList;
+
+			arraySplit->shardArrayArray[shardIndex] = (Node *) shardArrayExpr;
+		}
+		else
+		{
+			Const *arrayConst = (Const *) arrayNode;
+			int elementCount = list_length(elementList);
+			Datum *elementValues = palloc0(Max(elementCount, 1) * sizeof(Datum));
+			bool *elementNulls = palloc0(Max(elementCount, 1) * sizeof(bool));
+			int dimensions[1] = { elementCount };
+			int lowerBounds[1] = { 1 };
+			int elementIndex = 0;
+
+			Const *elementConst = NULL;
+			foreach_ptr(elementConst, elementList)
+			{
+				elementValues[elementIndex] = elementConst->constvalue;
+				elementNulls[elementIndex] = elementConst->constisnull;
+				elementIndex++;
+			}
+
+			ArrayType *shardArray = NULL;
+			if (elementCount == 0)
+			{
+				shardArray = construct_empty_array(partitionColumn->vartype);
+			}
+			else
+			{
+				shardArray = construct_md_array(elementValues, elementNulls, 1,
+												dimensions, lowerBounds,
+												partitionColumn->vartype,
+												typeLength, typeByValue, typeAlign);
+			}
+
+			arraySplit->shardArrayArray[shardIndex] =
+				(Node *) makeConst(arrayConst->consttype, arrayConst->consttypmod,
+								   arrayConst->constcollid, arrayConst->constlen,
+								   PointerGetDatum(shardArray), false, false);
+		}
+	}
+
+	return arraySplit;
+}
+
+
+/*
+ * PartitionKeyArrayElementsByShard returns, for each shard index of the given
+ * table, the list of constants in the given array argument that hash into the
+ * shard. NULL elements are added to the list of every shard. Returns NULL if
+ * the array argument is not an array of constants of the partition column
+ * type.
+ */
+static List **
+PartitionKeyArrayElementsByShard(Node *arrayNode, CitusTableCacheEntry *cacheEntry)
+{
+	Var *partitionColumn = cacheEntry->partitionColumn;
+	int shardCount = cacheEntry->shardIntervalArrayLength;
+	List *elementList = NIL;
+
+	if (IsA(arrayNode, ArrayExpr))
+	{
+		ArrayExpr *arrayExpr = (ArrayExpr *) arrayNode;
+
+		if (arrayExpr->multidims || arrayExpr->element_typeid != partitionColumn->vartype)
+		{
+			return NULL;
+		}
+
+		Node *element = NULL;
+		foreach_ptr(element, arrayExpr->elements)
+		{
+			if (!IsA(element, Const))
+			{
+				return NULL;
+			}
+		}
+
+		elementList = arrayExpr->elements;
+	}
+	else if (IsA(arrayNode, Const))
+	{
+		Const *arrayConst = (Const *) arrayNode;
+
+		if (arrayConst->constisnull ||
+			get_element_type(arrayConst->consttype) != partitionColumn->vartype)
+		{
+			return NULL;
+		}
+
+		ArrayType *array = DatumGetArrayTypeP(arrayConst->constvalue);
+		if (ARR_NDIM(array) > 1)
+		{
+			return NULL;
+		}
+
+		int16 typeLength = 0;
+		bool typeByValue = false;
+		char typeAlign = 0;
+		Datum *elementValues = NULL;
+		bool *elementNulls = NULL;
+		int elementCount = 0;
+
+		get_typlenbyvalalign(partitionColumn->vartype, &typeLength, &typeByValue,
+							 &typeAlign);
+		deconstruct_array(array, partitionColumn->vartype, typeLength, typeByValue,
+						  typeAlign, &elementValues, &elementNulls, &elementCount);
+
+		for (int elementIndex = 0; elementIndex < elementCount; elementIndex++)
+		{
+			Const *elementConst = makeConst(partitionColumn->vartype,
+											partitionColumn->vartypmod,
+											partitionColumn->varcollid, typeLength,
+											elementValues[elementIndex],
+											elementNulls[elementIndex], typeByValue);
+			elementList = lappend(elementList, elementConst);
+		}
+	}
+	else
+	{
+		return NULL;
+	}
+
+	/* splitting short arrays is not worth the planning overhead */
+	if (ShardArraySplitThreshold <= 0 ||
+		list_length(elementList) < Max(ShardArraySplitThreshold, 2))
+	{
+		return NULL;
+	}
+
+	List **shardElementLists = palloc0(shardCount * sizeof(List *));
+
+	Const *elementConst = NULL;
+	foreach_ptr(elementConst, elementList)
+	{
+		if (elementConst->constisnull)
+		{
+			for (int shardIndex = 0; shardIndex < shardCount; shardIndex++)
+			{
+				shardElementLists[shardIndex] =
+					lappend(shardElementLists[shardIndex], elementConst);
+			}
+
+			continue;
+		}
+
+		ShardInterval *shardInterval = FindShardInterval(elementConst->constvalue,
+														 cacheEntry);
+		if (shardInterval == NULL)
+		{
+			return NULL;
+		}
+
+		shardElementLists[shardInterval->shardIndex] =
+			lappend(shardElementLists[shardInterval->shardIndex], elementConst);
+	}
+
+	return shardElementLists;
+}
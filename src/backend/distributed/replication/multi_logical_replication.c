@@ -151,10 +151,14 @@ static void WaitForGroupedLogicalRepTargetsToCatchUp(XLogRecPtr sourcePosition,
  * for the given shards, source and target nodes. Also, the caller is responsible
  * for ensuring that the input shard list consists of co-located distributed tables
  * or a single shard.
+ *
+ * When resumeTransfer is true, the current operation continues a failed transfer
+ * of the same shards that already set up the replication and copied the data,
+ * so we only need to catch up from the replication slots it created.
  */
 void
 LogicallyReplicateShards(List *shardList, char *sourceNodeName, int sourceNodePort,
-						 char *targetNodeName, int targetNodePort)
+						 char *targetNodeName, int targetNodePort, bool resumeTransfer)
 {
 	AcquireLogicalReplicationLock();
 	char *superUser = CitusExtensionOwnerName();
@@ -195,60 +199,74 @@ LogicallyReplicateShards(List *shardList, char *sourceNodeName, int sourceNodePo
 	CreateGroupedLogicalRepTargetsConnections(groupedLogicalRepTargetsHash, superUser,
 											  databaseName);
 
-	MultiConnection *sourceReplicationConnection =
-		GetReplicationConnection(sourceConnection->hostname, sourceConnection->port);
+	if (!resumeTransfer)
+	{
+		MultiConnection *sourceReplicationConnection =
+			GetReplicationConnection(sourceConnection->hostname, sourceConnection->port);
 
-	/* set up the publication on the source and subscription on the target */
-	CreatePublications(sourceConnection, publicationInfoHash);
-	char *snapshot = CreateReplicationSlots(
-		sourceConnection,
-		sourceReplicationConnection,
-		logicalRepTargetList,
-		"pgoutput");
+		/* set up the publication on the source and subscription on the target */
+		CreatePublications(sourceConnection, publicationInfoHash);
+		char *snapshot = CreateReplicationSlots(
+			sourceConnection,
+			sourceReplicationConnection,
+			logicalRepTargetList,
+			"pgoutput");
 
-	CreateSubscriptions(
-		sourceConnection,
-		sourceConnection->database,
-		logicalRepTargetList);
+		CreateSubscriptions(
+			sourceConnection,
+			sourceConnection->database,
+			logicalRepTargetList);
 
-	/* only useful for isolation testing, see the function comment for the details */
-	ConflictWithIsolationTestingBeforeCopy();
+		/* only useful for isolation testing, see the function comment for the details */
+		ConflictWithIsolationTestingBeforeCopy();
 
-	/*
-	 * We have to create the primary key (or any other replica identity)
-	 * before the update/delete operations that are queued will be
-	 * replicated. Because if the replica identity does not exist on the
-	 * target, the replication would fail.
-	 *
-	 * So the latest possible moment we could do this is right after the
-	 * initial data COPY, but before enabling the susbcriptions. It might
-	 * seem like a good idea to it after the initial data COPY, since
-	 * it's generally the rule that it's cheaper to build an index at once
-	 * than to create it incrementally. This general rule, is why we create
-	 * all the regular indexes as late during the move as possible.
-	 *
-	 * But as it turns out in practice it's not as clear cut, and we saw a
-	 * speed degradation in the time it takes to move shards when doing the
-	 * replica identity creation after the initial COPY. So, instead we
-	 * keep it before the COPY.
-	 */
-	CreateReplicaIdentities(logicalRepTargetList);
+		/*
+		 * We have to create the primary key (or any other replica identity)
+		 * before the update/delete operations that are queued will be
+		 * replicated. Because if the replica identity does not exist on the
+		 * target, the replication would fail.
+		 *
+		 * So the latest possible moment we could do this is right after the
+		 * initial data COPY, but before enabling the susbcriptions. It might
+		 * seem like a good idea to it after the initial data COPY, since
+		 * it's generally the rule that it's cheaper to build an index at once
+		 * than to create it incrementally. This general rule, is why we create
+		 * all the regular indexes as late during the move as possible.
+		 *
+		 * But as it turns out in practice it's not as clear cut, and we saw a
+		 * speed degradation in the time it takes to move shards when doing the
+		 * replica identity creation after the initial COPY. So, instead we
+		 * keep it before the COPY.
+		 */
+		CreateReplicaIdentities(logicalRepTargetList);
 
-	UpdatePlacementUpdateStatusForShardIntervalList(
-		shardList,
-		sourceNodeName,
-		sourceNodePort,
-		PLACEMENT_UPDATE_STATUS_COPYING_DATA);
+		UpdatePlacementUpdateStatusForShardIntervalList(
+			shardList,
+			sourceNodeName,
+			sourceNodePort,
+			PLACEMENT_UPDATE_STATUS_COPYING_DATA);
 
-	CopyShardsToNode(sourceNode, targetNode, shardList, snapshot);
+		CopyShardsToNode(sourceNode, targetNode, shardList, snapshot);
 
-	/*
-	 * We can close this connection now, because we're done copying the
-	 * data and thus don't need access to the snapshot anymore. The
-	 * replication slot will still be at the same LSN, because the
-	 * subscriptions have not been enabled yet.
-	 */
-	CloseConnection(sourceReplicationConnection);
+		/*
+		 * We can close this connection now, because we're done copying the
+		 * data and thus don't need access to the snapshot anymore. The
+		 * replication slot will still be at the same LSN, because the
+		 * subscriptions have not been enabled yet.
+		 */
+		CloseConnection(sourceReplicationConnection);
+
+		/*
+		 * Once all shards are copied, a retry of a failed transfer can reuse
+		 * them, since the replication slots hold on to the changes that
+		 * happened after the copy. Shards copied before a failure during the
+		 * copy cannot be reused, because a retry cannot copy the remaining
+		 * shards under the same snapshot, so we only record the whole group.
+		 */
+		InsertShardTransferProgressOutsideTransaction(
+			ShardTransferProgressForShardList(shardList, sourceNode->nodeId,
+											  targetNode->nodeId));
+	}
 
 	/*
 	 * Start the replication and copy all data
@@ -340,6 +358,13 @@ CompleteNonBlockingShardTransfer(List *shardList,
 		sourceConnection->port,
 		PLACEMENT_UPDATE_STATUS_CREATING_CONSTRAINTS);
 
+	/*
+	 * A retry could not create the post-load objects again on shards that
+	 * already have some of them, so from here on a failed shard transfer
+	 * cannot be resumed.
+	 */
+	DeleteShardTransferProgressOutsideTransaction();
+
 	/*
 	 * Now lets create the post-load objects, such as the indexes, constraints
 	 * and partitioning hierarchy. Once they are done, wait until the replication
@@ -64,10 +64,14 @@
 #include "distributed/connection_management.h"
 #include "distributed/coordinator_protocol.h"
 #include "distributed/cte_inline.h"
+#include "distributed/deparse_shard_query.h"
 #include "distributed/distributed_deadlock_detection.h"
 #include "distributed/distributed_planner.h"
+#include "distributed/distributed_statistics.h"
 #include "distributed/errormessage.h"
+#include "distributed/hot_tenant_isolation.h"
 #include "distributed/intermediate_result_pruning.h"
+#include "distributed/intermediate_results.h"
 #include "distributed/local_distributed_join_planner.h"
 #include "distributed/local_executor.h"
 #include "distributed/local_multi_copy.h"
@@ -85,6 +89,7 @@
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_router_planner.h"
 #include "distributed/multi_server_executor.h"
+#include "distributed/parallel_copy.h"
 #include "distributed/pg_dist_partition.h"
 #include "distributed/placement_connection.h"
 #include "distributed/priority.h"
@@ -96,10 +101,13 @@
 #include "distributed/remote_commands.h"
 #include "distributed/remote_transaction.h"
 #include "distributed/repartition_executor.h"
+#include "distributed/repartition_join_execution.h"
+#include "distributed/repartitioned_aggregate.h"
 #include "distributed/replication_origin_session_utils.h"
 #include "distributed/resource_lock.h"
 #include "distributed/run_from_same_connection.h"
 #include "distributed/shard_cleaner.h"
+#include "distributed/shard_pruning.h"
 #include "distributed/shard_rebalancer.h"
 #include "distributed/shard_transfer.h"
 #include "distributed/shardsplit_shared_memory.h"
@@ -112,9 +120,11 @@
 #include "distributed/transaction_recovery.h"
 #include "distributed/utils/citus_stat_tenants.h"
 #include "distributed/utils/directory.h"
+#include "distributed/utils/shard_load_stats.h"
 #include "distributed/worker_log_messages.h"
 #include "distributed/worker_manager.h"
 #include "distributed/worker_protocol.h"
+#include "distributed/worker_shard_copy.h"
 #include "distributed/worker_shard_visibility.h"
 
 /* marks shared object as one loadable by the postgres version compiled against */
@@ -199,6 +209,8 @@ static void RegisterCitusConfigVariables(void);
 static void OverridePostgresConfigProperties(void);
 static bool ErrorIfNotASuitableDeadlockFactor(double *newval, void **extra,
 											  GucSource source);
+static bool PercentileApproximationCompressionCheckHook(int *newval, void **extra,
+														GucSource source);
 static bool WarnIfDeprecatedExecutorUsed(int *newval, void **extra, GucSource source);
 static bool WarnIfReplicationModelIsSet(int *newval, void **extra, GucSource source);
 static bool NoticeIfSubqueryPushdownEnabled(bool *newval, void **extra, GucSource source);
@@ -235,6 +247,12 @@ static const struct config_enum_entry stat_statements_track_options[] = {
 	{ NULL, 0, false }
 };
 
+static const struct config_enum_entry stat_shard_load_track_options[] = {
+	{ "none", STAT_SHARD_LOAD_TRACK_NONE, false },
+	{ "all", STAT_SHARD_LOAD_TRACK_ALL, false },
+	{ NULL, 0, false }
+};
+
 static const struct config_enum_entry stat_tenants_track_options[] = {
 	{ "none", STAT_TENANTS_TRACK_NONE, false },
 	{ "all", STAT_TENANTS_TRACK_ALL, false },
@@ -245,6 +263,7 @@ static const struct config_enum_entry task_assignment_policy_options[] = {
 	{ "greedy", TASK_ASSIGNMENT_GREEDY, false },
 	{ "first-replica", TASK_ASSIGNMENT_FIRST_REPLICA, false },
 	{ "round-robin", TASK_ASSIGNMENT_ROUND_ROBIN, false },
+	{ "adaptive", TASK_ASSIGNMENT_ADAPTIVE, false },
 	{ NULL, 0, false }
 };
 
@@ -273,6 +292,13 @@ static const struct config_enum_entry coordinator_aggregation_options[] = {
 	{ NULL, 0, false }
 };
 
+static const struct config_enum_entry count_distinct_approximation_options[] = {
+	{ "auto", COUNT_DISTINCT_APPROXIMATION_AUTO, false },
+	{ "hll", COUNT_DISTINCT_APPROXIMATION_HLL, false },
+	{ "native", COUNT_DISTINCT_APPROXIMATION_NATIVE, false },
+	{ NULL, 0, false }
+};
+
 static const struct config_enum_entry log_level_options[] = {
 	{ "off", CITUS_LOG_LEVEL_OFF, false },
 	{ "debug5", DEBUG5, false},
@@ -381,6 +407,17 @@ static const struct config_enum_entry metadata_sync_mode_options[] = {
 	{ NULL, 0, false }
 };
 
+static const struct config_enum_entry stream_compression_options[] = {
+	{ "none", STREAM_COMPRESSION_NONE, false },
+#if HAVE_CITUS_LIBLZ4
+	{ "lz4", STREAM_COMPRESSION_LZ4, false },
+#endif
+#if HAVE_LIBZSTD
+	{ "zstd", STREAM_COMPRESSION_ZSTD, false },
+#endif
+	{ NULL, 0, false }
+};
+
 /* *INDENT-ON* */
 
 
@@ -511,6 +548,8 @@ _PG_init(void)
 
 	InitializeMultiTenantMonitorSMHandleManagement();
 
+	InitializeShardLoadMonitor();
+
 	/* enable modification of pg_catalog tables during pg_upgrade */
 	if (IsBinaryUpgrade)
 	{
@@ -622,6 +661,7 @@ citus_shmem_request(void)
 	RequestAddinShmemSpace(MaintenanceDaemonShmemSize());
 	RequestAddinShmemSpace(CitusQueryStatsSharedMemSize());
 	RequestAddinShmemSpace(LogicalClockShmemSize());
+	RequestAddinShmemSpace(ShardLoadMonitorShmemSize());
 	RequestNamedLWLockTranche(STATS_SHARED_MEM_NAME, 1);
 }
 
@@ -994,6 +1034,22 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.analyze_interval",
+		gettext_noop("Sets the time to wait between gathering the statistics of "
+					 "shards into the coordinator."),
+		gettext_noop("The maintenance daemon periodically merges the row counts "
+					 "and column statistics of the shards of distributed and "
+					 "reference tables into the statistics of the tables on the "
+					 "coordinator, which are used when planning queries there. "
+					 "Use -1 to disable, in which case citus_analyze() can be "
+					 "used to gather them."),
+		&DistributedAnalyzeInterval,
+		-1, -1, 7 * MS_PER_DAY,
+		PGC_SIGHUP,
+		GUC_UNIT_MS | GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.background_task_queue_interval",
 		gettext_noop("Time to wait between checks for scheduled background tasks."),
@@ -1054,10 +1110,40 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_BYTE | GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.copy_to_preserve_shard_order",
+		gettext_noop("Sends the rows of COPY .. TO STDOUT on a distributed table "
+					 "in shard order."),
+		gettext_noop("When COPY .. TO STDOUT reads multiple shards concurrently "
+					 "(see citus.max_copy_to_connections), shards that are read "
+					 "ahead buffer a limited amount of data until the rows of the "
+					 "shards before them are sent. When disabled, rows are sent in "
+					 "the order in which they arrive."),
+		&CopyToPreserveShardOrder,
+		true,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomEnumVariable(
+		"citus.count_distinct_approximation_method",
+		gettext_noop("Sets how count(distinct) approximations are computed."),
+		gettext_noop("When citus.count_distinct_error_rate is set, count(distinct) "
+					 "is approximated using HyperLogLog sketches. The hll option "
+					 "uses the postgresql-hll extension, the native option uses "
+					 "the sketches built into Citus, and auto uses the extension "
+					 "when it is installed and the built-in sketches otherwise."),
+		&CountDistinctApproximationMethod,
+		COUNT_DISTINCT_APPROXIMATION_AUTO,
+		count_distinct_approximation_options,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomRealVariable(
 		"citus.count_distinct_error_rate",
 		gettext_noop("Desired error rate when calculating count(distinct) "
-					 "approximates using the postgresql-hll extension. "
+					 "approximates using HyperLogLog sketches. "
 					 "0.0 disables approximations for count(distinct); 1.0 "
 					 "provides no guarantees about the accuracy of results."),
 		NULL,
@@ -1253,6 +1339,36 @@ RegisterCitusConfigVariables(void)
 		PGC_USERSET,
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_common_subplan_elimination",
+		gettext_noop("Enables sharing a subplan among identical subqueries and CTEs."),
+		gettext_noop("When enabled, subqueries and CTEs that are planned separately "
+					 "and are structurally identical to one that was already "
+					 "planned for the same query read the intermediate result of "
+					 "that subplan, such that they are executed and broadcast only "
+					 "once. Subqueries with side effects or volatile functions are "
+					 "never shared."),
+		&EnableCommonSubplanElimination,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_concurrent_subplan_execution",
+		gettext_noop("Enables executing independent subplans concurrently."),
+		gettext_noop("When enabled, the remote tasks of subqueries and CTEs that "
+					 "are planned separately and do not read each other's results "
+					 "are executed together over the same worker sessions, such "
+					 "that the latency of the subplans is close to that of the "
+					 "slowest one instead of their sum."),
+		&EnableConcurrentSubPlanExecution,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_cost_based_connection_establishment",
 		gettext_noop("When enabled the connection establishment times "
@@ -1265,6 +1381,20 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_cost_based_join_order",
+		gettext_noop("Enables choosing the join order and the repartitioning "
+					 "strategy of non-colocated joins based on table sizes."),
+		gettext_noop("When enabled, the planner estimates the data that each "
+					 "repartition join sends over the network using the shard "
+					 "sizes on the workers and the filters in the query, and "
+					 "chooses the join order that transfers the least data."),
+		&EnableCostBasedJoinOrder,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_create_database_propagation",
 		gettext_noop("Enables propagating CREATE DATABASE "
@@ -1332,6 +1462,34 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_generic_multi_shard_plans",
+		gettext_noop("Enables caching plans of multi-shard prepared statements."),
+		gettext_noop("By default, multi-shard SELECT queries with parameters are "
+					 "planned for every execution with the parameter values. When "
+					 "enabled, such queries are planned without the parameter "
+					 "values if possible, such that the plan can be reused, and "
+					 "only the shards are pruned for every execution."),
+		&EnableGenericMultiShardPlans,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_interleaved_local_execution",
+		gettext_noop("Enables executing local tasks while waiting for the results "
+					 "of remote tasks."),
+		gettext_noop("By default, the tasks of a read-only multi-shard query that "
+					 "access local shards are executed after the remote tasks "
+					 "finished. When enabled, they are executed while the remote "
+					 "tasks are in flight."),
+		&EnableInterleavedLocalExecution,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_local_execution",
 		gettext_noop("Enables queries on shards that are local to the current node "
@@ -1407,6 +1565,19 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_repartition_join_bloom_filters",
+		gettext_noop("Enables bloom filters for inner repartition joins."),
+		gettext_noop("When enabled, Citus builds a bloom filter of the join keys "
+					 "on the smaller side of an inner dual partition join and "
+					 "skips rows on the other side that have no join partner "
+					 "before repartitioning them."),
+		&EnableRepartitionJoinBloomFilters,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_repartition_joins",
 		gettext_noop("Allows Citus to repartition data between nodes."),
@@ -1417,6 +1588,21 @@ RegisterCitusConfigVariables(void)
 		GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_repartitioned_aggregation",
+		gettext_noop("Enables finalizing aggregates on the workers when grouping "
+					 "by a column other than the distribution column."),
+		gettext_noop("When enabled, the partial aggregates of multi-shard queries "
+					 "are repartitioned by a GROUP BY column across the workers, "
+					 "which finalize the groups in parallel, such that only the "
+					 "final rows are sent to the coordinator. This helps queries "
+					 "with many groups, at the cost of an extra network round."),
+		&EnableRepartitionedAggregation,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_repartitioned_insert_select",
 		gettext_noop("Enables repartitioned INSERT/SELECTs"),
@@ -1451,6 +1637,19 @@ RegisterCitusConfigVariables(void)
 		GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_shard_query_templates",
+		gettext_noop("Enables deparsing multi-shard queries only once."),
+		gettext_noop("When enabled, a query that is sent to multiple shards is "
+					 "deparsed once with placeholders for the shard names, which "
+					 "are filled in for each task. When disabled, the query is "
+					 "deparsed for every task."),
+		&EnableShardQueryTemplates,
+		true,
+		PGC_USERSET,
+		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_single_hash_repartition_joins",
 		gettext_noop("Enables single hash repartitioning between hash "
@@ -1480,6 +1679,22 @@ RegisterCitusConfigVariables(void)
 		&StatisticsCollectionGucCheckHook,
 		NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_streaming_repartition_joins",
+		gettext_noop("Enables pushing repartitioned data directly to the nodes "
+					 "that consume it"),
+		gettext_noop("When enabled, the tasks that partition the data for a "
+					 "repartition join send each partition to the node that joins "
+					 "it as soon as partitioning finishes, rather than writing all "
+					 "partitions to disk and having the other nodes fetch them "
+					 "afterwards. Partitions that are too large to keep in memory "
+					 "are still fetched."),
+		&EnableStreamingRepartitionJoins,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_unique_job_ids",
 		gettext_noop("Enables unique job IDs by prepending the local process ID and "
@@ -1678,6 +1893,87 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomRealVariable(
+		"citus.hot_tenant_cpu_threshold",
+		gettext_noop("Sets the CPU usage per period above which a tenant is "
+					 "considered hot."),
+		gettext_noop("When citus.hot_tenant_isolation_interval is set, tenants "
+					 "whose CPU usage in seconds in the last period of "
+					 "citus_stat_tenants stays above this threshold are isolated "
+					 "to their own shard. 0 disables the threshold."),
+		&HotTenantCpuThreshold,
+		0.0, 0.0, 1000000.0,
+		PGC_SIGHUP,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.hot_tenant_isolation_interval",
+		gettext_noop("Sets the time to wait between checks for hot tenants."),
+		gettext_noop("The maintenance daemon periodically checks citus_stat_tenants "
+					 "for tenants that are above citus.hot_tenant_query_threshold "
+					 "or citus.hot_tenant_cpu_threshold, and schedules a background "
+					 "job that isolates such a tenant to its own shard and moves it "
+					 "to the least loaded node once it has been above them for "
+					 "citus.hot_tenant_sustain_time. Use -1 to disable."),
+		&HotTenantIsolationInterval,
+		-1, -1, 7 * MS_PER_DAY,
+		PGC_SIGHUP,
+		GUC_UNIT_MS,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.hot_tenant_query_threshold",
+		gettext_noop("Sets the number of queries per period above which a tenant "
+					 "is considered hot."),
+		gettext_noop("When citus.hot_tenant_isolation_interval is set, tenants "
+					 "whose query count in the last period of citus_stat_tenants "
+					 "stays above this threshold are isolated to their own shard. "
+					 "0 disables the threshold."),
+		&HotTenantQueryThreshold,
+		10000, 0, INT_MAX,
+		PGC_SIGHUP,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.hot_tenant_sustain_time",
+		gettext_noop("Sets how long a tenant has to be hot before it is isolated."),
+		NULL,
+		&HotTenantSustainTime,
+		600, 0, INT_MAX / 1000,
+		PGC_SIGHUP,
+		GUC_UNIT_S,
+		NULL, NULL, NULL);
+
+	DefineCustomEnumVariable(
+		"citus.intermediate_result_compression",
+		gettext_noop("Sets the compression method for intermediate results."),
+		gettext_noop("When enabled, intermediate results of CTEs, subqueries and "
+					 "repartition joins that are larger than "
+					 "citus.intermediate_result_compression_threshold are "
+					 "compressed before they are sent to other nodes and written "
+					 "to disk. Compressed results are recognized when they are "
+					 "read, regardless of this setting."),
+		&IntermediateResultCompression,
+		STREAM_COMPRESSION_NONE,
+		stream_compression_options,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.intermediate_result_compression_threshold",
+		gettext_noop("Sets the size above which intermediate results are compressed."),
+		gettext_noop("Intermediate results that are smaller than this size are "
+					 "sent uncompressed, since compressing them does not pay off. "
+					 "Results are buffered up to this size before they are sent."),
+		&IntermediateResultCompressionThreshold,
+		64, 0, 256 * 1024,
+		PGC_USERSET,
+		GUC_UNIT_KB | GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.isolation_test_session_process_id",
 		NULL,
@@ -1933,6 +2229,38 @@ RegisterCitusConfigVariables(void)
 		GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_copy_to_connections",
+		gettext_noop("Sets the maximum number of connections used concurrently to "
+					 "read shards for COPY .. TO STDOUT."),
+		gettext_noop("COPY .. TO STDOUT on a distributed table runs a COPY on each "
+					 "shard and forwards the rows to the client. When this is "
+					 "larger than 1, multiple shards are read concurrently, and "
+					 "COPY (query) TO STDOUT on a query of which the results do "
+					 "not need to be combined on the coordinator is also streamed "
+					 "from the shards."),
+		&MaxCopyToConnections,
+		1, 1, 1000,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_distribute_data_workers",
+		gettext_noop("Sets the maximum number of parallel workers used to copy "
+					 "the data of a local table into its shards when the table "
+					 "is distributed."),
+		gettext_noop("Parallel workers scan the local table and serialize its rows, "
+					 "while the backend that distributes the table sends them to "
+					 "the shards. Parallel copy is only used for large heap tables "
+					 "of which no shards are placed on the local node. 0 disables "
+					 "parallel copy."),
+		&MaxDistributeDataWorkers,
+		0, 0, 64,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.max_high_priority_background_processes",
 		gettext_noop("Sets the maximum number of background processes "
@@ -1969,6 +2297,23 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MB | GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_parallel_copy_workers",
+		gettext_noop("Sets the maximum number of parallel workers used to parse "
+					 "the input of a COPY into a distributed table."),
+		gettext_noop("The backend that runs the COPY splits the input into lines "
+					 "and sends them to parallel workers, which parse the rows and "
+					 "compute their shards, while the backend sends the rows to "
+					 "the shards. Parallel parsing is only used for text and CSV "
+					 "input into hash-distributed tables that includes all columns "
+					 "and of which no shards are placed on the local node. "
+					 "0 disables parallel parsing."),
+		&MaxParallelCopyWorkers,
+		0, 0, 64,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.max_rebalancer_logged_ignored_moves",
 		gettext_noop("Sets the maximum number of ignored moves the rebalance logs"),
@@ -1979,6 +2324,20 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_shard_copy_streams",
+		gettext_noop("Sets the maximum number of parallel streams used to copy "
+					 "a single shard during shard moves, copies and splits."),
+		gettext_noop("Shards that are larger than citus.shard_copy_chunk_size are "
+					 "copied in ranges of blocks by concurrent connections that read "
+					 "the shard using the same snapshot. 1 copies each shard using "
+					 "a single stream."),
+		&MaxShardCopyStreams,
+		1, 1, 64,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.max_shared_pool_size",
 		gettext_noop("Sets the maximum number of connections allowed per worker node "
@@ -2188,6 +2547,22 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.percentile_approximation_compression",
+		gettext_noop("Sets the compression of the t-digest sketches that approximate "
+					 "percentile_cont(). 0 disables approximations for "
+					 "percentile_cont()."),
+		gettext_noop("When set, percentile_cont() over double precision values is "
+					 "computed from t-digest sketches that the workers build and the "
+					 "coordinator merges, instead of pulling all rows to the "
+					 "coordinator. Higher values give more accurate percentiles with "
+					 "larger sketches."),
+		&PercentileApproximationCompression,
+		0, 0, 10000,
+		PGC_USERSET,
+		GUC_STANDARD,
+		PercentileApproximationCompressionCheckHook, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.prevent_incomplete_connection_establishment",
 		gettext_noop("When enabled, the executor waits until all the connections "
@@ -2282,6 +2657,19 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MS | GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.repartition_join_bloom_filter_max_rows",
+		gettext_noop("Sets the maximum number of rows for which a repartition "
+					 "join bloom filter is built."),
+		gettext_noop("A side of a repartition join only gets a bloom filter "
+					 "if each of its tasks returns at most this many rows and "
+					 "the filter holds at most this many keys in total."),
+		&RepartitionJoinBloomFilterMaxRows,
+		100000, 1, 10000000,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.repartition_join_bucket_count_per_node",
 		gettext_noop("Sets the bucket size for repartition joins per node"),
@@ -2348,6 +2736,32 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.shard_array_split_threshold",
+		gettext_noop("Sets the number of values above which a distribution column "
+					 "IN list is split across the shard queries."),
+		gettext_noop("When a multi-shard query filters the distribution column "
+					 "by an IN list or = ANY array with at least this many values, "
+					 "each shard query only receives the values that hash into its "
+					 "shard. 0 disables splitting."),
+		&ShardArraySplitThreshold,
+		32, 0, INT_MAX,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.shard_copy_chunk_size",
+		gettext_noop("Sets the amount of shard data that is copied by each stream "
+					 "when copying a shard using multiple streams."),
+		gettext_noop("A shard is only split into multiple copy streams if it is "
+					 "larger than this size, see citus.max_shard_copy_streams."),
+		&ShardCopyChunkSize,
+		1024 * 1024, 64, MAX_KILOBYTES,
+		PGC_USERSET,
+		GUC_UNIT_KB | GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.shard_count",
 		gettext_noop("Sets the number of shards for a new hash-partitioned table "
@@ -2372,6 +2786,40 @@ RegisterCitusConfigVariables(void)
 		GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomEnumVariable(
+		"citus.shard_transfer_compression",
+		gettext_noop("Sets the compression method for copying shards between nodes."),
+		gettext_noop("When enabled, shard moves and copies compress the data "
+					 "that the source node sends to the target node, both when "
+					 "blocking writes and for the initial copy before logical "
+					 "replication. The target node needs to support the same "
+					 "compression method."),
+		&ShardTransferCompression,
+		STREAM_COMPRESSION_NONE,
+		stream_compression_options,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.shard_transfer_resume_timeout",
+		gettext_noop("Sets how long the data copied by a failed shard move, copy "
+					 "or split is kept to resume the transfer."),
+		gettext_noop("When a shard move, copy or non-blocking split that uses "
+					 "logical replication fails after copying all shards of the "
+					 "shard group, the copied shards and the replication objects "
+					 "are kept for this long instead of being cleaned up. Retrying "
+					 "the same transfer within that time then only needs to catch "
+					 "up with the changes since the copy. A failure during the "
+					 "initial copy is not resumable, since the shards are copied "
+					 "under one snapshot, and a retry copies all shards again. 0 "
+					 "disables resuming shard transfers."),
+		&ShardTransferResumeTimeout,
+		0, 0, 7 * MS_PER_DAY,
+		PGC_SUSET,
+		GUC_UNIT_MS | GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomStringVariable(
 		"citus.show_shards_for_app_name_prefixes",
 		gettext_noop("If application_name starts with one of these values, show shards"),
@@ -2436,6 +2884,24 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.skip_row_validation_in_copy",
+		gettext_noop("Forward input lines to shards without parsing them on the "
+					 "coordinator during COPY into a distributed table"),
+		gettext_noop("Parsing and serializing every row on the coordinator may "
+					 "limit COPY throughput. If this GUC is set, only the "
+					 "distribution column of each input line is parsed on the "
+					 "coordinator and the line is sent to its shard as it is, which "
+					 "means the rows are validated by the workers and you cannot see "
+					 "the line number in case of malformed input. This setting only "
+					 "applies to text and CSV input that includes all columns, and "
+					 "does not apply to tables with local shards."),
+		&SkipRowValidationInCopy,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.sort_returning",
 		gettext_noop("Sorts the RETURNING clause to get consistent test output"),
@@ -2450,6 +2916,51 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.stat_shard_load_half_life",
+		gettext_noop("Sets the half-life of the shard load statistics that are "
+					 "used by the by_query_load rebalance strategy."),
+		gettext_noop("The CPU time, tuples read and queries that are recorded "
+					 "for a shard are halved every time this many seconds pass, "
+					 "such that the statistics reflect the recent load of the "
+					 "shard."),
+		&StatShardLoadHalfLife,
+		600, 1, 60 * 60 * 24 * 7,
+		PGC_SIGHUP,
+		GUC_UNIT_S | GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.stat_shard_load_limit",
+		gettext_noop("Sets the maximum number of shards for which the load "
+					 "statistics are kept on a node."),
+		gettext_noop("When the limit is reached, the statistics of the shards "
+					 "with the lowest load are removed to make room for new "
+					 "shards."),
+		&StatShardLoadLimit,
+		10000, 100, 1000000,
+		PGC_POSTMASTER,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomEnumVariable(
+		"citus.stat_shard_load_track",
+		gettext_noop("Enables/Disables the load statistics collection for the "
+					 "shards on a node."),
+		gettext_noop("Enables the collection of the CPU time, query count and "
+					 "tuples read of the queries on the shards of a node when "
+					 "set to 'all'. The tuples read are only counted when "
+					 "track_counts is enabled. The by_query_load rebalance "
+					 "strategy uses these statistics, hence this setting should "
+					 "be enabled on the nodes that hold shards when using that "
+					 "strategy."),
+		&StatShardLoadTrack,
+		STAT_SHARD_LOAD_TRACK_NONE,
+		stat_shard_load_track_options,
+		PGC_SUSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	/*
 	 * It takes about 140 bytes of shared memory to store one row, therefore
 	 * this setting should be used responsibly. setting it to 10M will require
@@ -2581,8 +3092,11 @@ RegisterCitusConfigVariables(void)
 					 "use when making these assignments. The greedy policy aims to "
 					 "evenly distribute tasks across worker nodes, first-replica just "
 					 "assigns tasks in the order shard placements were created, "
-					 "and the round-robin policy assigns tasks to worker nodes in "
-					 "a round-robin fashion."),
+					 "the round-robin policy assigns tasks to worker nodes in "
+					 "a round-robin fashion, and the adaptive policy assigns read "
+					 "tasks to the replica whose node currently has the lowest "
+					 "expected task latency based on recent task execution times "
+					 "and the number of running tasks."),
 		&TaskAssignmentPolicy,
 		TASK_ASSIGNMENT_GREEDY,
 		task_assignment_policy_options,
@@ -2743,6 +3257,25 @@ ErrorIfNotASuitableDeadlockFactor(double *newval, void **extra, GucSource source
 }
 
 
+/*
+ * PercentileApproximationCompressionCheckHook only accepts 0, which disables
+ * percentile_cont() approximations, and compressions from 10 up, below which
+ * t-digest sketches are too coarse to be useful.
+ */
+static bool
+PercentileApproximationCompressionCheckHook(int *newval, void **extra, GucSource source)
+{
+	if (*newval != DISABLE_PERCENTILE_APPROXIMATION && *newval < 10)
+	{
+		GUC_check_errdetail("citus.percentile_approximation_compression must be 0 "
+							"or at least 10.");
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * WarnIfDeprecatedExecutorUsed prints a warning and sets the config value to
  * adaptive executor (a.k.a., ignores real-time executor).
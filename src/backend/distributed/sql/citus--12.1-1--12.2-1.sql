@@ -55,3 +55,63 @@ DROP VIEW IF EXISTS pg_catalog.citus_lock_waits;
 #include "udfs/citus_internal_update_relation_colocation/12.2-1.sql"
 #include "udfs/repl_origin_helper/12.2-1.sql"
 #include "udfs/citus_finish_pg_upgrade/12.2-1.sql"
+#include "udfs/worker_partition_query_result/12.2-1.sql"
+#include "udfs/worker_build_bloom_filter/12.2-1.sql"
+#include "udfs/worker_partial_agg_binary/12.2-1.sql"
+#include "udfs/coord_combine_agg_binary/12.2-1.sql"
+#include "udfs/citus_hll_union_agg/12.2-1.sql"
+#include "udfs/citus_hll_add_agg/12.2-1.sql"
+#include "udfs/citus_hll_cardinality/12.2-1.sql"
+#include "udfs/citus_tdigest_union_agg/12.2-1.sql"
+#include "udfs/citus_tdigest_add_agg/12.2-1.sql"
+#include "udfs/citus_tdigest_percentile/12.2-1.sql"
+#include "udfs/citus_analyze/12.2-1.sql"
+#include "udfs/worker_copy_table_to_node/12.2-1.sql"
+#include "udfs/worker_split_copy/12.2-1.sql"
+#include "udfs/citus_create_distributed_table_progress/12.2-1.sql"
+
+-- Shards that a failed shard move, copy or split already copied to the target
+-- node, which lets a retry of the transfer reuse them until resumable_until.
+-- For splits, shardid is the new child shard of source_shardid and the
+-- shard_min_value and shard_max_value columns hold its hash range.
+CREATE TABLE citus.pg_dist_shard_transfer_progress (
+    operation_id bigint not null,
+    shardid bigint not null,
+    source_shardid bigint not null,
+    source_node_id int not null,
+    target_node_id int not null,
+    shard_min_value text,
+    shard_max_value text,
+    copied_at timestamptz not null default now(),
+    resumable_until timestamptz not null,
+    primary key (operation_id, shardid)
+);
+ALTER TABLE citus.pg_dist_shard_transfer_progress SET SCHEMA pg_catalog;
+GRANT SELECT ON pg_catalog.pg_dist_shard_transfer_progress TO public;
+
+#include "udfs/citus_shard_load_local/12.2-1.sql"
+#include "udfs/citus_shard_load_local_reset/12.2-1.sql"
+#include "udfs/citus_shard_cost_by_query_load/12.2-1.sql"
+
+INSERT INTO
+    pg_catalog.pg_dist_rebalance_strategy(
+        name,
+        default_strategy,
+        shard_cost_function,
+        node_capacity_function,
+        shard_allowed_on_node_function,
+        default_threshold,
+        minimum_threshold,
+        improvement_threshold
+    ) VALUES (
+        'by_query_load',
+        false,
+        'citus_shard_cost_by_query_load',
+        'citus_node_capacity_1',
+        'citus_shard_allowed_on_node_true',
+        0.1,
+        0.01,
+        0.5
+    );
+
+#include "udfs/citus_schedule_tenant_isolation/12.2-1.sql"
@@ -55,3 +55,57 @@ DROP FUNCTION citus_internal.start_replication_origin_tracking();
 DROP FUNCTION citus_internal.stop_replication_origin_tracking();
 DROP FUNCTION citus_internal.is_replication_origin_tracking_active();
 #include "../udfs/citus_finish_pg_upgrade/12.1-1.sql"
+
+DROP FUNCTION pg_catalog.worker_build_bloom_filter(text, int, bigint, int, bigint);
+DROP FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean, int[], bytea, text, int);
+CREATE OR REPLACE FUNCTION pg_catalog.worker_partition_query_result(
+    result_prefix text,
+    query text,
+    partition_column_index int,
+    partition_method citus.distribution_type,
+    partition_min_values text[],
+    partition_max_values text[],
+    binary_copy boolean,
+    allow_null_partition_column boolean DEFAULT false,
+    generate_empty_results boolean DEFAULT false,
+    OUT partition_index int,
+    OUT rows_written bigint,
+    OUT bytes_written bigint)
+RETURNS SETOF record
+LANGUAGE C STRICT VOLATILE
+AS 'MODULE_PATHNAME', $$worker_partition_query_result$$;
+COMMENT ON FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean)
+IS 'execute a query and partitions its results in set of local result files';
+
+DROP AGGREGATE pg_catalog.worker_partial_agg_binary(oid, anyelement);
+DROP FUNCTION pg_catalog.worker_partial_agg_binary_ffunc(internal);
+DROP AGGREGATE pg_catalog.coord_combine_agg_binary(oid, bytea, anyelement);
+DROP FUNCTION pg_catalog.coord_combine_agg_binary_ffunc(internal, oid, bytea, anyelement);
+DROP FUNCTION pg_catalog.coord_combine_agg_binary_sfunc(internal, oid, bytea, anyelement);
+
+DROP FUNCTION pg_catalog.citus_hll_cardinality(bytea);
+DROP AGGREGATE pg_catalog.citus_hll_add_agg(anyelement, int);
+DROP FUNCTION pg_catalog.citus_hll_add_sfunc(bytea, anyelement, int);
+DROP AGGREGATE pg_catalog.citus_hll_union_agg(bytea);
+DROP FUNCTION pg_catalog.citus_hll_union_sfunc(bytea, bytea);
+DROP FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision);
+DROP FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision[]);
+DROP AGGREGATE pg_catalog.citus_tdigest_add_agg(double precision, int);
+DROP FUNCTION pg_catalog.citus_tdigest_add_sfunc(bytea, double precision, int);
+DROP AGGREGATE pg_catalog.citus_tdigest_union_agg(bytea);
+DROP FUNCTION pg_catalog.citus_tdigest_union_sfunc(bytea, bytea);
+DROP FUNCTION pg_catalog.citus_tdigest_final(bytea);
+DROP FUNCTION pg_catalog.citus_analyze(regclass);
+
+DROP FUNCTION pg_catalog.worker_copy_table_to_node(regclass, integer, bigint, bigint);
+DROP FUNCTION pg_catalog.worker_split_copy(bigint, text, pg_catalog.split_copy_info[], bigint, bigint);
+DROP FUNCTION pg_catalog.citus_create_distributed_table_progress();
+
+DROP TABLE pg_catalog.pg_dist_shard_transfer_progress;
+
+DELETE FROM pg_catalog.pg_dist_rebalance_strategy WHERE name = 'by_query_load';
+DROP FUNCTION pg_catalog.citus_shard_cost_by_query_load(bigint);
+DROP FUNCTION pg_catalog.citus_shard_load_local_reset();
+DROP FUNCTION pg_catalog.citus_shard_load_local();
+
+DROP FUNCTION pg_catalog.citus_schedule_tenant_isolation(regclass, text, citus.shard_transfer_mode);
@@ -0,0 +1,6 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_analyze(relation regclass DEFAULT NULL)
+    RETURNS void
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$citus_analyze$$;
+COMMENT ON FUNCTION pg_catalog.citus_analyze(regclass)
+    IS 'gathers the statistics of the shards of the given table, or of all distributed tables, into the coordinator';
@@ -0,0 +1,12 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_create_distributed_table_progress()
+  RETURNS TABLE(pid integer,
+                table_name regclass,
+                parallel_workers integer,
+                total_blocks bigint,
+                blocks_scanned bigint,
+                rows_copied bigint
+            )
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C STRICT;
+COMMENT ON FUNCTION pg_catalog.citus_create_distributed_table_progress()
+    IS 'provides progress information about copying local data into shards while tables are distributed';
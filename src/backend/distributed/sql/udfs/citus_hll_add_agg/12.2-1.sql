@@ -0,0 +1,18 @@
+CREATE FUNCTION pg_catalog.citus_hll_add_sfunc(bytea, anyelement, int)
+RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_hll_add_sfunc(bytea, anyelement, int)
+    IS 'transition function for citus_hll_add_agg';
+
+CREATE AGGREGATE pg_catalog.citus_hll_add_agg(anyelement, int) (
+    STYPE = bytea,
+    SFUNC = pg_catalog.citus_hll_add_sfunc,
+    COMBINEFUNC = pg_catalog.citus_hll_union_sfunc,
+    PARALLEL = SAFE
+);
+COMMENT ON AGGREGATE pg_catalog.citus_hll_add_agg(anyelement, int)
+    IS 'builds a HyperLogLog sketch with 2^log2m registers of the distinct values';
+
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_hll_add_sfunc(bytea, anyelement, int) TO PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_hll_add_agg(anyelement, int) TO PUBLIC;
@@ -0,0 +1,8 @@
+CREATE FUNCTION pg_catalog.citus_hll_cardinality(bytea)
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_hll_cardinality(bytea)
+    IS 'estimates the number of distinct values in a HyperLogLog sketch';
+
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_hll_cardinality(bytea) TO PUBLIC;
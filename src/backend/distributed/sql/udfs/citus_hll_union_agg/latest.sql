@@ -0,0 +1,18 @@
+CREATE FUNCTION pg_catalog.citus_hll_union_sfunc(bytea, bytea)
+RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_hll_union_sfunc(bytea, bytea)
+    IS 'transition and combine function for citus_hll_union_agg and citus_hll_add_agg';
+
+CREATE AGGREGATE pg_catalog.citus_hll_union_agg(bytea) (
+    STYPE = bytea,
+    SFUNC = pg_catalog.citus_hll_union_sfunc,
+    COMBINEFUNC = pg_catalog.citus_hll_union_sfunc,
+    PARALLEL = SAFE
+);
+COMMENT ON AGGREGATE pg_catalog.citus_hll_union_agg(bytea)
+    IS 'merges HyperLogLog sketches built by citus_hll_add_agg';
+
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_hll_union_sfunc(bytea, bytea) TO PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_hll_union_agg(bytea) TO PUBLIC;
@@ -0,0 +1,12 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_schedule_tenant_isolation(
+    table_name regclass,
+    tenant_id text,
+    shard_transfer_mode citus.shard_transfer_mode DEFAULT 'auto')
+RETURNS bigint LANGUAGE C STRICT VOLATILE
+AS 'MODULE_PATHNAME', $$citus_schedule_tenant_isolation$$;
+
+COMMENT ON FUNCTION pg_catalog.citus_schedule_tenant_isolation(
+    table_name regclass,
+    tenant_id text,
+    shard_transfer_mode citus.shard_transfer_mode)
+IS 'isolate a tenant to its own shard and move it to the least loaded node in the background';
@@ -0,0 +1,12 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_shard_load_local(
+    OUT shardid bigint,
+    OUT query_count double precision,
+    OUT cpu_seconds double precision,
+    OUT tuples_read double precision,
+    OUT load double precision)
+RETURNS SETOF RECORD
+LANGUAGE C STRICT VOLATILE
+AS 'MODULE_PATHNAME', $$citus_shard_load_local$$;
+
+COMMENT ON FUNCTION pg_catalog.citus_shard_load_local()
+    IS 'returns the recent query load on the shards on the local node';
@@ -0,0 +1,9 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_shard_load_local_reset()
+    RETURNS VOID
+    LANGUAGE C STRICT
+AS 'MODULE_PATHNAME', $$citus_shard_load_local_reset$$;
+
+COMMENT ON FUNCTION pg_catalog.citus_shard_load_local_reset()
+    IS 'resets the query load statistics of the shards on the local node';
+
+REVOKE ALL ON FUNCTION pg_catalog.citus_shard_load_local_reset() FROM PUBLIC;
@@ -0,0 +1,19 @@
+CREATE FUNCTION pg_catalog.citus_tdigest_add_sfunc(bytea, double precision, int)
+RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_tdigest_add_sfunc(bytea, double precision, int)
+    IS 'transition function for citus_tdigest_add_agg';
+
+CREATE AGGREGATE pg_catalog.citus_tdigest_add_agg(double precision, int) (
+    STYPE = bytea,
+    SFUNC = pg_catalog.citus_tdigest_add_sfunc,
+    COMBINEFUNC = pg_catalog.citus_tdigest_union_sfunc,
+    FINALFUNC = pg_catalog.citus_tdigest_final,
+    PARALLEL = SAFE
+);
+COMMENT ON AGGREGATE pg_catalog.citus_tdigest_add_agg(double precision, int)
+    IS 'builds a t-digest sketch of the values with the given compression';
+
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_tdigest_add_sfunc(bytea, double precision, int) TO PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_tdigest_add_agg(double precision, int) TO PUBLIC;
@@ -0,0 +1,16 @@
+CREATE FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision)
+RETURNS double precision
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision)
+    IS 'estimates a continuous percentile of the values in a t-digest sketch';
+
+CREATE FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision[])
+RETURNS double precision[]
+AS 'MODULE_PATHNAME', $$citus_tdigest_percentile_array$$
+LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision[])
+    IS 'estimates continuous percentiles of the values in a t-digest sketch';
+
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision) TO PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_tdigest_percentile(bytea, double precision[]) TO PUBLIC;
@@ -0,0 +1,27 @@
+CREATE FUNCTION pg_catalog.citus_tdigest_union_sfunc(bytea, bytea)
+RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_tdigest_union_sfunc(bytea, bytea)
+    IS 'transition and combine function for citus_tdigest_union_agg and citus_tdigest_add_agg';
+
+CREATE FUNCTION pg_catalog.citus_tdigest_final(bytea)
+RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+COMMENT ON FUNCTION pg_catalog.citus_tdigest_final(bytea)
+    IS 'final function for citus_tdigest_union_agg and citus_tdigest_add_agg';
+
+CREATE AGGREGATE pg_catalog.citus_tdigest_union_agg(bytea) (
+    STYPE = bytea,
+    SFUNC = pg_catalog.citus_tdigest_union_sfunc,
+    COMBINEFUNC = pg_catalog.citus_tdigest_union_sfunc,
+    FINALFUNC = pg_catalog.citus_tdigest_final,
+    PARALLEL = SAFE
+);
+COMMENT ON AGGREGATE pg_catalog.citus_tdigest_union_agg(bytea)
+    IS 'merges t-digest sketches built by citus_tdigest_add_agg';
+
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_tdigest_union_sfunc(bytea, bytea) TO PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_tdigest_final(bytea) TO PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_catalog.citus_tdigest_union_agg(bytea) TO PUBLIC;
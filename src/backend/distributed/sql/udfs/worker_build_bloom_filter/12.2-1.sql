@@ -0,0 +1,11 @@
+CREATE OR REPLACE FUNCTION pg_catalog.worker_build_bloom_filter(
+    query text,
+    column_index int,
+    bit_count bigint,
+    hash_count int,
+    max_rows bigint)
+RETURNS bytea
+LANGUAGE C STRICT VOLATILE
+AS 'MODULE_PATHNAME', $$worker_build_bloom_filter$$;
+COMMENT ON FUNCTION pg_catalog.worker_build_bloom_filter(text, int, bigint, int, bigint)
+IS 'execute a query and build a bloom filter of the values in a column, unless it returns more than max_rows rows';
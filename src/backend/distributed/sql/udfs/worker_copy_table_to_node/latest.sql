@@ -6,3 +6,14 @@ LANGUAGE C STRICT
 AS 'MODULE_PATHNAME', $$worker_copy_table_to_node$$;
 COMMENT ON FUNCTION pg_catalog.worker_copy_table_to_node(regclass, integer)
     IS 'Perform copy of a shard';
+
+CREATE OR REPLACE FUNCTION pg_catalog.worker_copy_table_to_node(
+    source_table regclass,
+    target_node_id integer,
+    start_block bigint,
+    end_block bigint)
+RETURNS void
+LANGUAGE C
+AS 'MODULE_PATHNAME', $$worker_copy_table_to_node$$;
+COMMENT ON FUNCTION pg_catalog.worker_copy_table_to_node(regclass, integer, bigint, bigint)
+    IS 'Perform copy of a range of blocks of a shard';
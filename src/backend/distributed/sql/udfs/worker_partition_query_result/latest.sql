@@ -1,4 +1,4 @@
-DROP FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean);
+DROP FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean);
 
 CREATE OR REPLACE FUNCTION pg_catalog.worker_partition_query_result(
     result_prefix text,
@@ -10,11 +10,15 @@ CREATE OR REPLACE FUNCTION pg_catalog.worker_partition_query_result(
     binary_copy boolean,
     allow_null_partition_column boolean DEFAULT false,
     generate_empty_results boolean DEFAULT false,
+    target_node_ids int[] DEFAULT '{}',
+    bloom_filter bytea DEFAULT '',
+    compression text DEFAULT '',
+    compression_threshold int DEFAULT 64,
     OUT partition_index int,
     OUT rows_written bigint,
     OUT bytes_written bigint)
 RETURNS SETOF record
 LANGUAGE C STRICT VOLATILE
 AS 'MODULE_PATHNAME', $$worker_partition_query_result$$;
-COMMENT ON FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean)
-IS 'execute a query and partitions its results in set of local result files';
+COMMENT ON FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean, int[], bytea, text, int)
+IS 'execute a query and partitions its results in set of local result files, optionally compressing them, pushing them to the nodes that consume them and skipping rows that are not in a bloom filter';
@@ -82,9 +82,11 @@ partition_task_list_results(PG_FUNCTION_ARGS)
 		partitionColumnIndex = targetRelation->partitionColumn->varattno - 1;
 	}
 
+	bool allowNullPartitionColumnValues = false;
 	List *fragmentList = PartitionTasklistResults(resultIdPrefix, taskList,
 												  partitionColumnIndex,
-												  targetRelation, binaryFormat);
+												  targetRelation, binaryFormat,
+												  allowNullPartitionColumnValues);
 
 	TupleDesc tupleDescriptor = NULL;
 	Tuplestorestate *tupleStore = SetupTuplestore(fcinfo, &tupleDescriptor);
@@ -149,9 +151,11 @@ redistribute_task_list_results(PG_FUNCTION_ARGS)
 														  DISTRIBUTED_TABLE) ?
 							   targetRelation->partitionColumn->varattno - 1 : 0;
 
+	bool allowNullPartitionColumnValues = false;
 	List **shardResultIds = RedistributeTaskListResults(resultIdPrefix, taskList,
 														partitionColumnIndex,
-														targetRelation, binaryFormat);
+														targetRelation, binaryFormat,
+														allowNullPartitionColumnValues);
 
 	TupleDesc tupleDescriptor = NULL;
 	Tuplestorestate *tupleStore = SetupTuplestore(fcinfo, &tupleDescriptor);
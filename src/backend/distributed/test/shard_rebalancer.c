@@ -17,7 +17,9 @@
 #include "miscadmin.h"
 #include "safe_lib.h"
 
+#include "access/htup_details.h"
 #include "catalog/pg_type.h"
+#include "portability/instr_time.h"
 #include "utils/builtins.h"
 #include "utils/json.h"
 #include "utils/lsyscache.h"
@@ -48,10 +50,15 @@ static ArrayType * PlacementUpdateListToJsonArray(List *placementUpdateList);
 static bool ShardAllowedOnNode(uint64 shardId, WorkerNode *workerNode, void *context);
 static float NodeCapacity(WorkerNode *workerNode, void *context);
 static ShardCost GetShardCost(uint64 shardId, void *context);
+static bool BenchmarkShardAllowedOnNode(uint64 shardId, WorkerNode *workerNode,
+										void *context);
+static float BenchmarkNodeCapacity(WorkerNode *workerNode, void *context);
+static ShardCost BenchmarkShardCost(uint64 shardId, void *context);
 
 
 PG_FUNCTION_INFO_V1(shard_placement_rebalance_array);
 PG_FUNCTION_INFO_V1(shard_placement_replication_array);
+PG_FUNCTION_INFO_V1(shard_placement_rebalance_benchmark);
 PG_FUNCTION_INFO_V1(worker_node_responsive);
 PG_FUNCTION_INFO_V1(run_try_drop_marked_resources);
 
@@ -75,6 +82,12 @@ typedef struct RebalancePlanContext
 	List *shardPlacementTestInfoList;
 } RebalancePlacementContext;
 
+typedef struct RebalanceBenchmarkContext
+{
+	/* cost of each shard, indexed by shard id */
+	float4 *shardCosts;
+} RebalanceBenchmarkContext;
+
 /*
  * run_try_drop_marked_resources is a wrapper to run TryDropOrphanedResources.
  */
@@ -264,6 +277,174 @@ GetShardCost(uint64 shardId, void *voidContext)
 }
 
 
+/*
+ * shard_placement_rebalance_benchmark generates a synthetic cluster and returns
+ * the number of moves in its rebalance plan together with the time it took to
+ * compute that plan. The shards of each colocation group are placed
+ * round-robin on the first half of the nodes, as if the cluster had just been
+ * doubled in size. The cost of a shard varies between 1 and max_shard_cost.
+ */
+Datum
+shard_placement_rebalance_benchmark(PG_FUNCTION_ARGS)
+{
+	int32 nodeCount = PG_GETARG_INT32(0);
+	int32 shardCount = PG_GETARG_INT32(1);
+	int32 colocationGroupCount = PG_GETARG_INT32(2);
+	int32 maxShardCost = PG_GETARG_INT32(3);
+	float threshold = PG_GETARG_FLOAT4(4);
+	float utilizationImproventThreshold = PG_GETARG_FLOAT4(5);
+
+	if (nodeCount < 1 || shardCount < 1 || colocationGroupCount < 1 ||
+		maxShardCost < 1)
+	{
+		ereport(ERROR, (errmsg("node_count, shard_count, colocation_group_count "
+							   "and max_shard_cost must be positive")));
+	}
+
+	TupleDesc tupleDescriptor = NULL;
+	if (get_call_result_type(fcinfo, NULL, &tupleDescriptor) != TYPEFUNC_COMPOSITE)
+	{
+		elog(ERROR, "return type must be a row type");
+	}
+
+	List *workerNodeList = NIL;
+	for (int nodeIndex = 0; nodeIndex < nodeCount; nodeIndex++)
+	{
+		WorkerNode *workerNode = palloc0(sizeof(WorkerNode));
+		SafeSnprintf(workerNode->workerName, sizeof(workerNode->workerName),
+					 "node-%d", nodeIndex);
+		workerNode->nodeId = nodeIndex;
+		workerNode->workerPort = 5432;
+		workerNode->shouldHaveShards = true;
+		workerNode->isActive = true;
+		workerNode->nodeRole = PrimaryNodeRoleId();
+
+		workerNodeList = lappend(workerNodeList, workerNode);
+	}
+
+	RebalanceBenchmarkContext context = {
+		.shardCosts = palloc0((shardCount + 1) * sizeof(float4)),
+	};
+
+	List **placementListArray = palloc0(colocationGroupCount * sizeof(List *));
+	int occupiedNodeCount = Max(nodeCount / 2, 1);
+	for (uint64 shardId = 1; shardId <= (uint64) shardCount; shardId++)
+	{
+		int colocationGroupIndex = (shardId - 1) % colocationGroupCount;
+		int shardIndex = (shardId - 1) / colocationGroupCount;
+		WorkerNode *workerNode = list_nth(workerNodeList,
+										  shardIndex % occupiedNodeCount);
+
+		ShardPlacement *placement = palloc0(sizeof(ShardPlacement));
+		placement->placementId = shardId;
+		placement->shardId = shardId;
+		placement->nodeName = workerNode->workerName;
+		placement->nodePort = workerNode->workerPort;
+		placement->nodeId = workerNode->nodeId;
+
+		placementListArray[colocationGroupIndex] =
+			lappend(placementListArray[colocationGroupIndex], placement);
+
+		/* spread the costs deterministically over [1, maxShardCost] */
+		context.shardCosts[shardId] = 1 + (shardId * 7919) % maxShardCost;
+	}
+
+	/* colocation groups with fewer shards than nodes are balanced together */
+	List *shardPlacementListList = NIL;
+	List *unbalancedShards = NIL;
+	for (int groupIndex = 0; groupIndex < colocationGroupCount; groupIndex++)
+	{
+		List *placementList = placementListArray[groupIndex];
+
+		if (list_length(placementList) < nodeCount)
+		{
+			unbalancedShards = list_concat(unbalancedShards, placementList);
+		}
+		else
+		{
+			shardPlacementListList = lappend(shardPlacementListList, placementList);
+		}
+	}
+
+	if (list_length(unbalancedShards) > 0)
+	{
+		shardPlacementListList = lappend(shardPlacementListList, unbalancedShards);
+	}
+
+	RebalancePlanFunctions rebalancePlanFunctions = {
+		.shardAllowedOnNode = BenchmarkShardAllowedOnNode,
+		.nodeCapacity = BenchmarkNodeCapacity,
+		.shardCost = BenchmarkShardCost,
+		.context = &context,
+	};
+
+	instr_time planningStart;
+	instr_time planningDuration;
+	INSTR_TIME_SET_CURRENT(planningStart);
+
+	List *placementUpdateList = RebalancePlacementUpdates(workerNodeList,
+														  shardPlacementListList,
+														  threshold,
+														  PG_INT32_MAX,
+														  false,
+														  utilizationImproventThreshold,
+														  &rebalancePlanFunctions);
+
+	INSTR_TIME_SET_CURRENT(planningDuration);
+	INSTR_TIME_SUBTRACT(planningDuration, planningStart);
+
+	Datum values[2];
+	bool isNulls[2];
+	memset(isNulls, false, sizeof(isNulls));
+
+	values[0] = Int32GetDatum(list_length(placementUpdateList));
+	values[1] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(planningDuration));
+
+	HeapTuple tuple = heap_form_tuple(tupleDescriptor, values, isNulls);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(tuple));
+}
+
+
+/*
+ * BenchmarkShardAllowedOnNode allows every shard on every node of the
+ * synthetic cluster of shard_placement_rebalance_benchmark.
+ */
+static bool
+BenchmarkShardAllowedOnNode(uint64 shardId, WorkerNode *workerNode, void *voidContext)
+{
+	return true;
+}
+
+
+/*
+ * BenchmarkNodeCapacity gives every node of the synthetic cluster of
+ * shard_placement_rebalance_benchmark the same capacity.
+ */
+static float
+BenchmarkNodeCapacity(WorkerNode *workerNode, void *voidContext)
+{
+	return 1;
+}
+
+
+/*
+ * BenchmarkShardCost looks up the cost of a shard in the synthetic cluster of
+ * shard_placement_rebalance_benchmark. Unlike GetShardCost this is a constant
+ * time lookup, so that the benchmark only measures the planner itself.
+ */
+static ShardCost
+BenchmarkShardCost(uint64 shardId, void *voidContext)
+{
+	RebalanceBenchmarkContext *context = voidContext;
+	ShardCost shardCost;
+	memset_struct_0(shardCost);
+	shardCost.shardId = shardId;
+	shardCost.cost = context->shardCosts[shardId];
+	return shardCost;
+}
+
+
 /*
  * shard_placement_replication_array returns a list of operations which will
  * replicate under-replicated shards in a cluster consisting of given shard
@@ -366,6 +366,9 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 			 */
 			DeallocateReservedConnections();
 
+			/* give back in-flight task counts of abandoned task executions, if any */
+			ReleaseNodeInFlightTaskCounts();
+
 			UnSetDistributedTransactionId();
 
 			PlacementMovedUsingLogicalReplicationInTX = false;
@@ -459,6 +462,9 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 			 */
 			DeallocateReservedConnections();
 
+			/* give back in-flight task counts of abandoned task executions, if any */
+			ReleaseNodeInFlightTaskCounts();
+
 			/*
 			 * We reset these mainly for posterity. The only way we would normally
 			 * get here with ExecutorLevel or PlannerLevel > 0 is during a fatal
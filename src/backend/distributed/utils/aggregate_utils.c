@@ -8,6 +8,12 @@
  * calling finalfunc on workers, instead passing state to coordinator where
  * it uses combinefunc in coord_combine_agg & applying finalfunc only at end.
  *
+ * worker_partial_agg & coord_combine_agg pass the state in its text form.
+ * When the state can be passed in binary form, worker_partial_agg_binary &
+ * coord_combine_agg_binary are used instead, which use the serialfunc &
+ * deserialfunc of aggregates with an internal state, and the send & receive
+ * functions of the state type otherwise.
+ *
  * Copyright Citus Data, Inc.
  *
  *-------------------------------------------------------------------------
@@ -26,6 +32,7 @@
 #include "catalog/pg_type.h"
 #include "nodes/nodeFuncs.h"
 #include "utils/acl.h"
+#include "lib/stringinfo.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
@@ -38,6 +45,8 @@ PG_FUNCTION_INFO_V1(worker_partial_agg_sfunc);
 PG_FUNCTION_INFO_V1(worker_partial_agg_ffunc);
 PG_FUNCTION_INFO_V1(coord_combine_agg_sfunc);
 PG_FUNCTION_INFO_V1(coord_combine_agg_ffunc);
+PG_FUNCTION_INFO_V1(worker_partial_agg_binary_ffunc);
+PG_FUNCTION_INFO_V1(coord_combine_agg_binary_sfunc);
 
 /*
  * Holds information describing the structure of aggregation arguments
@@ -94,6 +103,13 @@ static void ExtractAggregationValues(FunctionCallInfo fcinfo, int argumentIndex,
 static void HandleTransition(StypeBox *box, FunctionCallInfo fcinfo,
 							 FunctionCallInfo innerFcinfo);
 static void HandleStrictUninit(StypeBox *box, FunctionCallInfo fcinfo, Datum value);
+static StypeBox * CoordCombineAggStypeBox(FunctionCallInfo fcinfo,
+										  const char *functionName,
+										  bool supportsInternalState,
+										  Oid *combineFunctionId,
+										  Oid *deserialFunctionId);
+static void HandleCombine(StypeBox *box, FunctionCallInfo fcinfo, Oid combine,
+						  Datum value, bool valueNull);
 static bool TypecheckWorkerPartialAggArgType(FunctionCallInfo fcinfo, StypeBox *box);
 static bool TypecheckCoordCombineAggReturnType(FunctionCallInfo fcinfo, Oid ffunc,
 											   StypeBox *box);
@@ -666,6 +682,82 @@ worker_partial_agg_ffunc(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * worker_partial_agg_binary_ffunc serializes transition state in binary form,
+ * essentially implementing the following pseudocode:
+ *
+ * (box) -> bytea
+ * return box.agg.serialfunc(box.value)
+ *
+ * For aggregates without an internal transition state, the send function of
+ * the state type is used in place of the serialfunc.
+ */
+Datum
+worker_partial_agg_binary_ffunc(PG_FUNCTION_ARGS)
+{
+	FmgrInfo info;
+	StypeBox *box = (StypeBox *) (PG_ARGISNULL(0) ? NULL : PG_GETARG_POINTER(0));
+	Form_pg_aggregate aggform;
+
+	if (box == NULL)
+	{
+		box = TryCreateStypeBoxFromFcinfoAggref(fcinfo);
+	}
+
+	if (box == NULL || box->valueNull)
+	{
+		PG_RETURN_NULL();
+	}
+
+	HeapTuple aggtuple = GetAggregateForm(box->agg, &aggform);
+
+	if (aggform->aggcombinefn == InvalidOid)
+	{
+		ereport(ERROR, (errmsg("worker_partial_agg_binary_ffunc expects an "
+							   "aggregate with COMBINEFUNC")));
+	}
+
+	if (aggform->aggtranstype == INTERNALOID &&
+		aggform->aggserialfn == InvalidOid)
+	{
+		ereport(ERROR, (errmsg("worker_partial_agg_binary_ffunc does not support "
+							   "aggregates with INTERNAL transition state without "
+							   "SERIALFUNC")));
+	}
+
+	Oid transtype = aggform->aggtranstype;
+	Oid serial = aggform->aggserialfn;
+	ReleaseSysCache(aggtuple);
+
+	if (transtype == INTERNALOID)
+	{
+		LOCAL_FCINFO(innerFcinfo, 1);
+
+		/* serialfunc needs to run in the aggregate context */
+		fmgr_info(serial, &info);
+		InitFunctionCallInfoData(*innerFcinfo, &info, 1, fcinfo->fncollation,
+								 fcinfo->context, fcinfo->resultinfo);
+		fcSetArgExt(innerFcinfo, 0, box->value, box->valueNull);
+
+		Datum result = FunctionCallInvoke(innerFcinfo);
+
+		if (innerFcinfo->isnull)
+		{
+			PG_RETURN_NULL();
+		}
+		PG_RETURN_DATUM(result);
+	}
+
+	Oid typsend = InvalidOid;
+	bool typIsVarlena = false;
+
+	getTypeBinaryOutputInfo(transtype, &typsend, &typIsVarlena);
+	fmgr_info(typsend, &info);
+
+	PG_RETURN_BYTEA_P(SendFunctionCall(&info, box->value));
+}
+
+
 /*
  * coord_combine_agg_sfunc deserializes transition state from worker
  * & advances transition state using combinefunc,
@@ -681,9 +773,130 @@ coord_combine_agg_sfunc(PG_FUNCTION_ARGS)
 {
 	LOCAL_FCINFO(innerFcinfo, 3);
 	FmgrInfo info;
-	Form_pg_aggregate aggform;
 	Form_pg_type transtypeform;
 	Datum value;
+	Oid combine = InvalidOid;
+	Oid deserial = InvalidOid;
+
+	StypeBox *box = CoordCombineAggStypeBox(fcinfo, "coord_combine_agg_sfunc", false,
+											&combine, &deserial);
+
+	bool valueNull = PG_ARGISNULL(2);
+	HeapTuple transtypetuple = GetTypeForm(box->transtype, &transtypeform);
+	Oid ioparam = getTypeIOParam(transtypetuple);
+	Oid typinput = transtypeform->typinput;
+	ReleaseSysCache(transtypetuple);
+
+	fmgr_info(typinput, &info);
+	if (valueNull && info.fn_strict)
+	{
+		value = (Datum) 0;
+	}
+	else
+	{
+		InitFunctionCallInfoData(*innerFcinfo, &info, 3, fcinfo->fncollation,
+								 fcinfo->context, fcinfo->resultinfo);
+		fcSetArgExt(innerFcinfo, 0, PG_GETARG_DATUM(2), valueNull);
+		fcSetArg(innerFcinfo, 1, ObjectIdGetDatum(ioparam));
+		fcSetArg(innerFcinfo, 2, Int32GetDatum(-1)); /* typmod */
+
+		value = FunctionCallInvoke(innerFcinfo);
+		valueNull = innerFcinfo->isnull;
+	}
+
+	HandleCombine(box, fcinfo, combine, value, valueNull);
+
+	PG_RETURN_POINTER(box);
+}
+
+
+/*
+ * coord_combine_agg_binary_sfunc is the equivalent of coord_combine_agg_sfunc
+ * for transition states in binary form, essentially implementing the following
+ * pseudocode:
+ *
+ * (box, agg, bytea) -> box
+ * box.agg = agg
+ * box.value = agg.combine(box.value, agg.deserialfunc(bytea))
+ * return box
+ *
+ * For aggregates without an internal transition state, the receive function of
+ * the state type is used in place of the deserialfunc.
+ */
+Datum
+coord_combine_agg_binary_sfunc(PG_FUNCTION_ARGS)
+{
+	FmgrInfo info;
+	Datum value = (Datum) 0;
+	bool valueNull = PG_ARGISNULL(2);
+	Oid combine = InvalidOid;
+	Oid deserial = InvalidOid;
+
+	StypeBox *box = CoordCombineAggStypeBox(fcinfo, "coord_combine_agg_binary_sfunc",
+											true, &combine, &deserial);
+
+	if (box->transtype == INTERNALOID)
+	{
+		LOCAL_FCINFO(innerFcinfo, 2);
+
+		/* deserialfunc is strict, and needs to run in the aggregate context */
+		if (!valueNull)
+		{
+			fmgr_info(deserial, &info);
+			InitFunctionCallInfoData(*innerFcinfo, &info, 2, fcinfo->fncollation,
+									 fcinfo->context, fcinfo->resultinfo);
+			fcSetArg(innerFcinfo, 0, PointerGetDatum(PG_GETARG_BYTEA_PP(2)));
+			fcSetArg(innerFcinfo, 1, (Datum) 0); /* dummy argument */
+
+			value = FunctionCallInvoke(innerFcinfo);
+			valueNull = innerFcinfo->isnull;
+		}
+	}
+	else
+	{
+		Oid typreceive = InvalidOid;
+		Oid ioparam = InvalidOid;
+		StringInfoData buffer;
+		StringInfo bufferPointer = NULL;
+
+		getTypeBinaryInputInfo(box->transtype, &typreceive, &ioparam);
+		fmgr_info(typreceive, &info);
+
+		if (!valueNull)
+		{
+			bytea *serializedValue = PG_GETARG_BYTEA_PP(2);
+
+			/* receive functions expect a null-terminated buffer */
+			initStringInfo(&buffer);
+			appendBinaryStringInfo(&buffer, VARDATA_ANY(serializedValue),
+								   VARSIZE_ANY_EXHDR(serializedValue));
+			bufferPointer = &buffer;
+		}
+
+		value = ReceiveFunctionCall(&info, bufferPointer, ioparam, -1);
+		valueNull = (bufferPointer == NULL);
+	}
+
+	HandleCombine(box, fcinfo, combine, value, valueNull);
+
+	PG_RETURN_POINTER(box);
+}
+
+
+/*
+ * CoordCombineAggStypeBox returns the StypeBox of the coord_combine_agg
+ * transition function call in fcinfo, initializing it on the first call. It
+ * also sets the combinefunc and deserialfunc of the aggregate.
+ *
+ * Aggregates with an internal transition state are only supported when the
+ * caller can deserialize them, which requires a deserialfunc.
+ */
+static StypeBox *
+CoordCombineAggStypeBox(FunctionCallInfo fcinfo, const char *functionName,
+						bool supportsInternalState, Oid *combineFunctionId,
+						Oid *deserialFunctionId)
+{
+	Form_pg_aggregate aggform;
 	StypeBox *box = NULL;
 
 	if (PG_ARGISNULL(0))
@@ -701,18 +914,20 @@ coord_combine_agg_sfunc(PG_FUNCTION_ARGS)
 
 	if (aggform->aggcombinefn == InvalidOid)
 	{
-		ereport(ERROR, (errmsg(
-							"coord_combine_agg_sfunc expects an aggregate with COMBINEFUNC")));
+		ereport(ERROR, (errmsg("%s expects an aggregate with COMBINEFUNC",
+							   functionName)));
 	}
 
-	if (aggform->aggtranstype == INTERNALOID)
+	if (aggform->aggtranstype == INTERNALOID &&
+		(!supportsInternalState || aggform->aggdeserialfn == InvalidOid))
 	{
 		ereport(ERROR,
-				(errmsg(
-					 "coord_combine_agg_sfunc does not support aggregates with INTERNAL transition state")));
+				(errmsg("%s does not support aggregates with INTERNAL "
+						"transition state", functionName)));
 	}
 
-	Oid combine = aggform->aggcombinefn;
+	*combineFunctionId = aggform->aggcombinefn;
+	*deserialFunctionId = aggform->aggdeserialfn;
 
 	if (PG_ARGISNULL(0))
 	{
@@ -728,28 +943,20 @@ coord_combine_agg_sfunc(PG_FUNCTION_ARGS)
 						&box->transtypeByVal);
 	}
 
-	bool valueNull = PG_ARGISNULL(2);
-	HeapTuple transtypetuple = GetTypeForm(box->transtype, &transtypeform);
-	Oid ioparam = getTypeIOParam(transtypetuple);
-	Oid deserial = transtypeform->typinput;
-	ReleaseSysCache(transtypetuple);
+	return box;
+}
 
-	fmgr_info(deserial, &info);
-	if (valueNull && info.fn_strict)
-	{
-		value = (Datum) 0;
-	}
-	else
-	{
-		InitFunctionCallInfoData(*innerFcinfo, &info, 3, fcinfo->fncollation,
-								 fcinfo->context, fcinfo->resultinfo);
-		fcSetArgExt(innerFcinfo, 0, PG_GETARG_DATUM(2), valueNull);
-		fcSetArg(innerFcinfo, 1, ObjectIdGetDatum(ioparam));
-		fcSetArg(innerFcinfo, 2, Int32GetDatum(-1)); /* typmod */
 
-		value = FunctionCallInvoke(innerFcinfo);
-		valueNull = innerFcinfo->isnull;
-	}
+/*
+ * HandleCombine advances the transition state in box by combining it with the
+ * given deserialized transition state of a worker using combinefunc.
+ */
+static void
+HandleCombine(StypeBox *box, FunctionCallInfo fcinfo, Oid combine, Datum value,
+			  bool valueNull)
+{
+	LOCAL_FCINFO(innerFcinfo, 2);
+	FmgrInfo info;
 
 	fmgr_info(combine, &info);
 
@@ -757,18 +964,18 @@ coord_combine_agg_sfunc(PG_FUNCTION_ARGS)
 	{
 		if (valueNull)
 		{
-			PG_RETURN_POINTER(box);
+			return;
 		}
 
 		if (!box->valueInit)
 		{
 			HandleStrictUninit(box, fcinfo, value);
-			PG_RETURN_POINTER(box);
+			return;
 		}
 
 		if (box->valueNull)
 		{
-			PG_RETURN_POINTER(box);
+			return;
 		}
 	}
 
@@ -778,8 +985,6 @@ coord_combine_agg_sfunc(PG_FUNCTION_ARGS)
 	fcSetArgExt(innerFcinfo, 1, value, valueNull);
 
 	HandleTransition(box, fcinfo, innerFcinfo);
-
-	PG_RETURN_POINTER(box);
 }
 
 
@@ -0,0 +1,244 @@
+/*-------------------------------------------------------------------------
+ *
+ * bloom_filter.c
+ *	  Utility functions for building and probing bloom filters over hash
+ *	  values, such as the hashes of join keys.
+ *
+ * The bit positions of an element are derived from its 32-bit hash value
+ * using double hashing. Since the number of bits is always a power of 2,
+ * a filter can be folded in half by OR-ing both halves, which allows us to
+ * shrink a filter once we know how many elements it contains.
+ *
+ * A serialized filter consists of the hash count as a 32-bit integer and the
+ * element count as a 64-bit integer in network byte order, followed by the
+ * bits.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "safe_lib.h"
+
+#include "common/hashfn.h"
+#include "port/pg_bitutils.h"
+#include "port/pg_bswap.h"
+
+#include "distributed/utils/bloom_filter.h"
+
+
+#define BLOOM_FILTER_HEADER_LENGTH (sizeof(uint32) + sizeof(uint64))
+
+
+static uint64 BloomFilterBitPosition(BloomFilter *filter, uint32 hashValue,
+									 uint32 hashIndex);
+
+
+/*
+ * CreateBloomFilter returns an empty bloom filter with at least the given
+ * number of bits, rounded up to a power of 2.
+ */
+BloomFilter *
+CreateBloomFilter(uint64 bitCount, uint32 hashCount)
+{
+	if (bitCount < BLOOM_FILTER_MIN_BIT_COUNT)
+	{
+		bitCount = BLOOM_FILTER_MIN_BIT_COUNT;
+	}
+
+	if (bitCount > (uint64) MaxAllocSize * 8)
+	{
+		ereport(ERROR, (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+						errmsg("bloom filter of " UINT64_FORMAT " bits is too large",
+							   bitCount)));
+	}
+
+	BloomFilter *filter = palloc0(sizeof(BloomFilter));
+	filter->hashCount = Max(hashCount, 1);
+	filter->bitCount = UINT64CONST(1) << pg_leftmost_one_pos64(bitCount);
+	if (filter->bitCount < bitCount)
+	{
+		filter->bitCount <<= 1;
+	}
+
+	filter->elementCount = 0;
+	filter->bits = palloc0(filter->bitCount / 8);
+
+	return filter;
+}
+
+
+/*
+ * BloomFilterAdd adds the element with the given hash value to the filter.
+ */
+void
+BloomFilterAdd(BloomFilter *filter, uint32 hashValue)
+{
+	for (uint32 hashIndex = 0; hashIndex < filter->hashCount; hashIndex++)
+	{
+		uint64 bitPosition = BloomFilterBitPosition(filter, hashValue, hashIndex);
+
+		filter->bits[bitPosition / 8] |= (uint8) (1 << (bitPosition % 8));
+	}
+
+	filter->elementCount++;
+}
+
+
+/*
+ * BloomFilterContains returns whether the element with the given hash value
+ * may have been added to the filter. False positives are possible, false
+ * negatives are not.
+ */
+bool
+BloomFilterContains(BloomFilter *filter, uint32 hashValue)
+{
+	for (uint32 hashIndex = 0; hashIndex < filter->hashCount; hashIndex++)
+	{
+		uint64 bitPosition = BloomFilterBitPosition(filter, hashValue, hashIndex);
+
+		if ((filter->bits[bitPosition / 8] & (1 << (bitPosition % 8))) == 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * BloomFilterBitPosition returns the bit position of the hashIndex-th hash
+ * function for the given hash value.
+ */
+static uint64
+BloomFilterBitPosition(BloomFilter *filter, uint32 hashValue, uint32 hashIndex)
+{
+	/* use an odd step such that positions do not repeat within the filter */
+	uint64 step = ((uint64) hash_bytes_uint32(hashValue)) | 1;
+
+	return ((uint64) hashValue + hashIndex * step) & (filter->bitCount - 1);
+}
+
+
+/*
+ * BloomFilterUnion adds all elements of the source filter to the target
+ * filter. The filters need to have the same hash count, the source filter is
+ * folded if it has more bits than the target filter.
+ */
+void
+BloomFilterUnion(BloomFilter *target, BloomFilter *source)
+{
+	if (target->hashCount != source->hashCount || target->bitCount > source->bitCount)
+	{
+		ereport(ERROR, (errmsg("cannot combine bloom filters of different shapes")));
+	}
+
+	uint64 targetByteCount = target->bitCount / 8;
+	uint64 sourceByteCount = source->bitCount / 8;
+
+	for (uint64 byteIndex = 0; byteIndex < sourceByteCount; byteIndex++)
+	{
+		target->bits[byteIndex % targetByteCount] |= source->bits[byteIndex];
+	}
+
+	target->elementCount += source->elementCount;
+}
+
+
+/*
+ * BloomFilterFold halves the number of bits of the filter as long as the
+ * result has at least BLOOM_FILTER_BITS_PER_ELEMENT bits per element and no
+ * fewer than minimumBitCount bits. Since bit positions are taken modulo the
+ * number of bits, which is a power of 2, the folded filter gives the same
+ * answers for the added elements, albeit with a higher false positive rate.
+ */
+void
+BloomFilterFold(BloomFilter *filter, uint64 minimumBitCount)
+{
+	uint64 requiredBitCount = filter->elementCount * BLOOM_FILTER_BITS_PER_ELEMENT;
+
+	minimumBitCount = Max(minimumBitCount, BLOOM_FILTER_MIN_BIT_COUNT);
+
+	while (filter->bitCount / 2 >= requiredBitCount &&
+		   filter->bitCount / 2 >= minimumBitCount)
+	{
+		uint64 halfByteCount = filter->bitCount / 16;
+
+		for (uint64 byteIndex = 0; byteIndex < halfByteCount; byteIndex++)
+		{
+			filter->bits[byteIndex] |= filter->bits[byteIndex + halfByteCount];
+		}
+
+		filter->bitCount /= 2;
+	}
+}
+
+
+/*
+ * BloomFilterToBytea serializes the given filter into a bytea.
+ */
+bytea *
+BloomFilterToBytea(BloomFilter *filter)
+{
+	uint64 byteCount = filter->bitCount / 8;
+	Size serializedLength = VARHDRSZ + BLOOM_FILTER_HEADER_LENGTH + byteCount;
+
+	bytea *serializedFilter = palloc0(serializedLength);
+	SET_VARSIZE(serializedFilter, serializedLength);
+
+	char *data = VARDATA(serializedFilter);
+	uint32 hashCount = pg_hton32(filter->hashCount);
+	uint64 elementCount = pg_hton64(filter->elementCount);
+
+	memcpy_s(data, sizeof(uint32), &hashCount, sizeof(uint32));
+	memcpy_s(data + sizeof(uint32), sizeof(uint64), &elementCount, sizeof(uint64));
+	memcpy_s(data + BLOOM_FILTER_HEADER_LENGTH, byteCount, filter->bits, byteCount);
+
+	return serializedFilter;
+}
+
+
+/*
+ * BloomFilterFromBytea deserializes a filter that was serialized with
+ * BloomFilterToBytea.
+ */
+BloomFilter *
+BloomFilterFromBytea(bytea *serializedFilter)
+{
+	Size dataLength = VARSIZE_ANY_EXHDR(serializedFilter);
+	char *data = VARDATA_ANY(serializedFilter);
+
+	uint64 byteCount = dataLength - BLOOM_FILTER_HEADER_LENGTH;
+	if (dataLength <= BLOOM_FILTER_HEADER_LENGTH ||
+		(byteCount & (byteCount - 1)) != 0 ||
+		byteCount * 8 < BLOOM_FILTER_MIN_BIT_COUNT)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("invalid bloom filter")));
+	}
+
+	uint32 hashCount = 0;
+	uint64 elementCount = 0;
+
+	memcpy_s(&hashCount, sizeof(uint32), data, sizeof(uint32));
+	memcpy_s(&elementCount, sizeof(uint64), data + sizeof(uint32), sizeof(uint64));
+
+	BloomFilter *filter = palloc0(sizeof(BloomFilter));
+	filter->hashCount = pg_ntoh32(hashCount);
+	filter->bitCount = byteCount * 8;
+	filter->elementCount = pg_ntoh64(elementCount);
+	filter->bits = palloc(byteCount);
+
+	memcpy_s(filter->bits, byteCount, data + BLOOM_FILTER_HEADER_LENGTH, byteCount);
+
+	if (filter->hashCount == 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("invalid bloom filter")));
+	}
+
+	return filter;
+}
@@ -101,6 +101,9 @@ copyJobInfo(Job *newnode, Job *from)
 	COPY_NODE_FIELD(partitionKeyValue);
 	COPY_NODE_FIELD(localPlannedStatements);
 	COPY_SCALAR_FIELD(parametersInJobQueryResolved);
+	COPY_NODE_FIELD(shardPruningRelationIdList);
+	COPY_NODE_FIELD(shardPruningRangeTableIdList);
+	COPY_NODE_FIELD(shardPruningRestrictionList);
 }
 
 
@@ -137,6 +140,10 @@ CopyNodeDistributedPlan(COPYFUNC_ARGS)
 	COPY_SCALAR_FIELD(fastPathRouterPlan);
 	COPY_SCALAR_FIELD(numberOfTimesExecuted);
 	COPY_NODE_FIELD(planningError);
+
+	COPY_NODE_FIELD(repartitionedAggregateQuery);
+	COPY_SCALAR_FIELD(repartitionedAggregateColumnIndex);
+	COPY_SCALAR_FIELD(repartitionedAggregateRelationId);
 }
 
 
@@ -210,6 +217,9 @@ CopyNodeMapMergeJob(COPYFUNC_ARGS)
 
 	COPY_NODE_FIELD(mapTaskList);
 	COPY_NODE_FIELD(mergeTaskList);
+	COPY_SCALAR_FIELD(buildBloomFilter);
+	COPY_NODE_FIELD(bloomFilterTaskList);
+	COPY_SCALAR_FIELD(estimatedDataSize);
 }
 
 
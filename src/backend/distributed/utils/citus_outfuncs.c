@@ -203,6 +203,10 @@ OutDistributedPlan(OUTFUNC_ARGS)
 	WRITE_UINT_FIELD(numberOfTimesExecuted);
 
 	WRITE_NODE_FIELD(planningError);
+
+	WRITE_NODE_FIELD(repartitionedAggregateQuery);
+	WRITE_INT_FIELD(repartitionedAggregateColumnIndex);
+	WRITE_OID_FIELD(repartitionedAggregateRelationId);
 }
 
 
@@ -349,6 +353,9 @@ OutJobFields(StringInfo str, const Job *node)
 	WRITE_NODE_FIELD(partitionKeyValue);
 	WRITE_NODE_FIELD(localPlannedStatements);
 	WRITE_BOOL_FIELD(parametersInJobQueryResolved);
+	WRITE_NODE_FIELD(shardPruningRelationIdList);
+	WRITE_NODE_FIELD(shardPruningRangeTableIdList);
+	WRITE_NODE_FIELD(shardPruningRestrictionList);
 }
 
 
@@ -415,6 +422,9 @@ OutMapMergeJob(OUTFUNC_ARGS)
 
 	WRITE_NODE_FIELD(mapTaskList);
 	WRITE_NODE_FIELD(mergeTaskList);
+	WRITE_BOOL_FIELD(buildBloomFilter);
+	WRITE_NODE_FIELD(bloomFilterTaskList);
+	WRITE_FLOAT_FIELD(estimatedDataSize, "%.0f");
 }
 
 
@@ -0,0 +1,389 @@
+/*-------------------------------------------------------------------------
+ *
+ * hll_sketch.c
+ *
+ * Implementation of the built-in HyperLogLog sketch aggregates, which are
+ * used to approximate count(distinct) when the hll extension is not
+ * available.
+ *
+ * Workers compute citus_hll_add_agg(column, log2m), which hashes the values
+ * into a sketch of 2^log2m one-byte registers. The coordinator merges the
+ * sketches of all workers using citus_hll_union_agg and estimates the number
+ * of distinct values using citus_hll_cardinality.
+ *
+ * A sketch is a bytea that consists of log2m as a single byte, followed by
+ * the registers. Since the transition functions only ever raise registers,
+ * they update the sketch in place when called as an aggregate.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <math.h>
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "safe_lib.h"
+
+#include "port/pg_bitutils.h"
+#include "utils/builtins.h"
+#include "utils/typcache.h"
+
+
+/* range of log2(register count) that we accept, see CountDistinctStorageSize */
+#define HLL_MIN_LOG2M 4
+#define HLL_MAX_LOG2M 17
+
+/* seed for the extended hash functions of the input type */
+#define HLL_HASH_SEED 0x5f3759df
+
+#define HLL_SKETCH_SIZE(log2m) (offsetof(HllSketch, registers) + (1 << (log2m)))
+
+
+/*
+ * HllSketch is the in-memory and on-the-wire layout of a sketch.
+ */
+typedef struct HllSketch
+{
+	int32 vl_len_;
+	uint8 log2m;
+	uint8 registers[FLEXIBLE_ARRAY_MEMBER];
+} HllSketch;
+
+
+static HllSketch * CreateHllSketch(FunctionCallInfo fcinfo, int log2m);
+static HllSketch * CopyHllSketch(FunctionCallInfo fcinfo, HllSketch *sketch);
+static HllSketch * GetHllSketchArg(FunctionCallInfo fcinfo, int argumentIndex);
+static void CheckHllSketch(HllSketch *sketch);
+static FmgrInfo * HllHashFunction(FunctionCallInfo fcinfo, int argumentIndex);
+static void HllSketchAddHash(HllSketch *sketch, uint64 hashValue);
+static int64 HllSketchCardinality(HllSketch *sketch);
+
+
+PG_FUNCTION_INFO_V1(citus_hll_add_sfunc);
+PG_FUNCTION_INFO_V1(citus_hll_union_sfunc);
+PG_FUNCTION_INFO_V1(citus_hll_cardinality);
+
+
+/*
+ * citus_hll_add_sfunc is the transition function of citus_hll_add_agg. It
+ * adds the hash of the value in the second argument to the sketch, which is
+ * created with 2^log2m registers on the first non-null value.
+ */
+Datum
+citus_hll_add_sfunc(PG_FUNCTION_ARGS)
+{
+	HllSketch *sketch = PG_ARGISNULL(0) ? NULL : GetHllSketchArg(fcinfo, 0);
+
+	if (PG_ARGISNULL(1))
+	{
+		if (sketch == NULL)
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_BYTEA_P(sketch);
+	}
+
+	if (sketch == NULL)
+	{
+		if (PG_ARGISNULL(2))
+		{
+			ereport(ERROR, (errmsg("citus_hll_add_agg requires a register count")));
+		}
+
+		sketch = CreateHllSketch(fcinfo, PG_GETARG_INT32(2));
+	}
+
+	FmgrInfo *hashFunction = HllHashFunction(fcinfo, 1);
+	uint64 hashValue = DatumGetUInt64(FunctionCall2Coll(hashFunction,
+														 PG_GET_COLLATION(),
+														 PG_GETARG_DATUM(1),
+														 UInt64GetDatum(HLL_HASH_SEED)));
+
+	HllSketchAddHash(sketch, hashValue);
+
+	PG_RETURN_BYTEA_P(sketch);
+}
+
+
+/*
+ * citus_hll_union_sfunc is the transition and combine function of
+ * citus_hll_union_agg, and the combine function of citus_hll_add_agg. It
+ * merges the sketch in the second argument into the first one.
+ */
+Datum
+citus_hll_union_sfunc(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_BYTEA_P(GetHllSketchArg(fcinfo, 0));
+	}
+
+	HllSketch *otherSketch = (HllSketch *) PG_GETARG_BYTEA_P(1);
+	CheckHllSketch(otherSketch);
+
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_BYTEA_P(CopyHllSketch(fcinfo, otherSketch));
+	}
+
+	HllSketch *sketch = GetHllSketchArg(fcinfo, 0);
+	if (sketch->log2m != otherSketch->log2m)
+	{
+		ereport(ERROR, (errmsg("cannot merge hll sketches with %d and %d registers",
+							   1 << sketch->log2m, 1 << otherSketch->log2m)));
+	}
+
+	int registerCount = 1 << sketch->log2m;
+	for (int registerIndex = 0; registerIndex < registerCount; registerIndex++)
+	{
+		sketch->registers[registerIndex] = Max(sketch->registers[registerIndex],
+											   otherSketch->registers[registerIndex]);
+	}
+
+	PG_RETURN_BYTEA_P(sketch);
+}
+
+
+/*
+ * citus_hll_cardinality returns the estimated number of distinct values that
+ * were added to the given sketch. A NULL sketch did not see any values.
+ */
+Datum
+citus_hll_cardinality(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_INT64(0);
+	}
+
+	HllSketch *sketch = (HllSketch *) PG_GETARG_BYTEA_P(0);
+	CheckHllSketch(sketch);
+
+	PG_RETURN_INT64(HllSketchCardinality(sketch));
+}
+
+
+/*
+ * CreateHllSketch returns an empty sketch with 2^log2m registers, allocated in
+ * the aggregate context if there is one.
+ */
+static HllSketch *
+CreateHllSketch(FunctionCallInfo fcinfo, int log2m)
+{
+	MemoryContext aggregateContext = NULL;
+
+	if (log2m < HLL_MIN_LOG2M || log2m > HLL_MAX_LOG2M)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("log2 of the register count must be between %d and %d",
+							   HLL_MIN_LOG2M, HLL_MAX_LOG2M)));
+	}
+
+	if (!AggCheckCallContext(fcinfo, &aggregateContext))
+	{
+		aggregateContext = CurrentMemoryContext;
+	}
+
+	Size sketchSize = HLL_SKETCH_SIZE(log2m);
+	HllSketch *sketch = MemoryContextAllocZero(aggregateContext, sketchSize);
+	SET_VARSIZE(sketch, sketchSize);
+	sketch->log2m = log2m;
+
+	return sketch;
+}
+
+
+/*
+ * CopyHllSketch returns a copy of the given sketch, allocated in the aggregate
+ * context if there is one.
+ */
+static HllSketch *
+CopyHllSketch(FunctionCallInfo fcinfo, HllSketch *sketch)
+{
+	HllSketch *copy = CreateHllSketch(fcinfo, sketch->log2m);
+	int registerCount = 1 << sketch->log2m;
+
+	memcpy_s(copy->registers, registerCount, sketch->registers, registerCount);
+
+	return copy;
+}
+
+
+/*
+ * GetHllSketchArg returns the sketch in the given argument, which may be
+ * updated in place. That is only allowed for the transition state of an
+ * aggregate, so we make a copy when not called as an aggregate.
+ */
+static HllSketch *
+GetHllSketchArg(FunctionCallInfo fcinfo, int argumentIndex)
+{
+	HllSketch *sketch = NULL;
+
+	if (AggCheckCallContext(fcinfo, NULL))
+	{
+		sketch = (HllSketch *) PG_GETARG_BYTEA_P(argumentIndex);
+	}
+	else
+	{
+		sketch = (HllSketch *) PG_GETARG_BYTEA_P_COPY(argumentIndex);
+	}
+
+	CheckHllSketch(sketch);
+
+	return sketch;
+}
+
+
+/*
+ * CheckHllSketch errors out if the given detoasted bytea is not a valid
+ * sketch, such that we never read beyond its registers.
+ */
+static void
+CheckHllSketch(HllSketch *sketch)
+{
+	Size sketchSize = VARSIZE(sketch);
+
+	if (sketchSize < offsetof(HllSketch, registers) ||
+		sketch->log2m < HLL_MIN_LOG2M || sketch->log2m > HLL_MAX_LOG2M ||
+		sketchSize != HLL_SKETCH_SIZE(sketch->log2m))
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						errmsg("invalid hll sketch")));
+	}
+}
+
+
+/*
+ * HllHashFunction returns the 64-bit extended hash function of the type of the
+ * given argument, caching it in fn_extra for subsequent calls.
+ */
+static FmgrInfo *
+HllHashFunction(FunctionCallInfo fcinfo, int argumentIndex)
+{
+	FmgrInfo *hashFunction = (FmgrInfo *) fcinfo->flinfo->fn_extra;
+	if (hashFunction != NULL)
+	{
+		return hashFunction;
+	}
+
+	Oid argumentType = get_fn_expr_argtype(fcinfo->flinfo, argumentIndex);
+	if (!OidIsValid(argumentType))
+	{
+		ereport(ERROR, (errmsg("could not determine the input type of "
+							   "citus_hll_add_agg")));
+	}
+
+	TypeCacheEntry *typeEntry = lookup_type_cache(argumentType,
+												  TYPECACHE_HASH_EXTENDED_PROC_FINFO);
+	if (!OidIsValid(typeEntry->hash_extended_proc))
+	{
+		ereport(ERROR, (errcode(ERRCODE_UNDEFINED_FUNCTION),
+						errmsg("could not identify an extended hash function "
+							   "for type %s", format_type_be(argumentType))));
+	}
+
+	hashFunction = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, sizeof(FmgrInfo));
+	fmgr_info_copy(hashFunction, &typeEntry->hash_extended_proc_finfo,
+				   fcinfo->flinfo->fn_mcxt);
+	fcinfo->flinfo->fn_extra = hashFunction;
+
+	return hashFunction;
+}
+
+
+/*
+ * HllSketchAddHash adds a hash value to the sketch. The first log2m bits
+ * select the register, which keeps the highest position of the first 1-bit
+ * in the remaining bits that it has seen.
+ */
+static void
+HllSketchAddHash(HllSketch *sketch, uint64 hashValue)
+{
+	int log2m = sketch->log2m;
+	uint32 registerIndex = (uint32) (hashValue >> (64 - log2m));
+	uint64 remainingBits = hashValue << log2m;
+	uint8 maxRank = 64 - log2m + 1;
+	uint8 rank = maxRank;
+
+	if (remainingBits != 0)
+	{
+		rank = Min(63 - pg_leftmost_one_pos64(remainingBits) + 1, maxRank);
+	}
+
+	if (rank > sketch->registers[registerIndex])
+	{
+		sketch->registers[registerIndex] = rank;
+	}
+}
+
+
+/*
+ * HllSketchCardinality returns the HyperLogLog estimate of the number of
+ * distinct values in the sketch, using linear counting for small
+ * cardinalities. With 64-bit hashes, no large range correction is needed.
+ */
+static int64
+HllSketchCardinality(HllSketch *sketch)
+{
+	int registerCount = 1 << sketch->log2m;
+	double inverseSum = 0.0;
+	int zeroRegisterCount = 0;
+	double alpha = 0.0;
+
+	for (int registerIndex = 0; registerIndex < registerCount; registerIndex++)
+	{
+		uint8 rank = sketch->registers[registerIndex];
+
+		inverseSum += ldexp(1.0, -rank);
+
+		if (rank == 0)
+		{
+			zeroRegisterCount++;
+		}
+	}
+
+	switch (registerCount)
+	{
+		case 16:
+		{
+			alpha = 0.673;
+			break;
+		}
+
+		case 32:
+		{
+			alpha = 0.697;
+			break;
+		}
+
+		case 64:
+		{
+			alpha = 0.709;
+			break;
+		}
+
+		default:
+		{
+			alpha = 0.7213 / (1.0 + 1.079 / registerCount);
+			break;
+		}
+	}
+
+	double estimate = alpha * registerCount * registerCount / inverseSum;
+
+	if (estimate <= 2.5 * registerCount && zeroRegisterCount > 0)
+	{
+		estimate = registerCount * log((double) registerCount / zeroRegisterCount);
+	}
+
+	return (int64) rint(estimate);
+}
@@ -71,6 +71,88 @@ SortList(List *pointerList, int (*comparisonFunction)(const void *, const void *
 }
 
 
+/*
+ * SortedListInsert inserts the given pointer into a list of pointers that is
+ * sorted by the given comparison function, keeping the list sorted. The
+ * position is found using binary search, so only a logarithmic number of
+ * comparisons is needed. The comparison function has the same signature as
+ * for SortList.
+ */
+List *
+SortedListInsert(List *sortedList, void *pointer,
+				 int (*comparisonFunction)(const void *, const void *))
+{
+	int lowerIndex = 0;
+	int upperIndex = list_length(sortedList);
+
+	while (lowerIndex < upperIndex)
+	{
+		int middleIndex = lowerIndex + (upperIndex - lowerIndex) / 2;
+		void *middlePointer = list_nth(sortedList, middleIndex);
+
+		if (comparisonFunction(&middlePointer, &pointer) <= 0)
+		{
+			lowerIndex = middleIndex + 1;
+		}
+		else
+		{
+			upperIndex = middleIndex;
+		}
+	}
+
+	return list_insert_nth(sortedList, lowerIndex, pointer);
+}
+
+
+/*
+ * SortedListDelete removes the given pointer from a list of pointers that is
+ * sorted by the given comparison function, using binary search to find it.
+ * The sort key of the pointer must not have changed since it was added to the
+ * list, otherwise the list is searched linearly.
+ */
+List *
+SortedListDelete(List *sortedList, void *pointer,
+				 int (*comparisonFunction)(const void *, const void *))
+{
+	int lowerIndex = 0;
+	int upperIndex = list_length(sortedList);
+
+	/* find the first element that is not smaller than the pointer */
+	while (lowerIndex < upperIndex)
+	{
+		int middleIndex = lowerIndex + (upperIndex - lowerIndex) / 2;
+		void *middlePointer = list_nth(sortedList, middleIndex);
+
+		if (comparisonFunction(&middlePointer, &pointer) < 0)
+		{
+			lowerIndex = middleIndex + 1;
+		}
+		else
+		{
+			upperIndex = middleIndex;
+		}
+	}
+
+	/* elements that compare equal can be in any order */
+	for (int listIndex = lowerIndex; listIndex < list_length(sortedList); listIndex++)
+	{
+		void *listPointer = list_nth(sortedList, listIndex);
+
+		if (listPointer == pointer)
+		{
+			return list_delete_nth_cell(sortedList, listIndex);
+		}
+
+		if (comparisonFunction(&listPointer, &pointer) != 0)
+		{
+			break;
+		}
+	}
+
+	return list_delete_ptr(sortedList, pointer);
+}
+
+
 /*
  * PointerArrayFromList converts a list of pointers to an array of pointers.
  */
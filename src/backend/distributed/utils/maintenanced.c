@@ -51,6 +51,8 @@
 #include "distributed/citus_safe_lib.h"
 #include "distributed/coordinator_protocol.h"
 #include "distributed/distributed_deadlock_detection.h"
+#include "distributed/distributed_statistics.h"
+#include "distributed/hot_tenant_isolation.h"
 #include "distributed/maintenanced.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/metadata_sync.h"
@@ -488,6 +490,8 @@ CitusMaintenanceDaemonMain(Datum main_arg)
 	bool retryStatsCollection USED_WITH_LIBCURL_ONLY = false;
 	TimestampTz lastRecoveryTime = 0;
 	TimestampTz lastShardCleanTime = 0;
+	TimestampTz lastDistributedAnalyzeTime = 0;
+	TimestampTz lastHotTenantIsolationTime = 0;
 	TimestampTz lastStatStatementsPurgeTime = 0;
 	TimestampTz nextMetadataSyncTime = 0;
 
@@ -790,6 +794,85 @@ CitusMaintenanceDaemonMain(Datum main_arg)
 			timeout = Min(timeout, DeferShardDeleteInterval);
 		}
 
+		if (!RecoveryInProgress() && DistributedAnalyzeInterval > 0 &&
+			TimestampDifferenceExceeds(lastDistributedAnalyzeTime, GetCurrentTimestamp(),
+									   DistributedAnalyzeInterval))
+		{
+			int numberOfAnalyzedTables = 0;
+
+			InvalidateMetadataSystemCache();
+			StartTransactionCommand();
+
+			if (!LockCitusExtension())
+			{
+				ereport(DEBUG1, (errmsg("could not lock the citus extension, "
+										"skipping distributed analyze")));
+			}
+			else if (CheckCitusVersion(DEBUG1) && CitusHasBeenLoaded() &&
+					 IsCoordinator())
+			{
+				/*
+				 * Record last analyze time at start to ensure we run once per
+				 * DistributedAnalyzeInterval.
+				 */
+				lastDistributedAnalyzeTime = GetCurrentTimestamp();
+
+				numberOfAnalyzedTables = TryAnalyzeDistributedTables();
+			}
+
+			CommitTransactionCommand();
+
+			if (numberOfAnalyzedTables > 0)
+			{
+				ereport(DEBUG1, (errmsg("maintenance daemon gathered the statistics "
+										"of %d distributed tables",
+										numberOfAnalyzedTables)));
+			}
+
+			/* make sure we don't wait too long */
+			timeout = Min(timeout, DistributedAnalyzeInterval);
+		}
+
+		if (!RecoveryInProgress() && HotTenantIsolationInterval > 0 &&
+			TimestampDifferenceExceeds(lastHotTenantIsolationTime, GetCurrentTimestamp(),
+									   HotTenantIsolationInterval))
+		{
+			int numberOfScheduledJobs = 0;
+
+			InvalidateMetadataSystemCache();
+			StartTransactionCommand();
+			PushActiveSnapshot(GetTransactionSnapshot());
+
+			if (!LockCitusExtension())
+			{
+				ereport(DEBUG1, (errmsg("could not lock the citus extension, "
+										"skipping hot tenant isolation")));
+			}
+			else if (CheckCitusVersion(DEBUG1) && CitusHasBeenLoaded() &&
+					 IsCoordinator())
+			{
+				/*
+				 * Record last check time at start to ensure we run once per
+				 * HotTenantIsolationInterval.
+				 */
+				lastHotTenantIsolationTime = GetCurrentTimestamp();
+
+				numberOfScheduledJobs = TryScheduleHotTenantIsolation();
+			}
+
+			PopActiveSnapshot();
+			CommitTransactionCommand();
+
+			if (numberOfScheduledJobs > 0)
+			{
+				ereport(DEBUG1, (errmsg("maintenance daemon scheduled the isolation "
+										"of a hot tenant")));
+			}
+
+			/* make sure we don't wait too long */
+			timeout = Min(timeout, HotTenantIsolationInterval);
+		}
+
 		if (StatStatementsPurgeInterval > 0 &&
 			StatStatementsTrack != STAT_STATEMENTS_TRACK_NONE &&
 			TimestampDifferenceExceeds(lastStatStatementsPurgeTime, GetCurrentTimestamp(),
@@ -0,0 +1,633 @@
+/*-------------------------------------------------------------------------
+ *
+ * shard_load_stats.c
+ *	  Routines for tracking the query load on the shards of a node.
+ *
+ * When citus.stat_shard_load_track is enabled, every query that accesses
+ * shards on this node adds its CPU time, a query count and the number of
+ * tuples it read from each of those shards to the statistics of the shard.
+ * The tuples read are taken from the pending per-relation counters of the
+ * cumulative statistics system, like seq_tup_read and idx_tup_fetch in
+ * pg_stat_user_tables, hence they require track_counts. The statistics are
+ * kept in shared memory and decay exponentially with a half-life of
+ * citus.stat_shard_load_half_life, such that they reflect the recent load.
+ *
+ * The rebalancer uses the statistics through the by_query_load rebalance
+ * strategy, which asks the node of each shard group for its load.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <math.h>
+#include <time.h>
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+
+#include "nodes/parsenodes.h"
+#include "nodes/plannodes.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/timestamp.h"
+
+#include "pg_version_constants.h"
+
+#include "distributed/citus_safe_lib.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/tuplestore.h"
+#include "distributed/utils/shard_load_stats.h"
+#include "distributed/worker_protocol.h"
+#include "distributed/worker_shard_visibility.h"
+
+
+#define SHARD_LOAD_COLUMNS 5
+
+/*
+ * The load of a shard is expressed in milliseconds of CPU time. Queries and
+ * tuples read are added using a rough estimate of their cost, such that shards
+ * that receive many short queries still get a load when clock() is too coarse
+ * to measure the individual queries.
+ */
+#define LOAD_PER_CPU_SECOND 1000.0
+#define LOAD_PER_QUERY 1.0
+#define LOAD_PER_TUPLE_READ 0.001
+
+/*
+ * MeasuredShard is a shard that is accessed by the query whose load is being
+ * measured, with the number of tuples that had been read from it when the
+ * measurement started.
+ */
+typedef struct MeasuredShard
+{
+	uint64 shardId;
+	Oid relationId;
+	int64 startTuplesRead;
+} MeasuredShard;
+
+static const char *SharedMemoryNameForShardLoadMonitor = "Shard Load Monitor";
+static char *ShardLoadMonitorTrancheName = "Shard Load Monitor Tranche";
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+/* shards that are accessed by the query whose load is being measured */
+static MeasuredShard *MeasuredShards = NULL;
+static int MeasuredShardCount = 0;
+static clock_t MeasurementStartClock = 0;
+
+static void ShardLoadMonitorShmemInit(void);
+static ShardLoadMonitor * GetShardLoadMonitor(void);
+static MeasuredShard * ShardsAccessedByPlan(PlannedStmt *plannedStmt, int *shardCount);
+static int64 ShardTuplesRead(Oid relationId);
+static void RecordShardLoad(ShardLoadMonitor *monitor, uint64 shardId,
+							double cpuSeconds, int64 tuplesRead,
+							TimestampTz queryTime);
+static void UpdateShardLoadStats(ShardLoadStats *shardLoadStats, double cpuSeconds,
+								 int64 tuplesRead, TimestampTz queryTime);
+static void DecayShardLoadStats(ShardLoadStats *shardLoadStats, TimestampTz now);
+static double ShardLoadScore(ShardLoadStats *shardLoadStats);
+static void EvictShardLoadStatsIfNecessary(ShardLoadMonitor *monitor,
+										   TimestampTz now);
+static int CompareShardLoadScore(const void *leftElement, const void *rightElement);
+
+/* GUC variables */
+int StatShardLoadHalfLife = 600;
+int StatShardLoadLimit = 10000;
+int StatShardLoadTrack = STAT_SHARD_LOAD_TRACK_NONE;
+
+PG_FUNCTION_INFO_V1(citus_shard_load_local);
+PG_FUNCTION_INFO_V1(citus_shard_load_local_reset);
+
+
+/*
+ * citus_shard_load_local returns the decayed load statistics of the shards
+ * on the local node.
+ */
+Datum
+citus_shard_load_local(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+
+	TupleDesc tupleDescriptor = NULL;
+	Tuplestorestate *tupleStore = SetupTuplestore(fcinfo, &tupleDescriptor);
+	TimestampTz now = GetCurrentTimestamp();
+
+	Datum values[SHARD_LOAD_COLUMNS];
+	bool isNulls[SHARD_LOAD_COLUMNS];
+
+	ShardLoadMonitor *monitor = GetShardLoadMonitor();
+	if (monitor == NULL)
+	{
+		PG_RETURN_VOID();
+	}
+
+	LWLockAcquire(&monitor->lock, LW_SHARED);
+
+	HASH_SEQ_STATUS hashSeq;
+	ShardLoadStats *shardLoadStats = NULL;
+
+	hash_seq_init(&hashSeq, monitor->shards);
+	while ((shardLoadStats = hash_seq_search(&hashSeq)) != NULL)
+	{
+		memset(values, 0, sizeof(values));
+		memset(isNulls, false, sizeof(isNulls));
+
+		SpinLockAcquire(&shardLoadStats->lock);
+
+		DecayShardLoadStats(shardLoadStats, now);
+
+		values[0] = Int64GetDatum(shardLoadStats->shardId);
+		values[1] = Float8GetDatum(shardLoadStats->queryCount);
+		values[2] = Float8GetDatum(shardLoadStats->cpuSeconds);
+		values[3] = Float8GetDatum(shardLoadStats->tuplesRead);
+		values[4] = Float8GetDatum(ShardLoadScore(shardLoadStats));
+
+		SpinLockRelease(&shardLoadStats->lock);
+
+		tuplestore_putvalues(tupleStore, tupleDescriptor, values, isNulls);
+	}
+
+	LWLockRelease(&monitor->lock);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * citus_shard_load_local_reset removes the load statistics of all shards on
+ * the local node.
+ */
+Datum
+citus_shard_load_local_reset(PG_FUNCTION_ARGS)
+{
+	ShardLoadMonitor *monitor = GetShardLoadMonitor();
+
+	/* if the monitor is not created yet, there is nothing to reset */
+	if (monitor == NULL)
+	{
+		PG_RETURN_VOID();
+	}
+
+	HASH_SEQ_STATUS hashSeq;
+	ShardLoadStats *shardLoadStats = NULL;
+
+	LWLockAcquire(&monitor->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&hashSeq, monitor->shards);
+	while ((shardLoadStats = hash_seq_search(&hashSeq)) != NULL)
+	{
+		hash_search(monitor->shards, &shardLoadStats->shardId, HASH_REMOVE, NULL);
+	}
+
+	LWLockRelease(&monitor->lock);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * InitializeShardLoadMonitor requests the shared memory for the shard load
+ * monitor on PG versions without shmem_request_hook and sets up the shared
+ * memory startup hook that creates it.
+ */
+void
+InitializeShardLoadMonitor(void)
+{
+/* on PG 15, we use shmem_request_hook_type */
+#if PG_VERSION_NUM < PG_VERSION_15
+	if (!IsUnderPostmaster)
+	{
+		RequestAddinShmemSpace(ShardLoadMonitorShmemSize());
+	}
+#endif
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = ShardLoadMonitorShmemInit;
+}
+
+
+/*
+ * ShardLoadMonitorShmemSize returns the size of the shared memory that the
+ * shard load monitor needs for citus.stat_shard_load_limit shards.
+ */
+size_t
+ShardLoadMonitorShmemSize(void)
+{
+	Size size = sizeof(ShardLoadMonitor);
+	size = add_size(size, hash_estimate_size(StatShardLoadLimit,
+											 sizeof(ShardLoadStats)));
+
+	return size;
+}
+
+
+/*
+ * ShardLoadMonitorShmemInit creates the shard load monitor in shared memory.
+ */
+static void
+ShardLoadMonitorShmemInit(void)
+{
+	bool found = false;
+
+	if (prev_shmem_startup_hook != NULL)
+	{
+		prev_shmem_startup_hook();
+	}
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	ShardLoadMonitor *monitor = ShmemInitStruct(SharedMemoryNameForShardLoadMonitor,
+												sizeof(ShardLoadMonitor), &found);
+	if (!found)
+	{
+		monitor->namedLockTranche.trancheId = LWLockNewTrancheId();
+		monitor->namedLockTranche.trancheName = ShardLoadMonitorTrancheName;
+
+		LWLockRegisterTranche(monitor->namedLockTranche.trancheId,
+							  monitor->namedLockTranche.trancheName);
+		LWLockInitialize(&monitor->lock, monitor->namedLockTranche.trancheId);
+	}
+
+	HASHCTL info;
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(uint64);
+	info.entrysize = sizeof(ShardLoadStats);
+
+	monitor->shards = ShmemInitHash("citus_shard_load hash",
+									StatShardLoadLimit, StatShardLoadLimit,
+									&info, HASH_ELEM | HASH_SHARED_MEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+
+/*
+ * GetShardLoadMonitor returns the shard load monitor in shared memory, or
+ * NULL if it was not created.
+ */
+static ShardLoadMonitor *
+GetShardLoadMonitor(void)
+{
+	bool found = false;
+	ShardLoadMonitor *monitor = ShmemInitStruct(SharedMemoryNameForShardLoadMonitor,
+												sizeof(ShardLoadMonitor), &found);
+	if (!found)
+	{
+		elog(WARNING, "shard load monitor not found");
+		return NULL;
+	}
+
+	return monitor;
+}
+
+
+/*
+ * StartShardLoadMeasurement starts measuring the load of the given query if
+ * load tracking is enabled and the query accesses shards on this node. It
+ * returns whether a measurement was started, in which case the caller should
+ * call EndShardLoadMeasurement or CancelShardLoadMeasurement.
+ *
+ * Only the outermost query that accesses shards is measured, such that the
+ * load of queries that run within a function is not counted twice.
+ */
+bool
+StartShardLoadMeasurement(QueryDesc *queryDesc)
+{
+	if (StatShardLoadTrack == STAT_SHARD_LOAD_TRACK_NONE ||
+		MeasuredShards != NULL || !CitusHasBeenLoaded())
+	{
+		return false;
+	}
+
+	int shardCount = 0;
+	MeasuredShard *shards = ShardsAccessedByPlan(queryDesc->plannedstmt, &shardCount);
+	if (shardCount == 0)
+	{
+		return false;
+	}
+
+	for (int shardIndex = 0; shardIndex < shardCount; shardIndex++)
+	{
+		shards[shardIndex].startTuplesRead =
+			ShardTuplesRead(shards[shardIndex].relationId);
+	}
+
+	MeasuredShards = shards;
+	MeasuredShardCount = shardCount;
+	MeasurementStartClock = clock();
+
+	return true;
+}
+
+
+/*
+ * EndShardLoadMeasurement adds the load of the query that is being measured
+ * to the statistics of the shards that it accessed. Each shard gets the CPU
+ * time of the query and the number of tuples that the query read from it.
+ */
+void
+EndShardLoadMeasurement(void)
+{
+	double cpuSeconds = ((double) (clock() - MeasurementStartClock)) / CLOCKS_PER_SEC;
+	TimestampTz queryTime = GetCurrentTimestamp();
+	MeasuredShard *shards = MeasuredShards;
+	int shardCount = MeasuredShardCount;
+
+	CancelShardLoadMeasurement();
+
+	ShardLoadMonitor *monitor = GetShardLoadMonitor();
+	if (monitor != NULL)
+	{
+		for (int shardIndex = 0; shardIndex < shardCount; shardIndex++)
+		{
+			MeasuredShard *shard = &shards[shardIndex];
+			int64 tuplesRead = ShardTuplesRead(shard->relationId) -
+							   shard->startTuplesRead;
+
+			RecordShardLoad(monitor, shard->shardId, cpuSeconds, Max(tuplesRead, 0),
+							queryTime);
+		}
+	}
+
+	pfree(shards);
+}
+
+
+/*
+ * CancelShardLoadMeasurement stops measuring the current query without
+ * recording its load, for instance because it failed.
+ */
+void
+CancelShardLoadMeasurement(void)
+{
+	MeasuredShards = NULL;
+	MeasuredShardCount = 0;
+}
+
+
+/*
+ * ShardsAccessedByPlan returns the distinct shards on this node that appear in
+ * the range table of the given plan.
+ */
+static MeasuredShard *
+ShardsAccessedByPlan(PlannedStmt *plannedStmt, int *shardCount)
+{
+	List *rangeTableList = plannedStmt->rtable;
+	MeasuredShard *shards = palloc0(list_length(rangeTableList) * sizeof(MeasuredShard));
+	int distinctShardCount = 0;
+
+	RangeTblEntry *rangeTableEntry = NULL;
+	foreach_ptr(rangeTableEntry, rangeTableList)
+	{
+		if (rangeTableEntry->rtekind != RTE_RELATION ||
+			!RelationIsAKnownShard(rangeTableEntry->relid))
+		{
+			continue;
+		}
+
+		bool missingOk = true;
+		char *shardRelationName = get_rel_name(rangeTableEntry->relid);
+		uint64 shardId = ExtractShardIdFromTableName(shardRelationName, missingOk);
+		bool alreadyAccessed = false;
+
+		for (int shardIndex = 0; shardIndex < distinctShardCount; shardIndex++)
+		{
+			if (shards[shardIndex].shardId == shardId)
+			{
+				alreadyAccessed = true;
+				break;
+			}
+		}
+
+		if (!alreadyAccessed)
+		{
+			shards[distinctShardCount].shardId = shardId;
+			shards[distinctShardCount].relationId = rangeTableEntry->relid;
+			distinctShardCount++;
+		}
+	}
+
+	if (distinctShardCount == 0)
+	{
+		pfree(shards);
+		shards = NULL;
+	}
+
+	*shardCount = distinctShardCount;
+	return shards;
+}
+
+
+/*
+ * ShardTuplesRead returns the number of tuples that this backend read from the
+ * given shard in sequential scans and index scans, and did not report to the
+ * cumulative statistics system yet. The pending counters are only reported
+ * between transactions, hence the difference between two calls during a query
+ * is the number of tuples that the query read from the shard.
+ */
+static int64
+ShardTuplesRead(Oid relationId)
+{
+	PgStat_TableStatus *tableStatus = find_tabstat_entry(relationId);
+	if (tableStatus == NULL)
+	{
+		return 0;
+	}
+
+#if PG_VERSION_NUM >= PG_VERSION_16
+	return tableStatus->counts.tuples_returned + tableStatus->counts.tuples_fetched;
+#else
+	return tableStatus->t_counts.t_tuples_returned +
+		   tableStatus->t_counts.t_tuples_fetched;
+#endif
+}
+
+
+/*
+ * RecordShardLoad adds the load of a query to the statistics of the given
+ * shard, and starts tracking the shard if it is not tracked yet.
+ */
+static void
+RecordShardLoad(ShardLoadMonitor *monitor, uint64 shardId, double cpuSeconds,
+				int64 tuplesRead, TimestampTz queryTime)
+{
+	bool found = false;
+
+	LWLockAcquire(&monitor->lock, LW_SHARED);
+
+	ShardLoadStats *shardLoadStats = hash_search(monitor->shards, &shardId,
+												 HASH_FIND, NULL);
+	if (shardLoadStats != NULL)
+	{
+		SpinLockAcquire(&shardLoadStats->lock);
+		UpdateShardLoadStats(shardLoadStats, cpuSeconds, tuplesRead, queryTime);
+		SpinLockRelease(&shardLoadStats->lock);
+
+		LWLockRelease(&monitor->lock);
+		return;
+	}
+
+	LWLockRelease(&monitor->lock);
+
+	/*
+	 * The shard is not tracked yet. Another backend might start tracking it
+	 * while we wait for the exclusive lock, hence we add it to the hash only
+	 * if it is still not there.
+	 */
+	LWLockAcquire(&monitor->lock, LW_EXCLUSIVE);
+
+	if (hash_search(monitor->shards, &shardId, HASH_FIND, NULL) == NULL)
+	{
+		EvictShardLoadStatsIfNecessary(monitor, queryTime);
+	}
+
+	shardLoadStats = hash_search(monitor->shards, &shardId, HASH_ENTER, &found);
+	if (!found)
+	{
+		shardLoadStats->queryCount = 0;
+		shardLoadStats->cpuSeconds = 0;
+		shardLoadStats->tuplesRead = 0;
+		shardLoadStats->lastUpdateTime = queryTime;
+
+		SpinLockInit(&shardLoadStats->lock);
+	}
+
+	SpinLockAcquire(&shardLoadStats->lock);
+	UpdateShardLoadStats(shardLoadStats, cpuSeconds, tuplesRead, queryTime);
+	SpinLockRelease(&shardLoadStats->lock);
+
+	LWLockRelease(&monitor->lock);
+}
+
+
+/*
+ * UpdateShardLoadStats decays the statistics of a shard to the given query
+ * time and adds the load of the query.
+ *
+ * Calling this function should be protected by the lock of the shard.
+ */
+static void
+UpdateShardLoadStats(ShardLoadStats *shardLoadStats, double cpuSeconds,
+					 int64 tuplesRead, TimestampTz queryTime)
+{
+	DecayShardLoadStats(shardLoadStats, queryTime);
+
+	shardLoadStats->queryCount += 1;
+	shardLoadStats->cpuSeconds += cpuSeconds;
+	shardLoadStats->tuplesRead += tuplesRead;
+}
+
+
+/*
+ * DecayShardLoadStats decays the statistics of a shard from the last time
+ * they were decayed to now, halving them every citus.stat_shard_load_half_life
+ * seconds.
+ *
+ * Calling this function should be protected by the lock of the shard.
+ */
+static void
+DecayShardLoadStats(ShardLoadStats *shardLoadStats, TimestampTz now)
+{
+	if (now <= shardLoadStats->lastUpdateTime)
+	{
+		return;
+	}
+
+	double elapsedSeconds =
+		((double) (now - shardLoadStats->lastUpdateTime)) / USECS_PER_SEC;
+	double decayFactor = pow(0.5, elapsedSeconds / StatShardLoadHalfLife);
+
+	shardLoadStats->queryCount *= decayFactor;
+	shardLoadStats->cpuSeconds *= decayFactor;
+	shardLoadStats->tuplesRead *= decayFactor;
+	shardLoadStats->lastUpdateTime = now;
+}
+
+
+/*
+ * ShardLoadScore combines the statistics of a shard into a single load
+ * number, expressed in milliseconds of CPU time.
+ */
+static double
+ShardLoadScore(ShardLoadStats *shardLoadStats)
+{
+	return shardLoadStats->cpuSeconds * LOAD_PER_CPU_SECOND +
+		   shardLoadStats->queryCount * LOAD_PER_QUERY +
+		   shardLoadStats->tuplesRead * LOAD_PER_TUPLE_READ;
+}
+
+
+/*
+ * EvictShardLoadStatsIfNecessary makes room for a new shard when the monitor
+ * tracks citus.stat_shard_load_limit shards, by removing the quarter of the
+ * shards with the lowest load.
+ *
+ * Calling this function should be protected by the monitor->lock in
+ * LW_EXCLUSIVE mode.
+ */
+static void
+EvictShardLoadStatsIfNecessary(ShardLoadMonitor *monitor, TimestampTz now)
+{
+	long shardCount = hash_get_num_entries(monitor->shards);
+	if (shardCount < StatShardLoadLimit)
+	{
+		return;
+	}
+
+	HASH_SEQ_STATUS hashSeq;
+	ShardLoadStats *shardLoadStats = NULL;
+	ShardLoadStats **statsArray = palloc(shardCount * sizeof(ShardLoadStats *));
+
+	int statsIndex = 0;
+	hash_seq_init(&hashSeq, monitor->shards);
+	while ((shardLoadStats = hash_seq_search(&hashSeq)) != NULL)
+	{
+		SpinLockAcquire(&shardLoadStats->lock);
+		DecayShardLoadStats(shardLoadStats, now);
+		SpinLockRelease(&shardLoadStats->lock);
+
+		statsArray[statsIndex++] = shardLoadStats;
+	}
+
+	SafeQsort(statsArray, statsIndex, sizeof(ShardLoadStats *), CompareShardLoadScore);
+
+	int evictCount = Max(statsIndex / 4, 1);
+	for (int evictIndex = 0; evictIndex < evictCount; evictIndex++)
+	{
+		hash_search(monitor->shards, &statsArray[evictIndex]->shardId, HASH_REMOVE,
+					NULL);
+	}
+
+	pfree(statsArray);
+}
+
+
+/*
+ * CompareShardLoadScore is used to sort the shard statistics by load in
+ * ascending order.
+ */
+static int
+CompareShardLoadScore(const void *leftElement, const void *rightElement)
+{
+	double leftScore = ShardLoadScore(*(ShardLoadStats *const *) leftElement);
+	double rightScore = ShardLoadScore(*(ShardLoadStats *const *) rightElement);
+
+	if (leftScore < rightScore)
+	{
+		return -1;
+	}
+	else if (leftScore > rightScore)
+	{
+		return 1;
+	}
+	return 0;
+}
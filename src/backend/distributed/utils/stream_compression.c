@@ -0,0 +1,614 @@
+/*-------------------------------------------------------------------------
+ *
+ * stream_compression.c
+ *	  Utility functions for compressing and decompressing byte streams
+ *	  such as intermediate results.
+ *
+ * A compressed stream consists of a header (see stream_compression.h)
+ * followed by a sequence of frames. Each frame starts with the uncompressed
+ * and the stored length of the frame as 32-bit integers in network byte
+ * order, followed by the stored bytes. When compressing a frame does not
+ * save any space, the frame is stored as-is and both lengths are equal.
+ *
+ * Both directions are implemented as push-style filters that append their
+ * output to a StringInfo, such that they can be used with files as well as
+ * with COPY data that arrives over a connection.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "safe_lib.h"
+
+#include "port/pg_bswap.h"
+
+#include "citus_version.h"
+
+#include "distributed/utils/stream_compression.h"
+
+#if HAVE_CITUS_LIBLZ4
+#include <lz4.h>
+#endif
+
+#if HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+
+/* favour speed over compression ratio, streams are usually short-lived */
+#define STREAM_COMPRESSION_ZSTD_LEVEL 1
+
+#define STREAM_COMPRESSION_FRAME_HEADER_LENGTH (2 * sizeof(uint32))
+
+
+static void AppendCompressedFrames(CompressionStream *stream, StringInfo output,
+								   bool flushAll);
+static void AppendCompressedFrame(CompressionStream *stream, const char *data,
+								  int dataLength, StringInfo output);
+static int CompressFrame(StreamCompressionMethod method, const char *data,
+						 int dataLength, StringInfo frameBuffer);
+static bool ProcessStreamHeader(DecompressionStream *stream, StringInfo output);
+static void AppendDecompressedFrames(DecompressionStream *stream, StringInfo output);
+static void DecompressFrame(StreamCompressionMethod method, const char *storedData,
+							uint32 storedLength, uint32 rawLength, StringInfo output);
+static void DiscardConsumedData(StringInfo buffer);
+
+
+/*
+ * CreateCompressionStream returns a new compression stream that compresses
+ * its input with the given method once more than thresholdBytes are written
+ * to it.
+ */
+CompressionStream *
+CreateCompressionStream(StreamCompressionMethod method, uint64 thresholdBytes)
+{
+	if (!StreamCompressionMethodSupported(method))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("compression method %d is not supported by this "
+							   "build of Citus", method)));
+	}
+
+	CompressionStream *stream = palloc0(sizeof(CompressionStream));
+	stream->method = method;
+	stream->thresholdBytes = thresholdBytes;
+	stream->compressing = false;
+	stream->pendingData = makeStringInfo();
+	stream->frameBuffer = makeStringInfo();
+
+	return stream;
+}
+
+
+/*
+ * CompressionStreamWrite adds the given bytes to the stream and appends any
+ * bytes that are ready to be sent or written to output. Until the stream
+ * grows beyond the threshold, the bytes are buffered since we do not know
+ * yet whether the stream is going to be compressed.
+ */
+void
+CompressionStreamWrite(CompressionStream *stream, const char *data, int dataLength,
+					   StringInfo output)
+{
+	if (stream->method == STREAM_COMPRESSION_NONE)
+	{
+		appendBinaryStringInfo(output, data, dataLength);
+		return;
+	}
+
+	appendBinaryStringInfo(stream->pendingData, data, dataLength);
+
+	if (!stream->compressing)
+	{
+		if ((uint64) stream->pendingData->len <= stream->thresholdBytes)
+		{
+			return;
+		}
+
+		/* the stream grew beyond the threshold, start compressing */
+		appendBinaryStringInfo(output, STREAM_COMPRESSION_MAGIC,
+							   STREAM_COMPRESSION_MAGIC_LENGTH);
+		appendStringInfoChar(output, (char) stream->method);
+
+		stream->compressing = true;
+	}
+
+	AppendCompressedFrames(stream, output, false);
+}
+
+
+/*
+ * CompressionStreamFinish appends all remaining bytes of the stream to output.
+ * Streams that never grew beyond the threshold are emitted uncompressed.
+ */
+void
+CompressionStreamFinish(CompressionStream *stream, StringInfo output)
+{
+	StringInfo pendingData = stream->pendingData;
+
+	if (!stream->compressing)
+	{
+		appendBinaryStringInfo(output, pendingData->data, pendingData->len);
+		resetStringInfo(pendingData);
+		return;
+	}
+
+	AppendCompressedFrames(stream, output, true);
+}
+
+
+/*
+ * AppendCompressedFrames compresses all complete frames in the pending data
+ * of the stream, or all pending data if flushAll is set, and appends them
+ * to output.
+ */
+static void
+AppendCompressedFrames(CompressionStream *stream, StringInfo output, bool flushAll)
+{
+	StringInfo pendingData = stream->pendingData;
+
+	while (true)
+	{
+		int remainingLength = pendingData->len - pendingData->cursor;
+		if (remainingLength == 0 ||
+			(!flushAll && remainingLength < STREAM_COMPRESSION_FRAME_SIZE))
+		{
+			break;
+		}
+
+		int frameLength = Min(remainingLength, STREAM_COMPRESSION_FRAME_SIZE);
+
+		AppendCompressedFrame(stream, pendingData->data + pendingData->cursor,
+							  frameLength, output);
+
+		pendingData->cursor += frameLength;
+	}
+
+	DiscardConsumedData(pendingData);
+}
+
+
+/*
+ * AppendCompressedFrame compresses a single frame and appends it to output.
+ * If compression does not reduce the size, the frame is stored as-is.
+ */
+static void
+AppendCompressedFrame(CompressionStream *stream, const char *data, int dataLength,
+					  StringInfo output)
+{
+	StringInfo frameBuffer = stream->frameBuffer;
+	const char *storedData = NULL;
+
+	int storedLength = CompressFrame(stream->method, data, dataLength, frameBuffer);
+	if (storedLength <= 0 || storedLength >= dataLength)
+	{
+		storedData = data;
+		storedLength = dataLength;
+	}
+	else
+	{
+		storedData = frameBuffer->data;
+	}
+
+	uint32 rawLengthNetwork = pg_hton32((uint32) dataLength);
+	uint32 storedLengthNetwork = pg_hton32((uint32) storedLength);
+
+	appendBinaryStringInfo(output, (char *) &rawLengthNetwork, sizeof(uint32));
+	appendBinaryStringInfo(output, (char *) &storedLengthNetwork, sizeof(uint32));
+	appendBinaryStringInfo(output, storedData, storedLength);
+}
+
+
+/*
+ * CompressFrame compresses the given bytes into frameBuffer and returns the
+ * compressed length, or -1 if the data could not be compressed.
+ */
+static int
+CompressFrame(StreamCompressionMethod method, const char *data, int dataLength,
+			  StringInfo frameBuffer)
+{
+	switch (method)
+	{
+#if HAVE_CITUS_LIBLZ4
+		case STREAM_COMPRESSION_LZ4:
+		{
+			int maximumLength = LZ4_compressBound(dataLength);
+
+			resetStringInfo(frameBuffer);
+			enlargeStringInfo(frameBuffer, maximumLength);
+
+			int compressedLength = LZ4_compress_default(data, frameBuffer->data,
+														dataLength, maximumLength);
+			if (compressedLength <= 0)
+			{
+				return -1;
+			}
+
+			return compressedLength;
+		}
+#endif
+
+#if HAVE_LIBZSTD
+		case STREAM_COMPRESSION_ZSTD:
+		{
+			int maximumLength = ZSTD_compressBound(dataLength);
+
+			resetStringInfo(frameBuffer);
+			enlargeStringInfo(frameBuffer, maximumLength);
+
+			size_t compressedLength = ZSTD_compress(frameBuffer->data, maximumLength,
+													data, dataLength,
+													STREAM_COMPRESSION_ZSTD_LEVEL);
+			if (ZSTD_isError(compressedLength))
+			{
+				return -1;
+			}
+
+			return (int) compressedLength;
+		}
+#endif
+
+		default:
+		{
+			return -1;
+		}
+	}
+}
+
+
+/*
+ * CreateDecompressionStream returns a new decompression stream. Whether the
+ * stream is compressed, and with which method, is determined from the first
+ * bytes that are written to it.
+ */
+DecompressionStream *
+CreateDecompressionStream(void)
+{
+	DecompressionStream *stream = palloc0(sizeof(DecompressionStream));
+	stream->headerProcessed = false;
+	stream->compressed = false;
+	stream->method = STREAM_COMPRESSION_NONE;
+	stream->pendingData = makeStringInfo();
+
+	return stream;
+}
+
+
+/*
+ * DecompressionStreamWrite adds the given bytes to the stream and appends
+ * all bytes that can be decompressed so far to output.
+ */
+void
+DecompressionStreamWrite(DecompressionStream *stream, const char *data, int dataLength,
+						 StringInfo output)
+{
+	if (stream->headerProcessed && !stream->compressed)
+	{
+		appendBinaryStringInfo(output, data, dataLength);
+		return;
+	}
+
+	appendBinaryStringInfo(stream->pendingData, data, dataLength);
+
+	if (!stream->headerProcessed && !ProcessStreamHeader(stream, output))
+	{
+		/* need more bytes to decide whether the stream is compressed */
+		return;
+	}
+
+	if (stream->compressed)
+	{
+		AppendDecompressedFrames(stream, output);
+	}
+}
+
+
+/*
+ * DecompressionStreamFinish appends any remaining bytes to output and errors
+ * out if the stream ended in the middle of a compressed frame.
+ */
+void
+DecompressionStreamFinish(DecompressionStream *stream, StringInfo output)
+{
+	StringInfo pendingData = stream->pendingData;
+
+	if (!stream->headerProcessed)
+	{
+		/* stream is shorter than the header, so it cannot be compressed */
+		appendBinaryStringInfo(output, pendingData->data, pendingData->len);
+		resetStringInfo(pendingData);
+		stream->headerProcessed = true;
+		return;
+	}
+
+	if (stream->compressed && pendingData->len > pendingData->cursor)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+						errmsg("compressed stream ended unexpectedly")));
+	}
+}
+
+
+/*
+ * ProcessStreamHeader checks whether the pending data starts with the
+ * compression header. It returns false if there are not enough bytes to
+ * decide yet. Uncompressed pending data is moved to output.
+ */
+static bool
+ProcessStreamHeader(DecompressionStream *stream, StringInfo output)
+{
+	StringInfo pendingData = stream->pendingData;
+	int magicPrefixLength = Min(pendingData->len, STREAM_COMPRESSION_MAGIC_LENGTH);
+
+	if (memcmp(pendingData->data, STREAM_COMPRESSION_MAGIC, magicPrefixLength) != 0)
+	{
+		/* not a compressed stream, pass through everything */
+		appendBinaryStringInfo(output, pendingData->data, pendingData->len);
+		resetStringInfo(pendingData);
+
+		stream->headerProcessed = true;
+		stream->compressed = false;
+		return true;
+	}
+
+	if (pendingData->len < STREAM_COMPRESSION_HEADER_LENGTH)
+	{
+		return false;
+	}
+
+	StreamCompressionMethod method =
+		(StreamCompressionMethod) (uint8) pendingData->data[
+			STREAM_COMPRESSION_MAGIC_LENGTH];
+	if (method == STREAM_COMPRESSION_NONE || !StreamCompressionMethodSupported(method))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("stream is compressed with compression method %d, "
+							   "which is not supported by this build of Citus",
+							   method)));
+	}
+
+	pendingData->cursor = STREAM_COMPRESSION_HEADER_LENGTH;
+
+	stream->headerProcessed = true;
+	stream->compressed = true;
+	stream->method = method;
+	return true;
+}
+
+
+/*
+ * AppendDecompressedFrames decompresses all complete frames in the pending
+ * data of the stream and appends them to output.
+ */
+static void
+AppendDecompressedFrames(DecompressionStream *stream, StringInfo output)
+{
+	StringInfo pendingData = stream->pendingData;
+
+	while (pendingData->len - pendingData->cursor >=
+		   STREAM_COMPRESSION_FRAME_HEADER_LENGTH)
+	{
+		char *frame = pendingData->data + pendingData->cursor;
+		uint32 rawLength = 0;
+		uint32 storedLength = 0;
+
+		memcpy_s(&rawLength, sizeof(uint32), frame, sizeof(uint32));
+		memcpy_s(&storedLength, sizeof(uint32), frame + sizeof(uint32), sizeof(uint32));
+		rawLength = pg_ntoh32(rawLength);
+		storedLength = pg_ntoh32(storedLength);
+
+		if (rawLength > STREAM_COMPRESSION_FRAME_SIZE || storedLength > rawLength)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+							errmsg("invalid frame in compressed stream")));
+		}
+
+		uint32 availableLength = pendingData->len - pendingData->cursor -
+								 STREAM_COMPRESSION_FRAME_HEADER_LENGTH;
+		if (availableLength < storedLength)
+		{
+			/* wait for the rest of the frame */
+			break;
+		}
+
+		char *storedData = frame + STREAM_COMPRESSION_FRAME_HEADER_LENGTH;
+
+		if (storedLength == rawLength)
+		{
+			appendBinaryStringInfo(output, storedData, storedLength);
+		}
+		else
+		{
+			DecompressFrame(stream->method, storedData, storedLength, rawLength,
+							output);
+		}
+
+		pendingData->cursor += STREAM_COMPRESSION_FRAME_HEADER_LENGTH + storedLength;
+	}
+
+	DiscardConsumedData(pendingData);
+}
+
+
+/*
+ * DecompressFrame decompresses a single frame and appends the result to output.
+ */
+static void
+DecompressFrame(StreamCompressionMethod method, const char *storedData,
+				uint32 storedLength, uint32 rawLength, StringInfo output)
+{
+	enlargeStringInfo(output, rawLength);
+
+	char *outputData = output->data + output->len;
+
+	switch (method)
+	{
+#if HAVE_CITUS_LIBLZ4
+		case STREAM_COMPRESSION_LZ4:
+		{
+			int decompressedLength = LZ4_decompress_safe(storedData, outputData,
+														 storedLength, rawLength);
+			if (decompressedLength != (int) rawLength)
+			{
+				ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+								errmsg("cannot decompress lz4 frame of compressed "
+									   "stream")));
+			}
+
+			break;
+		}
+#endif
+
+#if HAVE_LIBZSTD
+		case STREAM_COMPRESSION_ZSTD:
+		{
+			size_t decompressedLength = ZSTD_decompress(outputData, rawLength,
+														storedData, storedLength);
+			if (ZSTD_isError(decompressedLength))
+			{
+				ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+								errmsg("cannot decompress zstd frame of compressed "
+									   "stream: %s",
+									   ZSTD_getErrorName(decompressedLength))));
+			}
+
+			if (decompressedLength != rawLength)
+			{
+				ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+								errmsg("unexpected size of decompressed zstd frame")));
+			}
+
+			break;
+		}
+#endif
+
+		default:
+		{
+			ereport(ERROR, (errmsg("unexpected compression method %d", method)));
+		}
+	}
+
+	output->len += rawLength;
+	output->data[output->len] = '\0';
+}
+
+
+/*
+ * DiscardConsumedData removes the bytes before the cursor from the buffer.
+ */
+static void
+DiscardConsumedData(StringInfo buffer)
+{
+	if (buffer->cursor == 0)
+	{
+		return;
+	}
+
+	int remainingLength = buffer->len - buffer->cursor;
+
+	if (remainingLength > 0)
+	{
+		memmove_s(buffer->data, buffer->maxlen, buffer->data + buffer->cursor,
+				  remainingLength);
+	}
+
+	buffer->len = remainingLength;
+	buffer->data[remainingLength] = '\0';
+	buffer->cursor = 0;
+}
+
+
+/*
+ * StreamCompressionMethodSupported returns whether the given compression
+ * method is available in this build.
+ */
+bool
+StreamCompressionMethodSupported(StreamCompressionMethod method)
+{
+	switch (method)
+	{
+		case STREAM_COMPRESSION_NONE:
+		{
+			return true;
+		}
+
+#if HAVE_CITUS_LIBLZ4
+		case STREAM_COMPRESSION_LZ4:
+		{
+			return true;
+		}
+#endif
+
+#if HAVE_LIBZSTD
+		case STREAM_COMPRESSION_ZSTD:
+		{
+			return true;
+		}
+#endif
+
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+
+/*
+ * StreamCompressionMethodName returns the name of the given compression
+ * method, which matches the values of the compression GUCs.
+ */
+const char *
+StreamCompressionMethodName(StreamCompressionMethod method)
+{
+	switch (method)
+	{
+		case STREAM_COMPRESSION_LZ4:
+		{
+			return "lz4";
+		}
+
+		case STREAM_COMPRESSION_ZSTD:
+		{
+			return "zstd";
+		}
+
+		default:
+		{
+			return "none";
+		}
+	}
+}
+
+
+/*
+ * StreamCompressionMethodFromName sets method to the compression method with
+ * the given name and returns whether the name is known. Whether the method is
+ * available in this build is checked separately.
+ */
+bool
+StreamCompressionMethodFromName(const char *methodName,
+								StreamCompressionMethod *method)
+{
+	if (strcmp(methodName, "none") == 0)
+	{
+		*method = STREAM_COMPRESSION_NONE;
+	}
+	else if (strcmp(methodName, "lz4") == 0)
+	{
+		*method = STREAM_COMPRESSION_LZ4;
+	}
+	else if (strcmp(methodName, "zstd") == 0)
+	{
+		*method = STREAM_COMPRESSION_ZSTD;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,645 @@
+/*-------------------------------------------------------------------------
+ *
+ * tdigest_sketch.c
+ *
+ * Implementation of the built-in t-digest sketch aggregates, which are used
+ * to approximate percentile_cont() when the compression for percentile
+ * approximations is set.
+ *
+ * Workers compute citus_tdigest_add_agg(column, compression), which groups the
+ * values into centroids of a mean and a weight. The coordinator merges the
+ * sketches of all workers using citus_tdigest_union_agg and interpolates the
+ * requested percentiles between the centroids using citus_tdigest_percentile.
+ *
+ * A sketch is a bytea that consists of a header followed by the centroids.
+ * While aggregating, the sketch has room for more centroids than it keeps
+ * after compression, such that new values are appended in place and only
+ * merged into the existing centroids when that room runs out. The final
+ * functions return a compressed copy that is trimmed to its centroids.
+ *
+ * Centroids are merged using the k1 scale function of the t-digest paper, so
+ * that the centroids near the tails stay small and the extreme percentiles
+ * are accurate. A compressed sketch has at most compression + 2 centroids.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <math.h>
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "safe_lib.h"
+
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/float.h"
+
+
+/* range of compression that we accept, see citus.percentile_approximation_compression */
+#define TDIGEST_MIN_COMPRESSION 10
+#define TDIGEST_MAX_COMPRESSION 10000
+
+/* number of centroids an aggregate can hold per unit of compression */
+#define TDIGEST_BUFFER_FACTOR 5
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TDIGEST_SKETCH_SIZE(centroidCount) \
+	(offsetof(TDigestSketch, centroids) + (centroidCount) * sizeof(TDigestCentroid))
+
+
+/*
+ * TDigestCentroid represents the values that were merged into one centroid.
+ */
+typedef struct TDigestCentroid
+{
+	double mean;
+	double weight;
+} TDigestCentroid;
+
+
+/*
+ * TDigestSketch is the in-memory and on-the-wire layout of a sketch. The size
+ * of the bytea determines how many centroids fit into it.
+ */
+typedef struct TDigestSketch
+{
+	int32 vl_len_;
+	int32 compression;
+	int32 centroidCount;
+	int32 padding;		/* keeps the doubles aligned */
+	double minValue;
+	double maxValue;
+	TDigestCentroid centroids[FLEXIBLE_ARRAY_MEMBER];
+} TDigestSketch;
+
+
+static TDigestSketch * CreateTDigestSketch(FunctionCallInfo fcinfo, int compression);
+static TDigestSketch * CopyTDigestSketch(FunctionCallInfo fcinfo,
+										 TDigestSketch *sketch);
+static TDigestSketch * GetTDigestSketchArg(FunctionCallInfo fcinfo,
+										   int argumentIndex);
+static void CheckTDigestSketch(TDigestSketch *sketch);
+static int TDigestSketchCapacity(TDigestSketch *sketch);
+static void TDigestSketchAddCentroid(TDigestSketch *sketch, double mean,
+									 double weight);
+static void CompressTDigestSketch(TDigestSketch *sketch);
+static int CompareTDigestCentroids(const void *leftElement, const void *rightElement);
+static double TDigestScale(double quantile, double compression);
+static double TDigestScaleInverse(double scale, double compression);
+static double TDigestSketchTotalWeight(TDigestSketch *sketch);
+static double TDigestSketchPercentile(TDigestSketch *sketch, double percentile);
+static double Interpolate(double leftPosition, double leftValue, double rightPosition,
+						  double rightValue, double position);
+static void CheckPercentile(double percentile);
+
+
+PG_FUNCTION_INFO_V1(citus_tdigest_add_sfunc);
+PG_FUNCTION_INFO_V1(citus_tdigest_union_sfunc);
+PG_FUNCTION_INFO_V1(citus_tdigest_final);
+PG_FUNCTION_INFO_V1(citus_tdigest_percentile);
+PG_FUNCTION_INFO_V1(citus_tdigest_percentile_array);
+
+
+/*
+ * citus_tdigest_add_sfunc is the transition function of citus_tdigest_add_agg.
+ * It adds the value in the second argument to the sketch, which is created
+ * with the given compression on the first non-null value.
+ */
+Datum
+citus_tdigest_add_sfunc(PG_FUNCTION_ARGS)
+{
+	TDigestSketch *sketch = PG_ARGISNULL(0) ? NULL : GetTDigestSketchArg(fcinfo, 0);
+
+	if (PG_ARGISNULL(1))
+	{
+		if (sketch == NULL)
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_BYTEA_P(sketch);
+	}
+
+	double value = PG_GETARG_FLOAT8(1);
+
+	if (sketch == NULL)
+	{
+		if (PG_ARGISNULL(2))
+		{
+			ereport(ERROR, (errmsg("citus_tdigest_add_agg requires a compression")));
+		}
+
+		sketch = CreateTDigestSketch(fcinfo, PG_GETARG_INT32(2));
+		sketch->minValue = value;
+		sketch->maxValue = value;
+	}
+	else if (float8_lt(value, sketch->minValue))
+	{
+		sketch->minValue = value;
+	}
+	else if (float8_gt(value, sketch->maxValue))
+	{
+		sketch->maxValue = value;
+	}
+
+	TDigestSketchAddCentroid(sketch, value, 1.0);
+
+	PG_RETURN_BYTEA_P(sketch);
+}
+
+
+/*
+ * citus_tdigest_union_sfunc is the transition and combine function of
+ * citus_tdigest_union_agg, and the combine function of citus_tdigest_add_agg.
+ * It adds the centroids of the sketch in the second argument to the first one,
+ * which keeps its compression.
+ */
+Datum
+citus_tdigest_union_sfunc(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_BYTEA_P(GetTDigestSketchArg(fcinfo, 0));
+	}
+
+	/* copy, since centroids of a sketch stored in a tuple may not be aligned */
+	TDigestSketch *otherSketch = (TDigestSketch *) PG_GETARG_BYTEA_P_COPY(1);
+	CheckTDigestSketch(otherSketch);
+
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_BYTEA_P(CopyTDigestSketch(fcinfo, otherSketch));
+	}
+
+	TDigestSketch *sketch = GetTDigestSketchArg(fcinfo, 0);
+
+	if (float8_lt(otherSketch->minValue, sketch->minValue))
+	{
+		sketch->minValue = otherSketch->minValue;
+	}
+
+	if (float8_gt(otherSketch->maxValue, sketch->maxValue))
+	{
+		sketch->maxValue = otherSketch->maxValue;
+	}
+
+	for (int centroidIndex = 0; centroidIndex < otherSketch->centroidCount;
+		 centroidIndex++)
+	{
+		TDigestCentroid *centroid = &otherSketch->centroids[centroidIndex];
+
+		TDigestSketchAddCentroid(sketch, centroid->mean, centroid->weight);
+	}
+
+	pfree(otherSketch);
+
+	PG_RETURN_BYTEA_P(sketch);
+}
+
+
+/*
+ * citus_tdigest_final is the final function of citus_tdigest_add_agg and
+ * citus_tdigest_union_agg. It returns a compressed copy of the sketch that
+ * only takes the space of its centroids, to keep the results that workers
+ * send to the coordinator small.
+ */
+Datum
+citus_tdigest_final(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_NULL();
+	}
+
+	TDigestSketch *sketch = (TDigestSketch *) PG_GETARG_BYTEA_P(0);
+	CheckTDigestSketch(sketch);
+
+	/* the transition state must not be modified, so compress a copy */
+	TDigestSketch *compressedSketch = CopyTDigestSketch(NULL, sketch);
+	CompressTDigestSketch(compressedSketch);
+	SET_VARSIZE(compressedSketch, TDIGEST_SKETCH_SIZE(compressedSketch->centroidCount));
+
+	PG_RETURN_BYTEA_P(compressedSketch);
+}
+
+
+/*
+ * citus_tdigest_percentile returns the approximate value below which the given
+ * fraction of the values in the sketch lie, interpolating between the
+ * centroids in the same way as percentile_cont() interpolates between rows.
+ */
+Datum
+citus_tdigest_percentile(PG_FUNCTION_ARGS)
+{
+	TDigestSketch *sketch = (TDigestSketch *) PG_GETARG_BYTEA_P_COPY(0);
+	double percentile = PG_GETARG_FLOAT8(1);
+
+	CheckTDigestSketch(sketch);
+	CheckPercentile(percentile);
+
+	qsort(sketch->centroids, sketch->centroidCount, sizeof(TDigestCentroid),
+		  CompareTDigestCentroids);
+
+	PG_RETURN_FLOAT8(TDigestSketchPercentile(sketch, percentile));
+}
+
+
+/*
+ * citus_tdigest_percentile_array returns the approximate percentiles for each
+ * of the fractions in the given array, in an array of the same shape. Like
+ * for percentile_cont(), NULL fractions give NULL percentiles.
+ */
+Datum
+citus_tdigest_percentile_array(PG_FUNCTION_ARGS)
+{
+	TDigestSketch *sketch = (TDigestSketch *) PG_GETARG_BYTEA_P_COPY(0);
+	ArrayType *percentileArray = PG_GETARG_ARRAYTYPE_P(1);
+	Datum *percentileDatums = NULL;
+	bool *percentileNulls = NULL;
+	int percentileCount = 0;
+
+	CheckTDigestSketch(sketch);
+
+	if (ARR_NDIM(percentileArray) == 0)
+	{
+		PG_RETURN_POINTER(construct_empty_array(FLOAT8OID));
+	}
+
+	deconstruct_array(percentileArray, FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL,
+					  TYPALIGN_DOUBLE, &percentileDatums, &percentileNulls,
+					  &percentileCount);
+
+	qsort(sketch->centroids, sketch->centroidCount, sizeof(TDigestCentroid),
+		  CompareTDigestCentroids);
+
+	Datum *resultDatums = palloc0(percentileCount * sizeof(Datum));
+
+	for (int percentileIndex = 0; percentileIndex < percentileCount; percentileIndex++)
+	{
+		if (percentileNulls[percentileIndex])
+		{
+			continue;
+		}
+
+		double percentile = DatumGetFloat8(percentileDatums[percentileIndex]);
+		CheckPercentile(percentile);
+
+		double result = TDigestSketchPercentile(sketch, percentile);
+		resultDatums[percentileIndex] = Float8GetDatum(result);
+	}
+
+	ArrayType *resultArray = construct_md_array(resultDatums, percentileNulls,
+												ARR_NDIM(percentileArray),
+												ARR_DIMS(percentileArray),
+												ARR_LBOUND(percentileArray),
+												FLOAT8OID, sizeof(float8),
+												FLOAT8PASSBYVAL, TYPALIGN_DOUBLE);
+
+	PG_RETURN_ARRAYTYPE_P(resultArray);
+}
+
+
+/*
+ * CreateTDigestSketch returns an empty sketch with room for the centroids of
+ * an aggregate with the given compression, allocated in the aggregate context
+ * if there is one.
+ */
+static TDigestSketch *
+CreateTDigestSketch(FunctionCallInfo fcinfo, int compression)
+{
+	MemoryContext aggregateContext = NULL;
+
+	if (compression < TDIGEST_MIN_COMPRESSION || compression > TDIGEST_MAX_COMPRESSION)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("compression must be between %d and %d",
+							   TDIGEST_MIN_COMPRESSION, TDIGEST_MAX_COMPRESSION)));
+	}
+
+	if (fcinfo == NULL || !AggCheckCallContext(fcinfo, &aggregateContext))
+	{
+		aggregateContext = CurrentMemoryContext;
+	}
+
+	Size sketchSize = TDIGEST_SKETCH_SIZE(compression * TDIGEST_BUFFER_FACTOR);
+	TDigestSketch *sketch = MemoryContextAllocZero(aggregateContext, sketchSize);
+	SET_VARSIZE(sketch, sketchSize);
+	sketch->compression = compression;
+
+	return sketch;
+}
+
+
+/*
+ * CopyTDigestSketch returns a copy of the given sketch with room for the
+ * centroids of an aggregate, allocated in the aggregate context if there is
+ * one.
+ */
+static TDigestSketch *
+CopyTDigestSketch(FunctionCallInfo fcinfo, TDigestSketch *sketch)
+{
+	TDigestSketch *copy = CreateTDigestSketch(fcinfo, sketch->compression);
+
+	/* a sketch from another node may have a lower compression than its size */
+	if (TDigestSketchCapacity(copy) < sketch->centroidCount)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						errmsg("invalid t-digest sketch")));
+	}
+
+	copy->centroidCount = sketch->centroidCount;
+	copy->minValue = sketch->minValue;
+	copy->maxValue = sketch->maxValue;
+
+	Size centroidSize = sketch->centroidCount * sizeof(TDigestCentroid);
+	memcpy_s(copy->centroids, centroidSize, sketch->centroids, centroidSize);
+
+	return copy;
+}
+
+
+/*
+ * GetTDigestSketchArg returns the sketch in the given argument, which may be
+ * updated in place. That is only allowed for the transition state of an
+ * aggregate, so we make a copy when not called as an aggregate.
+ */
+static TDigestSketch *
+GetTDigestSketchArg(FunctionCallInfo fcinfo, int argumentIndex)
+{
+	TDigestSketch *sketch = NULL;
+
+	if (AggCheckCallContext(fcinfo, NULL))
+	{
+		sketch = (TDigestSketch *) PG_GETARG_BYTEA_P(argumentIndex);
+		CheckTDigestSketch(sketch);
+	}
+	else
+	{
+		/* make room to add centroids to the copy */
+		TDigestSketch *argumentSketch =
+			(TDigestSketch *) PG_GETARG_BYTEA_P_COPY(argumentIndex);
+		CheckTDigestSketch(argumentSketch);
+
+		sketch = CopyTDigestSketch(NULL, argumentSketch);
+	}
+
+	return sketch;
+}
+
+
+/*
+ * CheckTDigestSketch errors out if the given detoasted bytea is not a valid
+ * sketch, such that we never read beyond its centroids and all weights are
+ * positive.
+ */
+static void
+CheckTDigestSketch(TDigestSketch *sketch)
+{
+	Size sketchSize = VARSIZE(sketch);
+
+	if (sketchSize < offsetof(TDigestSketch, centroids) ||
+		sketch->compression < TDIGEST_MIN_COMPRESSION ||
+		sketch->compression > TDIGEST_MAX_COMPRESSION ||
+		sketch->centroidCount < 1 ||
+		sketch->centroidCount > TDigestSketchCapacity(sketch))
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						errmsg("invalid t-digest sketch")));
+	}
+
+	for (int centroidIndex = 0; centroidIndex < sketch->centroidCount;
+		 centroidIndex++)
+	{
+		if (!(sketch->centroids[centroidIndex].weight > 0.0))
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+							errmsg("invalid t-digest sketch")));
+		}
+	}
+}
+
+
+/*
+ * TDigestSketchCapacity returns the number of centroids that fit into the
+ * given sketch.
+ */
+static int
+TDigestSketchCapacity(TDigestSketch *sketch)
+{
+	Size centroidSpace = VARSIZE(sketch) - offsetof(TDigestSketch, centroids);
+
+	return (int) (centroidSpace / sizeof(TDigestCentroid));
+}
+
+
+/*
+ * TDigestSketchAddCentroid appends a centroid to a sketch that was created with
+ * room for the centroids of an aggregate, and compresses the sketch when that
+ * room runs out.
+ */
+static void
+TDigestSketchAddCentroid(TDigestSketch *sketch, double mean, double weight)
+{
+	if (sketch->centroidCount >= TDigestSketchCapacity(sketch))
+	{
+		CompressTDigestSketch(sketch);
+	}
+
+	TDigestCentroid *centroid = &sketch->centroids[sketch->centroidCount];
+	centroid->mean = mean;
+	centroid->weight = weight;
+	sketch->centroidCount++;
+}
+
+
+/*
+ * CompressTDigestSketch sorts the centroids of the sketch and merges adjacent
+ * centroids in place, as long as the merged centroid does not span more than
+ * one unit of the scale function.
+ */
+static void
+CompressTDigestSketch(TDigestSketch *sketch)
+{
+	TDigestCentroid *centroids = sketch->centroids;
+	double compression = sketch->compression;
+	double totalWeight = TDigestSketchTotalWeight(sketch);
+	double weightSoFar = 0.0;
+	int lastCentroidIndex = 0;
+
+	qsort(centroids, sketch->centroidCount, sizeof(TDigestCentroid),
+		  CompareTDigestCentroids);
+
+	double weightLimit = totalWeight *
+						 TDigestScaleInverse(TDigestScale(0.0, compression) + 1.0,
+											 compression);
+
+	for (int centroidIndex = 1; centroidIndex < sketch->centroidCount; centroidIndex++)
+	{
+		TDigestCentroid *lastCentroid = &centroids[lastCentroidIndex];
+		TDigestCentroid *centroid = &centroids[centroidIndex];
+		double mergedWeight = lastCentroid->weight + centroid->weight;
+
+		if (weightSoFar + mergedWeight <= weightLimit)
+		{
+			if (lastCentroid->mean != centroid->mean)
+			{
+				lastCentroid->mean += (centroid->mean - lastCentroid->mean) *
+									  centroid->weight / mergedWeight;
+			}
+
+			lastCentroid->weight = mergedWeight;
+		}
+		else
+		{
+			weightSoFar += lastCentroid->weight;
+			weightLimit = totalWeight *
+						  TDigestScaleInverse(TDigestScale(weightSoFar / totalWeight,
+														   compression) + 1.0,
+											  compression);
+
+			lastCentroidIndex++;
+			centroids[lastCentroidIndex] = *centroid;
+		}
+	}
+
+	sketch->centroidCount = lastCentroidIndex + 1;
+}
+
+
+/*
+ * CompareTDigestCentroids orders centroids by their mean, in the same way as
+ * the float8 comparison operators.
+ */
+static int
+CompareTDigestCentroids(const void *leftElement, const void *rightElement)
+{
+	const TDigestCentroid *leftCentroid = (const TDigestCentroid *) leftElement;
+	const TDigestCentroid *rightCentroid = (const TDigestCentroid *) rightElement;
+
+	return float8_cmp_internal(leftCentroid->mean, rightCentroid->mean);
+}
+
+
+/*
+ * TDigestScale is the k1 scale function, which maps a quantile to a scale of
+ * compression / 2 units that are narrow near the tails.
+ */
+static double
+TDigestScale(double quantile, double compression)
+{
+	return compression / (2.0 * M_PI) * asin(2.0 * quantile - 1.0);
+}
+
+
+/*
+ * TDigestScaleInverse maps a scale back to a quantile, which is capped at 1.
+ */
+static double
+TDigestScaleInverse(double scale, double compression)
+{
+	double angle = Min(scale * 2.0 * M_PI / compression, M_PI / 2.0);
+
+	return (sin(angle) + 1.0) / 2.0;
+}
+
+
+/*
+ * TDigestSketchTotalWeight returns the number of values in the sketch.
+ */
+static double
+TDigestSketchTotalWeight(TDigestSketch *sketch)
+{
+	double totalWeight = 0.0;
+
+	for (int centroidIndex = 0; centroidIndex < sketch->centroidCount;
+		 centroidIndex++)
+	{
+		totalWeight += sketch->centroids[centroidIndex].weight;
+	}
+
+	return totalWeight;
+}
+
+
+/*
+ * TDigestSketchPercentile returns the percentile of a sketch with sorted
+ * centroids. Every centroid is placed at the middle of the ranks of its values,
+ * and percentile_cont()'s rank is interpolated between the neighbouring
+ * centroids, or the minimum and maximum at the ends. That gives the exact
+ * result when no values were merged.
+ */
+static double
+TDigestSketchPercentile(TDigestSketch *sketch, double percentile)
+{
+	double totalWeight = TDigestSketchTotalWeight(sketch);
+	double targetPosition = percentile * (totalWeight - 1.0) + 0.5;
+	double previousPosition = 0.5;
+	double previousValue = sketch->minValue;
+	double weightSoFar = 0.0;
+
+	for (int centroidIndex = 0; centroidIndex < sketch->centroidCount;
+		 centroidIndex++)
+	{
+		TDigestCentroid *centroid = &sketch->centroids[centroidIndex];
+		double position = weightSoFar + centroid->weight / 2.0;
+
+		if (targetPosition <= position)
+		{
+			return Interpolate(previousPosition, previousValue, position,
+							   centroid->mean, targetPosition);
+		}
+
+		previousPosition = position;
+		previousValue = centroid->mean;
+		weightSoFar += centroid->weight;
+	}
+
+	return Interpolate(previousPosition, previousValue, totalWeight - 0.5,
+					   sketch->maxValue, targetPosition);
+}
+
+
+/*
+ * Interpolate returns the value at the given position on the line between two
+ * points, or the right value if the points are at the same position.
+ */
+static double
+Interpolate(double leftPosition, double leftValue, double rightPosition,
+			double rightValue, double position)
+{
+	if (rightPosition <= leftPosition)
+	{
+		return rightValue;
+	}
+
+	return leftValue + (rightValue - leftValue) * (position - leftPosition) /
+		   (rightPosition - leftPosition);
+}
+
+
+/*
+ * CheckPercentile errors out if the given fraction is not between 0 and 1, in
+ * the same way as percentile_cont().
+ */
+static void
+CheckPercentile(double percentile)
+{
+	if (percentile < 0.0 || percentile > 1.0 || isnan(percentile))
+	{
+		ereport(ERROR, (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						errmsg("percentile value %g is not between 0 and 1",
+							   percentile)));
+	}
+}
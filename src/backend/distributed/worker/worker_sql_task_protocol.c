@@ -21,6 +21,7 @@
 #include "utils/memutils.h"
 
 #include "distributed/commands/multi_copy.h"
+#include "distributed/intermediate_results.h"
 #include "distributed/multi_executor.h"
 #include "distributed/transmit.h"
 #include "distributed/version_compat.h"
@@ -47,12 +48,24 @@ typedef struct TaskFileDestReceiver
 	/* output file */
 	char *filePath;
 	FileCompat fileCompat;
+	bool fileOpened;
 	bool binaryCopyFormat;
 
+	/*
+	 * When bufferInMemory is set, the data is kept in memoryBuffer until it
+	 * exceeds COPY_BUFFER_SIZE, at which point it is spilled to the file.
+	 */
+	bool bufferInMemory;
+	StringInfo memoryBuffer;
+
 	/* state on how to copy out data types */
 	CopyOutState copyOutState;
 	FmgrInfo *columnOutputFunctions;
 
+	/* compression state, NULL if the file is not compressed */
+	CompressionStream *compressionStream;
+	StringInfo compressedData;
+
 	/* statistics */
 	uint64 tuplesSent;
 	uint64 bytesSent;
@@ -63,6 +76,8 @@ static void TaskFileDestReceiverStartup(DestReceiver *dest, int operation,
 										TupleDesc inputTupleDescriptor);
 static bool TaskFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
 static void WriteToLocalFile(StringInfo copyData, TaskFileDestReceiver *taskFileDest);
+static void WriteBytesToLocalFile(StringInfo data, TaskFileDestReceiver *taskFileDest);
+static void OpenTaskFile(TaskFileDestReceiver *taskFileDest);
 static void TaskFileDestReceiverShutdown(DestReceiver *destReceiver);
 static void TaskFileDestReceiverDestroy(DestReceiver *destReceiver);
 
@@ -86,10 +101,13 @@ worker_execute_sql_task(PG_FUNCTION_ARGS)
 
 /*
  * CreateFileDestReceiver creates a DestReceiver for writing query results
- * to a file.
+ * to a file. If bufferInMemory is true, the file is only created when the
+ * results do not fit into a single COPY buffer and otherwise the results
+ * can be obtained via FileDestReceiverMemoryBuffer.
  */
 DestReceiver *
-CreateFileDestReceiver(char *filePath, MemoryContext tupleContext, bool binaryCopyFormat)
+CreateFileDestReceiver(char *filePath, MemoryContext tupleContext, bool binaryCopyFormat,
+					   bool bufferInMemory)
 {
 	TaskFileDestReceiver *taskFileDest = (TaskFileDestReceiver *) palloc0(
 		sizeof(TaskFileDestReceiver));
@@ -106,6 +124,7 @@ CreateFileDestReceiver(char *filePath, MemoryContext tupleContext, bool binaryCo
 	taskFileDest->memoryContext = CurrentMemoryContext;
 	taskFileDest->filePath = pstrdup(filePath);
 	taskFileDest->binaryCopyFormat = binaryCopyFormat;
+	taskFileDest->bufferInMemory = bufferInMemory;
 
 	return (DestReceiver *) taskFileDest;
 }
@@ -125,8 +144,6 @@ TaskFileDestReceiverStartup(DestReceiver *dest, int operation,
 	const char *delimiterCharacter = "\t";
 	const char *nullPrintCharacter = "\\N";
 
-	const int fileFlags = (O_APPEND | O_CREAT | O_RDWR | O_TRUNC | PG_BINARY);
-
 	/* use the memory context that was in place when the DestReceiver was created */
 	MemoryContext oldContext = MemoryContextSwitchTo(taskFileDest->memoryContext);
 
@@ -145,9 +162,17 @@ TaskFileDestReceiverStartup(DestReceiver *dest, int operation,
 	taskFileDest->columnOutputFunctions = ColumnOutputFunctions(inputTupleDescriptor,
 																copyOutState->binary);
 
-	taskFileDest->fileCompat = FileCompatFromFileStart(FileOpenForTransmit(
-														   taskFileDest->filePath,
-														   fileFlags));
+	taskFileDest->compressionStream = CreateIntermediateResultCompressionStream();
+	taskFileDest->compressedData = makeStringInfo();
+
+	if (taskFileDest->bufferInMemory)
+	{
+		taskFileDest->memoryBuffer = makeStringInfo();
+	}
+	else
+	{
+		OpenTaskFile(taskFileDest);
+	}
 
 	if (copyOutState->binary)
 	{
@@ -205,13 +230,62 @@ TaskFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 
 
 /*
- * WriteToLocalResultsFile writes the bytes in a StringInfo to a local file.
+ * WriteToLocalResultsFile writes the bytes in a StringInfo to a local file,
+ * compressing them first if the file is compressed.
  */
 static void
 WriteToLocalFile(StringInfo copyData, TaskFileDestReceiver *taskFileDest)
 {
-	int bytesWritten = FileWriteCompat(&taskFileDest->fileCompat, copyData->data,
-									   copyData->len, PG_WAIT_IO);
+	if (taskFileDest->compressionStream != NULL)
+	{
+		StringInfo compressedData = taskFileDest->compressedData;
+
+		resetStringInfo(compressedData);
+		CompressionStreamWrite(taskFileDest->compressionStream, copyData->data,
+							   copyData->len, compressedData);
+
+		copyData = compressedData;
+	}
+
+	WriteBytesToLocalFile(copyData, taskFileDest);
+}
+
+
+/*
+ * WriteBytesToLocalFile writes the bytes in a StringInfo to the file as-is.
+ * When buffering in memory, the bytes are appended to the memory buffer
+ * instead, unless that would make the buffer exceed COPY_BUFFER_SIZE, in
+ * which case the buffered bytes are spilled to the file.
+ */
+static void
+WriteBytesToLocalFile(StringInfo data, TaskFileDestReceiver *taskFileDest)
+{
+	if (data->len == 0)
+	{
+		return;
+	}
+
+	StringInfo memoryBuffer = taskFileDest->memoryBuffer;
+	if (memoryBuffer != NULL)
+	{
+		if ((uint64) memoryBuffer->len + data->len <= COPY_BUFFER_SIZE)
+		{
+			appendBinaryStringInfo(memoryBuffer, data->data, data->len);
+			return;
+		}
+
+		/* results do not fit in memory, continue writing to the file */
+		taskFileDest->memoryBuffer = NULL;
+		OpenTaskFile(taskFileDest);
+
+		WriteBytesToLocalFile(memoryBuffer, taskFileDest);
+
+		pfree(memoryBuffer->data);
+		pfree(memoryBuffer);
+	}
+
+	int bytesWritten = FileWriteCompat(&taskFileDest->fileCompat, data->data,
+									   data->len, PG_WAIT_IO);
 	if (bytesWritten < 0)
 	{
 		ereport(ERROR, (errcode_for_file_access(),
@@ -222,6 +296,21 @@ WriteToLocalFile(StringInfo copyData, TaskFileDestReceiver *taskFileDest)
 }
 
 
+/*
+ * OpenTaskFile creates the output file of the TaskFileDestReceiver.
+ */
+static void
+OpenTaskFile(TaskFileDestReceiver *taskFileDest)
+{
+	const int fileFlags = (O_APPEND | O_CREAT | O_RDWR | O_TRUNC | PG_BINARY);
+
+	taskFileDest->fileCompat = FileCompatFromFileStart(FileOpenForTransmit(
+														   taskFileDest->filePath,
+														   fileFlags));
+	taskFileDest->fileOpened = true;
+}
+
+
 /*
  * TaskFileDestReceiverShutdown implements the rShutdown interface of
  * TaskFileDestReceiver. It writes the footer and closes the file.
@@ -247,7 +336,20 @@ TaskFileDestReceiverShutdown(DestReceiver *destReceiver)
 		resetStringInfo(copyOutState->fe_msgbuf);
 	}
 
-	FileClose(taskFileDest->fileCompat.fd);
+	if (taskFileDest->compressionStream != NULL)
+	{
+		/* flush the remaining (possibly uncompressed) bytes */
+		StringInfo compressedData = taskFileDest->compressedData;
+
+		resetStringInfo(compressedData);
+		CompressionStreamFinish(taskFileDest->compressionStream, compressedData);
+		WriteBytesToLocalFile(compressedData, taskFileDest);
+	}
+
+	if (taskFileDest->fileOpened)
+	{
+		FileClose(taskFileDest->fileCompat.fd);
+	}
 }
 
 
@@ -282,6 +384,7 @@ TaskFileDestReceiverDestroy(DestReceiver *destReceiver)
 
 /*
  * FileDestReceiverStats returns statistics for the given file dest receiver.
+ * Bytes that are kept in memory are not counted, since they are not written.
  */
 void
 FileDestReceiverStats(DestReceiver *dest, uint64 *rowsSent, uint64 *bytesSent)
@@ -290,3 +393,15 @@ FileDestReceiverStats(DestReceiver *dest, uint64 *rowsSent, uint64 *bytesSent)
 	*rowsSent = fileDestReceiver->tuplesSent;
 	*bytesSent = fileDestReceiver->bytesSent;
 }
+
+
+/*
+ * FileDestReceiverMemoryBuffer returns the results that the given file dest
+ * receiver kept in memory, or NULL if the results were written to the file.
+ */
+StringInfo
+FileDestReceiverMemoryBuffer(DestReceiver *dest)
+{
+	TaskFileDestReceiver *fileDestReceiver = (TaskFileDestReceiver *) dest;
+	return fileDestReceiver->memoryBuffer;
+}
@@ -13,6 +13,7 @@
 #define MULTI_COPY_H
 
 
+#include "commands/copy.h"
 #include "nodes/execnodes.h"
 #include "nodes/parsenodes.h"
 #include "parser/parse_coerce.h"
@@ -159,6 +160,9 @@ typedef struct CitusCopyDestReceiver
 
 /* GUCs */
 extern bool SkipJsonbValidationInCopy;
+extern bool SkipRowValidationInCopy;
+extern int MaxCopyToConnections;
+extern bool CopyToPreserveShardOrder;
 
 /* managed via GUC, the default is 4MB */
 extern int CopySwitchOverThresholdBytes;
@@ -171,6 +175,17 @@ extern CitusCopyDestReceiver * CreateCitusCopyDestReceiver(Oid relationId,
 														   EState *executorState,
 														   char *intermediateResultPrefix,
 														   bool isPublishable);
+extern void CitusCopyDestReceiverSendRawRow(CitusCopyDestReceiver *copyDest,
+											int64 shardId, StringInfo rowData);
+extern bool ShardIntervalListHasLocalPlacements(List *shardIntervalList);
+extern CopyFromState BeginCopyFromDistributedTable(Relation distributedRelation,
+												   CopyStmt *copyStatement,
+												   copy_data_source_cb dataSourceCallback,
+												   int partitionColumnIndex,
+												   bool skipJsonbValidation,
+												   bool binaryOutput,
+												   FmgrInfo *columnOutputFunctions);
+extern bool CopyInputIncludesAllColumns(Relation relation, List *attnameList);
 extern FmgrInfo * ColumnOutputFunctions(TupleDesc rowDescriptor, bool binaryFormat);
 extern bool CanUseBinaryCopyFormat(TupleDesc tupleDescription);
 extern bool CanUseBinaryCopyFormatForTargetList(List *targetEntryList);
@@ -22,6 +22,25 @@
 #include "distributed/citus_custom_scan.h"
 
 
+/*
+ * ShardQueryTemplate is a query that is deparsed once with placeholders in
+ * the places of the shard names, such that the query strings of tasks that
+ * only differ in the shards they access can be generated by substituting
+ * the shard names rather than by deparsing the query for each task.
+ */
+typedef struct ShardQueryTemplate
+{
+	/* parts of the query string around the shard names */
+	List *queryFragmentList;
+
+	/* relation whose shard name follows each fragment, except the last one */
+	List *relationIdList;
+} ShardQueryTemplate;
+
+
+extern bool EnableShardQueryTemplates;
+
+
 extern void RebuildQueryStrings(Job *workerJob);
 extern bool UpdateRelationToShardNames(Node *node, List *relationShardList);
 extern void SetTaskQueryIfShouldLazyDeparse(Task *task, Query *query);
@@ -31,6 +50,9 @@ extern char * TaskQueryString(Task *task);
 extern char * TaskQueryStringAtIndex(Task *task, int index);
 extern int GetTaskQueryType(Task *task);
 extern void AddInsertAliasIfNeeded(Query *query);
+extern ShardQueryTemplate * DeparseShardQueryTemplate(Query *query);
+extern char * InstantiateShardQueryTemplate(ShardQueryTemplate *queryTemplate,
+											List *relationShardList);
 
 
 #endif /* DEPARSE_SHARD_QUERY_H */
@@ -37,6 +37,9 @@
 /* level of planner calls */
 extern int PlannerLevel;
 
+/* whether to plan multi-shard SELECTs without bound parameter values */
+extern bool EnableGenericMultiShardPlans;
+
 
 typedef struct RelationRestrictionContext
 {
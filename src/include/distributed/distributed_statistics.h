@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * distributed_statistics.h
+ *	  Declarations for gathering the statistics of shards into the
+ *	  coordinator.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef DISTRIBUTED_STATISTICS_H
+#define DISTRIBUTED_STATISTICS_H
+
+#include "postgres.h"
+
+#include "nodes/pathnodes.h"
+
+
+/* GUC that determines how often the maintenance daemon gathers statistics */
+extern int DistributedAnalyzeInterval;
+
+extern void AnalyzeDistributedTable(Oid relationId);
+extern int TryAnalyzeDistributedTables(void);
+extern void SetDistributedTableSizeEstimate(Oid relationId, RelOptInfo *rel);
+
+#endif /* DISTRIBUTED_STATISTICS_H */
@@ -0,0 +1,28 @@
+/*-------------------------------------------------------------------------
+ *
+ * hot_tenant_isolation.h
+ *	  Declarations for isolating busy tenants to their own shards in the
+ *	  background.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef HOT_TENANT_ISOLATION_H
+#define HOT_TENANT_ISOLATION_H
+
+#include "postgres.h"
+
+
+/* GUCs that determine when the maintenance daemon isolates a tenant */
+extern int HotTenantIsolationInterval;
+extern int HotTenantQueryThreshold;
+extern double HotTenantCpuThreshold;
+extern int HotTenantSustainTime;
+
+extern int64 ScheduleTenantIsolation(Oid relationId, char *tenantValue,
+									 char shardTransferMode);
+extern int TryScheduleHotTenantIsolation(void);
+
+#endif /* HOT_TENANT_ISOLATION_H */
@@ -21,6 +21,7 @@
 #include "utils/palloc.h"
 
 #include "distributed/commands/multi_copy.h"
+#include "distributed/utils/stream_compression.h"
 
 
 /*
@@ -73,6 +74,10 @@ typedef struct NodeToNodeFragmentsTransfer
 /* Forward Declarations */
 struct CitusTableCacheEntry;
 
+/* GUC variables */
+extern int IntermediateResultCompression;
+extern int IntermediateResultCompressionThreshold;
+
 /* intermediate_results.c */
 extern DestReceiver * CreateRemoteFileDestReceiver(const char *resultId,
 												   EState *executorState,
@@ -92,6 +97,7 @@ extern CitusTableCacheEntry * QueryTupleShardSearchInfo(ArrayType *minValuesArra
 														Var *partitionColumn);
 extern void WriteToLocalFile(StringInfo copyData, FileCompat *fileCompat);
 extern uint64 RemoteFileDestReceiverBytesSent(DestReceiver *destReceiver);
+extern CompressionStream * CreateIntermediateResultCompressionStream(void);
 extern void SendQueryResultViaCopy(const char *resultId);
 extern void ReceiveQueryResultViaCopy(const char *resultId);
 extern void RemoveIntermediateResultsDirectories(void);
@@ -107,11 +113,13 @@ extern List ** RedistributeTaskListResults(const char *resultIdPrefix,
 										   List *selectTaskList,
 										   int partitionColumnIndex,
 										   CitusTableCacheEntry *targetRelation,
-										   bool binaryFormat);
+										   bool binaryFormat,
+										   bool allowNullPartitionColumnValues);
 extern List * PartitionTasklistResults(const char *resultIdPrefix, List *selectTaskList,
 									   int partitionColumnIndex,
 									   CitusTableCacheEntry *distributionScheme,
-									   bool binaryFormat);
+									   bool binaryFormat,
+									   bool allowNullPartitionColumnValues);
 extern char * QueryStringForFragmentsTransfer(
 	NodeToNodeFragmentsTransfer *fragmentsTransfer);
 extern void ShardMinMaxValueArrays(ShardInterval **shardIntervalArray, int shardCount,
@@ -165,6 +165,10 @@ typedef struct ListCellAndListWrapper
 /* utility functions declaration shared within this module */
 extern List * SortList(List *pointerList,
 					   int (*ComparisonFunction)(const void *, const void *));
+extern List * SortedListInsert(List *sortedList, void *pointer,
+							   int (*comparisonFunction)(const void *, const void *));
+extern List * SortedListDelete(List *sortedList, void *pointer,
+							   int (*comparisonFunction)(const void *, const void *));
 extern void ** PointerArrayFromList(List *pointerList);
 extern HTAB * ListToHashSet(List *pointerList, Size keySize, bool isStringList);
 extern char * StringJoin(List *stringList, char delimiter);
@@ -249,6 +249,7 @@ extern Oid DistLocalGroupIdRelationId(void);
 extern Oid DistObjectRelationId(void);
 extern Oid DistEnabledCustomAggregatesId(void);
 extern Oid DistTenantSchemaRelationId(void);
+extern Oid DistShardTransferProgressRelationId(void);
 
 /* index oids */
 extern Oid DistNodeNodeIdIndexId(void);
@@ -271,6 +272,7 @@ extern Oid DistTransactionGroupIndexId(void);
 extern Oid DistPlacementGroupidIndexId(void);
 extern Oid DistObjectPrimaryKeyIndexId(void);
 extern Oid DistCleanupPrimaryKeyIndexId(void);
+extern Oid DistShardTransferProgressPrimaryKeyIndexId(void);
 extern Oid DistTenantSchemaPrimaryKeyIndexId(void);
 extern Oid DistTenantSchemaUniqueColocationIdIndexId(void);
 
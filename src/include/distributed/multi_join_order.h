@@ -56,6 +56,10 @@ typedef struct TableEntry
 {
 	Oid relationId;
 	uint32 rangeTableId;
+
+	/* estimated rows after applying the table's filters, for cost-based ordering */
+	double rowCount;
+	double rowWidth;
 } TableEntry;
 
 
@@ -80,17 +84,28 @@ typedef struct JoinOrderNode
 	char partitionMethod;
 	List *joinClauseList;       /* not relevant for the first table */
 	TableEntry *anchorTable;
+
+	/*
+	 * When citus.enable_cost_based_join_order is on, we estimate the rows that
+	 * result from joining all tables up to and including this node, and the
+	 * number of bytes that this join sends over the network.
+	 */
+	double rowCount;
+	double rowWidth;
+	double transferCost;
 } JoinOrderNode;
 
 
 /* Config variables managed via guc.c */
 extern bool LogMultiJoinOrder;
 extern bool EnableSingleHashRepartitioning;
+extern bool EnableCostBasedJoinOrder;
 
 
 /* Function declaration for determining table join orders */
 extern List * JoinExprList(FromExpr *fromExpr);
-extern List * JoinOrderList(List *rangeTableEntryList, List *joinClauseList);
+extern List * JoinOrderList(List *rangeTableEntryList, List *joinClauseList,
+							 List *whereClauseList);
 extern bool IsApplicableJoinClause(List *leftTableIdList, uint32 rightTableId,
 								   Node *joinClause);
 extern List * ApplicableJoinClauses(List *leftTableIdList, uint32 rightTableId,
@@ -23,14 +23,20 @@
 #define DIVISION_OPER_NAME "/"
 #define DISABLE_LIMIT_APPROXIMATION -1
 #define DISABLE_DISTINCT_APPROXIMATION 0.0
+#define DISABLE_PERCENTILE_APPROXIMATION 0
 #define ARRAY_CAT_AGGREGATE_NAME "array_cat_agg"
 #define JSONB_CAT_AGGREGATE_NAME "jsonb_cat_agg"
 #define JSON_CAT_AGGREGATE_NAME "json_cat_agg"
 #define WORKER_PARTIAL_AGGREGATE_NAME "worker_partial_agg"
 #define COORD_COMBINE_AGGREGATE_NAME "coord_combine_agg"
+#define WORKER_PARTIAL_AGGREGATE_BINARY_NAME "worker_partial_agg_binary"
+#define COORD_COMBINE_AGGREGATE_BINARY_NAME "coord_combine_agg_binary"
 #define WORKER_COLUMN_FORMAT "worker_column_%d"
 
 /* Definitions related to count(distinct) approximations */
+#define CITUS_HLL_ADD_AGGREGATE_NAME "citus_hll_add_agg"
+#define CITUS_HLL_UNION_AGGREGATE_NAME "citus_hll_union_agg"
+#define CITUS_HLL_CARDINALITY_FUNC_NAME "citus_hll_cardinality"
 #define HLL_EXTENSION_NAME "hll"
 #define HLL_TYPE_NAME "hll"
 #define HLL_HASH_INTEGER_FUNC_NAME "hll_hash_integer"
@@ -42,6 +48,12 @@
 #define HLL_CARDINALITY_FUNC_NAME "hll_cardinality"
 #define HLL_FORCE_GROUPAGG_GUC_NAME "hll.force_groupagg"
 
+/* Definitions related to percentile_cont() approximations */
+#define PERCENTILE_CONT_AGGREGATE_NAME "percentile_cont"
+#define CITUS_TDIGEST_ADD_AGGREGATE_NAME "citus_tdigest_add_agg"
+#define CITUS_TDIGEST_UNION_AGGREGATE_NAME "citus_tdigest_union_agg"
+#define CITUS_TDIGEST_PERCENTILE_FUNC_NAME "citus_tdigest_percentile"
+
 /* Definitions related to Top-N approximations */
 #define TOPN_ADD_AGGREGATE_NAME "topn_add_agg"
 #define TOPN_UNION_AGGREGATE_NAME "topn_union_agg"
@@ -92,9 +104,12 @@ typedef enum
 	AGGREGATE_TDIGEST_PERCENTILE_OF_TDIGEST_DOUBLE = 29,
 	AGGREGATE_TDIGEST_PERCENTILE_OF_TDIGEST_DOUBLEARRAY = 30,
 
+	/* percentile_cont() approximated using the built-in t-digest sketches */
+	AGGREGATE_PERCENTILE_CONT_APPROXIMATE = 31,
+
 	/* AGGREGATE_CUSTOM must come last */
-	AGGREGATE_CUSTOM_COMBINE = 31,
-	AGGREGATE_CUSTOM_ROW_GATHER = 32,
+	AGGREGATE_CUSTOM_COMBINE = 32,
+	AGGREGATE_CUSTOM_ROW_GATHER = 33,
 } AggregateType;
 
 
@@ -106,6 +121,15 @@ typedef enum
 } CoordinatorAggregationStrategyType;
 
 
+/* Enumeration for citus.count_distinct_approximation_method GUC */
+typedef enum
+{
+	COUNT_DISTINCT_APPROXIMATION_AUTO,
+	COUNT_DISTINCT_APPROXIMATION_HLL,
+	COUNT_DISTINCT_APPROXIMATION_NATIVE,
+} CountDistinctApproximationMethodType;
+
+
 /*
  * PushDownStatus indicates whether a node can be pushed down below its child
  * using the commutative and distributive relational algebraic properties.
@@ -158,6 +182,8 @@ static const char *const AggregateNames[] = {
 extern int LimitClauseRowFetchCount;
 extern double CountDistinctErrorRate;
 extern int CoordinatorAggregationStrategy;
+extern int CountDistinctApproximationMethod;
+extern int PercentileApproximationCompression;
 
 
 /* Function declaration for optimizing logical plans */
@@ -179,5 +205,7 @@ extern void FindReferencedTableColumn(Expr *columnExpression, List *parentQueryL
 extern char * WorkerColumnName(AttrNumber resno);
 extern bool IsGroupBySubsetOfDistinct(List *groupClauses, List *distinctClauses);
 extern bool TargetListHasAggregates(List *targetEntryList);
+extern Oid CoordCombineAggOid(void);
+extern Oid CoordCombineAggBinaryOid(void);
 
 #endif   /* MULTI_LOGICAL_OPTIMIZER_H */
@@ -148,6 +148,9 @@ typedef struct MultiPartition
 	MultiUnaryNode unaryNode;
 	Var *partitionColumn;
 	uint32 splitPointTableId;
+
+	/* estimated bytes to repartition, 0 when not using cost-based join order */
+	double estimatedDataSize;
 } MultiPartition;
 
 
@@ -38,7 +38,15 @@
 #define NON_PRUNABLE_JOIN -1
 #define RESERVED_HASHED_COLUMN_ID MaxAttrNumber
 
+/*
+ * Map task queries end with this suffix, which allows the executor to pass
+ * additional arguments to worker_partition_query_result.
+ */
+#define MAP_TASK_QUERY_SUFFIX ") WHERE rows_written > 0"
+
 extern int RepartitionJoinBucketCountPerNode;
+extern bool EnableRepartitionJoinBloomFilters;
+extern int RepartitionJoinBloomFilterMaxRows;
 
 typedef enum CitusRTEKind
 {
@@ -87,7 +95,8 @@ typedef enum
 	TASK_ASSIGNMENT_INVALID_FIRST = 0,
 	TASK_ASSIGNMENT_GREEDY = 1,
 	TASK_ASSIGNMENT_ROUND_ROBIN = 2,
-	TASK_ASSIGNMENT_FIRST_REPLICA = 3
+	TASK_ASSIGNMENT_FIRST_REPLICA = 3,
+	TASK_ASSIGNMENT_ADAPTIVE = 4
 } TaskAssignmentPolicyType;
 
 
@@ -153,6 +162,15 @@ typedef struct Job
 	 */
 	bool parametersInJobQueryResolved;
 	uint32 colocationId; /* common colocation group ID of the relations */
+
+	/*
+	 * When a multi-shard job is planned before the parameters are bound, we
+	 * keep the restrictions of the relations to prune the task list again
+	 * once the parameter values are known.
+	 */
+	List *shardPruningRelationIdList;
+	List *shardPruningRangeTableIdList;
+	List *shardPruningRestrictionList;
 } Job;
 
 
@@ -167,6 +185,17 @@ typedef struct MapMergeJob
 	ShardInterval **sortedShardIntervalArray; /* only applies to range partitioning */
 	List *mapTaskList;
 	List *mergeTaskList;
+
+	/*
+	 * Whether the partition column values of this job can be used to filter
+	 * the other side of an inner dual partition join, and the tasks that build
+	 * the corresponding bloom filters on the workers.
+	 */
+	bool buildBloomFilter;
+	List *bloomFilterTaskList;
+
+	/* estimated bytes to repartition, 0 when not using cost-based join order */
+	double estimatedDataSize;
 } MapMergeJob;
 
 typedef enum TaskQueryType
@@ -471,6 +500,17 @@ typedef struct DistributedPlan
 	 * of source rows to be repartitioned for colocation with the target.
 	 */
 	int sourceResultRepartitionColumnIndex;
+
+	/*
+	 * When the groups of an aggregation are finalized on the workers, the
+	 * partial aggregates of the worker job are repartitioned by the given
+	 * column to be colocated with the shards of the given relation, the given
+	 * query finalizes the groups of each partition, and the combineQuery only
+	 * sorts and limits the final rows.
+	 */
+	Query *repartitionedAggregateQuery;
+	int repartitionedAggregateColumnIndex;
+	Oid repartitionedAggregateRelationId;
 } DistributedPlan;
 
 
@@ -589,6 +629,8 @@ extern List * AssignAnchorShardTaskList(List *taskList);
 extern List * FirstReplicaAssignTaskList(List *taskList);
 extern List * RoundRobinAssignTaskList(List *taskList);
 extern List * RoundRobinReorder(List *placementList);
+extern List * AdaptiveAssignTaskList(List *taskList);
+extern List * AdaptiveReorder(List *placementList);
 extern void SetPlacementNodeMetadata(ShardPlacement *placement, WorkerNode *workerNode);
 extern int CompareTasksByTaskId(const void *leftElement, const void *rightElement);
 extern int CompareTasksByExecutionDuration(const void *leftElement, const
@@ -0,0 +1,77 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallel_copy.h
+ *	  Declarations for copying data into the shards of a distributed table
+ *	  using parallel workers.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PARALLEL_COPY_H
+#define PARALLEL_COPY_H
+
+#include "postgres.h"
+
+#include "commands/copy.h"
+#include "port/atomics.h"
+#include "storage/block.h"
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
+#include "utils/relcache.h"
+
+#include "distributed/commands/multi_copy.h"
+
+
+/* identifies the progress monitors of copying local data into shards */
+#define DISTRIBUTE_DATA_ACTIVITY_MAGIC_NUMBER 1338
+
+
+/*
+ * DistributeDataProgress is the progress of copying the data of a local table
+ * into the shards of a distributed table, which is kept in a progress monitor
+ * and reported by citus_create_distributed_table_progress(). Only the backend
+ * that distributes the table updates it.
+ */
+typedef struct DistributeDataProgress
+{
+	Oid relationId;
+	int parallelWorkerCount;
+	uint64 totalBlocks;
+	pg_atomic_uint64 blocksScanned;
+	pg_atomic_uint64 rowsCopied;
+} DistributeDataProgress;
+
+
+/* GUC that determines the number of parallel workers used to copy local data */
+extern int MaxDistributeDataWorkers;
+
+/* GUC that determines the number of parallel workers used to parse COPY input */
+extern int MaxParallelCopyWorkers;
+
+extern DistributeDataProgress * CreateDistributeDataProgressMonitor(Oid relationId,
+																	BlockNumber
+																	totalBlocks);
+extern void UpdateDistributeDataProgress(DistributeDataProgress *progress,
+										 BlockNumber blocksScanned,
+										 uint64 rowsCopied);
+extern bool CanCopyLocalDataInParallel(Relation localRelation,
+									   CitusCopyDestReceiver *copyDest);
+extern uint64 ParallelCopyLocalDataIntoShards(Relation localRelation,
+											  CitusCopyDestReceiver *copyDest,
+											  DistributeDataProgress *progress);
+extern bool CanCopyFromInParallel(CopyStmt *copyStatement,
+								  CitusCopyDestReceiver *copyDest,
+								  Relation distributedRelation,
+								  bool isInputFormatBinary);
+extern bool ParallelCopyFromIntoShards(CopyFromState copyState,
+									   CopyStmt *copyStatement,
+									   CitusCopyDestReceiver *copyDest,
+									   uint64 *processedRowCount);
+extern PGDLLEXPORT void ParallelCopyLocalDataWorkerMain(dsm_segment *segment,
+														shm_toc *toc);
+extern PGDLLEXPORT void ParallelCopyFromWorkerMain(dsm_segment *segment,
+												   shm_toc *toc);
+
+#endif /* PARALLEL_COPY_H */
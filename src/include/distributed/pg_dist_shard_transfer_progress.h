@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_dist_shard_transfer_progress.h
+ *	  definition of the relation that holds the shards that a failed shard
+ *	  transfer already copied to the target node
+ *	  (pg_dist_shard_transfer_progress).
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_DIST_SHARD_TRANSFER_PROGRESS_H
+#define PG_DIST_SHARD_TRANSFER_PROGRESS_H
+
+/* ----------------
+ *      compiler constants for pg_dist_shard_transfer_progress
+ * ----------------
+ */
+
+#define Natts_pg_dist_shard_transfer_progress 9
+#define Anum_pg_dist_shard_transfer_progress_operation_id 1
+#define Anum_pg_dist_shard_transfer_progress_shardid 2
+#define Anum_pg_dist_shard_transfer_progress_source_shardid 3
+#define Anum_pg_dist_shard_transfer_progress_source_node_id 4
+#define Anum_pg_dist_shard_transfer_progress_target_node_id 5
+#define Anum_pg_dist_shard_transfer_progress_shard_min_value 6
+#define Anum_pg_dist_shard_transfer_progress_shard_max_value 7
+#define Anum_pg_dist_shard_transfer_progress_copied_at 8
+#define Anum_pg_dist_shard_transfer_progress_resumable_until 9
+
+#define PG_DIST_SHARD_TRANSFER_PROGRESS "pg_dist_shard_transfer_progress"
+
+#endif /* PG_DIST_SHARD_TRANSFER_PROGRESS_H */
@@ -28,6 +28,9 @@ typedef struct RangeTblEntryIndex
 	Index rteIndex;
 }RangeTblEntryIndex;
 
+/* GUC, whether identical subqueries and CTEs share a subplan */
+extern bool EnableCommonSubplanElimination;
+
 extern PlannerRestrictionContext * GetPlannerRestrictionContext(
 	RecursivePlanningContext *recursivePlanningContext);
 extern List * GenerateSubplansForSubqueriesAndCTEs(uint64 planId, Query *originalQuery,
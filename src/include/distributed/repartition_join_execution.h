@@ -12,6 +12,8 @@
 
 #include "nodes/pg_list.h"
 
+extern bool EnableStreamingRepartitionJoins;
+
 extern List * ExecuteDependentTasks(List *taskList, Job *topLevelJob);
 
 
@@ -0,0 +1,28 @@
+/*-------------------------------------------------------------------------
+ *
+ * repartitioned_aggregate.h
+ *	  Planning and execution of aggregations of which the groups are
+ *	  finalized on the workers after repartitioning the partial aggregates.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef REPARTITIONED_AGGREGATE_H
+#define REPARTITIONED_AGGREGATE_H
+
+#include "nodes/pg_list.h"
+
+#include "distributed/multi_physical_planner.h"
+
+
+/* GUC, determining whether groups may be finalized on the workers */
+extern bool EnableRepartitionedAggregation;
+
+extern void PlanRepartitionedAggregate(DistributedPlan *distributedPlan);
+extern List * RepartitionedAggregateTaskList(DistributedPlan *distributedPlan,
+											 List *taskList);
+
+
+#endif /* REPARTITIONED_AGGREGATE_H */
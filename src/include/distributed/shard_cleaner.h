@@ -11,6 +11,9 @@
 #ifndef CITUS_SHARD_CLEANER_H
 #define CITUS_SHARD_CLEANER_H
 
+#include "datatype/timestamp.h"
+#include "nodes/pg_list.h"
+
 #define MAX_BG_TASK_EXECUTORS 1000
 
 /* GUC to configure deferred shard deletion */
@@ -19,18 +22,21 @@ extern int BackgroundTaskQueueCheckInterval;
 extern int MaxBackgroundTaskExecutors;
 extern double DesiredPercentFreeAfterMove;
 extern bool CheckAvailableSpaceBeforeMove;
+extern int ShardTransferResumeTimeout;
 
 extern int NextOperationId;
 extern int NextCleanupRecordId;
 
 extern int TryDropOrphanedResources(void);
 extern void DropOrphanedResourcesInSeparateTransaction(void);
-extern void ErrorIfCleanupRecordForShardExists(char *shardName);
 
 /* Members for cleanup infrastructure */
 typedef uint64 OperationId;
 extern OperationId CurrentOperationId;
 
+extern void ErrorIfCleanupRecordForShardExists(char *shardName,
+											   OperationId resumedOperationId);
+
 /*
  * CleanupResource represents the Resource type in cleanup records.
  */
@@ -105,6 +111,13 @@ extern void InsertCleanupRecordOutsideTransaction(CleanupObject objectType,
 												  int nodeGroupId,
 												  CleanupPolicy policy);
 
+/*
+ * ResumeOperationNeedingCleanup is called instead of RegisterOperationNeedingCleanup
+ * by an operation that continues a failed operation, which takes over its
+ * resources and cleanup records.
+ */
+extern void ResumeOperationNeedingCleanup(OperationId operationId);
+
 /*
  * FinalizeOperationNeedingCleanupOnSuccess is be called by an operation to signal
  * completion on success. This will trigger cleanup of appropriate resources
@@ -112,4 +125,42 @@ extern void InsertCleanupRecordOutsideTransaction(CleanupObject objectType,
  */
 extern void FinalizeOperationNeedingCleanupOnSuccess(const char *operationName);
 
+/*
+ * ShardTransferProgress represents a record from pg_dist_shard_transfer_progress,
+ * which describes a shard that a shard transfer copied to its target node.
+ */
+typedef struct ShardTransferProgress
+{
+	/* identifier of the operation that copied the shard */
+	OperationId operationId;
+
+	/* shard that was copied, and the shard it was copied from */
+	uint64 shardId;
+	uint64 sourceShardId;
+
+	/* nodes that the shard was copied from and to */
+	uint32 sourceNodeId;
+	uint32 targetNodeId;
+
+	/* hash range of a split child, NULL for moves and copies */
+	char *minValue;
+	char *maxValue;
+
+	/* time until which the transfer can be resumed */
+	TimestampTz resumableUntil;
+} ShardTransferProgress;
+
+/* APIs for resuming failed shard transfers */
+extern List * ShardTransferProgressForShardList(List *shardIntervalList,
+												uint32 sourceNodeId,
+												uint32 targetNodeId);
+extern void InsertShardTransferProgressOutsideTransaction(List *progressList);
+extern void DeleteShardTransferProgressOutsideTransaction(void);
+extern OperationId LockResumableShardTransfer(List *expectedProgressList,
+											  List **resumedProgressList);
+extern void AbandonShardTransferProgress(List *shardIntervalList,
+										 OperationId resumedOperationId);
+extern bool ShardTransferProgressEquals(ShardTransferProgress *leftProgress,
+										ShardTransferProgress *rightProgress);
+
 #endif /*CITUS_SHARD_CLEANER_H */
@@ -17,6 +17,26 @@
 
 #define INVALID_SHARD_INDEX -1
 
+
+/*
+ * PartitionKeyArraySplit describes a partition column = ANY (array) filter in
+ * a query, of which the array values are grouped by the shard they hash into,
+ * such that each shard query only needs to contain the values of its shard.
+ */
+typedef struct PartitionKeyArraySplit
+{
+	/* the filter in the query and its original array argument */
+	ScalarArrayOpExpr *arrayOpExpr;
+	Node *originalArray;
+
+	/* the shards of the relation and the array argument for each of them */
+	Oid relationId;
+	int shardCount;
+	uint64 *shardIdArray;
+	Node **shardArrayArray;
+} PartitionKeyArraySplit;
+
+
 /* Function declarations for shard pruning */
 extern List * PruneShards(Oid relationId, Index rangeTableId, List *whereClauseList,
 						  Const **partitionValueConst);
@@ -26,5 +46,11 @@ extern Const * TransformPartitionRestrictionValue(Var *partitionColumn,
 												  Const *restrictionValue,
 												  bool missingOk);
 bool VarConstOpExprClause(OpExpr *opClause, Var **varClause, Const **constantClause);
+extern int ShardArraySplitThreshold;
+
+extern List * SplitPartitionKeyArraysByShard(Query *query);
+extern void RestrictPartitionKeyArraysToShards(List *arraySplitList,
+											   List *relationShardList);
+extern void ResetPartitionKeyArrays(List *arraySplitList);
 
 #endif /* SHARD_PRUNING_H_ */
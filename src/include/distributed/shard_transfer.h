@@ -10,9 +10,25 @@
 #include "postgres.h"
 
 #include "nodes/pg_list.h"
+#include "storage/block.h"
 
 #include "distributed/shard_rebalancer.h"
 
+/* GUCs that determine how many streams are used to copy a single large shard */
+extern int MaxShardCopyStreams;
+extern int ShardCopyChunkSize;
+
+/*
+ * ShardCopyBlockRange is a range of heap blocks [startBlock, endBlock) of a
+ * shard that is copied by a single task. An endBlock of InvalidBlockNumber
+ * means that the range extends to the end of the shard.
+ */
+typedef struct ShardCopyBlockRange
+{
+	BlockNumber startBlock;
+	BlockNumber endBlock;
+} ShardCopyBlockRange;
+
 extern Datum citus_move_shard_placement(PG_FUNCTION_ARGS);
 extern Datum citus_move_shard_placement_with_nodeid(PG_FUNCTION_ARGS);
 
@@ -32,6 +48,9 @@ extern uint64 ShardListSizeInBytes(List *colocatedShardList,
 extern void ErrorIfMoveUnsupportedTableType(Oid relationId);
 extern void CopyShardsToNode(WorkerNode *sourceNode, WorkerNode *targetNode,
 							 List *shardIntervalList, char *snapshotName);
+extern List * ShardCopyBlockRangeList(ShardInterval *shardInterval,
+									  WorkerNode *sourceNode);
+extern char * ShardCopyEndBlockString(ShardCopyBlockRange *blockRange);
 extern void VerifyTablesHaveReplicaIdentity(List *colocatedTableList);
 extern bool RelationCanPublishAllModifications(Oid relationId);
 extern void UpdatePlacementUpdateStatusForShardIntervalList(List *shardIntervalList,
@@ -17,6 +17,22 @@
 #define ALLOW_ALL_EXTERNAL_CONNECTIONS -1
 
 
+/*
+ * NodeTaskStats describes the recently observed task load on a node.
+ */
+typedef struct NodeTaskStats
+{
+	/* number of tasks that backends are currently running on the node */
+	int inFlightTaskCount;
+
+	/* whether a task finished on the node recently */
+	bool hasRecentTaskTime;
+
+	/* moving average of task execution times, if hasRecentTaskTime */
+	double averageTaskTimeMicrosecs;
+} NodeTaskStats;
+
+
 extern int MaxSharedPoolSize;
 extern int LocalSharedPoolSize;
 extern int MaxClientConnections;
@@ -36,5 +52,10 @@ extern void DecrementSharedConnectionCounter(const char *hostname, int port);
 extern void IncrementSharedConnectionCounter(const char *hostname, int port);
 extern int AdaptiveConnectionManagementFlag(bool connectToLocalNode, int
 											activeConnectionCount);
+extern void IncrementNodeInFlightTaskCount(const char *hostname, int port);
+extern void RecordNodeTaskCompletion(const char *hostname, int port,
+									 uint64 durationMicrosecs, bool succeeded);
+extern bool GetNodeTaskStats(const char *hostname, int port, NodeTaskStats *taskStats);
+extern void ReleaseNodeInFlightTaskCounts(void);
 
 #endif /* SHARED_CONNECTION_STATS_H */
@@ -12,12 +12,16 @@
 #define SUBPLAN_EXECUTION_H
 
 
+#include "utils/tuplestore.h"
+
 #include "distributed/multi_physical_planner.h"
 
 extern int MaxIntermediateResult;
 extern int SubPlanLevel;
+extern bool EnableConcurrentSubPlanExecution;
 
 extern void ExecuteSubPlans(DistributedPlan *distributedPlan);
+extern Tuplestorestate * ClaimPrefetchedSubPlanResult(DistributedPlan *distributedPlan);
 
 /**
  * IntermediateResultsHashEntry is used to store which nodes need to receive
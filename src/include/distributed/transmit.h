@@ -23,6 +23,8 @@ extern void RedirectCopyDataToRegularFile(const char *filename);
 extern void SendRegularFile(const char *filename);
 extern File FileOpenForTransmit(const char *filename, int fileFlags);
 extern File FileOpenForTransmitPerm(const char *filename, int fileFlags, int fileMode);
+extern void SendCopyInStart(bool binaryFormat);
+extern bool ReceiveCopyData(StringInfo copyData);
 
 
 #endif   /* TRANSMIT_H */
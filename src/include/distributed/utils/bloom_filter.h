@@ -0,0 +1,55 @@
+/*-------------------------------------------------------------------------
+ *
+ * bloom_filter.h
+ *	  Utility functions for building and probing bloom filters over hash
+ *	  values, such as the hashes of join keys.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef CITUS_BLOOM_FILTER_H
+#define CITUS_BLOOM_FILTER_H
+
+#include "postgres.h"
+
+
+/*
+ * Number of bits per element and number of hash functions that give a false
+ * positive rate of roughly 1%.
+ */
+#define BLOOM_FILTER_BITS_PER_ELEMENT 10
+#define BLOOM_FILTER_HASH_COUNT 7
+
+/* smallest filter we build or fold into, in bits */
+#define BLOOM_FILTER_MIN_BIT_COUNT 64
+
+
+/*
+ * BloomFilter is a bloom filter with a power-of-2 number of bits. Elements
+ * are added and probed by their 32-bit hash value, from which all bit
+ * positions are derived.
+ */
+typedef struct BloomFilter
+{
+	uint32 hashCount;
+	uint64 bitCount;
+
+	/* number of elements that were added, including duplicates */
+	uint64 elementCount;
+
+	uint8 *bits;
+} BloomFilter;
+
+
+extern BloomFilter * CreateBloomFilter(uint64 bitCount, uint32 hashCount);
+extern void BloomFilterAdd(BloomFilter *filter, uint32 hashValue);
+extern bool BloomFilterContains(BloomFilter *filter, uint32 hashValue);
+extern void BloomFilterUnion(BloomFilter *target, BloomFilter *source);
+extern void BloomFilterFold(BloomFilter *filter, uint64 minimumBitCount);
+extern bytea * BloomFilterToBytea(BloomFilter *filter);
+extern BloomFilter * BloomFilterFromBytea(bytea *serializedFilter);
+
+
+#endif   /* CITUS_BLOOM_FILTER_H */
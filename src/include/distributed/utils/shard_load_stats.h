@@ -0,0 +1,80 @@
+/*-------------------------------------------------------------------------
+ *
+ * shard_load_stats.h
+ *	  Routines for tracking the query load on the shards of a node.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SHARD_LOAD_STATS_H
+#define SHARD_LOAD_STATS_H
+
+#include "executor/execdesc.h"
+#include "storage/lwlock.h"
+#include "storage/spin.h"
+#include "utils/hsearch.h"
+#include "utils/timestamp.h"
+
+
+/*
+ * ShardLoadStats is the struct that keeps the decayed query load of one
+ * shard on this node. All counters are decayed to lastUpdateTime.
+ */
+typedef struct ShardLoadStats
+{
+	uint64 shardId;           /* hash key of entry - MUST BE FIRST */
+
+	/* number of queries that accessed the shard */
+	double queryCount;
+
+	/* CPU time in seconds spent by queries that accessed the shard */
+	double cpuSeconds;
+
+	/* number of tuples read from the shard by sequential and index scans */
+	double tuplesRead;
+
+	/* the time to which the counters above are decayed */
+	TimestampTz lastUpdateTime;
+
+	/* protects the fields above */
+	slock_t lock;
+} ShardLoadStats;
+
+
+/*
+ * ShardLoadMonitor is the struct for keeping the load statistics of the
+ * shards on this node in shared memory.
+ */
+typedef struct ShardLoadMonitor
+{
+	/*
+	 * Lock mechanism for the monitor. Updating the statistics of a shard
+	 * acquires the lock in shared mode, adding or removing shards acquires
+	 * it in exclusive mode.
+	 */
+	NamedLWLockTranche namedLockTranche;
+	LWLock lock;
+
+	/* the max length of the shards hashtable is citus.stat_shard_load_limit */
+	HTAB *shards;
+} ShardLoadMonitor;
+
+typedef enum
+{
+	STAT_SHARD_LOAD_TRACK_NONE = 0,
+	STAT_SHARD_LOAD_TRACK_ALL = 1
+} StatShardLoadTrackType;
+
+extern void InitializeShardLoadMonitor(void);
+extern size_t ShardLoadMonitorShmemSize(void);
+extern bool StartShardLoadMeasurement(QueryDesc *queryDesc);
+extern void EndShardLoadMeasurement(void);
+extern void CancelShardLoadMeasurement(void);
+
+extern int StatShardLoadHalfLife;
+extern int StatShardLoadLimit;
+extern int StatShardLoadTrack;
+
+#endif /* SHARD_LOAD_STATS_H */
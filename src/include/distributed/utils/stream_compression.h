@@ -0,0 +1,95 @@
+/*-------------------------------------------------------------------------
+ *
+ * stream_compression.h
+ *	  Utility functions for compressing and decompressing byte streams
+ *	  such as intermediate results.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef CITUS_STREAM_COMPRESSION_H
+#define CITUS_STREAM_COMPRESSION_H
+
+#include "postgres.h"
+
+#include "lib/stringinfo.h"
+
+
+/*
+ * A compressed stream starts with STREAM_COMPRESSION_MAGIC followed by a
+ * single byte that holds the compression method. Similar to the binary COPY
+ * signature, the magic contains a NUL byte such that it can never be the
+ * prefix of a text or csv formatted COPY stream.
+ */
+#define STREAM_COMPRESSION_MAGIC "CITUSZ\n\377\r\n\0"
+#define STREAM_COMPRESSION_MAGIC_LENGTH 11
+#define STREAM_COMPRESSION_HEADER_LENGTH (STREAM_COMPRESSION_MAGIC_LENGTH + 1)
+
+/* the header is followed by frames of at most this many uncompressed bytes */
+#define STREAM_COMPRESSION_FRAME_SIZE (64 * 1024)
+
+
+typedef enum StreamCompressionMethod
+{
+	STREAM_COMPRESSION_NONE = 0,
+	STREAM_COMPRESSION_LZ4 = 1,
+	STREAM_COMPRESSION_ZSTD = 2
+} StreamCompressionMethod;
+
+
+/*
+ * CompressionStream keeps the state of a stream that is being compressed.
+ * Data is passed through as-is unless more than thresholdBytes are written
+ * to the stream, such that small streams do not pay the compression overhead.
+ */
+typedef struct CompressionStream
+{
+	StreamCompressionMethod method;
+	uint64 thresholdBytes;
+
+	/* whether the header was emitted and data is being compressed */
+	bool compressing;
+
+	/* input bytes that are not yet emitted */
+	StringInfo pendingData;
+
+	/* scratch space for compressing a single frame */
+	StringInfo frameBuffer;
+} CompressionStream;
+
+
+/*
+ * DecompressionStream keeps the state of a stream that is being decompressed.
+ * Streams that do not start with the compression header are passed through
+ * as-is, which keeps uncompressed streams readable.
+ */
+typedef struct DecompressionStream
+{
+	/* whether we already know if the stream is compressed */
+	bool headerProcessed;
+	bool compressed;
+	StreamCompressionMethod method;
+
+	/* input bytes that are not yet decompressed */
+	StringInfo pendingData;
+} DecompressionStream;
+
+
+extern CompressionStream * CreateCompressionStream(StreamCompressionMethod method,
+												   uint64 thresholdBytes);
+extern void CompressionStreamWrite(CompressionStream *stream, const char *data,
+								   int dataLength, StringInfo output);
+extern void CompressionStreamFinish(CompressionStream *stream, StringInfo output);
+extern DecompressionStream * CreateDecompressionStream(void);
+extern void DecompressionStreamWrite(DecompressionStream *stream, const char *data,
+									 int dataLength, StringInfo output);
+extern void DecompressionStreamFinish(DecompressionStream *stream, StringInfo output);
+extern bool StreamCompressionMethodSupported(StreamCompressionMethod method);
+extern const char * StreamCompressionMethodName(StreamCompressionMethod method);
+extern bool StreamCompressionMethodFromName(const char *methodName,
+											StreamCompressionMethod *method);
+
+
+#endif   /* CITUS_STREAM_COMPRESSION_H */
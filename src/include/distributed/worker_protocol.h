@@ -45,10 +45,12 @@ extern void SetDefElemArg(AlterSeqStmt *statement, const char *name, Node *arg);
 /* Function declarations shared with the master planner */
 extern DestReceiver * CreateFileDestReceiver(char *filePath,
 											 MemoryContext tupleContext,
-											 bool binaryCopyFormat);
+											 bool binaryCopyFormat,
+											 bool bufferInMemory);
 extern void FileDestReceiverStats(DestReceiver *dest,
 								  uint64 *rowsSent,
 								  uint64 *bytesSent);
+extern StringInfo FileDestReceiverMemoryBuffer(DestReceiver *dest);
 
 /* Function declaration for parsing tree node */
 extern Node * ParseTreeNode(const char *ddlCommand);
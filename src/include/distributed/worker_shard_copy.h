@@ -12,9 +12,18 @@
 #ifndef WORKER_SHARD_COPY_H_
 #define WORKER_SHARD_COPY_H_
 
+#include "fmgr.h"
+
+#include "nodes/parsenodes.h"
+#include "storage/block.h"
+#include "tcop/cmdtag.h"
+
 /* GUC, determining whether Binary Copy is enabled */
 extern bool EnableBinaryProtocol;
 
+/* GUC, determining the compression method of shard copy streams */
+extern int ShardTransferCompression;
+
 extern DestReceiver * CreateShardCopyDestReceiver(EState *executorState,
 												  List *destinationShardFullyQualifiedName,
 												  uint32_t destinationNodeId);
@@ -24,4 +33,12 @@ extern const char * CopyableColumnNamesFromRelationName(const char *schemaName,
 
 extern const char * CopyableColumnNamesFromTupleDesc(TupleDesc tupdesc);
 
+extern void ShardCopyBlockRangeFromArgs(FunctionCallInfo fcinfo, int startBlockArgIndex,
+										BlockNumber *startBlock, BlockNumber *endBlock);
+extern char * ShardCopyBlockRangeFilter(BlockNumber startBlock, BlockNumber endBlock);
+extern char * SetShardTransferCompressionCommand(void);
+extern bool IsCompressedShardCopyStmt(CopyStmt *copyStatement);
+extern void ReceiveCompressedShardCopy(CopyStmt *copyStatement,
+									   QueryCompletion *completionTag);
+
 #endif /* WORKER_SHARD_COPY_H_ */
@@ -190,6 +190,7 @@ typedef RangeTblEntry RTEPermissionInfo;
 #define RelationCreateStorage_compat(a, b, c) RelationCreateStorage(a, b, c)
 #define parse_analyze_varparams_compat(a, b, c, d, e) parse_analyze_varparams(a, b, c, d, \
 																			  e)
+#define shm_mq_send_compat(a, b, c, d, e) shm_mq_send(a, b, c, d, e)
 #define CREATE_SEQUENCE_COMMAND \
 	"CREATE %sSEQUENCE IF NOT EXISTS %s AS %s INCREMENT BY " INT64_FORMAT \
 	" MINVALUE " INT64_FORMAT " MAXVALUE " INT64_FORMAT \
@@ -212,6 +213,7 @@ typedef Value String;
 #endif
 #define RelationCreateStorage_compat(a, b, c) RelationCreateStorage(a, b)
 #define parse_analyze_varparams_compat(a, b, c, d, e) parse_analyze_varparams(a, b, c, d)
+#define shm_mq_send_compat(a, b, c, d, e) shm_mq_send(a, b, c, d)
 #define pgstat_init_relation(r) pgstat_initstats(r)
 #define pg_analyze_and_rewrite_fixedparams(a, b, c, d, e) pg_analyze_and_rewrite(a, b, c, \
 																				 d, e)
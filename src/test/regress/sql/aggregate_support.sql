@@ -676,5 +676,19 @@ create aggregate min (coord) (
 
 select min((id,val)::coord) from aggdata;
 
+-- custom aggregate with an internal transition state, which is sent to the
+-- coordinator in binary form using its serialfunc & deserialfunc
+set citus.coordinator_aggregation_strategy to 'disabled';
+create aggregate binary_avg (int8) (
+    sfunc = int8_avg_accum,
+    stype = internal,
+    finalfunc = numeric_poly_avg,
+    combinefunc = int8_avg_combine,
+    serialfunc = int8_avg_serialize,
+    deserialfunc = int8_avg_deserialize
+);
+select key, binary_avg(val)::numeric(10,2), avg(val)::numeric(10,2) from aggdata group by key order by key;
+select binary_avg(val) from aggdata where valf = 0;
+
 set client_min_messages to error;
 drop schema aggregate_support cascade;
@@ -0,0 +1,58 @@
+--
+-- APPROXIMATE_COUNT_DISTINCT
+--
+-- Tests approximating count(distinct) using the built-in HyperLogLog sketches
+--
+CREATE SCHEMA approximate_count_distinct;
+SET search_path TO approximate_count_distinct;
+SET citus.next_shard_id TO 3190000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE visits (tenant_id int, visitor_id bigint, page text, visited_at date);
+SELECT create_distributed_table('visits', 'tenant_id');
+INSERT INTO visits
+SELECT i % 16, i % 5000, 'page-' || (i % 20), '2024-01-01'::date + (i % 100)
+FROM generate_series(1, 20000) i;
+
+SET citus.coordinator_aggregation_strategy TO 'disabled';
+SET citus.count_distinct_approximation_method TO 'native';
+
+-- without an error rate, the distinct values are pulled to the coordinator
+SELECT count(DISTINCT visitor_id) FROM visits;
+
+SET citus.count_distinct_error_rate TO 0.01;
+
+-- estimates are within a few percent of the exact counts
+SELECT count(DISTINCT visitor_id) BETWEEN 4750 AND 5250 FROM visits;
+SELECT count(DISTINCT page) BETWEEN 19 AND 21 FROM visits;
+SELECT count(DISTINCT visited_at) BETWEEN 95 AND 105 FROM visits;
+SELECT count(DISTINCT visitor_id % 1000) BETWEEN 950 AND 1050 FROM visits;
+
+SELECT page, count(DISTINCT visitor_id) BETWEEN 237 AND 263 AS estimate_ok
+FROM visits GROUP BY page ORDER BY page LIMIT 3;
+
+-- ordering by an estimate does not push the order by on sketches to the workers
+SELECT page FROM visits WHERE page IN ('page-0', 'page-1', 'page-2') GROUP BY page
+ORDER BY count(DISTINCT CASE page WHEN 'page-0' THEN visitor_id % 10
+                                  WHEN 'page-1' THEN visitor_id % 100
+                                  ELSE visitor_id END) DESC
+LIMIT 2;
+
+-- empty inputs and NULLs do not count
+SELECT count(DISTINCT visitor_id) FROM visits WHERE tenant_id < 0;
+SELECT count(DISTINCT NULLIF(visitor_id, visitor_id)) FROM visits;
+
+-- the sketch aggregates can also be used directly
+SELECT citus_hll_cardinality(citus_hll_add_agg(i, 14)) BETWEEN 9500 AND 10500
+FROM generate_series(1, 10000) i;
+SELECT citus_hll_cardinality(citus_hll_union_agg(sketch)) BETWEEN 14250 AND 15750
+FROM (SELECT citus_hll_add_agg(i, 14) AS sketch FROM generate_series(1, 10000) i
+      UNION ALL
+      SELECT citus_hll_add_agg(i, 14) FROM generate_series(5001, 15000) i) sketches;
+SELECT citus_hll_cardinality(NULL);
+SELECT citus_hll_add_agg(i, 30) FROM generate_series(1, 10) i;
+SELECT citus_hll_cardinality('\x00'::bytea);
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA approximate_count_distinct CASCADE;
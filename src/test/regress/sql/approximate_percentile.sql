@@ -0,0 +1,63 @@
+--
+-- APPROXIMATE_PERCENTILE
+--
+-- Tests approximating percentile_cont() using the built-in t-digest sketches
+--
+CREATE SCHEMA approximate_percentile;
+SET search_path TO approximate_percentile;
+SET citus.next_shard_id TO 3320000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE latencies (tenant_id int, endpoint text, latency double precision);
+SELECT create_distributed_table('latencies', 'tenant_id');
+INSERT INTO latencies
+SELECT i % 16, 'endpoint-' || (i % 4), (i % 1000) + 0.5
+FROM generate_series(1, 20000) i;
+
+SET citus.percentile_approximation_compression TO 5;
+SET citus.percentile_approximation_compression TO 100;
+
+-- workers build sketches instead of sending all rows to the coordinator
+EXPLAIN (COSTS OFF, VERBOSE)
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency) FROM latencies;
+
+-- estimates are close to the exact percentiles of 500, 899.6 and 989.6
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency) BETWEEN 480 AND 520
+FROM latencies;
+SELECT percentile_cont(0.9) WITHIN GROUP (ORDER BY latency) BETWEEN 880 AND 920
+FROM latencies;
+SELECT percentile_cont(0.99) WITHIN GROUP (ORDER BY latency) BETWEEN 980 AND 1000
+FROM latencies;
+
+-- the minimum and maximum are exact
+SELECT percentile_cont(ARRAY[0, 1]) WITHIN GROUP (ORDER BY latency) FROM latencies;
+
+SELECT endpoint,
+       percentile_cont(0.5) WITHIN GROUP (ORDER BY latency) BETWEEN 480 AND 520
+       AS estimate_ok
+FROM latencies GROUP BY endpoint ORDER BY endpoint;
+
+-- empty inputs give NULL, and fractions are checked like in percentile_cont()
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency)
+FROM latencies WHERE tenant_id < 0;
+SELECT percentile_cont(1.5) WITHIN GROUP (ORDER BY latency) FROM latencies;
+
+-- descending orders are not approximated
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency DESC) FROM latencies;
+
+-- the sketch functions can also be used directly, and are exact for few values
+SELECT citus_tdigest_percentile(citus_tdigest_add_agg(i, 100), 0.25)
+FROM generate_series(1, 4) i;
+SELECT citus_tdigest_percentile(citus_tdigest_add_agg(i, 100), 0.5) BETWEEN 4900 AND 5100
+FROM generate_series(1, 10000) i;
+SELECT citus_tdigest_percentile(citus_tdigest_union_agg(sketch), ARRAY[0, NULL, 1])
+FROM (SELECT citus_tdigest_add_agg(i, 100) AS sketch FROM generate_series(1, 100) i
+      UNION ALL
+      SELECT citus_tdigest_add_agg(i, 100) FROM generate_series(901, 1000) i) sketches;
+SELECT citus_tdigest_add_agg(i, 5) FROM generate_series(1, 10) i;
+SELECT citus_tdigest_percentile('\x00'::bytea, 0.5);
+
+RESET citus.percentile_approximation_compression;
+SET client_min_messages TO WARNING;
+DROP SCHEMA approximate_percentile CASCADE;
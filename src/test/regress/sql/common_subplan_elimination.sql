@@ -0,0 +1,86 @@
+--
+-- COMMON_SUBPLAN_ELIMINATION
+--
+-- Tests sharing a single subplan among identical subqueries and CTEs
+--
+CREATE SCHEMA common_subplan_elimination;
+SET search_path TO common_subplan_elimination;
+SET citus.next_shard_id TO 3220000;
+SET citus.shard_replication_factor TO 1;
+SET citus.shard_count TO 4;
+
+-- count the subplans in the plan of a query
+CREATE FUNCTION subplan_count(explain_command text)
+RETURNS bigint AS $$
+DECLARE
+  query_plan text;
+  subplans bigint := 0;
+BEGIN
+  FOR query_plan IN EXECUTE explain_command LOOP
+    IF query_plan ~ 'Distributed Subplan' THEN
+      subplans := subplans + 1;
+    END IF;
+  END LOOP;
+  RETURN subplans;
+END; $$ LANGUAGE plpgsql;
+
+CREATE TABLE events (user_id int, value int);
+SELECT create_distributed_table('events', 'user_id');
+INSERT INTO events SELECT i % 20, i FROM generate_series(1, 100) i;
+
+-- by default, each subquery gets its own subplan
+SELECT subplan_count($Q$
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 10) a JOIN
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 10) b USING (user_id);
+$Q$);
+
+SET citus.enable_common_subplan_elimination TO on;
+
+-- identical subqueries share a subplan
+SELECT subplan_count($Q$
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 10) a JOIN
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 10) b USING (user_id);
+$Q$);
+SELECT count(*) FROM
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 10) a JOIN
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 10) b USING (user_id);
+
+-- identical CTEs share a subplan
+SELECT subplan_count($Q$
+EXPLAIN (COSTS OFF)
+WITH a AS MATERIALIZED (SELECT user_id FROM events ORDER BY user_id LIMIT 10),
+     b AS MATERIALIZED (SELECT user_id FROM events ORDER BY user_id LIMIT 10)
+SELECT count(*) FROM a JOIN b USING (user_id);
+$Q$);
+WITH a AS MATERIALIZED (SELECT user_id FROM events ORDER BY user_id LIMIT 10),
+     b AS MATERIALIZED (SELECT user_id FROM events ORDER BY user_id LIMIT 10)
+SELECT count(*) FROM a JOIN b USING (user_id);
+
+-- different subqueries do not share a subplan
+SELECT subplan_count($Q$
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 10) a JOIN
+  (SELECT user_id FROM events ORDER BY user_id LIMIT 20) b USING (user_id);
+$Q$);
+
+-- subqueries with volatile functions do not share a subplan
+SELECT subplan_count($Q$
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM
+  (SELECT user_id FROM events WHERE random() >= 0 ORDER BY user_id LIMIT 10) a JOIN
+  (SELECT user_id FROM events WHERE random() >= 0 ORDER BY user_id LIMIT 10) b USING (user_id);
+$Q$);
+
+-- the shared result is used in both branches of a UNION
+SELECT user_id FROM events WHERE user_id IN (SELECT user_id FROM events ORDER BY user_id LIMIT 10) AND value < 50
+UNION
+SELECT user_id FROM events WHERE user_id IN (SELECT user_id FROM events ORDER BY user_id LIMIT 10) AND value >= 50
+ORDER BY 1;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA common_subplan_elimination CASCADE;
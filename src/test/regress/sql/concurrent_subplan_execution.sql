@@ -0,0 +1,94 @@
+--
+-- CONCURRENT_SUBPLAN_EXECUTION
+--
+-- Tests executing the remote tasks of independent subplans concurrently
+--
+CREATE SCHEMA concurrent_subplan_execution;
+SET search_path TO concurrent_subplan_execution;
+SET citus.next_shard_id TO 3120000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE users (user_id int, value int);
+SELECT create_distributed_table('users', 'user_id');
+INSERT INTO users SELECT i, i % 10 FROM generate_series(1, 100) i;
+
+CREATE TABLE events (event_id int, user_id int);
+SELECT create_distributed_table('events', 'event_id');
+INSERT INTO events SELECT i, i % 50 FROM generate_series(1, 200) i;
+
+SET citus.enable_concurrent_subplan_execution TO on;
+
+-- independent CTEs, all of them are executed together
+WITH user_count AS MATERIALIZED (
+    SELECT count(*) AS c FROM users
+), event_count AS MATERIALIZED (
+    SELECT count(*) AS c FROM events
+), max_value AS MATERIALIZED (
+    SELECT max(value) AS m FROM users
+)
+SELECT user_count.c AS user_total, event_count.c AS event_total, max_value.m AS max_value
+FROM user_count, event_count, max_value;
+
+-- top_events reads the result of top_users, so it waits for it
+WITH top_users AS MATERIALIZED (
+    SELECT user_id FROM users WHERE value = 3
+), top_events AS MATERIALIZED (
+    SELECT count(*) AS c FROM events WHERE user_id IN (SELECT user_id FROM top_users)
+), all_events AS MATERIALIZED (
+    SELECT count(*) AS c FROM events
+)
+SELECT top_events.c AS top_event_count, all_events.c AS event_count
+FROM top_events, all_events;
+
+-- the prepared statements are planned on their first execution, such that the
+-- second one only shows which subplans are executed concurrently
+PREPARE independent_ctes AS
+WITH user_count AS MATERIALIZED (
+    SELECT count(*) AS c FROM users
+), event_count AS MATERIALIZED (
+    SELECT count(*) AS c FROM events
+), max_value AS MATERIALIZED (
+    SELECT max(value) AS m FROM users
+)
+SELECT user_count.c AS user_total, event_count.c AS event_total, max_value.m AS max_value
+FROM user_count, event_count, max_value;
+PREPARE dependent_ctes AS
+WITH top_users AS MATERIALIZED (
+    SELECT user_id FROM users WHERE value = 3
+), top_events AS MATERIALIZED (
+    SELECT count(*) AS c FROM events WHERE user_id IN (SELECT user_id FROM top_users)
+), all_events AS MATERIALIZED (
+    SELECT count(*) AS c FROM events
+)
+SELECT top_events.c AS top_event_count, all_events.c AS event_count
+FROM top_events, all_events;
+EXECUTE independent_ctes;
+EXECUTE dependent_ctes;
+SET client_min_messages TO DEBUG1;
+EXECUTE independent_ctes;
+EXECUTE dependent_ctes;
+RESET client_min_messages;
+
+-- subqueries in the FROM clause that are planned separately
+SELECT a.user_id, b.c AS event_count
+FROM
+    (SELECT user_id FROM users ORDER BY user_id LIMIT 3) a,
+    (SELECT count(*) AS c FROM events GROUP BY user_id ORDER BY user_id LIMIT 1) b
+ORDER BY 1;
+
+-- results are the same without concurrent execution
+SET citus.enable_concurrent_subplan_execution TO off;
+
+WITH user_count AS MATERIALIZED (
+    SELECT count(*) AS c FROM users
+), event_count AS MATERIALIZED (
+    SELECT count(*) AS c FROM events
+), max_value AS MATERIALIZED (
+    SELECT max(value) AS m FROM users
+)
+SELECT user_count.c AS user_total, event_count.c AS event_total, max_value.m AS max_value
+FROM user_count, event_count, max_value;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA concurrent_subplan_execution CASCADE;
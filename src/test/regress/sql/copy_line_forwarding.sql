@@ -0,0 +1,72 @@
+--
+-- COPY_LINE_FORWARDING
+--
+-- Tests forwarding COPY input lines to shards while only parsing the
+-- distribution column on the coordinator
+--
+CREATE SCHEMA copy_line_forwarding;
+SET search_path TO copy_line_forwarding;
+SET citus.next_shard_id TO 3250000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (tenant_id int, event_id bigint, payload jsonb, note text DEFAULT 'none');
+SELECT create_distributed_table('events', 'tenant_id');
+
+SET citus.skip_row_validation_in_copy TO on;
+
+COPY events FROM STDIN;
+1	1	{"a": 1}	hello\tworld
+2	2	{"b": 2}	\N
+5	3	[1, 2]	back\\slash
+\.
+
+-- quoted fields can contain delimiters and newlines
+COPY events (note, payload, event_id, tenant_id) FROM STDIN WITH (format csv, header true);
+note,payload,event_id,tenant_id
+"multi
+line",{},10,3
+"a,b","{""x"": 1}",11,4
+,null,12,6
+\.
+
+-- columns with defaults are not in the input, so rows are parsed as usual
+COPY events (tenant_id, event_id, payload) FROM STDIN WITH (format csv);
+7,13,{}
+\.
+
+SELECT tenant_id, event_id, payload, to_json(note) FROM events ORDER BY event_id;
+
+-- all rows should be in the shard that covers their hash value
+WITH expected AS (
+  SELECT get_shard_id_for_distribution_column('events', tenant_id) AS shardid, count(*)
+  FROM events GROUP BY 1
+), actual AS (
+  SELECT shardid, result::bigint AS count
+  FROM run_command_on_shards('events', 'SELECT count(*) FROM %s')
+)
+SELECT count(*) FROM expected FULL JOIN actual USING (shardid)
+WHERE expected.count IS DISTINCT FROM actual.count;
+
+-- the distribution column is still validated on the coordinator
+COPY events FROM STDIN WITH (format csv);
+,5,{},x
+\.
+COPY events FROM STDIN WITH (format csv);
+abc,6,{},x
+\.
+COPY events FROM STDIN WITH (format csv);
+7,7
+\.
+
+-- other columns are validated by the workers
+\set VERBOSITY terse
+COPY events FROM STDIN WITH (format csv);
+8,abc,{},x
+\.
+\set VERBOSITY default
+
+SELECT count(*) FROM events;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA copy_line_forwarding CASCADE;
@@ -0,0 +1,65 @@
+--
+-- COST_BASED_JOIN_ORDER
+--
+-- Tests choosing the join order and the repartitioning strategy of non-colocated
+-- joins based on the sizes of the tables
+--
+CREATE SCHEMA cost_based_join_order;
+SET search_path TO cost_based_join_order;
+SET citus.next_shard_id TO 3200000;
+SET citus.shard_replication_factor TO 1;
+
+-- only show the repartition jobs, and hide the estimated sizes
+CREATE FUNCTION repartition_jobs(explain_command text, out query_plan text)
+RETURNS SETOF TEXT AS $$
+BEGIN
+  FOR query_plan IN EXECUTE explain_command LOOP
+    IF query_plan ~ '(MapMergeJob|Map Task Count|Merge Task Count|Estimated Data Transfer)' THEN
+      query_plan := regexp_replace(query_plan, 'Estimated Data Transfer: .*', 'Estimated Data Transfer: xxx');
+      RETURN NEXT;
+    END IF;
+  END LOOP;
+END; $$ LANGUAGE plpgsql;
+
+SET citus.shard_count TO 4;
+CREATE TABLE events (event_id int, user_id int, payload text);
+SELECT create_distributed_table('events', 'event_id');
+INSERT INTO events SELECT i, i % 100, repeat('x', 100) FROM generate_series(1, 20000) i;
+
+-- a small table that is not colocated with events
+SET citus.shard_count TO 3;
+CREATE TABLE flagged_events (event_id int, reason text);
+SELECT create_distributed_table('flagged_events', 'event_id');
+INSERT INTO flagged_events SELECT i, 'spam' FROM generate_series(200, 20000, 200) i;
+
+SET citus.enable_repartition_joins TO on;
+SET citus.enable_single_hash_repartition_joins TO on;
+
+-- by default, the first table keeps its shards and the large table is repartitioned
+SELECT repartition_jobs($Q$
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM flagged_events f, events e WHERE f.event_id = e.event_id;
+$Q$);
+SELECT count(*) FROM flagged_events f, events e WHERE f.event_id = e.event_id;
+
+-- with cost-based join ordering, the small table is repartitioned instead
+SET citus.enable_cost_based_join_order TO on;
+SELECT repartition_jobs($Q$
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM flagged_events f, events e WHERE f.event_id = e.event_id;
+$Q$);
+SELECT count(*) FROM flagged_events f, events e WHERE f.event_id = e.event_id;
+
+-- the order of the tables in the query does not matter
+SELECT repartition_jobs($Q$
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM events e, flagged_events f WHERE f.event_id = e.event_id;
+$Q$);
+SELECT count(*) FROM events e, flagged_events f WHERE f.event_id = e.event_id;
+
+-- filters reduce the estimated size of a table
+SELECT count(*) FROM flagged_events f, events e
+WHERE f.event_id = e.event_id AND e.user_id = 0 AND f.reason IN ('spam', 'fraud');
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA cost_based_join_order CASCADE;
@@ -0,0 +1,74 @@
+--
+-- DISTRIBUTED_STATISTICS
+--
+-- Tests gathering the statistics of shards into the coordinator using
+-- citus_analyze
+--
+CREATE SCHEMA distributed_statistics;
+SET search_path TO distributed_statistics;
+SET citus.next_shard_id TO 3210000;
+SET citus.shard_replication_factor TO 1;
+SET citus.shard_count TO 4;
+
+CREATE TABLE measurements (id int, category int, val int, note text);
+SELECT create_distributed_table('measurements', 'id');
+INSERT INTO measurements
+SELECT i, i % 4, i, CASE WHEN i % 10 = 0 THEN NULL ELSE 'note ' || (i % 7) END
+FROM generate_series(1, 1000) i;
+
+-- analyze the shards, which leaves the shell table empty
+ANALYZE measurements;
+SELECT reltuples FROM pg_class WHERE oid = 'measurements'::regclass;
+
+SELECT citus_analyze('measurements');
+SELECT reltuples FROM pg_class WHERE oid = 'measurements'::regclass;
+
+SELECT attname, round(null_frac::numeric, 3) AS null_frac, round(n_distinct::numeric, 2) AS n_distinct
+FROM pg_stats
+WHERE schemaname = 'distributed_statistics' AND tablename = 'measurements'
+ORDER BY attname;
+
+-- the most common values of the shards are combined
+SELECT (SELECT array_agg(v ORDER BY v) FROM unnest(most_common_vals::text::int[]) v) AS vals,
+       (SELECT array_agg(round(f::numeric, 2)) FROM unnest(most_common_freqs) f) AS freqs
+FROM pg_stats
+WHERE schemaname = 'distributed_statistics' AND tablename = 'measurements' AND attname = 'category';
+
+-- the histogram spans the values of all shards
+SELECT b[1] AS lowest, b[array_upper(b, 1)] AS highest, array_length(b, 1) > 2 AS has_buckets
+FROM (SELECT histogram_bounds::text::int[] AS b
+      FROM pg_stats
+      WHERE schemaname = 'distributed_statistics' AND tablename = 'measurements' AND attname = 'val') h;
+
+-- reference tables are analyzed using one of their placements
+CREATE TABLE categories (category int, name text);
+SELECT create_reference_table('categories');
+INSERT INTO categories SELECT i, 'category ' || i FROM generate_series(0, 3) i;
+ANALYZE categories;
+SELECT citus_analyze('categories');
+SELECT relname, reltuples FROM pg_class
+WHERE oid IN ('categories'::regclass, 'measurements'::regclass)
+ORDER BY relname;
+
+-- values that are equal but have a different text representation are combined
+CREATE TABLE readings (id int, reading numeric);
+SELECT create_distributed_table('readings', 'id');
+INSERT INTO readings
+SELECT i, CASE WHEN get_shard_id_for_distribution_column('readings', i) % 2 = 0
+               THEN 1.0 ELSE 1.00 END
+FROM generate_series(1, 100) i;
+INSERT INTO readings SELECT i, 2 FROM generate_series(101, 120) i;
+ANALYZE readings;
+SELECT citus_analyze('readings');
+SELECT array_length(most_common_vals::text::numeric[], 1) AS val_count,
+       round(most_common_freqs[1]::numeric, 2) AS top_freq,
+       (most_common_vals::text::numeric[])[1] = 1 AS top_is_one
+FROM pg_stats
+WHERE schemaname = 'distributed_statistics' AND tablename = 'readings' AND attname = 'reading';
+
+-- local tables cannot be analyzed this way
+CREATE TABLE local_table (a int);
+SELECT citus_analyze('local_table');
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA distributed_statistics CASCADE;
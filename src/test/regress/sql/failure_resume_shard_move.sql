@@ -0,0 +1,112 @@
+--
+-- failure_resume_shard_move
+--
+-- The tests cover resuming shard moves and splits that failed after copying the
+-- shards.
+
+CREATE SCHEMA resume_shard_move;
+SET search_path TO resume_shard_move;
+SET citus.shard_count TO 4;
+SET citus.next_shard_id TO 3290000;
+SET citus.next_operation_id TO 3290000;
+SET citus.shard_replication_factor TO 1;
+SET citus.max_adaptive_executor_pool_size TO 1;
+
+SELECT citus.mitmproxy('conn.allow()');
+
+CREATE TABLE t(id int PRIMARY KEY, data text);
+CREATE INDEX t_data_idx ON t(data);
+SELECT create_distributed_table('t', 'id');
+INSERT INTO t SELECT x, 'data-' || x FROM generate_series(1,1000) AS f(x);
+
+CREATE VIEW shards_in_workers AS
+SELECT shardid,
+       (CASE WHEN nodeport = :worker_1_port THEN 'worker1' ELSE 'worker2' END) AS worker
+FROM pg_dist_placement NATURAL JOIN pg_dist_node
+WHERE shardstate != 4
+ORDER BY 1,2 ASC;
+
+SELECT * FROM shards_in_workers;
+
+-- keep what a failed move copied for a while
+SET citus.shard_transfer_resume_timeout TO '1h';
+
+-- failure when enabling the subscriptions, after the shards are copied
+SELECT citus.mitmproxy('conn.onQuery(query="^ALTER SUBSCRIPTION .* ENABLE").kill()');
+SELECT citus_move_shard_placement(3290001, 'localhost', :worker_1_port, 'localhost', :worker_2_proxy_port);
+
+SELECT operation_id, shardid, source_node_id, target_node_id, resumable_until > copied_at AS resumable
+FROM pg_dist_shard_transfer_progress;
+
+-- the resources of the failed move are not cleaned up while it can be resumed
+CALL citus_cleanup_orphaned_resources();
+SELECT object_type, policy_type, count(*) FROM pg_dist_cleanup
+WHERE operation_id = 3290000 GROUP BY 1, 2 ORDER BY 1, 2;
+
+-- writes in the meantime are replicated when the move is resumed
+INSERT INTO t SELECT x, 'data-' || x FROM generate_series(1001,2000) AS f(x);
+UPDATE t SET data = 'updated' WHERE id <= 100;
+DELETE FROM t WHERE id > 1900;
+
+-- the retry does not copy the shards again, so failing any COPY does not
+-- affect it
+SELECT citus.mitmproxy('conn.onQuery(query="^COPY").kill()');
+SELECT citus_move_shard_placement(3290001, 'localhost', :worker_1_port, 'localhost', :worker_2_proxy_port);
+
+SELECT citus.mitmproxy('conn.allow()');
+
+SELECT * FROM shards_in_workers;
+SELECT count(*), count(*) FILTER (WHERE data = 'updated') FROM t;
+SELECT count(*) FROM pg_dist_shard_transfer_progress;
+
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*) FROM pg_dist_cleanup;
+
+-- a failed move is not resumed once its progress expired
+SET citus.shard_transfer_resume_timeout TO 1;
+SELECT citus.mitmproxy('conn.onQuery(query="^ALTER SUBSCRIPTION .* ENABLE").kill()');
+SELECT citus_move_shard_placement(3290003, 'localhost', :worker_1_port, 'localhost', :worker_2_proxy_port);
+SELECT pg_sleep(0.1);
+
+SELECT citus.mitmproxy('conn.allow()');
+SELECT citus_move_shard_placement(3290003, 'localhost', :worker_1_port, 'localhost', :worker_2_proxy_port);
+
+SELECT * FROM shards_in_workers;
+SELECT count(*), count(*) FILTER (WHERE data = 'updated') FROM t;
+SELECT count(*) FROM pg_dist_shard_transfer_progress;
+
+-- the resources of the expired move were cleaned up before the retry
+SELECT count(*) FROM pg_dist_cleanup WHERE operation_id = 3290001;
+
+RESET citus.shard_transfer_resume_timeout;
+SELECT public.wait_for_resource_cleanup();
+
+-- a failed non-blocking split is resumed in the same way
+SET citus.shard_transfer_resume_timeout TO '1h';
+SET citus.next_shard_id TO 3290100;
+SELECT nodeid AS worker_1_node FROM pg_dist_node WHERE nodeport = :worker_1_port \gset
+SELECT nodeid AS worker_2_node FROM pg_dist_node WHERE nodeport = :worker_2_proxy_port \gset
+
+SELECT citus.mitmproxy('conn.onQuery(query="^ALTER SUBSCRIPTION .* ENABLE").kill()');
+SELECT citus_split_shard_by_split_points(3290003, ARRAY['1610612735'], ARRAY[:worker_1_node, :worker_2_node], 'force_logical');
+
+SELECT shardid, source_shardid, target_node_id, shard_min_value, shard_max_value
+FROM pg_dist_shard_transfer_progress ORDER BY shardid;
+
+INSERT INTO t SELECT x, 'data-' || x FROM generate_series(1901,2000) AS f(x);
+
+-- the retry reuses the split children, so it does not run the split copy
+SELECT citus.mitmproxy('conn.onQuery(query="worker_split_copy").kill()');
+SELECT citus_split_shard_by_split_points(3290003, ARRAY['1610612735'], ARRAY[:worker_1_node, :worker_2_node], 'force_logical');
+
+SELECT citus.mitmproxy('conn.allow()');
+
+SELECT * FROM shards_in_workers;
+SELECT count(*) FROM t;
+SELECT count(*) FROM pg_dist_shard_transfer_progress;
+
+RESET citus.shard_transfer_resume_timeout;
+SELECT public.wait_for_resource_cleanup();
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA resume_shard_move CASCADE;
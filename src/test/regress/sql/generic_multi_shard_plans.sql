@@ -0,0 +1,47 @@
+--
+-- GENERIC_MULTI_SHARD_PLANS
+--
+-- Tests reusing plans of multi-shard prepared statements, which are pruned
+-- for every execution
+--
+CREATE SCHEMA generic_multi_shard_plans;
+SET search_path TO generic_multi_shard_plans;
+SET citus.next_shard_id TO 3160000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (tenant_id int, value int);
+SELECT create_distributed_table('events', 'tenant_id');
+INSERT INTO events SELECT i % 8, i FROM generate_series(1, 80) i;
+
+SET citus.enable_generic_multi_shard_plans TO on;
+SET plan_cache_mode TO force_generic_plan;
+
+-- parameters that do not prune shards
+PREPARE value_stats(int) AS SELECT count(*), sum(value) FROM events WHERE value > $1;
+EXECUTE value_stats(0);
+EXECUTE value_stats(40);
+EXECUTE value_stats(100);
+SELECT public.coordinator_plan($Q$
+EXPLAIN (COSTS OFF) EXECUTE value_stats(40);
+$Q$);
+
+-- parameters on the distribution column prune the tasks of the cached plan
+PREPARE tenant_count(int, int) AS SELECT count(*) FROM events WHERE tenant_id IN ($1, $2);
+EXECUTE tenant_count(1, 2);
+EXECUTE tenant_count(3, 3);
+EXECUTE tenant_count(9, 10);
+SELECT public.coordinator_plan($Q$
+EXPLAIN (COSTS OFF) EXECUTE tenant_count(3, 3);
+$Q$);
+
+-- cached plans are invalidated when the table changes
+ALTER TABLE events ADD COLUMN extra int;
+EXECUTE tenant_count(1, 2);
+
+RESET plan_cache_mode;
+SET citus.enable_generic_multi_shard_plans TO off;
+EXECUTE value_stats(40);
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA generic_multi_shard_plans CASCADE;
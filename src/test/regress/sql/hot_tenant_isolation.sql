@@ -0,0 +1,127 @@
+--
+-- HOT_TENANT_ISOLATION
+--
+-- Tests isolating a tenant to its own shard on the least loaded node using
+-- the background task queue
+--
+CREATE SCHEMA hot_tenant_isolation;
+SET search_path TO hot_tenant_isolation;
+SET citus.next_shard_id TO 3310000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+ALTER SYSTEM SET citus.background_task_queue_interval TO '1s';
+SELECT pg_reload_conf();
+
+CREATE TABLE tenants (tenant_id int PRIMARY KEY, name text);
+SELECT create_distributed_table('tenants', 'tenant_id', colocate_with => 'none');
+CREATE TABLE events (tenant_id int, event_id bigint, PRIMARY KEY (tenant_id, event_id));
+SELECT create_distributed_table('events', 'tenant_id', colocate_with => 'tenants');
+
+INSERT INTO tenants SELECT i, 'tenant ' || i FROM generate_series(1, 100) i;
+INSERT INTO events SELECT i % 100 + 1, i FROM generate_series(1, 1000) i;
+
+SELECT nodeport AS source_port
+FROM pg_dist_placement JOIN pg_dist_node USING (groupid)
+WHERE shardid = get_shard_id_for_distribution_column('tenants', 42) \gset
+
+-- isolate the tenant in the background and wait for it
+SELECT citus_schedule_tenant_isolation('tenants', '42') AS job_id \gset
+SELECT citus_job_wait(:job_id);
+
+SELECT status, command LIKE '%isolate_tenant_to_new_shard%' AS isolates
+FROM pg_dist_background_task WHERE job_id = :job_id ORDER BY task_id;
+
+-- the tenant has its own shard in both tables, which moved to the other node
+SELECT logicalrelid, shardminvalue = shardmaxvalue AS isolated,
+       nodeport <> :source_port AS moved
+FROM pg_dist_shard JOIN pg_dist_placement USING (shardid) JOIN pg_dist_node USING (groupid)
+WHERE shardid IN (get_shard_id_for_distribution_column('tenants', 42),
+                  get_shard_id_for_distribution_column('events', 42))
+ORDER BY logicalrelid;
+
+SELECT count(*) FROM events WHERE tenant_id = 42;
+SELECT count(*) FROM events;
+
+-- an isolated tenant cannot be isolated again
+SELECT citus_schedule_tenant_isolation('tenants', '42');
+
+-- the tenant value has to be valid for the distribution column
+SELECT citus_schedule_tenant_isolation('tenants', 'abc');
+
+-- only hash distributed tables have tenants
+CREATE TABLE ref (a int PRIMARY KEY);
+SELECT create_reference_table('ref');
+SELECT citus_schedule_tenant_isolation('ref', '1');
+
+-- non-blocking isolation needs a replica identity
+CREATE TABLE no_pk (a int);
+SELECT create_distributed_table('no_pk', 'a', colocate_with => 'none');
+SELECT citus_schedule_tenant_isolation('no_pk', '1');
+
+-- automatic isolation of hot tenants is disabled by default
+SHOW citus.hot_tenant_isolation_interval;
+
+-- the maintenance daemon isolates tenants that stay above the thresholds
+CREATE PROCEDURE keep_tenant_hot(p_tenant_id int, p_after_job_id bigint, p_iterations int)
+LANGUAGE plpgsql AS $$
+BEGIN
+    FOR i IN 1 .. p_iterations LOOP
+        PERFORM count(*) FROM hot_tenant_isolation.tenants WHERE tenant_id = p_tenant_id;
+        COMMIT;
+        EXIT WHEN EXISTS (SELECT 1 FROM pg_dist_background_job
+                          WHERE job_type = 'isolate_tenant' AND job_id > p_after_job_id);
+        PERFORM pg_sleep(0.01);
+    END LOOP;
+END;
+$$;
+
+ALTER SYSTEM SET citus.stat_tenants_period TO 2;
+SELECT bool_and(success) FROM run_command_on_workers('ALTER SYSTEM SET citus.stat_tenants_period TO 2');
+SELECT bool_and(success) FROM run_command_on_workers('SELECT pg_reload_conf()');
+ALTER SYSTEM SET citus.hot_tenant_query_threshold TO 5;
+ALTER SYSTEM SET citus.hot_tenant_sustain_time TO '1s';
+ALTER SYSTEM SET citus.hot_tenant_isolation_interval TO '100ms';
+SELECT pg_reload_conf();
+SELECT citus_stat_tenants_reset();
+
+-- no tenant is isolated while a rebalance is running
+INSERT INTO pg_dist_background_job (job_type, description)
+VALUES ('rebalance', 'rebalance that blocks hot tenant isolation') RETURNING job_id AS rebalance_job_id \gset
+
+CALL keep_tenant_hot(7, :job_id, 400);
+SELECT count(*) FROM pg_dist_background_job
+WHERE job_type = 'isolate_tenant' AND job_id > :job_id;
+
+DELETE FROM pg_dist_background_job WHERE job_id = :rebalance_job_id;
+
+-- afterwards, the tenant is isolated as soon as the daemon checks again
+CALL keep_tenant_hot(7, :job_id, 3000);
+SELECT job_id AS hot_tenant_job_id FROM pg_dist_background_job
+WHERE job_type = 'isolate_tenant' AND job_id > :job_id \gset
+
+ALTER SYSTEM RESET citus.hot_tenant_isolation_interval;
+ALTER SYSTEM RESET citus.hot_tenant_sustain_time;
+ALTER SYSTEM RESET citus.hot_tenant_query_threshold;
+ALTER SYSTEM RESET citus.stat_tenants_period;
+SELECT pg_reload_conf();
+SELECT bool_and(success) FROM run_command_on_workers('ALTER SYSTEM RESET citus.stat_tenants_period');
+SELECT bool_and(success) FROM run_command_on_workers('SELECT pg_reload_conf()');
+
+SELECT citus_job_wait(:hot_tenant_job_id);
+SELECT status, description LIKE 'Isolate tenant 7 of %' AS isolates_tenant
+FROM pg_dist_background_job WHERE job_id = :hot_tenant_job_id;
+
+SELECT logicalrelid, shardminvalue = shardmaxvalue AS isolated
+FROM pg_dist_shard
+WHERE shardid IN (get_shard_id_for_distribution_column('tenants', 7),
+                  get_shard_id_for_distribution_column('events', 7))
+ORDER BY logicalrelid;
+SELECT count(*) FROM events WHERE tenant_id = 7;
+
+ALTER SYSTEM RESET citus.background_task_queue_interval;
+SELECT pg_reload_conf();
+
+SET client_min_messages TO WARNING;
+CALL citus_cleanup_orphaned_resources();
+DROP SCHEMA hot_tenant_isolation CASCADE;
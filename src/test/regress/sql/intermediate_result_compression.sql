@@ -0,0 +1,84 @@
+--
+-- INTERMEDIATE_RESULT_COMPRESSION
+--
+-- Tests compressing intermediate results
+--
+CREATE SCHEMA intermediate_result_compression;
+SET search_path TO intermediate_result_compression;
+SET citus.next_shard_id TO 3130000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (event_id int, user_id int, payload text);
+SELECT create_distributed_table('events', 'event_id');
+INSERT INTO events SELECT i, i % 100, repeat('x', 50) FROM generate_series(1, 10000) i;
+
+CREATE TABLE users (user_id int, name text);
+SELECT create_distributed_table('users', 'user_id');
+INSERT INTO users SELECT i, 'user ' || i FROM generate_series(0, 99) i;
+
+SET citus.intermediate_result_compression TO 'lz4';
+SET citus.intermediate_result_compression_threshold TO 0;
+
+-- compressed results can be read back
+BEGIN;
+SELECT create_intermediate_result('squares', 'SELECT s, s*s FROM generate_series(1,1000) s');
+SELECT count(*), sum(x2) FROM read_intermediate_result('squares', 'binary') AS res (x int, x2 int);
+END;
+
+-- CTE that is read on the coordinator
+WITH user_events AS MATERIALIZED (
+    SELECT user_id, payload FROM events
+)
+SELECT count(*), count(DISTINCT user_id), max(length(payload)) FROM user_events;
+
+-- CTE that is broadcast to the workers
+WITH user_events AS MATERIALIZED (
+    SELECT user_id, payload FROM events
+)
+SELECT count(*) FROM users JOIN user_events USING (user_id);
+
+-- repartition joins compress the partitioned results on the workers, using the
+-- settings of the coordinator
+SET citus.enable_repartition_joins TO on;
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.event_id);
+
+SET citus.intermediate_result_compression TO 'zstd';
+
+WITH user_events AS MATERIALIZED (
+    SELECT user_id, payload FROM events
+)
+SELECT count(*) FROM users JOIN user_events USING (user_id);
+
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.event_id);
+
+-- the node that plans a repartition join passes its compression settings to
+-- worker_partition_query_result, which writes the partitions
+BEGIN;
+WITH uncompressed AS (
+    SELECT * FROM worker_partition_query_result('uncompressed_events',
+        'SELECT user_id, payload FROM intermediate_result_compression.events', 0, 'hash',
+        '{-2147483648,0}'::text[], '{-1,2147483647}'::text[], false,
+        compression => 'none')
+), compressed AS (
+    SELECT * FROM worker_partition_query_result('compressed_events',
+        'SELECT user_id, payload FROM intermediate_result_compression.events', 0, 'hash',
+        '{-2147483648,0}'::text[], '{-1,2147483647}'::text[], false,
+        compression => 'zstd', compression_threshold => 0)
+)
+SELECT partition_index,
+       compressed.rows_written = uncompressed.rows_written AS same_rows,
+       compressed.bytes_written * 10 < uncompressed.bytes_written AS compressed
+FROM uncompressed JOIN compressed USING (partition_index) ORDER BY 1;
+END;
+
+-- results below the threshold are not compressed
+RESET citus.intermediate_result_compression_threshold;
+
+WITH small_users AS MATERIALIZED (
+    SELECT user_id FROM users WHERE user_id < 10
+)
+SELECT count(*) FROM events JOIN small_users USING (user_id);
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA intermediate_result_compression CASCADE;
@@ -930,6 +930,18 @@ WHERE distributed_table.key = 1
 RESET client_min_messages;
 RESET citus.log_local_commands;
 
+-- local tasks of read-only multi-shard queries can run while remote tasks are in flight
+BEGIN;
+    SET LOCAL citus.enable_interleaved_local_execution TO on;
+    INSERT INTO reference_table SELECT i FROM generate_series(1, 10) i;
+    INSERT INTO distributed_table (key, value, age) SELECT i, i::text, 20 FROM generate_series(1, 10) i;
+    SELECT count(*), sum(age) FROM distributed_table;
+    SELECT count(*) FROM distributed_table JOIN reference_table USING (key);
+    -- the remote tasks sleep for a while, so local tasks run before their results arrive
+    SET LOCAL client_min_messages TO DEBUG1;
+    SELECT count(*) FROM distributed_table WHERE pg_sleep(0.05)::text = '';
+ROLLBACK;
+
 \c - - - :master_port
 SET search_path TO local_shard_execution;
 SET citus.next_shard_id TO 1480000;
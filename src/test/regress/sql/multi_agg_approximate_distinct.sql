@@ -26,6 +26,9 @@ SELECT public.explain_has_distributed_subplan($$
  $$);
 
 SET citus.coordinator_aggregation_strategy TO 'disabled';
+-- Use the hll extension for approximations, see approximate_count_distinct for
+-- the built-in sketches
+SET citus.count_distinct_approximation_method TO 'hll';
 
 -- Try to execute count(distinct) when approximate distincts aren't enabled
 
@@ -254,6 +254,16 @@ $cmd$, 'task_assignment_test_table_2');
 -- different workers
 SELECT count(DISTINCT value) FROM explain_outputs;
 
+-- the adaptive policy assigns tasks based on the observed task latencies
+-- and load of the nodes, the results do not depend on the picked replica
+SET citus.task_assignment_policy TO 'adaptive';
+INSERT INTO task_assignment_replicated_hash SELECT i FROM generate_series(1, 100) i;
+INSERT INTO task_assignment_reference_table SELECT i FROM generate_series(1, 10) i;
+SELECT count(*) FROM task_assignment_replicated_hash;
+SELECT count(*) FROM task_assignment_replicated_hash WHERE test_id = 5;
+SELECT count(*) FROM task_assignment_reference_table;
+SELECT count(*) FROM task_assignment_replicated_hash JOIN task_assignment_reference_table USING (test_id);
+
 RESET citus.task_assignment_policy;
 RESET client_min_messages;
 
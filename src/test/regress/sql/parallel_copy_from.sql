@@ -0,0 +1,77 @@
+--
+-- PARALLEL_COPY_FROM
+--
+-- Tests parsing the input of COPY into a distributed table using parallel
+-- workers
+--
+CREATE SCHEMA parallel_copy_from;
+SET search_path TO parallel_copy_from;
+SET citus.next_shard_id TO 3260000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (tenant_id int, event_id bigint, payload jsonb, note text);
+SELECT create_distributed_table('events', 'tenant_id');
+
+SET citus.max_parallel_copy_workers TO 4;
+
+COPY events FROM STDIN;
+1	1	{"a": 1}	hello\tworld
+2	2	{"b": 2}	\N
+5	3	[1, 2]	back\\slash
+\.
+
+-- quoted fields can contain delimiters and newlines
+COPY events (note, payload, event_id, tenant_id) FROM STDIN WITH (format csv, header true);
+note,payload,event_id,tenant_id
+"multi
+line",{},10,3
+"a,b","{""x"": 1}",11,4
+,null,12,6
+\.
+
+SELECT tenant_id, event_id, payload, to_json(note) FROM events ORDER BY event_id;
+
+-- input that spans many chunks is spread over the workers
+CREATE TABLE numbers (n int);
+SELECT create_distributed_table('numbers', 'n');
+
+SET citus.max_parallel_copy_workers TO 2;
+SET client_min_messages TO DEBUG1;
+COPY numbers FROM PROGRAM 'seq 100000';
+RESET client_min_messages;
+SELECT count(*), sum(n) FROM numbers;
+
+-- all rows should be in the shard that covers their hash value
+WITH expected AS (
+  SELECT get_shard_id_for_distribution_column('numbers', n) AS shardid, count(*)
+  FROM numbers GROUP BY 1
+), actual AS (
+  SELECT shardid, result::bigint AS count
+  FROM run_command_on_shards('numbers', 'SELECT count(*) FROM %s')
+)
+SELECT count(*) FROM expected FULL JOIN actual USING (shardid)
+WHERE expected.count IS DISTINCT FROM actual.count;
+
+-- errors in parallel workers abort the COPY and report the line of the input
+COPY events FROM STDIN WITH (format csv);
+9,20,{},x
+9,21,{},x
+,22,{},x
+\.
+COPY events FROM STDIN WITH (format csv);
+9,23,{},x
+8,abc,{},x
+\.
+
+SELECT count(*) FROM events;
+
+-- columns with defaults need to be in the input
+ALTER TABLE events ALTER COLUMN note SET DEFAULT 'none';
+COPY events (tenant_id, event_id, payload) FROM STDIN WITH (format csv);
+7,13,{}
+\.
+SELECT note FROM events WHERE event_id = 13;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA parallel_copy_from CASCADE;
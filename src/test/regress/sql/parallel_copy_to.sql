@@ -0,0 +1,72 @@
+--
+-- PARALLEL_COPY_TO
+--
+-- Tests reading shards concurrently for COPY .. TO STDOUT
+--
+CREATE SCHEMA parallel_copy_to;
+SET search_path TO parallel_copy_to;
+SET citus.next_shard_id TO 3270000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (tenant_id int, event_id int, note text);
+SELECT create_distributed_table('events', 'tenant_id');
+INSERT INTO events SELECT i % 8, i, 'note ' || i FROM generate_series(1, 16) i;
+
+-- rows are sent in shard order, like with a single connection
+SET citus.max_copy_to_connections TO 1;
+COPY events TO STDOUT;
+SET citus.max_copy_to_connections TO 4;
+COPY events TO STDOUT;
+COPY events (event_id, tenant_id) TO STDOUT WITH (format csv, header true);
+
+-- placements that were modified in the transaction are read over the same connection
+BEGIN;
+UPDATE events SET note = 'updated' WHERE tenant_id = 6;
+COPY events TO STDOUT;
+ROLLBACK;
+
+-- without preserving shard order, the header is still sent first
+SET citus.copy_to_preserve_shard_order TO off;
+CREATE TABLE single_tenant (tenant_id int, event_id int);
+SELECT create_distributed_table('single_tenant', 'tenant_id');
+INSERT INTO single_tenant SELECT 1, i FROM generate_series(1, 3) i;
+COPY single_tenant TO STDOUT WITH (format csv, header true);
+RESET citus.copy_to_preserve_shard_order;
+
+-- queries of which the results do not need to be combined are streamed from the shards
+COPY (SELECT event_id, note FROM events WHERE tenant_id = 3) TO STDOUT;
+COPY (SELECT tenant_id, event_id FROM events WHERE event_id > 12) TO STDOUT;
+
+-- other queries are run as usual
+COPY (SELECT tenant_id, count(*) FROM events GROUP BY 1 ORDER BY 1) TO STDOUT;
+COPY (SELECT event_id FROM events WHERE tenant_id = 2) TO STDOUT WITH (format csv, header);
+
+-- values are formatted with the settings of the coordinator, like with a single connection
+CREATE TABLE typed_events (tenant_id int, created_at timestamptz, day date, duration interval,
+                           score float8, payload bytea);
+SELECT create_distributed_table('typed_events', 'tenant_id');
+INSERT INTO typed_events
+SELECT 1, '2024-03-01 12:00:00+00'::timestamptz + i * interval '1 day', '2024-03-01'::date + i,
+       i * interval '1 hour 30 minutes', i / 3::float8, ('\x4' || i || 'ff')::bytea
+FROM generate_series(1, 3) i;
+
+SET TimeZone TO 'Asia/Kolkata';
+SET DateStyle TO 'SQL, DMY';
+SET IntervalStyle TO 'iso_8601';
+SET extra_float_digits TO 0;
+SET bytea_output TO 'escape';
+SET citus.max_copy_to_connections TO 1;
+COPY typed_events TO STDOUT;
+COPY (SELECT * FROM typed_events WHERE score > 0) TO STDOUT;
+SET citus.max_copy_to_connections TO 4;
+COPY typed_events TO STDOUT;
+COPY (SELECT * FROM typed_events WHERE score > 0) TO STDOUT;
+RESET TimeZone;
+RESET DateStyle;
+RESET IntervalStyle;
+RESET extra_float_digits;
+RESET bytea_output;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA parallel_copy_to CASCADE;
@@ -0,0 +1,57 @@
+--
+-- PARALLEL_DISTRIBUTE_DATA
+--
+-- Tests copying the data of a local table into its shards using parallel
+-- workers when the table is distributed
+--
+CREATE SCHEMA parallel_distribute_data;
+SET search_path TO parallel_distribute_data;
+SET citus.next_shard_id TO 3240000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+-- include a dropped and a generated column to check the serialized rows
+CREATE TABLE events (event_id bigint, dropped int, tenant text, payload text,
+                     payload_length int GENERATED ALWAYS AS (length(payload)) STORED);
+ALTER TABLE events DROP COLUMN dropped;
+INSERT INTO events (event_id, tenant, payload)
+SELECT i, CASE WHEN i % 10 = 0 THEN NULL ELSE 'tenant ' || (i % 7) || E'\t' END, repeat('x', i % 200)
+FROM generate_series(1, 20000) i;
+
+SET citus.max_distribute_data_workers TO 4;
+SET min_parallel_table_scan_size TO 0;
+
+SET client_min_messages TO DEBUG1;
+SELECT create_distributed_table('events', 'event_id');
+RESET client_min_messages;
+
+SELECT count(*), sum(event_id), count(tenant), sum(payload_length) FROM events;
+
+-- all rows should be in the shard that covers their hash value
+WITH expected AS (
+  SELECT get_shard_id_for_distribution_column('events', event_id) AS shardid, count(*)
+  FROM events GROUP BY 1
+), actual AS (
+  SELECT shardid, result::bigint AS count
+  FROM run_command_on_shards('events', 'SELECT count(*) FROM %s')
+)
+SELECT count(*) FROM expected FULL JOIN actual USING (shardid)
+WHERE expected.count IS DISTINCT FROM actual.count;
+
+SELECT event_id, length(tenant), payload_length FROM events WHERE event_id IN (1, 10, 9999) ORDER BY 1;
+
+-- the copied data is rolled back with the transaction
+CREATE TABLE orders (order_id int, amount numeric);
+INSERT INTO orders SELECT i, i * 1.5 FROM generate_series(1, 5000) i;
+BEGIN;
+SELECT create_distributed_table('orders', 'order_id');
+SELECT count(*), sum(amount) FROM orders;
+ROLLBACK;
+SELECT count(*) FROM pg_dist_partition WHERE logicalrelid = 'orders'::regclass;
+SELECT count(*), sum(amount) FROM orders;
+
+-- no tables are being distributed at the moment
+SELECT count(*) FROM citus_create_distributed_table_progress();
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA parallel_distribute_data CASCADE;
@@ -0,0 +1,66 @@
+--
+-- PARALLEL_SHARD_COPY
+--
+-- Tests copying large shards in multiple block ranges during shard moves
+-- and splits
+--
+CREATE SCHEMA parallel_shard_copy;
+SET search_path TO parallel_shard_copy;
+SET citus.next_shard_id TO 3230000;
+SET citus.shard_count TO 2;
+SET citus.shard_replication_factor TO 1;
+
+SELECT nodeid AS worker_1_node FROM pg_dist_node WHERE nodeport=:worker_1_port \gset
+SELECT nodeid AS worker_2_node FROM pg_dist_node WHERE nodeport=:worker_2_port \gset
+
+CREATE TABLE events (event_id bigint primary key, payload text);
+SELECT create_distributed_table('events', 'event_id');
+INSERT INTO events SELECT i, repeat('x', 200) FROM generate_series(1, 10000) i;
+
+-- copy each shard in up to 4 streams of 64kB
+SET citus.max_shard_copy_streams TO 4;
+SET citus.shard_copy_chunk_size TO '64kB';
+
+-- move a shard using logical replication, where all streams use the same snapshot
+SELECT citus_move_shard_placement(3230000, nodeid,
+                                  CASE WHEN nodeid = :worker_1_node THEN :worker_2_node ELSE :worker_1_node END,
+                                  'force_logical')
+FROM pg_dist_shard_placement JOIN pg_dist_node USING (nodename, nodeport)
+WHERE shardid = 3230000;
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*), sum(event_id), sum(length(payload)) FROM events;
+
+-- move it back while blocking writes, and show that it is copied in 4 streams
+SET client_min_messages TO DEBUG1;
+SELECT citus_move_shard_placement(3230000, nodeid,
+                                  CASE WHEN nodeid = :worker_1_node THEN :worker_2_node ELSE :worker_1_node END,
+                                  'block_writes')
+FROM pg_dist_shard_placement JOIN pg_dist_node USING (nodename, nodeport)
+WHERE shardid = 3230000;
+RESET client_min_messages;
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*), sum(event_id), sum(length(payload)) FROM events;
+
+-- split the other shard, which covers the positive hash values
+SELECT citus_split_shard_by_split_points(3230001, ARRAY['1073741823'],
+                                         ARRAY[:worker_1_node, :worker_2_node],
+                                         'block_writes');
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*) FROM pg_dist_shard WHERE logicalrelid = 'events'::regclass;
+SELECT count(*), sum(event_id), sum(length(payload)) FROM events;
+
+-- split one of the new shards using logical replication, where all streams
+-- use the snapshot of the replication slot
+SELECT citus_split_shard_by_split_points(3230002, ARRAY['536870911'],
+                                         ARRAY[:worker_1_node, :worker_2_node],
+                                         'force_logical');
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*) FROM pg_dist_shard WHERE logicalrelid = 'events'::regclass;
+SELECT count(*), sum(event_id), sum(length(payload)) FROM events;
+
+-- rows end up in the shard that covers their hash value
+SELECT count(*) FROM events WHERE event_id = 42;
+SELECT count(*) FROM events WHERE event_id BETWEEN 1 AND 100;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA parallel_shard_copy CASCADE;
@@ -0,0 +1,50 @@
+--
+-- REPARTITION_JOIN_BLOOM_FILTER
+--
+-- Tests filtering the inputs of inner repartition joins with bloom filters
+--
+CREATE SCHEMA repartition_join_bloom_filter;
+SET search_path TO repartition_join_bloom_filter;
+SET citus.next_shard_id TO 3150000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (event_id int, user_id int, payload text);
+SELECT create_distributed_table('events', 'event_id');
+INSERT INTO events SELECT i, i % 100, repeat('x', 50) FROM generate_series(1, 10000) i;
+
+CREATE TABLE customers (id int, user_id int, region text);
+SELECT create_distributed_table('customers', 'id');
+INSERT INTO customers SELECT i, i, CASE WHEN i <= 10 THEN 'eu' ELSE 'us' END FROM generate_series(1, 200) i;
+
+SET citus.enable_repartition_joins TO on;
+SET citus.enable_repartition_join_bloom_filters TO on;
+
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id) WHERE c.region = 'eu';
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id);
+
+-- NULL values in the join column never match
+INSERT INTO events VALUES (10001, NULL, 'null user');
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id) WHERE c.region = 'eu';
+
+-- no bloom filter is used when both sides are too large
+SET citus.repartition_join_bloom_filter_max_rows TO 5;
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id) WHERE c.region = 'eu';
+RESET citus.repartition_join_bloom_filter_max_rows;
+
+BEGIN;
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id) WHERE c.region = 'eu';
+END;
+
+-- bloom filters can be combined with streaming repartition joins
+SET citus.enable_streaming_repartition_joins TO on;
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id) WHERE c.region = 'eu';
+RESET citus.enable_streaming_repartition_joins;
+
+-- same results without bloom filters
+SET citus.enable_repartition_join_bloom_filters TO off;
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id) WHERE c.region = 'eu';
+SELECT count(*) FROM events e JOIN customers c ON (e.user_id = c.user_id);
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA repartition_join_bloom_filter CASCADE;
@@ -0,0 +1,79 @@
+--
+-- REPARTITIONED_AGGREGATION
+--
+-- Tests finalizing the groups of aggregations on the workers after
+-- repartitioning the partial aggregates by a group column
+--
+CREATE SCHEMA repartitioned_aggregation;
+SET search_path TO repartitioned_aggregation;
+SET citus.next_shard_id TO 3180000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (tenant_id int, category int, value int);
+SELECT create_distributed_table('events', 'tenant_id');
+INSERT INTO events SELECT i % 8, i % 10, i FROM generate_series(1, 100) i;
+INSERT INTO events VALUES (1, NULL, 5), (2, NULL, 7);
+
+SET citus.enable_repartitioned_aggregation TO on;
+
+-- only the final rows are sent to the coordinator
+SELECT public.coordinator_plan($Q$
+EXPLAIN (COSTS OFF) SELECT category, count(*) FROM events GROUP BY category;
+$Q$);
+
+SET client_min_messages TO DEBUG1;
+SELECT category, count(*), sum(value) FROM events GROUP BY category ORDER BY category;
+RESET client_min_messages;
+
+-- HAVING is applied on the workers, ORDER BY and LIMIT on the coordinator
+SELECT category, round(avg(value)) FROM events GROUP BY category HAVING count(*) > 5 ORDER BY 2 DESC LIMIT 3;
+
+-- multiple group columns
+SELECT category, value > 50 AS high, count(*) FROM events GROUP BY category, high ORDER BY category, high LIMIT 4;
+
+-- grouping by the distribution column does not need repartitioning
+SELECT tenant_id, count(*) FROM events GROUP BY tenant_id ORDER BY tenant_id LIMIT 2;
+
+-- user-defined aggregates are combined by name on the workers
+CREATE FUNCTION sum2_sfunc(state int, x int)
+RETURNS int IMMUTABLE LANGUAGE plpgsql AS $$
+BEGIN RETURN state + x;
+END;
+$$;
+CREATE FUNCTION sum2_finalfunc(state int)
+RETURNS int IMMUTABLE LANGUAGE plpgsql AS $$
+BEGIN RETURN state * 2;
+END;
+$$;
+CREATE AGGREGATE sum2 (int) (
+    sfunc = sum2_sfunc,
+    stype = int,
+    finalfunc = sum2_finalfunc,
+    combinefunc = sum2_sfunc,
+    initcond = '0'
+);
+SELECT create_distributed_function('sum2(int)');
+
+SET client_min_messages TO DEBUG1;
+SELECT category, sum2(value) FROM events GROUP BY category HAVING sum2(value) > 1000 ORDER BY category;
+RESET client_min_messages;
+
+-- a CTE with repartitioned aggregates is not executed ahead of time with other
+-- subplans, since its tasks need to be repartitioned first
+SET citus.enable_concurrent_subplan_execution TO on;
+WITH category_totals AS MATERIALIZED (
+    SELECT category, count(*) AS c, sum(value) AS s FROM events GROUP BY category
+), event_count AS MATERIALIZED (
+    SELECT count(*) AS c FROM events
+)
+SELECT category, category_totals.c AS count, s AS sum, event_count.c AS total
+FROM category_totals, event_count ORDER BY category;
+RESET citus.enable_concurrent_subplan_execution;
+
+-- results match those combined on the coordinator
+SET citus.enable_repartitioned_aggregation TO off;
+SELECT category, count(*), sum(value) FROM events GROUP BY category ORDER BY category;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA repartitioned_aggregation CASCADE;
@@ -0,0 +1,57 @@
+--
+-- SHARD_ARRAY_SPLITTING
+--
+-- Tests sending each shard query only the values of distribution column
+-- IN lists that hash into its shard
+--
+CREATE SCHEMA shard_array_splitting;
+SET search_path TO shard_array_splitting;
+SET citus.next_shard_id TO 3170000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.shard_array_split_threshold TO 4;
+
+CREATE TABLE items (key int, value int);
+SELECT create_distributed_table('items', 'key');
+INSERT INTO items SELECT i, i * 2 FROM generate_series(1, 100) i;
+
+CREATE TABLE names (key text, value int);
+SELECT create_distributed_table('names', 'key');
+INSERT INTO names SELECT 'name' || i, i FROM generate_series(1, 100) i;
+
+-- IN lists and arrays are split across the shard queries
+SELECT count(*), sum(value) FROM items WHERE key IN (1, 2, 3, 4, 5, 6, 7, 8);
+SELECT count(*), sum(value) FROM items WHERE key = ANY ('{10,20,30,40,50,60}'::int[]);
+
+-- each task only gets the values of its own shard
+SET citus.explain_all_tasks TO on;
+EXPLAIN (COSTS OFF) SELECT key FROM items WHERE key IN (1, 2, 3, 4, 5, 6, 7, 8);
+EXPLAIN (COSTS OFF) SELECT key FROM items WHERE key = ANY ('{10,20,30,40,50,60}'::int[]);
+RESET citus.explain_all_tasks;
+
+-- NULLs and values that are not in the table
+SELECT count(*), sum(value) FROM items WHERE key IN (1, 2, 3, NULL, 200, 300);
+SELECT count(*) FROM names WHERE key IN ('name1', 'name2', 'name3', 'name4', 'name5', 'name200');
+
+-- joins, subqueries and disjunctions
+SELECT count(*) FROM items a JOIN items b USING (key) WHERE a.key IN (1, 2, 3, 4, 5, 6);
+SELECT count(*) FROM (SELECT key FROM items WHERE key IN (1, 2, 3, 4, 5, 6) GROUP BY key) s;
+SELECT count(*) FROM items WHERE key IN (1, 2, 3, 4, 5, 6) OR value = 200;
+
+-- array parameters
+PREPARE items_count(int[]) AS SELECT count(*) FROM items WHERE key = ANY ($1);
+EXECUTE items_count('{1,2,3,4,5,6,7,8}');
+EXECUTE items_count('{1,2,3,4,5,6,7,200}');
+
+-- modifications
+UPDATE items SET value = value + 1 WHERE key IN (1, 2, 3, 4, 5, 6);
+SELECT count(*), sum(value) FROM items WHERE value % 2 = 1;
+DELETE FROM items WHERE key = ANY ('{91,92,93,94,95,96,97,98,99,100}'::int[]);
+SELECT count(*), max(key) FROM items;
+
+-- splitting can be disabled
+SET citus.shard_array_split_threshold TO 0;
+SELECT count(*), sum(value) FROM items WHERE key IN (1, 2, 3, 4, 5, 6, 7, 8);
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA shard_array_splitting CASCADE;
@@ -0,0 +1,76 @@
+--
+-- SHARD_LOAD_REBALANCE
+--
+-- Tests tracking the query load on shards and the by_query_load rebalance
+-- strategy that uses it
+--
+CREATE SCHEMA shard_load_rebalance;
+SET search_path TO shard_load_rebalance;
+SET citus.next_shard_id TO 3300000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (tenant_id int, payload text);
+SELECT create_distributed_table('events', 'tenant_id');
+INSERT INTO events SELECT i % 100, 'payload' FROM generate_series(1, 1000) i;
+
+-- both workers hold the same number of shards
+SELECT count(*) FROM get_rebalance_table_shards_plan('events', rebalance_strategy := 'by_shard_count');
+
+\c - - - :worker_1_port
+SET search_path TO shard_load_rebalance;
+SELECT citus_shard_load_local_reset();
+
+-- the load is not tracked by default
+SELECT count(*) FROM events;
+SELECT count(*) FROM citus_shard_load_local();
+
+-- run many queries on the shards on the first worker
+SET citus.stat_shard_load_track TO 'all';
+DO $$
+DECLARE
+    local_shard_id bigint;
+BEGIN
+    FOR local_shard_id IN SELECT shardid FROM pg_dist_shard JOIN pg_dist_placement USING (shardid)
+                          WHERE logicalrelid = 'events'::regclass
+                          AND groupid = (SELECT groupid FROM pg_dist_local_group) LOOP
+        FOR i IN 1..1000 LOOP
+            EXECUTE format('SELECT count(*) FROM %I WHERE tenant_id = $1', 'events_' || local_shard_id)
+            USING i % 100;
+        END LOOP;
+    END LOOP;
+END;
+$$;
+RESET citus.stat_shard_load_track;
+
+-- the statistics decay over time, hence we round them
+SELECT count(*), min(round(query_count / 100)), max(round(query_count / 100)),
+       min(load) > 500 AS loaded
+FROM citus_shard_load_local();
+
+-- every query reads all rows of its shard, not only the row it returns
+SELECT bool_and(tuples_read / query_count > 100) AS reads_shard_rows
+FROM citus_shard_load_local();
+
+\c - - - :master_port
+SET search_path TO shard_load_rebalance;
+
+-- shards on the first worker are expensive, shards without load cost 1
+SELECT nodeport = :worker_1_port AS on_worker_1,
+       citus_shard_cost_by_query_load(shardid) > 500 AS hot
+FROM pg_dist_shard_placement
+WHERE shardid BETWEEN 3300000 AND 3300003
+ORDER BY shardid;
+
+-- a hot shard moves to the second worker
+SELECT sourceport = :worker_1_port AS from_worker_1,
+       targetport = :worker_2_port AS to_worker_2
+FROM get_rebalance_table_shards_plan('events', rebalance_strategy := 'by_query_load');
+
+\c - - - :worker_1_port
+SELECT citus_shard_load_local_reset();
+SELECT count(*) FROM citus_shard_load_local();
+\c - - - :master_port
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA shard_load_rebalance CASCADE;
@@ -0,0 +1,69 @@
+--
+-- SHARD_QUERY_TEMPLATES
+--
+-- Tests that shard queries built from a query template are the same as shard
+-- queries that are deparsed for each task
+--
+CREATE SCHEMA "shard query templates";
+SET search_path TO "shard query templates";
+SET citus.next_shard_id TO 3290000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE "Events" (tenant_id int, "Value" int);
+SELECT create_distributed_table('"Events"', 'tenant_id');
+INSERT INTO "Events" SELECT i % 4, i FROM generate_series(1, 8) i;
+-- shard names that need quoting
+CREATE TABLE "order ""items""" (tenant_id int, quantity int);
+SELECT create_distributed_table('"order ""items"""', 'tenant_id');
+INSERT INTO "order ""items""" VALUES (0, 10), (1, 20), (2, 30), (3, 40);
+
+SET citus.enable_shard_query_templates TO on;
+-- multi-shard SELECT
+SELECT e.tenant_id, sum(e."Value"), max(i.quantity)
+FROM (SELECT * FROM "Events" WHERE "Value" > 2) e JOIN "order ""items""" i USING (tenant_id)
+GROUP BY e.tenant_id ORDER BY 1;
+BEGIN;
+-- INSERT..SELECT
+INSERT INTO "order ""items""" SELECT tenant_id, "Value" FROM "Events" WHERE "Value" > 6;
+SELECT * FROM "order ""items""" ORDER BY 1, 2;
+-- modifications with RETURNING
+UPDATE "Events" SET "Value" = "Value" + 100 WHERE "Value" = 5 RETURNING *;
+WITH updated AS (
+  UPDATE "Events" e SET "Value" = i.quantity FROM "order ""items""" i
+  WHERE e.tenant_id = i.tenant_id AND e."Value" < 3
+  RETURNING e.tenant_id, e."Value"
+)
+SELECT * FROM updated ORDER BY 1, 2;
+WITH deleted AS (
+  DELETE FROM "Events" WHERE "Value" > 6 RETURNING *
+)
+SELECT * FROM deleted ORDER BY 1, 2;
+ROLLBACK;
+
+SET citus.enable_shard_query_templates TO off;
+-- multi-shard SELECT
+SELECT e.tenant_id, sum(e."Value"), max(i.quantity)
+FROM (SELECT * FROM "Events" WHERE "Value" > 2) e JOIN "order ""items""" i USING (tenant_id)
+GROUP BY e.tenant_id ORDER BY 1;
+BEGIN;
+-- INSERT..SELECT
+INSERT INTO "order ""items""" SELECT tenant_id, "Value" FROM "Events" WHERE "Value" > 6;
+SELECT * FROM "order ""items""" ORDER BY 1, 2;
+-- modifications with RETURNING
+UPDATE "Events" SET "Value" = "Value" + 100 WHERE "Value" = 5 RETURNING *;
+WITH updated AS (
+  UPDATE "Events" e SET "Value" = i.quantity FROM "order ""items""" i
+  WHERE e.tenant_id = i.tenant_id AND e."Value" < 3
+  RETURNING e.tenant_id, e."Value"
+)
+SELECT * FROM updated ORDER BY 1, 2;
+WITH deleted AS (
+  DELETE FROM "Events" WHERE "Value" > 6 RETURNING *
+)
+SELECT * FROM deleted ORDER BY 1, 2;
+ROLLBACK;
+
+RESET citus.enable_shard_query_templates;
+SET client_min_messages TO WARNING;
+DROP SCHEMA "shard query templates" CASCADE;
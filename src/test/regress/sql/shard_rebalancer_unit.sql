@@ -584,3 +584,49 @@ SELECT unnest(shard_placement_rebalance_array(
         ]::json[],
     improvement_threshold := 0.1
 ));
+
+-- Check that the fill state lists stay sorted when the emptiest node does not
+-- allow the shards of the fullest node, and the move goes to a node whose new
+-- utilization passes both other nodes
+SELECT unnest(shard_placement_rebalance_array(
+    ARRAY['{"node_name": "x", "disallowed_shards": "3,4"}',
+          '{"node_name": "t"}',
+          '{"node_name": "a"}',
+          '{"node_name": "s"}']::json[],
+    ARRAY['{"shardid":1, "cost":1, "nodename":"t"}',
+          '{"shardid":2, "cost":2, "nodename":"a"}',
+          '{"shardid":3, "cost":5, "nodename":"s"}',
+          '{"shardid":4, "cost":4, "nodename":"s"}'
+        ]::json[]
+));
+
+CREATE FUNCTION shard_placement_rebalance_benchmark(
+    node_count int,
+    shard_count int,
+    colocation_group_count int DEFAULT 1,
+    max_shard_cost int DEFAULT 1,
+    threshold float4 DEFAULT 0,
+    improvement_threshold float4 DEFAULT 0.5,
+    OUT move_count int,
+    OUT planning_time_ms float8
+)
+AS 'citus'
+LANGUAGE C STRICT VOLATILE;
+
+-- Check the plan size for a cluster that was just doubled in size, half of the
+-- shards have to move to the new nodes
+SELECT move_count, planning_time_ms >= 0 AS timed
+FROM shard_placement_rebalance_benchmark(4, 40, colocation_group_count := 2);
+
+-- Colocation groups with fewer shards than nodes are balanced together
+SELECT move_count FROM shard_placement_rebalance_benchmark(4, 6, colocation_group_count := 3);
+
+-- Planning a large cluster with varying shard costs should finish quickly
+SELECT move_count > 0 AS has_moves, planning_time_ms < 60000 AS fast_enough
+FROM shard_placement_rebalance_benchmark(8, 8000, colocation_group_count := 16,
+                                         max_shard_cost := 100,
+                                         improvement_threshold := 0);
+
+SELECT shard_placement_rebalance_benchmark(0, 10);
+
+DROP FUNCTION shard_placement_rebalance_benchmark(int, int, int, int, float4, float4);
@@ -0,0 +1,83 @@
+--
+-- SHARD_TRANSFER_COMPRESSION
+--
+-- Tests compressing the data that is sent between nodes when copying shards
+--
+CREATE SCHEMA shard_transfer_compression;
+SET search_path TO shard_transfer_compression;
+SET citus.next_shard_id TO 3280000;
+SET citus.shard_count TO 2;
+SET citus.shard_replication_factor TO 1;
+
+SELECT nodeid AS worker_1_node FROM pg_dist_node WHERE nodeport=:worker_1_port \gset
+SELECT nodeid AS worker_2_node FROM pg_dist_node WHERE nodeport=:worker_2_port \gset
+
+CREATE TABLE events (event_id bigint primary key, payload text);
+SELECT create_distributed_table('events', 'event_id');
+INSERT INTO events SELECT i, repeat('x', 200) FROM generate_series(1, 10000) i;
+
+-- use the methods this build supports, such that the output does not depend on it
+SELECT CASE WHEN 'lz4' = ANY(enumvals) THEN 'lz4' ELSE 'none' END AS lz4_method,
+       CASE WHEN 'zstd' = ANY(enumvals) THEN 'zstd' ELSE 'none' END AS zstd_method,
+       coalesce((SELECT method FROM unnest(enumvals) method WHERE method <> 'none' LIMIT 1),
+                'none') AS compression_method
+FROM pg_settings WHERE name = 'citus.shard_transfer_compression' \gset
+
+-- the initial copy before logical replication is compressed, and the target
+-- node only accepts compressed data once the COPY announces compression
+SET citus.shard_transfer_compression TO :'lz4_method';
+SELECT citus_move_shard_placement(3280000, nodeid,
+                                  CASE WHEN nodeid = :worker_1_node THEN :worker_2_node ELSE :worker_1_node END,
+                                  'force_logical')
+FROM pg_dist_shard_placement JOIN pg_dist_node USING (nodename, nodeport)
+WHERE shardid = 3280000;
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*), sum(event_id), sum(length(payload)) FROM events;
+
+-- as is the copy while blocking writes
+SET citus.shard_transfer_compression TO :'zstd_method';
+SELECT citus_move_shard_placement(3280000, nodeid,
+                                  CASE WHEN nodeid = :worker_1_node THEN :worker_2_node ELSE :worker_1_node END,
+                                  'block_writes')
+FROM pg_dist_shard_placement JOIN pg_dist_node USING (nodename, nodeport)
+WHERE shardid = 3280000;
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*), sum(event_id), sum(length(payload)) FROM events;
+
+-- split children are not in the metadata while their data is copied, so
+-- splits copy uncompressed
+SELECT citus_split_shard_by_split_points(3280001, ARRAY['1073741823'],
+                                         ARRAY[:worker_1_node, :worker_2_node],
+                                         'block_writes');
+SELECT public.wait_for_resource_cleanup();
+SELECT count(*), sum(event_id), sum(length(payload)) FROM events;
+SELECT count(*) FROM events WHERE event_id BETWEEN 1 AND 100;
+RESET citus.shard_transfer_compression;
+
+-- compressed streams are only accepted for shards
+CREATE TABLE local_events (event_id bigint, payload text);
+COPY local_events FROM STDIN WITH (compression 'lz4');
+COPY events FROM STDIN WITH (compression 'lz4');
+
+SET citus.next_shard_id TO 3280100;
+CREATE TABLE copy_target (event_id bigint, payload text);
+SELECT create_distributed_table('copy_target', 'event_id', shard_count => 1, colocate_with => 'none');
+SELECT nodeport AS copy_target_port FROM pg_dist_shard_placement WHERE shardid = 3280100 \gset
+
+\c - - - :copy_target_port
+SET search_path TO shard_transfer_compression;
+
+-- the receiving side checks the compression method before it accepts data
+COPY copy_target_3280100 FROM STDIN WITH (compression 'snappy');
+
+-- and it only accepts data that is compressed with that method
+COPY copy_target_3280100 FROM STDIN WITH (compression :'compression_method');
+1	a
+\.
+SELECT count(*) FROM copy_target_3280100;
+
+\c - - - :master_port
+SET search_path TO shard_transfer_compression;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA shard_transfer_compression CASCADE;
@@ -0,0 +1,57 @@
+--
+-- STREAMING_REPARTITION_JOIN
+--
+-- Tests pushing repartitioned results to the nodes that consume them
+--
+CREATE SCHEMA streaming_repartition_join;
+SET search_path TO streaming_repartition_join;
+SET citus.next_shard_id TO 3140000;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE events (event_id int, user_id int, payload text);
+SELECT create_distributed_table('events', 'event_id');
+INSERT INTO events SELECT i, i % 100, repeat('x', 50) FROM generate_series(1, 10000) i;
+
+SET citus.enable_repartition_joins TO on;
+SET citus.enable_streaming_repartition_joins TO on;
+
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.event_id);
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.user_id);
+
+-- NULL values in the partition column
+INSERT INTO events VALUES (10001, NULL, 'null user');
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.event_id);
+
+-- the plan is cached on the first execution, such that the second one only
+-- shows that the map tasks push their partitions, except in a transaction block
+PREPARE single_repartition AS
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.event_id);
+EXECUTE single_repartition;
+SET client_min_messages TO DEBUG1;
+EXECUTE single_repartition;
+BEGIN;
+EXECUTE single_repartition;
+END;
+RESET client_min_messages;
+
+-- results are fetched as usual in a transaction block
+BEGIN;
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.event_id);
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.user_id);
+END;
+
+-- pushed results are compressed with the settings of the coordinator
+SET citus.intermediate_result_compression TO 'lz4';
+SET citus.intermediate_result_compression_threshold TO 0;
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.user_id);
+RESET citus.intermediate_result_compression;
+RESET citus.intermediate_result_compression_threshold;
+
+-- same results without streaming
+SET citus.enable_streaming_repartition_joins TO off;
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.event_id);
+SELECT count(*) FROM events e1 JOIN events e2 ON (e1.user_id = e2.user_id);
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA streaming_repartition_join CASCADE;
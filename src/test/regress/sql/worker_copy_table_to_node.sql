@@ -41,6 +41,25 @@ SELECT worker_copy_table_to_node('t_62629600', :worker_2_node);
 SET search_path TO worker_copy_table_to_node;
 
 SELECT count(*) FROM t_62629600;
+TRUNCATE t_62629600;
+
+\c - - - :worker_1_port
+SET search_path TO worker_copy_table_to_node;
+
+-- Copy the shard in block ranges, the last one extending to the end of the shard
+INSERT INTO t_62629600 SELECT generate_series(1, 1000);
+SELECT worker_copy_table_to_node('t_62629600', :worker_2_node, 0, 2);
+SELECT worker_copy_table_to_node('t_62629600', :worker_2_node, 2, NULL);
+
+-- Invalid block ranges
+SELECT worker_copy_table_to_node('t_62629600', :worker_2_node, -1, NULL);
+SELECT worker_copy_table_to_node('t_62629600', :worker_2_node, 2, 1);
+SELECT worker_copy_table_to_node('t_62629600', :worker_2_node, NULL, 1);
+
+\c - - - :worker_2_port
+SET search_path TO worker_copy_table_to_node;
+
+SELECT count(*), sum(a) FROM t_62629600;
 
 \c - - - :master_port
 SET search_path TO worker_copy_table_to_node;